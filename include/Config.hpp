@@ -6,7 +6,14 @@
 ControllerConfig getDefaultControllerConfig() {
     ControllerConfig config {
         .maxAngle = 1.0f, // Max angle in range [0, 1]
-        .updateRateMs = 100 // Update rate in milliseconds
+        .updateRateMs = 100, // Update rate in milliseconds
+
+        .reconstructionMode = ControllerReconstructionMode::EXTRAPOLATE, // Reconstruction of the controller position between updates
+        .maxExtrapolationMs = 100,  // Max time in milliseconds the last controller sample can be projected ahead
+
+        .adaptiveUpdateRate = true, // Adapt the update rate to the game phase and to the link quality
+        .minUpdateRateMs = 50,      // Fastest update rate in milliseconds (in game)
+        .maxUpdateRateMs = 200      // Slowest update rate in milliseconds (attract mode or degraded link)
     };
 
     return config;
@@ -16,7 +23,10 @@ GameConfig getDefaultGameConfig() {
     GameConfig config {
         .easyTimeLimitMs = 50000,   // Time limit for easy level in milliseconds
         .maxServoPulseRate = 4000,  // Maximum servo pulse change rate in pulses/second
+        .maxServoPulseAccel = 60000,    // Maximum servo pulse acceleration in pulses/second^2 (what the servo follows)
+        .maxServoPulseJerk = 4000000,   // Maximum servo pulse jerk in pulses/second^3
         .servoPulseRange = 600,     // Range of servo pulse in microseconds (e.g. 1000 for 1000-2000us)
+        .servoLoopRateHz = 250,     // Rate in Hz of the servo motion loop that ramps the servos towards their targets
 
         .prepareGamePulseRate = 200,    // Servo pulse change rate in pulses/second during game preparation phase (before start)
         .prepareGameXPulseus = 200,     // X servo pulse width during game preparation phase (before start)
@@ -26,10 +36,22 @@ GameConfig getDefaultGameConfig() {
         .ballDropXDeltaPulseUs = 200,   // X servo pulse width delta from center when ball is dropped
         .ballDropYDeltaPulseUs = -250,  // Y servo pulse width delta from center when ball is dropped
         .ballDropTimeMs = 4000,         // Time in milliseconds for the ball to reach the drop collection box after being dropped
+        .ballDropMinPulseUs = 500,      // Shortest ball drop sensor pulse in microseconds accepted as a ball, shorter ones are glitches
 
         .servoCalibrationErrorThresholdDeg = 0.5f,  // Acceptable error threshold in degrees for servo calibration
         .servoCalibrationTargetAngleXDeg = 0.0f,    // Compensation for physical X axis misalignment in degrees for servo calibration to achieve level orientation
-        .servoCalibrationTargetAngleYDeg = -1.7f    // Compensation for physical Y axis misalignment in degrees for servo calibration to achieve level orientation
+        .servoCalibrationTargetAngleYDeg = -1.7f,   // Compensation for physical Y axis misalignment in degrees for servo calibration to achieve level orientation
+
+        .tiltControlEnabled = false,        // Close the loop on the table tilt measured by the IMU during the game
+        .tiltMaxAngleDeg = 8.0f,            // Table tilt in degrees commanded at full controller deflection in closed-loop mode
+        .tiltKp = 20.0f,                    // Tilt PID proportional gain in microseconds per degree
+        .tiltKi = 200.0f,                   // Tilt PID integral gain in microseconds per degree per second
+        .tiltKd = 0.1f,                     // Tilt PID derivative gain in microseconds per degree per second of tilt rate
+        .tiltMaxCorrectionPulseUs = 100,    // Maximum servo pulse correction in microseconds applied by the tilt PID
+        .tiltSensorPeriodMs = 20,           // Period in milliseconds of the IMU tilt measurements
+
+        .telemetryCapacityRecords = 65536,  // Size in records of the in-game telemetry ring buffer allocated in PSRAM (26 bytes each)
+        .telemetryMaxGames = 8              // Number of most recent games kept by the in-game telemetry
     };
 
     return config;
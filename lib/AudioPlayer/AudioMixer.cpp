@@ -0,0 +1,332 @@
+#include "AudioMixer.hpp"
+
+namespace {
+    constexpr uint8_t kVoiceIndexBits = 3;      // A handle is the voice serial followed by the voice index
+
+    int16_t saturate(int32_t value, uint32_t& clipped) {
+        if (value > INT16_MAX) {
+            clipped++;
+            return INT16_MAX;
+        }
+        if (value < INT16_MIN) {
+            clipped++;
+            return INT16_MIN;
+        }
+        return (int16_t)value;
+    }
+}
+
+static_assert(AudioMixer::MAX_VOICES <= (1 << kVoiceIndexBits), "Voice index does not fit the handle");
+
+AudioMixer::Voice* AudioMixer::allocate(uint8_t priority) {
+    Voice* victim = nullptr;
+    for (Voice& voice : voices) {
+        if (voice.source == Source::NONE) {
+            return &voice;
+        }
+        if (victim == nullptr || voice.priority < victim->priority ||
+            (voice.priority == victim->priority && voice.serial < victim->serial)) {
+            victim = &voice;
+        }
+    }
+
+    // Every voice is busy: steal the least important and oldest one, unless it is more important than the new sound
+    if (victim->priority > priority) {
+        stats.voicesRefused++;
+        return nullptr;
+    }
+    release(*victim);
+    stats.voicesStolen++;
+    return victim;
+}
+
+AudioVoice AudioMixer::start(Voice& voice, Source source, uint8_t priority, uint16_t gain) {
+    voice.source = source;
+    voice.priority = priority;
+    voice.gain = gain;
+    voice.serial = nextSerial++;
+    voice.delayFrames = 0;
+    stats.voicesStarted++;
+    stats.maxActiveVoices = max(stats.maxActiveVoices, getActiveCount());
+    return (voice.serial << kVoiceIndexBits) | (uint32_t)(&voice - voices);
+}
+
+AudioMixer::Voice* AudioMixer::find(AudioVoice handle) {
+    uint32_t index = handle & ((1 << kVoiceIndexBits) - 1);
+    if (handle == AUDIO_VOICE_NONE || index >= MAX_VOICES) {
+        return nullptr;
+    }
+    Voice& voice = voices[index];
+    if (voice.source == Source::NONE || voice.serial != handle >> kVoiceIndexBits) {
+        return nullptr;
+    }
+    return &voice;
+}
+
+const AudioMixer::Voice* AudioMixer::find(AudioVoice handle) const {
+    return const_cast<AudioMixer*>(this)->find(handle);
+}
+
+void AudioMixer::release(Voice& voice) {
+    if (voice.source == Source::STREAM && voice.file) {
+        voice.file.close();
+    }
+    voice.file = fs::File();
+    voice.source = Source::NONE;
+}
+
+AudioVoice AudioMixer::playSample(const CachedSample& sample, uint8_t priority, uint16_t gain) {
+    if (sample.sampleRate != SAMPLE_RATE) {
+        return AUDIO_VOICE_NONE;
+    }
+    Voice* voice = allocate(priority);
+    if (voice == nullptr) {
+        return AUDIO_VOICE_NONE;
+    }
+    voice->sample = &sample;
+    voice->position = 0;
+    return start(*voice, Source::SAMPLE, priority, gain);
+}
+
+AudioVoice AudioMixer::playStream(fs::FS& fs, const char* path, uint8_t priority, uint16_t gain) {
+    if (path == nullptr || strlen(path) >= MAX_PATH_LENGTH) {
+        return AUDIO_VOICE_NONE;
+    }
+    Voice* voice = allocate(priority);
+    if (voice == nullptr) {
+        return AUDIO_VOICE_NONE;
+    }
+    voice->fs = &fs;
+    strcpy(voice->path, path);
+    voice->remainingFrames = 0;
+    voice->bufferFrames = 0;
+    voice->bufferPosition = 0;
+    return start(*voice, Source::STREAM, priority, gain);
+}
+
+AudioVoice AudioMixer::playTone(uint16_t frequency, uint32_t durationFrames, uint8_t priority, uint16_t gain,
+                                ToneWaveform waveform, const ToneEnvelope& envelope) {
+    Voice* voice = allocate(priority);
+    if (voice == nullptr) {
+        return AUDIO_VOICE_NONE;
+    }
+    voice->synth.startTone(frequency, durationFrames, waveform, envelope);
+    return start(*voice, Source::TONE, priority, gain);
+}
+
+AudioVoice AudioMixer::playSequence(const ToneNote* notes, uint8_t count, ToneWaveform waveform,
+                                    const ToneEnvelope& envelope, uint8_t priority, uint16_t gain) {
+    if (notes == nullptr || count == 0) {
+        return AUDIO_VOICE_NONE;
+    }
+    Voice* voice = allocate(priority);
+    if (voice == nullptr) {
+        return AUDIO_VOICE_NONE;
+    }
+    voice->synth.startSequence(notes, count, waveform, envelope);
+    return start(*voice, Source::TONE, priority, gain);
+}
+
+bool AudioMixer::setTone(AudioVoice handle, uint16_t frequency, uint32_t durationFrames) {
+    Voice* voice = find(handle);
+    if (voice == nullptr || voice->source != Source::TONE) {
+        return false;
+    }
+    return voice->synth.retune(frequency, durationFrames);
+}
+
+bool AudioMixer::delayStart(AudioVoice handle, uint32_t frames) {
+    Voice* voice = find(handle);
+    if (voice == nullptr) {
+        return false;
+    }
+    voice->delayFrames = frames;
+    return true;
+}
+
+bool AudioMixer::setGain(AudioVoice handle, uint16_t gain) {
+    Voice* voice = find(handle);
+    if (voice == nullptr) {
+        return false;
+    }
+    voice->gain = gain;
+    return true;
+}
+
+void AudioMixer::stop(AudioVoice handle) {
+    Voice* voice = find(handle);
+    if (voice == nullptr) {
+        return;
+    }
+    // A tone fades out with its envelope release, the voice ends with it
+    if (voice->source == Source::TONE) {
+        voice->synth.release();
+    } else {
+        release(*voice);
+    }
+}
+
+void AudioMixer::stopAll() {
+    for (Voice& voice : voices) {
+        if (voice.source != Source::NONE) {
+            release(voice);
+        }
+    }
+}
+
+bool AudioMixer::isPlaying(AudioVoice handle) const {
+    return find(handle) != nullptr;
+}
+
+uint8_t AudioMixer::getActiveCount() const {
+    uint8_t count = 0;
+    for (const Voice& voice : voices) {
+        if (voice.source != Source::NONE) {
+            count++;
+        }
+    }
+    return count;
+}
+
+bool AudioMixer::openStream(Voice& voice) {
+    voice.file = voice.fs->open(voice.path);
+    WavFormat wav;
+    bool opened = voice.file && !voice.file.isDirectory() && readWavHeader(voice.file, wav);
+    bool adpcm = opened && wav.isImaAdpcm();
+    bool playable = adpcm ? wav.blockAlign <= MAX_ADPCM_BLOCK_BYTES && wav.blockFrames <= STREAM_BUFFER_FRAMES
+                          : opened && wav.isPcm16();
+    if (!playable || wav.sampleRate != SAMPLE_RATE) {
+        Serial.printf("Mixer: cannot stream %s, 16-bit PCM or IMA ADPCM WAV at %lu Hz required\n", voice.path,
+            (unsigned long)SAMPLE_RATE);
+        return false;
+    }
+    voice.channels = (uint8_t)wav.channels;
+    voice.remainingFrames = wav.getFrames();
+    voice.blockBytes = adpcm ? wav.blockAlign : 0;
+    return true;
+}
+
+bool AudioMixer::fillStream(Voice& voice) {
+    if (voice.remainingFrames == 0) {
+        return false;
+    }
+    uint32_t frames;
+    if (voice.blockBytes > 0) {
+        // One block, the last one may be shorter in the file or padded past the last frame
+        size_t bytes = voice.file.read(voice.block, voice.blockBytes);
+        stats.streamBytesRead += bytes;
+        frames = min(imaAdpcmDecodeBlock(voice.block, bytes, voice.channels, voice.buffer), voice.remainingFrames);
+        if (frames == 0) {
+            return false;
+        }
+    } else {
+        frames = min(STREAM_BUFFER_FRAMES, voice.remainingFrames);
+        size_t bytes = frames * voice.channels * sizeof(int16_t);
+        if (voice.file.read(reinterpret_cast<uint8_t*>(voice.buffer), bytes) != bytes) {
+            return false;
+        }
+        stats.streamBytesRead += bytes;
+    }
+    voice.remainingFrames -= frames;
+    voice.bufferFrames = frames;
+    voice.bufferPosition = 0;
+    return true;
+}
+
+uint32_t AudioMixer::mixSample(Voice& voice, int32_t* accumulator, uint32_t frames, int32_t gain) {
+    const CachedSample& sample = *voice.sample;
+    uint32_t count = min(frames, sample.frames - voice.position);
+    const int16_t* source = sample.samples + voice.position * sample.channels;
+    if (sample.channels == 1) {
+        for (uint32_t i = 0; i < count; i++) {
+            int32_t value = (source[i] * gain) >> 15;
+            accumulator[i * 2] += value;
+            accumulator[i * 2 + 1] += value;
+        }
+    } else {
+        for (uint32_t i = 0; i < count * 2; i++) {
+            accumulator[i] += (source[i] * gain) >> 15;
+        }
+    }
+    voice.position += count;
+    return count;
+}
+
+uint32_t AudioMixer::mixStream(Voice& voice, int32_t* accumulator, uint32_t frames, int32_t gain) {
+    uint32_t mixed = 0;
+    while (mixed < frames) {
+        if (voice.bufferPosition == voice.bufferFrames && !fillStream(voice)) {
+            break;
+        }
+        uint32_t count = min(frames - mixed, voice.bufferFrames - voice.bufferPosition);
+        const int16_t* source = voice.buffer + voice.bufferPosition * voice.channels;
+        int32_t* target = accumulator + mixed * 2;
+        if (voice.channels == 1) {
+            for (uint32_t i = 0; i < count; i++) {
+                int32_t value = (source[i] * gain) >> 15;
+                target[i * 2] += value;
+                target[i * 2 + 1] += value;
+            }
+        } else {
+            for (uint32_t i = 0; i < count * 2; i++) {
+                target[i] += (source[i] * gain) >> 15;
+            }
+        }
+        voice.bufferPosition += count;
+        mixed += count;
+    }
+    return mixed;
+}
+
+void AudioMixer::mix(int16_t* out, uint32_t frames) {
+    frames = min(frames, MAX_BLOCK_FRAMES);
+    int32_t accumulator[MAX_BLOCK_FRAMES * 2] = {};
+
+    for (Voice& voice : voices) {
+        if (voice.source == Source::NONE) {
+            continue;
+        }
+        // A delayed voice starts inside the block, or not in this one at all
+        uint32_t delay = min(voice.delayFrames, frames);
+        voice.delayFrames -= delay;
+        if (delay == frames) {
+            continue;
+        }
+        if (voice.source == Source::STREAM && !voice.file && !openStream(voice)) {
+            stats.streamErrors++;
+            release(voice);
+            continue;
+        }
+
+        // One multiply per sample: the voice and the master gains are combined once per block
+        int32_t gain = ((int32_t)voice.gain * masterGain) >> 15;
+        int32_t* target = accumulator + delay * 2;
+        uint32_t count = frames - delay;
+        uint32_t mixed = 0;
+        switch (voice.source) {
+            case Source::SAMPLE:
+                mixed = mixSample(voice, target, count, gain);
+                break;
+            case Source::STREAM:
+                mixed = mixStream(voice, target, count, gain);
+                break;
+            case Source::TONE:
+                mixed = voice.synth.render(target, count, gain);
+                break;
+            case Source::NONE:
+                break;
+        }
+        // A tone ending right at the block end is released now, not by the next block
+        if (mixed < count || (voice.source == Source::TONE && !voice.synth.isPlaying())) {
+            if (voice.source == Source::STREAM && voice.remainingFrames > 0) {
+                stats.streamErrors++;
+            }
+            release(voice);
+        }
+    }
+
+    for (uint32_t i = 0; i < frames * 2; i++) {
+        out[i] = saturate(accumulator[i], stats.clippedSamples);
+    }
+    stats.framesMixed += frames;
+}
@@ -0,0 +1,228 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+#include "SampleCache.hpp"
+#include "ToneSynth.hpp"
+
+/**
+ * Handle of a mixer voice, returned when a sound starts. A handle stays invalid once its sound ends, even when
+ * the voice is reused by another sound.
+ */
+typedef uint32_t AudioVoice;
+
+constexpr AudioVoice AUDIO_VOICE_NONE = 0;
+
+constexpr uint16_t AUDIO_GAIN_UNITY = 32768;   // Gains are Q15: 32768 is 1.0
+
+constexpr uint8_t AUDIO_PRIORITY_EFFECT = 64;  // Short sound effects, may steal each other
+constexpr uint8_t AUDIO_PRIORITY_MUSIC = 128;  // Jingles and tunes, not stolen by effects
+
+/**
+ * Mixer statistics, to check that the voices are enough and the output does not clip
+ */
+struct AudioMixerStats {
+    uint32_t voicesStarted;
+    uint32_t voicesStolen;      // Voices stopped to start a sound of the same or higher priority
+    uint32_t voicesRefused;     // Sounds not started because every voice had a higher priority
+    uint32_t streamErrors;      // Streamed files that could not be opened or read
+    uint64_t streamBytesRead;   // Samples read from the streamed files, a quarter of the PCM size for IMA ADPCM
+    uint8_t maxActiveVoices;    // Most voices mixed at the same time
+    uint64_t framesMixed;
+    uint32_t clippedSamples;    // Output samples saturated to the int16 range
+
+    /**
+     * Print the statistics in a human readable format
+     * @param out Where to print the statistics (e.g. Serial)
+     */
+    void printTo(Print& out) const {
+        out.printf("Mixer: %lu voices started, %lu stolen, %lu refused, %lu stream errors, at most %u at once\n",
+            (unsigned long)voicesStarted, (unsigned long)voicesStolen, (unsigned long)voicesRefused,
+            (unsigned long)streamErrors, maxActiveVoices);
+        out.printf("  %llu frames mixed, %lu samples clipped, %llu bytes streamed\n", (unsigned long long)framesMixed,
+            (unsigned long)clippedSamples, (unsigned long long)streamBytesRead);
+    }
+};
+
+/**
+ * AudioMixer sums up to MAX_VOICES sounds into one 16-bit stereo stream at SAMPLE_RATE. A voice plays a sample
+ * of the SampleCache, a 16-bit PCM or IMA ADPCM WAV file streamed from a file system, or a tone or a note sequence
+ * of a ToneSynth. Each voice has a gain and a priority: when every voice is busy, a new sound takes the voice of
+ * the lowest priority, the oldest first, if that priority is not higher than its own.
+ *
+ * The mixing is fixed point: every voice sample is scaled by the voice gain times the master gain (Q15), summed
+ * in 32 bits and saturated to 16 bits. The mixer is not thread safe, the owner serializes the calls.
+ */
+class AudioMixer {
+public:
+    static constexpr uint8_t MAX_VOICES = 4;
+    static constexpr uint32_t SAMPLE_RATE = 44100;
+    static constexpr uint32_t MAX_BLOCK_FRAMES = 256;       // Largest block mixed by one mix() call
+    static constexpr uint32_t STREAM_BUFFER_FRAMES = 512;   // Frames read from a streamed file at once
+    static constexpr uint32_t MAX_ADPCM_BLOCK_BYTES = 512;  // Largest IMA ADPCM block of a streamed file
+    static constexpr uint8_t MAX_PATH_LENGTH = 32;
+
+    /**
+     * Starts playing a cached sample.
+     * @param sample The sample, it must be at SAMPLE_RATE and stay valid while playing.
+     * @param priority Voice priority, higher is kept longer.
+     * @param gain Voice gain, Q15.
+     * @return The voice handle, or AUDIO_VOICE_NONE if no voice is available or the sample rate differs.
+     */
+    AudioVoice playSample(const CachedSample& sample, uint8_t priority, uint16_t gain = AUDIO_GAIN_UNITY);
+
+    /**
+     * Starts streaming a WAV file. The file is opened by the next mix() call, the one that mixes its first
+     * samples; it must be 16-bit PCM or IMA ADPCM (blocks of at most MAX_ADPCM_BLOCK_BYTES and
+     * STREAM_BUFFER_FRAMES) at SAMPLE_RATE or the voice ends there. ADPCM is decoded a block per buffer fill.
+     * @param fs File system holding the file (e.g. SPIFFS).
+     * @param path Path of the file, copied.
+     * @param priority Voice priority, higher is kept longer.
+     * @param gain Voice gain, Q15.
+     * @return The voice handle, or AUDIO_VOICE_NONE if no voice is available or the path is too long.
+     */
+    AudioVoice playStream(fs::FS& fs, const char* path, uint8_t priority, uint16_t gain = AUDIO_GAIN_UNITY);
+
+    /**
+     * Starts a tone.
+     * @param frequency Tone frequency in Hz.
+     * @param durationFrames Tone duration in frames, the release of the envelope included.
+     * @param priority Voice priority, higher is kept longer.
+     * @param gain Voice gain, Q15.
+     * @param waveform Waveform of the tone.
+     * @param envelope Envelope of the tone.
+     * @return The voice handle, or AUDIO_VOICE_NONE if no voice is available.
+     */
+    AudioVoice playTone(uint16_t frequency, uint32_t durationFrames, uint8_t priority, uint16_t gain = AUDIO_GAIN_UNITY,
+                        ToneWaveform waveform = ToneWaveform::SINE, const ToneEnvelope& envelope = TONE_ENVELOPE_DEFAULT);
+
+    /**
+     * Starts a sequence of notes.
+     * @param notes The notes, they must stay valid while playing (e.g. a static const array).
+     * @param count Number of notes.
+     * @param waveform Waveform of the notes.
+     * @param envelope Envelope of each note.
+     * @param priority Voice priority, higher is kept longer.
+     * @param gain Voice gain, Q15.
+     * @return The voice handle, or AUDIO_VOICE_NONE if no voice is available.
+     */
+    AudioVoice playSequence(const ToneNote* notes, uint8_t count, ToneWaveform waveform, const ToneEnvelope& envelope,
+                            uint8_t priority, uint16_t gain = AUDIO_GAIN_UNITY);
+
+    /**
+     * Changes the frequency and the remaining duration of a playing tone, keeping its phase and its level so
+     * there is no click.
+     * @param voice Handle returned by playTone.
+     * @param frequency New frequency in Hz.
+     * @param durationFrames New remaining duration in frames.
+     * @return true if the tone is still playing and was changed, false otherwise (a sequence is not changed).
+     */
+    bool setTone(AudioVoice voice, uint16_t frequency, uint32_t durationFrames);
+
+    /**
+     * Delays the first sample of a voice just started: it stays silent for the given frames of the next blocks,
+     * so the sound starts at an exact frame instead of at the start of the next block.
+     * @param voice Voice handle, not yet mixed.
+     * @param frames Frames of silence before the first sample.
+     * @return true if the voice is still playing, false otherwise.
+     */
+    bool delayStart(AudioVoice voice, uint32_t frames);
+
+    /**
+     * Changes the gain of a playing voice.
+     * @return true if the voice is still playing, false otherwise.
+     */
+    bool setGain(AudioVoice voice, uint16_t gain);
+
+    /**
+     * Sets the gain applied to the sum of the voices.
+     * @param gain Master gain, Q15.
+     */
+    void setMasterGain(uint16_t gain) {
+        masterGain = gain;
+    }
+
+    /**
+     * Stops a voice. A tone or a sequence fades out with the release of its envelope, so it stays playing for
+     * the release time.
+     * @param voice Voice handle.
+     */
+    void stop(AudioVoice voice);
+
+    /**
+     * Stops every voice at once, tones included.
+     */
+    void stopAll();
+
+    /**
+     * Checks if a voice is still playing.
+     * @param voice Voice handle.
+     * @return true until its sound ends or is stopped or stolen.
+     */
+    bool isPlaying(AudioVoice voice) const;
+
+    uint8_t getActiveCount() const;
+
+    /**
+     * Mixes the next frames of the playing voices. Voices ending inside the block are released, the rest of
+     * the block is silence when no voice is playing.
+     * @param out Output interleaved stereo samples, 2 * frames values.
+     * @param frames Number of frames, at most MAX_BLOCK_FRAMES.
+     */
+    void mix(int16_t* out, uint32_t frames);
+
+    AudioMixerStats getStats() const {
+        return stats;
+    }
+
+    void resetStats() {
+        stats = {};
+    }
+
+private:
+    enum class Source : uint8_t {
+        NONE,
+        SAMPLE,
+        STREAM,
+        TONE
+    };
+
+    struct Voice {
+        Source source = Source::NONE;
+        uint8_t priority = 0;
+        uint16_t gain = 0;
+        uint32_t serial = 0;        // Start order, the handle is built from it
+        uint32_t delayFrames = 0;   // Frames of silence left before the first sample
+        // SAMPLE
+        const CachedSample* sample;
+        uint32_t position;          // Next frame
+        // STREAM
+        fs::FS* fs;
+        char path[MAX_PATH_LENGTH];
+        fs::File file;
+        uint8_t channels;
+        uint32_t remainingFrames;   // Frames of the file not yet read
+        uint16_t blockBytes;        // IMA ADPCM block size, 0 for PCM
+        uint8_t block[MAX_ADPCM_BLOCK_BYTES];
+        int16_t buffer[STREAM_BUFFER_FRAMES * 2];
+        uint32_t bufferFrames;
+        uint32_t bufferPosition;
+        // TONE
+        ToneSynth synth;
+    };
+
+    Voice voices[MAX_VOICES];
+    uint32_t nextSerial = 1;
+    uint16_t masterGain = AUDIO_GAIN_UNITY;
+    AudioMixerStats stats = {};
+
+    Voice* allocate(uint8_t priority);
+    AudioVoice start(Voice& voice, Source source, uint8_t priority, uint16_t gain);
+    Voice* find(AudioVoice voice);
+    const Voice* find(AudioVoice voice) const;
+    void release(Voice& voice);
+    bool openStream(Voice& voice);
+    bool fillStream(Voice& voice);
+    uint32_t mixSample(Voice& voice, int32_t* accumulator, uint32_t frames, int32_t gain);
+    uint32_t mixStream(Voice& voice, int32_t* accumulator, uint32_t frames, int32_t gain);
+};
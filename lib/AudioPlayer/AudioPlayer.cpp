@@ -1,160 +1,607 @@
 #include <AudioPlayer.hpp>
 
-static float sinTable[256];
-static bool sinTableInitialized = false;
+namespace {
+    constexpr uint32_t kPollPeriodMs = 5;   // Audio loop period when the I2S driver gives no DMA events
+    constexpr int64_t kDmaBufferUs = (int64_t)AudioPlayer::DMA_BUFFER_FRAMES * 1000000 / AudioMixer::SAMPLE_RATE;
+    constexpr int64_t kTimelineJumpUs = 1000;   // Beyond this error the output timeline restarts from the DMA event
+    constexpr int64_t kLateCueUs = 100;         // A cue starting later than this missed its time
 
-void AudioPlayer::generateTone() {
-    if (!sinTableInitialized) {
-        for (int i = 0; i < 256; i++) {
-            sinTable[i] = sinf(i * 2.0f * PI / 256.0f);
+    bool isWavFile(const char* filename) {
+        size_t length = strlen(filename);
+        return length >= 4 && strcasecmp(filename + length - 4, ".wav") == 0;
+    }
+}
+
+void AudioPlayer::begin(int bclk, int lrc, int dout) {
+    // Reinstall the driver of the audio library with an event queue, so the DMA buffer events pace the audio loop
+    // task, and with shorter DMA buffers, so the events come often and the mixer output is not queued far ahead
+    i2s_driver_uninstall(m_i2s_port);
+    i2s_config_t config = {};
+    config.mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_TX);
+    config.sample_rate = AudioMixer::SAMPLE_RATE;
+    config.bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT;
+    config.channel_format = I2S_CHANNEL_FMT_RIGHT_LEFT;
+    config.communication_format = I2S_COMM_FORMAT_STAND_I2S;
+    config.intr_alloc_flags = ESP_INTR_FLAG_LEVEL1;
+    config.dma_buf_count = DMA_BUFFER_COUNT;
+    config.dma_buf_len = DMA_BUFFER_FRAMES;
+    config.use_apll = false;
+    config.tx_desc_auto_clear = true;   // Send silence, not the last buffer again, when the samples run out
+    config.fixed_mclk = 0;
+    if (i2s_driver_install(m_i2s_port, &config, I2S_EVENT_QUEUE_SIZE, &m_i2sEvents) != ESP_OK) {
+        Serial.println("Audio: I2S driver install failed, the audio loop polls");
+        m_i2sEvents = nullptr;
+    }
+    m_mixerOwnsOutput = true;
+
+    audio.setPinout(bclk, lrc, dout);
+    audio.setVolume(AUDIO_MAX_VOLUME); // Set default volume to maximum
+}
+
+AudioVoice AudioPlayer::post(Command& command, bool newVoice) {
+    portENTER_CRITICAL(&m_producerMux);
+    if (newVoice) {
+        m_nextVoice++;
+        if (m_nextVoice == AUDIO_VOICE_NONE) {
+            m_nextVoice++;
         }
-        sinTableInitialized = true;
+        command.voice = m_nextVoice;
+    }
+    bool posted = m_commands.push(command);
+    if (posted && newVoice) {
+        m_lastPostedVoice.store(command.voice, std::memory_order_release);
+    }
+    portEXIT_CRITICAL(&m_producerMux);
+
+    if (!posted) {
+        portENTER_CRITICAL(&m_statsMux);
+        m_stats.droppedCommands++;
+        portEXIT_CRITICAL(&m_statsMux);
+        return AUDIO_VOICE_NONE;
     }
+    return newVoice ? command.voice : AUDIO_VOICE_NONE;
+}
 
-    size_t bytes_written;
-    int16_t samples[1024]; // 512 stereo samples (~11.6ms at 44.1kHz)
-    
-    // Map volume 0-21 to amplitude (approx 0-30000)
-    int amplitude = (m_volume * 30000) / AUDIO_MAX_VOLUME;
-    
-    float phaseIncrement = 256.0f * m_toneFreq / 44100.0f;
+void AudioPlayer::recordCall(int64_t startUs) {
+    uint32_t durationUs = (uint32_t)(esp_timer_get_time() - startUs);
+    portENTER_CRITICAL(&m_statsMux);
+    m_stats.calls++;
+    m_stats.sumCallUs += durationUs;
+    m_stats.maxCallUs = max(m_stats.maxCallUs, durationUs);
+    portEXIT_CRITICAL(&m_statsMux);
+}
+
+void AudioPlayer::addPendingStart(int64_t requestUs, bool cached) {
+    if (m_pendingStartCount < MAX_PENDING_STARTS) {
+        m_pendingStarts[m_pendingStartCount++] = {requestUs, cached};
+    }
+}
+
+void AudioPlayer::recordLatency(const PendingStart& start, int64_t nowUs) {
+    uint32_t latencyUs = (uint32_t)(nowUs - start.requestUs);
+    portENTER_CRITICAL(&m_statsMux);
+    if (start.cached) {
+        m_stats.cachedPlays++;
+        m_stats.sumCachedLatencyUs += latencyUs;
+        m_stats.maxCachedLatencyUs = max(m_stats.maxCachedLatencyUs, latencyUs);
+    } else {
+        m_stats.streamedPlays++;
+        m_stats.sumStreamedLatencyUs += latencyUs;
+        m_stats.maxStreamedLatencyUs = max(m_stats.maxStreamedLatencyUs, latencyUs);
+    }
+    portEXIT_CRITICAL(&m_statsMux);
+}
 
-    for (int i = 0; i < 512; i++) {
-        int16_t sample = (int16_t)(sinTable[(int)m_tonePhase & 0xFF] * amplitude);
-        samples[i * 2] = sample;
-        samples[i * 2 + 1] = sample;
-        
-        m_tonePhase += phaseIncrement;
-        while (m_tonePhase >= 256.0f) m_tonePhase -= 256.0f;
+bool AudioPlayer::preload(const char* filename) {
+    if (!m_cache.load(SPIFFS, filename, AUDIO_MAX_CACHED_FILE_BYTES)) {
+        return false;
     }
-    
-    // Write to I2S with a small timeout to avoid blocking too long if buffer is full
-    i2s_write(m_i2s_port, samples, sizeof(samples), &bytes_written, 10);
+    portENTER_CRITICAL(&m_statsMux);
+    m_stats.cachedFiles = m_cache.getCount();
+    m_stats.cacheBytes = m_cache.getBytes();
+    m_stats.cacheFileBytes = m_cache.getFileBytes();
+    portEXIT_CRITICAL(&m_statsMux);
+    return true;
+}
+
+AudioStats AudioPlayer::getStats() {
+    portENTER_CRITICAL(&m_statsMux);
+    AudioStats stats = m_stats;
+    portEXIT_CRITICAL(&m_statsMux);
+    return stats;
+}
+
+AudioMixerStats AudioPlayer::getMixerStats() {
+    portENTER_CRITICAL(&m_statsMux);
+    AudioMixerStats stats = m_mixerStats;
+    portEXIT_CRITICAL(&m_statsMux);
+    return stats;
+}
+
+void AudioPlayer::resetStats() {
+    Command command = {};
+    command.type = CommandType::RESET_STATS;
+    post(command, false);
 }
 
 bool AudioPlayer::isPlaying() {
-    bool currentlyRunning = false;
-    bool isPlayingNow = false;
+    // A sound posted and not yet started plays too
+    return m_lastPostedVoice.load(std::memory_order_acquire) != m_lastHandledVoice.load(std::memory_order_acquire) ||
+           m_playing.load(std::memory_order_acquire);
+}
 
-    if (xSemaphoreTake(_mutex, portMAX_DELAY)) {
-        currentlyRunning = audio.isRunning();
-        if (currentlyRunning || m_tonePlaying) {
-            isPlayingLatched = true;
-            lastPlaybackActivityMs = millis();
+bool AudioPlayer::isPlaying(AudioVoice voice) {
+    if (voice == AUDIO_VOICE_NONE) {
+        return false;
+    }
+    // Not yet run by the audio loop task, the voices are numbered in posting order
+    if ((int32_t)(voice - m_lastHandledVoice.load(std::memory_order_acquire)) > 0) {
+        return true;
+    }
+    for (const std::atomic<AudioVoice>& playingVoice : m_playingVoices) {
+        if (playingVoice.load(std::memory_order_acquire) == voice) {
+            return true;
         }
+    }
+    return m_decoderVoice.load(std::memory_order_acquire) == voice;
+}
+
+void AudioPlayer::setVolume(uint8_t volume) {
+    int64_t startUs = esp_timer_get_time();
+    if (volume > AUDIO_MAX_VOLUME) volume = AUDIO_MAX_VOLUME;
+    Command command = {};
+    command.type = CommandType::VOLUME;
+    command.value = volume;
+    post(command, false);
+    recordCall(startUs);
+}
+
+AudioVoice AudioPlayer::play(const char* filename, uint8_t priority, uint16_t gain) {
+    return postPlay(filename, 0, priority, gain);
+}
+
+AudioVoice AudioPlayer::playAt(int64_t startUs, const char* filename, uint8_t priority, uint16_t gain) {
+    return postPlay(filename, startUs, priority, gain);
+}
 
-        isPlayingNow = hasPendingPlayback || isPlayingLatched || currentlyRunning || m_tonePlaying;
-        xSemaphoreGive(_mutex);
+AudioVoice AudioPlayer::postPlay(const char* filename, int64_t startUs, uint8_t priority, uint16_t gain) {
+    int64_t callUs = esp_timer_get_time();
+    // SPIFFS paths are shorter than the mixer ones
+    if (filename == nullptr || strlen(filename) == 0 || strlen(filename) >= AudioMixer::MAX_PATH_LENGTH) {
+        return AUDIO_VOICE_NONE;
     }
 
-    return isPlayingNow;
-}    
+    Command command = {};
+    command.type = CommandType::PLAY;
+    command.priority = priority;
+    command.gain = gain;
+    command.requestUs = callUs;
+    command.startUs = startUs;
+    strcpy(command.path, filename);
+    AudioVoice voice = post(command, true);
+    recordCall(callUs);
+    return voice;
+}
 
-void AudioPlayer::setVolume(uint8_t volume) { 
-    volume = volume > 0 ? volume : 0; // Ensure volume is not negative
-    if (volume > AUDIO_MAX_VOLUME) volume = AUDIO_MAX_VOLUME;
-    audio.setVolume(volume); 
-    m_volume = volume;
+AudioVoice AudioPlayer::playTone(uint16_t frequency, uint32_t durationMs) {
+    int64_t startUs = esp_timer_get_time();
+    Command command = {};
+    command.type = CommandType::TONE;
+    command.frequency = frequency;
+    command.value = durationMs;
+    command.requestUs = startUs;
+    AudioVoice voice = post(command, true);
+    recordCall(startUs);
+    return voice;
+}
+
+AudioVoice AudioPlayer::playSequence(const ToneNote* notes, uint8_t count, ToneWaveform waveform,
+                                     const ToneEnvelope& envelope, uint8_t priority, uint16_t gain) {
+    return postSequence(notes, count, 0, waveform, envelope, priority, gain);
+}
+
+AudioVoice AudioPlayer::playSequenceAt(int64_t startUs, const ToneNote* notes, uint8_t count, ToneWaveform waveform,
+                                       const ToneEnvelope& envelope, uint8_t priority, uint16_t gain) {
+    return postSequence(notes, count, startUs, waveform, envelope, priority, gain);
 }
 
-void AudioPlayer::play(const char* filename) {
-    if (filename == nullptr || strlen(filename) == 0) {
+AudioVoice AudioPlayer::postSequence(const ToneNote* notes, uint8_t count, int64_t startUs, ToneWaveform waveform,
+                                     const ToneEnvelope& envelope, uint8_t priority, uint16_t gain) {
+    int64_t callUs = esp_timer_get_time();
+    if (notes == nullptr || count == 0) {
+        return AUDIO_VOICE_NONE;
+    }
+    Command command = {};
+    command.type = CommandType::SEQUENCE;
+    command.priority = priority;
+    command.gain = gain;
+    command.value = count;
+    command.requestUs = callUs;
+    command.startUs = startUs;
+    command.notes = notes;
+    command.waveform = waveform;
+    command.envelope = envelope;
+    AudioVoice voice = post(command, true);
+    recordCall(callUs);
+    return voice;
+}
+
+void AudioPlayer::markShown(AudioVoice voice, int64_t shownUs) {
+    Command command = {};
+    command.type = CommandType::CUE_SHOWN;
+    command.voice = voice;
+    command.requestUs = shownUs;
+    post(command, false);
+}
+
+void AudioPlayer::stop() {
+    int64_t startUs = esp_timer_get_time();
+    Command command = {};
+    command.type = CommandType::STOP_ALL;
+    post(command, false);
+    recordCall(startUs);
+}
+
+void AudioPlayer::stop(AudioVoice voice) {
+    int64_t startUs = esp_timer_get_time();
+    Command command = {};
+    command.type = CommandType::STOP;
+    command.voice = voice;
+    post(command, false);
+    recordCall(startUs);
+}
+
+void AudioPlayer::trackVoice(AudioVoice voice, AudioVoice mixerVoice) {
+    // The voices stolen by the new one are released first, so there is always a free entry
+    publishVoices();
+    for (uint8_t i = 0; i < AudioMixer::MAX_VOICES; i++) {
+        if (m_mixerVoices[i] == AUDIO_VOICE_NONE) {
+            m_mixerVoices[i] = mixerVoice;
+            m_playingVoices[i].store(voice, std::memory_order_release);
+            return;
+        }
+    }
+}
+
+void AudioPlayer::publishVoices() {
+    for (uint8_t i = 0; i < AudioMixer::MAX_VOICES; i++) {
+        if (m_mixerVoices[i] != AUDIO_VOICE_NONE && !m_mixer.isPlaying(m_mixerVoices[i])) {
+            m_mixerVoices[i] = AUDIO_VOICE_NONE;
+            m_playingVoices[i].store(AUDIO_VOICE_NONE, std::memory_order_release);
+        }
+    }
+}
+
+void AudioPlayer::stopDecoder() {
+    m_measureStreamedLatency = false;
+    m_decoderVoice.store(AUDIO_VOICE_NONE, std::memory_order_release);
+    if (audio.isRunning()) {
+        audio.stopSong();
+        // Drop the decoded audio still queued, the mixer output starts right away
+        i2s_zero_dma_buffer(m_i2s_port);
+        m_queuedFrames = 0;
+    }
+}
+
+void AudioPlayer::stopVoice(AudioVoice voice) {
+    if (voice != AUDIO_VOICE_NONE && voice == m_decoderVoice.load(std::memory_order_relaxed)) {
+        stopDecoder();
         return;
     }
+    for (uint8_t i = 0; i < AudioMixer::MAX_VOICES; i++) {
+        if (m_mixerVoices[i] != AUDIO_VOICE_NONE && m_playingVoices[i].load(std::memory_order_relaxed) == voice) {
+            m_mixer.stop(m_mixerVoices[i]);
+        }
+    }
+    publishVoices();
+}
 
-    if (xSemaphoreTake(_mutex, portMAX_DELAY)) {
-        newFilenameToPlay = filename; // Set the pending filename to play. The audio loop will handle starting playback.
-        hasPendingPlayback = true;
-        isPlayingLatched = true;
-        lastPlaybackActivityMs = millis();
-        xSemaphoreGive(_mutex);
+void AudioPlayer::updateTimeline(int64_t eventUs) {
+    // The DMA starts a buffer queued earlier: the first frame not yet started plays right after it
+    uint64_t frame = m_writtenFrames - m_queuedFrames;
+    int64_t frameUs = eventUs + kDmaBufferUs;
+    int64_t errorUs = frameUs - frameTimeUs(frame);
+
+    // The task wakes a little after the DMA interrupt, never before: the earliest estimate is the best one. A
+    // later one is followed slowly, for the drift between the I2S and the esp_timer clocks, unless the output
+    // stopped or restarted meanwhile.
+    if (m_anchorUs == 0 || errorUs < 0 || errorUs > kTimelineJumpUs) {
+        m_anchorUs = frameUs;
+    } else {
+        m_anchorUs = frameUs - errorUs + errorUs / 16;
     }
+    m_anchorFrame = frame;
 }
 
-void AudioPlayer::playTone(uint16_t frequency, uint32_t durationMs) {
-    if (xSemaphoreTake(_mutex, portMAX_DELAY)) {
-        if (audio.isRunning()) {
-            audio.stopSong();
-        }
-        newFilenameToPlay = ""; // Cancel any pending file
-        hasPendingPlayback = false;
-        
-        if (!m_tonePlaying) m_tonePhase = 0.0f; // Reset phase if starting new tone sequence
-        m_toneFreq = frequency;
-        m_toneEndMs = millis() + durationMs;
-        m_tonePlaying = true;
+int64_t AudioPlayer::frameTimeUs(uint64_t frame) const {
+    return m_anchorUs + ((int64_t)(frame - m_anchorFrame) * 1000000) / (int64_t)AudioMixer::SAMPLE_RATE;
+}
+
+void AudioPlayer::scheduleStart(const Command& command, AudioVoice mixerVoice) {
+    // The voice is mixed from the next block on, delayed to the frame playing at the cue time. Without DMA events
+    // the output timeline is unknown and the cue starts right away.
+    uint32_t delayFrames = 0;
+    int64_t audioUs = command.requestUs;
+    if (m_i2sEvents != nullptr && m_anchorUs != 0) {
+        // The rest of the last block mixed is queued first
+        uint64_t nextFrame = m_writtenFrames + (m_blockFrames - m_blockWrittenFrames);
+        int64_t nextUs = frameTimeUs(nextFrame);
+        if (command.startUs > nextUs) {
+            delayFrames = (uint32_t)(((command.startUs - nextUs) * AudioMixer::SAMPLE_RATE + 500000) / 1000000);
+            m_mixer.delayStart(mixerVoice, delayFrames);
+        }
+        audioUs = frameTimeUs(nextFrame + delayFrames);
+    }
+    m_cueStarts[m_nextCueStart] = {command.voice, audioUs};
+    m_nextCueStart = (m_nextCueStart + 1) % MAX_CUE_STARTS;
+
+    int64_t lateUs = audioUs - command.startUs;
+    portENTER_CRITICAL(&m_statsMux);
+    m_stats.cues++;
+    if (lateUs > kLateCueUs) {
+        m_stats.lateCues++;
+        m_stats.maxCueLateUs = max(m_stats.maxCueLateUs, (uint32_t)lateUs);
+    }
+    portEXIT_CRITICAL(&m_statsMux);
+}
+
+void AudioPlayer::recordShown(AudioVoice voice, int64_t shownUs) {
+    for (const CueStart& start : m_cueStarts) {
+        if (start.voice == voice && voice != AUDIO_VOICE_NONE) {
+            int32_t skewUs = (int32_t)(start.audioUs - shownUs);
+            portENTER_CRITICAL(&m_statsMux);
+            m_stats.shownCues++;
+            m_stats.sumAvSkewUs += skewUs;
+            if (abs(skewUs) > abs(m_stats.maxAvSkewUs)) {
+                m_stats.maxAvSkewUs = skewUs;
+            }
+            portEXIT_CRITICAL(&m_statsMux);
+            return;
+        }
+    }
+}
+
+void AudioPlayer::startVoice(const Command& command) {
+    stopDecoder();
+    const CachedSample* sample = m_cache.find(command.path);
+    AudioVoice mixerVoice = sample != nullptr
+        ? m_mixer.playSample(*sample, command.priority, command.gain)
+        : m_mixer.playStream(SPIFFS, command.path, command.priority, command.gain);
+    if (mixerVoice != AUDIO_VOICE_NONE) {
+        trackVoice(command.voice, mixerVoice);
+        if (command.startUs != 0) {
+            scheduleStart(command, mixerVoice);
+        } else {
+            addPendingStart(command.requestUs, sample != nullptr);
+        }
+    }
+}
+
+void AudioPlayer::startTone(const Command& command) {
+    stopDecoder();
+
+    // Retune the tone still playing, so a sweep of short tones is continuous. The new voice takes its place.
+    uint32_t durationFrames = (uint32_t)((uint64_t)command.value * AudioMixer::SAMPLE_RATE / 1000);
+    for (uint8_t i = 0; i < AudioMixer::MAX_VOICES; i++) {
+        if (m_toneVoice != AUDIO_VOICE_NONE && m_playingVoices[i].load(std::memory_order_relaxed) == m_toneVoice &&
+            m_mixer.setTone(m_mixerVoices[i], command.frequency, durationFrames)) {
+            m_playingVoices[i].store(command.voice, std::memory_order_release);
+            m_toneVoice = command.voice;
+            return;
+        }
+    }
+
+    AudioVoice mixerVoice = m_mixer.playTone(command.frequency, durationFrames, AUDIO_PRIORITY_EFFECT);
+    if (mixerVoice != AUDIO_VOICE_NONE) {
+        trackVoice(command.voice, mixerVoice);
+        m_toneVoice = command.voice;
+    }
+}
+
+void AudioPlayer::startSequence(const Command& command) {
+    stopDecoder();
+    AudioVoice mixerVoice = m_mixer.playSequence(command.notes, (uint8_t)command.value, command.waveform,
+        command.envelope, command.priority, command.gain);
+    if (mixerVoice != AUDIO_VOICE_NONE) {
+        trackVoice(command.voice, mixerVoice);
+        if (command.startUs != 0) {
+            scheduleStart(command, mixerVoice);
+        } else {
+            addPendingStart(command.requestUs, true);
+        }
+    }
+}
+
+void AudioPlayer::startDecoder(const Command& command) {
+    // The decoder plays alone: drop the mixer voices and the mixed audio not yet queued
+    m_mixer.stopAll();
+    publishVoices();
+    m_toneVoice = AUDIO_VOICE_NONE;
+    m_blockWrittenFrames = m_blockFrames;
+    m_pendingStartCount = 0;
+    m_blockStartCount = 0;
+    m_mixerOwnsOutput = false;
+    m_outputRunning = false;
+
+    if (audio.isRunning()) {
+        audio.stopSong();
+        audio.loop();
+    }
+
+    // Start to play the next file
+    if (!audio.connecttoFS(SPIFFS, command.path)) {
+        Serial.printf("Failed to play audio file: %s\n", command.path);
+        isPlayingLatched = false;
+        m_decoderVoice.store(AUDIO_VOICE_NONE, std::memory_order_release);
+        portENTER_CRITICAL(&m_statsMux);
+        m_stats.failedPlays++;
+        portEXIT_CRITICAL(&m_statsMux);
+    } else {
+        m_decoderVoice.store(command.voice, std::memory_order_release);
+        m_playRequestUs = command.requestUs;
+        m_measureStreamedLatency = true;
+    }
+}
+
+void AudioPlayer::runCommand(const Command& command) {
+    switch (command.type) {
+        case CommandType::PLAY:
+            if (isWavFile(command.path)) {
+                startVoice(command);
+            } else {
+                startDecoder(command);
+            }
+            break;
+        case CommandType::TONE:
+            startTone(command);
+            break;
+        case CommandType::SEQUENCE:
+            startSequence(command);
+            break;
+        case CommandType::STOP:
+            stopVoice(command.voice);
+            break;
+        case CommandType::STOP_ALL:
+            stopDecoder();
+            m_mixer.stopAll();
+            publishVoices();
+            m_toneVoice = AUDIO_VOICE_NONE;
+            isPlayingLatched = false;
+            break;
+        case CommandType::CUE_SHOWN:
+            recordShown(command.voice, command.requestUs);
+            break;
+        case CommandType::VOLUME:
+            audio.setVolume(command.value);
+            m_mixer.setMasterGain((uint16_t)((command.value * AUDIO_GAIN_UNITY) / AUDIO_MAX_VOLUME));
+            break;
+        case CommandType::RESET_STATS: {
+            portENTER_CRITICAL(&m_statsMux);
+            AudioStats cleared = {};
+            cleared.cachedFiles = m_stats.cachedFiles;
+            cleared.cacheBytes = m_stats.cacheBytes;
+            cleared.cacheFileBytes = m_stats.cacheFileBytes;
+            m_stats = cleared;
+            portEXIT_CRITICAL(&m_statsMux);
+            m_mixer.resetStats();
+            break;
+        }
+    }
+
+    if (command.type == CommandType::PLAY || command.type == CommandType::TONE || command.type == CommandType::SEQUENCE) {
         isPlayingLatched = true;
         lastPlaybackActivityMs = millis();
-        
-        // Ensure sample rate is set for tone generation
-        i2s_set_sample_rates(m_i2s_port, 44100);
-        
-        xSemaphoreGive(_mutex);
+        // After the voice tables, so isPlaying(voice) never misses the new voice
+        m_lastHandledVoice.store(command.voice, std::memory_order_release);
     }
 }
 
-void AudioPlayer::stop() {
-    if (xSemaphoreTake(_mutex, portMAX_DELAY)) {
-        if (audio.isRunning()) {
-            audio.stopSong();
+void AudioPlayer::handleI2sEvent(const i2s_event_t& event) {
+    if (event.type == I2S_EVENT_TX_Q_OVF) {
+        // The DMA found every buffer empty: an underrun if the mixer had more to play
+        if (m_outputRunning && (m_mixer.getActiveCount() > 0 || m_blockWrittenFrames < m_blockFrames)) {
+            portENTER_CRITICAL(&m_statsMux);
+            m_stats.underruns++;
+            portEXIT_CRITICAL(&m_statsMux);
         }
-        newFilenameToPlay = ""; // Clear any pending filename
-        hasPendingPlayback = false;
-        m_tonePlaying = false; // Stop tone if playing
-        isPlayingLatched = false;
-        xSemaphoreGive(_mutex);
+        m_queuedFrames = 0;
+    } else if (event.type == I2S_EVENT_TX_DONE) {
+        m_queuedFrames = m_queuedFrames > DMA_BUFFER_FRAMES ? m_queuedFrames - DMA_BUFFER_FRAMES : 0;
+        updateTimeline(esp_timer_get_time());
     }
 }
 
-void AudioPlayer::audioLoop() {
-    while(true) {
-        if (xSemaphoreTake(_mutex, portMAX_DELAY)) {
-            if (hasPendingPlayback && newFilenameToPlay.length() > 0) {
-                m_tonePlaying = false; // Stop tone if new file requested
-                String filenameToPlay = newFilenameToPlay;
-
-                if (audio.isRunning()) {
-                    audio.stopSong();
-                    audio.loop();
-                }
-
-                // Start to play the next file
-                if (!audio.connecttoFS(SPIFFS, filenameToPlay.c_str())) {
-                    Serial.println("Failed to play audio file: " + filenameToPlay);
-                    hasPendingPlayback = false;
-                    isPlayingLatched = false;
-                } else {
-                    hasPendingPlayback = false;
-                    isPlayingLatched = true;
-                    lastPlaybackActivityMs = millis();
-                }
-                newFilenameToPlay = ""; // Clear the pending filename after starting playback
+void AudioPlayer::pumpMixer() {
+    // Without DMA events the queued frames are unknown, write what the DMA buffers accept
+    if (m_i2sEvents == nullptr) {
+        m_queuedFrames = 0;
+    }
+
+    // Keep at most OUTPUT_LEAD_FRAMES queued, so the sounds started meanwhile are mixed soon
+    while (m_queuedFrames < OUTPUT_LEAD_FRAMES) {
+        if (m_blockWrittenFrames == m_blockFrames) {
+            if (m_mixer.getActiveCount() == 0) {
+                m_outputRunning = false;
+                return;
+            }
+            if (!m_mixerOwnsOutput) {
+                i2s_set_sample_rates(m_i2s_port, AudioMixer::SAMPLE_RATE);
+                m_mixerOwnsOutput = true;
             }
+            m_mixer.mix(m_block, AudioMixer::MAX_BLOCK_FRAMES);
+            m_blockFrames = AudioMixer::MAX_BLOCK_FRAMES;
+            m_blockWrittenFrames = 0;
+            memcpy(m_blockStarts, m_pendingStarts, m_pendingStartCount * sizeof(PendingStart));
+            m_blockStartCount = m_pendingStartCount;
+            m_pendingStartCount = 0;
+        }
 
-            if (m_tonePlaying) {
-                if (millis() >= m_toneEndMs) {
-                    m_tonePlaying = false;
-                    // Write silence to clear buffer
-                    size_t bytes_written;
-                    int16_t zero_samples[128] = {0};
-                    i2s_write(m_i2s_port, zero_samples, sizeof(zero_samples), &bytes_written, 0);
-                } else {
-                    generateTone();
-                }
-            } else {
-                audio.loop();
+        // Queue only what the DMA buffers accept, the rest is written at the next DMA event
+        size_t bytesWritten = 0;
+        uint32_t frames = m_blockFrames - m_blockWrittenFrames;
+        i2s_write(m_i2s_port, m_block + m_blockWrittenFrames * 2, frames * 2 * sizeof(int16_t), &bytesWritten, 0);
+        uint32_t framesWritten = bytesWritten / (2 * sizeof(int16_t));
+        if (framesWritten > 0 && m_blockWrittenFrames == 0) {
+            // The sounds started since the previous block begin at the first frame of this one
+            for (uint8_t i = 0; i < m_blockStartCount; i++) {
+                recordLatency(m_blockStarts[i], esp_timer_get_time());
             }
+            m_blockStartCount = 0;
+        }
+        m_blockWrittenFrames += framesWritten;
+        m_queuedFrames += framesWritten;
+        m_writtenFrames += framesWritten;
+        m_outputRunning = m_outputRunning || framesWritten > 0;
+        if (framesWritten < frames) {
+            return;
+        }
+    }
+}
 
-            bool running = audio.isRunning();
-            if (running || m_tonePlaying) {
-                isPlayingLatched = true;
-                lastPlaybackActivityMs = millis();
-            } else if (isPlayingLatched && !hasPendingPlayback && (millis() - lastPlaybackActivityMs > 200)) {
-                isPlayingLatched = false;
+void AudioPlayer::audioLoop() {
+    while(true) {
+        // Sleep until the DMA has sent a buffer. A command posted meanwhile waits at most one buffer, 5.8 ms,
+        // while the mixer output runs OUTPUT_LEAD_FRAMES ahead anyway.
+        i2s_event_t event;
+        if (m_i2sEvents == nullptr) {
+            delay(kPollPeriodMs);
+        } else if (xQueueReceive(m_i2sEvents, &event, portMAX_DELAY) == pdTRUE) {
+            do {
+                handleI2sEvent(event);
+            } while (xQueueReceive(m_i2sEvents, &event, 0) == pdTRUE);
+        }
+
+        Command command;
+        while (m_commands.pop(command)) {
+            runCommand(command);
+        }
+
+        if (audio.isRunning()) {
+            audio.loop();
+            if (m_measureStreamedLatency) {
+                recordLatency({m_playRequestUs, false}, esp_timer_get_time());
+                m_measureStreamedLatency = false;
             }
-            xSemaphoreGive(_mutex);
+            if (!audio.isRunning()) {
+                m_decoderVoice.store(AUDIO_VOICE_NONE, std::memory_order_release);
+            }
+        } else {
+            pumpMixer();
+        }
+        publishVoices();
+
+        bool running = audio.isRunning() || m_mixer.getActiveCount() > 0;
+        if (running) {
+            isPlayingLatched = true;
+            lastPlaybackActivityMs = millis();
+        } else if (isPlayingLatched && (millis() - lastPlaybackActivityMs > 200)) {
+            isPlayingLatched = false;
         }
-        delay(5); // Yield to other tasks. The audio library needs to be called frequently.
+        m_playing.store(running || isPlayingLatched, std::memory_order_release);
+
+        portENTER_CRITICAL(&m_statsMux);
+        m_mixerStats = m_mixer.getStats();
+        portEXIT_CRITICAL(&m_statsMux);
     }
 
 }
@@ -3,9 +3,14 @@
 #include <Arduino.h>
 #include <SPIFFS.h>
 #include "Audio.h"
-#include <freertos/semphr.h>
+#include <freertos/queue.h>
 #include <driver/i2s.h>
+#include <esp_timer.h>
 #include <math.h>
+#include "SampleCache.hpp"
+#include "AudioMixer.hpp"
+#include "SpscQueue.hpp"
+#include <atomic>
 
 #define AUDIO_MAX_VOLUME 21
 
@@ -21,25 +26,203 @@
 #define AUDIO_FILE_START_BEEP_LONG  "/start-beep-long.wav"
 #define AUDIO_FILE_DONT_TOUCH       "/ask-before-touch.wav"
 
+#define AUDIO_MAX_CACHED_FILE_BYTES (128 * 1024)   // Largest sound effect preloaded in PSRAM, about 1.5 s of mono audio
+
+/**
+ * Playback statistics, to compare the start latency of the cached and the streamed files and to check that the
+ * callers are never held up by the audio task
+ */
+struct AudioStats {
+    uint8_t cachedFiles;            // Files preloaded in PSRAM
+    uint32_t cacheBytes;            // PSRAM used by the preloaded files
+    uint32_t cacheFileBytes;        // Flash read to preload them, less than cacheBytes for IMA ADPCM files
+    uint32_t cachedPlays;           // Plays served from memory: cached files and synthesized sequences
+    uint32_t maxCachedLatencyUs;    // Longest time from play() to the first samples queued to I2S, cached files
+    uint64_t sumCachedLatencyUs;
+    uint32_t streamedPlays;         // Plays streamed from SPIFFS, by the mixer (WAV files) or the decoder
+    uint32_t maxStreamedLatencyUs;  // Longest time from play() to the first samples queued (to the end of the first
+                                    // decoder step for the decoder), streamed files
+    uint64_t sumStreamedLatencyUs;
+    uint32_t failedPlays;           // Files that could not be opened by the decoder
+    uint32_t underruns;             // DMA buffer-empty events while the mixer had voices to play
+    uint32_t calls;                 // play, playTone, stop and setVolume calls
+    uint32_t maxCallUs;             // Longest of these calls, from entry to return
+    uint64_t sumCallUs;
+    uint32_t droppedCommands;       // Calls ignored because the command queue was full
+    uint32_t cues;                  // Sounds scheduled at a time by playAt() or playSequenceAt(), not counted above
+    uint32_t lateCues;              // Cues started after their time, scheduled with less than CUE_LEAD_US notice
+    uint32_t maxCueLateUs;
+    uint32_t shownCues;             // Cues whose frame was reported by markShown()
+    int64_t sumAvSkewUs;            // Sound start minus frame shown time, positive when the sound comes later
+    int32_t maxAvSkewUs;            // Largest skew in magnitude, with its sign
+
+    /**
+     * Print the statistics in a human readable format
+     * @param out Where to print the statistics (e.g. Serial)
+     */
+    void printTo(Print& out) const {
+        out.printf("Audio: %u files cached (%lu bytes in PSRAM, %lu read from flash), %lu failed plays, %lu underruns\n",
+            cachedFiles, (unsigned long)cacheBytes, (unsigned long)cacheFileBytes, (unsigned long)failedPlays,
+            (unsigned long)underruns);
+        out.printf("  cached: %lu plays, start latency mean %.0f us, max %lu us\n", (unsigned long)cachedPlays,
+            cachedPlays > 0 ? (float)sumCachedLatencyUs / cachedPlays : 0.0f, (unsigned long)maxCachedLatencyUs);
+        out.printf("  streamed: %lu plays, start latency mean %.0f us, max %lu us\n", (unsigned long)streamedPlays,
+            streamedPlays > 0 ? (float)sumStreamedLatencyUs / streamedPlays : 0.0f,
+            (unsigned long)maxStreamedLatencyUs);
+        out.printf("  calls: %lu, duration mean %.1f us, max %lu us, %lu dropped (queue full)\n", (unsigned long)calls,
+            calls > 0 ? (float)sumCallUs / calls : 0.0f, (unsigned long)maxCallUs, (unsigned long)droppedCommands);
+        out.printf("  cues: %lu scheduled, %lu late (max %lu us), A/V skew of %lu shown: mean %+.0f us, max %+ld us\n",
+            (unsigned long)cues, (unsigned long)lateCues, (unsigned long)maxCueLateUs, (unsigned long)shownCues,
+            shownCues > 0 ? (float)sumAvSkewUs / shownCues : 0.0f, (long)maxAvSkewUs);
+    }
+};
+
+/**
+ * AudioPlayer plays the sound effects, the jingles and the tones of the game on an I2S amplifier.
+ *
+ * WAV files and tones are voices of an AudioMixer, so several sounds overlap: a beep does not cut the title
+ * jingle. Short effects preloaded in PSRAM (see preload) are mixed from memory, the other WAV files are streamed
+ * from SPIFFS. The build stores the sound files as IMA ADPCM WAV files, a quarter of the flash space and of the
+ * flash reads of 16-bit PCM (see tools/adpcm_encoder): the cache decodes them once at boot, the streamed voices a
+ * block at a time. Other formats (e.g. MP3) are played alone by the ESP32-audioI2S decoder: starting one stops the
+ * mixer voices, and starting a voice stops the decoder.
+ *
+ * The audio loop task owns the mixer and the decoder. The other tasks never wait for it: play(), stop() and the
+ * other calls post a command to a lock-free queue and return, and the playback state is read from atomics the
+ * task publishes. The task sleeps until the I2S DMA finishes a buffer, then runs the commands, feeds the decoder
+ * or queues the mixer output at most OUTPUT_LEAD_FRAMES ahead of the playback, so a new sound starts within a
+ * few milliseconds.
+ *
+ * A sound tied to an animation frame is scheduled instead, at the esp_timer time the frame is shown: playAt()
+ * and playSequenceAt() start it at the exact output frame that plays at that time. The DMA events give the time
+ * each buffer starts, which maps the mixer output frames to esp_timer time; the voice starts at the first block
+ * and is delayed to its frame inside the block or a later one. markShown() then reports when the frame was
+ * really shown, and the statistics keep the audio-visual skew.
+ */
 class AudioPlayer {
+    public:
+        static constexpr uint32_t DMA_BUFFER_COUNT = 8;
+        static constexpr uint32_t DMA_BUFFER_FRAMES = 256;     // One DMA event every 5.8 ms at 44.1 kHz
+        static constexpr uint32_t OUTPUT_LEAD_FRAMES = 1024;   // Mixer audio queued to I2S ahead of the playback, 23 ms
+        // Shortest notice for a cue to start on time: the audio queued ahead, the block being mixed and the wait
+        // for the next DMA event, 35 ms
+        static constexpr int64_t CUE_LEAD_US =
+            (int64_t)(OUTPUT_LEAD_FRAMES + 2 * DMA_BUFFER_FRAMES) * 1000000 / AudioMixer::SAMPLE_RATE;
+
     private:
+        enum class CommandType : uint8_t {
+            PLAY,
+            TONE,
+            SEQUENCE,
+            STOP,
+            STOP_ALL,
+            VOLUME,
+            CUE_SHOWN,
+            RESET_STATS
+        };
+
+        struct Command {
+            CommandType type;
+            uint8_t priority;           // PLAY, SEQUENCE
+            uint16_t gain;              // PLAY, SEQUENCE
+            AudioVoice voice;           // PLAY, TONE, SEQUENCE: voice of the new sound; STOP, CUE_SHOWN: voice
+            uint16_t frequency;         // TONE
+            uint32_t value;             // TONE: duration in ms; SEQUENCE: note count; VOLUME: volume
+            int64_t requestUs;          // esp_timer time of the call; CUE_SHOWN: time the frame was shown
+            int64_t startUs;            // PLAY, SEQUENCE: esp_timer time of the first sample, 0 for right away
+            const ToneNote* notes;      // SEQUENCE
+            ToneWaveform waveform;      // SEQUENCE
+            ToneEnvelope envelope;      // SEQUENCE
+            char path[AudioMixer::MAX_PATH_LENGTH];  // PLAY
+        };
+
+        struct PendingStart {
+            int64_t requestUs;          // esp_timer time of the play() call
+            bool cached;
+        };
+
+        /**
+         * Start of a cue, kept until its frame is reported shown
+         */
+        struct CueStart {
+            AudioVoice voice;
+            int64_t audioUs;            // esp_timer time of its first sample
+        };
+
+        static constexpr uint8_t MAX_PENDING_STARTS = 8;
+        static constexpr uint8_t MAX_CUE_STARTS = 8;
+        static constexpr uint32_t COMMAND_QUEUE_SIZE = 16;
+        static constexpr uint8_t I2S_EVENT_QUEUE_SIZE = DMA_BUFFER_COUNT;
+
         Audio audio;
-        String newFilenameToPlay;
-        SemaphoreHandle_t _mutex;
-        bool hasPendingPlayback;
+        i2s_port_t m_i2s_port;
+        QueueHandle_t m_i2sEvents;      // DMA events of the I2S driver, they wake the audio loop task
+
+        // Caller side: the callers are serialized among themselves, never with the audio loop task
+        SpscQueue<Command, COMMAND_QUEUE_SIZE> m_commands;
+        portMUX_TYPE m_producerMux = portMUX_INITIALIZER_UNLOCKED;
+        AudioVoice m_nextVoice;
+
+        // Published by the audio loop task
+        std::atomic<AudioVoice> m_lastPostedVoice;                      // Voice of the last play command posted
+        std::atomic<AudioVoice> m_lastHandledVoice;                     // Voice of the last play command run
+        std::atomic<AudioVoice> m_playingVoices[AudioMixer::MAX_VOICES]; // Voices of the mixer still playing
+        std::atomic<AudioVoice> m_decoderVoice;                         // Voice played by the decoder
+        std::atomic<bool> m_playing;
+
+        AudioStats m_stats;
+        AudioMixerStats m_mixerStats;   // Copy of the mixer statistics, read by the other tasks
+        portMUX_TYPE m_statsMux = portMUX_INITIALIZER_UNLOCKED;
+
+        // Owned by the audio loop task
         bool isPlayingLatched;
         uint32_t lastPlaybackActivityMs;
+        SampleCache m_cache;
+        AudioMixer m_mixer;
+        AudioVoice m_mixerVoices[AudioMixer::MAX_VOICES];   // Mixer handles of m_playingVoices
+        AudioVoice m_toneVoice;
 
-        i2s_port_t m_i2s_port;
-        bool m_tonePlaying;
-        uint16_t m_toneFreq;
-        uint32_t m_toneEndMs;
-        float m_tonePhase;
-        uint8_t m_volume;
+        int16_t m_block[AudioMixer::MAX_BLOCK_FRAMES * 2];  // Last block mixed, stereo
+        uint32_t m_blockFrames;
+        uint32_t m_blockWrittenFrames;  // Frames of m_block already queued to I2S
+        uint32_t m_queuedFrames;        // Frames queued to I2S and not yet started by the DMA, counted from its events
+        uint64_t m_writtenFrames;       // Frames queued to I2S since the start, the index of the next one
+        uint64_t m_anchorFrame;         // Output timeline: output frame m_anchorFrame plays at m_anchorUs
+        int64_t m_anchorUs;             // esp_timer time, 0 until the first DMA event
+        bool m_mixerOwnsOutput;         // The I2S port runs at the mixer sample rate
+        bool m_outputRunning;           // The mixer is queuing a continuous output, empty DMA buffers are an underrun
+
+        PendingStart m_pendingStarts[MAX_PENDING_STARTS];  // Voices started since the last block was mixed
+        uint8_t m_pendingStartCount;
+        PendingStart m_blockStarts[MAX_PENDING_STARTS];    // Voices starting at the first frame of m_block
+        uint8_t m_blockStartCount;
+        int64_t m_playRequestUs;        // esp_timer time of the play() call of the decoder file
+        bool m_measureStreamedLatency;  // The first decoder step of a decoder file is still to come
+        CueStart m_cueStarts[MAX_CUE_STARTS];               // Last cues started, oldest overwritten first
+        uint8_t m_nextCueStart;
 
-        // Internal function to generate a tone. This is called repeatedly in the audio loop
-        // while a tone is active.
-        void generateTone();
+        AudioVoice post(Command& command, bool newVoice);
+        AudioVoice postPlay(const char* filename, int64_t startUs, uint8_t priority, uint16_t gain);
+        AudioVoice postSequence(const ToneNote* notes, uint8_t count, int64_t startUs, ToneWaveform waveform,
+                                const ToneEnvelope& envelope, uint8_t priority, uint16_t gain);
+        void recordCall(int64_t startUs);
+        void addPendingStart(int64_t requestUs, bool cached);
+        void updateTimeline(int64_t eventUs);
+        int64_t frameTimeUs(uint64_t frame) const;
+        void scheduleStart(const Command& command, AudioVoice mixerVoice);
+        void recordShown(AudioVoice voice, int64_t shownUs);
+        void recordLatency(const PendingStart& start, int64_t nowUs);
+        void runCommand(const Command& command);
+        void startVoice(const Command& command);
+        void startTone(const Command& command);
+        void startSequence(const Command& command);
+        void startDecoder(const Command& command);
+        void stopDecoder();
+        void stopVoice(AudioVoice voice);
+        void trackVoice(AudioVoice voice, AudioVoice mixerVoice);
+        void publishVoices();
+        void handleI2sEvent(const i2s_event_t& event);
+        void pumpMixer();
 
     public:
         /**
@@ -48,14 +231,39 @@ class AudioPlayer {
          * @param i2s_port_number The I2S port number to use (0 or 1). Port 1 is recommended to avoid conflicts with other peripherals like RMT (for NeoPixels).
          */
         AudioPlayer(uint8_t i2s_port_number = 0) : audio(false, 0, i2s_port_number), m_i2s_port((i2s_port_t)i2s_port_number) {
-            _mutex = xSemaphoreCreateMutex();
-            newFilenameToPlay = "";
-            hasPendingPlayback = false;
+            m_i2sEvents = nullptr;
+            m_nextVoice = AUDIO_VOICE_NONE;
+            m_lastPostedVoice = AUDIO_VOICE_NONE;
+            m_lastHandledVoice = AUDIO_VOICE_NONE;
+            for (std::atomic<AudioVoice>& voice : m_playingVoices) {
+                voice = AUDIO_VOICE_NONE;
+            }
+            m_decoderVoice = AUDIO_VOICE_NONE;
+            m_playing = false;
+            m_stats = {};
+            m_mixerStats = {};
             isPlayingLatched = false;
             lastPlaybackActivityMs = 0;
-            m_tonePlaying = false;
-            m_tonePhase = 0.0f;
-            m_volume = AUDIO_MAX_VOLUME;
+            for (AudioVoice& voice : m_mixerVoices) {
+                voice = AUDIO_VOICE_NONE;
+            }
+            m_toneVoice = AUDIO_VOICE_NONE;
+            m_blockFrames = 0;
+            m_blockWrittenFrames = 0;
+            m_queuedFrames = 0;
+            m_writtenFrames = 0;
+            m_anchorFrame = 0;
+            m_anchorUs = 0;
+            m_mixerOwnsOutput = false;
+            m_outputRunning = false;
+            m_pendingStartCount = 0;
+            m_blockStartCount = 0;
+            m_playRequestUs = 0;
+            m_measureStreamedLatency = false;
+            for (CueStart& start : m_cueStarts) {
+                start = {AUDIO_VOICE_NONE, 0};
+            }
+            m_nextCueStart = 0;
         }
 
         /**
@@ -65,19 +273,30 @@ class AudioPlayer {
          * @param lrc The GPIO pin number for the I2S word select (LRC).
          * @param dout The GPIO pin number for the I2S data output (DOUT). 
          */
-        void begin(int bclk, int lrc, int dout) {
-            audio.setPinout(bclk, lrc, dout);
-            audio.setVolume(AUDIO_MAX_VOLUME); // Set default volume to maximum
-            m_volume = AUDIO_MAX_VOLUME;
-        }
+        void begin(int bclk, int lrc, int dout);
+
+        /**
+         * Loads a short sound effect into PSRAM, so play() mixes its samples from memory instead of streaming
+         * the file from SPIFFS: the sound starts without opening the file and does not read the flash while
+         * playing. Must be called after SPIFFS is mounted and before the audio loop task is created.
+         * @param filename The path of a 16-bit PCM or IMA ADPCM WAV file within SPIFFS, at most
+         *                 AUDIO_MAX_CACHED_FILE_BYTES of 16-bit samples once decoded.
+         * @return true if the file is cached, false otherwise (it is still played from SPIFFS).
+         */
+        bool preload(const char* filename);
 
         /**
-         * Checks if audio is currently playing. Note that this will return false if the audio has finished playing, 
-         * even if the file is still open. Use this in combination with the audio_info callback to detect when playback 
-         * has actually stopped.
+         * Checks if audio is currently playing: a mixer voice, the decoder, or a sound just requested.
          */ 
         bool isPlaying();
 
+        /**
+         * Checks if a sound started by play() or playTone() is still playing.
+         * @param voice The voice handle.
+         * @return true until the sound ends or is stopped or stolen by a more important one.
+         */
+        bool isPlaying(AudioVoice voice);
+
         /**
          * Sets the playback volume. The volume level can typically range from 0 (mute) to 21 (maximum), 
          * with a default of 10.
@@ -86,20 +305,78 @@ class AudioPlayer {
         void setVolume(uint8_t volume);
 
         /**
-         * Plays an audio file from the SPIFFS filesystem. 
-         * The file must be in a supported format (e.g., WAV, MP3) and located in the SPIFFS directory.
+         * Plays an audio file from the SPIFFS filesystem, over the sounds already playing. The sound starts
+         * with the next DMA buffer, the call does not wait for it.
+         * WAV files must be 16-bit PCM or IMA ADPCM at 44.1 kHz; files loaded with preload() are played from PSRAM. Other
+         * formats (e.g., MP3) are played alone by the decoder.
          * @param filename The path to the audio file within SPIFFS (e.g., "/music/song.mp3"). The leading slash is required.
-         * @return true if the file was successfully opened and playback started, false otherwise (e.g., file not found, unsupported format).
+         * @param priority Voice priority: when every voice is busy, the sound replaces the oldest one of the lowest priority, if not higher than this one.
+         * @param gain Voice gain, Q15 (AUDIO_GAIN_UNITY is 1.0).
+         * @return The voice handle, or AUDIO_VOICE_NONE if the path is too long or the command queue is full.
+         */
+        AudioVoice play(const char* filename, uint8_t priority = AUDIO_PRIORITY_EFFECT, uint16_t gain = AUDIO_GAIN_UNITY);
+
+        /**
+         * Schedules an audio file to start at a given time, e.g. the time the animation frame it goes with is
+         * shown. The first sample plays at that time if it is at least CUE_LEAD_US ahead, otherwise as soon as
+         * possible (a late cue). The voice is taken when the call is handled and stays silent until then, so
+         * schedule a cue at most a few hundred milliseconds ahead. Files played by the decoder start right away.
+         * @param startUs esp_timer time of the first sample.
+         * @param filename The path to the audio file within SPIFFS, as for play().
+         * @param priority Voice priority, as for play().
+         * @param gain Voice gain, Q15.
+         * @return The voice handle, playing from the call, or AUDIO_VOICE_NONE as for play().
          */
-        void play(const char* filename);
+        AudioVoice playAt(int64_t startUs, const char* filename, uint8_t priority = AUDIO_PRIORITY_EFFECT,
+                          uint16_t gain = AUDIO_GAIN_UNITY);
 
         /**
-         * Plays a tone with the specified frequency and duration.
-         * This will stop any currently playing audio file.
+         * Plays a sine tone with the specified frequency and duration, over the sounds already playing. The tone
+         * fades in and out in a few milliseconds, without clicks.
+         * Calling it again while the tone plays changes the tone without restarting its phase.
          * @param frequency The frequency of the tone in Hz.
          * @param durationMs The duration of the tone in milliseconds.
+         * @return The voice handle, or AUDIO_VOICE_NONE if the command queue is full.
+         */
+        AudioVoice playTone(uint16_t frequency, uint32_t durationMs);
+
+        /**
+         * Plays a sequence of synthesized notes over the sounds already playing, e.g. a countdown or a jingle
+         * without a file. Each note rises and falls with the envelope, so the notes start and end without clicks.
+         * @param notes The notes, they must stay valid while playing (e.g. a static const array).
+         * @param count Number of notes.
+         * @param waveform Waveform of the notes.
+         * @param envelope Envelope of each note.
+         * @param priority Voice priority, as for play().
+         * @param gain Voice gain, Q15.
+         * @return The voice handle, or AUDIO_VOICE_NONE if there are no notes or the command queue is full.
+         */
+        AudioVoice playSequence(const ToneNote* notes, uint8_t count, ToneWaveform waveform = ToneWaveform::SINE,
+                                const ToneEnvelope& envelope = TONE_ENVELOPE_DEFAULT,
+                                uint8_t priority = AUDIO_PRIORITY_EFFECT, uint16_t gain = AUDIO_GAIN_UNITY);
+
+        /**
+         * Schedules a sequence of synthesized notes to start at a given time, as playAt() does for a file.
+         * @param startUs esp_timer time of the first sample.
+         * @param notes The notes, they must stay valid while playing (e.g. a static const array).
+         * @param count Number of notes.
+         * @param waveform Waveform of the notes.
+         * @param envelope Envelope of each note.
+         * @param priority Voice priority, as for play().
+         * @param gain Voice gain, Q15.
+         * @return The voice handle, or AUDIO_VOICE_NONE if there are no notes or the command queue is full.
+         */
+        AudioVoice playSequenceAt(int64_t startUs, const ToneNote* notes, uint8_t count,
+                                  ToneWaveform waveform = ToneWaveform::SINE,
+                                  const ToneEnvelope& envelope = TONE_ENVELOPE_DEFAULT,
+                                  uint8_t priority = AUDIO_PRIORITY_EFFECT, uint16_t gain = AUDIO_GAIN_UNITY);
+
+        /**
+         * Reports when the animation frame of a cue was shown, to measure the audio-visual skew.
+         * @param voice The voice handle returned by playAt() or playSequenceAt().
+         * @param shownUs esp_timer time the frame was shown (e.g. right after display.show()).
          */
-        void playTone(uint16_t frequency, uint32_t durationMs);
+        void markShown(AudioVoice voice, int64_t shownUs);
 
         /**
          * Stops any currently playing audio file or tone.
@@ -107,7 +384,30 @@ class AudioPlayer {
         void stop();
 
         /**
-         * This function should be called repeatedly in the loop() function to allow the audio library to process audio data and handle events.
+         * Stops one sound. Tones and note sequences fade out with their envelope release, without a click.
+         * @param voice The voice handle returned by play(), playTone() or playSequence().
+         */
+        void stop(AudioVoice voice);
+
+        /**
+         * Gets a snapshot of the playback statistics.
+         * @return The statistics accumulated since the last reset.
+         */
+        AudioStats getStats();
+
+        /**
+         * Gets a snapshot of the mixer statistics, as of the last block mixed.
+         * @return The statistics accumulated since the last reset.
+         */
+        AudioMixerStats getMixerStats();
+
+        /**
+         * Resets the play counts, the latencies and the mixer statistics. The cache figures are kept.
+         */
+        void resetStats();
+
+        /**
+         * Runs the audio loop task, never returns. The task must have a higher priority than the callers.
          */
         void audioLoop();
 };
@@ -0,0 +1,224 @@
+#include "ImaAdpcm.hpp"
+
+namespace {
+    constexpr uint8_t kMaxStepIndex = 88;
+    constexpr uint32_t kStepSearchFrames = 64;  // Frames coded to choose the step index of a block
+    constexpr uint8_t kLookaheadFrames = 2;     // Frames after a sample weighed to choose its code
+
+    const int16_t kSteps[kMaxStepIndex + 1] = {
+        7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88,
+        97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658,
+        724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327, 3660,
+        4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818,
+        18500, 20350, 22385, 24623, 27086, 29794, 32767};
+    const int8_t kIndexAdjust[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+    /**
+     * Decoder state change of a code magnitude: the step table folded with the 3 magnitude bits of the code and
+     * with the clamped step index update, so a sample costs one table load instead of three tests and a clamp.
+     */
+    struct Transition {
+        uint16_t difference;    // Change of the predictor, the code sign bit gives its direction
+        uint8_t nextIndex;
+    };
+
+    struct TransitionTable {
+        Transition entries[kMaxStepIndex + 1][8];
+
+        TransitionTable() {
+            for (int32_t index = 0; index <= kMaxStepIndex; index++) {
+                for (uint8_t code = 0; code < 8; code++) {
+                    // The rounding of the reference decoder, so the files play the same with other decoders
+                    int32_t step = kSteps[index];
+                    int32_t difference = step >> 3;
+                    if (code & 4) {
+                        difference += step;
+                    }
+                    if (code & 2) {
+                        difference += step >> 1;
+                    }
+                    if (code & 1) {
+                        difference += step >> 2;
+                    }
+                    entries[index][code] = {(uint16_t)difference,
+                                            (uint8_t)constrain(index + kIndexAdjust[code], 0, (int32_t)kMaxStepIndex)};
+                }
+            }
+        }
+    };
+
+    // Built at startup, so it is in RAM: the decoder reads it for every sample
+    const TransitionTable kTransitions;
+
+    struct ChannelState {
+        int32_t predictor;
+        uint8_t index;
+    };
+
+    inline int16_t decodeCode(uint8_t code, ChannelState& state) {
+        const Transition& transition = kTransitions.entries[state.index][code & 7];
+        int32_t predictor = state.predictor + ((code & 8) ? -(int32_t)transition.difference : transition.difference);
+        predictor = predictor > INT16_MAX ? INT16_MAX : (predictor < INT16_MIN ? INT16_MIN : predictor);
+        state.predictor = predictor;
+        state.index = transition.nextIndex;
+        return (int16_t)predictor;
+    }
+
+    /**
+     * Frames of a block to encode, the last frame repeated past the end
+     */
+    struct EncoderInput {
+        const int16_t* frames;
+        uint32_t count;
+        uint8_t channels;
+
+        int16_t at(uint32_t frame, uint8_t channel) const {
+            return frames[min(frame, count - 1) * channels + channel];
+        }
+    };
+
+    /**
+     * Finds the least squared error of coding the next samples of a channel from a decoder state.
+     * @param depth Number of samples, at least 1.
+     */
+    int64_t leastError(const EncoderInput& input, uint32_t frame, uint8_t channel, const ChannelState& state,
+                       uint8_t depth) {
+        int32_t sample = input.at(frame, channel);
+        int64_t best = INT64_MAX;
+        for (uint8_t code = 0; code < 16; code++) {
+            ChannelState next = state;
+            int64_t error = sample - decodeCode(code, next);
+            error *= error;
+            // A path already worse than the best one is not followed further
+            if (depth > 1 && error < best) {
+                error += leastError(input, frame + 1, channel, next, depth - 1);
+            }
+            best = min(best, error);
+        }
+        return best;
+    }
+
+    /**
+     * Encodes a sample with the code of the least error over the sample and the lookahead samples after it, and
+     * updates the state as the decoder does. Looking ahead lets the step grow before a steep edge (e.g. of a
+     * square wave) instead of lagging behind it.
+     */
+    uint8_t encodeSample(const EncoderInput& input, uint32_t frame, uint8_t channel, ChannelState& state,
+                         uint8_t lookahead) {
+        int32_t sample = input.at(frame, channel);
+        uint8_t bestCode = 0;
+        int64_t bestError = INT64_MAX;
+        for (uint8_t code = 0; code < 16; code++) {
+            ChannelState next = state;
+            int64_t error = sample - decodeCode(code, next);
+            error *= error;
+            if (lookahead > 0 && error < bestError) {
+                error += leastError(input, frame + 1, channel, next, lookahead);
+            }
+            if (error < bestError) {
+                bestError = error;
+                bestCode = code;
+            }
+        }
+        decodeCode(bestCode, state);
+        return bestCode;
+    }
+
+    uint8_t chooseStepIndex(const EncoderInput& input, uint8_t channel) {
+        uint8_t bestIndex = 0;
+        int64_t bestError = INT64_MAX;
+        for (uint8_t index = 0; index <= kMaxStepIndex; index++) {
+            ChannelState state = {input.at(0, channel), index};
+            int64_t error = 0;
+            for (uint32_t frame = 1; frame < kStepSearchFrames; frame++) {
+                int32_t sample = input.at(frame, channel);
+                encodeSample(input, frame, channel, state, 0);
+                error += (int64_t)(sample - state.predictor) * (sample - state.predictor);
+            }
+            if (error < bestError) {
+                bestError = error;
+                bestIndex = index;
+            }
+        }
+        return bestIndex;
+    }
+}
+
+uint32_t imaAdpcmDecodeBlock(const uint8_t* block, uint32_t blockBytes, uint8_t channels, int16_t* out) {
+    if (channels < 1 || channels > 2 || blockBytes < (uint32_t)IMA_ADPCM_HEADER_BYTES * channels) {
+        return 0;
+    }
+    ChannelState states[2];
+    for (uint8_t c = 0; c < channels; c++) {
+        const uint8_t* header = block + c * IMA_ADPCM_HEADER_BYTES;
+        states[c] = {(int16_t)(header[0] | (header[1] << 8)), min(header[2], kMaxStepIndex)};
+        out[c] = (int16_t)states[c].predictor;
+    }
+    const uint8_t* data = block + IMA_ADPCM_HEADER_BYTES * channels;
+    uint32_t dataBytes = blockBytes - IMA_ADPCM_HEADER_BYTES * channels;
+
+    if (channels == 1) {
+        ChannelState state = states[0];
+        int16_t* target = out + 1;
+        for (uint32_t i = 0; i < dataBytes; i++) {
+            uint8_t codes = data[i];
+            target[0] = decodeCode(codes & 0x0F, state);
+            target[1] = decodeCode(codes >> 4, state);
+            target += 2;
+        }
+        return 1 + dataBytes * 2;
+    }
+
+    // Stereo: groups of 4 bytes of the left channel then 4 bytes of the right one, 8 frames
+    uint32_t groups = dataBytes / 8;
+    for (uint32_t group = 0; group < groups; group++) {
+        for (uint8_t c = 0; c < 2; c++) {
+            ChannelState& state = states[c];
+            const uint8_t* codes = data + group * 8 + c * 4;
+            int16_t* target = out + (1 + group * 8) * 2 + c;
+            for (uint8_t i = 0; i < 4; i++) {
+                target[i * 4] = decodeCode(codes[i] & 0x0F, state);
+                target[i * 4 + 2] = decodeCode(codes[i] >> 4, state);
+            }
+        }
+    }
+    return 1 + groups * 8;
+}
+
+void imaAdpcmEncodeBlock(const int16_t* in, uint32_t frames, uint8_t channels, uint8_t* block, uint32_t blockBytes) {
+    memset(block, 0, blockBytes);
+    if (frames == 0 || channels < 1 || channels > 2 || blockBytes < (uint32_t)IMA_ADPCM_HEADER_BYTES * channels) {
+        return;
+    }
+    EncoderInput input = {in, frames, channels};
+    ChannelState states[2];
+    for (uint8_t c = 0; c < channels; c++) {
+        int16_t first = input.at(0, c);
+        states[c] = {first, chooseStepIndex(input, c)};
+        uint8_t* header = block + c * IMA_ADPCM_HEADER_BYTES;
+        header[0] = (uint8_t)(first & 0xFF);
+        header[1] = (uint8_t)((uint16_t)first >> 8);
+        header[2] = states[c].index;
+    }
+    uint8_t* data = block + IMA_ADPCM_HEADER_BYTES * channels;
+    uint32_t dataBytes = blockBytes - IMA_ADPCM_HEADER_BYTES * channels;
+
+    if (channels == 1) {
+        for (uint32_t i = 0; i < dataBytes; i++) {
+            uint8_t low = encodeSample(input, 1 + i * 2, 0, states[0], kLookaheadFrames);
+            uint8_t high = encodeSample(input, 2 + i * 2, 0, states[0], kLookaheadFrames);
+            data[i] = low | (high << 4);
+        }
+        return;
+    }
+
+    for (uint32_t group = 0; group < dataBytes / 8; group++) {
+        for (uint8_t c = 0; c < 2; c++) {
+            uint8_t* codes = data + group * 8 + c * 4;
+            for (uint8_t i = 0; i < 8; i++) {
+                uint8_t code = encodeSample(input, 1 + group * 8 + i, c, states[c], kLookaheadFrames);
+                codes[i / 2] |= code << ((i & 1) * 4);
+            }
+        }
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <Arduino.h>
+
+// IMA ADPCM codec of the WAV files (format 0x11): 4 bits per sample, a quarter of the size of 16-bit PCM.
+//
+// The samples are coded in blocks of a fixed size. Each block starts with a header per channel (the first sample
+// as 16-bit PCM and the step index of the decoder), so a block decodes without the blocks before it: block n of
+// a file is at n times the block size from the first one, the block size is the whole seek index. After the
+// headers, mono blocks hold 2 samples per byte, low nibble first; stereo blocks alternate 4 bytes (8 samples) of
+// each channel.
+
+constexpr uint8_t IMA_ADPCM_HEADER_BYTES = 4;      // Per channel: first sample, step index, reserved byte
+
+/**
+ * Gets the frames coded in a block.
+ * @param blockBytes Size of the block, headers included.
+ * @param channels 1 (mono) or 2 (stereo).
+ * @return The number of frames, 0 if the block is shorter than its headers.
+ */
+inline uint32_t imaAdpcmBlockFrames(uint32_t blockBytes, uint8_t channels) {
+    uint32_t headerBytes = IMA_ADPCM_HEADER_BYTES * channels;
+    return channels > 0 && blockBytes >= headerBytes ? (blockBytes - headerBytes) * 2 / channels + 1 : 0;
+}
+
+/**
+ * Decodes a block.
+ * @param block The block. A stereo block is decoded in whole groups of 8 bytes, a shorter tail is ignored.
+ * @param blockBytes Size of the block, it may be shorter than the block size of the file for the last block.
+ * @param channels 1 (mono) or 2 (stereo).
+ * @param out Output 16-bit PCM frames, channels interleaved, imaAdpcmBlockFrames(blockBytes, channels) frames.
+ * @return The number of frames decoded.
+ */
+uint32_t imaAdpcmDecodeBlock(const uint8_t* block, uint32_t blockBytes, uint8_t channels, int16_t* out);
+
+/**
+ * Encodes a block. The step index of each channel is chosen for the least error at the start of the block, so a
+ * block does not depend on the one before it, and each code for the least error over the next samples too. The
+ * search is for the host tools (see tools/adpcm_encoder), it costs far more than the decoding.
+ * @param in 16-bit PCM frames, channels interleaved.
+ * @param frames Number of frames, at most imaAdpcmBlockFrames(blockBytes, channels). A shorter last block is
+ *               padded with its last frame.
+ * @param channels 1 (mono) or 2 (stereo).
+ * @param block Output block of blockBytes bytes.
+ * @param blockBytes Size of the block: the headers and a multiple of 4 bytes per channel.
+ */
+void imaAdpcmEncodeBlock(const int16_t* in, uint32_t frames, uint8_t channels, uint8_t* block, uint32_t blockBytes);
@@ -0,0 +1,77 @@
+#include "SampleCache.hpp"
+
+bool SampleCache::load(fs::FS& fs, const char* filename, uint32_t maxBytes) {
+    if (filename == nullptr || count == MAX_SAMPLES) {
+        return false;
+    }
+    if (find(filename) != nullptr) {
+        return true;
+    }
+
+    File file = fs.open(filename);
+    if (!file || file.isDirectory()) {
+        return false;
+    }
+
+    WavFormat wav;
+    if (!readWavHeader(file, wav) || !(wav.isPcm16() || wav.isImaAdpcm())) {
+        return false;
+    }
+    uint32_t frames = wav.getFrames();
+    uint32_t sampleBytes = frames * wav.channels * sizeof(int16_t);
+    if (frames == 0 || sampleBytes > maxBytes) {
+        return false;
+    }
+
+    // The WAV samples are little endian like the ESP32, they are copied as they are
+    int16_t* buffer = static_cast<int16_t*>(ps_malloc(sampleBytes));
+    if (buffer == nullptr) {
+        return false;
+    }
+    bool read = wav.isImaAdpcm() ? readAdpcm(file, wav, buffer, frames)
+                                 : file.read(reinterpret_cast<uint8_t*>(buffer), sampleBytes) == sampleBytes;
+    if (!read) {
+        free(buffer);
+        return false;
+    }
+
+    samples[count++] = {filename, buffer, frames, wav.sampleRate, (uint8_t)wav.channels};
+    bytes += sampleBytes;
+    fileBytes += wav.isImaAdpcm() ? wav.dataBytes : sampleBytes;
+    return true;
+}
+
+bool SampleCache::readAdpcm(fs::File& file, const WavFormat& wav, int16_t* buffer, uint32_t frames) {
+    // One block at a time, straight into the cache; the last block, padded past the last frame, goes through a copy
+    uint8_t channels = (uint8_t)wav.channels;
+    uint8_t* block = static_cast<uint8_t*>(malloc(wav.blockAlign + wav.blockFrames * channels * sizeof(int16_t)));
+    if (block == nullptr) {
+        return false;
+    }
+    int16_t* lastFrames = reinterpret_cast<int16_t*>(block + wav.blockAlign);
+    uint32_t decoded = 0;
+    while (decoded < frames) {
+        size_t blockBytes = file.read(block, wav.blockAlign);
+        uint32_t remaining = frames - decoded;
+        int16_t* target = remaining >= wav.blockFrames ? buffer + decoded * channels : lastFrames;
+        uint32_t count = min(imaAdpcmDecodeBlock(block, blockBytes, channels, target), remaining);
+        if (count == 0) {
+            break;
+        }
+        if (target == lastFrames) {
+            memcpy(buffer + decoded * channels, lastFrames, count * channels * sizeof(int16_t));
+        }
+        decoded += count;
+    }
+    free(block);
+    return decoded == frames;
+}
+
+const CachedSample* SampleCache::find(const char* filename) const {
+    for (uint8_t i = 0; i < count; i++) {
+        if (strcmp(samples[i].filename, filename) == 0) {
+            return &samples[i];
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+#include "WavFile.hpp"
+
+/**
+ * PCM samples of a WAV file kept in memory
+ */
+struct CachedSample {
+    const char* filename;   // Path of the file, as given to SampleCache::load
+    int16_t* samples;       // 16-bit PCM frames, channels interleaved
+    uint32_t frames;
+    uint32_t sampleRate;
+    uint8_t channels;       // 1 (mono) or 2 (stereo)
+};
+
+/**
+ * SampleCache loads short WAV files into PSRAM at boot, so they can be played without opening, parsing and
+ * streaming the file from flash. 16-bit PCM files are kept as stored, IMA ADPCM files are decoded once at load,
+ * both mono or stereo: the cache holds 16-bit PCM, the mixer plays it without decoding. The cache is filled once
+ * and never freed.
+ */
+class SampleCache {
+public:
+    static constexpr uint8_t MAX_SAMPLES = 16;
+
+    /**
+     * Loads a WAV file into the cache.
+     * @param fs File system holding the file (e.g. SPIFFS).
+     * @param filename Path of the file. The string must stay valid for the whole cache life (e.g. a literal).
+     * @param maxBytes Largest size of the 16-bit PCM samples to cache, longer files are refused.
+     * @return true if the file is cached, false if it is missing, not 16-bit PCM or IMA ADPCM, too long, or there
+     *         is no room.
+     */
+    bool load(fs::FS& fs, const char* filename, uint32_t maxBytes);
+
+    /**
+     * Looks up a cached file.
+     * @param filename Path of the file.
+     * @return The samples of the file, or nullptr if the file is not cached.
+     */
+    const CachedSample* find(const char* filename) const;
+
+    uint8_t getCount() const {
+        return count;
+    }
+
+    /**
+     * Gets the memory used by the cached samples.
+     * @return The size of the samples in bytes.
+     */
+    uint32_t getBytes() const {
+        return bytes;
+    }
+
+    /**
+     * Gets the size of the samples read from the files to fill the cache.
+     * @return The size in bytes, a quarter of getBytes() for IMA ADPCM files.
+     */
+    uint32_t getFileBytes() const {
+        return fileBytes;
+    }
+
+private:
+    CachedSample samples[MAX_SAMPLES] = {};
+    uint8_t count = 0;
+    uint32_t bytes = 0;
+    uint32_t fileBytes = 0;
+
+    bool readAdpcm(fs::File& file, const WavFormat& wav, int16_t* buffer, uint32_t frames);
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+/**
+ * Lock-free ring of SIZE items between one producer and one consumer. Each side only writes its own index: the
+ * producer publishes an item by advancing the head after copying it, the consumer frees its slot by advancing
+ * the tail after reading it. Neither side ever waits for the other.
+ */
+template <typename T, uint32_t SIZE>
+class SpscQueue {
+    static_assert(SIZE > 0 && (SIZE & (SIZE - 1)) == 0, "The queue size must be a power of two");
+
+public:
+    /**
+     * Appends an item. Producer side only.
+     * @param item The item, copied.
+     * @return false if the queue is full.
+     */
+    bool push(const T& item) {
+        uint32_t head = this->head.load(std::memory_order_relaxed);
+        if (head - tail.load(std::memory_order_acquire) == SIZE) {
+            return false;
+        }
+        items[head & (SIZE - 1)] = item;
+        this->head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Removes the oldest item. Consumer side only.
+     * @param item Output item.
+     * @return false if the queue is empty.
+     */
+    bool pop(T& item) {
+        uint32_t tail = this->tail.load(std::memory_order_relaxed);
+        if (tail == head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = items[tail & (SIZE - 1)];
+        this->tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    T items[SIZE];
+    std::atomic<uint32_t> head{0};  // Next slot to write, only advanced by the producer
+    std::atomic<uint32_t> tail{0};  // Next slot to read, only advanced by the consumer
+};
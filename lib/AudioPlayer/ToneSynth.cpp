@@ -0,0 +1,266 @@
+#include "ToneSynth.hpp"
+
+namespace {
+    constexpr int32_t kLevelFull = 1 << 30;     // Envelope level 1.0 in Q30
+
+    int16_t sineTable[257];                     // One period plus the first entry again, for the interpolation
+    bool sineTableInitialized = false;
+
+    void initSineTable() {
+        if (sineTableInitialized) {
+            return;
+        }
+        for (int i = 0; i < 256; i++) {
+            sineTable[i] = (int16_t)lroundf(sinf(i * 2.0f * PI / 256.0f) * ToneSynth::AMPLITUDE);
+        }
+        sineTable[256] = sineTable[0];
+        sineTableInitialized = true;
+    }
+
+    uint32_t phaseIncrementOf(uint16_t frequency) {
+        return (uint32_t)(((uint64_t)frequency << 32) / ToneSynth::SAMPLE_RATE);
+    }
+
+    /**
+     * Waveform value at a phase, within +-AMPLITUDE.
+     */
+    template <ToneWaveform WAVEFORM>
+    inline int32_t waveformAt(uint32_t phase) {
+        switch (WAVEFORM) {
+            case ToneWaveform::SINE: {
+                // Top 8 bits index the table, the next 16 bits interpolate to the following entry
+                uint32_t index = phase >> 24;
+                int32_t fraction = (int32_t)((phase >> 8) & 0xFFFF);
+                int32_t a = sineTable[index];
+                int32_t b = sineTable[index + 1];
+                return a + (((b - a) * fraction) >> 16);
+            }
+            case ToneWaveform::TRIANGLE: {
+                // Rises over the first half of the period, falls over the second
+                int32_t ramp = (int32_t)(phase >> 16);                      // 0..65535
+                int32_t folded = ramp < 32768 ? ramp : 65535 - ramp;        // 0..32767
+                return ((folded * 2 - 32767) * ToneSynth::AMPLITUDE) >> 15;
+            }
+            case ToneWaveform::SQUARE:
+                return phase < 0x80000000u ? ToneSynth::AMPLITUDE : -ToneSynth::AMPLITUDE;
+            case ToneWaveform::SAWTOOTH:
+                return (((int32_t)(phase >> 16) - 32768) * ToneSynth::AMPLITUDE) >> 15;
+        }
+        return 0;
+    }
+
+    /**
+     * Renders frames of one envelope stage: the level moves linearly, one multiply by the envelope and one by
+     * the gain per frame.
+     */
+    template <ToneWaveform WAVEFORM>
+    void renderStage(int32_t* accumulator, uint32_t frames, uint32_t& phase, uint32_t phaseIncrement, int32_t& level,
+                     int32_t levelStep, int32_t gain) {
+        uint32_t localPhase = phase;
+        int32_t localLevel = level;
+        for (uint32_t i = 0; i < frames; i++) {
+            int32_t value = (waveformAt<WAVEFORM>(localPhase) * (localLevel >> 15)) >> 15;
+            value = (value * gain) >> 15;
+            accumulator[i * 2] += value;
+            accumulator[i * 2 + 1] += value;
+            localPhase += phaseIncrement;
+            localLevel += levelStep;
+        }
+        phase = localPhase;
+        level = localLevel;
+    }
+}
+
+void ToneSynth::setEnvelope(ToneWaveform waveform, const ToneEnvelope& envelope) {
+    initSineTable();
+    this->waveform = waveform;
+    attackFrames = msToFrames(envelope.attackMs);
+    decayFrames = msToFrames(envelope.decayMs);
+    releaseFrames = msToFrames(envelope.releaseMs);
+    sustainLevel = (int32_t)min<uint32_t>(envelope.sustainLevel, TONE_LEVEL_FULL) << 15;
+}
+
+void ToneSynth::startTone(uint16_t frequency, uint32_t durationFrames, ToneWaveform waveform,
+                          const ToneEnvelope& envelope) {
+    setEnvelope(waveform, envelope);
+    notes = nullptr;
+    noteCount = 0;
+    nextNote = 0;
+    phase = 0;
+    level = 0;
+    startNote(frequency, durationFrames);
+}
+
+void ToneSynth::startSequence(const ToneNote* notes, uint8_t count, ToneWaveform waveform,
+                              const ToneEnvelope& envelope) {
+    setEnvelope(waveform, envelope);
+    this->notes = notes;
+    noteCount = count;
+    nextNote = 0;
+    phase = 0;
+    level = 0;
+    if (!startNextNote()) {
+        stage = Stage::DONE;
+    }
+}
+
+bool ToneSynth::retune(uint16_t frequency, uint32_t durationFrames) {
+    if (stage == Stage::DONE || notes != nullptr) {
+        return false;
+    }
+    phaseIncrement = phaseIncrementOf(frequency);
+    noteReleaseFrames = min(releaseFrames, durationFrames);
+    gateFrames = durationFrames - noteReleaseFrames;
+    if (stage == Stage::RELEASE || stage == Stage::REST) {
+        enterStage(Stage::ATTACK);
+    }
+    return true;
+}
+
+void ToneSynth::release() {
+    nextNote = noteCount;
+    if (stage == Stage::REST) {
+        stage = Stage::DONE;
+    } else if (stage == Stage::ATTACK || stage == Stage::DECAY || stage == Stage::SUSTAIN) {
+        noteReleaseFrames = releaseFrames;
+        enterStage(Stage::RELEASE);
+    }
+}
+
+bool ToneSynth::startNextNote() {
+    while (nextNote < noteCount) {
+        const ToneNote& note = notes[nextNote++];
+        uint32_t durationFrames = msToFrames(note.durationMs);
+        if (durationFrames > 0) {
+            startNote(note.frequency, durationFrames);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ToneSynth::startNote(uint16_t frequency, uint32_t durationFrames) {
+    if (frequency == TONE_REST) {
+        stage = Stage::REST;
+        stageFrames = durationFrames;
+        gateFrames = 0;
+        levelStep = 0;
+        level = 0;
+        return;
+    }
+    // The level is back to zero between the notes: the phase and the frequency change without a click
+    phaseIncrement = phaseIncrementOf(frequency);
+    noteReleaseFrames = min(releaseFrames, durationFrames);
+    gateFrames = durationFrames - noteReleaseFrames;
+    enterStage(Stage::ATTACK);
+}
+
+void ToneSynth::enterStage(Stage next) {
+    stage = next;
+    switch (next) {
+        case Stage::ATTACK:
+            // From the current level, so a retuned tone does not restart from silence
+            if (attackFrames > 0 && level < kLevelFull) {
+                stageFrames = max<uint32_t>((uint32_t)((int64_t)(kLevelFull - level) * attackFrames / kLevelFull), 1);
+                levelStep = (kLevelFull - level) / (int32_t)stageFrames;
+            } else {
+                level = kLevelFull;
+                enterStage(Stage::DECAY);
+            }
+            break;
+        case Stage::DECAY:
+            if (decayFrames > 0 && sustainLevel < kLevelFull) {
+                stageFrames = decayFrames;
+                levelStep = (sustainLevel - kLevelFull) / (int32_t)decayFrames;
+            } else {
+                level = sustainLevel;
+                enterStage(Stage::SUSTAIN);
+            }
+            break;
+        case Stage::SUSTAIN:
+            stageFrames = UINT32_MAX;
+            levelStep = 0;
+            break;
+        case Stage::RELEASE:
+            // From the level reached at the release, so the ramp always ends on silence
+            stageFrames = noteReleaseFrames;
+            levelStep = stageFrames > 0 ? -level / (int32_t)stageFrames : 0;
+            if (stageFrames == 0) {
+                level = 0;
+            }
+            break;
+        case Stage::REST:
+        case Stage::DONE:
+            levelStep = 0;
+            break;
+    }
+}
+
+void ToneSynth::endStage() {
+    switch (stage) {
+        case Stage::ATTACK:
+            level = kLevelFull;
+            enterStage(Stage::DECAY);
+            break;
+        case Stage::DECAY:
+            level = sustainLevel;
+            enterStage(Stage::SUSTAIN);
+            break;
+        case Stage::SUSTAIN:
+            break;
+        case Stage::RELEASE:
+        case Stage::REST:
+            level = 0;
+            if (!startNextNote()) {
+                stage = Stage::DONE;
+            }
+            break;
+        case Stage::DONE:
+            break;
+    }
+}
+
+uint32_t ToneSynth::render(int32_t* accumulator, uint32_t frames, int32_t gain) {
+    uint32_t rendered = 0;
+    while (rendered < frames && stage != Stage::DONE) {
+        // The note is released when its gate closes, whatever the stage reached
+        if (gateFrames == 0 && (stage == Stage::ATTACK || stage == Stage::DECAY || stage == Stage::SUSTAIN)) {
+            enterStage(Stage::RELEASE);
+        }
+        if (stageFrames == 0) {
+            endStage();
+            continue;
+        }
+
+        // The longest run of frames with a linear level: up to the end of the stage, of the gate or of the block
+        uint32_t count = min(frames - rendered, stageFrames);
+        if (stage != Stage::RELEASE && stage != Stage::REST) {
+            count = min(count, gateFrames);
+        }
+        int32_t* target = accumulator + rendered * 2;
+        if (stage != Stage::REST) {
+            switch (waveform) {
+                case ToneWaveform::SINE:
+                    renderStage<ToneWaveform::SINE>(target, count, phase, phaseIncrement, level, levelStep, gain);
+                    break;
+                case ToneWaveform::TRIANGLE:
+                    renderStage<ToneWaveform::TRIANGLE>(target, count, phase, phaseIncrement, level, levelStep, gain);
+                    break;
+                case ToneWaveform::SQUARE:
+                    renderStage<ToneWaveform::SQUARE>(target, count, phase, phaseIncrement, level, levelStep, gain);
+                    break;
+                case ToneWaveform::SAWTOOTH:
+                    renderStage<ToneWaveform::SAWTOOTH>(target, count, phase, phaseIncrement, level, levelStep, gain);
+                    break;
+            }
+        }
+        rendered += count;
+        if (stageFrames != UINT32_MAX) {
+            stageFrames -= count;
+        }
+        if (stage != Stage::RELEASE && stage != Stage::REST) {
+            gateFrames -= count;
+        }
+    }
+    return rendered;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <Arduino.h>
+
+constexpr uint16_t TONE_LEVEL_FULL = 32768;    // Envelope levels are Q15: 32768 is the full waveform amplitude
+constexpr uint16_t TONE_REST = 0;              // Note frequency of a silence
+
+enum class ToneWaveform : uint8_t {
+    SINE,
+    TRIANGLE,
+    SQUARE,
+    SAWTOOTH
+};
+
+/**
+ * ADSR envelope of the notes. The level rises linearly from silence to full in attackMs, falls to sustainLevel in
+ * decayMs, holds until the note is released, then falls back to silence in releaseMs. Ramps of a few milliseconds
+ * start and end the notes without clicks.
+ */
+struct ToneEnvelope {
+    uint16_t attackMs;
+    uint16_t decayMs;
+    uint16_t sustainLevel;  // Q15
+    uint16_t releaseMs;
+};
+
+constexpr ToneEnvelope TONE_ENVELOPE_DEFAULT = {5, 0, TONE_LEVEL_FULL, 15};
+
+/**
+ * Note of a sequence. The note is released releaseMs before its end, so it is silent when the next one starts.
+ */
+struct ToneNote {
+    uint16_t frequency;     // Hz, TONE_REST for a silence
+    uint16_t durationMs;
+};
+
+/**
+ * ToneSynth renders a tone or a sequence of notes with a direct digital synthesis oscillator: a 32-bit phase
+ * accumulator advanced by a fixed increment per sample, whose top bits index the waveform. The sine is read from
+ * a 256 entry table with linear interpolation; the other waveforms are computed from the phase. The ADSR
+ * envelope is a linear ramp per stage in Q30, everything is integer arithmetic.
+ */
+class ToneSynth {
+public:
+    static constexpr uint32_t SAMPLE_RATE = 44100;
+    static constexpr int16_t AMPLITUDE = 30000;   // Waveform peak at full level, below full scale like the former tones
+
+    /**
+     * Starts a single tone.
+     * @param frequency Tone frequency in Hz.
+     * @param durationFrames Tone duration in frames, the release included.
+     * @param waveform Waveform of the tone.
+     * @param envelope Envelope of the tone.
+     */
+    void startTone(uint16_t frequency, uint32_t durationFrames, ToneWaveform waveform = ToneWaveform::SINE,
+                   const ToneEnvelope& envelope = TONE_ENVELOPE_DEFAULT);
+
+    /**
+     * Starts a sequence of notes.
+     * @param notes The notes, they must stay valid while playing (e.g. a static const array).
+     * @param count Number of notes.
+     * @param waveform Waveform of the notes.
+     * @param envelope Envelope of each note.
+     */
+    void startSequence(const ToneNote* notes, uint8_t count, ToneWaveform waveform = ToneWaveform::SINE,
+                       const ToneEnvelope& envelope = TONE_ENVELOPE_DEFAULT);
+
+    /**
+     * Changes the frequency and the remaining duration of a single tone, keeping its phase and its level so
+     * there is no click. A tone already released rises again from its current level.
+     * @param frequency New frequency in Hz.
+     * @param durationFrames New remaining duration in frames, the release included.
+     * @return true if the tone is still playing and was changed, false for a sequence or a tone ended.
+     */
+    bool retune(uint16_t frequency, uint32_t durationFrames);
+
+    /**
+     * Ends the tone or the sequence with the release of the envelope, from the current level.
+     */
+    void release();
+
+    /**
+     * Adds the next frames of the tone to a stereo accumulator.
+     * @param accumulator Interleaved stereo sums, 2 * frames values.
+     * @param frames Number of frames.
+     * @param gain Gain applied over the envelope, Q15.
+     * @return The frames rendered, fewer than frames when the tone ends inside the block.
+     */
+    uint32_t render(int32_t* accumulator, uint32_t frames, int32_t gain);
+
+    bool isPlaying() const {
+        return stage != Stage::DONE;
+    }
+
+    static uint32_t msToFrames(uint32_t ms) {
+        return (uint32_t)((uint64_t)ms * SAMPLE_RATE / 1000);
+    }
+
+private:
+    enum class Stage : uint8_t {
+        ATTACK,
+        DECAY,
+        SUSTAIN,
+        RELEASE,
+        REST,
+        DONE
+    };
+
+    ToneWaveform waveform = ToneWaveform::SINE;
+    uint32_t attackFrames = 0;
+    uint32_t decayFrames = 0;
+    uint32_t releaseFrames = 0;
+    int32_t sustainLevel = 0;       // Q30
+
+    const ToneNote* notes = nullptr;
+    uint8_t noteCount = 0;
+    uint8_t nextNote = 0;
+
+    uint32_t phase = 0;             // A full waveform period is 2^32
+    uint32_t phaseIncrement = 0;
+    Stage stage = Stage::DONE;
+    uint32_t stageFrames = 0;       // Frames left in the stage
+    uint32_t gateFrames = 0;        // Frames left before the release
+    uint32_t noteReleaseFrames = 0; // Release of the current note, shorter than releaseFrames for short notes
+    int32_t level = 0;              // Envelope level, Q30
+    int32_t levelStep = 0;          // Level change per frame in the stage
+
+    void setEnvelope(ToneWaveform waveform, const ToneEnvelope& envelope);
+    void startNote(uint16_t frequency, uint32_t durationFrames);
+    bool startNextNote();
+    void enterStage(Stage stage);
+    void endStage();
+};
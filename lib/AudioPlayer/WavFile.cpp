@@ -0,0 +1,57 @@
+#include "WavFile.hpp"
+
+namespace {
+    uint32_t readLe32(const uint8_t* bytes) {
+        return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+    }
+
+    uint16_t readLe16(const uint8_t* bytes) {
+        return (uint16_t)(bytes[0] | (bytes[1] << 8));
+    }
+}
+
+bool readWavHeader(fs::File& file, WavFormat& format) {
+    format = {};
+    uint8_t header[12];
+    if (file.read(header, sizeof(header)) != sizeof(header) || memcmp(header, "RIFF", 4) != 0 ||
+        memcmp(header + 8, "WAVE", 4) != 0) {
+        return false;
+    }
+
+    bool formatFound = false;
+    uint8_t chunk[8];
+    while (file.read(chunk, sizeof(chunk)) == sizeof(chunk)) {
+        uint32_t chunkSize = readLe32(chunk + 4);
+        size_t next = file.position() + chunkSize + (chunkSize & 1);
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            uint8_t fmt[16];
+            if (chunkSize < sizeof(fmt) || file.read(fmt, sizeof(fmt)) != sizeof(fmt)) {
+                return false;
+            }
+            format.format = readLe16(fmt);
+            format.channels = readLe16(fmt + 2);
+            format.sampleRate = readLe32(fmt + 4);
+            format.blockAlign = readLe16(fmt + 12);
+            format.bitsPerSample = readLe16(fmt + 14);
+            // ADPCM formats extend the chunk with the frames per block
+            uint8_t extension[4];
+            if (chunkSize >= sizeof(fmt) + sizeof(extension) &&
+                file.read(extension, sizeof(extension)) == sizeof(extension) && readLe16(extension) >= 2) {
+                format.blockFrames = readLe16(extension + 2);
+            }
+            formatFound = true;
+        } else if (memcmp(chunk, "fact", 4) == 0) {
+            uint8_t fact[4];
+            if (chunkSize >= sizeof(fact) && file.read(fact, sizeof(fact)) == sizeof(fact)) {
+                format.factFrames = readLe32(fact);
+            }
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            format.dataBytes = min<uint32_t>(chunkSize, file.size() - file.position());
+            return formatFound;
+        }
+        if (!file.seek(next)) {
+            break;
+        }
+    }
+    return false;
+}
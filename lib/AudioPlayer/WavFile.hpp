@@ -0,0 +1,57 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+#include "ImaAdpcm.hpp"
+
+#define WAV_FORMAT_PCM 1
+#define WAV_FORMAT_IMA_ADPCM 0x11
+
+/**
+ * Format of the samples of a WAV file
+ */
+struct WavFormat {
+    uint16_t format;        // WAV_FORMAT_PCM for uncompressed samples, WAV_FORMAT_IMA_ADPCM for 4-bit blocks
+    uint16_t channels;
+    uint32_t sampleRate;
+    uint16_t blockAlign;    // Size of a frame, or of an ADPCM block
+    uint16_t bitsPerSample;
+    uint16_t blockFrames;   // Frames of an ADPCM block
+    uint32_t factFrames;    // Frames of the file given by the fact chunk, 0 without it
+    uint32_t dataBytes;     // Size of the samples, clipped to the file size
+
+    /**
+     * Checks if the samples are 16-bit PCM, the format played without the decoder.
+     * @return true for 16-bit mono or stereo PCM samples.
+     */
+    bool isPcm16() const {
+        return format == WAV_FORMAT_PCM && bitsPerSample == 16 && (channels == 1 || channels == 2) && sampleRate > 0;
+    }
+
+    /**
+     * Checks if the samples are mono or stereo IMA ADPCM blocks, the compressed format of the sound files.
+     * @return true for IMA ADPCM samples with a block size that matches the frames per block.
+     */
+    bool isImaAdpcm() const {
+        return format == WAV_FORMAT_IMA_ADPCM && bitsPerSample == 4 && (channels == 1 || channels == 2) &&
+               sampleRate > 0 && blockFrames > 1 && blockFrames == imaAdpcmBlockFrames(blockAlign, (uint8_t)channels);
+    }
+
+    uint32_t getFrames() const {
+        if (isImaAdpcm()) {
+            // The last block is padded to the block size, the fact chunk gives the frames really coded
+            uint32_t blockedFrames = (dataBytes + blockAlign - 1) / blockAlign * blockFrames;
+            return factFrames > 0 ? min(factFrames, blockedFrames) : blockedFrames;
+        }
+        return channels > 0 && bitsPerSample > 0 ? dataBytes / (channels * ((bitsPerSample + 7) / 8)) : 0;
+    }
+};
+
+/**
+ * Reads the header of a WAV file, walking the RIFF chunks up to the samples. The fact chunk is read when it comes
+ * before the samples, as the WAV writers put it.
+ * @param file File open at its beginning. On success it is left at the first sample.
+ * @param format Output format of the samples.
+ * @return true if the file is a WAV file with a format and a data chunk, false otherwise.
+ */
+bool readWavHeader(fs::File& file, WavFormat& format);
@@ -0,0 +1,153 @@
+#include "CalibrationSolver.hpp"
+#include <math.h>
+
+namespace {
+    constexpr float kMinRelativeDeterminant = 0.05f;    // Below this the axes are too coupled to be solved apart
+    constexpr float kMinUpdateStepUs = 20.0f;           // Smaller moves are dominated by noise and gear backlash
+}
+
+void CalibrationSolver::begin(const float startPulseUs[AXES], const float targetTiltDeg[AXES], float toleranceDeg,
+                              float minPulseUs, float maxPulseUs, const TiltModel* initialModel) {
+    phase = Phase::BASE;
+    tolerance = toleranceDeg;
+    minPulse = minPulseUs;
+    maxPulse = maxPulseUs;
+    measurements = 0;
+    for (uint8_t i = 0; i < AXES; i++) {
+        target[i] = targetTiltDeg[i];
+        nextPulse[i] = startPulseUs[i];
+        columnKnown[i] = initialModel != nullptr;
+    }
+    if (initialModel != nullptr) {
+        model = *initialModel;
+    } else {
+        model = {};
+    }
+}
+
+void CalibrationSolver::getNextPulses(uint16_t& xPulseUs, uint16_t& yPulseUs) const {
+    xPulseUs = static_cast<uint16_t>(lroundf(nextPulse[0]));
+    yPulseUs = static_cast<uint16_t>(lroundf(nextPulse[1]));
+}
+
+bool CalibrationSolver::getModel(TiltModel& outModel) const {
+    if (!modelComplete()) {
+        return false;
+    }
+    outModel = model;
+    return true;
+}
+
+CalibrationSolver::Status CalibrationSolver::addMeasurement(float xTiltDeg, float yTiltDeg) {
+    float pulse[AXES];
+    uint16_t roundedPulse[AXES];
+    getNextPulses(roundedPulse[0], roundedPulse[1]);
+    pulse[0] = roundedPulse[0];
+    pulse[1] = roundedPulse[1];
+    float tilt[AXES] = {xTiltDeg, yTiltDeg};
+    measurements++;
+
+    if (phase != Phase::BASE) {
+        updateModel(pulse, tilt);
+    }
+    bool confirmed = phase == Phase::CONFIRM && withinTolerance(tilt);
+    for (uint8_t i = 0; i < AXES; i++) {
+        lastPulse[i] = pulse[i];
+        lastTilt[i] = tilt[i];
+    }
+
+    if (confirmed) {
+        return Status::CONVERGED;
+    }
+    if (withinTolerance(tilt)) {
+        // Measure once more at the same pulse widths to confirm the solution
+        phase = Phase::CONFIRM;
+        return Status::RUNNING;
+    }
+    if (measurements >= MAX_MEASUREMENTS) {
+        return Status::FAILED;
+    }
+
+    if (!modelComplete()) {
+        phase = Phase::PROBE;
+        planProbe();
+        return Status::RUNNING;
+    }
+
+    phase = Phase::SOLVE;
+    return planSolveStep() ? Status::RUNNING : Status::FAILED;
+}
+
+bool CalibrationSolver::withinTolerance(const float tilt[AXES]) const {
+    return fabsf(target[0] - tilt[0]) < tolerance && fabsf(target[1] - tilt[1]) < tolerance;
+}
+
+void CalibrationSolver::updateModel(const float pulse[AXES], const float tilt[AXES]) {
+    float deltaPulse[AXES] = {pulse[0] - lastPulse[0], pulse[1] - lastPulse[1]};
+    float deltaTilt[AXES] = {tilt[0] - lastTilt[0], tilt[1] - lastTilt[1]};
+
+    // Probe on a single axis: measure that column of the model directly
+    for (uint8_t j = 0; j < AXES; j++) {
+        uint8_t other = 1 - j;
+        if (!columnKnown[j] && fabsf(deltaPulse[j]) >= kMinUpdateStepUs && deltaPulse[other] == 0.0f) {
+            model.gainDegPerUs[0][j] = deltaTilt[0] / deltaPulse[j];
+            model.gainDegPerUs[1][j] = deltaTilt[1] / deltaPulse[j];
+            columnKnown[j] = true;
+            return;
+        }
+    }
+
+    // Broyden rank-one update: correct the model along the direction just moved
+    float stepSquared = deltaPulse[0] * deltaPulse[0] + deltaPulse[1] * deltaPulse[1];
+    if (!modelComplete() || stepSquared < kMinUpdateStepUs * kMinUpdateStepUs) {
+        return;
+    }
+    for (uint8_t i = 0; i < AXES; i++) {
+        float predicted = model.gainDegPerUs[i][0] * deltaPulse[0] + model.gainDegPerUs[i][1] * deltaPulse[1];
+        float residual = deltaTilt[i] - predicted;
+        for (uint8_t j = 0; j < AXES; j++) {
+            model.gainDegPerUs[i][j] += residual * deltaPulse[j] / stepSquared;
+        }
+    }
+}
+
+void CalibrationSolver::planProbe() {
+    // Probe the first unknown axis, moving towards the target so the probe is not wasted
+    uint8_t axis = columnKnown[0] ? 1 : 0;
+    float direction = target[axis] - lastTilt[axis] >= 0.0f ? 1.0f : -1.0f;
+    nextPulse[0] = lastPulse[0];
+    nextPulse[1] = lastPulse[1];
+    nextPulse[axis] = fminf(fmaxf(lastPulse[axis] + direction * PROBE_PULSE_US, minPulse), maxPulse);
+    if (nextPulse[axis] == lastPulse[axis]) {
+        // At the limit of the range: probe in the other direction
+        nextPulse[axis] = lastPulse[axis] - direction * PROBE_PULSE_US;
+    }
+}
+
+bool CalibrationSolver::planSolveStep() {
+    float pulse[AXES] = {lastPulse[0], lastPulse[1]};
+    if (!solve(model, pulse, lastTilt, target)) {
+        return false;
+    }
+    for (uint8_t i = 0; i < AXES; i++) {
+        float step = fminf(fmaxf(pulse[i] - lastPulse[i], -MAX_STEP_PULSE_US), MAX_STEP_PULSE_US);
+        nextPulse[i] = fminf(fmaxf(lastPulse[i] + step, minPulse), maxPulse);
+    }
+    return true;
+}
+
+bool CalibrationSolver::solve(const TiltModel& model, float pulseUs[AXES], const float tiltDeg[AXES],
+                              const float targetTiltDeg[AXES]) {
+    const float (&g)[AXES][AXES] = model.gainDegPerUs;
+    float determinant = g[0][0] * g[1][1] - g[0][1] * g[1][0];
+    float scale = fabsf(g[0][0] * g[1][1]) + fabsf(g[0][1] * g[1][0]);
+    if (scale == 0.0f || fabsf(determinant) < kMinRelativeDeterminant * scale) {
+        return false;
+    }
+
+    float errorX = targetTiltDeg[0] - tiltDeg[0];
+    float errorY = targetTiltDeg[1] - tiltDeg[1];
+    pulseUs[0] += (g[1][1] * errorX - g[0][1] * errorY) / determinant;
+    pulseUs[1] += (g[0][0] * errorY - g[1][0] * errorX) / determinant;
+    return true;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Linear model of the table tilt around the level position: tilt = tilt0 + gain * (pulse - pulse0).
+ * gainDegPerUs[i][j] is the change of the tilt on axis i per microsecond of pulse width on axis j, so the
+ * off-diagonal terms capture the cross-axis coupling of the mechanics.
+ */
+struct TiltModel {
+    float gainDegPerUs[2][2];
+};
+
+/**
+ * CalibrationSolver finds the servo pulse widths that bring the table tilt to a target. It probes each axis once
+ * to measure the pulse-to-tilt model, then jumps straight to the solved pulse widths and refines the model with a
+ * Broyden update on every new measurement, so it converges in a few steps regardless of the starting error.
+ * The converged solution is confirmed by a second measurement before it is accepted.
+ *
+ * The solver does not touch the hardware: the caller applies the pulse widths from getNextPulses(), waits for
+ * the servos to settle, measures the tilt and passes it to addMeasurement().
+ */
+class CalibrationSolver {
+public:
+    enum class Status {
+        RUNNING,
+        CONVERGED,
+        FAILED
+    };
+
+    static constexpr uint8_t AXES = 2;
+
+    /**
+     * Starts a new solution.
+     * @param startPulseUs Pulse widths of the first measurement.
+     * @param targetTiltDeg Tilt to reach on each axis.
+     * @param toleranceDeg Accepted tilt error on each axis.
+     * @param minPulseUs Smallest pulse width the solver may request.
+     * @param maxPulseUs Largest pulse width the solver may request.
+     * @param initialModel Known model (e.g. from a previous calibration) to skip the probes, or nullptr.
+     */
+    void begin(const float startPulseUs[AXES], const float targetTiltDeg[AXES], float toleranceDeg,
+               float minPulseUs, float maxPulseUs, const TiltModel* initialModel = nullptr);
+
+    /**
+     * Gets the pulse widths at which the next tilt has to be measured.
+     * @param xPulseUs X pulse width in microseconds.
+     * @param yPulseUs Y pulse width in microseconds.
+     */
+    void getNextPulses(uint16_t& xPulseUs, uint16_t& yPulseUs) const;
+
+    /**
+     * Adds the tilt measured at the pulse widths returned by getNextPulses() and plans the next step.
+     * @param xTiltDeg Measured X tilt in degrees.
+     * @param yTiltDeg Measured Y tilt in degrees.
+     * @return RUNNING while more measurements are needed, CONVERGED when the solution is confirmed,
+     *         FAILED when the iteration limit is reached or the model cannot be inverted.
+     */
+    Status addMeasurement(float xTiltDeg, float yTiltDeg);
+
+    /**
+     * Gets the current pulse-to-tilt model.
+     * @param model Where to store the model.
+     * @return true if the model has been measured or provided, false otherwise.
+     */
+    bool getModel(TiltModel& model) const;
+
+    /**
+     * Gets the number of measurements added since begin().
+     * @return The number of measurements.
+     */
+    uint8_t getMeasurementCount() const {
+        return measurements;
+    }
+
+    /**
+     * Solves the model for the pulse widths that bring a measured tilt to the target, without changing the
+     * solver state. Useful to correct a small drift with a stored model.
+     * @param model Pulse-to-tilt model.
+     * @param pulseUs Pulse widths at which the tilt was measured; updated with the solution.
+     * @param tiltDeg Measured tilt.
+     * @param targetTiltDeg Tilt to reach.
+     * @return true if the model could be inverted, false otherwise.
+     */
+    static bool solve(const TiltModel& model, float pulseUs[AXES], const float tiltDeg[AXES],
+                      const float targetTiltDeg[AXES]);
+
+private:
+    static constexpr uint8_t MAX_MEASUREMENTS = 12;
+    static constexpr float PROBE_PULSE_US = 60.0f;
+    static constexpr float MAX_STEP_PULSE_US = 300.0f;
+
+    enum class Phase {
+        BASE,
+        PROBE,
+        SOLVE,
+        CONFIRM
+    };
+
+    Phase phase = Phase::BASE;
+    TiltModel model = {};
+    bool columnKnown[AXES] = {false, false};
+    float target[AXES] = {0.0f, 0.0f};
+    float tolerance = 0.0f;
+    float minPulse = 0.0f;
+    float maxPulse = 0.0f;
+    float nextPulse[AXES] = {0.0f, 0.0f};
+    float lastPulse[AXES] = {0.0f, 0.0f};
+    float lastTilt[AXES] = {0.0f, 0.0f};
+    uint8_t measurements = 0;
+
+    bool modelComplete() const {
+        return columnKnown[0] && columnKnown[1];
+    }
+    bool withinTolerance(const float tilt[AXES]) const;
+    void updateModel(const float pulse[AXES], const float tilt[AXES]);
+    bool planSolveStep();
+    void planProbe();
+};
@@ -1,4 +1,5 @@
 #include "CancelToken.hpp"
+#include <esp_timer.h>
 
 bool CancelToken::isCancelled() {
     std::lock_guard<std::mutex> lock(instanceMutex);
@@ -24,4 +25,16 @@ void delayCancellable(unsigned long delayMs, CancelToken& token, unsigned long p
         unsigned long sleepDuration = (remainingTime < pollIntervalMs) ? remainingTime : pollIntervalMs;
         delay(sleepDuration);
     }
+}
+
+void delayUntilUs(int64_t timeUs) {
+    int64_t remainingUs = timeUs - esp_timer_get_time();
+    if (remainingUs >= 1000) {
+        delay(remainingUs / 1000);
+        remainingUs = timeUs - esp_timer_get_time();
+    }
+    // delay() counts whole ticks of a millisecond, the rest is a short busy wait
+    if (remainingUs > 0) {
+        delayMicroseconds(remainingUs);
+    }
 }
\ No newline at end of file
@@ -26,3 +26,10 @@ public:
 };
 
 void delayCancellable(unsigned long delayMs, CancelToken& token, unsigned long pollIntervalMs = 10);
+
+/**
+ * Sleeps until an esp_timer time, e.g. the time an animation frame is due, so the frames keep their schedule
+ * whatever their drawing time.
+ * @param timeUs esp_timer time in microseconds, the call returns at once if it is past.
+ */
+void delayUntilUs(int64_t timeUs);
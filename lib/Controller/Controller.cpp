@@ -1,9 +1,34 @@
 #include "Controller.hpp"
 
+namespace {
+    constexpr float kIntervalSmoothing = 1.0f / 8.0f;   // EWMA gain of the mean inter-arrival time
+    constexpr float kJitterSmoothing = 1.0f / 4.0f;     // EWMA gain of the inter-arrival deviation
+    constexpr float kLossSmoothing = 1.0f / 16.0f;      // EWMA gain of the loss ratio
+    constexpr float kStalenessJitterFactor = 4.0f;      // Number of deviations above the mean before the link is stale
+    constexpr uint16_t kMinStalenessMarginMs = 20;      // Minimum margin above the update rate before the link is stale
+    constexpr uint16_t kMaxMissedSamplesPerGap = 10;     // Long gaps are disconnections, don't let them saturate the loss ratio
+    constexpr unsigned long kRateAdaptationPeriodMs = 1000;
+    constexpr float kHighLossRatio = 0.2f;              // Slow down the link above this loss ratio
+    constexpr float kLowLossRatio = 0.05f;              // Speed up the link again below this loss ratio
+    constexpr float kBackoffIncreaseFactor = 1.25f;
+    constexpr float kBackoffDecreaseFactor = 0.8f;
+    // Samples received after a rate switch that are left out of the link statistics: the interval spanning the
+    // switch, and the next one which is still at the old rate if a frame was in flight when the controller
+    // received the new rate
+    constexpr uint8_t kRateSwitchSkippedSamples = 2;
+}
+
 bool Controller::begin(ControllerConfig config) {
     isEnabled = true;
     updateRateMs = config.updateRateMs;
     maxAngle = config.maxAngle;
+    reconstructionMode = config.reconstructionMode;
+    maxExtrapolationMs = config.maxExtrapolationMs;
+    adaptiveUpdateRate = config.adaptiveUpdateRate;
+    minUpdateRateMs = min(config.minUpdateRateMs, config.maxUpdateRateMs);
+    maxUpdateRateMs = max(config.minUpdateRateMs, config.maxUpdateRateMs);
+    resetLinkStats();
+    resetTelemetry();
 
     // Update the controller parameters and wait for serial communication activity
     uint8_t retry = 10;
@@ -25,17 +50,151 @@ bool Controller::begin(ControllerConfig config) {
     // Send initial parameters to ensure host is aware of the current settings
     serialComm.sendControllerParams(maxAngle, updateRateMs);
     serialComm.sendControllerEnabled(isEnabled);
+    lastRateAdaptationMs = millis();
 
     return true;
 }
 
+void Controller::setUpdateRate(uint16_t rateMs) {
+    uint16_t previousTimeoutMs = stalenessTimeoutMs;
+    portENTER_CRITICAL(&statusMux);
+    updateRateMs = rateMs;
+    rateSwitchSamples = kRateSwitchSkippedSamples;
+    portEXIT_CRITICAL(&statusMux);
+    resetLinkStats();
+
+    // The next sample may still come at the old rate: keep its timeout until the statistics restart
+    portENTER_CRITICAL(&statusMux);
+    stalenessTimeoutMs = max(stalenessTimeoutMs, previousTimeoutMs);
+    portEXIT_CRITICAL(&statusMux);
+    serialComm.sendControllerParams(maxAngle, updateRateMs);
+}
+
+void Controller::setHMIMode(SerialComm::ControllerHMIMode mode) {
+    portENTER_CRITICAL(&statusMux);
+    hmiMode = mode;
+    hmiModePending = true;
+    portEXIT_CRITICAL(&statusMux);
+}
+
+void Controller::applyHMIMode() {
+    portENTER_CRITICAL(&statusMux);
+    bool pending = hmiModePending;
+    hmiModePending = false;
+    SerialComm::ControllerHMIMode mode = hmiMode;
+    portEXIT_CRITICAL(&statusMux);
+    if (!pending) {
+        return;
+    }
+    serialComm.sendControllerHMIMode(mode);
+
+    // Apply the preferred rate for the new mode right away instead of waiting for the next adaptation period
+    if (adaptiveUpdateRate) {
+        adaptUpdateRate(millis());
+    }
+}
+
+void Controller::resetLinkStats() {
+    portENTER_CRITICAL(&statusMux);
+    meanIntervalMs = updateRateMs;
+    intervalJitterMs = updateRateMs / 4.0f;
+    stalenessTimeoutMs = 2 * updateRateMs;
+    portEXIT_CRITICAL(&statusMux);
+}
+
+uint16_t Controller::inferMissedSamples(unsigned long intervalMs) const {
+    // Each interval spanning more than one update period means that samples were lost
+    if (updateRateMs == 0) {
+        return 0;
+    }
+    unsigned long periods = (intervalMs + updateRateMs / 2) / updateRateMs;
+    unsigned long missed = periods > 0 ? periods - 1 : 0;
+    return static_cast<uint16_t>(min(missed, static_cast<unsigned long>(kMaxMissedSamplesPerGap)));
+}
+
+void Controller::updateLinkStats(unsigned long intervalMs, uint16_t missed) {
+    // Smoothed inter-arrival time and mean deviation (same estimator used for TCP round trip times)
+    float interval = static_cast<float>(intervalMs);
+    float deviation = fabsf(interval - meanIntervalMs);
+    intervalJitterMs += (deviation - intervalJitterMs) * kJitterSmoothing;
+    meanIntervalMs += (interval - meanIntervalMs) * kIntervalSmoothing;
+
+    float lossSample = static_cast<float>(missed) / static_cast<float>(missed + 1);
+    lossRatio += (lossSample - lossRatio) * kLossSmoothing;
+
+    // The link is stale when no sample is received well beyond the expected arrival time
+    float timeoutMs = meanIntervalMs + kStalenessJitterFactor * intervalJitterMs;
+    float minTimeoutMs = static_cast<float>(updateRateMs + kMinStalenessMarginMs);
+    stalenessTimeoutMs = static_cast<uint16_t>(max(timeoutMs, minTimeoutMs));
+}
+
+void Controller::adaptUpdateRate(unsigned long nowMs) {
+    lastRateAdaptationMs = nowMs;
+
+    // Fast rate while the player uses the controller, slow rate in attract mode
+    bool controllerInUse = hmiMode == SerialComm::ControllerHMIMode::IN_GAME ||
+                           hmiMode == SerialComm::ControllerHMIMode::WAITING_TO_START ||
+                           hmiMode == SerialComm::ControllerHMIMode::WRITE_PLAYER_NAME;
+    uint16_t preferredRateMs = controllerInUse ? minUpdateRateMs : maxUpdateRateMs;
+
+    // Back off when the link drops samples or is very irregular, recover when it is healthy again
+    bool linkDegraded = lossRatio > kHighLossRatio || intervalJitterMs > 0.5f * meanIntervalMs;
+    bool linkHealthy = lossRatio < kLowLossRatio;
+    if (linkDegraded) {
+        backoffRateMs = max(backoffRateMs, static_cast<float>(updateRateMs)) * kBackoffIncreaseFactor;
+    } else if (linkHealthy) {
+        backoffRateMs *= kBackoffDecreaseFactor;
+    }
+    backoffRateMs = min(backoffRateMs, static_cast<float>(maxUpdateRateMs));
+
+    uint16_t newRateMs = max(preferredRateMs, static_cast<uint16_t>(backoffRateMs));
+    newRateMs = constrain(newRateMs, minUpdateRateMs, maxUpdateRateMs);
+    if (newRateMs != updateRateMs) {
+        setUpdateRate(newRateMs);
+    }
+}
+
+
+void Controller::updateStatus(float xAngle, float yAngle, bool isButtonPressed, bool hasSequence, uint32_t sequence) {
+    // Store the new status as a timestamped sample
+    unsigned long nowMs = millis();
+    portENTER_CRITICAL(&statusMux);
+    if (sampleHistory.size() > 0) {
+        unsigned long intervalMs = nowMs - lastUpdateTime;
 
-void Controller::updateStatus(float xAngle, float yAngle, bool isButtonPressed) {
-    // Store the new status
-    this->xAngle = xAngle;
-    this->yAngle = yAngle;
+        // Count lost frames from the sequence number when the controller sends it, from the arrival time otherwise
+        uint16_t missed;
+        if (hasSequence && this->hasSequence) {
+            uint32_t skipped = sequence - lastSequence - 1;
+            if (skipped != 0) {
+                telemetry.sequenceGaps++;
+            }
+            // A sequence going backward means that the controller restarted, not that frames were lost
+            missed = skipped < 0x80000000UL ? static_cast<uint16_t>(min(skipped, static_cast<uint32_t>(kMaxMissedSamplesPerGap))) : 0;
+        } else {
+            missed = inferMissedSamples(intervalMs);
+        }
+        telemetry.missedFrames += missed;
+        telemetry.intervalHistogram[ControllerTelemetry::histogramBucket(intervalMs)]++;
+        if (intervalMs > telemetry.longestStaleMs) {
+            telemetry.longestStaleMs = intervalMs;
+        }
+
+        // Intervals around a rate switch are not at the new rate: they would count as losses or jitter
+        if (rateSwitchSamples > 0) {
+            rateSwitchSamples--;
+        } else {
+            updateLinkStats(intervalMs, missed);
+        }
+    }
+    telemetry.framesReceived++;
+    this->hasSequence = hasSequence;
+    lastSequence = sequence;
+
+    sampleHistory.push({nowMs, xAngle, yAngle});
     this->isButtonPressed = isButtonPressed;
-    lastUpdateTime = millis();    
+    lastUpdateTime = nowMs;
+    portEXIT_CRITICAL(&statusMux);
 }
 
 bool Controller::getStatus(float& x, float& y, bool& buttonPressed) {
@@ -43,48 +202,146 @@ bool Controller::getStatus(float& x, float& y, bool& buttonPressed) {
     if (!isEnabled) {
         return false;
     }
-    
-    // Check if more than 2 times the update rate has elapsed since last updateStatus
+
+    // Take a consistent snapshot of the samples received by the controller task
+    portENTER_CRITICAL(&statusMux);
+    ControllerSampleHistory<SAMPLE_HISTORY_SIZE> history = sampleHistory;
+    bool button = isButtonPressed;
+    unsigned long lastTime = lastUpdateTime;
+    unsigned long maxElapsedTime = stalenessTimeoutMs;
+    portEXIT_CRITICAL(&statusMux);
+
+    // Check if the staleness timeout has elapsed since last updateStatus
     unsigned long currentTime = millis();
-    unsigned long elapsedTime = currentTime - lastUpdateTime;
-    unsigned long maxElapsedTime = 2 * updateRateMs;
+    unsigned long elapsedTime = currentTime - lastTime;
     
-    if (elapsedTime > maxElapsedTime) {
+    if (history.size() == 0 || elapsedTime > maxElapsedTime) {
+        if (hmiMode == SerialComm::ControllerHMIMode::IN_GAME) {
+            portENTER_CRITICAL(&statusMux);
+            telemetry.staleStatusInGame++;
+            portEXIT_CRITICAL(&statusMux);
+        }
         return false;
     }
     
     // Return current status via reference parameters
-    x = xAngle;
-    y = yAngle;
-    buttonPressed = isButtonPressed;
+    reconstructSample(history, currentTime, x, y);
+    buttonPressed = button;
     
     return true;
 }
 
+void Controller::reconstructSample(const ControllerSampleHistory<SAMPLE_HISTORY_SIZE>& history, unsigned long nowMs, float& x, float& y) const {
+    const ControllerSample& latest = history.get(0);
+    x = latest.x;
+    y = latest.y;
+
+    if (history.size() < 2) {
+        return; // Not enough samples to reconstruct anything but the last value
+    }
+
+    switch (reconstructionMode) {
+        case ControllerReconstructionMode::HOLD:
+            break;
+
+        case ControllerReconstructionMode::INTERPOLATE: {
+            // Render one update period in the past so that there is (usually) a sample on both sides
+            unsigned long renderTimeMs = nowMs - updateRateMs;
+            for (uint8_t age = 1; age < history.size(); age++) {
+                const ControllerSample& newer = history.get(age - 1);
+                const ControllerSample& older = history.get(age);
+                // Compare with signed differences to be robust to millis() roll over
+                if (static_cast<long>(renderTimeMs - older.timeMs) < 0) {
+                    // Render time older than this pair, keep searching backward
+                    x = older.x;
+                    y = older.y;
+                    continue;
+                }
+                if (static_cast<long>(renderTimeMs - newer.timeMs) >= 0) {
+                    // Render time after the newest sample of the pair, hold it
+                    x = newer.x;
+                    y = newer.y;
+                    break;
+                }
+                unsigned long spanMs = newer.timeMs - older.timeMs;
+                float t = spanMs > 0 ? static_cast<float>(renderTimeMs - older.timeMs) / static_cast<float>(spanMs) : 1.0f;
+                x = older.x + (newer.x - older.x) * t;
+                y = older.y + (newer.y - older.y) * t;
+                break;
+            }
+            break;
+        }
+
+        case ControllerReconstructionMode::EXTRAPOLATE: {
+            // Project the last sample forward using the velocity estimated from the last two samples
+            const ControllerSample& previous = history.get(1);
+            unsigned long spanMs = latest.timeMs - previous.timeMs;
+            if (spanMs == 0) {
+                break;
+            }
+            unsigned long aheadMs = nowMs - latest.timeMs;
+            if (aheadMs > maxExtrapolationMs) {
+                aheadMs = maxExtrapolationMs;
+            }
+            float t = static_cast<float>(aheadMs) / static_cast<float>(spanMs);
+            // The samples are stick deflections normalized to the axis range [-1, 1] (the range Game::update
+            // accepts): a projection beyond the end of the stick travel is a deflection the player cannot make
+            x = constrain(latest.x + (latest.x - previous.x) * t, -1.0f, 1.0f);
+            y = constrain(latest.y + (latest.y - previous.y) * t, -1.0f, 1.0f);
+            break;
+        }
+    }
+}
+
+ControllerTelemetry Controller::getTelemetry() {
+    portENTER_CRITICAL(&statusMux);
+    ControllerTelemetry snapshot = telemetry;
+    portEXIT_CRITICAL(&statusMux);
+
+    // Malformed lines are discarded by SerialComm before reaching the controller
+    snapshot.parseErrors += serialComm.getFormatErrorCount() - formatErrorsAtReset;
+    return snapshot;
+}
+
+void Controller::resetTelemetry() {
+    portENTER_CRITICAL(&statusMux);
+    telemetry = {};
+    telemetry.sinceMs = millis();
+    formatErrorsAtReset = serialComm.getFormatErrorCount();
+    portEXIT_CRITICAL(&statusMux);
+}
+
 void Controller::update() {
     while (true) {
         SerialCommand cmd = serialComm.readCommands();
         while (cmd.isValid) {
             if (cmd.command == "DATA") {
-                // Expected format: "DATA:<x value>,<y value>,<button state>"
+                // Expected format: "DATA:<x value>##<y value>##<button state>[##<sequence number>]"
                 SerialCommandReader reader(cmd);
                 float xVal, yVal;
                 bool buttonVal;
                 if (reader.getFloat(xVal) && reader.getFloat(yVal) && reader.getBool(buttonVal)) {
-                    updateStatus(xVal, yVal, buttonVal);
+                    uint32_t sequence = 0;
+                    bool hasSequence = reader.getUInt32(sequence);
+                    updateStatus(xVal, yVal, buttonVal, hasSequence, sequence);
                 } else {
-                    SerialCommandReader reader(cmd);
-                    Serial.println("X value valid: " + String(reader.getFloat(xVal)));
-                    Serial.println("Y value valid: " + String(reader.getFloat(yVal)));
-                    Serial.println("Button value valid: " + String(reader.getBool(buttonVal)));
-                    Serial.println("Invalid DATA command format: " + cmd.values);
+                    portENTER_CRITICAL(&statusMux);
+                    telemetry.parseErrors++;
+                    portEXIT_CRITICAL(&statusMux);
                 }
             } else {
-                Serial.println("Unknown command received: " + cmd.command);
+                portENTER_CRITICAL(&statusMux);
+                telemetry.unknownCommands++;
+                portEXIT_CRITICAL(&statusMux);
             }
             cmd = serialComm.readCommands();            
         }
 
+        applyHMIMode();
+        if (adaptiveUpdateRate && millis() - lastRateAdaptationMs >= kRateAdaptationPeriodMs) {
+            adaptUpdateRate(millis());
+        }
+
         delay(updateRateMs >> 4); // Small delay to prevent busy looping
     }
 }
@@ -3,6 +3,8 @@
 #include <Arduino.h>
 
 #include "ControllerConfig.h"
+#include "ControllerSampleHistory.hpp"
+#include "ControllerTelemetry.hpp"
 #include <SerialComm.hpp>
 #include <SerialCommandReader.hpp>
 
@@ -48,7 +50,7 @@ public:
      * Gets the current update rate in milliseconds.
      * The update rate is sent to the controller and the controller is expected to send updates 
      * at approximately this rate. The controller will be considered unresponsive if no updates 
-     * are received for more than 2 times this duration.
+     * are received within the staleness timeout (see getStalenessTimeoutMs).
      * @return The update rate in milliseconds.
      */
     uint16_t getUpdateRate() const {
@@ -56,12 +58,77 @@ public:
     }
 
     /**
-     * Sets the update rate in milliseconds.
+     * Sets the update rate in milliseconds. The link statistics are restarted from the new nominal rate.
+     * When the adaptive update rate is enabled the rate may be changed again by the update task, so call it
+     * from begin() or from the update task only.
      * @param rateMs The update rate in milliseconds.
      */
-    void setUpdateRate(uint16_t rateMs) {
-        updateRateMs = rateMs;
-        serialComm.sendControllerParams(maxAngle, updateRateMs);
+    void setUpdateRate(uint16_t rateMs);
+
+    /**
+     * Sets the HMI mode of the remote controller. The mode is forwarded to the controller and, when the
+     * adaptive update rate is enabled, selects the preferred update rate: fast while the player is using
+     * the controller, slow in attract mode. The change is posted to the update task, which owns the link
+     * parameters, so the mode can be set from any task.
+     * @param mode Desired HMI mode.
+     */
+    void setHMIMode(SerialComm::ControllerHMIMode mode);
+
+    /**
+     * Gets the current HMI mode of the remote controller.
+     * @return The last HMI mode set with setHMIMode.
+     */
+    SerialComm::ControllerHMIMode getHMIMode() const {
+        return hmiMode;
+    }
+
+    /**
+     * Gets the time without samples after which the controller is considered unresponsive.
+     * The timeout follows the measured inter-arrival time and jitter of the controller samples.
+     * @return The staleness timeout in milliseconds.
+     */
+    uint16_t getStalenessTimeoutMs() const {
+        return stalenessTimeoutMs;
+    }
+
+    /**
+     * Gets the smoothed inter-arrival time of the controller samples.
+     * @return The mean inter-arrival time in milliseconds.
+     */
+    float getMeanIntervalMs() const {
+        return meanIntervalMs;
+    }
+
+    /**
+     * Gets the smoothed inter-arrival jitter (mean absolute deviation) of the controller samples.
+     * @return The inter-arrival jitter in milliseconds.
+     */
+    float getIntervalJitterMs() const {
+        return intervalJitterMs;
+    }
+
+    /**
+     * Gets the smoothed ratio of controller samples lost on the link.
+     * @return The estimated loss ratio in range [0, 1].
+     */
+    float getLossRatio() const {
+        return lossRatio;
+    }
+
+    /**
+     * Gets the reconstruction strategy applied to the controller samples by getStatus.
+     * @return The current reconstruction mode.
+     */
+    ControllerReconstructionMode getReconstructionMode() const {
+        return reconstructionMode;
+    }
+
+    /**
+     * Sets the reconstruction strategy applied to the controller samples by getStatus.
+     * @param mode The reconstruction mode to use.
+     */
+    void setReconstructionMode(ControllerReconstructionMode mode) {
+        reconstructionMode = mode;
     }
 
     /**
@@ -85,6 +152,8 @@ public:
 
     /**
      * Gets the current status of the controller.
+     * The returned x and y values are reconstructed from the recent samples according to the configured
+     * reconstruction mode, so they change smoothly even when called faster than the controller update rate.
      * @param x Reference to store the current x angle.
      * @param y Reference to store the current y angle.
      * @param buttonPressed Reference to store the current button pressed status.
@@ -92,6 +161,17 @@ public:
      */
     bool getStatus(float& x, float& y, bool& buttonPressed);
 
+    /**
+     * Gets a snapshot of the link telemetry counters.
+     * @return The telemetry accumulated since the last reset.
+     */
+    ControllerTelemetry getTelemetry();
+
+    /**
+     * Resets the link telemetry counters (e.g. at the start of each game).
+     */
+    void resetTelemetry();
+
     /**
      * Updates the controller's internal state by processing incoming data from the controller.
      * This method should be called in a task to ensure the controller's status is up-to-date.
@@ -101,14 +181,42 @@ public:
 private:
     SerialComm& serialComm;
 
-    float xAngle = 0.0f;
-    float yAngle = 0.0f;
+    static constexpr uint8_t SAMPLE_HISTORY_SIZE = 4;
+
+    ControllerSampleHistory<SAMPLE_HISTORY_SIZE> sampleHistory;
     bool isButtonPressed = false;
     unsigned long lastUpdateTime = 0;
+    ControllerTelemetry telemetry = {};
+    uint32_t lastSequence = 0;
+    bool hasSequence = false;
+    uint32_t formatErrorsAtReset = 0;
+    portMUX_TYPE statusMux = portMUX_INITIALIZER_UNLOCKED;
     
     float maxAngle;
     uint16_t updateRateMs;
     bool isEnabled = false;
-
-    void updateStatus(float xAngle, float yAngle, bool isButtonPressed);    
+    SerialComm::ControllerHMIMode hmiMode = SerialComm::ControllerHMIMode::NO_GAME;
+    bool hmiModePending = false;    // Set by setHMIMode, guarded by statusMux: the update task sends the mode
+    ControllerReconstructionMode reconstructionMode = ControllerReconstructionMode::HOLD;
+    uint16_t maxExtrapolationMs = 0;
+
+    // Link statistics and update rate adaptation
+    bool adaptiveUpdateRate = false;
+    uint16_t minUpdateRateMs;
+    uint16_t maxUpdateRateMs;
+    float meanIntervalMs = 0.0f;
+    float intervalJitterMs = 0.0f;
+    float lossRatio = 0.0f;
+    float backoffRateMs = 0.0f;
+    uint16_t stalenessTimeoutMs;
+    unsigned long lastRateAdaptationMs = 0;
+    uint8_t rateSwitchSamples = 0;  // Samples to leave out of the link statistics after a rate switch
+
+    void updateStatus(float xAngle, float yAngle, bool isButtonPressed, bool hasSequence, uint32_t sequence);
+    void resetLinkStats();
+    uint16_t inferMissedSamples(unsigned long intervalMs) const;
+    void updateLinkStats(unsigned long intervalMs, uint16_t missed);
+    void applyHMIMode();
+    void adaptUpdateRate(unsigned long nowMs);
+    void reconstructSample(const ControllerSampleHistory<SAMPLE_HISTORY_SIZE>& history, unsigned long nowMs, float& x, float& y) const;
 };
\ No newline at end of file
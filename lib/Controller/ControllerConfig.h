@@ -2,7 +2,26 @@
 
 #include <Arduino.h>
 
+/**
+ * Strategy used to reconstruct the controller position between two consecutive samples received from the remote.
+ * - HOLD: return the last received sample (staircase output).
+ * - INTERPOLATE: linearly interpolate between the last two samples, delayed by one update period.
+ * - EXTRAPOLATE: project the last sample forward using the velocity of the last two samples (clamped).
+ */
+enum class ControllerReconstructionMode : uint8_t {
+    HOLD = 0,
+    INTERPOLATE = 1,
+    EXTRAPOLATE = 2
+};
+
 struct ControllerConfig {
     float maxAngle;         // Maximum angle in range [0, 1]
     uint16_t updateRateMs;  // Update rate in milliseconds
+
+    ControllerReconstructionMode reconstructionMode; // Reconstruction strategy applied between controller samples
+    uint16_t maxExtrapolationMs;                     // Maximum time in milliseconds the last sample can be extrapolated ahead
+
+    bool adaptiveUpdateRate;    // Adapt the update rate to the HMI mode and to the measured link quality
+    uint16_t minUpdateRateMs;   // Fastest update rate in milliseconds, used while the player is controlling the table
+    uint16_t maxUpdateRateMs;   // Slowest update rate in milliseconds, used in attract mode or when the link is degraded
 };
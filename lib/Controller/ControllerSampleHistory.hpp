@@ -0,0 +1,66 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * Timestamped controller sample as received from the remote controller.
+ */
+struct ControllerSample {
+    unsigned long timeMs;   ///< Reception time in milliseconds (millis())
+    float x;                ///< X axis value in range [-1, 1]
+    float y;                ///< Y axis value in range [-1, 1]
+};
+
+/**
+ * @brief Fixed size circular history of the most recent controller samples.
+ * 
+ * The oldest sample is overwritten when the history is full. Index 0 always refers 
+ * to the most recent sample, index 1 to the previous one and so on.
+ * 
+ * @tparam N Number of samples kept in the history
+ */
+template <uint8_t N>
+class ControllerSampleHistory {
+private:
+    ControllerSample samples[N];
+    uint8_t head = 0;   ///< Index where the next sample will be written
+    uint8_t count = 0;  ///< Number of valid samples
+
+public:
+    /**
+     * @brief Add a new sample to the history, overwriting the oldest one when full
+     * @param sample The sample to add
+     */
+    void push(const ControllerSample& sample) {
+        samples[head] = sample;
+        head = (head + 1) % N;
+        if (count < N) {
+            count++;
+        }
+    }
+
+    /**
+     * @brief Get a sample by age
+     * @param age 0 for the most recent sample, 1 for the previous one, ...
+     * @return Reference to the requested sample. The age must be lower than size()
+     */
+    const ControllerSample& get(uint8_t age) const {
+        return samples[(head + N - 1 - age) % N];
+    }
+
+    /**
+     * @brief Get the number of valid samples in the history
+     * @return Number of valid samples
+     */
+    uint8_t size() const {
+        return count;
+    }
+
+    /**
+     * @brief Remove all the samples from the history
+     */
+    void clear() {
+        head = 0;
+        count = 0;
+    }
+};
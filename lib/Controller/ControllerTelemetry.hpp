@@ -0,0 +1,57 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * Counters describing the health of the link with the remote controller. They are updated by the controller
+ * RX path with a handful of increments per frame, so they can stay enabled during the game.
+ */
+struct ControllerTelemetry {
+    static constexpr uint8_t HISTOGRAM_BUCKETS = 16;       ///< Number of inter-arrival histogram buckets
+    static constexpr uint8_t HISTOGRAM_BUCKET_SHIFT = 4;   ///< Bucket width as a power of two: 16 ms
+
+    uint32_t framesReceived;            ///< Valid DATA frames received
+    uint32_t parseErrors;               ///< Malformed lines or DATA frames with invalid values
+    uint32_t unknownCommands;           ///< Well formed lines with an unknown command
+    uint32_t sequenceGaps;              ///< Discontinuities in the DATA sequence number (when sent by the controller)
+    uint32_t missedFrames;              ///< Frames lost according to the sequence numbers or, without them, to the arrival times
+    uint32_t intervalHistogram[HISTOGRAM_BUCKETS]; ///< Inter-arrival times in 16 ms buckets, the last bucket collects the longer ones
+    uint32_t longestStaleMs;            ///< Longest time between two consecutive DATA frames
+    uint32_t staleStatusInGame;         ///< Number of getStatus calls that returned false while IN_GAME
+    unsigned long sinceMs;              ///< millis() of the last reset
+
+    /**
+     * Get the histogram bucket for an inter-arrival time
+     * @param intervalMs Inter-arrival time in milliseconds
+     * @return The bucket index
+     */
+    static inline uint8_t histogramBucket(unsigned long intervalMs) {
+        unsigned long bucket = intervalMs >> HISTOGRAM_BUCKET_SHIFT;
+        return bucket < HISTOGRAM_BUCKETS ? static_cast<uint8_t>(bucket) : HISTOGRAM_BUCKETS - 1;
+    }
+
+    /**
+     * Print the telemetry in a human readable format
+     * @param out Where to print the telemetry (e.g. Serial)
+     */
+    void printTo(Print& out) const {
+        out.printf("Controller link telemetry (last %lu ms)\n", millis() - sinceMs);
+        out.printf("  frames received:      %lu\n", (unsigned long)framesReceived);
+        out.printf("  parse errors:         %lu\n", (unsigned long)parseErrors);
+        out.printf("  unknown commands:     %lu\n", (unsigned long)unknownCommands);
+        out.printf("  sequence gaps:        %lu\n", (unsigned long)sequenceGaps);
+        out.printf("  missed frames:        %lu\n", (unsigned long)missedFrames);
+        out.printf("  longest stale period: %lu ms\n", (unsigned long)longestStaleMs);
+        out.printf("  stale status in game: %lu\n", (unsigned long)staleStatusInGame);
+        out.printf("  inter-arrival histogram:\n");
+        for (uint8_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+            unsigned long fromMs = (unsigned long)i << HISTOGRAM_BUCKET_SHIFT;
+            if (i < HISTOGRAM_BUCKETS - 1) {
+                unsigned long toMs = fromMs + (1UL << HISTOGRAM_BUCKET_SHIFT) - 1;
+                out.printf("    %3lu-%3lu ms: %lu\n", fromMs, toMs, (unsigned long)intervalHistogram[i]);
+            } else {
+                out.printf("    >=%3lu ms:   %lu\n", fromMs, (unsigned long)intervalHistogram[i]);
+            }
+        }
+    }
+};
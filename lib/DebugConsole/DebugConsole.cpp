@@ -0,0 +1,69 @@
+#include "DebugConsole.hpp"
+
+bool DebugConsole::registerCommand(const char* name, const char* help, CommandHandler handler) {
+    if (commandCount >= MAX_COMMANDS || name == nullptr || handler == nullptr) {
+        return false;
+    }
+
+    commands[commandCount++] = {name, help, handler};
+    return true;
+}
+
+void DebugConsole::update() {
+    while (true) {
+        while (stream.available() > 0) {
+            int c = stream.read();
+            if (c < 0) {
+                break;
+            }
+
+            if (c == '\n' || c == '\r') {
+                if (lineOverflow) {
+                    stream.println("Command too long");
+                } else if (lineLength > 0) {
+                    lineBuffer[lineLength] = '\0';
+                    execute(lineBuffer);
+                }
+                lineLength = 0;
+                lineOverflow = false;
+            } else if (lineLength < MAX_LINE_LENGTH) {
+                lineBuffer[lineLength++] = static_cast<char>(c);
+            } else {
+                lineOverflow = true;
+            }
+        }
+
+        delay(50); // Commands are typed by a human, no need to poll faster
+    }
+}
+
+void DebugConsole::execute(char* line) {
+    // Split the line in command name and arguments
+    char* args = strchr(line, ' ');
+    if (args != nullptr) {
+        *args = '\0';
+        args++;
+        while (*args == ' ') {
+            args++;
+        }
+    } else {
+        args = line + strlen(line);
+    }
+
+    if (strcasecmp(line, "HELP") == 0) {
+        stream.println("Available commands:");
+        for (uint8_t i = 0; i < commandCount; i++) {
+            stream.printf("  %-16s %s\n", commands[i].name, commands[i].help != nullptr ? commands[i].help : "");
+        }
+        return;
+    }
+
+    for (uint8_t i = 0; i < commandCount; i++) {
+        if (strcasecmp(line, commands[i].name) == 0) {
+            commands[i].handler(stream, args);
+            return;
+        }
+    }
+
+    stream.printf("Unknown command: %s (type HELP for the list of commands)\n", line);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * DebugConsole provides a minimal line based command interpreter on a stream (usually the USB serial).
+ * Each line is made of a command name optionally followed by a space and its arguments. The registered handler
+ * of the matching command is called with the stream to print the answer and the arguments string.
+ * The "HELP" command is built in and lists the registered commands. The update method should be called in a task.
+ */
+class DebugConsole {
+public:
+    /**
+     * Command handler signature.
+     * @param out Stream where the command output must be printed.
+     * @param args Arguments following the command name (can be empty).
+     */
+    typedef void (*CommandHandler)(Print& out, const char* args);
+
+    /**
+     * Constructor for DebugConsole.
+     * @param stream Reference to the stream used to read the commands and print the answers.
+     */
+    DebugConsole(Stream& stream) : stream(stream) {}
+
+    /**
+     * Registers a new command. Commands are matched case insensitively.
+     * @param name The command name. The string must stay valid for the whole console life (e.g. a literal).
+     * @param help Short description printed by the HELP command. Same lifetime requirements as name.
+     * @param handler Function called when the command is received.
+     * @return true if the command was registered, false if there is no room for more commands.
+     */
+    bool registerCommand(const char* name, const char* help, CommandHandler handler);
+
+    /**
+     * Reads and executes the incoming commands. This method never returns and should be called in a task.
+     */
+    void update();
+
+private:
+    static constexpr uint8_t MAX_COMMANDS = 32;
+    static constexpr size_t MAX_LINE_LENGTH = 63;
+
+    struct Command {
+        const char* name;
+        const char* help;
+        CommandHandler handler;
+    };
+
+    Stream& stream;
+    Command commands[MAX_COMMANDS];
+    uint8_t commandCount = 0;
+    char lineBuffer[MAX_LINE_LENGTH + 1];
+    size_t lineLength = 0;
+    bool lineOverflow = false;
+
+    void execute(char* line);
+};
@@ -2,45 +2,80 @@
 
 namespace {
     constexpr uint16_t kDefaultCenterPulseUs = 1500;
+    constexpr uint8_t kImuFifoSampleRateDivider = 4; // 200Hz IMU sample rate for the tilt measurement
+    constexpr uint8_t kMeasureSeedSamples = 20;     // Accelerometer samples averaged to seed a table angle measurement
+    constexpr uint8_t kMeasureWindowSamples = 20;   // Samples fused by a table angle measurement after the seed
+    constexpr uint8_t kMeasureWindowPeriodMs = 5;   // Period of the samples of a table angle measurement
+    constexpr uint16_t kCalibrationSettleMs = 300;  // Servo settle time before a calibration measurement
+    constexpr float kMaxWarmStartCorrectionDeg = 3.0f;  // Largest drift corrected with the stored tilt model
+    constexpr int64_t kIgnoredBallDropEdgeUs = INT64_MAX;   // Marks a sensor pulse that started before the game
 }
 
 Game::Game(HardwareServo& xServo, HardwareServo& yServo) 
-    : xServo(xServo), yServo(yServo) {
-        xServoRamp = SlewRateLimiter<int16_t>(kDefaultCenterPulseUs, 200.0f); // Default max rate: 200us/sec
-        yServoRamp = SlewRateLimiter<int16_t>(kDefaultCenterPulseUs, 200.0f); // Default max rate: 200us/sec
+    : xServo(xServo), yServo(yServo), motionLoop(xServo, yServo, kDefaultCenterPulseUs) {
     }
 
-void IRAM_ATTR Game::setBallDropped() {
+void IRAM_ATTR Game::setBallDropSignal(bool active) {
+    int64_t nowUs = esp_timer_get_time();
     portENTER_CRITICAL_ISR(&ballDroppedMux);
-    ballDropped = true;
+    if (active && !ballDropSignalActive) {
+        ballDropEdgeUs = nowUs;
+    } else if (!active && ballDropSignalActive && ballDropEdgeUs != kIgnoredBallDropEdgeUs) {
+        // A pulse too short for a ball is electrical noise (e.g. from the servos)
+        if (nowUs - ballDropEdgeUs >= config.ballDropMinPulseUs) {
+            if (ballDroppedAtUs == 0) {
+                ballDroppedAtUs = ballDropEdgeUs;
+            }
+        } else {
+            ballDropGlitches++;
+        }
+    }
+    ballDropSignalActive = active;
     portEXIT_CRITICAL_ISR(&ballDroppedMux);
 }
 
 void Game::resetBallDroppedFlag() {
     portENTER_CRITICAL(&ballDroppedMux);
-    ballDropped = false;
+    ballDroppedAtUs = 0;
+    // A pulse already in progress started before the game: do not accept it
+    ballDropEdgeUs = ballDropSignalActive ? kIgnoredBallDropEdgeUs : 0;
     portEXIT_CRITICAL(&ballDroppedMux);
 }
 
-bool Game::consumeBallDroppedFlag() {
-    bool dropped;
+bool Game::consumeBallDroppedFlag(int64_t nowUs, int64_t& droppedAtUs) {
     portENTER_CRITICAL(&ballDroppedMux);
-    dropped = ballDropped;
-    ballDropped = false;
+    // Accept a pulse still in progress once it lasted long enough
+    if (ballDroppedAtUs == 0 && ballDropSignalActive && ballDropEdgeUs != kIgnoredBallDropEdgeUs &&
+        nowUs - ballDropEdgeUs >= config.ballDropMinPulseUs) {
+        ballDroppedAtUs = ballDropEdgeUs;
+    }
+    droppedAtUs = ballDroppedAtUs;
+    ballDroppedAtUs = 0;
     portEXIT_CRITICAL(&ballDroppedMux);
-    return dropped;
+    return droppedAtUs != 0;
 }
 
 void Game::begin(const GameConfig config) {
     this->config = config;
-    xServoRamp.setMaxRate(config.maxServoPulseRate);
-    yServoRamp.setMaxRate(config.maxServoPulseRate);
+    if (!calibrationStore.begin()) {
+        Serial.println("Failed to open the servo calibration store");
+    }
+    motionLoop.setMaxRate(config.maxServoPulseRate);
+    motionLoop.setAccelerationLimits(config.maxServoPulseAccel, config.maxServoPulseJerk);
+    tiltController.begin(config.tiltKp, config.tiltKi, config.tiltKd, config.tiltMaxCorrectionPulseUs,
+        2 * config.tiltSensorPeriodMs);
+    motionLoop.setTiltController(&tiltController);
+    if (!motionLoop.begin(config.servoLoopRateHz)) {
+        Serial.println("Failed to start the servo motion loop");
+    }
+    if (!telemetry.begin(config.telemetryCapacityRecords, config.telemetryMaxGames)) {
+        Serial.println("Failed to allocate the telemetry buffer, games are not recorded");
+    }
 
     // Initialize game state
     status = GameStatus::NOT_RUNNING;
     currentTimeLimitMs = 0;
     startTimeMs = 0;
-    lastUpdateMs = millis();
 
     // Initialize last game results
     lastGameResult = GameResult::NONE;
@@ -55,10 +90,13 @@ void Game::prepareGame() {
 
     status = GameStatus::PREPARING;
     // Move servos to center position before starting the game
-    xServoRamp.setMaxRate(config.prepareGamePulseRate);
-    yServoRamp.setMaxRate(config.prepareGamePulseRate);
-    xServoRamp.setTarget(static_cast<int16_t>(xCenterPulseUs) + config.prepareGameXPulseus);
-    yServoRamp.setTarget(static_cast<int16_t>(yCenterPulseUs) + config.prepareGameYPulseus);
+    motionLoop.setMaxRate(config.prepareGamePulseRate);
+    motionLoop.setTargets(static_cast<int16_t>(xCenterPulseUs) + config.prepareGameXPulseus,
+            static_cast<int16_t>(yCenterPulseUs) + config.prepareGameYPulseus);
+
+    int64_t nowUs = esp_timer_get_time();
+    telemetry.beginGame(nowUs);
+    recordTelemetry(TelemetryRecordType::START, nowUs);
 }
 
 void Game::start(GameLevel level) {
@@ -67,16 +105,17 @@ void Game::start(GameLevel level) {
     }
 
     // Move the servos quickly in the opposite direction of the prepareGame to kick the ball away from the holder
-    xServoRamp.setMaxRate(config.maxServoPulseRate);
-    yServoRamp.setMaxRate(config.maxServoPulseRate);
-    xServoRamp.setTarget(static_cast<int16_t>(xCenterPulseUs) - config.prepareGameXPulseus);
-    yServoRamp.setTarget(static_cast<int16_t>(yCenterPulseUs) - config.prepareGameYPulseus);
+    motionLoop.setMaxRate(config.maxServoPulseRate);
+    motionLoop.setTargets(static_cast<int16_t>(xCenterPulseUs) - config.prepareGameXPulseus,
+            static_cast<int16_t>(yCenterPulseUs) - config.prepareGameYPulseus);
+    recordTelemetry(TelemetryRecordType::KICKBACK, esp_timer_get_time());
     delay(config.prepareKickBackDelayMs);
     
     // Let's the player control the servos after the kick back
     currentLevel = level;
     currentTimeLimitMs = getTimeLimitMs(level);
     startTimeMs = millis();
+    startTimeUs = esp_timer_get_time();
     status = GameStatus::RUNNING;
     resetBallDroppedFlag();
 }
@@ -86,11 +125,14 @@ void Game::stop() {
         return;
     }
 
+    recordTelemetry(TelemetryRecordType::STOP, esp_timer_get_time());
+    telemetry.endGame(static_cast<uint8_t>(currentLevel), static_cast<uint8_t>(GameResult::NONE), 0);
     status = GameStatus::NOT_RUNNING;
+    tiltController.setEnabled(false);
 
     // Reset servos to center position
-    xServoRamp.setTarget(static_cast<int16_t>(xCenterPulseUs));
-    yServoRamp.setTarget(static_cast<int16_t>(yCenterPulseUs));
+    motionLoop.setTargets(static_cast<int16_t>(xCenterPulseUs),
+            static_cast<int16_t>(yCenterPulseUs));
 
     // Clear last game results
     lastGameResult = GameResult::NONE;
@@ -98,28 +140,40 @@ void Game::stop() {
 }
 
 void Game::update(float controllerX, float controllerY) {
-    unsigned long nowMs = millis();
+    int64_t nowUs = esp_timer_get_time();
+    lastControllerX = controllerX;
+    lastControllerY = controllerY;
     if (status == GameStatus::RUNNING) {
-        // Check if the game time limit has been exceeded
-        unsigned long elapsedMs = nowMs - startTimeMs;
-        if (currentTimeLimitMs > 0 && elapsedMs >= currentTimeLimitMs) {
-            status = GameStatus::NOT_RUNNING;
-            xServoRamp.setTarget(static_cast<int16_t>(xCenterPulseUs));
-            yServoRamp.setTarget(static_cast<int16_t>(yCenterPulseUs));
-            lastGameResult = GameResult::LOST;
-            lastGameCompletionTimeMs = currentTimeLimitMs;
+        // Check if the ball has been dropped within the time limit, timed by the sensor interrupt rather than
+        // by this loop
+        int64_t droppedAtUs;
+        int64_t timeLimitUs = static_cast<int64_t>(currentTimeLimitMs) * 1000;
+        if (consumeBallDroppedFlag(nowUs, droppedAtUs) &&
+            (currentTimeLimitMs == 0 || droppedAtUs - startTimeUs < timeLimitUs)) {
+            int64_t completionUs = max<int64_t>(droppedAtUs - startTimeUs, 0);
+            recordTelemetry(TelemetryRecordType::DROP, droppedAtUs);
+            status = GameStatus::DROPPING_BALL;
+            tiltController.setEnabled(false);
+            motionLoop.setTargets(config.ballDropXDeltaPulseUs + static_cast<int16_t>(xCenterPulseUs),
+                    config.ballDropYDeltaPulseUs + static_cast<int16_t>(yCenterPulseUs));
+            timer.load(config.ballDropTimeMs);
+            lastGameResult = GameResult::WON;
+            lastGameCompletionTimeMs = static_cast<uint32_t>((completionUs + 500) / 1000);
             lastGameLevel = currentLevel;
             return;
         }
 
-        // Check if the ball has been dropped
-        if (consumeBallDroppedFlag()) {
-            status = GameStatus::DROPPING_BALL;
-            xServoRamp.setTarget(config.ballDropXDeltaPulseUs + static_cast<int16_t>(xCenterPulseUs));
-            yServoRamp.setTarget(config.ballDropYDeltaPulseUs + static_cast<int16_t>(yCenterPulseUs));
-            timer.load(config.ballDropTimeMs);
-            lastGameResult = GameResult::WON;
-            lastGameCompletionTimeMs = elapsedMs;
+        // Check if the game time limit has been exceeded
+        if (currentTimeLimitMs > 0 && nowUs - startTimeUs >= timeLimitUs) {
+            recordTelemetry(TelemetryRecordType::TIMEOUT, nowUs);
+            telemetry.endGame(static_cast<uint8_t>(currentLevel), static_cast<uint8_t>(GameResult::LOST),
+                currentTimeLimitMs);
+            status = GameStatus::NOT_RUNNING;
+            tiltController.setEnabled(false);
+            motionLoop.setTargets(static_cast<int16_t>(xCenterPulseUs),
+                    static_cast<int16_t>(yCenterPulseUs));
+            lastGameResult = GameResult::LOST;
+            lastGameCompletionTimeMs = currentTimeLimitMs;
             lastGameLevel = currentLevel;
             return;
         }
@@ -131,31 +185,28 @@ void Game::update(float controllerX, float controllerY) {
         float halfRangeUs = static_cast<float>(config.servoPulseRange) * 0.5f;
         float targetPulseXUs = xCenterPulseUs + (clampedX * halfRangeUs);
         float targetPulseYUs = yCenterPulseUs + (clampedY * halfRangeUs);
-        xServoRamp.setTarget(static_cast<int16_t>(targetPulseXUs));
-        yServoRamp.setTarget(static_cast<int16_t>(targetPulseYUs));
+        motionLoop.setTargets(static_cast<int16_t>(targetPulseXUs),
+                static_cast<int16_t>(targetPulseYUs));
+
+        // In closed-loop mode the controller commands the table tilt and the open-loop pulse is the feedforward
+        if (config.tiltControlEnabled) {
+            tiltController.setTargetTilt(clampedX * config.tiltMaxAngleDeg, clampedY * config.tiltMaxAngleDeg);
+            tiltController.setEnabled(true);
+        }
     }
+    recordTelemetry(TelemetryRecordType::SAMPLE, nowUs);
     if (status == GameStatus::DROPPING_BALL) {
         // During ball dropping controller is not used and wait for the ball to reach
         // the back collection box
         if (timer.isElapsed()) {
             // Ball has reached the back collection box, ready for next game
+            telemetry.endGame(static_cast<uint8_t>(lastGameLevel), static_cast<uint8_t>(lastGameResult),
+                lastGameCompletionTimeMs);
             status = GameStatus::NOT_RUNNING;
-            xServoRamp.setTarget(static_cast<int16_t>(xCenterPulseUs));
-            yServoRamp.setTarget(static_cast<int16_t>(yCenterPulseUs));
+            motionLoop.setTargets(static_cast<int16_t>(xCenterPulseUs),
+                    static_cast<int16_t>(yCenterPulseUs));
         }
     }
-
-    // Update servo positions with slew rate limiting
-    unsigned long deltaMs = nowMs - lastUpdateMs;
-    lastUpdateMs = nowMs;
-    xServoRamp.update(deltaMs);
-    yServoRamp.update(deltaMs);
-
-    // Apply updated servo positions to the hardware except when calibration is in progress
-    if (!calibrationInProgress) {
-        xServo.setPulseWidth(static_cast<uint16_t>(xServoRamp.getCurrentValue()));
-        yServo.setPulseWidth(static_cast<uint16_t>(yServoRamp.getCurrentValue()));
-    }
 }
 
 bool Game::isRunning() const {
@@ -166,13 +217,135 @@ bool Game::isReadyToStart() const {
     return status == GameStatus::NOT_RUNNING;
 }
 
-void Game::lastGameStats(GameLevel& level, GameResult& result, uint16_t& completionTime) const {
+void Game::lastGameStats(GameLevel& level, GameResult& result, uint32_t& completionTime) const {
     level = lastGameLevel;
     result = lastGameResult;
     completionTime = lastGameCompletionTimeMs;
 }
 
-uint16_t Game::getTimeLimitMs(GameLevel level) const {
+void Game::tiltSensorLoop(MPU6886& imu) {
+    // Stream the IMU samples through its FIFO, so every sample is used with a single burst read per period
+    if (!imu.beginFifo(kImuFifoSampleRateDivider)) {
+        Serial.println("Failed to start the IMU FIFO");
+    }
+
+    bool wasEnabled = false;
+    while (true) {
+        // The IMU is read only while the loop is closed, to leave the I2C bus free otherwise
+        if (tiltController.isEnabled()) {
+            if (!wasEnabled) {
+                // Discard the samples collected while the loop was open and restart the orientation from them
+                imu.resetFifo();
+                orientation.reset();
+                wasEnabled = true;
+            }
+
+            // Fuse every sample of the last period into the table orientation
+            imu.readFifo();
+            MPU6886Sample sample;
+            bool newSamples = false;
+            while (imu.popSample(sample)) {
+                orientation.update(imu.gyroToDps(sample.gyro[0]), imu.gyroToDps(sample.gyro[1]),
+                    imu.gyroToDps(sample.gyro[2]), imu.accelToG(sample.accel[0]), imu.accelToG(sample.accel[1]),
+                    imu.accelToG(sample.accel[2]), sample.timestampUs);
+                newSamples = true;
+            }
+
+            if (newSamples && orientation.isInitialized()) {
+                float gravityX, gravityY, gravityZ;
+                float angleXDeg, angleYDeg;
+                orientation.getGravity(gravityX, gravityY, gravityZ);
+                accelToTableAngles(gravityX, gravityY, angleXDeg, angleYDeg);
+                tiltController.setMeasuredTilt(angleXDeg - config.servoCalibrationTargetAngleXDeg,
+                    angleYDeg - config.servoCalibrationTargetAngleYDeg, orientation.getTimestampUs());
+            }
+        } else {
+            wasEnabled = false;
+        }
+        delay(config.tiltSensorPeriodMs);
+    }
+}
+
+void Game::measureTableAngles(MPU6886& imu, float& angleXDeg, float& angleYDeg) {
+    // Seed the filter from an averaged window of accelerometer samples: at a gain of a few 1/s the filter
+    // started from a single sample would still be dominated by its noise at the end of a short window
+    float sumX = 0.0f;
+    float sumY = 0.0f;
+    float sumZ = 0.0f;
+    for (uint8_t i = 0; i < kMeasureSeedSamples; i++) {
+        float accelX, accelY, accelZ;
+        imu.getAccel(&accelX, &accelY, &accelZ);
+        sumX += accelX;
+        sumY += accelY;
+        sumZ += accelZ;
+        delay(kMeasureWindowPeriodMs);
+    }
+
+    // A filter of its own, the TiltSensorTask may be updating the orientation of the tilt control meanwhile.
+    // The samples after the seed follow the table with the gyroscope if it is still moving.
+    OrientationEstimator measurement;
+    measurement.initialize(sumX / kMeasureSeedSamples, sumY / kMeasureSeedSamples, sumZ / kMeasureSeedSamples,
+        micros());
+    for (uint8_t i = 0; i < kMeasureWindowSamples; i++) {
+        float accelX, accelY, accelZ;
+        float gyroX, gyroY, gyroZ;
+        imu.getAccel(&accelX, &accelY, &accelZ);
+        imu.getGyro(&gyroX, &gyroY, &gyroZ);
+        measurement.update(gyroX, gyroY, gyroZ, accelX, accelY, accelZ, micros());
+        delay(kMeasureWindowPeriodMs);
+    }
+
+    float gravityX, gravityY, gravityZ;
+    measurement.getGravity(gravityX, gravityY, gravityZ);
+    accelToTableAngles(gravityX, gravityY, angleXDeg, angleYDeg);
+}
+
+void Game::accelToTableAngles(float accelX, float accelY, float& angleXDeg, float& angleYDeg) {
+    // Invert X and Y accelation to match servo directions
+    accelX = -accelX;
+    accelY = -accelY;
+
+    // Calculate angles from accelerometer data
+    angleXDeg = asin(constrain(accelX, -1.0f, 1.0f)) * 180.0 / M_PI;
+    angleYDeg = asin(constrain(accelY, -1.0f, 1.0f)) * 180.0 / M_PI;
+}
+
+void Game::recordTelemetry(TelemetryRecordType type, int64_t timeUs) {
+    if (!telemetry.isRecording()) {
+        return;
+    }
+
+    int64_t startUs = esp_timer_get_time();
+    TelemetryRecord record = {};
+    record.type = static_cast<uint8_t>(type);
+    record.inputX = static_cast<int16_t>(lroundf(constrain(lastControllerX, -1.0f, 1.0f) * 10000.0f));
+    record.inputY = static_cast<int16_t>(lroundf(constrain(lastControllerY, -1.0f, 1.0f) * 10000.0f));
+
+    int16_t xPulseUs, yPulseUs;
+    motionLoop.getTargets(xPulseUs, yPulseUs);
+    record.targetXUs = xPulseUs;
+    record.targetYUs = yPulseUs;
+    motionLoop.getOutputs(xPulseUs, yPulseUs);
+    record.rampXUs = xPulseUs;
+    record.rampYUs = yPulseUs;
+    record.pulseXUs = xServo.getLastPulseWitdth();
+    record.pulseYUs = yServo.getLastPulseWitdth();
+
+    // The IMU is read only while the tilt control is enabled, the tilt is stale otherwise
+    float tiltXDeg, tiltYDeg;
+    if (tiltController.getMeasuredTilt(tiltXDeg, tiltYDeg)) {
+        record.flags |= TELEMETRY_FLAG_TILT;
+        record.tiltXCdeg = static_cast<int16_t>(lroundf(tiltXDeg * 100.0f));
+        record.tiltYCdeg = static_cast<int16_t>(lroundf(tiltYDeg * 100.0f));
+    }
+    if (tiltController.isEnabled()) {
+        record.flags |= TELEMETRY_FLAG_TILT_CONTROL;
+    }
+
+    telemetry.append(record, timeUs, startUs);
+}
+
+uint32_t Game::getTimeLimitMs(GameLevel level) const {
     switch (level) {
         case GameLevel::EASY:
             return config.easyTimeLimitMs;
@@ -181,36 +354,144 @@ uint16_t Game::getTimeLimitMs(GameLevel level) const {
 }
 
 void Game::servoCalibration(MPU6886& imu) {
-    calibrationInProgress = true;
-    Serial.println("Starting servo calibration...");
+    // Take the servos away from the motion loop while the calibration drives them directly
+    motionLoop.setOutputEnabled(false);
+    unsigned long startMs = millis();
+    calibrationReport = {};
+
+    // Warm start: verify the calibration stored by the previous boot and run the full calibration only on drift
+    ServoCalibration calibration;
+    bool calibrated = false;
+    if (calibrationStore.load(calibration)) {
+        Serial.println("Verifying stored servo calibration...");
+        calibrated = verifyStoredCalibration(imu, calibration);
+    } else {
+        calibration.xCenterPulseUs = kDefaultCenterPulseUs;
+        calibration.yCenterPulseUs = kDefaultCenterPulseUs;
+        calibration.tiltModel = {};
+    }
+
+    if (!calibrated) {
+        Serial.println("Starting servo calibration...");
+        calibrationReport.mode = CalibrationMode::FULL;
+        runFullCalibration(imu, calibration);
+    }
+
+    if (calibrationReport.mode != CalibrationMode::WARM_START && !calibrationStore.save(calibration)) {
+        Serial.println("Failed to store the servo calibration");
+    }
 
-    // Move servos to center position
-    xServo.setPulseWidth(kDefaultCenterPulseUs);
-    yServo.setPulseWidth(kDefaultCenterPulseUs);
+    // Save calibration data
+    xCenterPulseUs = calibration.xCenterPulseUs;
+    yCenterPulseUs = calibration.yCenterPulseUs;
+    motionLoop.reset(static_cast<int16_t>(xCenterPulseUs), static_cast<int16_t>(yCenterPulseUs));
+
+    calibrationReport.durationMs = millis() - startMs;
+    calibrationReport.xCenterPulseUs = xCenterPulseUs;
+    calibrationReport.yCenterPulseUs = yCenterPulseUs;
+    calibrationReport.printTo(Serial);
+    motionLoop.setOutputEnabled(true);
+}
+
+bool Game::verifyStoredCalibration(MPU6886& imu, ServoCalibration& calibration) {
+    xServo.setPulseWidth(calibration.xCenterPulseUs);
+    yServo.setPulseWidth(calibration.yCenterPulseUs);
+    delay(kCalibrationSettleMs);
+
+    float errorX, errorY;
+    measureCalibrationError(imu, errorX, errorY);
+    if (isCalibrationErrorOk(errorX, errorY)) {
+        calibrationReport.mode = CalibrationMode::WARM_START;
+        return true;
+    }
+
+    // Small drift: jump to the corrected pulse widths with the stored servo model and verify once more
+    if (fabsf(errorX) > kMaxWarmStartCorrectionDeg || fabsf(errorY) > kMaxWarmStartCorrectionDeg) {
+        return false;
+    }
+    float pulseUs[2] = {static_cast<float>(calibration.xCenterPulseUs), static_cast<float>(calibration.yCenterPulseUs)};
+    const float tiltDeg[2] = {-errorX, -errorY};
+    const float levelDeg[2] = {0.0f, 0.0f};
+    if (!CalibrationSolver::solve(calibration.tiltModel, pulseUs, tiltDeg, levelDeg)) {
+        return false;
+    }
+    xServo.setPulseWidth(static_cast<uint16_t>(lroundf(pulseUs[0])));
+    yServo.setPulseWidth(static_cast<uint16_t>(lroundf(pulseUs[1])));
+    delay(kCalibrationSettleMs);
+
+    measureCalibrationError(imu, errorX, errorY);
+    if (isCalibrationErrorOk(errorX, errorY)) {
+        calibration.xCenterPulseUs = xServo.getLastPulseWitdth();
+        calibration.yCenterPulseUs = yServo.getLastPulseWitdth();
+        calibrationReport.mode = CalibrationMode::WARM_START_CORRECTED;
+        return true;
+    }
+    return false;
+}
+
+void Game::runFullCalibration(MPU6886& imu, ServoCalibration& calibration) {
+    // Move servos to the starting position
+    xServo.setPulseWidth(calibration.xCenterPulseUs);
+    yServo.setPulseWidth(calibration.yCenterPulseUs);
     delay(1000); // Wait for servos to stabilize
 
-    // Read IMU data to determine current orientation
-    float accelX, accelY, accelZ;
-    imu.getAccel(&accelX, &accelY, &accelZ);
+    if (runSolverCalibration(imu, calibration)) {
+        return;
+    }
+
+    Serial.println("Calibration solver failed, falling back to the proportional loop");
+    calibrationReport.mode = CalibrationMode::FULL_PROPORTIONAL;
+    runProportionalCalibration(imu, calibration);
+}
+
+bool Game::runSolverCalibration(MPU6886& imu, ServoCalibration& calibration) {
+    // Probe each axis to measure the pulse-to-tilt model, then jump to the solved level pulse widths
+    const float startPulseUs[2] = {static_cast<float>(xServo.getLastPulseWitdth()),
+                                   static_cast<float>(yServo.getLastPulseWitdth())};
+    const float targetDeg[2] = {config.servoCalibrationTargetAngleXDeg, config.servoCalibrationTargetAngleYDeg};
+    CalibrationSolver solver;
+    solver.begin(startPulseUs, targetDeg, config.servoCalibrationErrorThresholdDeg,
+                 max(xServo.getMinPulseWidth(), yServo.getMinPulseWidth()),
+                 min(xServo.getMaxPulseWidth(), yServo.getMaxPulseWidth()));
+
+    CalibrationSolver::Status status = CalibrationSolver::Status::RUNNING;
+    bool firstMeasurement = true;
+    while (status == CalibrationSolver::Status::RUNNING) {
+        uint16_t xPulseUs, yPulseUs;
+        solver.getNextPulses(xPulseUs, yPulseUs);
+        if (!firstMeasurement) {
+            xServo.setPulseWidth(xPulseUs);
+            yServo.setPulseWidth(yPulseUs);
+            delay(kCalibrationSettleMs);
+        }
+        firstMeasurement = false;
+
+        float errorX, errorY;
+        measureCalibrationError(imu, errorX, errorY);
+        status = solver.addMeasurement(targetDeg[0] - errorX, targetDeg[1] - errorY);
+    }
+
+    // Keep the model even if the solver failed: the probes measured it and the next warm start can use it
+    solver.getModel(calibration.tiltModel);
+    if (status != CalibrationSolver::Status::CONVERGED) {
+        return false;
+    }
 
+    calibration.xCenterPulseUs = xServo.getLastPulseWitdth();
+    calibration.yCenterPulseUs = yServo.getLastPulseWitdth();
+    return true;
+}
+
+void Game::runProportionalCalibration(MPU6886& imu, ServoCalibration& calibration) {
     int xCalibrationOk = 0;
     int yCalibrationOk = 0;
 
     while (true) {
-        imu.getAccel(&accelX, &accelY, &accelZ);
-
-        // Invert X and Y accelation to match servo directions
-        accelX = -accelX;
-        accelY = -accelY;
-
-        // Calculate angles from accelerometer data
-        float angleX_deg = asin(accelX) * 180.0 / M_PI;
-        float angleY_deg = asin(accelY) * 180.0 / M_PI;
+        float errorX, errorY;
+        measureCalibrationError(imu, errorX, errorY);
 
         // Apply a simple proportional control to move servos towards leveling the table
         float kP = 0.5f; // Proportional gain (adjust as needed)
-        float errorX = config.servoCalibrationTargetAngleXDeg - angleX_deg; // Desired angle is targetAngleXDeg
-        float errorY = config.servoCalibrationTargetAngleYDeg - angleY_deg; // Desired angle is targetAngleYDeg
         if (abs(errorX) < config.servoCalibrationErrorThresholdDeg) {
             xCalibrationOk++;
         } else {
@@ -234,12 +515,26 @@ void Game::servoCalibration(MPU6886& imu) {
         }
     }
 
-    // Save calibration data
-    xCenterPulseUs = xServo.getLastPulseWitdth();
-    yCenterPulseUs = yServo.getLastPulseWitdth();
-    xServoRamp.reset(static_cast<int16_t>(xCenterPulseUs));
-    yServoRamp.reset(static_cast<int16_t>(yCenterPulseUs));
-
-    Serial.println("Servo calibration complete.");
-    calibrationInProgress = false;
-}
\ No newline at end of file
+    calibration.xCenterPulseUs = xServo.getLastPulseWitdth();
+    calibration.yCenterPulseUs = yServo.getLastPulseWitdth();
+}
+
+void Game::measureCalibrationError(MPU6886& imu, float& errorXDeg, float& errorYDeg) {
+    float angleXDeg, angleYDeg;
+    measureTableAngles(imu, angleXDeg, angleYDeg);
+    errorXDeg = config.servoCalibrationTargetAngleXDeg - angleXDeg; // Desired angle is targetAngleXDeg
+    errorYDeg = config.servoCalibrationTargetAngleYDeg - angleYDeg; // Desired angle is targetAngleYDeg
+
+    calibrationReport.measurements++;
+    calibrationReport.residualXDeg = errorXDeg;
+    calibrationReport.residualYDeg = errorYDeg;
+}
+
+bool Game::isCalibrationErrorOk(float errorXDeg, float errorYDeg) const {
+    return fabsf(errorXDeg) < config.servoCalibrationErrorThresholdDeg &&
+           fabsf(errorYDeg) < config.servoCalibrationErrorThresholdDeg;
+}
+
+bool Game::clearStoredCalibration() {
+    return calibrationStore.clear();
+}
@@ -1,12 +1,18 @@
 #pragma once
 
 #include <Arduino.h>
+#include <esp_timer.h>
 #include <GameLevel.hpp>
 #include <SoftTimer.hpp>
 #include <HardwareServo.hpp>
 #include <GameConfig.h>
-#include <SlewRateLimiter.hpp>
+#include <ServoMotionLoop.hpp>
+#include <TiltController.hpp>
 #include <MPU6886.hpp>
+#include <OrientationEstimator.hpp>
+#include <ServoCalibrationStore.hpp>
+#include <CalibrationSolver.hpp>
+#include <TelemetryRecorder.hpp>
 
 enum class GameResult {
     NONE,
@@ -21,10 +27,49 @@ enum class GameStatus {
     DROPPING_BALL
 };
 
+enum class CalibrationMode {
+    NONE,
+    WARM_START,             // Stored calibration verified as is
+    WARM_START_CORRECTED,   // Stored calibration corrected for a small drift with the stored servo model
+    FULL,                   // Calibrated from scratch by the model-based solver
+    FULL_PROPORTIONAL       // Calibrated from scratch by the proportional loop, after the solver failed
+};
+
+/**
+ * Outcome and cost of the last servo calibration
+ */
+struct CalibrationReport {
+    CalibrationMode mode;
+    unsigned long durationMs;   // Time spent calibrating
+    uint16_t measurements;      // Number of IMU measurements taken
+    float residualXDeg;         // X tilt error at the last measurement
+    float residualYDeg;         // Y tilt error at the last measurement
+    uint16_t xCenterPulseUs;    // Resulting X level pulse width
+    uint16_t yCenterPulseUs;    // Resulting Y level pulse width
+
+    /**
+     * Print the report in a human readable format
+     * @param out Where to print the report (e.g. Serial)
+     */
+    void printTo(Print& out) const {
+        const char* modeName = "none";
+        switch (mode) {
+            case CalibrationMode::WARM_START: modeName = "warm start"; break;
+            case CalibrationMode::WARM_START_CORRECTED: modeName = "warm start, corrected"; break;
+            case CalibrationMode::FULL: modeName = "full"; break;
+            case CalibrationMode::FULL_PROPORTIONAL: modeName = "full, proportional"; break;
+            default: break;
+        }
+        out.printf("Servo calibration (%s): %lu ms, %u measurements, residual X %.2f deg, Y %.2f deg, center X %u us, Y %u us\n",
+            modeName, durationMs, measurements, residualXDeg, residualYDeg, xCenterPulseUs, yCenterPulseUs);
+    }
+};
+
 /**
  * Game class manages the state and logic of the game. It handles starting, stopping, and updating the game
  * based on controller input and ball drop status. The update method should be called regularly 
- * (e.g., in a loop or timer) to process game logic and update servo positions.
+ * (e.g., in a loop or timer) to process game logic and set the servo targets. The servos are moved towards
+ * the targets by a ServoMotionLoop running at a fixed rate, independently of how often update is called.
  */
 class Game {
     public:
@@ -61,14 +106,24 @@ class Game {
         void stop();
 
         /**
-         * Sets the ball drop status to true, indicating that the ball has been dropped. This should be called
-         * when the ball drop sensor detects that the ball has been dropped.
+         * Records an edge of the ball drop sensor with its microsecond timestamp. This should be called from the
+         * interrupt of the ball drop sensor on both edges. A ball is accepted when the sensor stays active for
+         * at least ballDropMinPulseUs; the completion time is taken from the activating edge.
+         * @param active true if the sensor is now detecting the ball, false otherwise.
          */
-        void IRAM_ATTR setBallDropped();
+        void IRAM_ATTR setBallDropSignal(bool active);
+
+        /**
+         * Gets the number of ball drop sensor pulses rejected as glitches since boot.
+         * @return The number of rejected pulses.
+         */
+        uint32_t getBallDropGlitchCount() const {
+            return ballDropGlitches;
+        }
 
         /**
          * Updates the game state based on controller input and ball drop status. This should be called regularly
-         * (e.g., in a loop or timer) to process game logic and update servo positions.
+         * (e.g., in a loop or timer) to process game logic and update the servo targets.
          * @param controllerX The X axis input from the controller, expected to be in the range [-1, 1].
          * @param controllerY The Y axis input from the controller, expected to be in the range [-1, 1].
          */
@@ -77,10 +132,34 @@ class Game {
         /** 
          * Performs servo calibration by moving the servos to level the game table, using the IMU 
          * to measure the current orientation. This can help ensure that the game starts with the table level.
+         * The calibration of the previous boot is loaded from NVS and verified first; the full calibration runs
+         * only when the table drifted, and its result is stored for the next boot.
          * @param imu Reference to the MPU6886 IMU used for measuring orientation during calibration.
         */
         void servoCalibration(MPU6886& imu);
 
+        /**
+         * Gets the outcome and the cost of the last servo calibration.
+         * @return The report of the last calibration.
+         */
+        const CalibrationReport& getCalibrationReport() const {
+            return calibrationReport;
+        }
+
+        /**
+         * Removes the stored servo calibration, so the next boot runs the full calibration.
+         * @return true if the stored calibration was removed, false otherwise.
+         */
+        bool clearStoredCalibration();
+
+        /**
+         * Measures the table tilt with the IMU and feeds it to the closed-loop tilt control while it is active.
+         * This function runs an infinite loop and should be called from a dedicated task, after servoCalibration
+         * has completed.
+         * @param imu Reference to the MPU6886 IMU mounted on the table.
+         */
+        void tiltSensorLoop(MPU6886& imu);
+
         /**
          * Checks if the game is currently running.
          * When status is DROPPING_BALL, isRunning() will return false.
@@ -101,7 +180,7 @@ class Game {
          * @param result Last game result.
          * @param completionTime Last game completion time in milliseconds.
          */
-        void lastGameStats(GameLevel& level, GameResult& result, uint16_t& completionTime) const;
+        void lastGameStats(GameLevel& level, GameResult& result, uint32_t& completionTime) const;
 
         /**
          * Gets end time for the current game. If the goal is not reached within the time limit, the game will end 
@@ -120,42 +199,100 @@ class Game {
          * within this time span, the game will end and the player will lose.
          * @return The time span for the current game in milliseconds. If the game is not running, returns 0.
          */
-        uint16_t currentGameTimeLimitMs() const {
+        uint32_t currentGameTimeLimitMs() const {
             if (status != GameStatus::RUNNING) {
                 return 0;
             }
             return currentTimeLimitMs;
         }
 
+        /**
+         * Gets the period statistics of the servo motion loop.
+         * @return The statistics accumulated since the last reset.
+         */
+        ServoLoopStats getServoLoopStats() {
+            return motionLoop.getStats();
+        }
+
+        /**
+         * Resets the period statistics of the servo motion loop.
+         */
+        void resetServoLoopStats() {
+            motionLoop.resetStats();
+        }
+
+        /**
+         * Gets the tracking statistics of the closed-loop tilt control.
+         * @return The statistics accumulated since the last reset.
+         */
+        TiltControlStats getTiltControlStats() {
+            return tiltController.getStats();
+        }
+
+        /**
+         * Resets the tracking statistics of the closed-loop tilt control.
+         */
+        void resetTiltControlStats() {
+            tiltController.resetStats();
+        }
+
+        /**
+         * Gets the recorder of the in-game telemetry, which traces the control loop of the last games.
+         * @return The telemetry recorder.
+         */
+        TelemetryRecorder& getTelemetry() {
+            return telemetry;
+        }
+
     private:
         HardwareServo& xServo;
         HardwareServo& yServo;
 
         GameConfig config;
-        SlewRateLimiter<int16_t> xServoRamp;
-        SlewRateLimiter<int16_t> yServoRamp;
+        ServoMotionLoop motionLoop;
+        TiltController tiltController;
+        OrientationEstimator orientation;
         SoftTimer timer;
+        TelemetryRecorder telemetry;
 
         // Current game state
         GameStatus status = GameStatus::NOT_RUNNING;
         GameLevel currentLevel = GameLevel::EASY;    
-        uint16_t currentTimeLimitMs = 0;
+        uint32_t currentTimeLimitMs = 0;
         unsigned long startTimeMs = 0;
-        unsigned long lastUpdateMs = 0;
-        volatile bool ballDropped = false;
+        int64_t startTimeUs = 0;
+        float lastControllerX = 0.0f;
+        float lastControllerY = 0.0f;
+
+        // Ball drop sensor state, written by the interrupt
         portMUX_TYPE ballDroppedMux = portMUX_INITIALIZER_UNLOCKED;
+        bool ballDropSignalActive = false;
+        int64_t ballDropEdgeUs = 0;         // Activating edge of the current sensor pulse
+        int64_t ballDroppedAtUs = 0;        // Activating edge of the accepted pulse, 0 if none
+        volatile uint32_t ballDropGlitches = 0;
 
         // Last game results
         GameResult lastGameResult = GameResult::NONE;
-        uint16_t lastGameCompletionTimeMs = 0;
+        uint32_t lastGameCompletionTimeMs = 0;
         GameLevel lastGameLevel = GameLevel::EASY;
 
         void resetBallDroppedFlag();
-        bool consumeBallDroppedFlag();
-        uint16_t getTimeLimitMs(GameLevel level) const;
+        bool consumeBallDroppedFlag(int64_t nowUs, int64_t& droppedAtUs);
+        uint32_t getTimeLimitMs(GameLevel level) const;
+        void recordTelemetry(TelemetryRecordType type, int64_t timeUs);
 
         // Calibration
-        bool calibrationInProgress = false;
+        ServoCalibrationStore calibrationStore;
+        CalibrationReport calibrationReport = {};
+
+        bool verifyStoredCalibration(MPU6886& imu, ServoCalibration& calibration);
+        void runFullCalibration(MPU6886& imu, ServoCalibration& calibration);
+        bool runSolverCalibration(MPU6886& imu, ServoCalibration& calibration);
+        void runProportionalCalibration(MPU6886& imu, ServoCalibration& calibration);
+        void measureCalibrationError(MPU6886& imu, float& errorXDeg, float& errorYDeg);
+        bool isCalibrationErrorOk(float errorXDeg, float errorYDeg) const;
+        void measureTableAngles(MPU6886& imu, float& angleXDeg, float& angleYDeg);
+        static void accelToTableAngles(float accelX, float accelY, float& angleXDeg, float& angleYDeg);
         uint16_t xCenterPulseUs = 1500;
         uint16_t yCenterPulseUs = 1500;
 };
\ No newline at end of file
@@ -3,9 +3,12 @@
 #include <Arduino.h>
 
 struct GameConfig {
-    uint16_t easyTimeLimitMs;   // Time limit for easy level in milliseconds
+    uint32_t easyTimeLimitMs;   // Time limit for easy level in milliseconds
     uint16_t maxServoPulseRate; // Maximum servo pulse change rate in pulses/second
+    uint32_t maxServoPulseAccel; // Maximum servo pulse acceleration in pulses/second^2
+    uint32_t maxServoPulseJerk;  // Maximum servo pulse jerk in pulses/second^3
     uint16_t servoPulseRange;   // Range of servo pulse in \microseconds (e.g. 1000 for 1000-2000us)
+    uint16_t servoLoopRateHz;   // Rate in Hz of the servo motion loop that ramps the servos towards their targets
 
     uint16_t prepareGamePulseRate;   // Servo pulse change rate in pulses/second during game preparation phase (before start)
     int16_t prepareGameXPulseus;     // X servo pulse width during game preparation phase (before start)
@@ -15,8 +18,20 @@ struct GameConfig {
     int16_t ballDropXDeltaPulseUs;   // X servo pulse width delta from center when ball is dropped
     int16_t ballDropYDeltaPulseUs;   // Y servo pulse width delta from center when ball is dropped
     uint16_t ballDropTimeMs;         // Time in milliseconds for the ball to reach the drop collection box after being dropped
+    uint16_t ballDropMinPulseUs;     // Shortest ball drop sensor pulse in microseconds accepted as a ball, shorter ones are glitches
 
     float servoCalibrationErrorThresholdDeg;    // Acceptable error threshold in degrees for servo calibration
     float servoCalibrationTargetAngleXDeg;      // Compensation for physical X axis misalignment in degrees for servo calibration to achieve level orientation
     float servoCalibrationTargetAngleYDeg;      // Compensation for physical Y axis misalignment in degrees for servo calibration to achieve level orientation
+
+    bool tiltControlEnabled;            // Close the loop on the table tilt measured by the IMU during the game
+    float tiltMaxAngleDeg;              // Table tilt in degrees commanded at full controller deflection in closed-loop mode
+    float tiltKp;                       // Tilt PID proportional gain in microseconds per degree
+    float tiltKi;                       // Tilt PID integral gain in microseconds per degree per second
+    float tiltKd;                       // Tilt PID derivative gain in microseconds per degree per second of tilt rate
+    uint16_t tiltMaxCorrectionPulseUs;  // Maximum servo pulse correction in microseconds applied by the tilt PID
+    uint16_t tiltSensorPeriodMs;        // Period in milliseconds of the IMU tilt measurements
+
+    uint32_t telemetryCapacityRecords;  // Size in records of the in-game telemetry ring buffer allocated in PSRAM
+    uint8_t telemetryMaxGames;          // Number of most recent games kept by the in-game telemetry
 };
\ No newline at end of file
@@ -18,6 +18,20 @@
 #define MAIN_DISPLAY_MODE_READY_SET_GO 8
 #define MAIN_DISPLAY_MODE_DONT_TOUCH 9
 
+namespace {
+    // Countdown beeps of the ready-set-go animation, synthesized instead of the start-beep files: a bright low
+    // beep for READY and SET, then one an octave higher and twice as long for GO. The envelope release ends
+    // them without the click of the files.
+    constexpr ToneEnvelope kStartBeepEnvelope = {5, 150, TONE_LEVEL_FULL / 2, 40};
+    constexpr uint16_t kStartBeepGain = AUDIO_GAIN_UNITY / 3;
+    const ToneNote kStartBeepShort[] = {{220, 500}};
+    const ToneNote kStartBeepLong[] = {{440, 1000}};
+
+    // The warning beep of each second is scheduled this long before the displayed second changes: more than
+    // the notice the audio player needs, plus a frame
+    constexpr uint32_t kWarningBeepNoticeMs = AudioPlayer::CUE_LEAD_US / 1000 + 2 * MAIN_DISPLAY_MAX_FPS_MS;
+}
+
 #define SKY_BLUE_GRADIENT_COLORS { \
     RgbColor(0, 50, 150), \
     RgbColor(0, 50, 150), \
@@ -95,6 +109,21 @@ namespace {
         uint32_t wholeSeconds = centiseconds / 100;
         uint32_t fractionalPart = centiseconds % 100;
 
+        // From 100 seconds on, switch to minutes and seconds to keep the same width
+        if (wholeSeconds >= 100) {
+            uint32_t minutes = min<uint32_t>(wholeSeconds / 60, 99);
+            uint32_t seconds = minutes < 99 ? wholeSeconds % 60 : 59;
+            String minutesText = String(minutes);
+            if (minutes < 10) {
+                minutesText = "0" + minutesText;
+            }
+            String secondsText = String(seconds);
+            if (seconds < 10) {
+                secondsText = "0" + secondsText;
+            }
+            return minutesText + ":" + secondsText;
+        }
+
         String wholeSecondsText = String(wholeSeconds);
         if (wholeSeconds < 10) {
             wholeSecondsText = "0" + wholeSecondsText;
@@ -413,7 +442,7 @@ void MainDisplay::dontTouchUpdateLoop() {
     CancelToken localCancelToken;
     cancelToken = &localCancelToken;
 
-    audioPlayer.play(AUDIO_FILE_DONT_TOUCH);
+    audioPlayer.play(AUDIO_FILE_DONT_TOUCH, AUDIO_PRIORITY_MUSIC);
 
     for (uint16_t i = 0; i < 14; i++) {
         if (localCancelToken.isCancelled()) {
@@ -443,7 +472,9 @@ void MainDisplay::countdownUpdateLoop() {
     CancelToken localCancelToken;
     cancelToken = &localCancelToken;
     int16_t stripeOffset = 0;
-    int16_t seconds = -1;
+    int32_t seconds = -1;
+    AudioVoice warningBeep = AUDIO_VOICE_NONE;     // Beep scheduled at the next change of the displayed second
+    int64_t warningBeepUs = 0;
 
     while (!localCancelToken.isCancelled()) {
         // Calculate remaining time
@@ -521,7 +552,8 @@ void MainDisplay::countdownUpdateLoop() {
             }
 
             // Draw remaining time in seconds at the center of the display
-            String timerText = String(remainingTimeMs / 1000.0, 2); // Show 2 decimal places
+            // Show 2 decimal places, or minutes and seconds for long levels
+            String timerText = remainingTimeMs < 100000 ? String(remainingTimeMs / 1000.0, 2) : formatTimeSpan(remainingTimeMs);
             uint16_t textWidth = display.getStringWidth(timerText, FONT_6x8, true);
             int16_t xPos = (w - textWidth) / 2; // Center the text
             int16_t xBackgroundStart = xPos - 1;
@@ -536,11 +568,28 @@ void MainDisplay::countdownUpdateLoop() {
             display.drawLine(w - 1, 0, w - 1, h - 1, COLOR_RED);
 
             display.show();
+            int64_t shownUs = esp_timer_get_time();
 
-            uint16_t remainingSeconds = remainingTimeMs / 1000;
+            int32_t remainingSeconds = remainingTimeMs / 1000;
             if (seconds != remainingSeconds) {
                 seconds = remainingSeconds;
-                audioPlayer.play(AUDIO_FILE_WARNING_BEEP);
+                if (warningBeep != AUDIO_VOICE_NONE) {
+                    // First frame of the new second, its beep was scheduled at this time
+                    audioPlayer.markShown(warningBeep, shownUs);
+                    warningBeep = AUDIO_VOICE_NONE;
+                } else {
+                    audioPlayer.play(AUDIO_FILE_WARNING_BEEP);
+                }
+            }
+
+            // Schedule the beep of the next second, the loop wakes at that time to show it. esp_timer is read after
+            // millis(), so the change time is never before the millisecond of the change.
+            uint32_t changeInMs = remainingTimeMs - seconds * 1000 + 1;
+            if (seconds > 0 && warningBeep == AUDIO_VOICE_NONE && changeInMs <= kWarningBeepNoticeMs) {
+                unsigned long nowMs = millis();
+                int64_t nowUs = esp_timer_get_time();
+                warningBeepUs = nowUs + (int64_t)(long)(countdownEndTimeMs - seconds * 1000 + 1 - nowMs) * 1000;
+                warningBeep = audioPlayer.playAt(warningBeepUs, AUDIO_FILE_WARNING_BEEP);
             }
 
             if (remainingTimeMs == 0) {
@@ -548,7 +597,15 @@ void MainDisplay::countdownUpdateLoop() {
             }
         }
 
-        delay(MAIN_DISPLAY_MAX_FPS_MS); // Limit update rate to max FPS
+        // Limit update rate to max FPS, the frame of a scheduled beep is shown at its time
+        int64_t nextFrameUs = esp_timer_get_time() + MAIN_DISPLAY_MAX_FPS_MS * 1000LL;
+        if (warningBeep != AUDIO_VOICE_NONE) {
+            nextFrameUs = min(nextFrameUs, warningBeepUs);
+        }
+        delayUntilUs(nextFrameUs);
+    }
+    if (warningBeep != AUDIO_VOICE_NONE) {
+        audioPlayer.stop(warningBeep);
     }
 
     cancelToken = nullptr; // Clear the token when exiting the loop
@@ -573,13 +630,13 @@ void MainDisplay::gameOverUpdateLoop() {
     display.drawCenteredString(0, "GAME OVER", redYelloMirrorGradient, FONT_6x8);
     display.copyCanvasTo(_buffer2);
 
-    audioPlayer.play(AUDIO_FILE_GAME_OVER);
+    AudioVoice jingle = audioPlayer.play(AUDIO_FILE_GAME_OVER, AUDIO_PRIORITY_MUSIC);
     imageTransitionAnimation.horizontalCenterTransition(_buffer1, _buffer2, COLOR_RED, 300, localCancelToken);
 
     // Wait in this loop until the mode changes to avoid to repeat the animation
     while (!localCancelToken.isCancelled()) {        
         if (!modeDone) {
-            if (!audioPlayer.isPlaying()) {
+            if (!audioPlayer.isPlaying(jingle)) {
                 modeDone = true; // Signal that game win animation has finished when audio finishes playing
             }
         }
@@ -608,7 +665,7 @@ void MainDisplay::gameWinUpdateLoop() {
     display.drawCenteredString(0, "YOU WIN!", greenYellowMirrorGradient, FONT_6x8);
     display.copyCanvasTo(_buffer2);
 
-    audioPlayer.play(AUDIO_FILE_GAME_WIN);
+    AudioVoice jingle = audioPlayer.play(AUDIO_FILE_GAME_WIN, AUDIO_PRIORITY_MUSIC);
     imageTransitionAnimation.horizontalCenterTransition(_buffer1, _buffer2, COLOR_GREEN, 300, localCancelToken);
 
     // Wait in this loop until the mode changes to avoid to repeat the animation
@@ -625,7 +682,7 @@ void MainDisplay::gameWinUpdateLoop() {
         display.show();
 
         if (!modeDone) {
-            if (!audioPlayer.isPlaying()) {
+            if (!audioPlayer.isPlaying(jingle)) {
                 modeDone = true; // Signal that game win animation has finished when audio finishes playing
             }
         }
@@ -783,7 +840,7 @@ void MainDisplay::endGameHighScoreUpdateLoop() {
     display.drawCenteredString(0, "HIGH SCORE!", neonGradient, FONT_6x8, true);
     display.copyCanvasTo(_buffer2);
 
-    audioPlayer.play(AUDIO_FILE_NEW_HIGHSCORE);
+    audioPlayer.play(AUDIO_FILE_NEW_HIGHSCORE, AUDIO_PRIORITY_MUSIC);
     // Animate transition from previous screen to the high score screen with a horizontal center inverse transition effect, using cyan as the transition color for a vibrant look
     imageTransitionAnimation.horizontalCenterInverseTransition(_buffer1, _buffer2, COLOR_CYAN, 300, localCancelToken);
 
@@ -1173,7 +1230,7 @@ void MainDisplay::showBrickMazeTitleScreen(CancelToken& cancelToken, bool playTi
             delay(50);
         } 
     } else {
-        audioPlayer.play(AUDIO_FILE_BRICK_MAZE);
+        AudioVoice title = audioPlayer.play(AUDIO_FILE_BRICK_MAZE, AUDIO_PRIORITY_MUSIC);
 
         // Wait for the laugh in the audio
         delayCancellable(2600, cancelToken, 100);
@@ -1181,7 +1238,7 @@ void MainDisplay::showBrickMazeTitleScreen(CancelToken& cancelToken, bool playTi
 
         // Blink until the end of the audio to sync the title animation with the audio for a more impactful presentation
         uint16_t frame = 0;
-        while (audioPlayer.isPlaying()) {
+        while (audioPlayer.isPlaying(title)) {
             IF_CANCELLED(cancelToken, { audioPlayer.stop(); return; })
 
             display.clear();
@@ -1222,41 +1279,47 @@ void MainDisplay::showReadySetGoAnimation(CancelToken& cancelToken) {
     display.linearColorGradient(RgbColor(255, 200, 0), RgbColor(150, 50, 0), ambraGradient, ANIM_TEXT_FONT_HEIGHT);
     display.linearColorGradient(RgbColor(150, 255, 0), RgbColor(0, 80, 0), greenGradient, ANIM_TEXT_FONT_HEIGHT);
 
+    // Each beep is scheduled at the time the first frame of its word is shown, the word waits for it
+    int64_t beepUs = esp_timer_get_time() + AudioPlayer::CUE_LEAD_US;
+    AudioVoice beep = audioPlayer.playSequenceAt(beepUs, kStartBeepShort, 1, ToneWaveform::SQUARE, kStartBeepEnvelope,
+        AUDIO_PRIORITY_EFFECT, kStartBeepGain);
+    delayUntilUs(beepUs);
+
     // Show "READY"
-    audioPlayer.play(AUDIO_FILE_START_BEEP_SHORT);
     centerGrowAndFade.animate("READY", RgbColor(255, 30, 30), redGradient, cancelToken);
-    audioPlayer.setVolume(0); // Hack to avoid the click sound when the audio end
-    delay(50);
-    audioPlayer.setVolume(21);
     IF_CANCELLED(cancelToken, return;)
+    audioPlayer.markShown(beep, centerGrowAndFade.getFirstFrameUs());
 
     // Show "SET"
-    audioPlayer.play(AUDIO_FILE_START_BEEP_SHORT);
+    beepUs = esp_timer_get_time() + AudioPlayer::CUE_LEAD_US;
+    beep = audioPlayer.playSequenceAt(beepUs, kStartBeepShort, 1, ToneWaveform::SQUARE, kStartBeepEnvelope,
+        AUDIO_PRIORITY_EFFECT, kStartBeepGain);
+    delayUntilUs(beepUs);
     centerGrowAndFade.animate("SET", RgbColor(255, 200, 0), ambraGradient, cancelToken);
-    audioPlayer.setVolume(0); // Hack to avoid the click sound when the audio end
-    delay(50);
-    audioPlayer.setVolume(21);
     IF_CANCELLED(cancelToken, return;)
+    audioPlayer.markShown(beep, centerGrowAndFade.getFirstFrameUs());
 
     // Show "GO!"
-    audioPlayer.play(AUDIO_FILE_START_BEEP_LONG);
+    beepUs = esp_timer_get_time() + AudioPlayer::CUE_LEAD_US;
+    AudioVoice goBeep = audioPlayer.playSequenceAt(beepUs, kStartBeepLong, 1, ToneWaveform::SQUARE, kStartBeepEnvelope,
+        AUDIO_PRIORITY_EFFECT, kStartBeepGain);
+    delayUntilUs(beepUs);
     for (uint8_t i = 0; i < 6; i++) {
         IF_CANCELLED(cancelToken, {
-            audioPlayer.stop();
-            audioPlayer.setVolume(21);
+            audioPlayer.stop(goBeep);
             return;
         })
 
         display.clear();
         display.drawCenteredString(0, "GO!", greenGradient, FONT_6x8, true);
         display.show();
+        if (i == 0) {
+            audioPlayer.markShown(goBeep, esp_timer_get_time());
+        }
         delay(100);
 
         display.clear();
         display.show();
         delay(60);
     }
-    audioPlayer.setVolume(0); // Hack to avoid the click sound when the audio end
-    delay(50);
-    audioPlayer.setVolume(21);
 }
\ No newline at end of file
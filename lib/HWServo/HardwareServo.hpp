@@ -55,6 +55,17 @@ public:
         return (float)minAngle + normalized * (float)(maxAngle - minAngle);
     }
 
+    /**
+     * Gets the pulse width range of the servo.
+     * @return Pulse width in microseconds corresponding to the minimum or maximum angle.
+     */
+    inline uint16_t getMinPulseWidth() const {
+        return minPulseWidthUs < maxPulseWidthUs ? minPulseWidthUs : maxPulseWidthUs;
+    }
+    inline uint16_t getMaxPulseWidth() const {
+        return minPulseWidthUs < maxPulseWidthUs ? maxPulseWidthUs : minPulseWidthUs;
+    }
+
     /**
      * Gets the most recently commanded pulse width in microseconds.
      * @return Last pulse width setpoint in microseconds.
@@ -5,33 +5,79 @@ bool HighScore::begin(GameConfig config) {
         return false;
     }
 
-    // Load per-level scores
-    const size_t expectedTodaySize = sizeof(scores);
-    if (preferences.getBytesLength(NVS_KEY_TODAY) == expectedTodaySize &&
-        preferences.getBytes(NVS_KEY_TODAY, scores, expectedTodaySize) == expectedTodaySize) {
+    journaled = journal.begin(esp_partition_find_first(JOURNAL_PARTITION_TYPE, JOURNAL_PARTITION_SUBTYPE,
+                                                       JOURNAL_PARTITION_LABEL));
+    if (journaled && journal.hasSnapshot()) {
+        // Entries missing from the snapshot keep the defaults
+        loadDefaultScores(config.easyTimeLimitMs);
+        loadDefaultAllTimeScores(config.easyTimeLimitMs);
+        if (!journal.replay(replayRecord, this)) {
+            return false;
+        }
+        // Left by a power cut during the move of the NVS tables to the journal
+        removeNvsScores();
+        initialized = true;
+        return true;
+    }
+
+    if (!loadLevelScores(config) || !loadAllTimeScores(config)) {
+        return false;
+    }
+    if (journaled) {
+        // First boot with the journal partition: the tables of NVS become its first snapshot. If the partition
+        // cannot be written, the scores stay in NVS.
+        if (compactJournal()) {
+            removeNvsScores();
+        } else {
+            journaled = false;
+            if (!persistAll()) return false;
+        }
+    }
+
+    initialized = true;
+    return true;
+}
+
+bool HighScore::loadLevelScores(GameConfig config) {
+    const size_t expectedSize = sizeof(scores);
+    if (preferences.getBytesLength(NVS_KEY_TODAY) == expectedSize &&
+        preferences.getBytes(NVS_KEY_TODAY, scores, expectedSize) == expectedSize) {
         for (uint8_t level = 0; level < GAME_LEVEL_COUNT; ++level) {
             for (uint8_t rank = 0; rank < SCORES_PER_LEVEL; ++rank) {
                 normalizeScore(scores[level][rank]);
             }
         }
-    } else {
-        loadDefaultScores(config);
+        return true;
+    }
+
+    // Convert the scores of older firmware, or start from the defaults
+    if (!migrateLevelScoresV1()) {
+        loadDefaultScores(config.easyTimeLimitMs);
+    }
+    if (!journaled) {
         if (!persistLevelScores()) return false;
+        preferences.remove(NVS_KEY_TODAY_V1);
     }
+    return true;
+}
 
-    // Load all-time scores
-    const size_t expectedAllTimeSize = sizeof(allTimeScores);
-    if (preferences.getBytesLength(NVS_KEY_ALLTIME) == expectedAllTimeSize &&
-        preferences.getBytes(NVS_KEY_ALLTIME, allTimeScores, expectedAllTimeSize) == expectedAllTimeSize) {
+bool HighScore::loadAllTimeScores(GameConfig config) {
+    const size_t expectedSize = sizeof(allTimeScores);
+    if (preferences.getBytesLength(NVS_KEY_ALLTIME) == expectedSize &&
+        preferences.getBytes(NVS_KEY_ALLTIME, allTimeScores, expectedSize) == expectedSize) {
         for (uint8_t rank = 0; rank < SCORES_PER_LEVEL; ++rank) {
             normalizeAllTimeScore(allTimeScores[rank]);
         }
-    } else {
-        loadDefaultAllTimeScores(config);
-        if (!persistAllTimeScores()) return false;
+        return true;
     }
 
-    initialized = true;
+    if (!migrateAllTimeScoresV1()) {
+        loadDefaultAllTimeScores(config.easyTimeLimitMs);
+    }
+    if (!journaled) {
+        if (!persistAllTimeScores()) return false;
+        preferences.remove(NVS_KEY_ALLTIME_V1);
+    }
     return true;
 }
 
@@ -49,6 +95,24 @@ int8_t HighScore::write(GameLevel level, const Score& score) {
         return -1;
     }
 
+    const int8_t rank = insertScore(level, score);
+    if (rank < 0) {
+        return -1;
+    }
+
+    if (journaled) {
+        ScoreJournal::Record record = {ScoreJournal::RecordType::NEW_SCORE, static_cast<uint8_t>(level), 0};
+        memcpy(record.name, scores[gameLevelToIndex(level)][rank].name, sizeof(record.name));
+        record.timeMs = score.timeMs;
+        journalRecord(record);
+    } else {
+        persistAll();
+    }
+
+    return rank;
+}
+
+int8_t HighScore::insertScore(GameLevel level, const Score& score) {
     // A score that doesn't make the today list cannot make the all-time list
     const int8_t rank = updateTodayScores(level, score);
     if (rank < 0) {
@@ -56,19 +120,16 @@ int8_t HighScore::write(GameLevel level, const Score& score) {
     }
 
     updateAllTimeScores(level, score);
-    persistAll();
-
     return rank;
 }
 
 int8_t HighScore::updateTodayScores(GameLevel level, const Score& score) {
-    const int8_t rank = getHighScoreRank(level, score.timeMs);
+    const uint8_t levelIndex = gameLevelToIndex(level);
+    const int8_t rank = findRank(levelIndex, score.timeMs);
     if (rank < 0) {
         return -1;
     }
 
-    const uint8_t levelIndex = gameLevelToIndex(level);
-
     // Shift down lower scores to make room for the new score at the correct rank
     for (int8_t i = static_cast<int8_t>(SCORES_PER_LEVEL) - 1; i > rank; --i) {
         scores[levelIndex][i] = scores[levelIndex][i - 1];
@@ -113,12 +174,15 @@ void HighScore::updateAllTimeScores(GameLevel level, const Score& score) {
     allTimeScores[allTimeRank] = allTimeScore;
 }
 
-int8_t HighScore::getHighScoreRank(GameLevel level, uint16_t time) const {
+int8_t HighScore::getHighScoreRank(GameLevel level, uint32_t time) const {
     if (!initialized || !isValidGameLevel(level)) {
         return -1;
     }
 
-    const uint8_t levelIndex = gameLevelToIndex(level);
+    return findRank(gameLevelToIndex(level), time);
+}
+
+int8_t HighScore::findRank(uint8_t levelIndex, uint32_t time) const {
     for (uint8_t rank = 0; rank < SCORES_PER_LEVEL; ++rank) {
         if (time < scores[levelIndex][rank].timeMs) {
             return static_cast<int8_t>(rank);
@@ -143,20 +207,60 @@ bool HighScore::overwriteWithDefaultScores(GameConfig config) {
     }
 
     // Only reset per-level scores; all-time scores are preserved
-    loadDefaultScores(config);
+    loadDefaultScores(config.easyTimeLimitMs);
+    if (journaled) {
+        ScoreJournal::Record record = {ScoreJournal::RecordType::RESET_TODAY, 0, 0};
+        record.timeMs = config.easyTimeLimitMs;
+        return journalRecord(record);
+    }
     return persistLevelScores();
 }
 
-void HighScore::loadDefaultAllTimeScores(GameConfig config) {
+bool HighScore::migrateLevelScoresV1() {
+    ScoreV1 oldScores[GAME_LEVEL_COUNT][SCORES_PER_LEVEL];
+    const size_t expectedSize = sizeof(oldScores);
+    if (preferences.getBytesLength(NVS_KEY_TODAY_V1) != expectedSize ||
+        preferences.getBytes(NVS_KEY_TODAY_V1, oldScores, expectedSize) != expectedSize) {
+        return false;
+    }
+
+    for (uint8_t level = 0; level < GAME_LEVEL_COUNT; ++level) {
+        for (uint8_t rank = 0; rank < SCORES_PER_LEVEL; ++rank) {
+            memcpy(scores[level][rank].name, oldScores[level][rank].name, sizeof(scores[level][rank].name));
+            scores[level][rank].timeMs = oldScores[level][rank].timeMs;
+            normalizeScore(scores[level][rank]);
+        }
+    }
+    return true;
+}
+
+bool HighScore::migrateAllTimeScoresV1() {
+    AllTimeScoreV1 oldScores[SCORES_PER_LEVEL];
+    const size_t expectedSize = sizeof(oldScores);
+    if (preferences.getBytesLength(NVS_KEY_ALLTIME_V1) != expectedSize ||
+        preferences.getBytes(NVS_KEY_ALLTIME_V1, oldScores, expectedSize) != expectedSize) {
+        return false;
+    }
+
+    for (uint8_t rank = 0; rank < SCORES_PER_LEVEL; ++rank) {
+        memcpy(allTimeScores[rank].name, oldScores[rank].name, sizeof(allTimeScores[rank].name));
+        allTimeScores[rank].timeMs = oldScores[rank].timeMs;
+        allTimeScores[rank].level = oldScores[rank].level;
+        normalizeAllTimeScore(allTimeScores[rank]);
+    }
+    return true;
+}
+
+void HighScore::loadDefaultAllTimeScores(uint32_t timeMs) {
     for (uint8_t i = 0; i < SCORES_PER_LEVEL; ++i) {
-        allTimeScores[i] = {{'B', 'M', 'Z', '\0'}, config.easyTimeLimitMs, GameLevel::EASY};
+        allTimeScores[i] = {{'B', 'M', 'Z', '\0'}, timeMs, GameLevel::EASY};
     }
 }
 
-void HighScore::loadDefaultScores(GameConfig config) {    
+void HighScore::loadDefaultScores(uint32_t timeMs) {
     for (uint8_t level = 0; level < GAME_LEVEL_COUNT; ++level) {
         for (uint8_t rank = 0; rank < SCORES_PER_LEVEL; ++rank) {
-            scores[level][rank] = {{'B', 'M', 'Z', '\0'}, config.easyTimeLimitMs};
+            scores[level][rank] = {{'B', 'M', 'Z', '\0'}, timeMs};
         }
     }
 }
@@ -175,6 +279,71 @@ bool HighScore::persistAll() {
     return persistLevelScores() && persistAllTimeScores();
 }
 
+void HighScore::removeNvsScores() {
+    for (const char* key : {NVS_KEY_TODAY, NVS_KEY_ALLTIME, NVS_KEY_TODAY_V1, NVS_KEY_ALLTIME_V1}) {
+        if (preferences.isKey(key)) {
+            preferences.remove(key);
+        }
+    }
+}
+
+bool HighScore::journalRecord(const ScoreJournal::Record& record) {
+    // The tables already hold the change: a full sector is compacted with it
+    return journal.append(record) || compactJournal();
+}
+
+bool HighScore::compactJournal() {
+    ScoreJournal::Record records[SNAPSHOT_RECORDS];
+    uint16_t count = 0;
+    for (uint8_t level = 0; level < GAME_LEVEL_COUNT; ++level) {
+        for (uint8_t rank = 0; rank < SCORES_PER_LEVEL; ++rank) {
+            ScoreJournal::Record& record = records[count++];
+            record = {ScoreJournal::RecordType::TODAY_SCORE, level, rank};
+            memcpy(record.name, scores[level][rank].name, sizeof(record.name));
+            record.timeMs = scores[level][rank].timeMs;
+        }
+    }
+    for (uint8_t rank = 0; rank < SCORES_PER_LEVEL; ++rank) {
+        ScoreJournal::Record& record = records[count++];
+        record = {ScoreJournal::RecordType::ALL_TIME_SCORE, static_cast<uint8_t>(allTimeScores[rank].level), rank};
+        memcpy(record.name, allTimeScores[rank].name, sizeof(record.name));
+        record.timeMs = allTimeScores[rank].timeMs;
+    }
+    return journal.compact(records, count);
+}
+
+void HighScore::replayRecord(const ScoreJournal::Record& record, void* context) {
+    HighScore& self = *static_cast<HighScore*>(context);
+    const GameLevel level = static_cast<GameLevel>(record.level);
+    const Score score = {{record.name[0], record.name[1], record.name[2], '\0'}, record.timeMs};
+
+    // Records of levels or ranks this firmware does not know are ignored
+    switch (record.type) {
+        case ScoreJournal::RecordType::TODAY_SCORE:
+            if (record.level < GAME_LEVEL_COUNT && record.rank < SCORES_PER_LEVEL) {
+                self.scores[record.level][record.rank] = score;
+            }
+            break;
+        case ScoreJournal::RecordType::ALL_TIME_SCORE:
+            if (isValidGameLevel(level) && record.rank < SCORES_PER_LEVEL) {
+                AllTimeScore& entry = self.allTimeScores[record.rank];
+                memcpy(entry.name, score.name, sizeof(entry.name));
+                entry.timeMs = score.timeMs;
+                entry.level = level;
+            }
+            break;
+        case ScoreJournal::RecordType::NEW_SCORE:
+            // Inserted as write() did
+            if (isValidGameLevel(level)) {
+                self.insertScore(level, score);
+            }
+            break;
+        case ScoreJournal::RecordType::RESET_TODAY:
+            self.loadDefaultScores(record.timeMs);
+            break;
+    }
+}
+
 void HighScore::normalizeScore(Score& score) {
     score.name[3] = '\0';
 
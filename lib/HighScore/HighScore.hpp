@@ -6,18 +6,20 @@
 #include <GameLevel.hpp>
 #include <GameConfig.h>
 
+#include "ScoreJournal.hpp"
+
 class HighScore {
 public:
     static constexpr uint8_t SCORES_PER_LEVEL = 9;
 
     struct Score {
         char name[4];
-        uint16_t timeMs;
+        uint32_t timeMs;
     };
 
     struct AllTimeScore {
         char name[4];
-        uint16_t timeMs;
+        uint32_t timeMs;
         GameLevel level;
     };
 
@@ -25,27 +27,64 @@ public:
 
     bool read(GameLevel level, uint8_t rank, Score& outScore) const;
     int8_t write(GameLevel level, const Score& score);
-    int8_t getHighScoreRank(GameLevel level, uint16_t time) const;
+    int8_t getHighScoreRank(GameLevel level, uint32_t time) const;
 
     bool readAllTime(uint8_t rank, AllTimeScore& outScore) const;
 
     bool overwriteWithDefaultScores(GameConfig config);
 
+    ScoreJournalStats getJournalStats() const { return journal.getStats(); }
+
 private:
+    // Partition of the score journal, of a custom type (0x40-0xFE): the data subtypes are reserved for ESP-IDF.
+    // The scores are stored in NVS instead with a partition table without it.
+    static constexpr const char* JOURNAL_PARTITION_LABEL = "scores";
+    static constexpr esp_partition_type_t JOURNAL_PARTITION_TYPE = (esp_partition_type_t)0x40;
+    static constexpr esp_partition_subtype_t JOURNAL_PARTITION_SUBTYPE = (esp_partition_subtype_t)0x00;
+    static constexpr uint16_t SNAPSHOT_RECORDS = (GAME_LEVEL_COUNT + 1) * SCORES_PER_LEVEL;
+
     static constexpr const char* NVS_NAMESPACE = "brickmaze";
-    static constexpr const char* NVS_KEY_TODAY = "today";
-    static constexpr const char* NVS_KEY_ALLTIME = "alltime";
+    static constexpr const char* NVS_KEY_TODAY = "today2";
+    static constexpr const char* NVS_KEY_ALLTIME = "alltime2";
+
+    // Keys and layouts of the scores with 16-bit times written by older firmware, converted once at boot.
+    // The old all-time layout has the same size as the new one, so the versions are told apart by key.
+    static constexpr const char* NVS_KEY_TODAY_V1 = "today";
+    static constexpr const char* NVS_KEY_ALLTIME_V1 = "alltime";
+
+    struct ScoreV1 {
+        char name[4];
+        uint16_t timeMs;
+    };
+
+    struct AllTimeScoreV1 {
+        char name[4];
+        uint16_t timeMs;
+        GameLevel level;
+    };
 
     Preferences preferences;
+    ScoreJournal journal;
     Score scores[GAME_LEVEL_COUNT][SCORES_PER_LEVEL];
     AllTimeScore allTimeScores[SCORES_PER_LEVEL];
+    bool journaled = false;     // The scores are stored in the journal, not in NVS
     bool initialized = false;
 
-    void loadDefaultScores(GameConfig config);
-    void loadDefaultAllTimeScores(GameConfig config);
+    bool loadLevelScores(GameConfig config);
+    bool loadAllTimeScores(GameConfig config);
+    bool migrateLevelScoresV1();
+    bool migrateAllTimeScoresV1();
+    void loadDefaultScores(uint32_t timeMs);
+    void loadDefaultAllTimeScores(uint32_t timeMs);
     bool persistLevelScores();
     bool persistAllTimeScores();
     bool persistAll();
+    void removeNvsScores();
+    bool journalRecord(const ScoreJournal::Record& record);
+    bool compactJournal();
+    static void replayRecord(const ScoreJournal::Record& record, void* context);
+    int8_t insertScore(GameLevel level, const Score& score);
+    int8_t findRank(uint8_t levelIndex, uint32_t time) const;
     int8_t updateTodayScores(GameLevel level, const Score& score);
     void updateAllTimeScores(GameLevel level, const Score& score);
     static void normalizeScore(Score& score);
@@ -0,0 +1,240 @@
+#include "ScoreJournal.hpp"
+
+namespace {
+    constexpr uint8_t kSlotsPerRead = 16;   // Slots read at once when scanning a sector, 256 bytes of stack
+
+    uint32_t crc32(const uint8_t* data, size_t length) {
+        uint32_t crc = 0xFFFFFFFF;
+        for (size_t i = 0; i < length; i++) {
+            crc ^= data[i];
+            for (uint8_t bit = 0; bit < 8; bit++) {
+                crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+            }
+        }
+        return ~crc;
+    }
+}
+
+bool ScoreJournal::begin(const esp_partition_t* partition) {
+    this->partition = nullptr;
+    sectorCount = 0;
+    activeSector = -1;
+    sequence = 0;
+    maxSequence = 0;
+    snapshotRecords = 0;
+    nextSlot = 0;
+    tornRecords = 0;
+    if (partition == nullptr || partition->size < 2 * SECTOR_BYTES) {
+        return false;
+    }
+    this->partition = partition;
+    sectorCount = min(partition->size / SECTOR_BYTES, (uint32_t)MAX_SECTORS);
+
+    // The active sector is the committed one of the highest sequence whose snapshot reads back
+    for (uint8_t sector = 0; sector < sectorCount; sector++) {
+        SectorHeader header;
+        if (!readHeader(sector, header)) {
+            continue;
+        }
+        maxSequence = max(maxSequence, header.sequence);
+        if ((activeSector < 0 || header.sequence > sequence) && checkSnapshot(sector, header.snapshotRecords)) {
+            activeSector = sector;
+            sequence = header.sequence;
+            snapshotRecords = header.snapshotRecords;
+        }
+    }
+    if (activeSector >= 0 && !scanRecords()) {
+        // Unreadable records: nothing more is appended to this sector, the next write compacts
+        nextSlot = SLOTS_PER_SECTOR;
+    }
+
+    portENTER_CRITICAL(&statsMux);
+    stats.sectors = sectorCount;
+    portEXIT_CRITICAL(&statsMux);
+    return true;
+}
+
+bool ScoreJournal::replay(RecordHandler handler, void* context) {
+    if (activeSector < 0) {
+        return false;
+    }
+    Record records[kSlotsPerRead];
+    for (uint16_t slot = 1; slot < nextSlot; slot += kSlotsPerRead) {
+        uint16_t count = min((uint16_t)(nextSlot - slot), (uint16_t)kSlotsPerRead);
+        if (esp_partition_read(partition, slotOffset(activeSector, slot), records, count * SLOT_BYTES) != ESP_OK) {
+            countFlashError();
+            return false;
+        }
+        for (uint16_t i = 0; i < count; i++) {
+            // Torn records are skipped
+            if (records[i].crc == slotCrc(&records[i])) {
+                handler(records[i], context);
+            }
+        }
+    }
+    return true;
+}
+
+bool ScoreJournal::append(const Record& record) {
+    if (activeSector < 0 || nextSlot >= SLOTS_PER_SECTOR) {
+        return false;
+    }
+    Record slot = record;
+    slot.crc = slotCrc(&slot);
+    // A slot that fails is not used again: it may hold a part of the record, skipped on replay as a torn record
+    if (!writeSlot(activeSector, nextSlot++, &slot)) {
+        return false;
+    }
+
+    portENTER_CRITICAL(&statsMux);
+    stats.appends++;
+    portEXIT_CRITICAL(&statsMux);
+    return true;
+}
+
+bool ScoreJournal::compact(const Record* records, uint16_t count) {
+    if (partition == nullptr || count >= SLOTS_PER_SECTOR) {
+        return false;
+    }
+
+    // The next sector of the ring, or the ones after it if it cannot be written
+    uint8_t first = activeSector < 0 ? 0 : (activeSector + 1) % sectorCount;
+    for (uint8_t attempt = 0; attempt < sectorCount; attempt++) {
+        uint8_t sector = (first + attempt) % sectorCount;
+        if (sector == activeSector || !writeSnapshot(sector, records, count)) {
+            continue;
+        }
+        activeSector = sector;
+        sequence = maxSequence;
+        snapshotRecords = count;
+        nextSlot = count + 1;
+        tornRecords = 0;
+
+        portENTER_CRITICAL(&statsMux);
+        stats.compactions++;
+        portEXIT_CRITICAL(&statsMux);
+        return true;
+    }
+    return false;
+}
+
+ScoreJournalStats ScoreJournal::getStats() const {
+    portENTER_CRITICAL(&statsMux);
+    ScoreJournalStats result = stats;
+    portEXIT_CRITICAL(&statsMux);
+    result.activeSector = activeSector < 0 ? 0 : activeSector;
+    result.sequence = sequence;
+    result.usedSlots = activeSector < 0 ? 0 : nextSlot;
+    result.freeSlots = activeSector < 0 ? 0 : SLOTS_PER_SECTOR - nextSlot;
+    result.tornRecords = tornRecords;
+    return result;
+}
+
+bool ScoreJournal::readHeader(uint8_t sector, SectorHeader& header) {
+    if (esp_partition_read(partition, slotOffset(sector, 0), &header, sizeof(header)) != ESP_OK) {
+        countFlashError();
+        return false;
+    }
+    return header.magic == HEADER_MAGIC && header.version == FORMAT_VERSION && header.crc == slotCrc(&header) &&
+           header.snapshotRecords < SLOTS_PER_SECTOR;
+}
+
+bool ScoreJournal::checkSnapshot(uint8_t sector, uint16_t count) {
+    Record records[kSlotsPerRead];
+    for (uint16_t slot = 1; slot <= count; slot += kSlotsPerRead) {
+        uint16_t chunk = min((uint16_t)(count + 1 - slot), (uint16_t)kSlotsPerRead);
+        if (esp_partition_read(partition, slotOffset(sector, slot), records, chunk * SLOT_BYTES) != ESP_OK) {
+            countFlashError();
+            return false;
+        }
+        for (uint16_t i = 0; i < chunk; i++) {
+            if (records[i].crc != slotCrc(&records[i])) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool ScoreJournal::scanRecords() {
+    Record records[kSlotsPerRead];
+    tornRecords = 0;
+    for (uint16_t slot = snapshotRecords + 1; slot < SLOTS_PER_SECTOR; slot += kSlotsPerRead) {
+        uint16_t count = min((uint16_t)(SLOTS_PER_SECTOR - slot), (uint16_t)kSlotsPerRead);
+        if (esp_partition_read(partition, slotOffset(activeSector, slot), records, count * SLOT_BYTES) != ESP_OK) {
+            countFlashError();
+            return false;
+        }
+        for (uint16_t i = 0; i < count; i++) {
+            // The records are appended in order, the first erased slot ends them
+            if (isErased(&records[i])) {
+                nextSlot = slot + i;
+                return true;
+            }
+            if (records[i].crc != slotCrc(&records[i])) {
+                tornRecords++;
+            }
+        }
+    }
+    nextSlot = SLOTS_PER_SECTOR;
+    return true;
+}
+
+bool ScoreJournal::writeSlot(uint8_t sector, uint16_t slot, const void* data) {
+    uint8_t readBack[SLOT_BYTES];
+    if (esp_partition_write(partition, slotOffset(sector, slot), data, SLOT_BYTES) != ESP_OK ||
+        esp_partition_read(partition, slotOffset(sector, slot), readBack, SLOT_BYTES) != ESP_OK ||
+        memcmp(readBack, data, SLOT_BYTES) != 0) {
+        countFlashError();
+        return false;
+    }
+    return true;
+}
+
+bool ScoreJournal::writeSnapshot(uint8_t sector, const Record* records, uint16_t count) {
+    if (esp_partition_erase_range(partition, sector * SECTOR_BYTES, SECTOR_BYTES) != ESP_OK) {
+        countFlashError();
+        return false;
+    }
+    portENTER_CRITICAL(&statsMux);
+    stats.sectorErases++;
+    portEXIT_CRITICAL(&statsMux);
+
+    for (uint16_t i = 0; i < count; i++) {
+        Record slot = records[i];
+        slot.crc = slotCrc(&slot);
+        if (!writeSlot(sector, i + 1, &slot)) {
+            return false;
+        }
+    }
+
+    // The header last: a sector without it is ignored at boot
+    SectorHeader header = {HEADER_MAGIC, maxSequence + 1, count, FORMAT_VERSION, 0, 0};
+    header.crc = slotCrc(&header);
+    if (!writeSlot(sector, 0, &header)) {
+        return false;
+    }
+    maxSequence = header.sequence;
+    return true;
+}
+
+void ScoreJournal::countFlashError() {
+    portENTER_CRITICAL(&statsMux);
+    stats.flashErrors++;
+    portEXIT_CRITICAL(&statsMux);
+}
+
+uint32_t ScoreJournal::slotCrc(const void* slot) {
+    // Every byte of the slot but the CRC in its last 4 bytes
+    return crc32(static_cast<const uint8_t*>(slot), SLOT_BYTES - sizeof(uint32_t));
+}
+
+bool ScoreJournal::isErased(const void* slot) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(slot);
+    for (uint16_t i = 0; i < SLOT_BYTES; i++) {
+        if (bytes[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
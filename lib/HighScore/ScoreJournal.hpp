@@ -0,0 +1,150 @@
+#pragma once
+
+#include <Arduino.h>
+#include <esp_partition.h>
+
+// Append-only journal of the high scores in a flash partition of its own, so a new score costs a 16-byte record
+// instead of rewriting the score tables.
+//
+// The partition is a ring of 4 KB sectors, one of them active. A sector holds a header slot, a snapshot of the
+// score tables (a record per entry), then the records appended since; every slot is 16 bytes with a CRC-32, so
+// replaying the active sector rebuilds the tables. When the active sector is full, the compaction erases the next
+// sector of the ring, writes the snapshot of the current tables to it and its header last: the header commits
+// the sector, so a power cut at any point leaves the old sector or the new one valid, the newer one being active.
+// A record torn by a power cut fails its CRC and is skipped, the next records are appended after it. The sectors
+// are used in turn, so their erases are spread evenly over the ring.
+
+/**
+ * Journal statistics, to check its flash wear and the records lost to power cuts
+ */
+struct ScoreJournalStats {
+    uint8_t sectors;            // Sectors of the ring, 0 without a journal partition
+    uint8_t activeSector;
+    uint32_t sequence;          // Compactions since the partition was first written
+    uint16_t usedSlots;         // Slots of the active sector written: header, snapshot, records and torn records
+    uint16_t freeSlots;         // Records that can be appended before the next compaction
+    uint16_t tornRecords;       // Records of the active sector that failed their CRC at boot
+    uint32_t appends;           // Records appended since boot
+    uint32_t compactions;       // Snapshots written since boot
+    uint32_t sectorErases;      // Since boot
+    uint32_t flashErrors;       // Failed flash operations and written slots that did not read back, since boot
+
+    /**
+     * Print the statistics in a human readable format
+     * @param out Where to print the statistics (e.g. Serial)
+     */
+    void printTo(Print& out) const {
+        if (sectors == 0) {
+            out.println("Score journal: no partition, the scores are stored in NVS");
+            return;
+        }
+        out.printf("Score journal: sector %u of %u, sequence %lu, %u slots used, %u free, %u torn records\n",
+            activeSector, sectors, (unsigned long)sequence, usedSlots, freeSlots, tornRecords);
+        out.printf("  since boot: %lu records appended, %lu compactions, %lu sector erases, %lu flash errors\n",
+            (unsigned long)appends, (unsigned long)compactions, (unsigned long)sectorErases,
+            (unsigned long)flashErrors);
+    }
+};
+
+class ScoreJournal {
+public:
+    static constexpr uint32_t SECTOR_BYTES = 4096;
+    static constexpr uint16_t SLOT_BYTES = 16;
+    static constexpr uint16_t SLOTS_PER_SECTOR = SECTOR_BYTES / SLOT_BYTES;
+    static constexpr uint8_t MAX_SECTORS = 16;
+
+    enum class RecordType : uint8_t {
+        TODAY_SCORE = 1,        // Snapshot entry of a per-level table: level index, rank, name, time
+        ALL_TIME_SCORE = 2,     // Snapshot entry of the all-time table: level, rank, name, time
+        NEW_SCORE = 3,          // A score written: level, name, time
+        RESET_TODAY = 4,        // The per-level tables reset to the default scores: time of the defaults
+    };
+
+    struct Record {
+        RecordType type;
+        uint8_t level;          // GameLevel value, the table index for TODAY_SCORE
+        uint8_t rank;
+        char name[3];
+        uint8_t reserved[2];
+        uint32_t timeMs;
+        uint32_t crc;           // Computed by the journal
+    };
+    static_assert(sizeof(Record) == SLOT_BYTES, "a record fills a slot");
+
+    typedef void (*RecordHandler)(const Record& record, void* context);
+
+    /**
+     * Mounts the journal: finds the active sector and the end of its records.
+     * @param partition The journal partition, nullptr if the partition table has none.
+     * @return true if the partition can hold a journal (at least 2 sectors), even if it holds none yet.
+     */
+    bool begin(const esp_partition_t* partition);
+
+    /**
+     * Checks if the partition holds a committed snapshot, so replay() rebuilds the tables.
+     */
+    bool hasSnapshot() const { return activeSector >= 0; }
+
+    /**
+     * Reads the active sector: the snapshot records, then the records appended after it, in order.
+     * @param handler Called with each record.
+     * @param context Passed to the handler.
+     * @return false if there is no snapshot or the flash cannot be read.
+     */
+    bool replay(RecordHandler handler, void* context);
+
+    /**
+     * Appends a record to the active sector.
+     * @param record The record, its CRC is computed here.
+     * @return false if the sector is full or the flash fails: the caller compacts.
+     */
+    bool append(const Record& record);
+
+    /**
+     * Writes a snapshot to the next sector of the ring and makes it the active one. The records are the current
+     * tables, with every record appended so far applied.
+     * @param records The snapshot records.
+     * @param count Number of records, less than SLOTS_PER_SECTOR.
+     * @return false if no sector of the ring could be written, the active sector is unchanged.
+     */
+    bool compact(const Record* records, uint16_t count);
+
+    ScoreJournalStats getStats() const;
+
+private:
+    static constexpr uint32_t HEADER_MAGIC = 0x4A534D42;   // "BMSJ"
+    static constexpr uint8_t FORMAT_VERSION = 1;
+
+    // First slot of a sector, written after the snapshot to commit it
+    struct SectorHeader {
+        uint32_t magic;
+        uint32_t sequence;
+        uint16_t snapshotRecords;
+        uint8_t version;
+        uint8_t reserved;
+        uint32_t crc;
+    };
+    static_assert(sizeof(SectorHeader) == SLOT_BYTES, "a header fills a slot");
+
+    const esp_partition_t* partition = nullptr;
+    uint8_t sectorCount = 0;
+    int8_t activeSector = -1;
+    uint32_t sequence = 0;              // Of the active sector
+    uint32_t maxSequence = 0;           // Of every committed sector, the next snapshot gets a higher one
+    uint16_t snapshotRecords = 0;
+    uint16_t nextSlot = 0;              // First erased slot of the active sector
+    uint16_t tornRecords = 0;
+
+    ScoreJournalStats stats = {};
+    mutable portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+
+    bool readHeader(uint8_t sector, SectorHeader& header);
+    bool checkSnapshot(uint8_t sector, uint16_t count);
+    bool scanRecords();
+    bool writeSlot(uint8_t sector, uint16_t slot, const void* data);
+    bool writeSnapshot(uint8_t sector, const Record* records, uint16_t count);
+    uint32_t slotOffset(uint8_t sector, uint16_t slot) const { return sector * SECTOR_BYTES + slot * SLOT_BYTES; }
+    void countFlashError();
+    static uint32_t slotCrc(const void* slot);
+    static bool isErased(const void* slot);
+};
@@ -0,0 +1,370 @@
+#include "I2CBus.hpp"
+
+namespace {
+    uint8_t priorityIndex(I2CPriority priority) {
+        return priority == I2CPriority::DEVICE_DEFAULT ? static_cast<uint8_t>(I2CPriority::NORMAL)
+                                                       : static_cast<uint8_t>(priority);
+    }
+}
+
+I2CRequest::I2CRequest() {
+    completion = xSemaphoreCreateBinaryStatic(&completionBuffer);
+}
+
+I2CRequest::~I2CRequest() {
+    vSemaphoreDelete(completion);
+}
+
+void I2CRequest::setRead(uint8_t newAddr, uint8_t newReg, uint8_t* buffer, uint8_t newLength, bool newRepeatedStart,
+                         bool newMergeable) {
+    type = Type::READ;
+    addr = newAddr;
+    reg = newReg;
+    readBuffer = buffer;
+    writeData = nullptr;
+    length = newLength;
+    repeatedStart = newRepeatedStart;
+    mergeable = newMergeable;
+}
+
+void I2CRequest::setWrite(uint8_t newAddr, uint8_t newReg, const uint8_t* data, uint8_t newLength) {
+    type = Type::WRITE;
+    addr = newAddr;
+    reg = newReg;
+    readBuffer = nullptr;
+    writeData = data;
+    length = newLength;
+    mergeable = false;
+}
+
+void I2CRequest::setProbe(uint8_t newAddr) {
+    type = Type::PROBE;
+    addr = newAddr;
+    readBuffer = nullptr;
+    writeData = nullptr;
+    length = 0;
+    mergeable = false;
+}
+
+bool I2CRequest::wait(TickType_t timeout) {
+    if (!done && xSemaphoreTake(completion, timeout) == pdTRUE) {
+        done = true;
+    }
+    return done;
+}
+
+bool I2CRequest::isDone() {
+    return wait(0);
+}
+
+void I2CBus::run() {
+    portENTER_CRITICAL(&statsMux);
+    windowStartUs = esp_timer_get_time();
+    portEXIT_CRITICAL(&statsMux);
+    busTask = xTaskGetCurrentTaskHandle();
+
+    I2CRequest* group[MAX_MERGED_REQUESTS];
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        uint8_t count;
+        while ((count = popNext(group)) > 0) {
+            execute(group, count);
+        }
+    }
+}
+
+void I2CBus::submit(I2CRequest& request) {
+    request.done = false;
+    request.ok = false;
+    request.next = nullptr;
+    request.submitUs = esp_timer_get_time();
+
+    // Before the bus task starts, and for requests issued by the bus task itself, execute in place
+    if (busTask == nullptr || xTaskGetCurrentTaskHandle() == busTask) {
+        I2CRequest* group[1] = {&request};
+        execute(group, 1);
+        return;
+    }
+
+    uint8_t priority = priorityIndex(request.priority);
+    portENTER_CRITICAL(&queueMux);
+    if (queueTail[priority] != nullptr) {
+        queueTail[priority]->next = &request;
+    } else {
+        queueHead[priority] = &request;
+    }
+    queueTail[priority] = &request;
+    queueDepth++;
+    uint8_t depth = queueDepth;
+    portEXIT_CRITICAL(&queueMux);
+
+    portENTER_CRITICAL(&statsMux);
+    if (depth > maxQueueDepth) {
+        maxQueueDepth = depth;
+    }
+    portEXIT_CRITICAL(&statsMux);
+    xTaskNotifyGive(busTask);
+}
+
+bool I2CBus::executeSync(I2CRequest& request) {
+    submit(request);
+    request.wait();
+    return request.isOk();
+}
+
+bool I2CBus::read(uint8_t addr, uint8_t reg, uint8_t* buffer, uint8_t length, I2CPriority priority,
+                  bool repeatedStart, bool mergeable) {
+    I2CRequest request;
+    request.setRead(addr, reg, buffer, length, repeatedStart, mergeable);
+    request.setPriority(priority);
+    return executeSync(request);
+}
+
+bool I2CBus::write(uint8_t addr, uint8_t reg, const uint8_t* data, uint8_t length, I2CPriority priority) {
+    I2CRequest request;
+    request.setWrite(addr, reg, data, length);
+    request.setPriority(priority);
+    return executeSync(request);
+}
+
+bool I2CBus::post(uint8_t addr, uint8_t reg, const uint8_t* data, uint8_t length, I2CPriority priority) {
+    if (length > MAX_POSTED_WRITE_LENGTH) {
+        return false;
+    }
+    PostedWrite* posted = nullptr;
+    portENTER_CRITICAL(&queueMux);
+    for (PostedWrite& candidate : postedWrites) {
+        if (!candidate.inUse) {
+            candidate.inUse = true;
+            posted = &candidate;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&queueMux);
+    if (posted == nullptr) {
+        return write(addr, reg, data, length, priority);
+    }
+
+    memcpy(posted->data, data, length);
+    posted->request.setWrite(addr, reg, posted->data, length);
+    posted->request.setPriority(priority);
+    posted->request.setCallback(releasePostedWrite, this);
+    submit(posted->request);
+    return true;
+}
+
+void I2CBus::releasePostedWrite(I2CRequest& request, void* context) {
+    I2CBus* bus = static_cast<I2CBus*>(context);
+    portENTER_CRITICAL(&bus->queueMux);
+    for (PostedWrite& posted : bus->postedWrites) {
+        if (&posted.request == &request) {
+            posted.inUse = false;
+        }
+    }
+    portEXIT_CRITICAL(&bus->queueMux);
+}
+
+bool I2CBus::probe(uint8_t addr, I2CPriority priority) {
+    I2CRequest request;
+    request.setProbe(addr);
+    request.setPriority(priority);
+    return executeSync(request);
+}
+
+uint8_t I2CBus::popNext(I2CRequest* group[MAX_MERGED_REQUESTS]) {
+    portENTER_CRITICAL(&queueMux);
+    I2CRequest* first = nullptr;
+    for (uint8_t priority = 0; priority < PRIORITIES && first == nullptr; priority++) {
+        first = queueHead[priority];
+        if (first != nullptr) {
+            queueHead[priority] = first->next;
+            if (queueHead[priority] == nullptr) {
+                queueTail[priority] = nullptr;
+            }
+        }
+    }
+    if (first == nullptr) {
+        portEXIT_CRITICAL(&queueMux);
+        return 0;
+    }
+
+    // Serve queued reads of adjacent registers with the same burst
+    group[0] = first;
+    uint8_t count = 1;
+    if (first->type == I2CRequest::Type::READ && first->mergeable) {
+        uint8_t firstReg = first->reg;
+        uint16_t endReg = first->reg + first->length;
+        while (count < MAX_MERGED_REQUESTS && takeAdjacentRead(group, count, firstReg, endReg)) {
+            count++;
+        }
+    }
+    queueDepth -= count;
+    portEXIT_CRITICAL(&queueMux);
+    return count;
+}
+
+bool I2CBus::takeAdjacentRead(I2CRequest* group[], uint8_t count, uint8_t& firstReg, uint16_t& endReg) {
+    const I2CRequest* first = group[0];
+    for (uint8_t priority = 0; priority < PRIORITIES; priority++) {
+        I2CRequest* previous = nullptr;
+        for (I2CRequest* candidate = queueHead[priority]; candidate != nullptr; candidate = candidate->next) {
+            uint16_t candidateEnd = candidate->reg + candidate->length;
+            uint8_t mergedFirst = min(firstReg, candidate->reg);
+            uint16_t mergedEnd = max(endReg, candidateEnd);
+            bool adjacent = candidate->reg <= endReg && candidateEnd >= firstReg;
+            if (candidate->type == I2CRequest::Type::READ && candidate->mergeable && candidate->addr == first->addr &&
+                candidate->repeatedStart == first->repeatedStart && adjacent &&
+                mergedEnd - mergedFirst <= MAX_MERGED_READ_LENGTH) {
+                if (previous != nullptr) {
+                    previous->next = candidate->next;
+                } else {
+                    queueHead[priority] = candidate->next;
+                }
+                if (queueTail[priority] == candidate) {
+                    queueTail[priority] = previous;
+                }
+                group[count] = candidate;
+                firstReg = mergedFirst;
+                endReg = mergedEnd;
+                return true;
+            }
+            previous = candidate;
+        }
+    }
+    return false;
+}
+
+void I2CBus::execute(I2CRequest* group[], uint8_t count) {
+    int64_t startUs = esp_timer_get_time();
+    I2CRequest& first = *group[0];
+    bool ok;
+    if (count == 1) {
+        switch (first.type) {
+            case I2CRequest::Type::READ:
+                ok = transferRead(first.addr, first.reg, first.readBuffer, first.length, first.repeatedStart);
+                break;
+            case I2CRequest::Type::WRITE:
+                ok = transferWrite(first.addr, first.reg, first.writeData, first.length);
+                break;
+            default:
+                ok = transferProbe(first.addr);
+                break;
+        }
+    } else {
+        uint8_t firstReg = first.reg;
+        uint16_t endReg = first.reg + first.length;
+        for (uint8_t i = 1; i < count; i++) {
+            firstReg = min(firstReg, group[i]->reg);
+            endReg = max<uint16_t>(endReg, group[i]->reg + group[i]->length);
+        }
+        uint8_t buffer[MAX_MERGED_READ_LENGTH];
+        ok = transferRead(first.addr, firstReg, buffer, endReg - firstReg, first.repeatedStart);
+        if (ok) {
+            for (uint8_t i = 0; i < count; i++) {
+                memcpy(group[i]->readBuffer, buffer + (group[i]->reg - firstReg), group[i]->length);
+            }
+        }
+    }
+    int64_t endUs = esp_timer_get_time();
+
+    portENTER_CRITICAL(&statsMux);
+    transfers++;
+    requests += count;
+    busyUs += endUs - startUs;
+    if (count > 1) {
+        mergedRequests += count;
+    }
+    if (!ok) {
+        failures += count;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t priority = priorityIndex(group[i]->priority);
+        uint32_t waitUs = static_cast<uint32_t>(startUs - group[i]->submitUs);
+        requestsByPriority[priority]++;
+        totalWaitUs[priority] += waitUs;
+        if (waitUs > maxWaitUs[priority]) {
+            maxWaitUs[priority] = waitUs;
+        }
+    }
+    portEXIT_CRITICAL(&statsMux);
+
+    for (uint8_t i = 0; i < count; i++) {
+        complete(*group[i], ok);
+    }
+}
+
+bool I2CBus::transferRead(uint8_t addr, uint8_t reg, uint8_t* buffer, uint8_t length, bool repeatedStart) {
+    wire.beginTransmission(addr);
+    wire.write(reg);
+    if (wire.endTransmission(!repeatedStart) != 0) {
+        return false;
+    }
+    if (wire.requestFrom(addr, length) != length) {
+        return false;
+    }
+    for (uint8_t i = 0; i < length; i++) {
+        buffer[i] = wire.read();
+    }
+    return true;
+}
+
+bool I2CBus::transferWrite(uint8_t addr, uint8_t reg, const uint8_t* data, uint8_t length) {
+    wire.beginTransmission(addr);
+    wire.write(reg);
+    for (uint8_t i = 0; i < length; i++) {
+        wire.write(data[i]);
+    }
+    return wire.endTransmission() == 0;
+}
+
+bool I2CBus::transferProbe(uint8_t addr) {
+    wire.beginTransmission(addr);
+    return wire.endTransmission() == 0;
+}
+
+void I2CBus::complete(I2CRequest& request, bool ok) {
+    request.ok = ok;
+    if (request.callback != nullptr) {
+        request.callback(request, request.callbackContext);
+    }
+    // Last access: the owner may destroy the request as soon as the completion is signaled
+    xSemaphoreGive(request.completion);
+}
+
+I2CBusStats I2CBus::getStats() const {
+    I2CBusStats stats = {};
+    int64_t nowUs = esp_timer_get_time();
+    portENTER_CRITICAL(&statsMux);
+    stats.requests = requests;
+    stats.transfers = transfers;
+    stats.mergedRequests = mergedRequests;
+    stats.failures = failures;
+    stats.maxQueueDepth = maxQueueDepth;
+    int64_t windowUs = nowUs - windowStartUs;
+    stats.windowMs = static_cast<uint32_t>(windowUs / 1000);
+    stats.utilizationPercent = windowUs > 0 ? 100.0f * static_cast<float>(busyUs) / static_cast<float>(windowUs) : 0.0f;
+    for (uint8_t i = 0; i < PRIORITIES; i++) {
+        stats.requestsByPriority[i] = requestsByPriority[i];
+        stats.meanWaitUs[i] = requestsByPriority[i] > 0 ? static_cast<uint32_t>(totalWaitUs[i] / requestsByPriority[i]) : 0;
+        stats.maxWaitUs[i] = maxWaitUs[i];
+    }
+    portEXIT_CRITICAL(&statsMux);
+    return stats;
+}
+
+void I2CBus::resetStats() {
+    portENTER_CRITICAL(&statsMux);
+    requests = 0;
+    transfers = 0;
+    mergedRequests = 0;
+    failures = 0;
+    maxQueueDepth = 0;
+    busyUs = 0;
+    windowStartUs = esp_timer_get_time();
+    for (uint8_t i = 0; i < PRIORITIES; i++) {
+        requestsByPriority[i] = 0;
+        totalWaitUs[i] = 0;
+        maxWaitUs[i] = 0;
+    }
+    portEXIT_CRITICAL(&statsMux);
+}
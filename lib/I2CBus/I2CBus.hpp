@@ -0,0 +1,271 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+/**
+ * Priority of an I2C transaction. Queued transactions are executed highest priority first, in submission order
+ * within the same priority.
+ */
+enum class I2CPriority : uint8_t {
+    CRITICAL = 0,       // Sensors sampled on a deadline (e.g. the IMU)
+    NORMAL = 1,         // User inputs (e.g. buttons)
+    BACKGROUND = 2,     // Outputs that can wait (e.g. LEDs)
+    DEVICE_DEFAULT = 3  // Use the default priority of the I2CDevice issuing the transaction
+};
+
+class I2CRequest;
+
+/**
+ * Completion callback of an asynchronous I2C transaction. Runs in the I2C bus task: it must be short and must
+ * not wait for other I2C transactions.
+ * @param request The completed request.
+ * @param context The context passed to I2CRequest::setCallback.
+ */
+typedef void (*I2CCallback)(I2CRequest& request, void* context);
+
+/**
+ * I2CRequest is a single I2C transaction (register read, register write or address probe) submitted to an
+ * I2CBus. It doubles as the future of the transaction: wait() blocks until the bus task has completed it.
+ * The request and its data buffer are owned by the caller and must stay valid until the transaction completes,
+ * except for the requests of the writes posted to the bus (see I2CBus::post), which the bus owns.
+ */
+class I2CRequest {
+public:
+    I2CRequest();
+    ~I2CRequest();
+    I2CRequest(const I2CRequest&) = delete;
+    I2CRequest& operator=(const I2CRequest&) = delete;
+
+    /**
+     * Prepares a register read.
+     * @param addr I2C address of the device.
+     * @param reg First register to read.
+     * @param buffer Where to store the data.
+     * @param length Number of bytes to read.
+     * @param repeatedStart true to read after a repeated start, false to stop after writing the register address.
+     * @param mergeable true if the device auto-increments the register address, so the read can be served by a
+     *                  single burst together with queued reads of adjacent registers.
+     */
+    void setRead(uint8_t addr, uint8_t reg, uint8_t* buffer, uint8_t length, bool repeatedStart = true,
+                 bool mergeable = false);
+
+    /**
+     * Prepares a register write.
+     * @param addr I2C address of the device.
+     * @param reg First register to write.
+     * @param data Data to write.
+     * @param length Number of bytes to write.
+     */
+    void setWrite(uint8_t addr, uint8_t reg, const uint8_t* data, uint8_t length);
+
+    /**
+     * Prepares an address probe (empty write) to check that a device acknowledges its address.
+     * @param addr I2C address of the device.
+     */
+    void setProbe(uint8_t addr);
+
+    void setPriority(I2CPriority newPriority) {
+        priority = newPriority;
+    }
+
+    /**
+     * Sets a function called by the bus task when the transaction completes.
+     * @param newCallback Function to call, or nullptr.
+     * @param newContext Context passed to the function.
+     */
+    void setCallback(I2CCallback newCallback, void* newContext) {
+        callback = newCallback;
+        callbackContext = newContext;
+    }
+
+    /**
+     * Waits for the transaction to complete.
+     * @param timeout Maximum time to wait in ticks.
+     * @return true if the transaction completed, false on timeout.
+     */
+    bool wait(TickType_t timeout = portMAX_DELAY);
+
+    /**
+     * Checks without blocking whether the transaction has completed.
+     * @return true if the transaction completed, false otherwise.
+     */
+    bool isDone();
+
+    /**
+     * Gets the outcome of the transaction. Valid in the completion callback and once wait() or isDone() returned
+     * true.
+     * @return true if the device acknowledged the transaction, false otherwise.
+     */
+    bool isOk() const {
+        return ok;
+    }
+
+private:
+    friend class I2CBus;
+
+    enum class Type : uint8_t {
+        READ,
+        WRITE,
+        PROBE
+    };
+
+    Type type = Type::PROBE;
+    I2CPriority priority = I2CPriority::NORMAL;
+    uint8_t addr = 0;
+    uint8_t reg = 0;
+    uint8_t length = 0;
+    bool repeatedStart = true;
+    bool mergeable = false;
+    uint8_t* readBuffer = nullptr;
+    const uint8_t* writeData = nullptr;
+    I2CCallback callback = nullptr;
+    void* callbackContext = nullptr;
+
+    bool done = true;           // Only written by the owner: the bus task signals completion through the semaphore
+    bool ok = false;
+    int64_t submitUs = 0;
+    I2CRequest* next = nullptr;
+    StaticSemaphore_t completionBuffer;
+    SemaphoreHandle_t completion = nullptr;
+};
+
+/**
+ * I2C bus metrics
+ */
+struct I2CBusStats {
+    static constexpr uint8_t PRIORITIES = 3;
+
+    uint32_t requests;              // Completed requests
+    uint32_t transfers;             // Bus transfers (merged reads count once)
+    uint32_t mergedRequests;        // Requests served by a transfer shared with other requests
+    uint32_t failures;              // Requests not acknowledged by the device
+    uint8_t maxQueueDepth;          // Most requests waiting at the same time
+    float utilizationPercent;       // Time spent transferring over the measurement window
+    uint32_t windowMs;              // Length of the measurement window
+    uint32_t requestsByPriority[PRIORITIES];
+    uint32_t meanWaitUs[PRIORITIES];    // Mean time from submission to the start of the transfer
+    uint32_t maxWaitUs[PRIORITIES];     // Longest time from submission to the start of the transfer
+
+    /**
+     * Print the metrics in a human readable format
+     * @param out Where to print the metrics (e.g. Serial)
+     */
+    void printTo(Print& out) const {
+        static const char* const priorityNames[PRIORITIES] = {"critical", "normal", "background"};
+        out.printf("I2C bus: %lu requests, %lu transfers, %lu merged, %lu failed, utilization %.1f%% over %lu ms, max queue %u\n",
+            requests, transfers, mergedRequests, failures, utilizationPercent, windowMs, maxQueueDepth);
+        for (uint8_t i = 0; i < PRIORITIES; i++) {
+            out.printf("  %-10s %lu requests, wait mean %lu us, max %lu us\n",
+                priorityNames[i], requestsByPriority[i], meanWaitUs[i], maxWaitUs[i]);
+        }
+    }
+};
+
+/**
+ * I2CBus owns a TwoWire bus and executes the I2C transactions of all the tasks from a single bus task, so that
+ * transactions from different tasks never interleave on the wire. Transactions are queued by priority; queued
+ * reads of adjacent registers of the same device are merged into a single burst when the requests allow it.
+ *
+ * Until run() is started transactions execute directly in the calling task, so devices can be initialized from
+ * setup() before the bus task exists.
+ */
+class I2CBus {
+public:
+    I2CBus(TwoWire& wire) : wire(wire) {}
+
+    /**
+     * Runs the bus task loop. This function runs an infinite loop and should be called from a dedicated task.
+     */
+    void run();
+
+    /**
+     * Queues a transaction. The request must not be already queued.
+     * @param request The transaction to execute; it must stay valid until it completes.
+     */
+    void submit(I2CRequest& request);
+
+    /**
+     * Executes a register read and waits for it to complete.
+     * @return true if the device acknowledged the read, false otherwise.
+     */
+    bool read(uint8_t addr, uint8_t reg, uint8_t* buffer, uint8_t length, I2CPriority priority,
+              bool repeatedStart = true, bool mergeable = false);
+
+    /**
+     * Executes a register write and waits for it to complete.
+     * @return true if the device acknowledged the write, false otherwise.
+     */
+    bool write(uint8_t addr, uint8_t reg, const uint8_t* data, uint8_t length, I2CPriority priority);
+
+    /**
+     * Queues a register write without waiting for it (fire and forget). The data is copied into a request owned
+     * by the bus, so the caller can reuse its buffer at once. When all the posted write requests are in use, the
+     * write is executed as by write().
+     * @param length Number of bytes to write, at most MAX_POSTED_WRITE_LENGTH.
+     * @return true if the write was queued (or executed and acknowledged), false otherwise. A queued write that
+     *         the device does not acknowledge only counts as a failure in the metrics.
+     */
+    bool post(uint8_t addr, uint8_t reg, const uint8_t* data, uint8_t length, I2CPriority priority);
+
+    /**
+     * Checks that a device acknowledges its address.
+     * @return true if the device acknowledged, false otherwise.
+     */
+    bool probe(uint8_t addr, I2CPriority priority = I2CPriority::NORMAL);
+
+    I2CBusStats getStats() const;
+    void resetStats();
+
+    static constexpr uint8_t MAX_POSTED_WRITE_LENGTH = 8;
+
+private:
+    static constexpr uint8_t PRIORITIES = I2CBusStats::PRIORITIES;
+    static constexpr uint8_t MAX_MERGED_REQUESTS = 8;
+    static constexpr uint8_t MAX_MERGED_READ_LENGTH = 32;
+    static constexpr uint8_t POSTED_WRITES = 8;
+
+    // A write posted to the bus: nobody waits for its request, the completion callback frees it
+    struct PostedWrite {
+        I2CRequest request;
+        uint8_t data[MAX_POSTED_WRITE_LENGTH];
+        bool inUse = false;     // Guarded by queueMux
+    };
+
+    TwoWire& wire;
+    TaskHandle_t busTask = nullptr;
+    PostedWrite postedWrites[POSTED_WRITES];
+
+    // Pending requests, one FIFO list per priority
+    portMUX_TYPE queueMux = portMUX_INITIALIZER_UNLOCKED;
+    I2CRequest* queueHead[PRIORITIES] = {};
+    I2CRequest* queueTail[PRIORITIES] = {};
+    uint8_t queueDepth = 0;
+
+    // Metrics
+    mutable portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+    uint32_t requests = 0;
+    uint32_t transfers = 0;
+    uint32_t mergedRequests = 0;
+    uint32_t failures = 0;
+    uint8_t maxQueueDepth = 0;
+    int64_t busyUs = 0;
+    int64_t windowStartUs = 0;
+    uint32_t requestsByPriority[PRIORITIES] = {};
+    uint64_t totalWaitUs[PRIORITIES] = {};
+    uint32_t maxWaitUs[PRIORITIES] = {};
+
+    bool executeSync(I2CRequest& request);
+    static void releasePostedWrite(I2CRequest& request, void* context);
+    uint8_t popNext(I2CRequest* group[MAX_MERGED_REQUESTS]);
+    bool takeAdjacentRead(I2CRequest* group[], uint8_t count, uint8_t& firstReg, uint16_t& endReg);
+    void execute(I2CRequest* group[], uint8_t count);
+    bool transferRead(uint8_t addr, uint8_t reg, uint8_t* buffer, uint8_t length, bool repeatedStart);
+    bool transferWrite(uint8_t addr, uint8_t reg, const uint8_t* data, uint8_t length);
+    bool transferProbe(uint8_t addr);
+    void complete(I2CRequest& request, bool ok);
+};
@@ -1,33 +1,51 @@
 #pragma once
 
 #include <Arduino.h>
-#include <Wire.h>
+#include <I2CBus.hpp>
 
 /**
  * I2CDevice is a base class for communicating with I2C devices. It provides methods to initialize communication,
  * write bytes to a device register, and read bytes from a device register. Derived classes can implement specific
  * functionality for different I2C devices by utilizing these basic read/write operations.
+ * All the transactions go through the I2CBus shared by the devices, with the default priority of the device unless
+ * a priority is given.
  */
 class I2CDevice {
     protected:
         uint8_t addr;
-        TwoWire& wire;
+        I2CBus& bus;
+        I2CPriority priority;
+        bool registerAutoIncrement;
+
+        inline I2CPriority resolvePriority(I2CPriority requested) const {
+            return requested == I2CPriority::DEVICE_DEFAULT ? priority : requested;
+        }
 
         /**
          * Write multiple bytes to the device starting from a specific register.
          * @param reg The starting register address to write to.
          * @param buffer Pointer to the data buffer to be written.
          * @param length The number of bytes to write from the buffer.
+         * @param requestPriority Priority of the transaction.
          * @return true if the write operation was successful, false otherwise.
          */
-        inline bool writeBytes(uint8_t reg, uint8_t *buffer, uint8_t length) {
-            wire.beginTransmission(addr);
-            wire.write(reg);
-            for (uint8_t i = 0; i < length; i++) {
-                wire.write(*(buffer + i));
-            }
-            if (wire.endTransmission() == 0) return true;
-            return false;
+        inline bool writeBytes(uint8_t reg, const uint8_t *buffer, uint8_t length,
+                               I2CPriority requestPriority = I2CPriority::DEVICE_DEFAULT) {
+            return bus.write(addr, reg, buffer, length, resolvePriority(requestPriority));
+        }
+
+        /**
+         * Queue a write of multiple bytes to the device without waiting for it to complete. The data is copied, the
+         * buffer can be reused at once.
+         * @param reg The starting register address to write to.
+         * @param buffer Pointer to the data buffer to be written.
+         * @param length The number of bytes to write from the buffer, at most I2CBus::MAX_POSTED_WRITE_LENGTH.
+         * @param requestPriority Priority of the transaction.
+         * @return true if the write was queued, false otherwise.
+         */
+        inline bool postBytes(uint8_t reg, const uint8_t *buffer, uint8_t length,
+                              I2CPriority requestPriority = I2CPriority::DEVICE_DEFAULT) {
+            return bus.post(addr, reg, buffer, length, resolvePriority(requestPriority));
         }
 
         /**
@@ -35,20 +53,26 @@ class I2CDevice {
          * @param reg The starting register address to read from.
          * @param buffer Pointer to the data buffer where the read bytes will be stored.
          * @param length The number of bytes to read into the buffer.
+         * @param requestPriority Priority of the transaction.
+         * @return true if the read operation was successful, false otherwise.
+         */
+        inline bool readBytes(uint8_t reg, uint8_t *buffer, uint8_t length,
+                              I2CPriority requestPriority = I2CPriority::DEVICE_DEFAULT) {
+            return bus.read(addr, reg, buffer, length, resolvePriority(requestPriority), true, registerAutoIncrement);
+        }
+
+        /**
+         * Read multiple bytes from a register that does not auto-increment (e.g. a FIFO data register). The read
+         * is never merged with reads of adjacent registers.
+         * @param reg The register address to read from.
+         * @param buffer Pointer to the data buffer where the read bytes will be stored.
+         * @param length The number of bytes to read into the buffer.
+         * @param requestPriority Priority of the transaction.
          * @return true if the read operation was successful, false otherwise.
          */
-        inline bool readBytes(uint8_t reg, uint8_t *buffer, uint8_t length) {
-            uint8_t index = 0;
-            wire.beginTransmission(addr);
-            wire.write(reg);
-            wire.endTransmission(false);
-            if (wire.requestFrom(addr, length)) {
-                for (uint8_t i = 0; i < length; i++) {
-                    buffer[index++] = wire.read();
-                }
-                return true;
-            }
-            return false;
+        inline bool readStream(uint8_t reg, uint8_t *buffer, uint8_t length,
+                               I2CPriority requestPriority = I2CPriority::DEVICE_DEFAULT) {
+            return bus.read(addr, reg, buffer, length, resolvePriority(requestPriority), true, false);
         }
 
         /**
@@ -68,54 +92,61 @@ class I2CDevice {
          * Write a 16-bit unsigned integer to the device starting from a specific register.
          * @param reg The starting register address to write to.
          * @param value The 16-bit value to write.
+         * @param requestPriority Priority of the transaction.
          * @return true if the write operation was successful, false otherwise.
          */
-        inline bool writeUint16(uint8_t reg, uint16_t value) {
+        inline bool writeUint16(uint8_t reg, uint16_t value, I2CPriority requestPriority = I2CPriority::DEVICE_DEFAULT) {
             uint8_t write_buf[2];
             write_buf[0] = value & 0xff;
             write_buf[1] = value >> 8;
-            return writeBytes(reg, write_buf, 2);
+            return writeBytes(reg, write_buf, 2, requestPriority);
         }
 
         /**
          * Read a single byte from the device starting from a specific register.
          * @param reg The register address to read from.
          * @param data Pointer to the variable where the read byte will be stored.
+         * @param requestPriority Priority of the transaction.
          * @return true if the read operation was successful, false otherwise.
          */
-        inline bool readByte(uint8_t reg, uint8_t *data) {
-            wire.beginTransmission(addr);
-            wire.write(reg);
-            wire.endTransmission();
-
-            if (wire.requestFrom(addr, (uint8_t)1)) {
-                *data = wire.read();
-                return true;
-            }
-
-            return false;
+        inline bool readByte(uint8_t reg, uint8_t *data, I2CPriority requestPriority = I2CPriority::DEVICE_DEFAULT) {
+            // The register address is sent with a stop condition before the read
+            return bus.read(addr, reg, data, 1, resolvePriority(requestPriority), false, registerAutoIncrement);
         }
 
         /**
          * Write a single byte to the device starting from a specific register.
          * @param reg The register address to write to.
          * @param data The byte to write.
+         * @param requestPriority Priority of the transaction.
          * @return true if the write operation was successful, false otherwise.
          */
-        inline bool writeByte(uint8_t reg, uint8_t data) {
-            wire.beginTransmission(addr);
-            wire.write(reg);
-            wire.write(data);
-            return (wire.endTransmission() == 0);
+        inline bool writeByte(uint8_t reg, uint8_t data, I2CPriority requestPriority = I2CPriority::DEVICE_DEFAULT) {
+            return bus.write(addr, reg, &data, 1, resolvePriority(requestPriority));
+        }
+
+        /**
+         * Queue a write of a single byte to the device without waiting for it to complete.
+         * @param reg The register address to write to.
+         * @param data The byte to write.
+         * @param requestPriority Priority of the transaction.
+         * @return true if the write was queued, false otherwise.
+         */
+        inline bool postByte(uint8_t reg, uint8_t data, I2CPriority requestPriority = I2CPriority::DEVICE_DEFAULT) {
+            return bus.post(addr, reg, &data, 1, resolvePriority(requestPriority));
         }
 
    public:
         /** 
          * Constructor for I2CDevice.
-         * @param wire Reference to the TwoWire instance (I2C bus) to use for communication.
+         * @param bus Reference to the I2CBus that executes the transactions.
          * @param addr The I2C address of the device.
+         * @param priority Default priority of the transactions of the device.
+         * @param registerAutoIncrement true if the device auto-increments the register address on multi-byte reads,
+         *                              so queued reads of adjacent registers can be merged into a single burst.
         */
-        I2CDevice(TwoWire &wire, uint8_t addr) : wire(wire), addr(addr) 
+        I2CDevice(I2CBus &bus, uint8_t addr, I2CPriority priority = I2CPriority::NORMAL, bool registerAutoIncrement = false)
+            : addr(addr), bus(bus), priority(priority), registerAutoIncrement(registerAutoIncrement)
         {
         }
 
@@ -124,4 +155,4 @@ class I2CDevice {
          * @return true if the device acknowledges its address, false otherwise.
          */
         bool begin();
-};
\ No newline at end of file
+};
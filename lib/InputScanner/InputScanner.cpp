@@ -0,0 +1,180 @@
+#include "InputScanner.hpp"
+
+uint8_t InputScanner::addInput(uint8_t channel, uint8_t index, bool activeLow) {
+    if (inputCount >= MAX_INPUTS || channel >= PBHUB_CHANNELS || index > 1) {
+        return INVALID_INPUT;
+    }
+
+    Input& input = inputs[inputCount];
+    input.channel = channel;
+    input.index = index;
+    input.activeLow = activeLow;
+    input.rawChangeUs = 0;
+    input.lastRaw = false;
+    return inputCount++;
+}
+
+bool InputScanner::begin() {
+    eventQueue = xQueueCreate(EVENT_QUEUE_LENGTH, sizeof(InputEvent));
+    if (eventQueue == nullptr) {
+        return false;
+    }
+
+    scan();
+    return true;
+}
+
+void InputScanner::scanLoop(uint16_t periodMs) {
+    TickType_t lastWake = xTaskGetTickCount();
+    while (true) {
+        scan();
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(periodMs));
+    }
+}
+
+void InputScanner::scan() {
+    int64_t scanUs = esp_timer_get_time();
+    uint32_t nowMs = millis();
+
+    // The registered pins of each channel, one single-byte read each
+    uint8_t channelPins[PBHUB_CHANNELS] = {};
+    for (uint8_t i = 0; i < inputCount; i++) {
+        channelPins[inputs[i].channel] |= 1 << inputs[i].index;
+    }
+    uint8_t channelValues[PBHUB_CHANNELS] = {};
+    bool channelOk[PBHUB_CHANNELS] = {};
+    bool failed = false;
+    for (uint8_t channel = 0; channel < PBHUB_CHANNELS; channel++) {
+        if (channelPins[channel] != 0) {
+            channelOk[channel] = hub.digitalReadChannel(channel, channelPins[channel], channelValues[channel]);
+            failed |= !channelOk[channel];
+        }
+    }
+
+    uint16_t newSnapshot = 0;
+    for (uint8_t i = 0; i < inputCount; i++) {
+        Input& input = inputs[i];
+        bool raw = input.lastRaw;   // Keep the last state rather than inventing an edge from a failed read
+        if (channelOk[input.channel]) {
+            bool level = (channelValues[input.channel] >> input.index) & 0x01;
+            raw = input.activeLow ? !level : level;
+        }
+        if (raw != input.lastRaw) {
+            input.lastRaw = raw;
+            if (input.rawChangeUs == 0) {
+                input.rawChangeUs = scanUs;
+            }
+        }
+
+        Button& button = input.button;
+        button.setRawState(nowMs, raw);
+        if (button.wasPressed() || button.wasReleased()) {
+            if (input.rawChangeUs != 0) {
+                uint32_t latencyUs = static_cast<uint32_t>(scanUs - input.rawChangeUs);
+                portENTER_CRITICAL(&statsMux);
+                edgeCount++;
+                totalEdgeLatencyUs += latencyUs;
+                maxEdgeLatencyUs = max(maxEdgeLatencyUs, latencyUs);
+                portEXIT_CRITICAL(&statsMux);
+                input.rawChangeUs = 0;
+            }
+            publish(i, button.wasPressed() ? InputEvent::Type::PRESSED : InputEvent::Type::RELEASED, 0, scanUs);
+        }
+        if (button.wasHold()) {
+            publish(i, InputEvent::Type::HOLD, 0, scanUs);
+        }
+        if (button.wasDecideClickCount()) {
+            publish(i, InputEvent::Type::CLICKED, button.getClickCount(), scanUs);
+        }
+        if (raw == (button.isPressed() != 0)) {
+            input.rawChangeUs = 0;  // Bounce settled back to the debounced state
+        }
+
+        if (button.isPressed()) {
+            newSnapshot |= 1u << i;
+        }
+        if (raw) {
+            newSnapshot |= 1u << (i + RAW_SHIFT);
+        }
+    }
+    snapshot.store(newSnapshot, std::memory_order_release);
+
+    uint32_t scanDurationUs = static_cast<uint32_t>(esp_timer_get_time() - scanUs);
+    portENTER_CRITICAL(&statsMux);
+    if (scans > 0) {
+        maxScanPeriodMs = max(maxScanPeriodMs, nowMs - lastScanMs);
+    }
+    lastScanMs = nowMs;
+    scans++;
+    if (failed) {
+        failedScans++;
+    }
+    maxScanUs = max(maxScanUs, scanDurationUs);
+    portEXIT_CRITICAL(&statsMux);
+}
+
+void InputScanner::publish(uint8_t input, InputEvent::Type type, uint8_t clickCount, int64_t scanUs) {
+    InputEvent event = {input, type, clickCount, scanUs};
+    bool queued = xQueueSendToBack(eventQueue, &event, 0) == pdTRUE;
+    portENTER_CRITICAL(&statsMux);
+    if (queued) {
+        events++;
+    } else {
+        droppedEvents++;
+    }
+    portEXIT_CRITICAL(&statsMux);
+}
+
+bool InputScanner::popEvent(InputEvent& event, TickType_t timeout) {
+    if (eventQueue == nullptr || xQueueReceive(eventQueue, &event, timeout) != pdTRUE) {
+        return false;
+    }
+
+    uint32_t deliveryUs = static_cast<uint32_t>(esp_timer_get_time() - event.scanUs);
+    portENTER_CRITICAL(&statsMux);
+    deliveredEvents++;
+    totalDeliveryUs += deliveryUs;
+    maxDeliveryUs = max(maxDeliveryUs, deliveryUs);
+    portEXIT_CRITICAL(&statsMux);
+    return true;
+}
+
+void InputScanner::clearEvents() {
+    if (eventQueue != nullptr) {
+        xQueueReset(eventQueue);
+    }
+}
+
+InputScannerStats InputScanner::getStats() const {
+    InputScannerStats stats;
+    portENTER_CRITICAL(&statsMux);
+    stats.scans = scans;
+    stats.failedScans = failedScans;
+    stats.maxScanUs = maxScanUs;
+    stats.maxScanPeriodMs = maxScanPeriodMs;
+    stats.events = events;
+    stats.droppedEvents = droppedEvents;
+    stats.meanEdgeLatencyUs = edgeCount > 0 ? static_cast<uint32_t>(totalEdgeLatencyUs / edgeCount) : 0;
+    stats.maxEdgeLatencyUs = maxEdgeLatencyUs;
+    stats.meanDeliveryUs = deliveredEvents > 0 ? static_cast<uint32_t>(totalDeliveryUs / deliveredEvents) : 0;
+    stats.maxDeliveryUs = maxDeliveryUs;
+    portEXIT_CRITICAL(&statsMux);
+    return stats;
+}
+
+void InputScanner::resetStats() {
+    portENTER_CRITICAL(&statsMux);
+    scans = 0;
+    failedScans = 0;
+    maxScanUs = 0;
+    maxScanPeriodMs = 0;
+    events = 0;
+    droppedEvents = 0;
+    edgeCount = 0;
+    totalEdgeLatencyUs = 0;
+    maxEdgeLatencyUs = 0;
+    deliveredEvents = 0;
+    totalDeliveryUs = 0;
+    maxDeliveryUs = 0;
+    portEXIT_CRITICAL(&statsMux);
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <Button.hpp>
+#include <M5UnitPbHub.hpp>
+
+/**
+ * Debounced input edge or gesture published by the InputScanner
+ */
+struct InputEvent {
+    enum class Type : uint8_t {
+        PRESSED,        // Debounced press
+        RELEASED,       // Debounced release
+        HOLD,           // Held pressed past the hold threshold
+        CLICKED         // Click sequence finished; clickCount holds the number of clicks
+    };
+
+    uint8_t input;          // Input id returned by InputScanner::addInput
+    Type type;
+    uint8_t clickCount;
+    int64_t scanUs;         // Start of the scan that produced the event
+};
+
+/**
+ * Input scanner timing metrics
+ */
+struct InputScannerStats {
+    uint32_t scans;             // Completed scans
+    uint32_t failedScans;       // Scans with at least one failed I2C read
+    uint32_t maxScanUs;         // Longest scan (I2C transactions included)
+    uint32_t maxScanPeriodMs;   // Longest time between consecutive scans
+    uint32_t events;            // Events published
+    uint32_t droppedEvents;     // Events lost because the queue was full
+    uint32_t meanEdgeLatencyUs; // Mean time from the first scan seeing a raw change to the debounced event
+    uint32_t maxEdgeLatencyUs;  // Longest time from the first scan seeing a raw change to the debounced event
+    uint32_t meanDeliveryUs;    // Mean time from the scan producing an event to its consumption
+    uint32_t maxDeliveryUs;     // Longest time from the scan producing an event to its consumption
+
+    /**
+     * Print the metrics in a human readable format
+     * @param out Where to print the metrics (e.g. Serial)
+     */
+    void printTo(Print& out) const {
+        out.printf("Input scanner: %lu scans (%lu failed), max scan %lu us, max period %lu ms\n",
+            scans, failedScans, maxScanUs, maxScanPeriodMs);
+        out.printf("  %lu events (%lu dropped), edge latency mean %lu us max %lu us, delivery mean %lu us max %lu us\n",
+            events, droppedEvents, meanEdgeLatencyUs, maxEdgeLatencyUs, meanDeliveryUs, maxDeliveryUs);
+    }
+};
+
+/**
+ * InputScanner reads all the digital inputs wired to the PbHub at a fixed rate, with one single-byte I2C read per
+ * input (the PbHub registers do not auto-increment), and runs each input through a Button debouncer. The debounced state is published as an atomic
+ * snapshot and the edges and gestures as an event queue, so consumers never touch the I2C bus.
+ * The queue has a single consumer.
+ */
+class InputScanner {
+public:
+    static constexpr uint8_t MAX_INPUTS = 8;
+    static constexpr uint8_t INVALID_INPUT = 0xFF;
+
+    InputScanner(M5UnitPbHub& hub) : hub(hub) {}
+
+    /**
+     * Registers a PbHub input. All the inputs must be added before begin().
+     * @param channel PbHub channel (0-7).
+     * @param index Pin of the channel (0-1).
+     * @param activeLow true if the input reads LOW when pressed.
+     * @return The input id, or INVALID_INPUT if no more inputs can be added.
+     */
+    uint8_t addInput(uint8_t channel, uint8_t index, bool activeLow = true);
+
+    /**
+     * Creates the event queue and performs the first scan, so the raw state is available right away.
+     * @return true if the scanner is ready, false otherwise.
+     */
+    bool begin();
+
+    /**
+     * Scans the inputs at a fixed rate. This function runs an infinite loop and should be called from a
+     * dedicated task.
+     * @param periodMs Scan period in milliseconds.
+     */
+    void scanLoop(uint16_t periodMs);
+
+    /**
+     * Gets the debounced state of an input.
+     * @param input Input id returned by addInput.
+     * @return true if the input is pressed, false otherwise.
+     */
+    bool isPressed(uint8_t input) const {
+        return input < MAX_INPUTS && (snapshot.load(std::memory_order_acquire) & (1u << input)) != 0;
+    }
+
+    /**
+     * Gets the state of an input at the last scan, before debouncing.
+     * @param input Input id returned by addInput.
+     * @return true if the input read pressed, false otherwise.
+     */
+    bool isRawPressed(uint8_t input) const {
+        return input < MAX_INPUTS && (snapshot.load(std::memory_order_acquire) & (1u << (input + RAW_SHIFT))) != 0;
+    }
+
+    /**
+     * Takes the next input event.
+     * @param event Where to store the event.
+     * @param timeout Maximum time to wait for an event in ticks.
+     * @return true if an event was taken, false on timeout.
+     */
+    bool popEvent(InputEvent& event, TickType_t timeout = 0);
+
+    /**
+     * Discards the queued events, e.g. when entering a screen that must not react to earlier clicks.
+     */
+    void clearEvents();
+
+    InputScannerStats getStats() const;
+    void resetStats();
+
+private:
+    static constexpr uint8_t RAW_SHIFT = 8;
+    static constexpr uint8_t EVENT_QUEUE_LENGTH = 16;
+    static constexpr uint8_t PBHUB_CHANNELS = 8;
+
+    struct Input {
+        uint8_t channel;
+        uint8_t index;
+        bool activeLow;
+        Button button;
+        int64_t rawChangeUs;    // First scan that saw the pending raw change, 0 if none
+        bool lastRaw;
+    };
+
+    M5UnitPbHub& hub;
+    Input inputs[MAX_INPUTS];
+    uint8_t inputCount = 0;
+    std::atomic<uint16_t> snapshot{0};
+    QueueHandle_t eventQueue = nullptr;
+
+    mutable portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+    uint32_t scans = 0;
+    uint32_t failedScans = 0;
+    uint32_t maxScanUs = 0;
+    uint32_t maxScanPeriodMs = 0;
+    uint32_t events = 0;
+    uint32_t droppedEvents = 0;
+    uint32_t edgeCount = 0;
+    uint64_t totalEdgeLatencyUs = 0;
+    uint32_t maxEdgeLatencyUs = 0;
+    uint32_t deliveredEvents = 0;
+    uint64_t totalDeliveryUs = 0;
+    uint32_t maxDeliveryUs = 0;
+    uint32_t lastScanMs = 0;
+
+    void scan();
+    void publish(uint8_t input, InputEvent::Type type, uint8_t clickCount, int64_t scanUs);
+};
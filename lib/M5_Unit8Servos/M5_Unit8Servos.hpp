@@ -33,7 +33,7 @@ typedef enum { _8bit = 0, _12bit } extio_anolog_read_mode_t;
 
 class M5_Unit8Servos : public I2CDevice {
 public:
-    M5_Unit8Servos(TwoWire &wire, uint8_t addr = M5_UNIT_8SERVO_DEFAULT_ADDR) : I2CDevice(wire, addr) {}
+    M5_Unit8Servos(I2CBus &bus, uint8_t addr = M5_UNIT_8SERVO_DEFAULT_ADDR) : I2CDevice(bus, addr) {}
 
     /**
      * Set the I2C address of the M5 Unit 8 Servos. This allows you to change the default 
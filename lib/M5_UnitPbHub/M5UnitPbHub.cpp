@@ -15,6 +15,24 @@ bool M5UnitPbHub::digitalRead(uint8_t channel, uint8_t index)
     return readByte(reg, &value) && (value != 0);
 }
 
+bool M5UnitPbHub::digitalReadChannel(uint8_t channel, uint8_t pins, uint8_t& values)
+{
+    PB_HUB_VALIDATE_AND_FIX_CHANNEL(channel)
+    values = 0;
+    for (uint8_t index = 0; index < 2; index++) {
+        if ((pins & (1 << index)) == 0) {
+            continue;
+        }
+        uint8_t reg = ((channel + 4) << 4) | (0x04 + index);
+        uint8_t value;
+        if (!readByte(reg, &value)) {
+            return false;
+        }
+        values |= (value != 0 ? 1 : 0) << index;
+    }
+    return true;
+}
+
 uint16_t M5UnitPbHub::analogRead(uint8_t channel)
 {
     PB_HUB_VALIDATE_AND_FIX_CHANNEL(channel)
@@ -58,7 +76,7 @@ bool M5UnitPbHub::setLEDNum(uint8_t channel, uint16_t count)
     uint8_t data[2];
     data[0] = count & 0xff;
     data[1] = count >> 8;
-    return writeBytes(reg, data, 2);
+    return postBytes(reg, data, 2, I2CPriority::BACKGROUND);
 }
 
 bool M5UnitPbHub::setLEDColor(uint8_t channel, uint8_t index, uint32_t rgb888)
@@ -71,7 +89,7 @@ bool M5UnitPbHub::setLEDColor(uint8_t channel, uint8_t index, uint32_t rgb888)
     data[2] = (rgb888 >> 16) & 0xff;
     data[3] = (rgb888 >> 8) & 0xff;
     data[4] = rgb888 & 0xff;
-    return writeBytes(reg, data, 5);
+    return postBytes(reg, data, 5, I2CPriority::BACKGROUND);
 }
 
 bool M5UnitPbHub::fillLEDColor(uint8_t channel, uint8_t start, uint8_t count, uint32_t rgb888)
@@ -86,19 +104,19 @@ bool M5UnitPbHub::fillLEDColor(uint8_t channel, uint8_t start, uint8_t count, ui
     data[4] = (rgb888 >> 16) & 0xff;
     data[5] = (rgb888 >> 8) & 0xff;
     data[6] = rgb888 & 0xff;
-    return writeBytes(reg, data, 7);
+    return postBytes(reg, data, 7, I2CPriority::BACKGROUND);
 }
 
 bool M5UnitPbHub::setLEDBrightness(uint8_t channel, uint8_t value)
 {
     PB_HUB_VALIDATE_AND_FIX_CHANNEL(channel)
     uint8_t reg = ((channel + 4) << 4) | (0x0B);
-    return writeByte(reg, value);
+    return postByte(reg, value, I2CPriority::BACKGROUND);
 }
 
 bool M5UnitPbHub::setLEDShowMode(uint8_t mode)
 {
-    return writeByte(0xFA, mode);
+    return postByte(0xFA, mode, I2CPriority::BACKGROUND);
 }
 
 uint8_t M5UnitPbHub::getLEDShowMode(void)
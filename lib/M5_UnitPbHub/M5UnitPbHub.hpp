@@ -17,7 +17,8 @@
 class M5UnitPbHub : public I2CDevice
 {
 public:
-    M5UnitPbHub(TwoWire &wire, uint8_t addr = UNIT_PBHUB_I2C_ADDR) : I2CDevice(wire, addr) {}
+    // Button reads are user inputs; the LED writes are queued with background priority
+    M5UnitPbHub(I2CBus &bus, uint8_t addr = UNIT_PBHUB_I2C_ADDR) : I2CDevice(bus, addr, I2CPriority::NORMAL, false) {}
 
     // -- SECTION IO
 
@@ -38,6 +39,17 @@ public:
      */
     bool digitalRead(uint8_t channel, uint8_t index);
 
+    /**
+     * Read digital input pins of a channel, reporting failed reads apart from LOW levels. Each pin is read with
+     * its own single-byte transaction: the registers of the hub are commands, a longer read does not continue
+     * with the register of the next pin.
+     * @param channel The channel number (0-7) to read from.
+     * @param pins The pins to read: bit 0 for index 0, bit 1 for index 1.
+     * @param values Where to store the pin states: bit 0 for index 0, bit 1 for index 1 (set if HIGH).
+     * @return true if every read operation was successful, false otherwise.
+     */
+    bool digitalReadChannel(uint8_t channel, uint8_t pins, uint8_t& values);
+
     /**
      * Read the value from an analog input pin on the specified channel and index.
      * @param channel The channel number (0-7) to read from.
@@ -79,7 +91,7 @@ public:
      * Set the number of RGB LEDs for a specified channel. Default is 74.
      * @param channel The channel number (0-7) to configure.
      * @param count The number of RGB LEDs to set for the channel.
-     * @return true if the write operation was successful, false otherwise.
+     * @return true if the write was queued, false otherwise. The write is sent without waiting for it.
      */
     bool setLEDNum(uint8_t channel, uint16_t count);  // default 74
 
@@ -88,7 +100,7 @@ public:
      * @param channel The channel number (0-7) to write to.
      * @param index The index of the LED within the channel (0-1).
      * @param rgb888 The RGB color value in 0xRRGGBB format to set the LED to.
-     * @return true if the write operation was successful, false otherwise.
+     * @return true if the write was queued, false otherwise. The write is sent without waiting for it.
      */
     bool setLEDColor(uint8_t channel, uint8_t index, uint32_t rgb888);
 
@@ -98,7 +110,7 @@ public:
      * @param start The starting index of the LED range to fill.
      * @param count The number of LEDs to fill starting from the index.
      * @param rgb888 The RGB color value in 0xRRGGBB format
-     * @return true if the write operation was successful, false otherwise.
+     * @return true if the write was queued, false otherwise. The write is sent without waiting for it.
      */
     bool fillLEDColor(uint8_t channel, uint8_t start, uint8_t count, uint32_t rgb888);
 
@@ -107,7 +119,7 @@ public:
      * It's effective on the new LEDs write
      * @param channel The channel number (0-7) to configure.
      * @param value The brightness value to set (0-255).
-     * @return true if the write operation was successful, false otherwise.
+     * @return true if the write was queued, false otherwise. The write is sent without waiting for it.
      */
     bool setLEDBrightness(uint8_t channel, uint8_t value);
 
@@ -128,7 +140,7 @@ public:
      *     0 for WS2812, WS2815, WS2816, SK6812
      *     1 for SK6822, APA106, PL9823
      * @param mode The LED show mode value to set (0 or 1).
-     * @return true if the write operation was successful, false otherwise.
+     * @return true if the write was queued, false otherwise. The write is sent without waiting for it.
      */
     bool setLEDShowMode(uint8_t mode);
 
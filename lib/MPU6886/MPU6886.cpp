@@ -14,6 +14,23 @@
 #define MPU6886_ACCEL_XOUT_H    0x3B
 #define MPU6886_GYRO_XOUT_H     0x43
 #define MPU6886_TEMP_OUT_H      0x41
+#define MPU6886_INT_PIN_CFG     0x37
+#define MPU6886_INT_ENABLE      0x38
+#define MPU6886_INT_STATUS      0x3A
+#define MPU6886_FIFO_COUNTH     0x72
+#define MPU6886_FIFO_R_W        0x74
+
+// Register bits
+#define CONFIG_FIFO_MODE_STOP   0x40    // Stop writing to a full FIFO instead of overwriting (keeps packets aligned)
+#define CONFIG_DLPF_41HZ        0x03
+#define FIFO_EN_GYRO_ACCEL      0x18    // GYRO_FIFO_EN | ACCEL_FIFO_EN
+#define USER_CTRL_FIFO_EN       0x40
+#define USER_CTRL_FIFO_RST      0x04
+#define INT_DATA_RDY            0x01
+#define INT_FIFO_OFLOW          0x10
+
+// Largest FIFO burst that fits in the Wire buffer, in whole packets
+#define FIFO_BURST_PACKETS      9
 
 // Default scale factors
 #define GYRO_SCALE  (1.0f / 131.0f)    // ±250°/s range
@@ -208,3 +225,245 @@ void MPU6886::getTemp(float *t) {
     
     *t = TEMP_OFFSET + ((float)temp_raw / TEMP_SCALE);
 }
+
+/**
+ * Start the FIFO streaming mode: accelerometer, temperature and gyroscope samples are stored by the sensor
+ * in its FIFO at the given sample rate and drained with burst reads by readFifo().
+ * @param sampleRateDivider Sample rate divider, the sample rate is 1kHz / (1 + divider).
+ * @param interruptPin GPIO connected to the sensor INT pin to wait for data-ready interrupts, or -1 to poll.
+ *                     The interrupts notify the calling task, so waitForData() must be called from it.
+ * @return true if the FIFO was configured, false otherwise.
+ */
+bool MPU6886::beginFifo(uint8_t sampleRateDivider, int8_t interruptPin) {
+    endFifo();
+
+    if (!setSampleRateDivider(sampleRateDivider)) {
+        return false;
+    }
+    samplePeriodUs = 1000UL * (1 + sampleRateDivider);
+
+    // Keep the 41Hz DLPF and stop the FIFO when full, so an overflow never leaves a partial packet at its head
+    if (!writeByte(MPU6886_CONFIG, CONFIG_FIFO_MODE_STOP | CONFIG_DLPF_41HZ)) {
+        return false;
+    }
+
+    fifoInterruptPin = interruptPin;
+    if (fifoInterruptPin >= 0) {
+        // INT active high, push-pull, 50us pulse on each new sample
+        dataReadyTask = xTaskGetCurrentTaskHandle();
+        writeByte(MPU6886_INT_PIN_CFG, 0x00);
+        writeByte(MPU6886_INT_ENABLE, INT_DATA_RDY | INT_FIFO_OFLOW);
+        pinMode(fifoInterruptPin, INPUT);
+        attachInterruptArg(digitalPinToInterrupt(fifoInterruptPin), onDataReady, this, RISING);
+    } else {
+        writeByte(MPU6886_INT_ENABLE, INT_FIFO_OFLOW);
+    }
+
+    if (!writeByte(MPU6886_FIFO_EN, FIFO_EN_GYRO_ACCEL)) {
+        return false;
+    }
+    fifoEnabled = true;
+    return resetFifo();
+}
+
+/**
+ * Stop the FIFO streaming mode and detach the data-ready interrupt.
+ */
+void MPU6886::endFifo() {
+    if (fifoInterruptPin >= 0) {
+        detachInterrupt(digitalPinToInterrupt(fifoInterruptPin));
+        fifoInterruptPin = -1;
+    }
+    writeByte(MPU6886_INT_ENABLE, 0x00);
+    writeByte(MPU6886_USER_CTRL, 0x00);
+    writeByte(MPU6886_FIFO_EN, 0x00);
+    writeByte(MPU6886_CONFIG, CONFIG_DLPF_41HZ);
+    fifoEnabled = false;
+    dataReadyTask = nullptr;
+
+    portENTER_CRITICAL(&sampleRingMux);
+    sampleRingHead = 0;
+    sampleRingCount = 0;
+    portEXIT_CRITICAL(&sampleRingMux);
+}
+
+/**
+ * Discard the FIFO content and the buffered samples, e.g. after the samples were not read for a while.
+ * @return true if the FIFO was reset, false otherwise.
+ */
+bool MPU6886::resetFifo() {
+    if (!fifoEnabled) {
+        return false;
+    }
+
+    portENTER_CRITICAL(&sampleRingMux);
+    sampleRingHead = 0;
+    sampleRingCount = 0;
+    portEXIT_CRITICAL(&sampleRingMux);
+
+    uint8_t status;
+    readByte(MPU6886_INT_STATUS, &status);  // Clear a pending overflow
+    return writeByte(MPU6886_USER_CTRL, USER_CTRL_FIFO_EN | USER_CTRL_FIFO_RST);
+}
+
+/**
+ * Wait for new samples. With the interrupt pin configured, waits for the data-ready interrupt, otherwise waits
+ * one sample period.
+ * @param timeoutMs Maximum time to wait in milliseconds.
+ * @return true if new data is expected to be available, false on timeout.
+ */
+bool MPU6886::waitForData(uint32_t timeoutMs) {
+    if (fifoInterruptPin >= 0) {
+        return ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeoutMs)) > 0;
+    }
+    delay(min<uint32_t>(timeoutMs, max<uint32_t>(1, samplePeriodUs / 1000)));
+    return true;
+}
+
+void IRAM_ATTR MPU6886::onDataReady(void* arg) {
+    MPU6886* imu = static_cast<MPU6886*>(arg);
+    imu->lastDataReadyUs = micros();
+
+    BaseType_t higherPriorityTaskWoken = pdFALSE;
+    if (imu->dataReadyTask != nullptr) {
+        vTaskNotifyGiveFromISR(imu->dataReadyTask, &higherPriorityTaskWoken);
+    }
+    portYIELD_FROM_ISR(higherPriorityTaskWoken);
+}
+
+/**
+ * Drain the FIFO with burst reads into the sample ring buffer. The samples are timestamped backwards from the
+ * last data-ready interrupt (or from the read time when polling) at the sample period.
+ * @return The number of samples read.
+ */
+uint16_t MPU6886::readFifo() {
+    if (!fifoEnabled) {
+        return 0;
+    }
+
+    uint8_t status;
+    if (readByte(MPU6886_INT_STATUS, &status) && (status & INT_FIFO_OFLOW)) {
+        // Samples were lost: restart from an empty FIFO so the packets stay aligned
+        portENTER_CRITICAL(&sampleRingMux);
+        fifoStats.overflows++;
+        portEXIT_CRITICAL(&sampleRingMux);
+        writeByte(MPU6886_USER_CTRL, USER_CTRL_FIFO_EN | USER_CTRL_FIFO_RST);
+        return 0;
+    }
+
+    uint8_t countBuf[2];
+    if (!readBytes(MPU6886_FIFO_COUNTH, countBuf, 2)) {
+        return 0;
+    }
+    uint32_t newestUs = fifoInterruptPin >= 0 ? lastDataReadyUs : micros();
+    uint16_t fifoCount = ((countBuf[0] & 0x1F) << 8) | countBuf[1];
+    uint16_t packets = fifoCount / FIFO_PACKET_SIZE;
+
+    uint8_t buf[FIFO_BURST_PACKETS * FIFO_PACKET_SIZE];
+    uint16_t read = 0;
+    while (read < packets) {
+        uint8_t burstPackets = min<uint16_t>(packets - read, FIFO_BURST_PACKETS);
+        if (!readStream(MPU6886_FIFO_R_W, buf, burstPackets * FIFO_PACKET_SIZE)) {
+            break;
+        }
+
+        for (uint8_t i = 0; i < burstPackets; i++) {
+            MPU6886Sample sample;
+            decodeFifoPacket(&buf[i * FIFO_PACKET_SIZE], sample);
+            sample.timestampUs = newestUs - (packets - 1 - (read + i)) * samplePeriodUs;
+            pushSample(sample);
+        }
+        read += burstPackets;
+
+        portENTER_CRITICAL(&sampleRingMux);
+        fifoStats.burstReads++;
+        fifoStats.samples += burstPackets;
+        portEXIT_CRITICAL(&sampleRingMux);
+    }
+
+    return read;
+}
+
+void MPU6886::pushSample(const MPU6886Sample& sample) {
+    portENTER_CRITICAL(&sampleRingMux);
+    if (sampleRingCount == SAMPLE_RING_SIZE) {
+        // Drop the oldest sample
+        sampleRingHead = (sampleRingHead + 1) % SAMPLE_RING_SIZE;
+        sampleRingCount--;
+        fifoStats.ringOverruns++;
+    }
+    sampleRing[(sampleRingHead + sampleRingCount) % SAMPLE_RING_SIZE] = sample;
+    sampleRingCount++;
+    portEXIT_CRITICAL(&sampleRingMux);
+}
+
+/**
+ * Get the oldest sample read from the FIFO.
+ * @param sample Where to store the sample.
+ * @return true if a sample was available, false otherwise.
+ */
+bool MPU6886::popSample(MPU6886Sample& sample) {
+    bool available = false;
+    portENTER_CRITICAL(&sampleRingMux);
+    if (sampleRingCount > 0) {
+        sample = sampleRing[sampleRingHead];
+        sampleRingHead = (sampleRingHead + 1) % SAMPLE_RING_SIZE;
+        sampleRingCount--;
+        available = true;
+    }
+    portEXIT_CRITICAL(&sampleRingMux);
+    return available;
+}
+
+/**
+ * Get the number of samples read from the FIFO and not yet popped.
+ * @return The number of buffered samples.
+ */
+uint16_t MPU6886::availableSamples() {
+    portENTER_CRITICAL(&sampleRingMux);
+    uint16_t count = sampleRingCount;
+    portEXIT_CRITICAL(&sampleRingMux);
+    return count;
+}
+
+/**
+ * Get the FIFO streaming counters.
+ * @return A snapshot of the counters.
+ */
+MPU6886FifoStats MPU6886::getFifoStats() {
+    portENTER_CRITICAL(&sampleRingMux);
+    MPU6886FifoStats snapshot = fifoStats;
+    portEXIT_CRITICAL(&sampleRingMux);
+    return snapshot;
+}
+
+/**
+ * Convert a raw acceleration to g with the current accelerometer scale.
+ * @param raw Raw acceleration.
+ * @return Acceleration in g.
+ */
+float MPU6886::accelToG(int16_t raw) const {
+    return (float)raw * accelScaleFactor;
+}
+
+/**
+ * Convert a raw angular rate to degrees per second.
+ * @param raw Raw angular rate.
+ * @return Angular rate in °/s.
+ */
+float MPU6886::gyroToDps(int16_t raw) const {
+    return (float)raw * GYRO_SCALE;
+}
+
+/**
+ * Decode a FIFO packet: big-endian accelerometer X, Y, Z, temperature and gyroscope X, Y, Z.
+ * @param packet Pointer to the FIFO_PACKET_SIZE bytes of the packet.
+ * @param sample Where to store the raw values. The timestamp is not modified.
+ */
+void MPU6886::decodeFifoPacket(const uint8_t* packet, MPU6886Sample& sample) {
+    for (uint8_t i = 0; i < 3; i++) {
+        sample.accel[i] = (int16_t)((packet[2 * i] << 8) | packet[2 * i + 1]);
+        sample.gyro[i] = (int16_t)((packet[8 + 2 * i] << 8) | packet[8 + 2 * i + 1]);
+    }
+    sample.temp = (int16_t)((packet[6] << 8) | packet[7]);
+}
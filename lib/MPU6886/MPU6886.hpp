@@ -2,6 +2,26 @@
 
 #include <I2CDevice.hpp>
 
+/**
+ * Raw accelerometer, temperature and gyroscope sample read from the MPU6886 FIFO
+ */
+struct MPU6886Sample {
+    uint32_t timestampUs;   ///< Estimated sampling time (micros())
+    int16_t accel[3];       ///< Raw X, Y, Z acceleration
+    int16_t temp;           ///< Raw temperature
+    int16_t gyro[3];        ///< Raw X, Y, Z angular rate
+};
+
+/**
+ * Counters of the MPU6886 FIFO streaming mode
+ */
+struct MPU6886FifoStats {
+    uint32_t samples;       ///< Samples read from the FIFO
+    uint32_t burstReads;    ///< I2C burst reads of the FIFO data
+    uint32_t overflows;     ///< FIFO overflows (samples lost, FIFO reset)
+    uint32_t ringOverruns;  ///< Samples dropped because the ring buffer was full
+};
+
 class MPU6886 : public I2CDevice {
 public:
     enum class AccelScale : uint8_t {
@@ -21,7 +41,7 @@ public:
         BW_5HZ = 0x06
     };
 
-    MPU6886(TwoWire &wire, uint8_t address = 0x68) : I2CDevice(wire, address) 
+    MPU6886(I2CBus &bus, uint8_t address = 0x68) : I2CDevice(bus, address, I2CPriority::CRITICAL, true) 
     {        
     };
     
@@ -38,10 +58,41 @@ public:
     void getGyro(float* gx, float* gy, float* gz);
     void getTemp(float *t);
 
+    // FIFO streaming mode
+    static constexpr uint8_t FIFO_PACKET_SIZE = 14;
+    static constexpr uint8_t SAMPLE_RING_SIZE = 64;
+
+    bool beginFifo(uint8_t sampleRateDivider, int8_t interruptPin = -1);
+    void endFifo();
+    bool resetFifo();
+    bool waitForData(uint32_t timeoutMs);
+    uint16_t readFifo();
+    bool popSample(MPU6886Sample& sample);
+    uint16_t availableSamples();
+    MPU6886FifoStats getFifoStats();
+    float accelToG(int16_t raw) const;
+    float gyroToDps(int16_t raw) const;
+    static void decodeFifoPacket(const uint8_t* packet, MPU6886Sample& sample);
+
 private:
     float accelScaleFactor = 1.0f / 16384.0f;
     AccelScale currentAccelScale = AccelScale::RANGE_2G;
     AccelFilter currentAccelFilter = AccelFilter::BW_10HZ;
     uint8_t currentSampleRateDivider = 19;
 
+    // FIFO streaming mode
+    bool fifoEnabled = false;
+    int8_t fifoInterruptPin = -1;
+    uint32_t samplePeriodUs = 0;
+    TaskHandle_t dataReadyTask = nullptr;
+    volatile uint32_t lastDataReadyUs = 0;
+    MPU6886Sample sampleRing[SAMPLE_RING_SIZE];
+    uint8_t sampleRingHead = 0;
+    uint8_t sampleRingCount = 0;
+    MPU6886FifoStats fifoStats = {};
+    portMUX_TYPE sampleRingMux = portMUX_INITIALIZER_UNLOCKED;
+
+    static void IRAM_ATTR onDataReady(void* arg);
+    void pushSample(const MPU6886Sample& sample);
+
 };
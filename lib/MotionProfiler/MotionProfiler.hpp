@@ -0,0 +1,298 @@
+#pragma once
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * @brief Jerk-limited (S-curve) motion profiler with fixed-point state.
+ *
+ * This class moves a value from its current state to a target state limiting its velocity, acceleration
+ * and jerk, so the value starts and stops smoothly instead of with the velocity steps of a SlewRateLimiter.
+ * Position, velocity and acceleration are kept in fixed-point with FracBits fractional bits and accumulate
+ * their fractional part, so small steps (low rates or short update periods) are never rounded away.
+ *
+ * The target can be changed at any time: the profile is re-planned from the current position, velocity and
+ * acceleration, braking as late as the limits allow so the value settles without overshoot.
+ *
+ * The limits trade the speed of short moves for the overshoot of long ones. A servo follows a step of its pulse
+ * width faster than any ramp, so short moves settle later than with a SlewRateLimiter, which steps them (20 us:
+ * 68 ms instead of 44 ms with the game limits, see tools/motion_profile_sim), while long moves settle sooner
+ * and with a fraction of the overshoot, the servo no longer braking harder than it can.
+ *
+ * With the default 12 fractional bits the internal 64-bit math supports values up to +-100000 and
+ * accelerations up to 500000 units/s^2.
+ *
+ * @tparam T Integer output type (e.g. int16_t for servo pulse widths)
+ * @tparam FracBits Number of fractional bits of the internal fixed-point state
+ *
+ * Example usage:
+ * @code
+ * MotionProfiler<int16_t> pulseProfiler(1500, 4000, 40000, 800000);  // Initial: 1500us, 4000us/s, 40000us/s^2, 800000us/s^3
+ * pulseProfiler.setTarget(2000);
+ *
+ * while (!pulseProfiler.isAtTarget()) {
+ *     pulseProfiler.update(4);  // 4ms delta time
+ *     servo.writeMicroseconds(pulseProfiler.getCurrentValue());
+ * }
+ * @endcode
+ */
+template <typename T, uint8_t FracBits = 12>
+class MotionProfiler {
+private:
+    static constexpr int64_t ONE = static_cast<int64_t>(1) << FracBits;
+    static constexpr uint8_t BRAKE_SEARCH_ITERATIONS = 16;
+
+    int64_t position = 0;       ///< Current position (fixed-point)
+    int64_t velocity = 0;       ///< Current velocity in units/s (fixed-point)
+    int64_t acceleration = 0;   ///< Current acceleration in units/s^2 (fixed-point)
+    int64_t target = 0;         ///< Target position (fixed-point)
+
+    int64_t maxVelocity = ONE;      ///< Maximum velocity in units/s (fixed-point)
+    int64_t maxAcceleration = ONE;  ///< Maximum acceleration in units/s^2 (fixed-point)
+    int64_t maxJerk = ONE;          ///< Maximum jerk in units/s^3 (fixed-point)
+    int64_t jerkVelocity = ONE;     ///< Velocity change while ramping the acceleration from 0 to max and back (A^2/J)
+
+    static int64_t toFixed(int64_t value) {
+        return value * ONE;
+    }
+
+    static uint64_t isqrt(uint64_t value) {
+        uint64_t result = 0;
+        uint64_t bit = static_cast<uint64_t>(1) << 62;
+        while (bit > value) {
+            bit >>= 2;
+        }
+        while (bit != 0) {
+            if (value >= result + bit) {
+                value -= result + bit;
+                result = (result >> 1) + bit;
+            } else {
+                result >>= 1;
+            }
+            bit >>= 2;
+        }
+        return result;
+    }
+
+    /**
+     * Distance needed to stop from velocity v >= 0 starting with zero acceleration
+     */
+    int64_t stoppingDistance(int64_t v) const {
+        if (v >= jerkVelocity) {
+            // Acceleration ramps to the limit, holds and ramps back: v^2/(2A) + v*A/(2J)
+            return v * (v + jerkVelocity) / (2 * maxAcceleration);
+        }
+        // Acceleration limit not reached: triangular acceleration profile lasting 2*sqrt(v/J)
+        int64_t halfTime = static_cast<int64_t>(isqrt(static_cast<uint64_t>(v * ONE * ONE / maxJerk)));
+        return v * halfTime / ONE;
+    }
+
+    /**
+     * Check whether the target at the given distance is overshot when braking from velocity v and acceleration a
+     */
+    bool overshoots(int64_t distance, int64_t v, int64_t a) const {
+        // Predict the state once the current acceleration has been ramped back to zero
+        int64_t rampTime = llabs(a) * ONE / maxJerk;
+        int64_t rampVelocity = v + a * rampTime / (2 * ONE);
+        int64_t rampDistance = v * rampTime / ONE + (a * rampTime / ONE) * rampTime / (3 * ONE);
+        return rampVelocity > 0 && rampDistance + stoppingDistance(rampVelocity) > distance;
+    }
+
+    /**
+     * Check whether the target is overshot when braking after one step with the given acceleration change
+     */
+    bool overshootsAfterStep(int64_t distance, int64_t v, int64_t a, int64_t accelerationChange,
+                             uint32_t deltaTimeMs) const {
+        int64_t nextA = clamp(a + accelerationChange, maxAcceleration);
+        int64_t nextV = v + nextA * static_cast<int64_t>(deltaTimeMs) / 1000;
+        return overshoots(distance - nextV * static_cast<int64_t>(deltaTimeMs) / 1000, nextV, nextA);
+    }
+
+    /**
+     * Acceleration to apply for a step that brings the velocity to the target velocity without overshooting it.
+     * Applying a for a step then ramping it back to zero in n = floor(a/(J*dt)) steps of the jerk limit changes the
+     * velocity by dt*((n+1)*a - J*dt*n*(n+1)/2): the largest a within the velocity change dv is found by solving for
+     * n first, the velocity change at a = n*J*dt being J*dt^2*n*(n+1)/2.
+     */
+    int64_t velocityAcceleration(int64_t currentVelocity, int64_t targetVelocity, uint32_t deltaTimeMs) const {
+        int64_t deltaVelocity = targetVelocity - currentVelocity;
+        int64_t magnitude = llabs(deltaVelocity);
+        int64_t dt = static_cast<int64_t>(deltaTimeMs);
+        int64_t steps = (static_cast<int64_t>(isqrt(static_cast<uint64_t>(
+            1 + 8 * magnitude * 1000000 / (maxJerk * dt * dt)))) - 1) / 2;
+        magnitude = (magnitude * 1000 / dt + maxJerk * dt * steps * (steps + 1) / 2000) / (steps + 1);
+        magnitude = magnitude < maxAcceleration ? magnitude : maxAcceleration;
+        return deltaVelocity >= 0 ? magnitude : -magnitude;
+    }
+
+    static int64_t clamp(int64_t value, int64_t limit) {
+        return value > limit ? limit : (value < -limit ? -limit : value);
+    }
+
+public:
+    /**
+     * @brief Constructor
+     * @param initialValue Starting value (default: 0)
+     * @param maxVelocityPerSecond Maximum velocity in units per second
+     * @param maxAccelerationPerSecond2 Maximum acceleration in units per second^2
+     * @param maxJerkPerSecond3 Maximum jerk in units per second^3
+     */
+    MotionProfiler(T initialValue = 0, uint32_t maxVelocityPerSecond = 1, uint32_t maxAccelerationPerSecond2 = 1,
+                   uint32_t maxJerkPerSecond3 = 1)
+    {
+        reset(initialValue);
+        setLimits(maxVelocityPerSecond, maxAccelerationPerSecond2, maxJerkPerSecond3);
+    }
+
+    /**
+     * @brief Set the target value to move towards
+     * @param targetValue The desired target value
+     */
+    void setTarget(T targetValue) {
+        target = toFixed(targetValue);
+    }
+
+    /**
+     * @brief Advance the profile by the elapsed time
+     *
+     * Call this regularly (e.g., in a loop or timer) with the time delta since last update. A constant delta
+     * gives the smoothest motion.
+     *
+     * @param deltaTimeMs Time elapsed since last update in milliseconds
+     */
+    void update(uint32_t deltaTimeMs) {
+        if (deltaTimeMs == 0 || isAtTarget()) {
+            return;
+        }
+
+        // Work in the frame where the target is ahead, so the decision is the same in both directions
+        int64_t error = target - position;
+        int64_t direction = error >= 0 ? 1 : -1;
+        int64_t distance = error * direction;
+        int64_t v = velocity * direction;
+        int64_t a = acceleration * direction;
+
+        // Keep accelerating towards (or holding) the maximum velocity if the target can still be reached without
+        // overshoot after this step, otherwise brake as gently as possible while still stopping on the target
+        int64_t maxAccelerationChange = maxJerk * deltaTimeMs / 1000;
+        int64_t accelerationChange = clamp(velocityAcceleration(v, maxVelocity, deltaTimeMs) - a,
+            maxAccelerationChange);
+        if (overshootsAfterStep(distance, v, a, accelerationChange, deltaTimeMs)) {
+            int64_t low = -maxAccelerationChange;
+            int64_t high = accelerationChange;
+            for (uint8_t i = 0; i < BRAKE_SEARCH_ITERATIONS && high - low > 1; i++) {
+                int64_t middle = low + (high - low) / 2;
+                if (overshootsAfterStep(distance, v, a, middle, deltaTimeMs)) {
+                    high = middle;
+                } else {
+                    low = middle;
+                }
+            }
+            accelerationChange = low;
+        }
+
+        // Integrate with the jerk and acceleration limits
+        a = clamp(a + accelerationChange, maxAcceleration);
+        acceleration = a * direction;
+        velocity += acceleration * static_cast<int64_t>(deltaTimeMs) / 1000;
+        position += velocity * static_cast<int64_t>(deltaTimeMs) / 1000;
+
+        // Settle on the target once the remaining error is below half a unit and the motion is below a unit per step
+        error = target - position;
+        if (llabs(error) < ONE / 2 && llabs(velocity) * deltaTimeMs / 1000 < ONE) {
+            position = target;
+            velocity = 0;
+            acceleration = 0;
+        }
+    }
+
+    /**
+     * @brief Get the current value rounded to the output type
+     * @return The current value
+     */
+    T getCurrentValue() const {
+        return static_cast<T>((position + ONE / 2) >> FracBits);
+    }
+
+    /**
+     * @brief Get the target value
+     * @return The target value
+     */
+    T getTargetValue() const {
+        return static_cast<T>(target >> FracBits);
+    }
+
+    /**
+     * @brief Get the current velocity
+     * @return Velocity in units per second
+     */
+    float getVelocity() const {
+        return static_cast<float>(velocity) / ONE;
+    }
+
+    /**
+     * @brief Get the current acceleration
+     * @return Acceleration in units per second^2
+     */
+    float getAcceleration() const {
+        return static_cast<float>(acceleration) / ONE;
+    }
+
+    /**
+     * @brief Check if the value has settled on the target
+     * @return true if the current value equals target and the motion is stopped, false otherwise
+     */
+    bool isAtTarget() const {
+        return position == target && velocity == 0 && acceleration == 0;
+    }
+
+    /**
+     * @brief Set the motion limits
+     * @param maxVelocityPerSecond Maximum velocity in units per second
+     * @param maxAccelerationPerSecond2 Maximum acceleration in units per second^2
+     * @param maxJerkPerSecond3 Maximum jerk in units per second^3
+     */
+    void setLimits(uint32_t maxVelocityPerSecond, uint32_t maxAccelerationPerSecond2, uint32_t maxJerkPerSecond3) {
+        maxAcceleration = toFixed(maxAccelerationPerSecond2 > 0 ? maxAccelerationPerSecond2 : 1);
+        maxJerk = toFixed(maxJerkPerSecond3 > 0 ? maxJerkPerSecond3 : 1);
+        jerkVelocity = maxAcceleration * maxAcceleration / maxJerk;
+        setMaxVelocity(maxVelocityPerSecond);
+    }
+
+    /**
+     * @brief Set the maximum velocity, keeping the acceleration and jerk limits
+     *
+     * Lowering the limit while moving faster brakes with the acceleration limits instead of with a velocity step.
+     *
+     * @param maxVelocityPerSecond Maximum velocity in units per second
+     */
+    void setMaxVelocity(uint32_t maxVelocityPerSecond) {
+        maxVelocity = toFixed(maxVelocityPerSecond > 0 ? maxVelocityPerSecond : 1);
+    }
+
+    /**
+     * @brief Get the maximum velocity
+     * @return Maximum velocity in units per second
+     */
+    uint32_t getMaxVelocity() const {
+        return static_cast<uint32_t>(maxVelocity >> FracBits);
+    }
+
+    /**
+     * @brief Reset to a new initial state at rest
+     * @param value The new current and target value
+     */
+    void reset(T value) {
+        position = toFixed(value);
+        target = position;
+        velocity = 0;
+        acceleration = 0;
+    }
+
+    /**
+     * @brief Get the distance to target
+     * @return Absolute difference between current and target value
+     */
+    T getDistanceToTarget() const {
+        return static_cast<T>(llabs(target - position) >> FracBits);
+    }
+};
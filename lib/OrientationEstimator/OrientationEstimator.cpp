@@ -0,0 +1,140 @@
+#include "OrientationEstimator.hpp"
+
+namespace {
+    constexpr float kDegToRad = M_PI / 180.0f;
+    constexpr float kRadToDeg = 180.0f / M_PI;
+    constexpr float kMaxDeltaS = 0.1f;              // Longer gaps are integrated as this, the correction does the rest
+    constexpr float kAccelTolerance = 0.2f;         // Accelerometer samples are used only within 1g +- this
+    constexpr float kMaxGyroBiasRadS = 10.0f * kDegToRad;   // Limit of the estimated gyroscope bias
+}
+
+OrientationEstimator::OrientationEstimator(float kp, float ki) : kp(kp), ki(ki) {
+}
+
+void OrientationEstimator::setGains(float kp, float ki) {
+    this->kp = kp;
+    this->ki = ki;
+}
+
+void OrientationEstimator::reset(bool keepGyroBias) {
+    initialized = false;
+    rejectedAccelSamples = 0;
+    if (!keepGyroBias) {
+        integralX = 0.0f;
+        integralY = 0.0f;
+        integralZ = 0.0f;
+    }
+}
+
+bool OrientationEstimator::initialize(float axG, float ayG, float azG, uint32_t timestampUs) {
+    float accelNorm = sqrtf(axG * axG + ayG * ayG + azG * azG);
+    if (accelNorm < 1.0f - kAccelTolerance || accelNorm > 1.0f + kAccelTolerance) {
+        rejectedAccelSamples++;
+        return false;
+    }
+    initializeFromAccel(axG, ayG, azG);
+    lastTimestampUs = timestampUs;
+    initialized = true;
+    return true;
+}
+
+void OrientationEstimator::initializeFromAccel(float ax, float ay, float az) {
+    float roll = atan2f(ay, az);
+    float pitch = atan2f(-ax, sqrtf(ay * ay + az * az));
+    float cr = cosf(roll * 0.5f);
+    float sr = sinf(roll * 0.5f);
+    float cp = cosf(pitch * 0.5f);
+    float sp = sinf(pitch * 0.5f);
+    q0 = cr * cp;
+    q1 = sr * cp;
+    q2 = cr * sp;
+    q3 = -sr * sp;
+}
+
+void OrientationEstimator::update(float gxDps, float gyDps, float gzDps, float axG, float ayG, float azG,
+                                  uint32_t timestampUs) {
+    float accelNorm = sqrtf(axG * axG + ayG * ayG + azG * azG);
+
+    if (!initialized) {
+        initialize(axG, ayG, azG, timestampUs);
+        return;
+    }
+
+    float dt = (timestampUs - lastTimestampUs) * 1e-6f;
+    lastTimestampUs = timestampUs;
+    if (dt <= 0.0f) {
+        return;
+    }
+    dt = min(dt, kMaxDeltaS);
+
+    float gx = gxDps * kDegToRad;
+    float gy = gyDps * kDegToRad;
+    float gz = gzDps * kDegToRad;
+
+    if (accelNorm >= 1.0f - kAccelTolerance && accelNorm <= 1.0f + kAccelTolerance) {
+        float ax = axG / accelNorm;
+        float ay = ayG / accelNorm;
+        float az = azG / accelNorm;
+
+        // Estimated direction of gravity and error with the measured one
+        float vx = 2.0f * (q1 * q3 - q0 * q2);
+        float vy = 2.0f * (q0 * q1 + q2 * q3);
+        float vz = q0 * q0 - q1 * q1 - q2 * q2 + q3 * q3;
+        float ex = ay * vz - az * vy;
+        float ey = az * vx - ax * vz;
+        float ez = ax * vy - ay * vx;
+
+        // Integral feedback estimates the gyroscope bias, proportional feedback corrects the drift
+        integralX = constrain(integralX + ki * ex * dt, -kMaxGyroBiasRadS, kMaxGyroBiasRadS);
+        integralY = constrain(integralY + ki * ey * dt, -kMaxGyroBiasRadS, kMaxGyroBiasRadS);
+        integralZ = constrain(integralZ + ki * ez * dt, -kMaxGyroBiasRadS, kMaxGyroBiasRadS);
+        gx += kp * ex;
+        gy += kp * ey;
+        gz += kp * ez;
+    } else {
+        rejectedAccelSamples++;
+    }
+    gx += integralX;
+    gy += integralY;
+    gz += integralZ;
+
+    // Integrate the quaternion rate of change
+    float halfDt = 0.5f * dt;
+    float qa = q0;
+    float qb = q1;
+    float qc = q2;
+    q0 += (-qb * gx - qc * gy - q3 * gz) * halfDt;
+    q1 += (qa * gx + qc * gz - q3 * gy) * halfDt;
+    q2 += (qa * gy - qb * gz + q3 * gx) * halfDt;
+    q3 += (qa * gz + qb * gy - qc * gx) * halfDt;
+
+    float norm = sqrtf(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+    q0 /= norm;
+    q1 /= norm;
+    q2 /= norm;
+    q3 /= norm;
+}
+
+void OrientationEstimator::getGravity(float& x, float& y, float& z) const {
+    x = 2.0f * (q1 * q3 - q0 * q2);
+    y = 2.0f * (q0 * q1 + q2 * q3);
+    z = q0 * q0 - q1 * q1 - q2 * q2 + q3 * q3;
+}
+
+float OrientationEstimator::getRollDeg() const {
+    float x, y, z;
+    getGravity(x, y, z);
+    return atan2f(y, z) * kRadToDeg;
+}
+
+float OrientationEstimator::getPitchDeg() const {
+    float x, y, z;
+    getGravity(x, y, z);
+    return asinf(constrain(-x, -1.0f, 1.0f)) * kRadToDeg;
+}
+
+void OrientationEstimator::getGyroBias(float& xDps, float& yDps, float& zDps) const {
+    xDps = -integralX * kRadToDeg;
+    yDps = -integralY * kRadToDeg;
+    zDps = -integralZ * kRadToDeg;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * OrientationEstimator fuses accelerometer and gyroscope samples into the table orientation with a Mahony
+ * complementary filter. The gyroscope is integrated for a fast, vibration free response, while the
+ * accelerometer slowly corrects the drift through a proportional term and estimates the gyroscope bias
+ * online through an integral term. Accelerometer samples far from 1g (shocks, servo vibration) are not used
+ * for the correction.
+ *
+ * Only the tilt (roll and pitch) is observable without a magnetometer; the yaw is not estimated.
+ */
+class OrientationEstimator {
+public:
+    /**
+     * Constructor for the OrientationEstimator class.
+     * @param kp Proportional gain of the accelerometer correction (1/s).
+     * @param ki Integral gain of the gyroscope bias estimation (1/s^2).
+     */
+    OrientationEstimator(float kp = 2.0f, float ki = 0.1f);
+
+    /**
+     * Sets the filter gains.
+     * @param kp Proportional gain of the accelerometer correction (1/s).
+     * @param ki Integral gain of the gyroscope bias estimation (1/s^2).
+     */
+    void setGains(float kp, float ki);
+
+    /**
+     * Forgets the orientation. The next update initializes it from the accelerometer alone.
+     * @param keepGyroBias true to keep the estimated gyroscope bias, false to reset it as well.
+     */
+    void reset(bool keepGyroBias = true);
+
+    /**
+     * Initializes the orientation from an accelerometer reading, e.g. averaged over a window at rest, instead of
+     * from the first sample fused by update.
+     * @param axG X acceleration in g.
+     * @param ayG Y acceleration in g.
+     * @param azG Z acceleration in g.
+     * @param timestampUs Time of the reading in microseconds (e.g. micros()).
+     * @return true if the orientation is initialized, false if the reading is too far from 1g.
+     */
+    bool initialize(float axG, float ayG, float azG, uint32_t timestampUs);
+
+    /**
+     * Fuses a new sample.
+     * @param gxDps X angular rate in degrees per second.
+     * @param gyDps Y angular rate in degrees per second.
+     * @param gzDps Z angular rate in degrees per second.
+     * @param axG X acceleration in g.
+     * @param ayG Y acceleration in g.
+     * @param azG Z acceleration in g.
+     * @param timestampUs Sampling time of the sample in microseconds (e.g. micros()).
+     */
+    void update(float gxDps, float gyDps, float gzDps, float axG, float ayG, float azG, uint32_t timestampUs);
+
+    /**
+     * Checks if the orientation has been initialized by at least one sample.
+     * @return true if the orientation is valid, false otherwise.
+     */
+    bool isInitialized() const {
+        return initialized;
+    }
+
+    /**
+     * Gets the estimated direction of gravity in the sensor frame, i.e. the filtered accelerometer
+     * reading at rest.
+     * @param x X component of the unit gravity vector.
+     * @param y Y component of the unit gravity vector.
+     * @param z Z component of the unit gravity vector.
+     */
+    void getGravity(float& x, float& y, float& z) const;
+
+    /**
+     * Gets the roll angle (rotation around the X axis).
+     * @return Roll angle in degrees.
+     */
+    float getRollDeg() const;
+
+    /**
+     * Gets the pitch angle (rotation around the Y axis).
+     * @return Pitch angle in degrees.
+     */
+    float getPitchDeg() const;
+
+    /**
+     * Gets the estimated gyroscope bias.
+     * @param xDps X bias in degrees per second.
+     * @param yDps Y bias in degrees per second.
+     * @param zDps Z bias in degrees per second.
+     */
+    void getGyroBias(float& xDps, float& yDps, float& zDps) const;
+
+    /**
+     * Gets the time of the last fused sample.
+     * @return Timestamp of the last sample in microseconds.
+     */
+    uint32_t getTimestampUs() const {
+        return lastTimestampUs;
+    }
+
+    /**
+     * Gets the number of accelerometer samples not used for the correction because too far from 1g.
+     * @return The number of rejected samples since the last reset.
+     */
+    uint32_t getRejectedAccelSamples() const {
+        return rejectedAccelSamples;
+    }
+
+private:
+    float kp;
+    float ki;
+
+    // Orientation quaternion (sensor frame to level frame)
+    float q0 = 1.0f;
+    float q1 = 0.0f;
+    float q2 = 0.0f;
+    float q3 = 0.0f;
+
+    // Integral of the correction, i.e. the opposite of the gyroscope bias (rad/s)
+    float integralX = 0.0f;
+    float integralY = 0.0f;
+    float integralZ = 0.0f;
+
+    bool initialized = false;
+    uint32_t lastTimestampUs = 0;
+    uint32_t rejectedAccelSamples = 0;
+
+    void initializeFromAccel(float ax, float ay, float az);
+};
@@ -0,0 +1,137 @@
+#pragma once
+#include <algorithm>
+
+/**
+ * @brief PID controller with anti-windup and filtered derivative.
+ *
+ * The derivative acts on the measurement instead of the error, so setpoint steps do not produce output kicks,
+ * and is low-pass filtered to limit the noise amplification. When the measurement is sampled slower than the
+ * controller runs, the derivative is computed over the measurement period and held between the samples. The output is clamped to a symmetric limit and
+ * the integral is back-calculated when the output saturates, so it does not wind up while the actuator is
+ * at its limit.
+ *
+ * Example usage:
+ * @code
+ * PidController pid(2.0f, 10.0f, 0.05f, 100.0f);  // Kp, Ki, Kd, output limit
+ * float output = pid.update(setpoint, measurement, 0.004f);  // 4ms time step
+ * @endcode
+ */
+class PidController {
+private:
+    float kp;
+    float ki;
+    float kd;
+    float outputLimit;
+    float derivativeTimeConstantS;
+
+    float integral = 0.0f;
+    float filteredDerivative = 0.0f;
+    float lastMeasurement = 0.0f;
+    bool hasLastMeasurement = false;
+
+public:
+    /**
+     * @brief Constructor
+     * @param kp Proportional gain
+     * @param ki Integral gain (output units per error unit per second)
+     * @param kd Derivative gain (output units per error unit per second of rate)
+     * @param outputLimit Maximum absolute value of the output
+     * @param derivativeTimeConstantS Time constant of the derivative low-pass filter in seconds
+     */
+    PidController(float kp = 0.0f, float ki = 0.0f, float kd = 0.0f, float outputLimit = 0.0f,
+                  float derivativeTimeConstantS = 0.02f)
+        : kp(kp), ki(ki), kd(kd), outputLimit(outputLimit), derivativeTimeConstantS(derivativeTimeConstantS) {
+    }
+
+    /**
+     * @brief Set the controller gains
+     * @param kp Proportional gain
+     * @param ki Integral gain
+     * @param kd Derivative gain
+     */
+    void setGains(float kp, float ki, float kd) {
+        this->kp = kp;
+        this->ki = ki;
+        this->kd = kd;
+    }
+
+    /**
+     * @brief Set the maximum absolute value of the output
+     * @param limit Output limit
+     */
+    void setOutputLimit(float limit) {
+        outputLimit = limit;
+    }
+
+    /**
+     * @brief Compute the controller output for a new measurement
+     * @param setpoint Desired value
+     * @param measurement Measured value
+     * @param dtS Time elapsed since the previous update in seconds
+     * @return The controller output, clamped to the output limit
+     */
+    float update(float setpoint, float measurement, float dtS) {
+        return update(setpoint, measurement, dtS, dtS);
+    }
+
+    /**
+     * @brief Compute the controller output with a measurement sampled slower than the controller runs
+     *
+     * Differentiating the measurement at the controller rate would give a zero rate while the measurement
+     * repeats and a spike at each new sample, so the derivative is updated only with a new measurement.
+     * @param setpoint Desired value
+     * @param measurement Latest measured value
+     * @param dtS Time elapsed since the previous update in seconds
+     * @param measurementDtS Time between the measurement and the previous one in seconds, 0 if the measurement
+     *        is the one of the previous update
+     * @return The controller output, clamped to the output limit
+     */
+    float update(float setpoint, float measurement, float dtS, float measurementDtS) {
+        float error = setpoint - measurement;
+        float proportional = kp * error;
+
+        // Derivative on measurement with a first order low-pass filter
+        if (!hasLastMeasurement || measurementDtS > 0.0f) {
+            if (hasLastMeasurement) {
+                float derivative = (measurement - lastMeasurement) / measurementDtS;
+                filteredDerivative += (derivative - filteredDerivative) * measurementDtS /
+                    (derivativeTimeConstantS + measurementDtS);
+            }
+            lastMeasurement = measurement;
+            hasLastMeasurement = true;
+        }
+        float derivativeTerm = -kd * filteredDerivative;
+
+        integral += ki * error * dtS;
+        integral = std::max(-outputLimit, std::min(outputLimit, integral));
+
+        // Back-calculate the integral when the output saturates
+        float output = proportional + integral + derivativeTerm;
+        if (output > outputLimit) {
+            integral = std::max(-outputLimit, integral - (output - outputLimit));
+            output = outputLimit;
+        } else if (output < -outputLimit) {
+            integral = std::min(outputLimit, integral - (output + outputLimit));
+            output = -outputLimit;
+        }
+
+        return output;
+    }
+
+    /**
+     * @brief Clear the integral and derivative state
+     */
+    void reset() {
+        integral = 0.0f;
+        filteredDerivative = 0.0f;
+        hasLastMeasurement = false;
+    }
+
+    /**
+     * @brief Get the integral term
+     * @return The current integral term in output units
+     */
+    float getIntegral() const {
+        return integral;
+    }
+};
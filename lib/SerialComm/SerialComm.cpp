@@ -31,7 +31,7 @@ SerialCommand SerialComm::readCommands() {
                 cmd.isValid = true;
             } else {
                 // Invalid command format
-                Serial.println("Invalid command format received: " + line);
+                formatErrorCount++;
             }
         }
     }
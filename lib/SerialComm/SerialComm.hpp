@@ -59,8 +59,17 @@ class SerialComm {
          * @return A SerialCommand struct containing the parsed command and its values.
          */
         SerialCommand readCommands();
+
+        /**
+         * Gets the number of received lines discarded because they were not in the "<command>:<values>" format.
+         * @return The number of malformed lines received since startup.
+         */
+        uint32_t getFormatErrorCount() const {
+            return formatErrorCount;
+        }
         
     private:
         HardwareSerial& serial;
         String receiveBuffer;  // Buffer to accumulate incoming data until newline
+        uint32_t formatErrorCount = 0;
 };
\ No newline at end of file
@@ -0,0 +1,58 @@
+#include "ServoCalibrationStore.hpp"
+
+bool ServoCalibrationStore::begin() {
+    if (!preferences.begin(NVS_NAMESPACE, false)) {
+        return false;
+    }
+
+    initialized = true;
+    return true;
+}
+
+bool ServoCalibrationStore::load(ServoCalibration& outCalibration) {
+    if (!initialized) {
+        return false;
+    }
+
+    StoredCalibration stored;
+    const size_t expectedSize = sizeof(stored);
+    if (preferences.getBytesLength(NVS_KEY_CALIBRATION) != expectedSize ||
+        preferences.getBytes(NVS_KEY_CALIBRATION, &stored, expectedSize) != expectedSize) {
+        return false;
+    }
+
+    // Reject data written by another format version or out of the servo range
+    const ServoCalibration& calibration = stored.calibration;
+    if (stored.version != FORMAT_VERSION ||
+        calibration.xCenterPulseUs < MIN_PULSE_US || calibration.xCenterPulseUs > MAX_PULSE_US ||
+        calibration.yCenterPulseUs < MIN_PULSE_US || calibration.yCenterPulseUs > MAX_PULSE_US) {
+        return false;
+    }
+    for (const auto& row : calibration.tiltModel.gainDegPerUs) {
+        if (isnan(row[0]) || isnan(row[1])) {
+            return false;
+        }
+    }
+
+    outCalibration = calibration;
+    return true;
+}
+
+bool ServoCalibrationStore::save(const ServoCalibration& calibration) {
+    if (!initialized) {
+        return false;
+    }
+
+    StoredCalibration stored = {};
+    stored.version = FORMAT_VERSION;
+    stored.calibration = calibration;
+    return preferences.putBytes(NVS_KEY_CALIBRATION, &stored, sizeof(stored)) == sizeof(stored);
+}
+
+bool ServoCalibrationStore::clear() {
+    if (!initialized) {
+        return false;
+    }
+
+    return preferences.remove(NVS_KEY_CALIBRATION);
+}
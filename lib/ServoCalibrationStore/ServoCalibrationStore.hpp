@@ -0,0 +1,42 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <CalibrationSolver.hpp>
+
+/**
+ * Servo calibration persisted across reboots
+ */
+struct ServoCalibration {
+    uint16_t xCenterPulseUs;    // X servo pulse width that levels the table
+    uint16_t yCenterPulseUs;    // Y servo pulse width that levels the table
+    TiltModel tiltModel;        // Table tilt change per microsecond of pulse width, all zero if unknown
+};
+
+/**
+ * ServoCalibrationStore keeps the last servo calibration in NVS, so the next boot can verify it instead of
+ * calibrating from scratch.
+ */
+class ServoCalibrationStore {
+public:
+    bool begin();
+
+    bool load(ServoCalibration& outCalibration);
+    bool save(const ServoCalibration& calibration);
+    bool clear();
+
+private:
+    static constexpr const char* NVS_NAMESPACE = "servocal";
+    static constexpr const char* NVS_KEY_CALIBRATION = "cal";
+    static constexpr uint8_t FORMAT_VERSION = 2;
+    static constexpr uint16_t MIN_PULSE_US = 500;
+    static constexpr uint16_t MAX_PULSE_US = 2500;
+
+    struct StoredCalibration {
+        uint8_t version;
+        ServoCalibration calibration;
+    };
+
+    Preferences preferences;
+    bool initialized = false;
+};
@@ -0,0 +1,136 @@
+#include "ServoMotionLoop.hpp"
+
+ServoMotionLoop::ServoMotionLoop(HardwareServo& xServo, HardwareServo& yServo, int16_t initialPulseUs)
+    : xServo(xServo), yServo(yServo),
+      xProfile(initialPulseUs, 200, 100000, 4000000), // Default limits: 200us/s, 100000us/s^2, 4000000us/s^3
+      yProfile(initialPulseUs, 200, 100000, 4000000),
+      targetPulses(packPulses(initialPulseUs, initialPulseUs)),
+      resetPulses(packPulses(initialPulseUs, initialPulseUs)),
+      outputPulses(packPulses(initialPulseUs, initialPulseUs)),
+      resetPending(false), maxRate(200), outputEnabled(true) {
+}
+
+void ServoMotionLoop::setAccelerationLimits(uint32_t maxAcceleration, uint32_t maxJerk) {
+    uint16_t rate = maxRate.load(std::memory_order_acquire);
+    xProfile.setLimits(rate, maxAcceleration, maxJerk);
+    yProfile.setLimits(rate, maxAcceleration, maxJerk);
+    appliedMaxRate = rate;
+}
+
+bool ServoMotionLoop::begin(uint16_t rateHz) {
+    if (rateHz == 0) {
+        return false;
+    }
+
+    // Whole milliseconds period, so every profile update uses exactly the same time step
+    periodMs = max(1UL, 1000UL / rateHz);
+    stats.nominalPeriodUs = periodMs * 1000;
+    resetStats();
+
+    esp_timer_create_args_t timerArgs = {};
+    timerArgs.callback = &ServoMotionLoop::timerCallback;
+    timerArgs.arg = this;
+    timerArgs.dispatch_method = ESP_TIMER_TASK;
+    timerArgs.name = "ServoMotionLoop";
+    if (esp_timer_create(&timerArgs, &timer) != ESP_OK) {
+        return false;
+    }
+
+    return esp_timer_start_periodic(timer, static_cast<uint64_t>(periodMs) * 1000) == ESP_OK;
+}
+
+void ServoMotionLoop::reset(int16_t xPulseUs, int16_t yPulseUs) {
+    uint32_t packed = packPulses(xPulseUs, yPulseUs);
+    targetPulses.store(packed, std::memory_order_release);
+    resetPulses.store(packed, std::memory_order_release);
+    resetPending.store(true, std::memory_order_release);
+}
+
+ServoLoopStats ServoMotionLoop::getStats() {
+    portENTER_CRITICAL(&statsMux);
+    ServoLoopStats snapshot = stats;
+    portEXIT_CRITICAL(&statsMux);
+    return snapshot;
+}
+
+void ServoMotionLoop::resetStats() {
+    portENTER_CRITICAL(&statsMux);
+    statsResetPending = true;
+    portEXIT_CRITICAL(&statsMux);
+}
+
+void ServoMotionLoop::timerCallback(void* arg) {
+    static_cast<ServoMotionLoop*>(arg)->step();
+}
+
+void ServoMotionLoop::step() {
+    int64_t startUs = esp_timer_get_time();
+
+    // Apply the requests posted by the other tasks
+    if (resetPending.exchange(false, std::memory_order_acquire)) {
+        uint32_t packed = resetPulses.load(std::memory_order_acquire);
+        xProfile.reset(unpackX(packed));
+        yProfile.reset(unpackY(packed));
+    }
+    uint16_t rate = maxRate.load(std::memory_order_acquire);
+    if (rate != appliedMaxRate) {
+        xProfile.setMaxVelocity(rate);
+        yProfile.setMaxVelocity(rate);
+        appliedMaxRate = rate;
+    }
+    uint32_t targets = targetPulses.load(std::memory_order_acquire);
+    int16_t xTarget = unpackX(targets);
+    int16_t yTarget = unpackY(targets);
+
+    // Closed-loop tilt correction, applied to the targets so enabling or disabling it never makes the servos jump
+    if (tiltController != nullptr) {
+        int16_t xCorrectionUs, yCorrectionUs;
+        tiltController->update(periodMs, xCorrectionUs, yCorrectionUs);
+        xTarget += xCorrectionUs;
+        yTarget += yCorrectionUs;
+    }
+    xProfile.setTarget(xTarget);
+    yProfile.setTarget(yTarget);
+
+    // Advance the profiles by exactly one period
+    xProfile.update(periodMs);
+    yProfile.update(periodMs);
+    outputPulses.store(packPulses(xProfile.getCurrentValue(), yProfile.getCurrentValue()), std::memory_order_release);
+
+    if (outputEnabled.load(std::memory_order_acquire)) {
+        xServo.setPulseWidth(static_cast<uint16_t>(xProfile.getCurrentValue()));
+        yServo.setPulseWidth(static_cast<uint16_t>(yProfile.getCurrentValue()));
+    }
+
+    updateStats(startUs);
+}
+
+void ServoMotionLoop::updateStats(int64_t startUs) {
+    uint32_t executionUs = static_cast<uint32_t>(esp_timer_get_time() - startUs);
+
+    portENTER_CRITICAL(&statsMux);
+    if (statsResetPending) {
+        uint32_t nominalPeriodUs = stats.nominalPeriodUs;
+        stats = {};
+        stats.nominalPeriodUs = nominalPeriodUs;
+        stats.minPeriodUs = UINT32_MAX;
+        statsResetPending = false;
+        lastTickUs = 0;
+    }
+
+    if (lastTickUs != 0) {
+        uint32_t periodUs = static_cast<uint32_t>(startUs - lastTickUs);
+        uint32_t jitterUs = periodUs > stats.nominalPeriodUs ? periodUs - stats.nominalPeriodUs : stats.nominalPeriodUs - periodUs;
+        stats.ticks++;
+        stats.sumPeriodUs += periodUs;
+        stats.minPeriodUs = min(stats.minPeriodUs, periodUs);
+        stats.maxPeriodUs = max(stats.maxPeriodUs, periodUs);
+        stats.maxJitterUs = max(stats.maxJitterUs, jitterUs);
+        if (periodUs > stats.nominalPeriodUs + stats.nominalPeriodUs / 2) {
+            stats.latePeriods++;
+        }
+    }
+    stats.maxExecutionUs = max(stats.maxExecutionUs, executionUs);
+    lastTickUs = startUs;
+    portEXIT_CRITICAL(&statsMux);
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+#include <esp_timer.h>
+#include <HardwareServo.hpp>
+#include <MotionProfiler.hpp>
+#include <TiltController.hpp>
+
+/**
+ * Statistics of the servo loop period, used to verify that the motion pipeline runs at a constant rate.
+ */
+struct ServoLoopStats {
+    uint32_t nominalPeriodUs;   ///< Configured loop period
+    uint32_t ticks;             ///< Number of loop iterations measured
+    uint32_t minPeriodUs;       ///< Shortest measured period
+    uint32_t maxPeriodUs;       ///< Longest measured period
+    uint64_t sumPeriodUs;       ///< Sum of the measured periods, to compute the mean
+    uint32_t maxJitterUs;       ///< Largest deviation of a period from the nominal one
+    uint32_t latePeriods;       ///< Periods longer than 1.5 times the nominal one
+    uint32_t maxExecutionUs;    ///< Longest execution time of a loop iteration
+
+    /**
+     * Print the statistics in a human readable format
+     * @param out Where to print the statistics (e.g. Serial)
+     */
+    void printTo(Print& out) const {
+        out.printf("Servo loop statistics (nominal period %lu us)\n", (unsigned long)nominalPeriodUs);
+        out.printf("  ticks:         %lu\n", (unsigned long)ticks);
+        if (ticks > 0) {
+            out.printf("  period:        min %lu us, mean %lu us, max %lu us\n",
+                (unsigned long)minPeriodUs, (unsigned long)(sumPeriodUs / ticks), (unsigned long)maxPeriodUs);
+        }
+        out.printf("  max jitter:    %lu us\n", (unsigned long)maxJitterUs);
+        out.printf("  late periods:  %lu\n", (unsigned long)latePeriods);
+        out.printf("  max execution: %lu us\n", (unsigned long)maxExecutionUs);
+    }
+};
+
+/**
+ * ServoMotionLoop runs the servo motion pipeline (target, jerk-limited profile, pulse width output) for the X and Y
+ * servos in a periodic esp_timer callback at a fixed rate, so the profiles always advance with a constant time step
+ * regardless of the load of the other tasks. Targets, rate limit and resets are posted lock-free from any task.
+ */
+class ServoMotionLoop {
+public:
+    /**
+     * Constructor for the ServoMotionLoop class.
+     * @param xServo Reference to the HardwareServo controlling the X axis.
+     * @param yServo Reference to the HardwareServo controlling the Y axis.
+     * @param initialPulseUs Initial pulse width of both servos in microseconds.
+     */
+    ServoMotionLoop(HardwareServo& xServo, HardwareServo& yServo, int16_t initialPulseUs = 1500);
+
+    /**
+     * Sets the acceleration and jerk limits of both servos. Must be called before begin().
+     * @param maxAcceleration Maximum pulse width acceleration in microseconds per second^2.
+     * @param maxJerk Maximum pulse width jerk in microseconds per second^3.
+     */
+    void setAccelerationLimits(uint32_t maxAcceleration, uint32_t maxJerk);
+
+    /**
+     * Sets the tilt controller whose pulse width corrections are added to the targets, closing the loop on the
+     * measured table tilt. Must be called before begin().
+     * @param controller Pointer to the tilt controller, or nullptr to run open loop.
+     */
+    void setTiltController(TiltController* controller) {
+        tiltController = controller;
+    }
+
+    /**
+     * Starts the periodic loop.
+     * @param rateHz Loop rate in Hz. The period is rounded to whole milliseconds to keep the profile time step exact.
+     * @return true if the timer was created and started, false otherwise.
+     */
+    bool begin(uint16_t rateHz);
+
+    /**
+     * Sets the pulse widths the servos have to move to with the current maximum rate.
+     * @param xPulseUs Target X servo pulse width in microseconds.
+     * @param yPulseUs Target Y servo pulse width in microseconds.
+     */
+    void setTargets(int16_t xPulseUs, int16_t yPulseUs) {
+        targetPulses.store(packPulses(xPulseUs, yPulseUs), std::memory_order_release);
+    }
+
+    /**
+     * Sets the maximum pulse width change rate of both servos. Lowering it while moving faster brakes within
+     * the acceleration limits.
+     * @param pulsesPerSecond Maximum rate in microseconds per second.
+     */
+    void setMaxRate(uint16_t pulsesPerSecond) {
+        maxRate.store(pulsesPerSecond, std::memory_order_release);
+    }
+
+    /**
+     * Moves both profiles instantly to the given pulse widths, which also become the new targets.
+     * @param xPulseUs X servo pulse width in microseconds.
+     * @param yPulseUs Y servo pulse width in microseconds.
+     */
+    void reset(int16_t xPulseUs, int16_t yPulseUs);
+
+    /**
+     * Enables or disables the output to the servos. When disabled the profiles keep running but the servos
+     * are not written, so another component (e.g. the calibration) can drive them directly.
+     * @param enabled true to write the profile output to the servos, false otherwise.
+     */
+    void setOutputEnabled(bool enabled) {
+        outputEnabled.store(enabled, std::memory_order_release);
+    }
+
+    /**
+     * Gets the pulse widths the servos are moving to, as set by setTargets or reset.
+     * @param xPulseUs Output X target pulse width in microseconds.
+     * @param yPulseUs Output Y target pulse width in microseconds.
+     */
+    void getTargets(int16_t& xPulseUs, int16_t& yPulseUs) const {
+        uint32_t packed = targetPulses.load(std::memory_order_acquire);
+        xPulseUs = unpackX(packed);
+        yPulseUs = unpackY(packed);
+    }
+
+    /**
+     * Gets the output of the motion profiles at the last loop tick, the targets ramped within the motion limits
+     * with the tilt correction included.
+     * @param xPulseUs Output X profile pulse width in microseconds.
+     * @param yPulseUs Output Y profile pulse width in microseconds.
+     */
+    void getOutputs(int16_t& xPulseUs, int16_t& yPulseUs) const {
+        uint32_t packed = outputPulses.load(std::memory_order_acquire);
+        xPulseUs = unpackX(packed);
+        yPulseUs = unpackY(packed);
+    }
+
+    /**
+     * Gets a snapshot of the loop period statistics.
+     * @return The statistics accumulated since the last reset.
+     */
+    ServoLoopStats getStats();
+
+    /**
+     * Resets the loop period statistics.
+     */
+    void resetStats();
+
+private:
+    HardwareServo& xServo;
+    HardwareServo& yServo;
+    MotionProfiler<int16_t> xProfile;
+    MotionProfiler<int16_t> yProfile;
+    TiltController* tiltController = nullptr;
+    esp_timer_handle_t timer = nullptr;
+    uint32_t periodMs = 4;
+
+    std::atomic<uint32_t> targetPulses;
+    std::atomic<uint32_t> resetPulses;
+    std::atomic<uint32_t> outputPulses;
+    std::atomic<bool> resetPending;
+    std::atomic<uint16_t> maxRate;
+    std::atomic<bool> outputEnabled;
+    uint16_t appliedMaxRate = 0;
+
+    ServoLoopStats stats = {};
+    int64_t lastTickUs = 0;
+    bool statsResetPending = false;
+    portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+
+    static inline uint32_t packPulses(int16_t xPulseUs, int16_t yPulseUs) {
+        return (static_cast<uint32_t>(static_cast<uint16_t>(xPulseUs)) << 16) | static_cast<uint16_t>(yPulseUs);
+    }
+    static inline int16_t unpackX(uint32_t packed) {
+        return static_cast<int16_t>(packed >> 16);
+    }
+    static inline int16_t unpackY(uint32_t packed) {
+        return static_cast<int16_t>(packed & 0xFFFF);
+    }
+
+    static void timerCallback(void* arg);
+    void step();
+    void updateStats(int64_t startUs);
+};
@@ -0,0 +1,293 @@
+#include "SystemMonitor.hpp"
+
+#include <atomic>
+
+namespace {
+    constexpr uint8_t kOtherTasks = SystemMonitor::MAX_TASKS;   // Counter slot of the unwatched tasks
+    constexpr uint32_t kTaskStackBytes = 4096;
+
+    // Counters of the allocation wrappers. They are zero initialized before any constructor runs, since the
+    // wrappers are called from the very first allocation. The 32 bit counters wrap around, the sampling task
+    // accumulates their increments.
+    std::atomic<TaskHandle_t> watchedHandles[SystemMonitor::MAX_TASKS];
+    std::atomic<uint8_t> watchedCount;
+    std::atomic<uint32_t> taskAllocations[SystemMonitor::MAX_TASKS + 1];
+    std::atomic<uint32_t> taskAllocatedBytes[SystemMonitor::MAX_TASKS + 1];
+    std::atomic<uint32_t> allocationCount;
+    std::atomic<uint32_t> freeCount;
+
+    void countAllocation(size_t size) {
+        // Before the scheduler starts there is no current task, it also matches the unresolved handles
+        TaskHandle_t task = xTaskGetCurrentTaskHandle();
+        uint8_t slot = kOtherTasks;
+        if (task != nullptr) {
+            uint8_t count = watchedCount.load(std::memory_order_acquire);
+            for (uint8_t i = 0; i < count; i++) {
+                if (watchedHandles[i].load(std::memory_order_relaxed) == task) {
+                    slot = i;
+                    break;
+                }
+            }
+        }
+        taskAllocations[slot].fetch_add(1, std::memory_order_relaxed);
+        taskAllocatedBytes[slot].fetch_add(static_cast<uint32_t>(size), std::memory_order_relaxed);
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void countFree() {
+        freeCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    HeapSample readHeap(uint32_t caps) {
+        HeapSample heap;
+        heap.totalBytes = heap_caps_get_total_size(caps);
+        heap.freeBytes = heap_caps_get_free_size(caps);
+        heap.largestFreeBlock = heap_caps_get_largest_free_block(caps);
+        heap.minFreeBytes = heap_caps_get_minimum_free_size(caps);
+        return heap;
+    }
+}
+
+// Allocation wrappers installed by the -Wl,--wrap linker flags: the calls to malloc & co. of the whole program
+// land here, and __real_xxx are the original functions
+extern "C" {
+    void* __real_malloc(size_t size);
+    void* __real_calloc(size_t count, size_t size);
+    void* __real_realloc(void* block, size_t size);
+    void __real_free(void* block);
+
+    void* __wrap_malloc(size_t size) {
+        void* block = __real_malloc(size);
+        if (block != nullptr) {
+            countAllocation(size);
+        }
+        return block;
+    }
+
+    void* __wrap_calloc(size_t count, size_t size) {
+        void* block = __real_calloc(count, size);
+        if (block != nullptr) {
+            countAllocation(count * size);
+        }
+        return block;
+    }
+
+    void* __wrap_realloc(void* block, size_t size) {
+        // A resize counts as a new block replacing the old one, like the String reallocations it mostly serves
+        void* resized = __real_realloc(block, size);
+        if (block != nullptr && (resized != nullptr || size == 0)) {
+            countFree();
+        }
+        if (resized != nullptr) {
+            countAllocation(size);
+        }
+        return resized;
+    }
+
+    void __wrap_free(void* block) {
+        if (block != nullptr) {
+            countFree();
+        }
+        __real_free(block);
+    }
+}
+
+bool SystemMonitor::watchTask(TaskHandle_t handle) {
+    if (handle == nullptr) {
+        return false;
+    }
+    const char* name = pcTaskGetName(handle);
+    uint32_t stackFreeBytes = uxTaskGetStackHighWaterMark(handle);
+
+    portENTER_CRITICAL(&statsMux);
+    bool added = taskCount < MAX_TASKS;
+    if (added) {
+        tasks[taskCount] = {name, handle, stackFreeBytes, 0, 0, 0, 0};
+        watchedHandles[taskCount].store(handle, std::memory_order_relaxed);
+        taskCount++;
+        watchedCount.store(taskCount, std::memory_order_release);
+    }
+    portEXIT_CRITICAL(&statsMux);
+    return added;
+}
+
+bool SystemMonitor::begin(uint32_t samplePeriodMs) {
+    if (this->samplePeriodMs != 0 || samplePeriodMs == 0) {
+        return false;
+    }
+
+    this->samplePeriodMs = samplePeriodMs;
+    lastLogMs = millis();
+    sample();
+
+    TaskHandle_t handle = nullptr;
+    BaseType_t created = xTaskCreatePinnedToCore(
+        [](void* param) {
+            static_cast<SystemMonitor*>(param)->run();
+        },
+        "SystemMonitorTask",    // Task name
+        kTaskStackBytes,        // Stack size
+        this,                   // Parameter
+        1,                      // Priority
+        &handle,                // Task handle
+        0                       // Core 0
+    );
+    if (created != pdPASS) {
+        return false;
+    }
+    watchTask(handle);
+    return true;
+}
+
+void SystemMonitor::run() {
+    TickType_t lastWake = xTaskGetTickCount();
+    while (true) {
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(samplePeriodMs));
+        sample();
+
+        uint32_t nowMs = millis();
+        if (logPeriodMs > 0 && nowMs - lastLogMs >= logPeriodMs) {
+            lastLogMs = nowMs;
+            printSummary();
+        }
+    }
+}
+
+void SystemMonitor::sample() {
+    HeapSample internalNow = readHeap(MALLOC_CAP_INTERNAL);
+    HeapSample psramNow = readHeap(MALLOC_CAP_SPIRAM);
+
+    // Read the stacks outside of the critical section
+    portENTER_CRITICAL(&statsMux);
+    uint8_t count = taskCount;
+    portEXIT_CRITICAL(&statsMux);
+    uint32_t stackFreeBytes[MAX_TASKS];
+    for (uint8_t i = 0; i < count; i++) {
+        stackFreeBytes[i] = uxTaskGetStackHighWaterMark(watchedHandles[i].load(std::memory_order_relaxed));
+    }
+
+    portENTER_CRITICAL(&statsMux);
+    for (uint8_t i = 0; i < count; i++) {
+        tasks[i].stackFreeBytes = stackFreeBytes[i];
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        WatchedTask& task = tasks[i];
+        uint32_t taskAllocationsNow = taskAllocations[i].load(std::memory_order_relaxed);
+        uint32_t taskBytesNow = taskAllocatedBytes[i].load(std::memory_order_relaxed);
+        task.allocations += taskAllocationsNow - task.lastAllocations;
+        task.allocatedBytes += taskBytesNow - task.lastAllocatedBytes;
+        task.lastAllocations = taskAllocationsNow;
+        task.lastAllocatedBytes = taskBytesNow;
+    }
+    WatchedTask& others = tasks[kOtherTasks];
+    uint32_t otherAllocationsNow = taskAllocations[kOtherTasks].load(std::memory_order_relaxed);
+    uint32_t otherBytesNow = taskAllocatedBytes[kOtherTasks].load(std::memory_order_relaxed);
+    others.allocations += otherAllocationsNow - others.lastAllocations;
+    others.allocatedBytes += otherBytesNow - others.lastAllocatedBytes;
+    others.lastAllocations = otherAllocationsNow;
+    others.lastAllocatedBytes = otherBytesNow;
+
+    uint32_t allocationsNow = allocationCount.load(std::memory_order_relaxed);
+    uint32_t freesNow = freeCount.load(std::memory_order_relaxed);
+    uint32_t newAllocations = allocationsNow - lastAllocations;
+    allocations += newAllocations;
+    frees += freesNow - lastFrees;
+    lastAllocations = allocationsNow;
+    lastFrees = freesNow;
+    allocationsPerSecond = samples > 0 ? newAllocations * 1000.0f / samplePeriodMs : 0.0f;
+
+    internal = internalNow;
+    psram = psramNow;
+    minLargestFreeBlock = min(minLargestFreeBlock, internal.largestFreeBlock);
+    maxFragmentation = max(maxFragmentation, internal.getFragmentation());
+    samples++;
+    portEXIT_CRITICAL(&statsMux);
+}
+
+int32_t SystemMonitor::getLiveBlocks() const {
+    return static_cast<int32_t>(allocationCount.load(std::memory_order_relaxed) -
+                                freeCount.load(std::memory_order_relaxed));
+}
+
+SystemMemoryStats SystemMonitor::getStats() {
+    SystemMemoryStats stats;
+    portENTER_CRITICAL(&statsMux);
+    stats.samples = samples;
+    stats.samplePeriodMs = samplePeriodMs;
+    stats.internal = internal;
+    stats.psram = psram;
+    stats.minLargestFreeBlock = samples > 0 ? minLargestFreeBlock : 0;
+    stats.maxFragmentation = maxFragmentation;
+    stats.allocations = allocations;
+    stats.frees = frees;
+    stats.allocationsPerSecond = allocationsPerSecond;
+    portEXIT_CRITICAL(&statsMux);
+    stats.liveBlocks = getLiveBlocks();
+    return stats;
+}
+
+bool SystemMonitor::getTaskStats(uint8_t index, TaskMemoryStats& stats) {
+    portENTER_CRITICAL(&statsMux);
+    bool found = index < taskCount;
+    if (found) {
+        const WatchedTask& task = tasks[index];
+        stats = {task.name, task.stackFreeBytes, task.allocations, task.allocatedBytes};
+    }
+    portEXIT_CRITICAL(&statsMux);
+    return found;
+}
+
+void SystemMonitor::printSummary() {
+    SystemMemoryStats stats = getStats();
+    TaskMemoryStats task;
+    const char* tightestTask = nullptr;
+    uint32_t tightestStackBytes = UINT32_MAX;
+    for (uint8_t i = 0; getTaskStats(i, task); i++) {
+        if (task.stackFreeBytes < tightestStackBytes) {
+            tightestTask = task.name;
+            tightestStackBytes = task.stackFreeBytes;
+        }
+    }
+
+    log.printf("MEM %lu free, largest %lu (%.1f%% frag), min %lu; psram %lu free; %ld blocks, %.1f allocs/s",
+        (unsigned long)stats.internal.freeBytes, (unsigned long)stats.internal.largestFreeBlock,
+        stats.internal.getFragmentation() * 100.0f, (unsigned long)stats.internal.minFreeBytes,
+        (unsigned long)stats.psram.freeBytes, (long)stats.liveBlocks, stats.allocationsPerSecond);
+    if (tightestTask != nullptr) {
+        log.printf("; least stack %s %lu\n", tightestTask, (unsigned long)tightestStackBytes);
+    } else {
+        log.println();
+    }
+}
+
+void SystemMonitor::printTo(Print& out) {
+    getStats().printTo(out);
+
+    out.printf("  %-18s %10s %12s %12s\n", "task", "stack free", "allocations", "bytes");
+    TaskMemoryStats task;
+    for (uint8_t i = 0; getTaskStats(i, task); i++) {
+        out.printf("  %-18s %10lu %12llu %12llu\n", task.name, (unsigned long)task.stackFreeBytes,
+            (unsigned long long)task.allocations, (unsigned long long)task.allocatedBytes);
+    }
+    portENTER_CRITICAL(&statsMux);
+    const WatchedTask& others = tasks[kOtherTasks];
+    uint64_t otherAllocations = others.allocations;
+    uint64_t otherBytes = others.allocatedBytes;
+    portEXIT_CRITICAL(&statsMux);
+    out.printf("  %-18s %10s %12llu %12llu\n", "(other tasks)", "-", (unsigned long long)otherAllocations,
+        (unsigned long long)otherBytes);
+}
+
+void SystemMonitor::resetStats() {
+    portENTER_CRITICAL(&statsMux);
+    minLargestFreeBlock = internal.largestFreeBlock;
+    maxFragmentation = internal.getFragmentation();
+    allocations = 0;
+    frees = 0;
+    for (uint8_t i = 0; i <= MAX_TASKS; i++) {
+        tasks[i].allocations = 0;
+        tasks[i].allocatedBytes = 0;
+    }
+    portEXIT_CRITICAL(&statsMux);
+}
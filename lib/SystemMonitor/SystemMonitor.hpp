@@ -0,0 +1,176 @@
+#pragma once
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+/**
+ * State of a heap region at a sample
+ */
+struct HeapSample {
+    uint32_t totalBytes;        // Size of the region, 0 if the board does not have it
+    uint32_t freeBytes;
+    uint32_t largestFreeBlock;  // Largest allocation that can succeed
+    uint32_t minFreeBytes;      // Lowest free size since boot
+
+    /**
+     * Gets the share of the free memory unusable for an allocation of the whole free size.
+     * @return 0 when the free memory is a single block, close to 1 when it is scattered in small blocks.
+     */
+    float getFragmentation() const {
+        return freeBytes > 0 ? 1.0f - (float)largestFreeBlock / freeBytes : 0.0f;
+    }
+};
+
+/**
+ * Memory use of a watched task
+ */
+struct TaskMemoryStats {
+    const char* name;
+    uint32_t stackFreeBytes;    // Stack high water mark: the least free stack since the task started
+    uint64_t allocations;       // Heap allocations made by the task (malloc, calloc, realloc and new)
+    uint64_t allocatedBytes;    // Bytes requested by these allocations
+};
+
+/**
+ * Heap statistics accumulated by the SystemMonitor
+ */
+struct SystemMemoryStats {
+    uint32_t samples;
+    uint32_t samplePeriodMs;
+    HeapSample internal;            // Internal RAM at the last sample
+    HeapSample psram;               // PSRAM at the last sample
+    uint32_t minLargestFreeBlock;   // Smallest internal largest free block seen by the samples
+    float maxFragmentation;         // Highest internal fragmentation seen by the samples
+    uint64_t allocations;           // Heap allocations of all the tasks
+    uint64_t frees;                 // Heap blocks released by all the tasks
+    int32_t liveBlocks;             // Blocks allocated and not yet released since boot
+    float allocationsPerSecond;     // Allocation rate over the last sample period
+
+    /**
+     * Print the statistics in a human readable format
+     * @param out Where to print the statistics (e.g. Serial)
+     */
+    void printTo(Print& out) const {
+        out.printf("Heap: %lu samples every %lu ms\n", (unsigned long)samples, (unsigned long)samplePeriodMs);
+        out.printf("  internal: %lu of %lu bytes free, largest block %lu (%.1f%% fragmented), min free %lu\n",
+            (unsigned long)internal.freeBytes, (unsigned long)internal.totalBytes,
+            (unsigned long)internal.largestFreeBlock, internal.getFragmentation() * 100.0f,
+            (unsigned long)internal.minFreeBytes);
+        out.printf("  worst: largest block %lu, fragmentation %.1f%%\n", (unsigned long)minLargestFreeBlock,
+            maxFragmentation * 100.0f);
+        if (psram.totalBytes > 0) {
+            out.printf("  psram: %lu of %lu bytes free, largest block %lu, min free %lu\n",
+                (unsigned long)psram.freeBytes, (unsigned long)psram.totalBytes,
+                (unsigned long)psram.largestFreeBlock, (unsigned long)psram.minFreeBytes);
+        }
+        out.printf("  %llu allocations, %llu frees, %ld live blocks, %.1f allocations/s\n",
+            (unsigned long long)allocations, (unsigned long long)frees, (long)liveBlocks, allocationsPerSecond);
+    }
+};
+
+/**
+ * SystemMonitor samples the heap and the task stacks at a fixed period, to catch leaks, fragmentation and
+ * undersized stacks during long runs. It keeps the worst values seen, prints a summary line on a stream at a
+ * configurable period, and reports the stack high water mark and the heap allocations of every watched task.
+ *
+ * The allocations are counted by wrappers of malloc, calloc, realloc and free, installed at link time with the
+ * -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free flags (new and the Arduino String end up there too).
+ * Allocations made inside the C library itself (e.g. strdup) are not counted. The wrappers only add a few atomic
+ * increments to each allocation. The counters are global, so only one SystemMonitor should be created.
+ */
+class SystemMonitor {
+public:
+    static constexpr uint8_t MAX_TASKS = 16;
+
+    /**
+     * Constructor for SystemMonitor.
+     * @param log Stream where the periodic summary lines are printed (usually the USB serial).
+     */
+    SystemMonitor(Print& log) : log(log) {}
+
+    /**
+     * Adds a task to watch. Its allocations are counted from then on.
+     * @param handle Handle of the task, as returned by xTaskCreate. The task must not be deleted.
+     * @return true if the task was added, false if the handle is null or there is no room for more tasks.
+     */
+    bool watchTask(TaskHandle_t handle);
+
+    /**
+     * Takes the first sample and creates the sampling task, which watches itself.
+     * @param samplePeriodMs Sampling period in milliseconds.
+     * @return true if the sampling task was created, false otherwise.
+     */
+    bool begin(uint32_t samplePeriodMs);
+
+    /**
+     * Sets the period of the summary line printed on the log stream.
+     * @param periodMs Period in milliseconds, 0 to stop printing.
+     */
+    void setLogPeriod(uint32_t periodMs) {
+        logPeriodMs = periodMs;
+    }
+
+    SystemMemoryStats getStats();
+
+    /**
+     * Gets the memory use of a watched task.
+     * @param index Task index, in the order of watchTask.
+     * @param stats Output statistics.
+     * @return true if the task exists, false if index is out of range.
+     */
+    bool getTaskStats(uint8_t index, TaskMemoryStats& stats);
+
+    /**
+     * Gets the number of heap blocks allocated and not yet released, counted at the time of the call.
+     * @return The live blocks since boot.
+     */
+    int32_t getLiveBlocks() const;
+
+    /**
+     * Prints the heap statistics and the table of the watched tasks.
+     * @param out Where to print the report (e.g. Serial)
+     */
+    void printTo(Print& out);
+
+    /**
+     * Resets the worst values and the allocation counts. The live blocks and the stack high water marks,
+     * kept since boot, are not reset.
+     */
+    void resetStats();
+
+private:
+    struct WatchedTask {
+        const char* name;
+        TaskHandle_t handle;
+        uint32_t stackFreeBytes;
+        uint64_t allocations;
+        uint64_t allocatedBytes;
+        uint32_t lastAllocations;   // Counter values at the previous sample, the counters wrap around
+        uint32_t lastAllocatedBytes;
+    };
+
+    Print& log;
+    WatchedTask tasks[MAX_TASKS + 1] = {};  // The last entry collects the allocations of the unwatched tasks
+    uint8_t taskCount = 0;
+    uint32_t samplePeriodMs = 0;
+    uint32_t logPeriodMs = 0;
+    uint32_t lastLogMs = 0;
+
+    portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+    uint32_t samples = 0;
+    HeapSample internal = {};
+    HeapSample psram = {};
+    uint32_t minLargestFreeBlock = UINT32_MAX;
+    float maxFragmentation = 0.0f;
+    uint64_t allocations = 0;
+    uint64_t frees = 0;
+    uint32_t lastAllocations = 0;
+    uint32_t lastFrees = 0;
+    float allocationsPerSecond = 0.0f;
+
+    void run();
+    void sample();
+    void printSummary();
+};
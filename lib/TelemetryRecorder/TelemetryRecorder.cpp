@@ -0,0 +1,197 @@
+#include "TelemetryRecorder.hpp"
+
+namespace {
+    constexpr size_t kDumpChunkRecords = 8;     // Records copied out of the ring buffer per critical section
+}
+
+bool TelemetryRecorder::begin(uint32_t capacityRecords, uint8_t maxGames) {
+    if (buffer != nullptr || capacityRecords == 0 || maxGames == 0) {
+        return false;
+    }
+
+    buffer = static_cast<TelemetryRecord*>(ps_malloc(capacityRecords * sizeof(TelemetryRecord)));
+    games = static_cast<TelemetryGame*>(calloc(maxGames, sizeof(TelemetryGame)));
+    if (buffer == nullptr || games == nullptr) {
+        free(buffer);
+        free(games);
+        buffer = nullptr;
+        games = nullptr;
+        return false;
+    }
+
+    capacity = capacityRecords;
+    this->maxGames = maxGames;
+    stats.capacityRecords = capacity;
+    return true;
+}
+
+void TelemetryRecorder::beginGame(int64_t nowUs) {
+    if (buffer == nullptr) {
+        return;
+    }
+
+    portENTER_CRITICAL(&mux);
+    if (recording) {
+        gameAt(gameCount - 1).recording = false;
+    }
+    if (gameCount == maxGames) {
+        firstGame = (firstGame + 1) % maxGames;
+        gameCount--;
+    }
+    TelemetryGame& game = gameAt(gameCount);
+    game = {};
+    game.id = nextGameId++;
+    game.startMs = millis();
+    game.firstRecord = nextRecord;
+    game.recording = true;
+    gameCount++;
+    gameStartUs = nowUs;
+    recording = true;
+    portEXIT_CRITICAL(&mux);
+}
+
+void TelemetryRecorder::endGame(uint8_t level, uint8_t result, uint32_t completionMs) {
+    portENTER_CRITICAL(&mux);
+    if (recording) {
+        TelemetryGame& game = gameAt(gameCount - 1);
+        game.level = level;
+        game.result = result;
+        game.completionMs = completionMs;
+        game.recording = false;
+        recording = false;
+    }
+    portEXIT_CRITICAL(&mux);
+}
+
+void TelemetryRecorder::append(TelemetryRecord record, int64_t timeUs, int64_t costStartUs) {
+    record.timeUs = static_cast<uint32_t>(max<int64_t>(timeUs - gameStartUs, 0));
+
+    portENTER_CRITICAL(&mux);
+    if (!recording) {
+        stats.droppedRecords++;
+        portEXIT_CRITICAL(&mux);
+        return;
+    }
+    buffer[nextRecord % capacity] = record;
+    nextRecord++;
+    gameAt(gameCount - 1).recordCount++;
+
+    // The cost covers everything but leaving the critical section, a handful of cycles
+    uint32_t costUs = static_cast<uint32_t>(esp_timer_get_time() - costStartUs);
+    stats.records++;
+    stats.sumRecordUs += costUs;
+    stats.maxRecordUs = max(stats.maxRecordUs, costUs);
+    if (costUs > RECORD_BUDGET_US) {
+        stats.overBudgetRecords++;
+    }
+    portEXIT_CRITICAL(&mux);
+}
+
+void TelemetryRecorder::trimGame(TelemetryGame& game) const {
+    // Drop the records of the game overwritten by the newer ones
+    uint32_t age = nextRecord - game.firstRecord;
+    if (age > capacity) {
+        uint32_t lost = min(age - capacity, game.recordCount);
+        game.firstRecord += lost;
+        game.recordCount -= lost;
+        game.lostRecords += lost;
+    }
+}
+
+uint8_t TelemetryRecorder::getGameCount() {
+    portENTER_CRITICAL(&mux);
+    uint8_t count = gameCount;
+    portEXIT_CRITICAL(&mux);
+    return count;
+}
+
+bool TelemetryRecorder::getGame(uint8_t index, TelemetryGame& game) {
+    portENTER_CRITICAL(&mux);
+    bool found = index < gameCount;
+    if (found) {
+        game = gameAt(index);
+        trimGame(game);
+    }
+    portEXIT_CRITICAL(&mux);
+    return found;
+}
+
+size_t TelemetryRecorder::readRecords(const TelemetryGame& game, uint32_t offset, TelemetryRecord* records,
+                                      size_t maxRecords) {
+    size_t count = 0;
+    portENTER_CRITICAL(&mux);
+    while (count < maxRecords && offset + count < game.recordCount) {
+        uint32_t sequence = game.firstRecord + offset + count;
+        if (nextRecord - sequence > capacity) {
+            break;  // Overwritten since the game summary was taken
+        }
+        records[count++] = buffer[sequence % capacity];
+    }
+    portEXIT_CRITICAL(&mux);
+    return count;
+}
+
+void TelemetryRecorder::dumpTo(Print& out, int32_t gameId) {
+    uint8_t count = getGameCount();
+    uint8_t dumped = 0;
+    TelemetryGame game;
+    for (uint8_t i = 0; i < count; i++) {
+        if (getGame(i, game) && (gameId < 0 || game.id == static_cast<uint32_t>(gameId))) {
+            dumped++;
+        }
+    }
+
+    out.printf("TLM BEGIN %u %u %u\n", FORMAT_VERSION, (unsigned)sizeof(TelemetryRecord), dumped);
+    uint32_t records = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        if (getGame(i, game) && (gameId < 0 || game.id == static_cast<uint32_t>(gameId))) {
+            dumpGame(out, game);
+            records += game.recordCount;
+        }
+    }
+    out.printf("TLM END %lu\n", (unsigned long)records);
+}
+
+void TelemetryRecorder::dumpGame(Print& out, const TelemetryGame& game) {
+    static const char kHexDigits[] = "0123456789abcdef";
+
+    out.printf("TLM GAME %lu %lu %u %u %lu %lu %lu\n", (unsigned long)game.id, (unsigned long)game.startMs,
+        game.level, game.result, (unsigned long)game.completionMs, (unsigned long)game.recordCount,
+        (unsigned long)game.lostRecords);
+
+    // Records are copied in small chunks, so the recording is never held for the time it takes to print them
+    TelemetryRecord chunk[kDumpChunkRecords];
+    char line[6 + 2 * sizeof(TelemetryRecord) + 1] = "TLM R ";
+    uint32_t offset = 0;
+    while (offset < game.recordCount) {
+        size_t count = readRecords(game, offset, chunk, kDumpChunkRecords);
+        if (count == 0) {
+            break;
+        }
+        for (size_t i = 0; i < count; i++) {
+            const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&chunk[i]);
+            char* hex = line + 6;
+            for (size_t b = 0; b < sizeof(TelemetryRecord); b++) {
+                *hex++ = kHexDigits[bytes[b] >> 4];
+                *hex++ = kHexDigits[bytes[b] & 0x0F];
+            }
+            *hex++ = '\n';
+            out.write(reinterpret_cast<const uint8_t*>(line), hex - line);
+        }
+        offset += count;
+    }
+}
+
+TelemetryStats TelemetryRecorder::getStats() {
+    portENTER_CRITICAL(&mux);
+    TelemetryStats snapshot = stats;
+    portEXIT_CRITICAL(&mux);
+    return snapshot;
+}
+
+void TelemetryRecorder::resetStats() {
+    portENTER_CRITICAL(&mux);
+    stats = {};
+    stats.capacityRecords = capacity;
+    portEXIT_CRITICAL(&mux);
+}
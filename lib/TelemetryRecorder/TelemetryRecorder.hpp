@@ -0,0 +1,205 @@
+#pragma once
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+
+/**
+ * Type of a telemetry record: a periodic sample of the control loop or a game event. Event records carry the
+ * same sample fields as the periodic ones, taken when the event happened.
+ */
+enum class TelemetryRecordType : uint8_t {
+    SAMPLE = 0,     // Periodic control loop sample
+    START = 1,      // Game preparation started, first record of a game
+    KICKBACK = 2,   // Kickback issued at the game start, player control follows
+    DROP = 3,       // Ball drop accepted, timestamped by the sensor interrupt
+    TIMEOUT = 4,    // Time limit reached
+    STOP = 5        // Game stopped by the player
+};
+
+/**
+ * Telemetry record as stored in the ring buffer and exported by dumpTo. The layout is little endian and packed,
+ * it is the binary format decoded by tools/telemetry/decode_telemetry.py: keep them in sync and bump
+ * TelemetryRecorder::FORMAT_VERSION on any change.
+ */
+struct __attribute__((packed)) TelemetryRecord {
+    uint32_t timeUs;        // Time since the first record of the game in microseconds
+    uint8_t type;           // TelemetryRecordType
+    uint8_t flags;          // TELEMETRY_FLAG_xxx
+    int16_t inputX;         // Controller X input in 1/10000 of full deflection
+    int16_t inputY;         // Controller Y input in 1/10000 of full deflection
+    int16_t targetXUs;      // X servo target pulse width set by the game
+    int16_t targetYUs;      // Y servo target pulse width set by the game
+    int16_t rampXUs;        // X motion profile output (target ramped within the rate limits)
+    int16_t rampYUs;        // Y motion profile output (target ramped within the rate limits)
+    uint16_t pulseXUs;      // X pulse width written to the servo
+    uint16_t pulseYUs;      // Y pulse width written to the servo
+    int16_t tiltXCdeg;      // Measured X table tilt in hundredths of degree, valid with TELEMETRY_FLAG_TILT
+    int16_t tiltYCdeg;      // Measured Y table tilt in hundredths of degree, valid with TELEMETRY_FLAG_TILT
+};
+
+static_assert(sizeof(TelemetryRecord) == 26, "TelemetryRecord layout is part of the dump format");
+
+constexpr uint8_t TELEMETRY_FLAG_TILT = 0x01;           // The IMU tilt fields hold a fresh measurement
+constexpr uint8_t TELEMETRY_FLAG_TILT_CONTROL = 0x02;   // The closed-loop tilt control was enabled
+
+/**
+ * Summary of a recorded game
+ */
+struct TelemetryGame {
+    uint32_t id;            // Game number since boot
+    uint32_t startMs;       // millis() at the first record
+    uint32_t firstRecord;   // Sequence number of the first record still in the ring buffer
+    uint32_t recordCount;   // Records still in the ring buffer
+    uint32_t lostRecords;   // Oldest records of the game overwritten by newer games
+    uint8_t level;          // GameLevel of the game
+    uint8_t result;         // GameResult of the game
+    uint32_t completionMs;  // Completion time of the game
+    bool recording;         // The game is still being recorded
+};
+
+/**
+ * Recording statistics, to verify the cost of recording inside the control loop
+ */
+struct TelemetryStats {
+    uint32_t capacityRecords;   // Size of the ring buffer in records
+    uint32_t records;           // Records written
+    uint32_t droppedRecords;    // Records discarded because no game was being recorded or the buffer is missing
+    uint32_t maxRecordUs;       // Longest record, from the sample capture to the end of the write
+    uint64_t sumRecordUs;       // Sum of the record costs, to compute the mean
+    uint32_t overBudgetRecords; // Records longer than TelemetryRecorder::RECORD_BUDGET_US
+
+    /**
+     * Print the statistics in a human readable format
+     * @param out Where to print the statistics (e.g. Serial)
+     */
+    void printTo(Print& out) const {
+        out.printf("Telemetry: %lu records (%lu dropped), buffer %lu records\n",
+            (unsigned long)records, (unsigned long)droppedRecords, (unsigned long)capacityRecords);
+        out.printf("  record cost: mean %.2f us, max %lu us, %lu over budget\n",
+            records > 0 ? (float)sumRecordUs / records : 0.0f, (unsigned long)maxRecordUs,
+            (unsigned long)overBudgetRecords);
+    }
+};
+
+/**
+ * TelemetryRecorder keeps the control loop trace of the last games in a ring buffer allocated in PSRAM.
+ * Records have a fixed size and are copied under a short critical section, so the recording cost inside the
+ * control loop is constant: no allocation, no I/O and no blocking. The oldest records are overwritten when the
+ * buffer is full and only the last games are listed.
+ *
+ * The recorded games are exported as text lines on a stream (e.g. the USB serial) with dumpTo:
+ *   TLM BEGIN <format version> <record size> <games>
+ *   TLM GAME <id> <start ms> <level> <result> <completion ms> <records> <lost records>
+ *   TLM R <record bytes in hex>            (one line per record of the game above)
+ *   TLM END <records>
+ * Every line starts with "TLM " so the dump can be captured together with other log messages.
+ */
+class TelemetryRecorder {
+public:
+    static constexpr uint8_t FORMAT_VERSION = 1;
+    static constexpr uint32_t RECORD_BUDGET_US = 20;    // Recording cost above which a record is counted as over budget
+
+    /**
+     * Allocates the ring buffer in PSRAM.
+     * @param capacityRecords Size of the ring buffer in records.
+     * @param maxGames Number of most recent games listed and exported.
+     * @return true if the buffer was allocated, false otherwise (nothing is recorded).
+     */
+    bool begin(uint32_t capacityRecords, uint8_t maxGames);
+
+    /**
+     * Starts recording a new game. The oldest game is forgotten if maxGames are already listed.
+     * @param nowUs Current esp_timer time, the time origin of the game records.
+     */
+    void beginGame(int64_t nowUs);
+
+    /**
+     * Stops recording the current game and stores its outcome.
+     * @param level GameLevel of the game.
+     * @param result GameResult of the game.
+     * @param completionMs Completion time of the game in milliseconds.
+     */
+    void endGame(uint8_t level, uint8_t result, uint32_t completionMs);
+
+    /**
+     * Checks if a game is being recorded.
+     * @return true between beginGame and endGame, false otherwise.
+     */
+    bool isRecording() const {
+        return recording;
+    }
+
+    /**
+     * Appends a record to the current game. Safe to call from any task.
+     * @param record The record to append; its timeUs field is set from timeUs.
+     * @param timeUs esp_timer time of the record.
+     * @param costStartUs esp_timer time when the caller started capturing the record, so the recording cost
+     *                    measured covers the capture too.
+     */
+    void append(TelemetryRecord record, int64_t timeUs, int64_t costStartUs);
+
+    /**
+     * Gets the number of games listed, the current one included.
+     * @return The number of games.
+     */
+    uint8_t getGameCount();
+
+    /**
+     * Gets the summary of a listed game.
+     * @param index Game index, 0 being the oldest.
+     * @param game Output summary.
+     * @return true if the game exists, false otherwise.
+     */
+    bool getGame(uint8_t index, TelemetryGame& game);
+
+    /**
+     * Copies records of a game out of the ring buffer. Records overwritten in the meantime are not copied.
+     * @param game Summary returned by getGame.
+     * @param offset Index of the first record to copy, 0 being the first record of the game.
+     * @param records Output records.
+     * @param maxRecords Capacity of the output array.
+     * @return The number of records copied.
+     */
+    size_t readRecords(const TelemetryGame& game, uint32_t offset, TelemetryRecord* records, size_t maxRecords);
+
+    /**
+     * Exports the listed games on a stream in the dump format described above.
+     * @param out Where to print the dump (e.g. Serial).
+     * @param gameId Id of the game to export, or -1 to export all the listed games.
+     */
+    void dumpTo(Print& out, int32_t gameId = -1);
+
+    /**
+     * Gets a snapshot of the recording statistics.
+     * @return The statistics accumulated since the last reset.
+     */
+    TelemetryStats getStats();
+
+    /**
+     * Resets the recording statistics.
+     */
+    void resetStats();
+
+private:
+    TelemetryRecord* buffer = nullptr;
+    uint32_t capacity = 0;
+    uint32_t nextRecord = 0;    // Sequence number of the next record, the buffer index is nextRecord % capacity
+
+    TelemetryGame* games = nullptr;
+    uint8_t maxGames = 0;
+    uint8_t gameCount = 0;
+    uint8_t firstGame = 0;      // Index in games of the oldest listed game
+    uint32_t nextGameId = 1;
+    int64_t gameStartUs = 0;
+    volatile bool recording = false;
+
+    TelemetryStats stats = {};
+    portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+
+    TelemetryGame& gameAt(uint8_t index) {
+        return games[(firstGame + index) % maxGames];
+    }
+    void trimGame(TelemetryGame& game) const;
+    void dumpGame(Print& out, const TelemetryGame& game);
+};
@@ -1,4 +1,5 @@
 #include <CenterGrowAndFadeAnimation.hpp>
+#include <esp_timer.h>
 
 void CenterGrowAndFadeAnimation::animate(String text, RgbColor zoomColor, RgbColor textGradientColors[ANIM_TEXT_FONT_HEIGHT], CancelToken& cancelToken) {
     uint16_t dw = display.getWidth();
@@ -7,6 +8,7 @@ void CenterGrowAndFadeAnimation::animate(String text, RgbColor zoomColor, RgbCol
     int16_t centerY = dh / 2;
     
     uint16_t fpsTimeMs = 1000 / fps; 
+    firstFrameUs = 0;
 
     int16_t textWidth = display.getStringWidth(text, ANIM_TEXT_FONT);
     int16_t startX = (dw - textWidth) / 2;
@@ -25,6 +27,9 @@ void CenterGrowAndFadeAnimation::animate(String text, RgbColor zoomColor, RgbCol
         display.fillRect(centerX - w/2, centerY - h/2, w, h, zoomColor);
 
         display.show();
+        if (firstFrameUs == 0) {
+            firstFrameUs = esp_timer_get_time();
+        }
         delay(fpsTimeMs);
     }
 
@@ -32,6 +37,9 @@ void CenterGrowAndFadeAnimation::animate(String text, RgbColor zoomColor, RgbCol
     display.clear();
     display.drawCenteredString(0, text, textGradientColors, ANIM_TEXT_FONT);
     display.show();
+    if (firstFrameUs == 0) {
+        firstFrameUs = esp_timer_get_time();
+    }
     delay(middlePaudeMs);
 
     // --- PHASE 3: FADE OUT (Toward white/off) ---
@@ -10,10 +10,20 @@ class CenterGrowAndFadeAnimation {
 
         void animate(String text, RgbColor zoomColor, RgbColor textGradientColors[ANIM_TEXT_FONT_HEIGHT], CancelToken& cancelToken);
 
+        /**
+         * Gets the time the last animate() call showed its first frame, e.g. to measure the skew of a sound
+         * scheduled with it.
+         * @return esp_timer time in microseconds, 0 if no frame was shown.
+         */
+        int64_t getFirstFrameUs() const {
+            return firstFrameUs;
+        }
+
     private:
         PuzzleDisplay& display;
         uint16_t growDurationMs;
         uint16_t middlePaudeMs;
         uint16_t fadeTimeMs;
         uint8_t fps;
+        int64_t firstFrameUs = 0;
 };
\ No newline at end of file
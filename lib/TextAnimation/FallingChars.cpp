@@ -4,8 +4,28 @@ constexpr int16_t bounceOffsets[] = {-8, -5, -2, 0, -1, 0};
 constexpr int16_t numFrames = 6;
 
 void FallingCharsAnimation::InCharAnimation(uint16_t x, char c, uint16_t charWidth, const RgbColor* gradientColors, uint16_t frameDelayMs, RgbColor initialCanvas[TOTAL_LEDS], CancelToken& cancelToken) {
+    // The frames follow a fixed schedule, so the bounce sounds are scheduled ahead at the time of the frames
+    // where the character hits the ground
+    int64_t startUs = esp_timer_get_time();
+    int64_t frameUs = frameDelayMs * 1000LL;
+    AudioVoice bounceVoices[numFrames] = {};
+    if (bounceAudioFile != nullptr) {
+        for (uint16_t frame = 0; frame < numFrames; frame++) {
+            if (bounceOffsets[frame] == 0) {
+                bounceVoices[frame] = audioPlayer.playAt(startUs + frame * frameUs, bounceAudioFile);
+            }
+        }
+    }
+
     for (uint16_t frame = 0; frame < numFrames; frame++) {
-        IF_CANCELLED(cancelToken, return;)
+        IF_CANCELLED(cancelToken, {
+            for (uint16_t next = frame; next < numFrames; next++) {
+                if (bounceVoices[next] != AUDIO_VOICE_NONE) {
+                    audioPlayer.stop(bounceVoices[next]);
+                }
+            }
+            return;
+        })
 
         // Restore the initial canvas to clear previous character position
         display.copyCanvasFrom(initialCanvas, x, 0, charWidth, display.getHeight(), x, 0);
@@ -14,14 +34,15 @@ void FallingCharsAnimation::InCharAnimation(uint16_t x, char c, uint16_t charWid
         int16_t yOffset = bounceOffsets[frame];
         display.drawChar(x, yOffset, c, gradientColors, FONT_6x8);
 
-        // Play bounce sound when hit ground
-        if (yOffset == 0 && bounceAudioFile != nullptr) {
-            audioPlayer.play(bounceAudioFile);
-        }
-
+        delayUntilUs(startUs + frame * frameUs);
         display.show();
-        delay(frameDelayMs);
-    }    
+
+        // Bounce sound when hit ground
+        if (bounceVoices[frame] != AUDIO_VOICE_NONE) {
+            audioPlayer.markShown(bounceVoices[frame], esp_timer_get_time());
+        }
+    }
+    delayUntilUs(startUs + numFrames * frameUs);
 }
 
 void FallingCharsAnimation::InAnimation(uint16_t x, const char* text, const RgbColor* gradientColors, uint16_t charDurationMs, CancelToken& cancelToken) {    
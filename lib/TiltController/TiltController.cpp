@@ -0,0 +1,91 @@
+#include "TiltController.hpp"
+
+TiltController::TiltController()
+    : enabled(false), targetTilt(0), measuredTilt(0), measuredTiltTimestampUs(0), measuredTiltTimeMs(0) {
+}
+
+void TiltController::begin(float kp, float ki, float kd, uint16_t maxCorrectionPulseUs, uint16_t maxMeasurementAgeMs) {
+    this->maxCorrectionPulseUs = maxCorrectionPulseUs;
+    this->maxMeasurementAgeMs = maxMeasurementAgeMs;
+    xPid.setGains(kp, ki, kd);
+    yPid.setGains(kp, ki, kd);
+    xPid.setOutputLimit(maxCorrectionPulseUs);
+    yPid.setOutputLimit(maxCorrectionPulseUs);
+    xPid.reset();
+    yPid.reset();
+    resetStats();
+}
+
+void TiltController::update(uint32_t deltaTimeMs, int16_t& xCorrectionUs, int16_t& yCorrectionUs) {
+    if (!enabled.load(std::memory_order_acquire)) {
+        if (active) {
+            xPid.reset();
+            yPid.reset();
+            lastXCorrectionUs = 0;
+            lastYCorrectionUs = 0;
+            active = false;
+        }
+        xCorrectionUs = 0;
+        yCorrectionUs = 0;
+        return;
+    }
+    active = true;
+
+    // Without a fresh measurement hold the last correction instead of integrating an outdated error
+    unsigned long measurementAgeMs = millis() - measuredTiltTimeMs.load(std::memory_order_acquire);
+    if (measurementAgeMs > maxMeasurementAgeMs) {
+        xCorrectionUs = lastXCorrectionUs;
+        yCorrectionUs = lastYCorrectionUs;
+        portENTER_CRITICAL(&statsMux);
+        stats.staleMeasurements++;
+        portEXIT_CRITICAL(&statsMux);
+        return;
+    }
+
+    // The timestamp is stored after the tilt: a new timestamp comes with its tilt (or a newer one)
+    uint32_t timestampUs = measuredTiltTimestampUs.load(std::memory_order_acquire);
+    uint32_t target = targetTilt.load(std::memory_order_acquire);
+    uint32_t measured = measuredTilt.load(std::memory_order_acquire);
+    float targetX = unpackX(target);
+    float targetY = unpackY(target);
+    float measuredX = unpackX(measured);
+    float measuredY = unpackY(measured);
+
+    // The loop runs faster than the tilt is measured: the tilt rate is computed between the measurements only
+    float dtS = deltaTimeMs * 0.001f;
+    float measurementDtS = (timestampUs - lastMeasurementTimestampUs) * 1e-6f;
+    lastMeasurementTimestampUs = timestampUs;
+    float xCorrection = xPid.update(targetX, measuredX, dtS, measurementDtS);
+    float yCorrection = yPid.update(targetY, measuredY, dtS, measurementDtS);
+    lastXCorrectionUs = static_cast<int16_t>(lroundf(xCorrection));
+    lastYCorrectionUs = static_cast<int16_t>(lroundf(yCorrection));
+    xCorrectionUs = lastXCorrectionUs;
+    yCorrectionUs = lastYCorrectionUs;
+
+    float errorX = targetX - measuredX;
+    float errorY = targetY - measuredY;
+    bool saturated = fabsf(xCorrection) >= maxCorrectionPulseUs || fabsf(yCorrection) >= maxCorrectionPulseUs;
+    portENTER_CRITICAL(&statsMux);
+    stats.samples++;
+    stats.sumSquaredErrorX += errorX * errorX;
+    stats.sumSquaredErrorY += errorY * errorY;
+    stats.maxAbsErrorXDeg = max(stats.maxAbsErrorXDeg, fabsf(errorX));
+    stats.maxAbsErrorYDeg = max(stats.maxAbsErrorYDeg, fabsf(errorY));
+    if (saturated) {
+        stats.saturatedSamples++;
+    }
+    portEXIT_CRITICAL(&statsMux);
+}
+
+TiltControlStats TiltController::getStats() {
+    portENTER_CRITICAL(&statsMux);
+    TiltControlStats snapshot = stats;
+    portEXIT_CRITICAL(&statsMux);
+    return snapshot;
+}
+
+void TiltController::resetStats() {
+    portENTER_CRITICAL(&statsMux);
+    stats = {};
+    portEXIT_CRITICAL(&statsMux);
+}
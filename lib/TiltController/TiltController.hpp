@@ -0,0 +1,160 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+#include <PidController.hpp>
+
+/**
+ * Tracking statistics of the closed-loop tilt control.
+ */
+struct TiltControlStats {
+    uint32_t samples;           ///< Number of closed-loop updates measured
+    float sumSquaredErrorX;     ///< Sum of the squared X tilt error, to compute the RMS error
+    float sumSquaredErrorY;     ///< Sum of the squared Y tilt error, to compute the RMS error
+    float maxAbsErrorXDeg;      ///< Largest absolute X tilt error
+    float maxAbsErrorYDeg;      ///< Largest absolute Y tilt error
+    uint32_t saturatedSamples;  ///< Updates where the correction was at its limit on at least one axis
+    uint32_t staleMeasurements; ///< Updates skipped because the tilt measurement was too old
+
+    /**
+     * Print the statistics in a human readable format
+     * @param out Where to print the statistics (e.g. Serial)
+     */
+    void printTo(Print& out) const {
+        out.println("Tilt control statistics");
+        out.printf("  samples:            %lu\n", (unsigned long)samples);
+        if (samples > 0) {
+            out.printf("  RMS error:          X %.2f deg, Y %.2f deg\n",
+                sqrtf(sumSquaredErrorX / samples), sqrtf(sumSquaredErrorY / samples));
+        }
+        out.printf("  max error:          X %.2f deg, Y %.2f deg\n", maxAbsErrorXDeg, maxAbsErrorYDeg);
+        out.printf("  saturated:          %lu\n", (unsigned long)saturatedSamples);
+        out.printf("  stale measurements: %lu\n", (unsigned long)staleMeasurements);
+    }
+};
+
+/**
+ * TiltController closes the loop on the table tilt measured by the IMU. It runs inside the servo motion loop
+ * and returns, for each axis, a pulse width correction that a PID controller computes from the difference between
+ * the commanded and the measured tilt. The correction is added to the open-loop servo targets, so the table angle
+ * tracks the command despite servo deadband, backlash and load.
+ *
+ * Commands and measurements are posted lock-free from the other tasks.
+ */
+class TiltController {
+public:
+    TiltController();
+
+    /**
+     * Configures the controller gains. Must be called before the servo motion loop is started.
+     * @param kp Proportional gain in microseconds per degree.
+     * @param ki Integral gain in microseconds per degree per second.
+     * @param kd Derivative gain in microseconds per degree per second of tilt rate.
+     * @param maxCorrectionPulseUs Maximum absolute pulse width correction in microseconds.
+     * @param maxMeasurementAgeMs Oldest tilt measurement used to close the loop.
+     */
+    void begin(float kp, float ki, float kd, uint16_t maxCorrectionPulseUs, uint16_t maxMeasurementAgeMs);
+
+    /**
+     * Enables or disables the closed loop. When disabled the correction is zero and the controller state is reset.
+     * @param enabled true to close the loop, false otherwise.
+     */
+    void setEnabled(bool enabled) {
+        this->enabled.store(enabled, std::memory_order_release);
+    }
+
+    /**
+     * Checks if the closed loop is enabled.
+     * @return true if the closed loop is enabled, false otherwise.
+     */
+    bool isEnabled() const {
+        return enabled.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Sets the commanded table tilt.
+     * @param xDeg Commanded X tilt in degrees from level.
+     * @param yDeg Commanded Y tilt in degrees from level.
+     */
+    void setTargetTilt(float xDeg, float yDeg) {
+        targetTilt.store(packTilt(xDeg, yDeg), std::memory_order_release);
+    }
+
+    /**
+     * Sets the latest measured table tilt.
+     * @param xDeg Measured X tilt in degrees from level.
+     * @param yDeg Measured Y tilt in degrees from level.
+     * @param timestampUs Sampling time of the measurement in microseconds (e.g. the time of the last IMU sample
+     *        fused), used to compute the tilt rate at the measurement rate.
+     */
+    void setMeasuredTilt(float xDeg, float yDeg, uint32_t timestampUs) {
+        measuredTilt.store(packTilt(xDeg, yDeg), std::memory_order_release);
+        measuredTiltTimestampUs.store(timestampUs, std::memory_order_release);
+        measuredTiltTimeMs.store(millis(), std::memory_order_release);
+    }
+
+    /**
+     * Gets the latest measured table tilt.
+     * @param xDeg Output measured X tilt in degrees from level.
+     * @param yDeg Output measured Y tilt in degrees from level.
+     * @return true if the measurement is recent enough to close the loop, false otherwise.
+     */
+    bool getMeasuredTilt(float& xDeg, float& yDeg) const {
+        unsigned long timeMs = measuredTiltTimeMs.load(std::memory_order_acquire);
+        uint32_t packed = measuredTilt.load(std::memory_order_acquire);
+        xDeg = unpackX(packed);
+        yDeg = unpackY(packed);
+        return timeMs != 0 && millis() - timeMs <= maxMeasurementAgeMs;
+    }
+
+    /**
+     * Runs one closed-loop update. Called by the servo motion loop at its fixed rate.
+     * @param deltaTimeMs Time elapsed since the previous update in milliseconds.
+     * @param xCorrectionUs Output X pulse width correction in microseconds.
+     * @param yCorrectionUs Output Y pulse width correction in microseconds.
+     */
+    void update(uint32_t deltaTimeMs, int16_t& xCorrectionUs, int16_t& yCorrectionUs);
+
+    /**
+     * Gets a snapshot of the tracking statistics.
+     * @return The statistics accumulated since the last reset.
+     */
+    TiltControlStats getStats();
+
+    /**
+     * Resets the tracking statistics.
+     */
+    void resetStats();
+
+private:
+    PidController xPid;
+    PidController yPid;
+    float maxCorrectionPulseUs = 0.0f;
+    uint16_t maxMeasurementAgeMs = 0;
+    bool active = false;
+    int16_t lastXCorrectionUs = 0;
+    int16_t lastYCorrectionUs = 0;
+    uint32_t lastMeasurementTimestampUs = 0;
+
+    std::atomic<bool> enabled;
+    std::atomic<uint32_t> targetTilt;
+    std::atomic<uint32_t> measuredTilt;
+    std::atomic<uint32_t> measuredTiltTimestampUs;
+    std::atomic<unsigned long> measuredTiltTimeMs;
+
+    TiltControlStats stats = {};
+    portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+
+    // Tilts are exchanged in hundredths of degree, packed in a single word to keep the two axes consistent
+    static inline uint32_t packTilt(float xDeg, float yDeg) {
+        int16_t x = static_cast<int16_t>(constrain(lroundf(xDeg * 100.0f), INT16_MIN, INT16_MAX));
+        int16_t y = static_cast<int16_t>(constrain(lroundf(yDeg * 100.0f), INT16_MIN, INT16_MAX));
+        return (static_cast<uint32_t>(static_cast<uint16_t>(x)) << 16) | static_cast<uint16_t>(y);
+    }
+    static inline float unpackX(uint32_t packed) {
+        return static_cast<int16_t>(packed >> 16) * 0.01f;
+    }
+    static inline float unpackY(uint32_t packed) {
+        return static_cast<int16_t>(packed & 0xFFFF) * 0.01f;
+    }
+};
@@ -6,9 +6,11 @@
 #include <Config.hpp>
 
 #include <HardwareServo.hpp>
+#include <I2CBus.hpp>
 #include <M5UnitPbHub.hpp>
+#include <InputScanner.hpp>
 #include <MPU6886.hpp>
-#include <Button.hpp>
+#include <OrientationEstimator.hpp>
 
 #include <Controller.hpp>
 #include <Game.hpp>
@@ -19,12 +21,18 @@
 #include <HighScore.hpp>
 
 #include <CancelToken.hpp>
+#include <DebugConsole.hpp>
+#include <SystemMonitor.hpp>
 
 HardwareServo xServo(X_SERVO_PIN, 0, -180, 180, 500, 2500, true);
 HardwareServo yServo(Y_SERVO_PIN, 1, -180, 180, 500, 2500);
 
-M5UnitPbHub pbHub(Wire);
-MPU6886 imu(Wire);
+I2CBus i2cBus(Wire);
+M5UnitPbHub pbHub(i2cBus);
+MPU6886 imu(i2cBus);
+InputScanner inputScanner(pbHub);
+uint8_t startButtonInput = InputScanner::INVALID_INPUT;
+uint8_t stopButtonInput = InputScanner::INVALID_INPUT;
 
 SerialComm controllerSerialComm(Serial1);
 Controller controller(controllerSerialComm);
@@ -35,6 +43,8 @@ AudioPlayer audioPlayer(1); // Use I2S port 1. Display uses I2S0 (ESP32) or LCD
 PuzzleDisplay display(PUZZLE_DISPLAY_PIXEL_PIN);
 HighScore highScore;
 MainDisplay mainDisplay(audioPlayer, display, highScore);
+DebugConsole debugConsole(Serial);
+SystemMonitor systemMonitor(Serial);
 GameLevel nextGameLevel = GameLevel::EASY;
 bool waitingForGameToStart = false;
 
@@ -47,7 +57,7 @@ GameLevel selectNextGameLevel(GameLevel level) {
     return GameLevel::EASY;
 }
 
-uint16_t getCriticalThresholdMs(GameLevel level) {
+uint32_t getCriticalThresholdMs(GameLevel level) {
     switch (level) {
         case GameLevel::EASY:
             return 10000;
@@ -70,20 +80,26 @@ void showInitFailed(const char* displayMessage, const char* serialMessage) {
 }
 
 bool isStopButtonPressed() {
-    return pbHub.digitalRead(0, 1) == LOW;
+    return inputScanner.isPressed(stopButtonInput);
 }
 
 bool isStartButtonPressed() {
-    return pbHub.digitalRead(0, 0) == LOW;
+    return inputScanner.isPressed(startButtonInput);
 }
 
 void IRAM_ATTR onBallDropInterrupt() {
-    game.setBallDropped();
+    // The sensor pulls the pin low while it detects the ball
+    game.setBallDropSignal(digitalRead(BALL_DROP_PIN) == LOW);
 }
 
 void setup() {
     // Initialize serial communication for debugging
     Serial.begin(115200);
+    // Sample the heap and the stacks of this task and of all the tasks created below, with a summary line on
+    // the serial
+    systemMonitor.watchTask(xTaskGetCurrentTaskHandle());
+    systemMonitor.begin(1000);
+    systemMonitor.setLogPeriod(60000);
     // Initialize serial comunication with the remote controller
     Serial1.begin (115200, SERIAL_8N1, REMOTE_CONTROLLER_UART_RX, REMOTE_CONTROLLER_UART_TX, false);
     Serial1.setTimeout(0);
@@ -95,13 +111,33 @@ void setup() {
     pinMode(LED_BUILTIN, OUTPUT);
     // Initialize ball drop pin input
     pinMode(BALL_DROP_PIN, INPUT_PULLUP);
-    attachInterrupt(digitalPinToInterrupt(BALL_DROP_PIN), onBallDropInterrupt, FALLING);
+    attachInterrupt(digitalPinToInterrupt(BALL_DROP_PIN), onBallDropInterrupt, CHANGE);
 
     // Initialize I2C bus & devices
     Wire.begin(I2C_SDA, I2C_SCL);
+    TaskHandle_t taskHandle = nullptr;
+    // Create the task that owns the I2C bus and executes the transactions of all the other tasks
+    xTaskCreatePinnedToCore(
+        [](void* param) {
+            i2cBus.run();
+        },
+        "I2CBusTask",       // Task name
+        3072,               // Stack size
+        nullptr,            // Parameter
+        4,                  // Priority (above the tasks using the bus, below audio)
+        &taskHandle,        // Task handle
+        0                   // Core 0
+    );
+    systemMonitor.watchTask(taskHandle);
     if (!pbHub.begin()) {
         showInitFailed("PB Hub Init Fail", "Failed to initialize M5 Unit PB Hub");
     }
+    // The start and stop buttons are the two pins of PbHub channel 0, read one at a time on each scan
+    startButtonInput = inputScanner.addInput(0, 0);
+    stopButtonInput = inputScanner.addInput(0, 1);
+    if (!inputScanner.begin()) {
+        showInitFailed("Input Init Fail", "Failed to initialize the input scanner");
+    }
     if (!imu.begin(MPU6886::AccelScale::RANGE_2G)) {
         showInitFailed("IMU Init Fail", "Failed to initialize MPU6886 IMU");
     }
@@ -121,7 +157,8 @@ void setup() {
     }
     // Overwrite high scores with default values if both stop and start buttons are pressed during startup as a way 
     // to reset high scores without needing to reflash the device
-    if (isStopButtonPressed() && isStartButtonPressed()) {
+    // The scanner task is not running yet: use the state read by the first scan
+    if (inputScanner.isRawPressed(stopButtonInput) && inputScanner.isRawPressed(startButtonInput)) {
         highScore.overwriteWithDefaultScores(getDefaultGameConfig());
     }
 
@@ -143,6 +180,16 @@ void setup() {
     // Initialize Audio library with I2S pins
     audioPlayer.begin(I2S_BCLK, I2S_LRC, I2S_DOUT);
 
+    // Preload the short sound effects in PSRAM, the longer tunes are streamed from SPIFFS. The countdown beeps are
+    // synthesized.
+    const char* soundEffects[] = {AUDIO_FILE_WARNING_BEEP, AUDIO_FILE_LEGO_SNAP, AUDIO_FILE_BADING,
+        AUDIO_FILE_SYSTEM_READY, AUDIO_FILE_NEW_HIGHSCORE};
+    for (const char* soundEffect : soundEffects) {
+        if (!audioPlayer.preload(soundEffect)) {
+            Serial.printf("Sound effect %s not cached, it will be streamed\n", soundEffect);
+        }
+    }
+
     // Initialized the controller and wait for serial communication to be established with it
     if (!controller.begin(getDefaultControllerConfig())) {
         showInitFailed("Ctrl Init Fail", "Failed to initialize controller");
@@ -160,9 +207,10 @@ void setup() {
         8192,               // Stack size
         nullptr,            // Parameter
         5,                  // Priority (higher than default loop, but not max)
-        nullptr,            // Task handle
+        &taskHandle,        // Task handle
         0                   // Core 0
     );
+    systemMonitor.watchTask(taskHandle);
 
     // Create a task to run the HMI update loop on core 0
     xTaskCreatePinnedToCore(
@@ -173,9 +221,10 @@ void setup() {
         12 * 1024,          // Stack size
         nullptr,            // Parameter
         1,                  // Priority
-        nullptr,            // Task handle
+        &taskHandle,        // Task handle
         1                   // Core 1
     );
+    systemMonitor.watchTask(taskHandle);
 
     // Create a task to run controller update loop on core 1 with high priority to ensure responsive control
     xTaskCreatePinnedToCore(
@@ -186,9 +235,10 @@ void setup() {
         4096,               // Stack size
         nullptr,            // Parameter
         2,                  // Priority
-        nullptr,            // Task handle
+        &taskHandle,        // Task handle
         1                   // Core 1
     );
+    systemMonitor.watchTask(taskHandle);
 
     // Create a task to run the game update loop on core 1
     xTaskCreatePinnedToCore(
@@ -217,9 +267,25 @@ void setup() {
         4096,               // Stack size
         nullptr,            // Parameter
         1,                  // Priority
-        nullptr,            // Task handle
+        &taskHandle,        // Task handle
         1                   // Core 1
     );
+    systemMonitor.watchTask(taskHandle);
+
+    // Create a task that scans the buttons and publishes their debounced state and events. A scan per debounce
+    // period of the Button (10 ms) is enough and keeps the PbHub reads at 200 per second
+    xTaskCreatePinnedToCore(
+        [](void* param) {
+            inputScanner.scanLoop(10);
+        },
+        "InputScanTask",    // Task name
+        3072,               // Stack size
+        nullptr,            // Parameter
+        3,                  // Priority
+        &taskHandle,        // Task handle
+        0                   // Core 0
+    );
+    systemMonitor.watchTask(taskHandle);
 
     // Create a task that listens for game stop button
     xTaskCreatePinnedToCore(
@@ -236,14 +302,185 @@ void setup() {
         2048,               // Stack size
         nullptr,            // Parameter
         1,                  // Priority
-        nullptr,            // Task handle
+        &taskHandle,        // Task handle
         1                   // Core 1
     );
+    systemMonitor.watchTask(taskHandle);
+
+    // Register the diagnostic commands available on the USB serial and create the task that serves them
+    debugConsole.registerCommand("CTRL", "Print the controller link telemetry", [](Print& out, const char* args) {
+        controller.getTelemetry().printTo(out);
+        out.printf("  update rate: %u ms, mean interval: %.1f ms, jitter: %.1f ms, loss: %.1f%%, stale timeout: %u ms\n",
+            controller.getUpdateRate(), controller.getMeanIntervalMs(), controller.getIntervalJitterMs(),
+            controller.getLossRatio() * 100.0f, controller.getStalenessTimeoutMs());
+    });
+    debugConsole.registerCommand("CTRL_RESET", "Reset the controller link telemetry", [](Print& out, const char* args) {
+        controller.resetTelemetry();
+        out.println("Controller link telemetry reset");
+    });
+    debugConsole.registerCommand("SERVO", "Print the servo motion loop period statistics", [](Print& out, const char* args) {
+        game.getServoLoopStats().printTo(out);
+    });
+    debugConsole.registerCommand("SERVO_RESET", "Reset the servo motion loop period statistics", [](Print& out, const char* args) {
+        game.resetServoLoopStats();
+        out.println("Servo motion loop statistics reset");
+    });
+    debugConsole.registerCommand("TILT", "Print the closed-loop tilt control statistics", [](Print& out, const char* args) {
+        game.getTiltControlStats().printTo(out);
+    });
+    debugConsole.registerCommand("TILT_RESET", "Reset the closed-loop tilt control statistics", [](Print& out, const char* args) {
+        game.resetTiltControlStats();
+        out.println("Tilt control statistics reset");
+    });
+    debugConsole.registerCommand("IMU", "Print the IMU FIFO streaming counters", [](Print& out, const char* args) {
+        MPU6886FifoStats stats = imu.getFifoStats();
+        out.printf("IMU FIFO: %lu samples, %lu burst reads, %lu overflows, %lu ring overruns\n",
+            (unsigned long)stats.samples, (unsigned long)stats.burstReads,
+            (unsigned long)stats.overflows, (unsigned long)stats.ringOverruns);
+    });
+    debugConsole.registerCommand("I2C", "Print the I2C bus utilization and queue wait statistics", [](Print& out, const char* args) {
+        i2cBus.getStats().printTo(out);
+    });
+    debugConsole.registerCommand("I2C_RESET", "Reset the I2C bus statistics", [](Print& out, const char* args) {
+        i2cBus.resetStats();
+        out.println("I2C bus statistics reset");
+    });
+    debugConsole.registerCommand("INPUT", "Print the button scanner timing and latency statistics", [](Print& out, const char* args) {
+        inputScanner.getStats().printTo(out);
+    });
+    debugConsole.registerCommand("INPUT_RESET", "Reset the button scanner statistics", [](Print& out, const char* args) {
+        inputScanner.resetStats();
+        out.println("Input scanner statistics reset");
+    });
+    debugConsole.registerCommand("BALL", "Print the ball drop sensor glitch counter", [](Print& out, const char* args) {
+        out.printf("Ball drop sensor: %lu glitches rejected\n", (unsigned long)game.getBallDropGlitchCount());
+    });
+    debugConsole.registerCommand("CAL", "Print the report of the boot servo calibration", [](Print& out, const char* args) {
+        game.getCalibrationReport().printTo(out);
+    });
+    debugConsole.registerCommand("CAL_CLEAR", "Forget the stored servo calibration", [](Print& out, const char* args) {
+        out.println(game.clearStoredCalibration() ? "Stored servo calibration cleared" : "No stored servo calibration");
+    });
+    debugConsole.registerCommand("SCORES", "Print the high score journal state and flash wear", [](Print& out, const char* args) {
+        highScore.getJournalStats().printTo(out);
+    });
+    debugConsole.registerCommand("TELEMETRY", "List the recorded games and the recording cost", [](Print& out, const char* args) {
+        TelemetryRecorder& telemetry = game.getTelemetry();
+        telemetry.getStats().printTo(out);
+        TelemetryGame recorded;
+        for (uint8_t i = 0; telemetry.getGame(i, recorded); i++) {
+            out.printf("  game %lu: started at %lu ms, %lu records (%lu lost), result %u, %lu ms%s\n",
+                (unsigned long)recorded.id, (unsigned long)recorded.startMs, (unsigned long)recorded.recordCount,
+                (unsigned long)recorded.lostRecords, recorded.result, (unsigned long)recorded.completionMs,
+                recorded.recording ? ", recording" : "");
+        }
+    });
+    debugConsole.registerCommand("TELEMETRY_DUMP", "Export the recorded games, or only game <id>", [](Print& out, const char* args) {
+        game.getTelemetry().dumpTo(out, *args != '\0' ? atol(args) : -1);
+    });
+    debugConsole.registerCommand("TELEMETRY_RESET", "Reset the telemetry recording cost statistics", [](Print& out, const char* args) {
+        game.getTelemetry().resetStats();
+        out.println("Telemetry statistics reset");
+    });
+    debugConsole.registerCommand("AUDIO", "Print the sound effect cache, the playback start latency and the mixer statistics", [](Print& out, const char* args) {
+        audioPlayer.getStats().printTo(out);
+        audioPlayer.getMixerStats().printTo(out);
+    });
+    debugConsole.registerCommand("AUDIO_RESET", "Reset the playback and mixer statistics", [](Print& out, const char* args) {
+        audioPlayer.resetStats();
+        out.println("Audio statistics reset");
+    });
+    debugConsole.registerCommand("MEM", "Print the heap state and the stack and heap use of every task", [](Print& out, const char* args) {
+        systemMonitor.printTo(out);
+    });
+    debugConsole.registerCommand("MEM_RESET", "Reset the worst heap values and the allocation counts", [](Print& out, const char* args) {
+        systemMonitor.resetStats();
+        out.println("Memory statistics reset");
+    });
+    debugConsole.registerCommand("MEM_LOG", "Print a heap summary line every <s> seconds, 0 to stop", [](Print& out, const char* args) {
+        uint32_t periodS = atol(args);
+        systemMonitor.setLogPeriod(periodS * 1000);
+        out.printf("Heap summary %s\n", periodS > 0 ? "enabled" : "disabled");
+    });
+    debugConsole.registerCommand("FUSION_BENCH", "Measure the cost of an orientation estimator update", [](Print& out, const char* args) {
+        constexpr uint32_t kUpdates = 10000;
+        OrientationEstimator estimator;
+        uint32_t startUs = micros();
+        for (uint32_t i = 0; i < kUpdates; i++) {
+            // Slowly rotating synthetic samples, 5ms apart, so every update runs the accelerometer correction
+            float angle = i * 0.0001f;
+            estimator.update(1.0f, -1.0f, 0.5f, sinf(angle), -sinf(angle), cosf(angle), i * 5000);
+        }
+        uint32_t elapsedUs = micros() - startUs;
+        out.printf("Orientation estimator: %.2f us per update (%lu updates, roll %.2f deg, pitch %.2f deg)\n",
+            (float)elapsedUs / kUpdates, (unsigned long)kUpdates, estimator.getRollDeg(), estimator.getPitchDeg());
+    });
+    debugConsole.registerCommand("ADPCM_BENCH", "Measure the flash read and the decoding cost of a second of IMA ADPCM audio", [](Print& out, const char* args) {
+        File file = SPIFFS.open(AUDIO_FILE_BRICK_MAZE);
+        WavFormat wav;
+        if (!file || !readWavHeader(file, wav) || !wav.isImaAdpcm()) {
+            out.printf("%s is not an IMA ADPCM file\n", AUDIO_FILE_BRICK_MAZE);
+            return;
+        }
+        // The blocks of the first second, read at once then decoded one by one as a streamed voice does
+        uint32_t blocks = (wav.sampleRate + wav.blockFrames - 1) / wav.blockFrames;
+        uint32_t blockBytes = blocks * wav.blockAlign;
+        uint8_t* data = static_cast<uint8_t*>(malloc(blockBytes + wav.blockFrames * wav.channels * sizeof(int16_t)));
+        if (data == nullptr) {
+            out.println("Not enough memory");
+            return;
+        }
+        int16_t* frames = reinterpret_cast<int16_t*>(data + blockBytes);
+        uint32_t readStartUs = micros();
+        size_t bytesRead = file.read(data, blockBytes);
+        uint32_t readUs = micros() - readStartUs;
+        uint32_t decoded = 0;
+        uint32_t decodeStartUs = micros();
+        for (size_t offset = 0; offset + wav.blockAlign <= bytesRead; offset += wav.blockAlign) {
+            decoded += imaAdpcmDecodeBlock(data + offset, wav.blockAlign, (uint8_t)wav.channels, frames);
+        }
+        uint32_t decodeUs = micros() - decodeStartUs;
+        free(data);
+        float audioS = (float)decoded / wav.sampleRate;
+        out.printf("IMA ADPCM: %.2f s of audio, %u bytes read in %lu us, decoded in %lu us\n", audioS,
+            (unsigned)bytesRead, (unsigned long)readUs, (unsigned long)decodeUs);
+        if (audioS > 0) {
+            out.printf("  per second of audio: %.0f us of flash read, %.0f us of decoding (%.2f%% of a core)\n",
+                readUs / audioS, decodeUs / audioS, decodeUs / audioS / 1e4f);
+        }
+    });
+
+    xTaskCreatePinnedToCore(
+        [](void* param) {
+            debugConsole.update();
+        },
+        "DebugConsoleTask", // Task name
+        4096,               // Stack size
+        nullptr,            // Parameter
+        1,                  // Priority
+        &taskHandle,        // Task handle
+        0                   // Core 0
+    );
+    systemMonitor.watchTask(taskHandle);
 
     // Calibrate servos by leveling the table before starting the game
     mainDisplay.setTableLevelingMode();
     game.servoCalibration(imu);
 
+    // Create a task that measures the table tilt for the closed-loop tilt control, now that the IMU is free
+    xTaskCreatePinnedToCore(
+        [](void* param) {
+            game.tiltSensorLoop(imu);
+        },
+        "TiltSensorTask",   // Task name
+        4096,               // Stack size
+        nullptr,            // Parameter
+        2,                  // Priority
+        &taskHandle,        // Task handle
+        0                   // Core 0
+    );
+    systemMonitor.watchTask(taskHandle);
+
     audioPlayer.play(AUDIO_FILE_SYSTEM_READY);
     delay(2000);
     mainDisplay.setNoGameMode(true);
@@ -292,16 +529,19 @@ void displayNextGameLevel() {
 }
 
 void beforeGame() {
-    Button startButton;
-
     mainDisplay.setNoGameMode();
-    controllerSerialComm.sendControllerHMIMode(SerialComm::ControllerHMIMode::NO_GAME);
+    controller.setHMIMode(SerialComm::ControllerHMIMode::NO_GAME);
     displayNextGameLevel();
+    // Ignore the clicks made during the last game
+    inputScanner.clearEvents();
 
     while (true) {
-        startButton.setRawState(millis(), isStartButtonPressed());
+        InputEvent event;
+        if (!inputScanner.popEvent(event, portMAX_DELAY)) {
+            continue;
+        }
 
-        if (startButton.wasSingleClicked()) {
+        if (event.input == startButtonInput && event.type == InputEvent::Type::CLICKED && event.clickCount == 1) {
             if (isStopButtonPressed()) {
                 nextGameLevel = selectNextGameLevel(nextGameLevel);
                 displayNextGameLevel();
@@ -309,14 +549,12 @@ void beforeGame() {
                 break;
             }
         }
-
-        delay(10);
     }
 }
 
 bool startGame() {
     game.prepareGame();
-    controllerSerialComm.sendControllerHMIMode(SerialComm::ControllerHMIMode::WAITING_TO_START);
+    controller.setHMIMode(SerialComm::ControllerHMIMode::WAITING_TO_START);
     mainDisplay.setReadySetGoMode();
     while (!mainDisplay.isModeDone()) {
         if (isStopButtonPressed()) {
@@ -328,17 +566,18 @@ bool startGame() {
     game.start(nextGameLevel);
 
     unsigned long gameEndTimeMs = game.currentGameEndTimeMs();
-    uint16_t gameTimeLimitMs = game.currentGameTimeLimitMs();
-    uint16_t criticalThresholdMs = getCriticalThresholdMs(nextGameLevel);
+    uint32_t gameTimeLimitMs = game.currentGameTimeLimitMs();
+    uint32_t criticalThresholdMs = getCriticalThresholdMs(nextGameLevel);
     mainDisplay.setCountdownMode(gameEndTimeMs, gameTimeLimitMs, criticalThresholdMs);
-    controllerSerialComm.sendControllerHMIMode(SerialComm::ControllerHMIMode::IN_GAME);
+    controller.setHMIMode(SerialComm::ControllerHMIMode::IN_GAME);
+    controller.resetTelemetry(); // Collect the link telemetry per game
     return true;
 }
 
 void gameEnd() {
     GameLevel lastGameLevel;
     GameResult lastGameResult;
-    uint16_t lastGameCompletionTimeMs;
+    uint32_t lastGameCompletionTimeMs;
 
     game.lastGameStats(lastGameLevel, lastGameResult, lastGameCompletionTimeMs);
 
@@ -348,7 +587,7 @@ void gameEnd() {
         return;
     }
 
-    controllerSerialComm.sendControllerHMIMode(SerialComm::ControllerHMIMode::END_GAME);
+    controller.setHMIMode(SerialComm::ControllerHMIMode::END_GAME);
 
     // Update the display to reflect the game result
     if (lastGameResult == GameResult::WON) {
@@ -368,7 +607,7 @@ void gameEnd() {
         if (rank >= 0) {
             // Enter player name and show high score celebration animation on the display
             // Press the stop button to cancel the high score submission.
-            controllerSerialComm.sendControllerHMIMode(SerialComm::ControllerHMIMode::WRITE_PLAYER_NAME);
+            controller.setHMIMode(SerialComm::ControllerHMIMode::WRITE_PLAYER_NAME);
             mainDisplay.setEndGameHighScoreMode(lastGameCompletionTimeMs, lastGameLevel, rank);
             bool highScoreCancel = false;
             while (!mainDisplay.isModeDone() && !highScoreCancel) {
@@ -396,7 +635,7 @@ void gameEnd() {
             }
 
             // Small pause to let the player see their completion time before returning to idle state
-            controllerSerialComm.sendControllerHMIMode(SerialComm::ControllerHMIMode::END_GAME);
+            controller.setHMIMode(SerialComm::ControllerHMIMode::END_GAME);
             delay(2000);
         }
     } else if (lastGameResult == GameResult::LOST) {
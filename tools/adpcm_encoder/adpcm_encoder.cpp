@@ -0,0 +1,227 @@
+/**
+ * Linux encoder of the sound files: converts the 16-bit PCM WAV files of the data directory to the IMA ADPCM WAV
+ * files stored in SPIFFS by the build (see encode_data.py), a quarter of the size.
+ *
+ * Each file is coded in blocks of kBlockBytesPerChannel bytes per channel (505 frames), with the encoder of
+ * lib/AudioPlayer/ImaAdpcm.cpp, and keeps its name, so the firmware plays it with the same path. The output is
+ * then read back with the firmware WAV parser and decoder and compared with the input: the report gives the
+ * sizes and the signal to noise ratio of each file. Other files (not 16-bit PCM WAV) are copied as they are.
+ *
+ * Usage:
+ *   adpcm_encoder -o <output directory> <file>...
+ *
+ * The exit status is 0 when every file is converted or copied and decodes to the frames of its input.
+ */
+
+#include <ImaAdpcm.hpp>
+#include <SPIFFS.h>
+#include <WavFile.hpp>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+    constexpr uint32_t kBlockBytesPerChannel = 256;
+
+    struct Pcm {
+        WavFormat format;
+        std::vector<int16_t> samples;
+    };
+
+    std::string baseName(const std::string& path) {
+        size_t slash = path.rfind('/');
+        return slash == std::string::npos ? path : path.substr(slash + 1);
+    }
+
+    std::string directoryName(const std::string& path) {
+        size_t slash = path.rfind('/');
+        return slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+    }
+
+    /**
+     * Opens a file of the host with the file system of the firmware, so it is parsed by the firmware code.
+     */
+    fs::File openHostFile(const std::string& path) {
+        SPIFFS.setHostDirectory(directoryName(path).c_str());
+        SPIFFS.begin();
+        return SPIFFS.open(("/" + baseName(path)).c_str());
+    }
+
+    bool readPcm(const std::string& path, Pcm& pcm) {
+        fs::File file = openHostFile(path);
+        if (!file || !readWavHeader(file, pcm.format) || !pcm.format.isPcm16()) {
+            return false;
+        }
+        pcm.samples.resize(pcm.format.getFrames() * pcm.format.channels);
+        size_t bytes = pcm.samples.size() * sizeof(int16_t);
+        return file.read(reinterpret_cast<uint8_t*>(pcm.samples.data()), bytes) == bytes;
+    }
+
+    void putLe16(std::vector<uint8_t>& out, uint16_t value) {
+        out.push_back(value & 0xFF);
+        out.push_back(value >> 8);
+    }
+
+    void putLe32(std::vector<uint8_t>& out, uint32_t value) {
+        putLe16(out, value & 0xFFFF);
+        putLe16(out, value >> 16);
+    }
+
+    void putTag(std::vector<uint8_t>& out, const char* tag) {
+        out.insert(out.end(), tag, tag + 4);
+    }
+
+    /**
+     * Encodes the samples to an IMA ADPCM WAV file: fmt chunk with the frames per block, fact chunk with the
+     * frames, then the blocks, the last one padded.
+     */
+    std::vector<uint8_t> encodeWav(const Pcm& pcm) {
+        uint8_t channels = (uint8_t)pcm.format.channels;
+        uint32_t blockBytes = kBlockBytesPerChannel * channels;
+        uint32_t blockFrames = imaAdpcmBlockFrames(blockBytes, channels);
+        uint32_t frames = pcm.samples.size() / channels;
+        uint32_t blocks = (frames + blockFrames - 1) / blockFrames;
+
+        std::vector<uint8_t> out;
+        putTag(out, "RIFF");
+        putLe32(out, 4 + (8 + 20) + (8 + 4) + 8 + blocks * blockBytes);
+        putTag(out, "WAVE");
+        putTag(out, "fmt ");
+        putLe32(out, 20);
+        putLe16(out, WAV_FORMAT_IMA_ADPCM);
+        putLe16(out, channels);
+        putLe32(out, pcm.format.sampleRate);
+        putLe32(out, (uint32_t)((uint64_t)pcm.format.sampleRate * blockBytes / blockFrames));
+        putLe16(out, blockBytes);
+        putLe16(out, 4);
+        putLe16(out, 2);
+        putLe16(out, blockFrames);
+        putTag(out, "fact");
+        putLe32(out, 4);
+        putLe32(out, frames);
+        putTag(out, "data");
+        putLe32(out, blocks * blockBytes);
+
+        std::vector<uint8_t> block(blockBytes);
+        for (uint32_t frame = 0; frame < frames; frame += blockFrames) {
+            imaAdpcmEncodeBlock(pcm.samples.data() + frame * channels, std::min(blockFrames, frames - frame),
+                channels, block.data(), blockBytes);
+            out.insert(out.end(), block.begin(), block.end());
+        }
+        return out;
+    }
+
+    bool writeFile(const std::string& path, const std::vector<uint8_t>& bytes) {
+        FILE* file = fopen(path.c_str(), "wb");
+        if (file == nullptr) {
+            return false;
+        }
+        bool written = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+        return fclose(file) == 0 && written;
+    }
+
+    bool readFile(const std::string& path, std::vector<uint8_t>& bytes) {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (file == nullptr) {
+            return false;
+        }
+        bytes.clear();
+        uint8_t buffer[4096];
+        size_t count;
+        while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            bytes.insert(bytes.end(), buffer, buffer + count);
+        }
+        fclose(file);
+        return true;
+    }
+
+    /**
+     * Decodes an encoded file as the firmware does and measures its error.
+     * @param snrDb Output signal to noise ratio of the decoded samples.
+     * @return true if the file decodes to the frames of the input.
+     */
+    bool checkEncoded(const std::string& path, const Pcm& pcm, double& snrDb) {
+        fs::File file = openHostFile(path);
+        WavFormat format;
+        if (!file || !readWavHeader(file, format) || !format.isImaAdpcm() || format.getFrames() * format.channels !=
+            pcm.samples.size()) {
+            return false;
+        }
+        std::vector<uint8_t> block(format.blockAlign);
+        std::vector<int16_t> decoded(format.blockFrames * format.channels);
+        double signal = 0;
+        double noise = 0;
+        size_t position = 0;
+        while (position < pcm.samples.size()) {
+            size_t blockBytes = file.read(block.data(), block.size());
+            uint32_t frames = imaAdpcmDecodeBlock(block.data(), blockBytes, (uint8_t)format.channels, decoded.data());
+            if (frames == 0) {
+                return false;
+            }
+            for (uint32_t i = 0; i < frames * format.channels && position < pcm.samples.size(); i++, position++) {
+                double value = pcm.samples[position];
+                signal += value * value;
+                noise += (value - decoded[i]) * (value - decoded[i]);
+            }
+        }
+        snrDb = 10 * log10(std::max(signal, 1.0) / std::max(noise, 1.0));
+        return true;
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string outputDirectory;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            outputDirectory = argv[++i];
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "Unknown or incomplete option %s\n", argv[i]);
+            return 2;
+        } else {
+            inputs.push_back(argv[i]);
+        }
+    }
+    if (outputDirectory.empty() || inputs.empty()) {
+        fprintf(stderr, "Usage: adpcm_encoder -o <output directory> <file>...\n");
+        return 2;
+    }
+
+    bool passed = true;
+    uint64_t totalInputBytes = 0;
+    uint64_t totalOutputBytes = 0;
+    printf("  %-24s %8s %10s %10s %8s %8s\n", "file", "s", "PCM bytes", "ADPCM", "ratio", "SNR dB");
+    for (const std::string& input : inputs) {
+        std::string output = outputDirectory + "/" + baseName(input);
+        std::vector<uint8_t> bytes;
+        Pcm pcm;
+        if (!readPcm(input, pcm)) {
+            // Not a 16-bit PCM WAV file: stored as it is
+            bool copied = readFile(input, bytes) && writeFile(output, bytes);
+            printf("  %-24s copied%s\n", baseName(input).c_str(), copied ? "" : "  FAIL");
+            passed = passed && copied;
+            continue;
+        }
+
+        bytes = encodeWav(pcm);
+        double snrDb = 0;
+        bool ok = writeFile(output, bytes) && checkEncoded(output, pcm, snrDb);
+        uint32_t pcmBytes = pcm.samples.size() * sizeof(int16_t);
+        printf("  %-24s %8.2f %10lu %10zu %7.2fx %8.1f%s\n", baseName(input).c_str(),
+            (double)pcm.format.getFrames() / pcm.format.sampleRate, (unsigned long)pcmBytes, bytes.size(),
+            (double)pcmBytes / bytes.size(), snrDb, ok ? "" : "  FAIL");
+        totalInputBytes += pcmBytes;
+        totalOutputBytes += bytes.size();
+        passed = passed && ok;
+    }
+    if (totalOutputBytes > 0) {
+        printf("  %-24s %8s %10llu %10llu %7.2fx\n", "total", "", (unsigned long long)totalInputBytes,
+            (unsigned long long)totalOutputBytes, (double)totalInputBytes / totalOutputBytes);
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,46 @@
+"""
+PlatformIO extra script: stores the sound files in SPIFFS as IMA ADPCM, a quarter of the 16-bit PCM size.
+
+When the file system image is built (pio run -t buildfs or -t uploadfs), the encoder of this directory is built with
+make and converts the files of the data directory to $BUILD_DIR/data, the directory the image is then built from.
+The data directory keeps the 16-bit PCM originals. Only the files changed since the last run are encoded again.
+Needs make and a host C++ compiler (g++).
+"""
+
+import os
+import subprocess
+import sys
+
+Import("env")
+
+FS_TARGETS = {"buildfs", "uploadfs", "uploadfsota"}
+
+
+def encode_data(source_dir, output_dir):
+    encoder_dir = os.path.join(env.subst("$PROJECT_DIR"), "tools", "adpcm_encoder")
+    encoder = os.path.join(encoder_dir, "adpcm_encoder")
+    if subprocess.call(["make", "-s", "-C", encoder_dir]) != 0:
+        sys.exit("encode_data: cannot build the ADPCM encoder")
+
+    os.makedirs(output_dir, exist_ok=True)
+    for name in os.listdir(output_dir):
+        if not os.path.isfile(os.path.join(source_dir, name)):
+            os.remove(os.path.join(output_dir, name))
+
+    # A new encoder encodes every file again
+    stale = []
+    for name in sorted(os.listdir(source_dir)):
+        source = os.path.join(source_dir, name)
+        output = os.path.join(output_dir, name)
+        if os.path.isfile(source) and (not os.path.exists(output) or
+                                       os.path.getmtime(output) < max(os.path.getmtime(source),
+                                                                      os.path.getmtime(encoder))):
+            stale.append(source)
+    if stale and subprocess.call([encoder, "-o", output_dir] + stale) != 0:
+        sys.exit("encode_data: cannot encode the data directory")
+
+
+if FS_TARGETS & set(COMMAND_LINE_TARGETS):
+    output_dir = os.path.join(env.subst("$BUILD_DIR"), "data")
+    encode_data(env.subst("$PROJECT_DATA_DIR"), output_dir)
+    env.Replace(PROJECT_DATA_DIR=output_dir)
@@ -0,0 +1,708 @@
+/**
+ * Linux benchmark and golden output test of the AudioMixer kernel, and spectral tests of the ToneSynth edges.
+ *
+ * The benchmark mixes seconds of audio with 1 to AudioMixer::MAX_VOICES voices of each source kind (mono and
+ * stereo cached samples, tones) and reports the mixing throughput in voice samples per second (one voice
+ * sample is one output sample of one voice, the I2S output needs 88200 per second and voice), and how many times
+ * faster than real time the whole mix runs. Streamed voices mix like the cached ones once their buffer is
+ * read, the file system cost is not part of the kernel and is left out. It then renders blocks of
+ * AudioMixer::MAX_BLOCK_FRAMES frames with the ToneSynth of each waveform and reports the cost per block.
+ *
+ * The spectral tests look for clicks: a discontinuity of the waveform spreads energy over the whole spectrum,
+ * far above the tone. Each test renders a 1 kHz sine around an edge (note start, note end, note change in a
+ * sequence, stop, retune) and measures the strongest component above 3 kHz in a Hann window centred on the
+ * edge, relative to the tone. It must stay below kClickThresholdDb; the same edge without envelope ramps (or
+ * without phase continuity for the retune) is measured too, to show that the test does detect a click.
+ *
+ * The golden test mixes a fixed scene with synthetic samples (overlapping voices, a tone retuned mid-block,
+ * saturation, voice stealing, a refused voice, master gain changes, a stopped voice, a note sequence and a
+ * voice started at an exact frame, in blocks of uneven sizes) and compares it sample by sample with the
+ * reference WAV file. Any change of the mixer output makes it fail: after an intended change, listen to the new
+ * output and update the reference with --write-golden.
+ *
+ * The IMA ADPCM test streams every sound file of the project through the mixer twice, the 16-bit PCM original
+ * and the encoded file the build stores in SPIFFS (made by tools/adpcm_encoder, see the Makefile), and reports
+ * the flash bytes read by each play. The encoded file must decode with a signal to noise ratio of at least
+ * kMinAdpcmSnrDb, and the same file decoded by the SampleCache must mix to the very same output. The benchmark
+ * then reports the decoding cost per second of audio, from memory, without the file reads.
+ *
+ * Usage:
+ *   audio_bench [options]
+ *     --seconds <s>          Audio mixed per benchmark case (default 60)
+ *     --golden <path>        Reference output of the golden test (default golden/mixer.wav)
+ *     --write-golden         Write the reference output instead of comparing with it
+ *     --pcm <dir>            Directory of the 16-bit PCM sound files (default ../../data)
+ *     --adpcm <dir>          Directory of the same files encoded to IMA ADPCM (default build/data)
+ *     --no-bench             Run only the golden, the spectral and the IMA ADPCM tests
+ *
+ * The exit status is 0 when the golden, the spectral and the IMA ADPCM tests pass.
+ */
+
+#include <AudioMixer.hpp>
+#include <SPIFFS.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace {
+    constexpr uint32_t kBenchSampleFrames = AudioMixer::SAMPLE_RATE;    // 1 s samples, looped by restarting
+    constexpr uint32_t kGoldenFrames = 8192;
+    constexpr uint32_t kSpectrumFrames = 2048;          // Window of the spectral tests, 46 ms
+    constexpr uint16_t kTestFrequency = 1000;
+    constexpr float kClickBandHz = 3000.0f;             // Clicks are measured above this frequency
+    constexpr float kClickThresholdDb = -60.0f;
+    constexpr ToneEnvelope kHardGate = {0, 0, TONE_LEVEL_FULL, 0};
+    constexpr float kMinAdpcmSnrDb = 20.0f;             // The square wave beeps are the worst case, about 23 dB
+    constexpr uint32_t kAdpcmBenchBlocks = 16;          // Blocks encoded for the decoder benchmark, looped
+
+    struct Options {
+        float seconds = 60.0f;
+        const char* goldenPath = "golden/mixer.wav";
+        const char* pcmDir = "../../data";
+        const char* adpcmDir = "build/data";
+        bool writeGolden = false;
+        bool bench = true;
+    };
+
+    /**
+     * Sample with integer synthetic content, so the golden output does not depend on the host math library.
+     */
+    struct SyntheticSample {
+        std::vector<int16_t> data;
+        CachedSample sample;
+
+        SyntheticSample(const char* name, uint32_t frames, uint8_t channels, uint32_t period, int16_t amplitude,
+                        bool square) {
+            data.resize(frames * channels);
+            for (uint32_t i = 0; i < frames; i++) {
+                int32_t phase = (int32_t)(i % period);
+                int32_t value = square ? (phase < (int32_t)period / 2 ? amplitude : -amplitude)
+                                       : -amplitude + (int32_t)(2 * amplitude * (int64_t)phase / period);
+                for (uint8_t c = 0; c < channels; c++) {
+                    // The right channel of stereo samples is inverted, to check the channel order
+                    data[i * channels + c] = (int16_t)(c == 0 ? value : -value);
+                }
+            }
+            sample = {name, data.data(), frames, AudioMixer::SAMPLE_RATE, channels};
+        }
+    };
+
+    // -- Benchmark
+
+    enum class BenchSource {
+        MONO_SAMPLE,
+        STEREO_SAMPLE,
+        TONE
+    };
+
+    const char* toneWaveformName(ToneWaveform waveform) {
+        switch (waveform) {
+            case ToneWaveform::SINE:
+                return "sine";
+            case ToneWaveform::TRIANGLE:
+                return "triangle";
+            case ToneWaveform::SQUARE:
+                return "square";
+            case ToneWaveform::SAWTOOTH:
+                return "sawtooth";
+        }
+        return "";
+    }
+
+    const char* benchSourceName(BenchSource source) {
+        switch (source) {
+            case BenchSource::MONO_SAMPLE:
+                return "mono sample";
+            case BenchSource::STEREO_SAMPLE:
+                return "stereo sample";
+            case BenchSource::TONE:
+                return "tone";
+        }
+        return "";
+    }
+
+    void runBenchmark(const Options& options) {
+        SyntheticSample mono("mono", kBenchSampleFrames, 1, 100, 8000, false);
+        SyntheticSample stereo("stereo", kBenchSampleFrames, 2, 100, 8000, false);
+        uint64_t totalFrames = (uint64_t)(options.seconds * AudioMixer::SAMPLE_RATE);
+        int16_t block[AudioMixer::MAX_BLOCK_FRAMES * 2];
+
+        printf("Mixing %.0f s of audio per case, blocks of %lu frames\n", options.seconds,
+            (unsigned long)AudioMixer::MAX_BLOCK_FRAMES);
+        printf("  %-14s %6s %18s %14s %12s\n", "source", "voices", "voice samples/s", "ns/sample", "x real time");
+        for (BenchSource source : {BenchSource::MONO_SAMPLE, BenchSource::STEREO_SAMPLE, BenchSource::TONE}) {
+            for (uint8_t voiceCount = 1; voiceCount <= AudioMixer::MAX_VOICES; voiceCount++) {
+                AudioMixer mixer;
+                AudioVoice voices[AudioMixer::MAX_VOICES] = {};
+
+                auto start = std::chrono::steady_clock::now();
+                for (uint64_t frame = 0; frame < totalFrames; frame += AudioMixer::MAX_BLOCK_FRAMES) {
+                    // Restart the voices that ended, outside of the mix calls they cost little
+                    for (uint8_t v = 0; v < voiceCount; v++) {
+                        if (!mixer.isPlaying(voices[v])) {
+                            uint16_t gain = AUDIO_GAIN_UNITY / AudioMixer::MAX_VOICES;
+                            switch (source) {
+                                case BenchSource::MONO_SAMPLE:
+                                    voices[v] = mixer.playSample(mono.sample, AUDIO_PRIORITY_EFFECT, gain);
+                                    break;
+                                case BenchSource::STEREO_SAMPLE:
+                                    voices[v] = mixer.playSample(stereo.sample, AUDIO_PRIORITY_EFFECT, gain);
+                                    break;
+                                case BenchSource::TONE:
+                                    voices[v] = mixer.playTone(440 + v * 110, kBenchSampleFrames, AUDIO_PRIORITY_EFFECT,
+                                        gain);
+                                    break;
+                            }
+                        }
+                    }
+                    mixer.mix(block, AudioMixer::MAX_BLOCK_FRAMES);
+                }
+                double elapsedS = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+                // Stereo output samples of every voice: the cost of the block overhead is shared by the voices
+                double samples = (double)totalFrames * 2 * voiceCount;
+                printf("  %-14s %6u %18.0f %14.2f %12.0f\n", benchSourceName(source), voiceCount,
+                    samples / elapsedS, elapsedS * 1e9 / samples,
+                    totalFrames / (elapsedS * AudioMixer::SAMPLE_RATE));
+            }
+        }
+
+        // The synthesizer alone, one voice, in sustain with short notes so the envelope stages are crossed too
+        static const ToneNote notes[] = {{440, 300}, {660, 120}, {TONE_REST, 40}, {880, 500}};
+        const ToneEnvelope envelope = {5, 30, TONE_LEVEL_FULL / 2, 20};
+        double blockUs = AudioMixer::MAX_BLOCK_FRAMES * 1e6 / AudioMixer::SAMPLE_RATE;
+        printf("Synthesizing %.0f s per waveform, blocks of %lu frames (%.0f us of audio)\n", options.seconds,
+            (unsigned long)AudioMixer::MAX_BLOCK_FRAMES, blockUs);
+        printf("  %-14s %14s %14s %14s\n", "waveform", "ns/block", "ns/frame", "% of block");
+        for (ToneWaveform waveform : {ToneWaveform::SINE, ToneWaveform::TRIANGLE, ToneWaveform::SQUARE,
+                                      ToneWaveform::SAWTOOTH}) {
+            ToneSynth synth;
+            int32_t accumulator[AudioMixer::MAX_BLOCK_FRAMES * 2] = {};
+            uint64_t blocks = totalFrames / AudioMixer::MAX_BLOCK_FRAMES;
+            int64_t sink = 0;   // Keeps the rendering from being optimized out
+
+            auto start = std::chrono::steady_clock::now();
+            for (uint64_t block = 0; block < blocks; block++) {
+                if (!synth.isPlaying()) {
+                    synth.startSequence(notes, 4, waveform, envelope);
+                }
+                synth.render(accumulator, AudioMixer::MAX_BLOCK_FRAMES, AUDIO_GAIN_UNITY / 2);
+                sink += accumulator[block % (AudioMixer::MAX_BLOCK_FRAMES * 2)];
+            }
+            double elapsedS = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            double blockNs = elapsedS * 1e9 / blocks;
+            printf("  %-14s %14.0f %14.2f %13.3f%%\n", toneWaveformName(waveform), blockNs,
+                blockNs / AudioMixer::MAX_BLOCK_FRAMES, blockNs / 1000 / blockUs * 100);
+            if (sink == INT64_MIN) {
+                printf("unreachable\n");
+            }
+        }
+    }
+
+    // -- Spectral tests
+
+    /**
+     * Measures the strongest spectral component above kClickBandHz, relative to the strongest one overall.
+     * @param samples kSpectrumFrames mono samples, the edge at the centre.
+     * @return The level in dB.
+     */
+    float measureClickDb(const std::vector<int32_t>& samples) {
+        std::vector<double> windowed(kSpectrumFrames);
+        for (uint32_t n = 0; n < kSpectrumFrames; n++) {
+            windowed[n] = samples[n] * (0.5 - 0.5 * cos(2 * M_PI * n / kSpectrumFrames));
+        }
+        std::vector<double> cosTable(kSpectrumFrames);
+        std::vector<double> sinTable(kSpectrumFrames);
+        for (uint32_t n = 0; n < kSpectrumFrames; n++) {
+            cosTable[n] = cos(2 * M_PI * n / kSpectrumFrames);
+            sinTable[n] = sin(2 * M_PI * n / kSpectrumFrames);
+        }
+
+        uint32_t bandBin = (uint32_t)(kClickBandHz * kSpectrumFrames / AudioMixer::SAMPLE_RATE);
+        double peak = 0;
+        double bandPeak = 0;
+        for (uint32_t k = 1; k < kSpectrumFrames / 2; k++) {
+            double re = 0;
+            double im = 0;
+            for (uint32_t n = 0; n < kSpectrumFrames; n++) {
+                uint32_t index = (uint32_t)(((uint64_t)k * n) % kSpectrumFrames);
+                re += windowed[n] * cosTable[index];
+                im -= windowed[n] * sinTable[index];
+            }
+            double magnitude = sqrt(re * re + im * im);
+            peak = std::max(peak, magnitude);
+            if (k >= bandBin) {
+                bandPeak = std::max(bandPeak, magnitude);
+            }
+        }
+        return (float)(20 * log10(std::max(bandPeak, 1e-9) / std::max(peak, 1e-9)));
+    }
+
+    /**
+     * Renders a synthesizer scene and keeps the window centred on a frame.
+     * @param scene Starts the synth and applies the events, called with the synth and the frame of each block
+     *              start (blocks of 64 frames, so the events land inside the window at known offsets).
+     * @param edgeFrame Frame at the centre of the window.
+     * @return kSpectrumFrames mono samples.
+     */
+    template <typename Scene>
+    std::vector<int32_t> renderAround(Scene scene, uint32_t edgeFrame) {
+        constexpr uint32_t kBlock = 64;
+        ToneSynth synth;
+        uint32_t totalFrames = edgeFrame + kSpectrumFrames / 2;
+        std::vector<int32_t> accumulator((totalFrames + kBlock) * 2, 0);
+        for (uint32_t frame = 0; frame < totalFrames; frame += kBlock) {
+            scene(synth, frame);
+            synth.render(accumulator.data() + frame * 2, kBlock, AUDIO_GAIN_UNITY);
+        }
+        std::vector<int32_t> samples(kSpectrumFrames);
+        for (uint32_t n = 0; n < kSpectrumFrames; n++) {
+            int64_t frame = (int64_t)edgeFrame - kSpectrumFrames / 2 + n;
+            samples[n] = frame >= 0 ? accumulator[frame * 2] : 0;
+        }
+        return samples;
+    }
+
+    bool runSpectralTests() {
+        constexpr uint32_t kStart = 2048;               // Frame where the tones of the scenes start
+        const uint32_t noteFrames = ToneSynth::msToFrames(200);
+        static const ToneNote twoNotes[] = {{kTestFrequency, 200}, {1500, 200}};
+
+        // Each scene renders the edge as the synthesizer does, or as a reference without the envelope ramps (or,
+        // for the retune, restarting the tone at the new frequency, i.e. without keeping the phase)
+        struct EdgeTest {
+            const char* name;
+            uint32_t edgeFrame;
+            std::function<void(ToneSynth&, uint32_t, bool)> scene;
+        };
+        const EdgeTest tests[] = {
+            {"note start", kStart, [](ToneSynth& synth, uint32_t frame, bool reference) {
+                if (frame == kStart) {
+                    synth.startTone(kTestFrequency, AudioMixer::SAMPLE_RATE, ToneWaveform::SINE,
+                        reference ? kHardGate : TONE_ENVELOPE_DEFAULT);
+                }
+            }},
+            {"note end", kStart + noteFrames, [noteFrames](ToneSynth& synth, uint32_t frame, bool reference) {
+                if (frame == kStart) {
+                    synth.startTone(kTestFrequency, noteFrames, ToneWaveform::SINE,
+                        reference ? kHardGate : TONE_ENVELOPE_DEFAULT);
+                }
+            }},
+            {"note change", kStart + noteFrames, [](ToneSynth& synth, uint32_t frame, bool reference) {
+                if (frame == kStart) {
+                    synth.startSequence(twoNotes, 2, ToneWaveform::SINE, reference ? kHardGate : TONE_ENVELOPE_DEFAULT);
+                }
+            }},
+            {"stop", kStart + 4096, [](ToneSynth& synth, uint32_t frame, bool reference) {
+                if (frame == kStart) {
+                    synth.startTone(kTestFrequency, AudioMixer::SAMPLE_RATE, ToneWaveform::SINE,
+                        reference ? kHardGate : TONE_ENVELOPE_DEFAULT);
+                }
+                if (frame == kStart + 4096) {
+                    synth.release();
+                }
+            }},
+            {"retune", kStart + 4096, [](ToneSynth& synth, uint32_t frame, bool reference) {
+                if (frame == kStart) {
+                    synth.startTone(kTestFrequency, AudioMixer::SAMPLE_RATE, ToneWaveform::SINE, kHardGate);
+                }
+                if (frame == kStart + 4096) {
+                    if (reference) {
+                        synth.startTone(1200, AudioMixer::SAMPLE_RATE, ToneWaveform::SINE, kHardGate);
+                    } else {
+                        synth.retune(1200, AudioMixer::SAMPLE_RATE);
+                    }
+                }
+            }},
+        };
+
+        bool passed = true;
+        printf("Click tests, strongest component above %.0f Hz around the edge (limit %.0f dB)\n", kClickBandHz,
+            kClickThresholdDb);
+        printf("  %-14s %14s %14s\n", "edge", "synth dB", "reference dB");
+        for (const EdgeTest& test : tests) {
+            auto render = [&test](bool reference) {
+                return renderAround([&test, reference](ToneSynth& synth, uint32_t frame) {
+                    test.scene(synth, frame, reference);
+                }, test.edgeFrame);
+            };
+            float synthDb = measureClickDb(render(false));
+            float referenceDb = measureClickDb(render(true));
+            bool ok = synthDb < kClickThresholdDb;
+            printf("  %-14s %14.1f %14.1f%s\n", test.name, synthDb, referenceDb, ok ? "" : "  FAIL");
+            passed = passed && ok;
+        }
+        return passed;
+    }
+
+    // -- Golden test
+
+    /**
+     * Mixes the golden scene.
+     * @param output Output interleaved stereo samples.
+     * @param stats Output mixer statistics at the end of the scene.
+     */
+    void mixGoldenScene(std::vector<int16_t>& output, AudioMixerStats& stats) {
+        SyntheticSample saw("saw", 3000, 1, 97, 12000, false);
+        SyntheticSample square("square", 2500, 2, 60, 30000, true);
+        SyntheticSample click("click", 400, 1, 20, 20000, true);
+
+        AudioMixer mixer;
+        AudioVoice sawVoice = AUDIO_VOICE_NONE;
+        AudioVoice tone = AUDIO_VOICE_NONE;
+        AudioVoice music = AUDIO_VOICE_NONE;
+
+        // Uneven block sizes, to cross the sample ends and the events at any offset
+        const uint32_t blockSizes[] = {256, 100, 37, 256, 1, 200};
+        output.assign(kGoldenFrames * 2, 0);
+        uint32_t frame = 0;
+        for (uint32_t block = 0; frame < kGoldenFrames; block++) {
+            uint32_t frames = std::min(blockSizes[block % 6], kGoldenFrames - frame);
+
+            // Events, applied at the start of the block holding their frame
+            auto at = [frame, frames](uint32_t eventFrame) {
+                return frame <= eventFrame && eventFrame < frame + frames;
+            };
+            if (at(0)) {
+                sawVoice = mixer.playSample(saw.sample, AUDIO_PRIORITY_EFFECT, AUDIO_GAIN_UNITY / 2);
+            }
+            if (at(600)) {
+                tone = mixer.playTone(1000, 2000, AUDIO_PRIORITY_EFFECT, AUDIO_GAIN_UNITY / 4);
+            }
+            if (at(1200)) {
+                mixer.setTone(tone, 1500, 1500);
+            }
+            if (at(1800)) {
+                // Loud stereo square over the saw and the tone: saturates
+                music = mixer.playSample(square.sample, AUDIO_PRIORITY_MUSIC);
+            }
+            if (at(2400)) {
+                // Two clicks fill the voices, the third one steals the oldest effect (the saw)
+                for (int i = 0; i < 3; i++) {
+                    mixer.playSample(click.sample, AUDIO_PRIORITY_EFFECT, AUDIO_GAIN_UNITY / 8);
+                }
+                // Every voice has a higher priority than this sound: refused
+                mixer.playSample(click.sample, 0);
+            }
+            if (at(3500)) {
+                mixer.setMasterGain(AUDIO_GAIN_UNITY / 3);
+            }
+            if (at(4000)) {
+                mixer.stop(music);
+                mixer.setGain(sawVoice, AUDIO_GAIN_UNITY);   // Already stolen: no effect
+                mixer.playTone(220, 3000, AUDIO_PRIORITY_EFFECT);
+            }
+            if (at(4500)) {
+                // Triangle notes with a rest, crossing the block ends
+                static const ToneNote notes[] = {{660, 10}, {TONE_REST, 5}, {990, 12}};
+                const ToneEnvelope envelope = {2, 3, TONE_LEVEL_FULL / 2, 4};
+                mixer.playSequence(notes, 3, ToneWaveform::TRIANGLE, envelope, AUDIO_PRIORITY_EFFECT,
+                    AUDIO_GAIN_UNITY / 2);
+            }
+            if (at(6000)) {
+                mixer.setMasterGain(AUDIO_GAIN_UNITY);
+                mixer.playSample(saw.sample, AUDIO_PRIORITY_EFFECT, AUDIO_GAIN_UNITY);
+            }
+            if (at(6800)) {
+                // Starts at an exact frame of a later block, like a scheduled cue
+                AudioVoice cue = mixer.playSample(click.sample, AUDIO_PRIORITY_EFFECT, AUDIO_GAIN_UNITY / 2);
+                mixer.delayStart(cue, 7000 - frame);
+            }
+
+            mixer.mix(output.data() + frame * 2, frames);
+            frame += frames;
+        }
+        stats = mixer.getStats();
+    }
+
+    void writeLe32(FILE* file, uint32_t value) {
+        uint8_t bytes[4] = {(uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24)};
+        fwrite(bytes, 1, 4, file);
+    }
+
+    void writeLe16(FILE* file, uint16_t value) {
+        uint8_t bytes[2] = {(uint8_t)value, (uint8_t)(value >> 8)};
+        fwrite(bytes, 1, 2, file);
+    }
+
+    bool writeWav(const char* path, const std::vector<int16_t>& samples) {
+        FILE* file = fopen(path, "wb");
+        if (file == nullptr) {
+            return false;
+        }
+        uint32_t dataBytes = samples.size() * sizeof(int16_t);
+        fwrite("RIFF", 1, 4, file);
+        writeLe32(file, 36 + dataBytes);
+        fwrite("WAVEfmt ", 1, 8, file);
+        writeLe32(file, 16);
+        writeLe16(file, WAV_FORMAT_PCM);
+        writeLe16(file, 2);
+        writeLe32(file, AudioMixer::SAMPLE_RATE);
+        writeLe32(file, AudioMixer::SAMPLE_RATE * 4);
+        writeLe16(file, 4);
+        writeLe16(file, 16);
+        fwrite("data", 1, 4, file);
+        writeLe32(file, dataBytes);
+        for (int16_t sample : samples) {
+            writeLe16(file, (uint16_t)sample);
+        }
+        return fclose(file) == 0;
+    }
+
+    bool readWav(const char* path, std::vector<int16_t>& samples) {
+        FILE* file = fopen(path, "rb");
+        if (file == nullptr) {
+            return false;
+        }
+        uint8_t header[44];
+        bool ok = fread(header, 1, sizeof(header), file) == sizeof(header) && memcmp(header, "RIFF", 4) == 0 &&
+                  memcmp(header + 36, "data", 4) == 0;
+        if (ok) {
+            uint32_t dataBytes = header[40] | (header[41] << 8) | (header[42] << 16) | ((uint32_t)header[43] << 24);
+            std::vector<uint8_t> bytes(dataBytes);
+            ok = fread(bytes.data(), 1, dataBytes, file) == dataBytes;
+            samples.resize(dataBytes / 2);
+            for (size_t i = 0; i < samples.size(); i++) {
+                samples[i] = (int16_t)(bytes[i * 2] | (bytes[i * 2 + 1] << 8));
+            }
+        }
+        fclose(file);
+        return ok;
+    }
+
+    bool runGoldenTest(const Options& options) {
+        std::vector<int16_t> output;
+        AudioMixerStats stats;
+        mixGoldenScene(output, stats);
+        printf("Golden scene: %u frames, %lu voices started, %lu stolen, %lu refused, %lu samples clipped\n",
+            kGoldenFrames, (unsigned long)stats.voicesStarted, (unsigned long)stats.voicesStolen,
+            (unsigned long)stats.voicesRefused, (unsigned long)stats.clippedSamples);
+
+        // The scene must exercise the paths it was written for, whatever the reference says
+        if (stats.voicesStolen == 0 || stats.voicesRefused == 0 || stats.clippedSamples == 0 ||
+            stats.maxActiveVoices != AudioMixer::MAX_VOICES) {
+            printf("FAIL: the scene does not steal, refuse, clip or fill every voice\n");
+            return false;
+        }
+
+        if (options.writeGolden) {
+            if (!writeWav(options.goldenPath, output)) {
+                printf("FAIL: cannot write %s\n", options.goldenPath);
+                return false;
+            }
+            printf("Reference written to %s\n", options.goldenPath);
+            return true;
+        }
+
+        std::vector<int16_t> reference;
+        if (!readWav(options.goldenPath, reference)) {
+            printf("FAIL: cannot read the reference %s\n", options.goldenPath);
+            return false;
+        }
+        if (reference.size() != output.size()) {
+            printf("FAIL: %zu frames in the reference, %zu mixed\n", reference.size() / 2, output.size() / 2);
+            return false;
+        }
+        size_t mismatches = 0;
+        size_t firstMismatch = 0;
+        int maxDifference = 0;
+        for (size_t i = 0; i < output.size(); i++) {
+            int difference = abs(output[i] - reference[i]);
+            if (difference > 0) {
+                if (mismatches++ == 0) {
+                    firstMismatch = i;
+                }
+                maxDifference = std::max(maxDifference, difference);
+            }
+        }
+        if (mismatches > 0) {
+            printf("FAIL: %zu samples differ from the reference, first at frame %zu (%s), largest difference %d\n",
+                mismatches, firstMismatch / 2, firstMismatch % 2 == 0 ? "left" : "right", maxDifference);
+            return false;
+        }
+        printf("Output identical to %s\n", options.goldenPath);
+        return true;
+    }
+
+    // -- IMA ADPCM
+
+    std::vector<std::string> listWavFiles(fs::FS& fs) {
+        std::vector<std::string> paths;
+        fs::File root = fs.open("/");
+        for (fs::File file = root.openNextFile(); file; file = root.openNextFile()) {
+            size_t length = strlen(file.name());
+            if (!file.isDirectory() && length > 4 && strcasecmp(file.name() + length - 4, ".wav") == 0) {
+                paths.push_back(file.path());
+            }
+        }
+        return paths;
+    }
+
+    /**
+     * Plays a sound to its end on a mixer voice.
+     * @param start Starts the voice on the mixer.
+     * @param stats Output mixer statistics, with the bytes read from the file.
+     * @return The mixed interleaved stereo samples, up to the end of the block where the voice ends.
+     */
+    template <typename Start>
+    std::vector<int16_t> mixToEnd(Start start, AudioMixerStats& stats) {
+        AudioMixer mixer;
+        AudioVoice voice = start(mixer);
+        std::vector<int16_t> output;
+        int16_t block[AudioMixer::MAX_BLOCK_FRAMES * 2];
+        while (mixer.isPlaying(voice)) {
+            mixer.mix(block, AudioMixer::MAX_BLOCK_FRAMES);
+            output.insert(output.end(), block, block + AudioMixer::MAX_BLOCK_FRAMES * 2);
+        }
+        stats = mixer.getStats();
+        return output;
+    }
+
+    bool runAdpcmTests(const Options& options) {
+        fs::SPIFFSFS pcmFs;
+        fs::SPIFFSFS adpcmFs;
+        pcmFs.setHostDirectory(options.pcmDir);
+        adpcmFs.setHostDirectory(options.adpcmDir);
+        if (!pcmFs.begin() || !adpcmFs.begin()) {
+            printf("FAIL: no %s or %s directory (\"make\" encodes the sound files)\n", options.pcmDir,
+                options.adpcmDir);
+            return false;
+        }
+
+        bool passed = true;
+        uint64_t totalPcmBytes = 0;
+        uint64_t totalAdpcmBytes = 0;
+        printf("IMA ADPCM sound files, flash read by a streamed play (limit %.0f dB SNR)\n", kMinAdpcmSnrDb);
+        printf("  %-24s %8s %12s %12s %8s %10s\n", "file", "s", "PCM bytes", "ADPCM bytes", "SNR dB", "cached");
+        std::vector<std::string> paths = listWavFiles(pcmFs);
+        for (const std::string& path : paths) {
+            AudioMixerStats pcmStats;
+            AudioMixerStats adpcmStats;
+            AudioMixerStats cachedStats;
+            std::vector<int16_t> pcm = mixToEnd([&](AudioMixer& mixer) {
+                return mixer.playStream(pcmFs, path.c_str(), AUDIO_PRIORITY_EFFECT);
+            }, pcmStats);
+            std::vector<int16_t> adpcm = mixToEnd([&](AudioMixer& mixer) {
+                return mixer.playStream(adpcmFs, path.c_str(), AUDIO_PRIORITY_EFFECT);
+            }, adpcmStats);
+
+            // The cache of a single file, its samples are not freed: the cache lives as long as the firmware
+            SampleCache cache;
+            bool cached = cache.load(adpcmFs, path.c_str(), UINT32_MAX);
+            std::vector<int16_t> fromCache = cached ? mixToEnd([&](AudioMixer& mixer) {
+                return mixer.playSample(*cache.find(path.c_str()), AUDIO_PRIORITY_EFFECT);
+            }, cachedStats) : std::vector<int16_t>();
+
+            double signal = 0;
+            double noise = 0;
+            for (size_t i = 0; i < std::min(pcm.size(), adpcm.size()); i++) {
+                signal += (double)pcm[i] * pcm[i];
+                noise += (double)(pcm[i] - adpcm[i]) * (pcm[i] - adpcm[i]);
+            }
+            double snrDb = 10 * log10(std::max(signal, 1.0) / std::max(noise, 1.0));
+            bool identical = cached && fromCache == adpcm;
+            bool ok = pcmStats.streamErrors == 0 && adpcmStats.streamErrors == 0 && pcm.size() == adpcm.size() &&
+                      identical && snrDb >= kMinAdpcmSnrDb;
+            printf("  %-24s %8.2f %12llu %12llu %8.1f %10s%s\n", path.c_str() + 1,
+                (double)pcmStats.framesMixed / AudioMixer::SAMPLE_RATE, (unsigned long long)pcmStats.streamBytesRead,
+                (unsigned long long)adpcmStats.streamBytesRead, snrDb, identical ? "identical" : "differs",
+                ok ? "" : "  FAIL");
+            totalPcmBytes += pcmStats.streamBytesRead;
+            totalAdpcmBytes += adpcmStats.streamBytesRead;
+            passed = passed && ok;
+        }
+        if (paths.empty()) {
+            printf("FAIL: no WAV file in %s\n", options.pcmDir);
+            return false;
+        }
+        printf("  %-24s %8s %12llu %12llu  (%.2fx less)\n", "total", "", (unsigned long long)totalPcmBytes,
+            (unsigned long long)totalAdpcmBytes, (double)totalPcmBytes / std::max<uint64_t>(totalAdpcmBytes, 1));
+        return passed;
+    }
+
+    void runAdpcmBenchmark(const Options& options) {
+        double seconds = options.seconds;
+        printf("Decoding %.0f s of IMA ADPCM audio from memory, blocks of 256 bytes per channel\n", seconds);
+        printf("  %-14s %14s %14s %18s %12s\n", "channels", "ns/block", "ns/frame", "us per s of audio",
+            "x real time");
+        for (uint8_t channels = 1; channels <= 2; channels++) {
+            uint32_t blockBytes = 256 * channels;
+            uint32_t blockFrames = imaAdpcmBlockFrames(blockBytes, channels);
+            SyntheticSample source("source", kAdpcmBenchBlocks * blockFrames, channels, 100, 8000, false);
+            std::vector<uint8_t> blocks(kAdpcmBenchBlocks * blockBytes);
+            for (uint32_t block = 0; block < kAdpcmBenchBlocks; block++) {
+                imaAdpcmEncodeBlock(source.data.data() + block * blockFrames * channels, blockFrames, channels,
+                    blocks.data() + block * blockBytes, blockBytes);
+            }
+
+            std::vector<int16_t> decoded(blockFrames * channels);
+            uint64_t totalBlocks = (uint64_t)(seconds * AudioMixer::SAMPLE_RATE / blockFrames);
+            int64_t sink = 0;   // Keeps the decoding from being optimized out
+            auto start = std::chrono::steady_clock::now();
+            for (uint64_t block = 0; block < totalBlocks; block++) {
+                imaAdpcmDecodeBlock(blocks.data() + (block % kAdpcmBenchBlocks) * blockBytes, blockBytes, channels,
+                    decoded.data());
+                sink += decoded[block % decoded.size()];
+            }
+            double elapsedS = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            double audioS = (double)totalBlocks * blockFrames / AudioMixer::SAMPLE_RATE;
+            printf("  %-14s %14.0f %14.2f %18.1f %12.0f\n", channels == 1 ? "mono" : "stereo",
+                elapsedS * 1e9 / totalBlocks, elapsedS * 1e9 / (totalBlocks * blockFrames), elapsedS * 1e6 / audioS,
+                audioS / elapsedS);
+            if (sink == INT64_MIN) {
+                printf("unreachable\n");
+            }
+        }
+    }
+
+    bool parseOptions(int argc, char** argv, Options& options) {
+        for (int i = 1; i < argc; i++) {
+            const char* arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (strcmp(arg, "--seconds") == 0 && hasValue) {
+                options.seconds = atof(argv[++i]);
+            } else if (strcmp(arg, "--golden") == 0 && hasValue) {
+                options.goldenPath = argv[++i];
+            } else if (strcmp(arg, "--pcm") == 0 && hasValue) {
+                options.pcmDir = argv[++i];
+            } else if (strcmp(arg, "--adpcm") == 0 && hasValue) {
+                options.adpcmDir = argv[++i];
+            } else if (strcmp(arg, "--write-golden") == 0) {
+                options.writeGolden = true;
+            } else if (strcmp(arg, "--no-bench") == 0) {
+                options.bench = false;
+            } else {
+                fprintf(stderr, "Unknown or incomplete option %s\n", arg);
+                return false;
+            }
+        }
+        return options.seconds > 0;
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        return 2;
+    }
+
+    bool passed = runGoldenTest(options);
+    passed = runSpectralTests() && passed;
+    passed = runAdpcmTests(options) && passed;
+    if (options.bench) {
+        runBenchmark(options);
+        runAdpcmBenchmark(options);
+    }
+    printf("%s\n", passed ? "OK" : "FAILED");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,271 @@
+/**
+ * Linux simulator of the boot servo calibration. It runs the firmware CalibrationSolver against a configurable
+ * servo/table model with random starting errors and compares it with the proportional loop used as fallback,
+ * reporting how many measurements and how much time each needs to level the table.
+ *
+ * Usage:
+ *   calibration_sim [options]
+ *     --trials <n>            Number of random starting points (default 1000)
+ *     --seed <n>              Random seed (default 1)
+ *     --gain <deg/us>         Table tilt per microsecond of pulse width on both axes (default 0.05)
+ *     --gain-ratio <r>        Y gain as a fraction of the X gain (default 1.0)
+ *     --coupling <r>          Tilt of each axis per microsecond on the other axis, as a fraction of the gain (default 0.1)
+ *     --curvature <deg/us^2>  Quadratic term of the tilt response, models the linkage geometry (default 0.00002)
+ *     --backlash <us>         Dead zone of the servo gear train when reversing (default 4)
+ *     --noise <deg>           Standard deviation of a single tilt measurement (default 0.05)
+ *     --max-start-error <us>  Largest distance of the starting pulse width from the level one (default 300)
+ *     --tolerance <deg>       Accepted tilt error (default 0.5)
+ *     --verbose               Print every step of the first trial
+ *
+ * The proportional loop mirrors Game::runProportionalCalibration: a 0.5 gain on the tilt error applied through
+ * HardwareServo::changeAngle (5.56 us per servo degree), 200 ms per step and 5 consecutive good readings. The
+ * solver takes a 300 ms settle per step; each measurement adds the 100 ms IMU averaging window.
+ */
+
+#include <CalibrationSolver.hpp>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace {
+    constexpr float kMeasureWindowMs = 100.0f;
+    constexpr float kSolverSettleMs = 300.0f;
+    constexpr float kProportionalStepMs = 200.0f;
+    constexpr float kProportionalGain = 0.5f;
+    constexpr float kServoUsPerDeg = 2000.0f / 360.0f;
+    constexpr int kMaxProportionalSteps = 500;
+    constexpr float kMinPulseUs = 500.0f;
+    constexpr float kMaxPulseUs = 2500.0f;
+
+    struct SimConfig {
+        int trials = 1000;
+        unsigned seed = 1;
+        float gain = 0.05f;
+        float gainRatio = 1.0f;
+        float coupling = 0.1f;
+        float curvature = 0.00002f;
+        float backlashUs = 4.0f;
+        float noiseDeg = 0.05f;
+        float maxStartErrorUs = 300.0f;
+        float toleranceDeg = 0.5f;
+        bool verbose = false;
+    };
+
+    /**
+     * Servo and table model: each servo horn follows the commanded pulse width through a backlash dead zone, and
+     * the table tilt is a mildly non-linear, cross-coupled function of the horn positions.
+     */
+    class TableModel {
+    public:
+        TableModel(const SimConfig& config, std::mt19937& rng, const float levelPulseUs[2], const float startPulseUs[2])
+            : config(config), rng(rng), noise(0.0f, config.noiseDeg) {
+            for (int i = 0; i < 2; i++) {
+                level[i] = levelPulseUs[i];
+                horn[i] = startPulseUs[i];
+            }
+            gain[0][0] = config.gain;
+            gain[1][1] = config.gain * config.gainRatio;
+            gain[0][1] = config.gain * config.coupling;
+            gain[1][0] = config.gain * config.gainRatio * config.coupling;
+        }
+
+        void command(float xPulseUs, float yPulseUs) {
+            const float pulse[2] = {xPulseUs, yPulseUs};
+            const float halfBacklash = config.backlashUs / 2.0f;
+            for (int i = 0; i < 2; i++) {
+                if (pulse[i] > horn[i] + halfBacklash) {
+                    horn[i] = pulse[i] - halfBacklash;
+                } else if (pulse[i] < horn[i] - halfBacklash) {
+                    horn[i] = pulse[i] + halfBacklash;
+                }
+            }
+        }
+
+        void measure(float& xTiltDeg, float& yTiltDeg) {
+            float offset[2] = {horn[0] - level[0], horn[1] - level[1]};
+            float tilt[2];
+            for (int i = 0; i < 2; i++) {
+                tilt[i] = gain[i][0] * offset[0] + gain[i][1] * offset[1] + config.curvature * offset[i] * offset[i];
+                tilt[i] += noise(rng);
+            }
+            xTiltDeg = tilt[0];
+            yTiltDeg = tilt[1];
+        }
+
+        float levelError(int axis, float pulseUs) const {
+            return pulseUs - level[axis];
+        }
+
+    private:
+        const SimConfig& config;
+        std::mt19937& rng;
+        std::normal_distribution<float> noise;
+        float level[2];
+        float horn[2];
+        float gain[2][2] = {};
+    };
+
+    struct TrialResult {
+        bool converged;
+        int measurements;
+        float timeMs;
+        float residualUs;
+    };
+
+    TrialResult runSolver(const SimConfig& config, TableModel& table, const float startPulseUs[2], bool verbose) {
+        const float target[2] = {0.0f, 0.0f};
+        CalibrationSolver solver;
+        solver.begin(startPulseUs, target, config.toleranceDeg, kMinPulseUs, kMaxPulseUs);
+
+        TrialResult result = {false, 0, 1000.0f, 0.0f};
+        CalibrationSolver::Status status = CalibrationSolver::Status::RUNNING;
+        uint16_t pulse[2] = {0, 0};
+        while (status == CalibrationSolver::Status::RUNNING) {
+            solver.getNextPulses(pulse[0], pulse[1]);
+            if (result.measurements > 0) {
+                table.command(pulse[0], pulse[1]);
+                result.timeMs += kSolverSettleMs;
+            }
+            float tilt[2];
+            table.measure(tilt[0], tilt[1]);
+            result.timeMs += kMeasureWindowMs;
+            result.measurements++;
+            if (verbose) {
+                printf("  solver step %2d: pulse %4u %4u us, tilt %7.2f %7.2f deg\n",
+                       result.measurements, pulse[0], pulse[1], tilt[0], tilt[1]);
+            }
+            status = solver.addMeasurement(tilt[0], tilt[1]);
+        }
+
+        result.converged = status == CalibrationSolver::Status::CONVERGED;
+        result.residualUs = std::max(fabsf(table.levelError(0, pulse[0])), fabsf(table.levelError(1, pulse[1])));
+        return result;
+    }
+
+    TrialResult runProportional(const SimConfig& config, TableModel& table, const float startPulseUs[2], bool verbose) {
+        TrialResult result = {false, 0, 1000.0f, 0.0f};
+        float pulse[2] = {startPulseUs[0], startPulseUs[1]};
+        int okCount[2] = {0, 0};
+        while (result.measurements < kMaxProportionalSteps) {
+            float tilt[2];
+            table.measure(tilt[0], tilt[1]);
+            result.timeMs += kMeasureWindowMs + kProportionalStepMs;
+            result.measurements++;
+            if (verbose) {
+                printf("  proportional step %3d: pulse %7.1f %7.1f us, tilt %7.2f %7.2f deg\n",
+                       result.measurements, pulse[0], pulse[1], tilt[0], tilt[1]);
+            }
+            for (int i = 0; i < 2; i++) {
+                float error = -tilt[i];
+                if (fabsf(error) < config.toleranceDeg) {
+                    okCount[i]++;
+                } else {
+                    okCount[i] = 0;
+                    pulse[i] = roundf(pulse[i] + kProportionalGain * error * kServoUsPerDeg);
+                }
+            }
+            table.command(pulse[0], pulse[1]);
+            if (okCount[0] >= 5 && okCount[1] >= 5) {
+                result.converged = true;
+                break;
+            }
+        }
+        result.residualUs = std::max(fabsf(table.levelError(0, pulse[0])), fabsf(table.levelError(1, pulse[1])));
+        return result;
+    }
+
+    void printSummary(const char* name, std::vector<TrialResult>& results) {
+        int converged = 0;
+        float sumMeasurements = 0.0f;
+        float sumTimeMs = 0.0f;
+        float maxResidualUs = 0.0f;
+        std::vector<float> times;
+        int maxMeasurements = 0;
+        for (const TrialResult& result : results) {
+            if (result.converged) {
+                converged++;
+                sumMeasurements += result.measurements;
+                sumTimeMs += result.timeMs;
+                times.push_back(result.timeMs);
+                maxMeasurements = std::max(maxMeasurements, result.measurements);
+                maxResidualUs = std::max(maxResidualUs, result.residualUs);
+            }
+        }
+        std::sort(times.begin(), times.end());
+        float p95 = times.empty() ? 0.0f : times[std::min(times.size() - 1, times.size() * 95 / 100)];
+        float n = converged > 0 ? converged : 1;
+        printf("%-13s converged %d/%zu, measurements mean %.1f max %d, time mean %.0f ms p95 %.0f ms, "
+               "max level error %.1f us\n",
+               name, converged, results.size(), sumMeasurements / n, maxMeasurements, sumTimeMs / n, p95, maxResidualUs);
+    }
+
+    bool parseArgs(int argc, char** argv, SimConfig& config) {
+        for (int i = 1; i < argc; i++) {
+            const char* arg = argv[i];
+            if (strcmp(arg, "--verbose") == 0) {
+                config.verbose = true;
+                continue;
+            }
+            if (i + 1 >= argc) {
+                return false;
+            }
+            const char* value = argv[++i];
+            if (strcmp(arg, "--trials") == 0) config.trials = atoi(value);
+            else if (strcmp(arg, "--seed") == 0) config.seed = strtoul(value, nullptr, 10);
+            else if (strcmp(arg, "--gain") == 0) config.gain = atof(value);
+            else if (strcmp(arg, "--gain-ratio") == 0) config.gainRatio = atof(value);
+            else if (strcmp(arg, "--coupling") == 0) config.coupling = atof(value);
+            else if (strcmp(arg, "--curvature") == 0) config.curvature = atof(value);
+            else if (strcmp(arg, "--backlash") == 0) config.backlashUs = atof(value);
+            else if (strcmp(arg, "--noise") == 0) config.noiseDeg = atof(value);
+            else if (strcmp(arg, "--max-start-error") == 0) config.maxStartErrorUs = atof(value);
+            else if (strcmp(arg, "--tolerance") == 0) config.toleranceDeg = atof(value);
+            else return false;
+        }
+        return config.trials > 0;
+    }
+}
+
+int main(int argc, char** argv) {
+    SimConfig config;
+    if (!parseArgs(argc, argv, config)) {
+        fprintf(stderr, "Usage: %s [--trials n] [--seed n] [--gain deg/us] [--gain-ratio r] [--coupling r] "
+                        "[--curvature deg/us^2] [--backlash us] [--noise deg] [--max-start-error us] "
+                        "[--tolerance deg] [--verbose]\n", argv[0]);
+        return 2;
+    }
+
+    std::mt19937 rng(config.seed);
+    std::uniform_real_distribution<float> levelDist(1400.0f, 1600.0f);
+    std::uniform_real_distribution<float> startDist(-config.maxStartErrorUs, config.maxStartErrorUs);
+    std::vector<TrialResult> solverResults;
+    std::vector<TrialResult> proportionalResults;
+
+    for (int trial = 0; trial < config.trials; trial++) {
+        const float level[2] = {levelDist(rng), levelDist(rng)};
+        const float start[2] = {roundf(level[0] + startDist(rng)), roundf(level[1] + startDist(rng))};
+        bool verbose = config.verbose && trial == 0;
+        if (verbose) {
+            printf("Trial 0: level %.1f %.1f us, start %.0f %.0f us\n", level[0], level[1], start[0], start[1]);
+        }
+
+        TableModel solverTable(config, rng, level, start);
+        solverResults.push_back(runSolver(config, solverTable, start, verbose));
+        TableModel proportionalTable(config, rng, level, start);
+        proportionalResults.push_back(runProportional(config, proportionalTable, start, verbose));
+    }
+
+    printSummary("solver", solverResults);
+    printSummary("proportional", proportionalResults);
+    int solverFailures = 0;
+    for (const TrialResult& result : solverResults) {
+        solverFailures += result.converged ? 0 : 1;
+    }
+    return solverFailures == 0 ? 0 : 1;
+}
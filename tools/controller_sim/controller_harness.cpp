@@ -0,0 +1,583 @@
+/**
+ * Linux harness for the remote controller link. It builds the firmware SerialComm, SerialCommandReader and
+ * Controller against a HardwareSerial backed by a pseudo-terminal (or a real tty) so that the link can be
+ * exercised without the board, with traces replayed by replay_trace.py or with the real remote controller.
+ *
+ * Usage:
+ *   controller_harness run [--device <tty>] [--record <trace>] [--duration <s>]
+ *       Runs the Controller task. Without --device a pty is created and its path is printed: pass it to
+ *       replay_trace.py. Prints the controller status every second, and at the end the worst-case and
+ *       percentile latency from line arrival to Controller processing plus the link telemetry.
+ *       --record saves every received line with its arrival time in the trace format.
+ *   controller_harness bench <trace> [--repeat <n>]
+ *       Measures the parser throughput (SerialComm + SerialCommandReader) on the lines of a trace.
+ *   controller_harness sim [--seed <n>]
+ *       Runs the Controller on the virtual clock against the simulated remote controller of firmware_sim. Checks
+ *       the adaptive update rate on a lossy link (the loss estimate, the backoff and the rate switches between
+ *       the HMI modes), then compares the tracking error of the sample reconstruction modes. Exits with a
+ *       non-zero status on failure.
+ *
+ * Trace format: one "<time ms> <line>" per line, lines starting with '#' are comments.
+ */
+
+#include <Arduino.h>
+#include <SerialComm.hpp>
+#include <SerialCommandReader.hpp>
+#include <Controller.hpp>
+#include <HostKernel.h>
+#include "SimulatedController.hpp"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace {
+    std::atomic<bool> stopRequested(false);
+
+    ControllerConfig harnessControllerConfig() {
+        ControllerConfig config {
+            .maxAngle = 1.0f,
+            .updateRateMs = 100,
+            .reconstructionMode = ControllerReconstructionMode::EXTRAPOLATE,
+            .maxExtrapolationMs = 100,
+            .adaptiveUpdateRate = false,
+            .minUpdateRateMs = 50,
+            .maxUpdateRateMs = 200
+        };
+        return config;
+    }
+
+    int openPty(std::string& slavePath) {
+        int master = posix_openpt(O_RDWR | O_NOCTTY);
+        if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+            return -1;
+        }
+        slavePath = ptsname(master);
+
+        // Raw mode on the slave side so that the replayed bytes reach the harness untouched
+        int slave = open(slavePath.c_str(), O_RDWR | O_NOCTTY);
+        if (slave >= 0) {
+            struct termios tio;
+            tcgetattr(slave, &tio);
+            cfmakeraw(&tio);
+            tcsetattr(slave, TCSANOW, &tio);
+            close(slave);
+        }
+        return master;
+    }
+
+    int openDevice(const char* path) {
+        int fd = open(path, O_RDWR | O_NOCTTY);
+        if (fd < 0) {
+            return -1;
+        }
+        struct termios tio;
+        tcgetattr(fd, &tio);
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, B115200);
+        cfsetospeed(&tio, B115200);
+        tcsetattr(fd, TCSANOW, &tio);
+        return fd;
+    }
+
+    // Lossy link simulation: in game, attract mode, in game again
+    constexpr uint32_t kSimPollMs = 10;                 // GameTask period, the rate getStatus is called at
+    constexpr uint32_t kLossyLinkAttractStartMs = 20130;
+    constexpr uint32_t kLossyLinkAttractEndMs = 35110;
+    constexpr uint32_t kLossyLinkDurationMs = 60000;
+    constexpr float kLossEstimateTolerance = 0.05f;     // Largest loss estimate on a link without losses
+
+    // Tracking error simulation: the stick sweeps a sine, the game reads it every kSimPollMs
+    constexpr uint32_t kTrackingDurationMs = 30000;
+    constexpr uint16_t kTrackingUpdateRateMs = 100;
+    constexpr float kTrackingAmplitude = 0.9f;
+    constexpr float kTrackingPeriodMs = 2000.0f;
+
+    ControllerConfig simControllerConfig() {
+        ControllerConfig config {
+            .maxAngle = 1.0f,
+            .updateRateMs = 50,
+            .reconstructionMode = ControllerReconstructionMode::HOLD,
+            .maxExtrapolationMs = 100,
+            .adaptiveUpdateRate = true,
+            .minUpdateRateMs = 20,
+            .maxUpdateRateMs = 200
+        };
+        return config;
+    }
+
+    /**
+     * Runs a simulation on a thread of its own with a HostKernel, so it runs on the virtual clock.
+     * @param body The simulation, run as the main context of the kernel.
+     */
+    void runSimulation(const std::function<void()>& body) {
+        std::thread thread([&body]() {
+            HostKernel kernel;
+            body();
+        });
+        thread.join();
+    }
+
+    /**
+     * Connects a Controller and its update task to a simulated remote controller on a port of their own.
+     */
+    struct SimulatedLink {
+        HardwareSerial port;
+        SerialComm serialComm;
+        Controller controller;
+        SimulatedController remote;
+
+        SimulatedLink(uint32_t seed) : serialComm(port), controller(serialComm), remote(port, seed) {}
+
+        /**
+         * Starts the remote and the Controller.
+         * @param config Controller configuration.
+         * @param source Source of the remote controller state.
+         * @return true if the Controller established the communication.
+         */
+        bool begin(const ControllerConfig& config, SimulatedController::InputSource source) {
+            remote.begin(source);
+            if (!controller.begin(config)) {
+                return false;
+            }
+            xTaskCreate([](void* param) { static_cast<Controller*>(param)->update(); },
+                        "ControllerTask", 4096, &controller, 2, nullptr);
+            return true;
+        }
+    };
+
+    void slowSweep(uint32_t nowMs, uint8_t hmiMode, float& x, float& y, bool& button) {
+        x = 0.8f * sinf(2.0f * static_cast<float>(PI) * nowMs / 4000.0f);
+        y = 0.8f * cosf(2.0f * static_cast<float>(PI) * nowMs / 4000.0f);
+        button = false;
+    }
+
+    struct LossyLinkResult {
+        bool started;
+        float meanEstimatedLoss;    // Loss estimate averaged over the run
+        float maxEstimatedLoss;
+        uint16_t attractRateMs;     // Update rate at the end of the attract mode phase
+        uint16_t inGameRateMs;      // Update rate at the end of the run, in game
+        uint32_t rateChanges;
+        uint32_t staleInGame;       // getStatus calls in game that found the link stale
+        uint32_t framesSent;
+        uint32_t framesLost;
+    };
+
+    LossyLinkResult simulateLossyLink(float lossRatio, bool sequence, uint32_t seed) {
+        LossyLinkResult result = {};
+        runSimulation([&]() {
+            SimulatedLink link(seed);
+            link.remote.setLossRatio(lossRatio);
+            link.remote.setSendSequence(sequence);
+            Controller& controller = link.controller;
+            controller.setHMIMode(SerialComm::ControllerHMIMode::IN_GAME);
+            if (!link.begin(simControllerConfig(), slowSweep)) {
+                return;
+            }
+            result.started = true;
+            controller.resetTelemetry();
+
+            double lossSum = 0.0;
+            uint32_t polls = 0;
+            for (uint32_t t = 0; t < kLossyLinkDurationMs; t += kSimPollMs) {
+                if (t == kLossyLinkAttractStartMs) {
+                    controller.setHMIMode(SerialComm::ControllerHMIMode::NO_GAME);
+                } else if (t == kLossyLinkAttractEndMs) {
+                    result.attractRateMs = controller.getUpdateRate();
+                    controller.setHMIMode(SerialComm::ControllerHMIMode::IN_GAME);
+                }
+                delay(kSimPollMs);
+
+                float x, y;
+                bool button;
+                controller.getStatus(x, y, button);
+                float loss = controller.getLossRatio();
+                lossSum += loss;
+                polls++;
+                result.maxEstimatedLoss = max(result.maxEstimatedLoss, loss);
+            }
+            result.meanEstimatedLoss = static_cast<float>(lossSum / polls);
+            result.inGameRateMs = controller.getUpdateRate();
+            result.staleInGame = controller.getTelemetry().staleStatusInGame;
+            result.rateChanges = link.remote.getRateChanges();
+            result.framesSent = link.remote.getFramesSent();
+            result.framesLost = link.remote.getFramesLost();
+        });
+        return result;
+    }
+
+    void trackingSweep(uint32_t nowMs, uint8_t hmiMode, float& x, float& y, bool& button) {
+        x = kTrackingAmplitude * sinf(2.0f * static_cast<float>(PI) * nowMs / kTrackingPeriodMs);
+        y = kTrackingAmplitude * cosf(2.0f * static_cast<float>(PI) * nowMs / kTrackingPeriodMs);
+        button = false;
+    }
+
+    struct TrackingResult {
+        bool started;
+        float rmsError;     // Distance between the reconstructed and the actual stick position
+        float maxError;
+        float maxStep;      // Largest change of the reconstructed position between two reads
+        float maxAbs;       // Largest reconstructed coordinate, to check the clamping
+    };
+
+    TrackingResult simulateTracking(ControllerReconstructionMode mode, float lossRatio, uint32_t seed) {
+        TrackingResult result = {};
+        runSimulation([&]() {
+            ControllerConfig config = simControllerConfig();
+            config.updateRateMs = kTrackingUpdateRateMs;
+            config.reconstructionMode = mode;
+            config.adaptiveUpdateRate = false;
+            SimulatedLink link(seed);
+            link.remote.setLossRatio(lossRatio);
+            Controller& controller = link.controller;
+            controller.setHMIMode(SerialComm::ControllerHMIMode::IN_GAME);
+            if (!link.begin(config, trackingSweep)) {
+                return;
+            }
+            result.started = true;
+
+            double squaredErrorSum = 0.0;
+            uint32_t reads = 0;
+            bool hasPrevious = false;
+            float previousX = 0.0f;
+            float previousY = 0.0f;
+            for (uint32_t t = 0; t < kTrackingDurationMs; t += kSimPollMs) {
+                delay(kSimPollMs);
+                float x, y;
+                bool button;
+                if (!controller.getStatus(x, y, button)) {
+                    continue;
+                }
+                float actualX, actualY;
+                trackingSweep(millis(), 0, actualX, actualY, button);
+                float error = hypotf(x - actualX, y - actualY);
+                squaredErrorSum += error * error;
+                reads++;
+                result.maxError = max(result.maxError, error);
+                if (hasPrevious) {
+                    result.maxStep = max(result.maxStep, hypotf(x - previousX, y - previousY));
+                }
+                result.maxAbs = max(result.maxAbs, max(fabsf(x), fabsf(y)));
+                previousX = x;
+                previousY = y;
+                hasPrevious = true;
+            }
+            result.rmsError = reads > 0 ? static_cast<float>(sqrt(squaredErrorSum / reads)) : 0.0f;
+        });
+        return result;
+    }
+
+    int sim(int argc, char** argv) {
+        uint32_t seed = 1;
+        for (int i = 2; i < argc; i++) {
+            if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+                seed = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 0));
+            } else {
+                fprintf(stderr, "Unknown option: %s\n", argv[i]);
+                return 1;
+            }
+        }
+
+        const ControllerConfig config = simControllerConfig();
+        const float lossRatios[] = {0.0f, 0.1f, 0.4f};
+        int failures = 0;
+        printf("Lossy link, adaptive rate %u-%u ms: in game %.0f s, attract mode %.0f s, in game %.0f s\n",
+            config.minUpdateRateMs, config.maxUpdateRateMs, kLossyLinkAttractStartMs / 1000.0f,
+            (kLossyLinkAttractEndMs - kLossyLinkAttractStartMs) / 1000.0f,
+            (kLossyLinkDurationMs - kLossyLinkAttractEndMs) / 1000.0f);
+        printf("  link loss  sequence  lost     est. mean  est. max  attract rate  game rate  switches  stale in game\n");
+        for (float lossRatio : lossRatios) {
+            for (bool sequence : {true, false}) {
+                LossyLinkResult result = simulateLossyLink(lossRatio, sequence, seed);
+                if (!result.started) {
+                    printf("  %8.0f%%  %-8s  the controller did not start: FAIL\n", lossRatio * 100.0f, sequence ? "yes" : "no");
+                    failures++;
+                    continue;
+                }
+
+                // A clean link runs at the preferred rates without false losses, through the rate switches; the
+                // loss estimate of a lossy link follows its losses (it counts the gaps, so it reads low), and a
+                // very lossy link backs off in game
+                bool ok;
+                if (lossRatio == 0.0f) {
+                    ok = result.maxEstimatedLoss < kLossEstimateTolerance && result.staleInGame == 0 &&
+                         result.inGameRateMs == config.minUpdateRateMs && result.attractRateMs == config.maxUpdateRateMs;
+                } else if (lossRatio >= 0.4f) {
+                    ok = result.inGameRateMs > config.minUpdateRateMs;
+                } else {
+                    ok = result.meanEstimatedLoss > 0.25f * lossRatio && result.meanEstimatedLoss < 1.5f * lossRatio;
+                }
+                failures += ok ? 0 : 1;
+                printf("  %8.0f%%  %-8s  %5.1f%%  %8.1f%%  %7.1f%%  %9u ms  %6u ms  %8lu  %13lu  %s\n",
+                    lossRatio * 100.0f, sequence ? "yes" : "no",
+                    100.0f * result.framesLost / max(result.framesSent + result.framesLost, 1u),
+                    result.meanEstimatedLoss * 100.0f, result.maxEstimatedLoss * 100.0f,
+                    result.attractRateMs, result.inGameRateMs, (unsigned long)result.rateChanges,
+                    (unsigned long)result.staleInGame, ok ? "ok" : "FAIL");
+            }
+        }
+
+        // Each mode must beat the staircase of HOLD on what it is for: EXTRAPOLATE on the lag, INTERPOLATE on
+        // the smoothness. Neither may leave the axis range.
+        printf("\nTracking error, %u ms update rate, stick sweeping a %.1f sine of %.1f s, read every %lu ms\n",
+            kTrackingUpdateRateMs, kTrackingAmplitude, kTrackingPeriodMs / 1000.0f, (unsigned long)kSimPollMs);
+        printf("  link loss  mode         rms error  max error  max step  max coordinate\n");
+        const ControllerReconstructionMode modes[] = {ControllerReconstructionMode::HOLD,
+            ControllerReconstructionMode::INTERPOLATE, ControllerReconstructionMode::EXTRAPOLATE};
+        const char* const modeNames[] = {"hold", "interpolate", "extrapolate"};
+        for (float lossRatio : {0.0f, 0.1f}) {
+            TrackingResult results[3];
+            for (uint8_t i = 0; i < 3; i++) {
+                results[i] = simulateTracking(modes[i], lossRatio, seed);
+            }
+            const TrackingResult& hold = results[0];
+            for (uint8_t i = 0; i < 3; i++) {
+                const TrackingResult& result = results[i];
+                bool ok = result.started && result.maxAbs <= 1.0f;
+                if (modes[i] == ControllerReconstructionMode::INTERPOLATE) {
+                    ok = ok && result.maxStep < hold.maxStep;
+                } else if (modes[i] == ControllerReconstructionMode::EXTRAPOLATE) {
+                    ok = ok && result.rmsError < hold.rmsError;
+                }
+                failures += ok ? 0 : 1;
+                printf("  %8.0f%%  %-11s  %9.3f  %9.3f  %8.3f  %14.3f  %s\n", lossRatio * 100.0f, modeNames[i],
+                    result.rmsError, result.maxError, result.maxStep, result.maxAbs, ok ? "ok" : "FAIL");
+            }
+        }
+
+        printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+        return failures == 0 ? 0 : 1;
+    }
+
+    unsigned long processedLines(const ControllerTelemetry& telemetry) {
+        return telemetry.framesReceived + telemetry.parseErrors + telemetry.unknownCommands;
+    }
+
+    int run(int argc, char** argv) {
+        const char* device = nullptr;
+        const char* recordPath = nullptr;
+        long durationS = 0;
+        for (int i = 2; i < argc; i++) {
+            if (strcmp(argv[i], "--device") == 0 && i + 1 < argc) {
+                device = argv[++i];
+            } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+                recordPath = argv[++i];
+            } else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) {
+                durationS = atol(argv[++i]);
+            } else {
+                fprintf(stderr, "Unknown option: %s\n", argv[i]);
+                return 1;
+            }
+        }
+
+        int fd;
+        if (device != nullptr) {
+            fd = openDevice(device);
+            if (fd < 0) {
+                perror(device);
+                return 1;
+            }
+            printf("Connected to %s\n", device);
+        } else {
+            std::string slavePath;
+            fd = openPty(slavePath);
+            if (fd < 0) {
+                perror("posix_openpt");
+                return 1;
+            }
+            printf("Controller pty: %s\n", slavePath.c_str());
+        }
+        fflush(stdout);
+        Serial1.attach(fd, fd);
+        // Timestamp the lines when they arrive: the controller task only polls the port every updateRateMs / 16
+        Serial1.startReceiveThread();
+
+        FILE* record = nullptr;
+        if (recordPath != nullptr) {
+            record = fopen(recordPath, "w");
+            if (record == nullptr) {
+                perror(recordPath);
+                return 1;
+            }
+            fprintf(record, "# Controller trace recorded by controller_harness\n");
+            unsigned long recordStartUs = micros();
+            Serial1.onLineReceived([record, recordStartUs](unsigned long timeUs, const std::string& line) {
+                fprintf(record, "%lu %s\n", (timeUs - recordStartUs) / 1000, line.c_str());
+            });
+        }
+
+        SerialComm serialComm(Serial1);
+        Controller controller(serialComm);
+        printf("Waiting for the controller...\n");
+        fflush(stdout);
+        while (!controller.begin(harnessControllerConfig())) {
+            if (stopRequested) {
+                return 1;
+            }
+        }
+        controller.setHMIMode(SerialComm::ControllerHMIMode::IN_GAME);
+        controller.resetTelemetry();
+        unsigned long discardedUs;
+        while (Serial1.popLineArrivalTime(discardedUs)) {} // Discard lines received during begin()
+
+        std::thread controllerTask([&controller]() { controller.update(); });
+        controllerTask.detach();
+
+        // Measure the time between a line arrival on the serial and its processing by the controller task
+        std::vector<unsigned long> latenciesUs;
+        unsigned long processed = 0;
+        unsigned long startMs = millis();
+        unsigned long nextReportMs = startMs + 1000;
+        while (!stopRequested && (durationS == 0 || millis() - startMs < static_cast<unsigned long>(durationS) * 1000)) {
+            ControllerTelemetry telemetry = controller.getTelemetry();
+            unsigned long nowUs = micros();
+            while (processed < processedLines(telemetry)) {
+                unsigned long arrivalUs;
+                if (!Serial1.popLineArrivalTime(arrivalUs)) {
+                    break;
+                }
+                latenciesUs.push_back(nowUs - arrivalUs);
+                processed++;
+            }
+
+            if (millis() >= nextReportMs) {
+                nextReportMs += 1000;
+                float x = 0, y = 0;
+                bool button = false;
+                bool active = controller.getStatus(x, y, button);
+                printf("t=%5lus frames=%lu errors=%lu status=%s x=%+.3f y=%+.3f button=%d\n",
+                    (millis() - startMs) / 1000, (unsigned long)telemetry.framesReceived, (unsigned long)telemetry.parseErrors,
+                    active ? "ok" : "stale", x, y, button);
+                fflush(stdout);
+            }
+            delayMicroseconds(200);
+        }
+
+        printf("\n");
+        controller.getTelemetry().printTo(Serial);
+        if (!latenciesUs.empty()) {
+            std::sort(latenciesUs.begin(), latenciesUs.end());
+            unsigned long long sum = 0;
+            for (unsigned long latency : latenciesUs) {
+                sum += latency;
+            }
+            printf("Line processing latency over %zu lines: mean %.2f ms, p50 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+                latenciesUs.size(), sum / 1000.0 / latenciesUs.size(),
+                latenciesUs[latenciesUs.size() / 2] / 1000.0,
+                latenciesUs[latenciesUs.size() * 99 / 100] / 1000.0,
+                latenciesUs.back() / 1000.0);
+        }
+
+        if (record != nullptr) {
+            Serial1.onLineReceived(nullptr);
+            fclose(record);
+        }
+        return 0;
+    }
+
+    int bench(int argc, char** argv) {
+        if (argc < 3) {
+            fprintf(stderr, "Missing trace file\n");
+            return 1;
+        }
+        long repeat = 100;
+        if (argc >= 5 && strcmp(argv[3], "--repeat") == 0) {
+            repeat = atol(argv[4]);
+        }
+
+        // Load the lines of the trace, without their timestamps
+        FILE* trace = fopen(argv[2], "r");
+        if (trace == nullptr) {
+            perror(argv[2]);
+            return 1;
+        }
+        std::string payload;
+        size_t lineCount = 0;
+        char line[512];
+        while (fgets(line, sizeof(line), trace) != nullptr) {
+            if (line[0] == '#') {
+                continue;
+            }
+            char* content = strchr(line, ' ');
+            if (content == nullptr) {
+                continue;
+            }
+            payload += content + 1;
+            lineCount++;
+        }
+        fclose(trace);
+        if (lineCount == 0) {
+            fprintf(stderr, "Empty trace\n");
+            return 1;
+        }
+
+        // Feed the trace from a temporary file through the HardwareSerial shim, which buffers it like the UART driver
+        unsigned long frames = 0;
+        unsigned long errors = 0;
+        double busySeconds = 0;
+        FILE* payloadFile = tmpfile();
+        if (payloadFile == nullptr || fwrite(payload.data(), 1, payload.size(), payloadFile) != payload.size()) {
+            perror("tmpfile");
+            return 1;
+        }
+        fflush(payloadFile);
+        for (long r = 0; r < repeat; r++) {
+            lseek(fileno(payloadFile), 0, SEEK_SET);
+            HardwareSerial serial(fileno(payloadFile), -1);
+            SerialComm serialComm(serial);
+            size_t parsed = 0;
+            auto start = std::chrono::steady_clock::now();
+            while (parsed < lineCount) {
+                SerialCommand cmd = serialComm.readCommands();
+                if (!cmd.isValid) {
+                    if (serialComm.getFormatErrorCount() + parsed >= lineCount) {
+                        break;
+                    }
+                    continue;
+                }
+                parsed++;
+                SerialCommandReader reader(cmd);
+                float x, y;
+                bool button;
+                if (cmd.command == "DATA" && reader.getFloat(x) && reader.getFloat(y) && reader.getBool(button)) {
+                    frames++;
+                } else {
+                    errors++;
+                }
+            }
+            busySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            errors += serialComm.getFormatErrorCount();
+        }
+        fclose(payloadFile);
+
+        printf("Parsed %lu frames (%lu invalid lines) in %.3f s: %.0f frames/s, %.2f us/frame\n",
+            frames, errors, busySeconds, (frames + errors) / busySeconds, busySeconds * 1e6 / (frames + errors));
+        return 0;
+    }
+}
+
+int main(int argc, char** argv) {
+    signal(SIGINT, [](int) { stopRequested = true; });
+
+    if (argc >= 2 && strcmp(argv[1], "run") == 0) {
+        return run(argc, argv);
+    }
+    if (argc >= 2 && strcmp(argv[1], "bench") == 0) {
+        return bench(argc, argv);
+    }
+    if (argc >= 2 && strcmp(argv[1], "sim") == 0) {
+        return sim(argc, argv);
+    }
+
+    fprintf(stderr, "Usage: %s run [--device <tty>] [--record <trace>] [--duration <s>]\n", argv[0]);
+    fprintf(stderr, "       %s bench <trace> [--repeat <n>]\n", argv[0]);
+    fprintf(stderr, "       %s sim [--seed <n>]\n", argv[0]);
+    return 1;
+}
@@ -0,0 +1,180 @@
+#!/usr/bin/env python3
+"""
+Replays a recorded remote controller trace on a serial port, a pseudo-terminal created by controller_harness
+or a USB-UART adapter wired to the board controller UART.
+
+Trace format: one "<time ms> <line>" per line (e.g. "1200 DATA:0.125##-0.300##0"), lines starting with '#'
+are comments. Traces are recorded with "controller_harness run --record <trace>" or generated with --generate.
+
+Examples:
+    replay_trace.py /dev/pts/3 field.trace                      # original timing
+    replay_trace.py /dev/pts/3 field.trace --speed 4 --loop     # 4 times faster, forever
+    replay_trace.py /dev/pts/3 field.trace --noise 0.001 --burst-every 5 --burst-frames 8
+    replay_trace.py /dev/pts/3 --generate 60 --rate-ms 100 --disconnect-every 20 --disconnect-ms 500
+"""
+
+import argparse
+import math
+import os
+import random
+import select
+import sys
+import termios
+import time
+import tty
+
+
+def load_trace(path):
+    events = []
+    with open(path, "r") as trace:
+        for line in trace:
+            line = line.rstrip("\r\n")
+            if not line or line.startswith("#"):
+                continue
+            time_ms, _, content = line.partition(" ")
+            events.append((int(time_ms), content))
+    return events
+
+
+def generate_trace(duration_s, rate_ms, with_sequence):
+    """Slow sine sweeps on both axes with a button press every 10 seconds."""
+    events = []
+    for seq, time_ms in enumerate(range(0, int(duration_s * 1000), rate_ms)):
+        t = time_ms / 1000.0
+        x = 0.8 * math.sin(2 * math.pi * 0.25 * t)
+        y = 0.6 * math.sin(2 * math.pi * 0.17 * t + 1.0)
+        button = 1 if (time_ms % 10000) < 200 else 0
+        line = "DATA:%.3f##%.3f##%d" % (x, y, button)
+        if with_sequence:
+            line += "##%d" % seq
+        events.append((time_ms, line))
+    return events
+
+
+def open_port(path):
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+    if os.isatty(fd):
+        tty.setraw(fd)
+        attrs = termios.tcgetattr(fd)
+        attrs[4] = attrs[5] = termios.B115200
+        termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    return fd
+
+
+def corrupt(data, rate, rng):
+    """Flips a random bit in each byte with the given probability, to emulate line noise."""
+    if rate <= 0:
+        return data
+    out = bytearray(data)
+    for i in range(len(out)):
+        if rng.random() < rate:
+            out[i] ^= 1 << rng.randrange(8)
+    return bytes(out)
+
+
+def drain(fd, verbose):
+    """Reads (and optionally prints) what the board sends back, e.g. SET_CTRL_PARAMS and SET_HMI_MODE."""
+    while select.select([fd], [], [], 0)[0]:
+        try:
+            data = os.read(fd, 1024)
+        except OSError:
+            return
+        if not data:
+            return
+        if verbose:
+            sys.stderr.write(data.decode("ascii", "replace"))
+
+
+def replay(fd, events, args, rng):
+    start = time.monotonic()
+    base_ms = events[0][0]
+    next_disconnect_s = args.disconnect_every if args.disconnect_every > 0 else None
+    next_burst_s = args.burst_every if args.burst_every > 0 else None
+    held = []
+    sent = dropped = 0
+
+    for time_ms, line in events:
+        due = start + (time_ms - base_ms) / 1000.0 / args.speed
+        while True:
+            now = time.monotonic()
+            if now >= due:
+                break
+            drain(fd, args.verbose)
+            time.sleep(min(due - now, 0.005))
+
+        elapsed_s = time.monotonic() - start
+
+        # Disconnection: the controller goes silent for a while, frames are lost
+        if next_disconnect_s is not None and elapsed_s >= next_disconnect_s:
+            if elapsed_s < next_disconnect_s + args.disconnect_ms / 1000.0 / args.speed:
+                dropped += 1
+                continue
+            next_disconnect_s += args.disconnect_every
+
+        if args.drop > 0 and rng.random() < args.drop:
+            dropped += 1
+            continue
+
+        data = corrupt((line + "\n").encode("ascii"), args.noise, rng)
+
+        # Burst: frames are held back and then delivered back-to-back, like a radio retransmission
+        if next_burst_s is not None and elapsed_s >= next_burst_s:
+            held.append(data)
+            if len(held) < args.burst_frames:
+                continue
+            data = b"".join(held)
+            held = []
+            next_burst_s += args.burst_every
+
+        os.write(fd, data)
+        sent += 1
+
+    return sent, dropped
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("port", help="serial port or pty path")
+    parser.add_argument("trace", nargs="?", help="trace file to replay")
+    parser.add_argument("--generate", type=float, metavar="SECONDS", help="replay a synthetic trace of the given length")
+    parser.add_argument("--rate-ms", type=int, default=100, help="update rate of the synthetic trace (default 100)")
+    parser.add_argument("--sequence", action="store_true", help="append a sequence number to the synthetic frames")
+    parser.add_argument("--speed", type=float, default=1.0, help="replay speed factor (default 1 = original timing)")
+    parser.add_argument("--loop", action="store_true", help="replay the trace forever")
+    parser.add_argument("--noise", type=float, default=0.0, help="probability of a bit flip per byte")
+    parser.add_argument("--drop", type=float, default=0.0, help="probability of dropping a frame")
+    parser.add_argument("--burst-every", type=float, default=0.0, metavar="SECONDS", help="deliver a burst of frames every N seconds")
+    parser.add_argument("--burst-frames", type=int, default=5, help="frames held back and delivered in each burst")
+    parser.add_argument("--disconnect-every", type=float, default=0.0, metavar="SECONDS", help="disconnect the controller every N seconds")
+    parser.add_argument("--disconnect-ms", type=int, default=500, help="length of each disconnection")
+    parser.add_argument("--seed", type=int, default=1, help="random seed, for reproducible noise")
+    parser.add_argument("--verbose", action="store_true", help="print the commands sent back by the board")
+    args = parser.parse_args()
+
+    if args.trace is None and args.generate is None:
+        parser.error("a trace file or --generate is required")
+    if args.speed <= 0:
+        parser.error("--speed must be positive")
+
+    events = load_trace(args.trace) if args.trace else generate_trace(args.generate, args.rate_ms, args.sequence)
+    if not events:
+        sys.exit("Empty trace")
+
+    rng = random.Random(args.seed)
+    fd = open_port(args.port)
+    try:
+        while True:
+            sent, dropped = replay(fd, events, args, rng)
+            print("Replayed %d frames, %d dropped" % (sent, dropped), file=sys.stderr)
+            if not args.loop:
+                break
+    except KeyboardInterrupt:
+        pass
+    except OSError as error:
+        print("Port closed: %s" % error, file=sys.stderr)
+    finally:
+        os.close(fd)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,76 @@
+#include "SimulatedController.hpp"
+
+SimulatedController::SimulatedController(HardwareSerial& serial, uint32_t seed)
+    : serial(serial), rng(seed), uniform(0.0f, 1.0f) {}
+
+void SimulatedController::begin(InputSource source) {
+    this->source = source;
+    serial.onTransmit([this](const uint8_t* data, size_t length) { onReceive(data, length); });
+
+    esp_timer_create_args_t args = {};
+    args.callback = [](void* arg) { static_cast<SimulatedController*>(arg)->sendFrame(); };
+    args.arg = this;
+    args.name = "RemoteController";
+    esp_timer_create(&args, &timer);
+    esp_timer_start_periodic(timer, updateRateMs * 1000ULL);
+}
+
+void SimulatedController::onReceive(const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        if (data[i] == '\n') {
+            handleLine(rxLine);
+            rxLine.clear();
+        } else if (data[i] != '\r') {
+            rxLine += static_cast<char>(data[i]);
+        }
+    }
+}
+
+void SimulatedController::handleLine(const std::string& line) {
+    size_t colon = line.find(':');
+    if (colon == std::string::npos) {
+        return;
+    }
+    std::string command = line.substr(0, colon);
+    const char* values = line.c_str() + colon + 1;
+
+    if (command == "SET_CTRL_PARAMS") {
+        // "<max angle>##<update rate ms>"
+        const char* separator = strstr(values, "##");
+        int rateMs = separator != nullptr ? atoi(separator + 2) : 0;
+        if (rateMs > 0 && rateMs != updateRateMs) {
+            updateRateMs = static_cast<uint16_t>(rateMs);
+            rateChanges++;
+            esp_timer_stop(timer);
+            esp_timer_start_periodic(timer, updateRateMs * 1000ULL);
+        }
+    } else if (command == "ENAB_CTRL") {
+        enabled = atoi(values) != 0;
+    } else if (command == "SET_HMI_MODE") {
+        hmiMode = static_cast<uint8_t>(atoi(values));
+    }
+}
+
+void SimulatedController::sendFrame() {
+    if (!enabled) {
+        return;
+    }
+    float x = 0.0f;
+    float y = 0.0f;
+    bool button = false;
+    source(millis(), hmiMode, x, y, button);
+
+    // The sequence number counts the lost frames too, so the firmware can detect them
+    sequence++;
+    if (lossRatio > 0.0f && uniform(rng) < lossRatio) {
+        framesLost++;
+        return;
+    }
+    char line[64];
+    int length = sendSequence
+        ? snprintf(line, sizeof(line), "DATA:%.3f##%.3f##%d##%lu\n", x, y, button ? 1 : 0,
+                   static_cast<unsigned long>(sequence))
+        : snprintf(line, sizeof(line), "DATA:%.3f##%.3f##%d\n", x, y, button ? 1 : 0);
+    serial.inject(reinterpret_cast<const uint8_t*>(line), static_cast<size_t>(length));
+    framesSent++;
+}
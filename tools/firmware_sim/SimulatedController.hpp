@@ -0,0 +1,77 @@
+#pragma once
+
+#include <Arduino.h>
+#include <esp_timer.h>
+
+#include <functional>
+#include <random>
+
+/**
+ * Remote controller on the other end of the simulated UART. It follows the link protocol of SerialComm: it
+ * applies the update rate and enable commands and sends the stick and button state at the requested rate, with
+ * a sequence number, optionally losing frames.
+ */
+class SimulatedController {
+public:
+    /**
+     * Source of the controller state, sampled at each frame.
+     * @param nowMs Current virtual time in milliseconds.
+     * @param hmiMode Last HMI mode set by the firmware (SerialComm::ControllerHMIMode).
+     * @param x Output X stick position in [-1, 1].
+     * @param y Output Y stick position in [-1, 1].
+     * @param button Output button state.
+     */
+    using InputSource = std::function<void(uint32_t nowMs, uint8_t hmiMode, float& x, float& y, bool& button)>;
+
+    /**
+     * @param serial Firmware port connected to the controller.
+     * @param seed Seed of the frame losses.
+     */
+    SimulatedController(HardwareSerial& serial, uint32_t seed);
+
+    /**
+     * Connects the controller to the port and powers it on. Must be called from the thread of the kernel.
+     * @param source Source of the controller state.
+     */
+    void begin(InputSource source);
+
+    /**
+     * Sets the probability to lose a frame on the link.
+     * @param ratio Loss probability in [0, 1].
+     */
+    void setLossRatio(float ratio) { lossRatio = ratio; }
+
+    /**
+     * Sets whether the frames carry a sequence number. Without it the firmware infers the lost frames from the
+     * arrival times, as with the remotes running an older firmware.
+     * @param enabled true to send the sequence number (default).
+     */
+    void setSendSequence(bool enabled) { sendSequence = enabled; }
+
+    uint8_t getHmiMode() const { return hmiMode; }
+    uint16_t getUpdateRateMs() const { return updateRateMs; }
+    uint32_t getFramesSent() const { return framesSent; }
+    uint32_t getFramesLost() const { return framesLost; }
+    uint32_t getRateChanges() const { return rateChanges; }
+
+private:
+    HardwareSerial& serial;
+    InputSource source;
+    esp_timer_handle_t timer = nullptr;
+    std::string rxLine;
+    bool enabled = false;
+    uint8_t hmiMode = 0;
+    uint16_t updateRateMs = 100;
+    uint32_t sequence = 0;
+    uint32_t framesSent = 0;
+    uint32_t framesLost = 0;
+    uint32_t rateChanges = 0;
+    float lossRatio = 0.0f;
+    bool sendSequence = true;
+    std::mt19937 rng;
+    std::uniform_real_distribution<float> uniform;
+
+    void onReceive(const uint8_t* data, size_t length);
+    void handleLine(const std::string& line);
+    void sendFrame();
+};
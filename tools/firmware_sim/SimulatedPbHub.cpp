@@ -0,0 +1,156 @@
+#include "SimulatedPbHub.hpp"
+
+namespace {
+    constexpr uint8_t kRegDigitalWrite = 0x00;  // Two registers, one per pin
+    constexpr uint8_t kRegPwm = 0x02;
+    constexpr uint8_t kRegDigitalRead = 0x04;
+    constexpr uint8_t kRegAnalogRead = 0x06;
+    constexpr uint8_t kRegLedNum = 0x08;
+    constexpr uint8_t kRegLedColor = 0x09;
+    constexpr uint8_t kRegLedFill = 0x0A;
+    constexpr uint8_t kRegLedBrightness = 0x0B;
+    constexpr uint8_t kRegServoAngle = 0x0C;
+    constexpr uint8_t kRegServoPulse = 0x0E;
+    constexpr uint8_t kRegShowMode = 0xFA;
+    constexpr uint8_t kRegFirmwareVersion = 0xFE;
+
+    constexpr uint8_t kFirmwareVersion = 2;
+    constexpr uint8_t kPadding = 0xFF;          // Bytes read past the value of a register
+
+    uint32_t readColor(const uint8_t* data) {
+        return (static_cast<uint32_t>(data[0]) << 16) | (data[1] << 8) | data[2];
+    }
+}
+
+SimulatedPbHub::SimulatedPbHub() {}
+
+int8_t SimulatedPbHub::rowOfChannel(uint8_t channel) {
+    if (channel >= CHANNELS) {
+        return -1;
+    }
+    return channel >= 5 ? channel + 1 : channel;
+}
+
+void SimulatedPbHub::setInput(uint8_t channel, uint8_t index, bool level) {
+    int8_t row = rowOfChannel(channel);
+    if (row >= 0 && index < 2) {
+        rows[row].inputs[index] = level;
+    }
+}
+
+uint32_t SimulatedPbHub::getLedColor(uint8_t channel, uint8_t index) const {
+    int8_t row = rowOfChannel(channel);
+    return row >= 0 && index < MAX_LEDS ? rows[row].leds[index] : 0;
+}
+
+uint8_t SimulatedPbHub::getLedBrightness(uint8_t channel) const {
+    int8_t row = rowOfChannel(channel);
+    return row >= 0 ? rows[row].brightness : 0;
+}
+
+bool SimulatedPbHub::onWrite(const uint8_t* data, size_t length) {
+    if (length == 0) {
+        return true;    // Address probe
+    }
+    pointer = data[0];
+    if (length == 1) {
+        return true;    // Register selection before a read
+    }
+    writes++;
+
+    const uint8_t* value = data + 1;
+    size_t valueLength = length - 1;
+    if (pointer == kRegShowMode) {
+        showMode = value[0];
+        return true;
+    }
+    int row = (pointer >> 4) - 4;
+    if (row < 0 || row >= ROWS) {
+        return false;
+    }
+    Row& state = rows[row];
+    uint8_t reg = pointer & 0x0F;
+    switch (reg) {
+        case kRegDigitalWrite:
+        case kRegDigitalWrite + 1:
+            state.outputs[reg - kRegDigitalWrite] = value[0] != 0 ? 1 : 0;
+            return true;
+        case kRegPwm:
+        case kRegPwm + 1:
+            state.outputs[reg - kRegPwm] = value[0];
+            return true;
+        case kRegLedNum:
+            if (valueLength < 2) {
+                return false;
+            }
+            state.ledCount = min<uint16_t>(value[0] | (value[1] << 8), MAX_LEDS);
+            return true;
+        case kRegLedColor: {
+            if (valueLength < 5) {
+                return false;
+            }
+            uint16_t index = value[0] | (value[1] << 8);
+            if (index < state.ledCount) {
+                state.leds[index] = readColor(value + 2);
+            }
+            return true;
+        }
+        case kRegLedFill: {
+            if (valueLength < 7) {
+                return false;
+            }
+            uint16_t start = value[0] | (value[1] << 8);
+            uint16_t count = value[2] | (value[3] << 8);
+            for (uint16_t i = start; i < start + count && i < state.ledCount; i++) {
+                state.leds[i] = readColor(value + 4);
+            }
+            return true;
+        }
+        case kRegLedBrightness:
+            state.brightness = value[0];
+            return true;
+        case kRegServoAngle:
+        case kRegServoAngle + 1:
+            state.servoPulses[reg - kRegServoAngle] = static_cast<uint16_t>(500 + value[0] * 2000 / 180);
+            return true;
+        case kRegServoPulse:
+        case kRegServoPulse + 1:
+            if (valueLength < 2) {
+                return false;
+            }
+            state.servoPulses[reg - kRegServoPulse] = value[0] | (value[1] << 8);
+            return true;
+    }
+    return false;
+}
+
+size_t SimulatedPbHub::onRead(uint8_t* buffer, size_t length) {
+    reads++;
+    // The registers are commands answering with a value of their own size (1 byte, 2 for the analog input): a
+    // longer read does not continue with the next register, its extra bytes are padding
+    memset(buffer, kPadding, length);
+    if (pointer == kRegShowMode) {
+        buffer[0] = showMode;
+        return length;
+    }
+    if (pointer == kRegFirmwareVersion) {
+        buffer[0] = kFirmwareVersion;
+        return length;
+    }
+    int row = (pointer >> 4) - 4;
+    if (row < 0 || row >= ROWS || length == 0) {
+        return length;
+    }
+
+    const Row& state = rows[row];
+    uint8_t reg = pointer & 0x0F;
+    if (reg == kRegDigitalRead || reg == kRegDigitalRead + 1) {
+        buffer[0] = state.inputs[reg - kRegDigitalRead] ? 1 : 0;
+    } else if (reg == kRegAnalogRead) {
+        buffer[0] = state.inputs[0] ? 0xFF : 0x00;
+        if (length > 1) {
+            buffer[1] = state.inputs[0] ? 0x0F : 0x00;
+        }
+    }
+    return length;
+}
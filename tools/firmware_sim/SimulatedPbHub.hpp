@@ -0,0 +1,58 @@
+#pragma once
+
+#include <Wire.h>
+
+/**
+ * Register model of the M5Stack PbHub unit on the simulated I2C bus: digital inputs and outputs, PWM, servo and
+ * the RGB LED strings of its channels. The input pins idle high, as with the pull-ups of the buttons.
+ */
+class SimulatedPbHub : public HostI2CDevice {
+public:
+    static constexpr uint8_t ADDRESS = 0x61;
+    static constexpr uint8_t CHANNELS = 8;
+    static constexpr uint8_t MAX_LEDS = 74;
+
+    SimulatedPbHub();
+
+    /**
+     * Drives an input pin, e.g. a button wired to ground.
+     * @param channel Channel number as used by the firmware (0 to 7).
+     * @param index Pin of the channel (0 or 1).
+     * @param level Pin level.
+     */
+    void setInput(uint8_t channel, uint8_t index, bool level);
+
+    /**
+     * Gets the color of a LED of a channel string.
+     * @return The 0xRRGGBB color last written.
+     */
+    uint32_t getLedColor(uint8_t channel, uint8_t index) const;
+    uint8_t getLedBrightness(uint8_t channel) const;
+
+    uint32_t getReads() const { return reads; }
+    uint32_t getWrites() const { return writes; }
+
+    bool onWrite(const uint8_t* data, size_t length) override;
+    size_t onRead(uint8_t* buffer, size_t length) override;
+
+private:
+    // The registers skip a row between channel 4 and 5, the rows are indexed by the register high nibble - 4
+    static constexpr uint8_t ROWS = CHANNELS + 1;
+
+    struct Row {
+        bool inputs[2] = {true, true};
+        uint8_t outputs[2] = {};
+        uint16_t servoPulses[2] = {};
+        uint16_t ledCount = MAX_LEDS;
+        uint8_t brightness = 0;
+        uint32_t leds[MAX_LEDS] = {};
+    };
+
+    Row rows[ROWS];
+    uint8_t pointer = 0;
+    uint8_t showMode = 0;
+    uint32_t reads = 0;
+    uint32_t writes = 0;
+
+    static int8_t rowOfChannel(uint8_t channel);
+};
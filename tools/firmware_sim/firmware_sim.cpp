@@ -0,0 +1,570 @@
+/**
+ * Linux build of the whole firmware on the virtual clock. src/main.cpp and every library are compiled unchanged
+ * against the host replacements of the Arduino core, FreeRTOS, esp_timer, Wire, Preferences, SPIFFS, I2S, the
+ * audio library and NeoPixelBus (tools/host): the framework headers are the hardware abstraction, resolved at
+ * link time, so the firmware keeps calling the ESP32 APIs directly and pays nothing for it on the board.
+ *
+ * The devices behind them are simulated: the maze table with its servos, IMU and ball drop sensor (the maze_sim
+ * world), the PbHub with the start and stop buttons, the remote controller on Serial1 played by the maze_sim
+ * player, the LED matrix and the audio output. setup() and loop() run as on the board, while an operator script
+ * cycles attract mode, games, stops and high score entries. Hours of operation run in seconds, to find leaks,
+ * starvation and timing bugs; the run fails when the firmware does not start a game, does not end one, does
+ * not come back to attract mode in time, when its heap grows from game to game, or when the SystemMonitor sees
+ * a task without free stack.
+ *
+ * The heap is sampled each time the firmware is back in attract mode: the live blocks counted by the
+ * SystemMonitor allocation wrappers and the heap in use. A sample also holds what happens to be allocated at that
+ * moment (the files of the sounds still playing, for instance), a few blocks and kilobytes that come and go, so
+ * the check fits a trend through the samples after the first quarter of the run, the warm-up of caches and
+ * buffers. The heap grows when the trend exceeds a leak rate per game, or when the growth it adds up to over the
+ * run exceeds the noise of a sample, which catches the slow leaks of the long runs.
+ *
+ * Usage:
+ *   firmware_sim [options]
+ *     --hours <h>             Simulated operating time (default 1)
+ *     --games <n>             Stops after n games (default: no limit)
+ *     --seed <n>              Seed of the maze, the players and the operator (default 1)
+ *     --attract <s>           Mean attract mode time between two games (default 60)
+ *     --stop-ratio <r>        Fraction of the games stopped with the stop button (default 0.05)
+ *     --touch-ratio <r>       Fraction of the attract periods where a visitor plays with the controller (default 0.1)
+ *     --reaction <min,max>    Range of the player reaction delays in ms (default 150,400)
+ *     --loss <r>              Frame loss ratio of the controller link (default 0)
+ *     --data <dir>            Directory holding the SPIFFS files (default: build/data, the data directory of the project
+ *                             encoded as the build stores it)
+ *     --console <c1,c2,...>   Debug console commands run at the end (default CTRL,I2C,INPUT,SERVO,TILT,TELEMETRY)
+ *     --soak                  Soak test preset: 8 hours of short attract periods, frequent stops and visitors
+ *     --verbose               Prints the firmware log (Serial) and every game
+ */
+
+#include <Arduino.h>
+#include <SPIFFS.h>
+#include <Wire.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <HostKernel.h>
+
+#include <PinsDefinitions.h>
+#include <AudioPlayer.hpp>
+#include <GameConfig.h>
+#include <Game.hpp>
+#include <SerialComm.hpp>
+#include <SystemMonitor.hpp>
+
+#include "MazePlayer.hpp"
+#include "MazeWorld.hpp"
+#include "SimulatedController.hpp"
+#include "SimulatedPbHub.hpp"
+
+#include <unistd.h>
+
+#include <chrono>
+#include <memory>
+#include <random>
+#include <vector>
+
+// Arduino entry points and state of src/main.cpp. Config.hpp is compiled there: its functions are not inline.
+void setup();
+void loop();
+GameConfig getDefaultGameConfig();
+extern Game game;
+extern bool waitingForGameToStart;
+extern SystemMonitor systemMonitor;
+extern AudioPlayer audioPlayer;
+
+namespace {
+    constexpr uint8_t kButtonChannel = 0;       // Start and stop buttons of main.cpp, active low
+    constexpr uint8_t kStartButtonIndex = 0;
+    constexpr uint8_t kStopButtonIndex = 1;
+    constexpr uint8_t kAudioPort = 1;           // I2S port of the AudioPlayer in main.cpp
+    constexpr uint32_t kClickMs = 120;
+    constexpr uint32_t kNameButtonPressMs = 200;
+    constexpr uint32_t kNameButtonPeriodMs = 600;
+    constexpr uint32_t kStartTimeoutMs = 15000;     // Ready, set, go included
+    constexpr uint32_t kEndMarginMs = 30000;        // Beyond the time limit and the ball drop time
+    constexpr uint32_t kAttractTimeoutMs = 120000;  // End of game animations and high score entry included
+    constexpr uint32_t kBootTimeoutMs = 60000;
+    constexpr uint32_t kConsoleCommandMs = 200;
+    constexpr size_t kMinHeapSamples = 8;           // Games needed for the heap growth check
+    constexpr size_t kHeapCheckpointCapacity = 4096;    // Games of the longest runs (about 45 per hour)
+    constexpr float kMaxHeapBlocksPerGame = 0.25f;  // Heap trend of a leak: a block every 4 games
+    constexpr float kMaxHeapBytesPerGame = 256.0f;
+    constexpr float kHeapNoiseBlocks = 8.0f;        // Spread of the samples: blocks and bytes allocated at the time
+    constexpr float kHeapNoiseBytes = 8192.0f;
+    constexpr uint8_t kHmiModeWritePlayerName = static_cast<uint8_t>(SerialComm::ControllerHMIMode::WRITE_PLAYER_NAME);
+
+#ifndef FIRMWARE_SIM_DATA_DIR
+#define FIRMWARE_SIM_DATA_DIR "../../data"
+#endif
+
+    struct SimOptions {
+        double hours = 1.0;
+        int games = -1;
+        uint32_t seed = 1;
+        float attractS = 60.0f;
+        float stopRatio = 0.05f;
+        float touchRatio = 0.1f;
+        float minReactionMs = 150.0f;
+        float maxReactionMs = 400.0f;
+        float lossRatio = 0.0f;
+        const char* dataDir = FIRMWARE_SIM_DATA_DIR;
+        std::vector<std::string> consoleCommands = {"CTRL", "I2C", "INPUT", "SERVO", "TILT", "TELEMETRY", "AUDIO", "MEM"};
+        bool verbose = false;
+        WorldConfig world;
+    };
+
+    struct RunStats {
+        uint32_t games;
+        uint32_t won;
+        uint32_t lost;
+        uint32_t stopped;
+        uint32_t highScores;
+        uint32_t visitorTouches;
+        uint32_t startIgnored;      // Start click not followed by a game
+        uint32_t gameHangs;         // Game still running well after its time limit
+        uint32_t attractHangs;      // No return to attract mode after a game
+        uint32_t maxAttractReturnMs;
+    };
+
+    /**
+     * Heap in use when the firmware is back in attract mode after a game
+     */
+    struct HeapCheckpoint {
+        int32_t liveBlocks;
+        size_t usedBytes;
+    };
+
+    /**
+     * Least squares trend of the heap samples after the warm-up
+     */
+    struct HeapGrowth {
+        size_t games;               // Games of the fit
+        float blocksPerGame;
+        float bytesPerGame;
+
+        float blocksOverRun() const { return blocksPerGame * (games - 1); }
+        float bytesOverRun() const { return bytesPerGame * (games - 1); }
+
+        bool grew() const {
+            return blocksPerGame > kMaxHeapBlocksPerGame || bytesPerGame > kMaxHeapBytesPerGame ||
+                blocksOverRun() > kHeapNoiseBlocks || bytesOverRun() > kHeapNoiseBytes;
+        }
+    };
+
+    /**
+     * Operator script and people around the maze: the player steering with the remote controller, the visitors
+     * touching it in attract mode, and the operator using the start and stop buttons.
+     */
+    struct Scenario {
+        const SimOptions& options;
+        MazeWorld& world;
+        SimulatedPbHub& hub;
+        SimulatedController* controller = nullptr;
+        std::mt19937 rng;
+        std::unique_ptr<MazePlayer> player;
+        RunStats stats = {};
+        std::vector<HeapCheckpoint> heapCheckpoints;
+
+        bool visitorTouching = false;
+        uint32_t nameEntryStartMs = 0;  // Start of the button presses entering a high score name, 0 if none
+
+        Scenario(const SimOptions& options, MazeWorld& world, SimulatedPbHub& hub)
+            : options(options), world(world), hub(hub), rng(options.seed) {
+            // The samples must not grow the heap they measure
+            heapCheckpoints.reserve(kHeapCheckpointCapacity);
+        }
+
+        float uniform(float low, float high) {
+            return std::uniform_real_distribution<float>(low, high)(rng);
+        }
+
+        /**
+         * State of the remote controller, sampled by the controller at each frame.
+         */
+        void controllerInput(uint32_t nowMs, uint8_t hmiMode, float& x, float& y, bool& button) {
+            x = 0.0f;
+            y = 0.0f;
+            button = false;
+            if (nameEntryStartMs != 0 && hmiMode == kHmiModeWritePlayerName) {
+                // Confirm the first character until the name is complete, after the high score animation: "AAA"
+                button = (nowMs - nameEntryStartMs) % kNameButtonPeriodMs < kNameButtonPressMs;
+            } else if (visitorTouching) {
+                x = uniform(-1.0f, 1.0f);
+                y = uniform(-1.0f, 1.0f);
+                button = true;
+            } else if (player != nullptr) {
+                player->update(nowMs, game.isRunning(), x, y);
+            }
+        }
+
+        void click(uint8_t index) {
+            hub.setInput(kButtonChannel, index, false);
+            delay(kClickMs);
+            hub.setInput(kButtonChannel, index, true);
+        }
+
+        /**
+         * Waits for a condition, polling it like a person watching the maze.
+         * @return true if the condition holds before the timeout.
+         */
+        template <typename Condition>
+        bool waitFor(Condition condition, uint32_t timeoutMs) {
+            uint32_t startMs = millis();
+            while (!condition()) {
+                if (millis() - startMs >= timeoutMs) {
+                    return false;
+                }
+                delay(50);
+            }
+            return true;
+        }
+
+        bool finished(int64_t endUs) const {
+            return esp_timer_get_time() >= endUs || (options.games >= 0 && static_cast<int>(stats.games) >= options.games);
+        }
+
+        void run() {
+            int64_t endUs = esp_timer_get_time() + static_cast<int64_t>(options.hours * 3600e6);
+            if (!waitFor([] { return waitingForGameToStart; }, kBootTimeoutMs)) {
+                stats.attractHangs++;
+                return;
+            }
+
+            while (!finished(endUs)) {
+                // Attract mode, sometimes with a visitor playing with the controller
+                uint32_t attractMs = static_cast<uint32_t>(
+                    std::exponential_distribution<float>(1.0f / options.attractS)(rng) * 1000.0f) + 1000;
+                if (uniform(0.0f, 1.0f) < options.touchRatio) {
+                    uint32_t touchMs = min<uint32_t>(static_cast<uint32_t>(uniform(1000.0f, 5000.0f)), attractMs / 2);
+                    delay(attractMs / 2);
+                    visitorTouching = true;
+                    stats.visitorTouches++;
+                    delay(touchMs);
+                    visitorTouching = false;
+                    delay(attractMs - attractMs / 2 - touchMs);
+                } else {
+                    delay(attractMs);
+                }
+
+                // The operator puts the ball back in the holder and the next player presses start
+                PlayerConfig playerConfig;
+                playerConfig.reactionMs = uniform(options.minReactionMs, options.maxReactionMs);
+                world.resetForGame();
+                player.reset(new MazePlayer(playerConfig, world, static_cast<uint32_t>(rng())));
+                click(kStartButtonIndex);
+                if (!waitFor([] { return game.isRunning(); }, kStartTimeoutMs)) {
+                    stats.startIgnored++;
+                    if (options.verbose) {
+                        printf("[%9.1f s] start ignored\n", millis() / 1000.0);
+                    }
+                    continue;
+                }
+                stats.games++;
+
+                // Play, the operator sometimes stopping the game
+                bool stopGame = uniform(0.0f, 1.0f) < options.stopRatio;
+                uint32_t stopAtMs = millis() + static_cast<uint32_t>(uniform(2000.0f, 20000.0f));
+                GameConfig config = getDefaultGameConfig();
+                uint32_t endTimeoutMs = config.easyTimeLimitMs + config.ballDropTimeMs + kEndMarginMs;
+                bool ended = waitFor([&] {
+                    if (stopGame && millis() >= stopAtMs && game.isRunning()) {
+                        click(kStopButtonIndex);
+                        stopGame = false;
+                    }
+                    return !game.isRunning();
+                }, endTimeoutMs);
+                if (!ended) {
+                    stats.gameHangs++;
+                    if (options.verbose) {
+                        printf("[%9.1f s] game still running after %lu ms\n", millis() / 1000.0,
+                               static_cast<unsigned long>(endTimeoutMs));
+                    }
+                    click(kStopButtonIndex);
+                }
+                GameLevel level;
+                GameResult result;
+                uint32_t completionMs;
+                game.lastGameStats(level, result, completionMs);
+                stats.won += result == GameResult::WON ? 1 : 0;
+                stats.lost += result == GameResult::LOST ? 1 : 0;
+                stats.stopped += result == GameResult::NONE ? 1 : 0;
+                if (options.verbose) {
+                    printf("[%9.1f s] game %lu: %s, %lu ms, reaction %.0f ms\n", millis() / 1000.0,
+                           static_cast<unsigned long>(stats.games),
+                           result == GameResult::WON ? "won" : result == GameResult::LOST ? "lost" : "stopped",
+                           static_cast<unsigned long>(completionMs), playerConfig.reactionMs);
+                }
+
+                // Enter a name when the player made a high score, then wait for the attract mode
+                uint32_t endMs = millis();
+                bool back = waitFor([&] {
+                    if (nameEntryStartMs == 0 && controller->getHmiMode() == kHmiModeWritePlayerName) {
+                        nameEntryStartMs = millis();
+                        stats.highScores++;
+                    }
+                    return waitingForGameToStart;
+                }, kAttractTimeoutMs);
+                nameEntryStartMs = 0;
+                player.reset();
+                if (!back) {
+                    stats.attractHangs++;
+                    if (options.verbose) {
+                        printf("[%9.1f s] not back to attract mode %lu ms after the game\n", millis() / 1000.0,
+                               static_cast<unsigned long>(kAttractTimeoutMs));
+                    }
+                    return;
+                }
+                stats.maxAttractReturnMs = max<uint32_t>(stats.maxAttractReturnMs, millis() - endMs);
+                heapCheckpoints.push_back({systemMonitor.getLiveBlocks(),
+                    heap_caps_get_total_size(MALLOC_CAP_INTERNAL) - heap_caps_get_free_size(MALLOC_CAP_INTERNAL)});
+            }
+        }
+    };
+
+    /**
+     * Fits the trend of the heap samples after the first quarter of the run.
+     * @param samples Heap samples, one per game.
+     * @param growth Output trend.
+     * @return true if there are enough samples for the fit, false otherwise.
+     */
+    bool measureHeapGrowth(const std::vector<HeapCheckpoint>& samples, HeapGrowth& growth) {
+        if (samples.size() < kMinHeapSamples) {
+            return false;
+        }
+
+        size_t first = samples.size() / 4;
+        double n = static_cast<double>(samples.size() - first);
+        double meanGame = 0.0, meanBlocks = 0.0, meanBytes = 0.0;
+        for (size_t i = first; i < samples.size(); i++) {
+            meanGame += i / n;
+            meanBlocks += samples[i].liveBlocks / n;
+            meanBytes += samples[i].usedBytes / n;
+        }
+        double gameVariance = 0.0, blocksCovariance = 0.0, bytesCovariance = 0.0;
+        for (size_t i = first; i < samples.size(); i++) {
+            double game = i - meanGame;
+            gameVariance += game * game;
+            blocksCovariance += game * (samples[i].liveBlocks - meanBlocks);
+            bytesCovariance += game * (samples[i].usedBytes - meanBytes);
+        }
+        growth.games = samples.size() - first;
+        growth.blocksPerGame = static_cast<float>(blocksCovariance / gameVariance);
+        growth.bytesPerGame = static_cast<float>(bytesCovariance / gameVariance);
+        return true;
+    }
+
+    bool parseArgs(int argc, char** argv, SimOptions& options) {
+        for (int i = 1; i < argc; i++) {
+            const char* arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (strcmp(arg, "--hours") == 0 && hasValue) {
+                options.hours = atof(argv[++i]);
+            } else if (strcmp(arg, "--games") == 0 && hasValue) {
+                options.games = atoi(argv[++i]);
+            } else if (strcmp(arg, "--seed") == 0 && hasValue) {
+                options.seed = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+            } else if (strcmp(arg, "--attract") == 0 && hasValue) {
+                options.attractS = static_cast<float>(atof(argv[++i]));
+            } else if (strcmp(arg, "--stop-ratio") == 0 && hasValue) {
+                options.stopRatio = static_cast<float>(atof(argv[++i]));
+            } else if (strcmp(arg, "--touch-ratio") == 0 && hasValue) {
+                options.touchRatio = static_cast<float>(atof(argv[++i]));
+            } else if (strcmp(arg, "--reaction") == 0 && hasValue) {
+                if (sscanf(argv[++i], "%f,%f", &options.minReactionMs, &options.maxReactionMs) != 2) {
+                    return false;
+                }
+            } else if (strcmp(arg, "--loss") == 0 && hasValue) {
+                options.lossRatio = static_cast<float>(atof(argv[++i]));
+            } else if (strcmp(arg, "--data") == 0 && hasValue) {
+                options.dataDir = argv[++i];
+            } else if (strcmp(arg, "--console") == 0 && hasValue) {
+                options.consoleCommands.clear();
+                std::string list = argv[++i];
+                size_t start = 0;
+                while (start <= list.size()) {
+                    size_t comma = list.find(',', start);
+                    std::string command = list.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+                    if (!command.empty()) {
+                        options.consoleCommands.push_back(command);
+                    }
+                    if (comma == std::string::npos) {
+                        break;
+                    }
+                    start = comma + 1;
+                }
+            } else if (strcmp(arg, "--soak") == 0) {
+                options.hours = 8.0;
+                options.attractS = 10.0f;
+                options.stopRatio = 0.2f;
+                options.touchRatio = 0.3f;
+            } else if (strcmp(arg, "--verbose") == 0) {
+                options.verbose = true;
+            } else {
+                return false;
+            }
+        }
+        return options.hours > 0.0 && options.attractS > 0.0f && options.minReactionMs <= options.maxReactionMs;
+    }
+
+    /**
+     * Runs debug console commands as if typed on the USB serial, printing their output.
+     */
+    void runConsoleCommands(const std::vector<std::string>& commands) {
+        Serial.onTransmit([](const uint8_t* data, size_t length) { fwrite(data, 1, length, stdout); });
+        for (const std::string& command : commands) {
+            printf("> %s\n", command.c_str());
+            std::string line = command + "\n";
+            Serial.inject(reinterpret_cast<const uint8_t*>(line.c_str()), line.size());
+            delay(kConsoleCommandMs);
+        }
+        Serial.onTransmit(nullptr);
+    }
+
+    /**
+     * Prints the tasks the SystemMonitor of the firmware sees without free stack.
+     * @return true if there is any.
+     */
+    bool reportExhaustedStacks() {
+        bool exhausted = false;
+        TaskMemoryStats task;
+        for (uint8_t i = 0; systemMonitor.getTaskStats(i, task); i++) {
+            if (task.stackFreeBytes == 0) {
+                printf("Stack exhausted: %s\n", task.name);
+                exhausted = true;
+            }
+        }
+        return exhausted;
+    }
+
+    void printReport(const Scenario& scenario, const SimulatedController& controller, const SimulatedPbHub& hub,
+                     int64_t startUs, double wallS) {
+        HostKernel* kernel = HostKernel::current();
+        HostBoard& board = hostBoard();
+        HostKernelStats kernelStats = kernel->getStats();
+        double virtualS = (kernelStats.virtualUs - startUs) / 1e6;
+        const RunStats& stats = scenario.stats;
+
+        printf("\n%.2f h simulated in %.1f s (%.0fx real time), %llu context switches, %llu timer callbacks\n",
+            virtualS / 3600.0, wallS, virtualS / wallS, static_cast<unsigned long long>(kernelStats.contextSwitches),
+            static_cast<unsigned long long>(kernelStats.timerCallbacks));
+        printf("Games: %lu (%lu won, %lu lost, %lu stopped), %lu high scores entered, %lu visitor touches\n",
+            (unsigned long)stats.games, (unsigned long)stats.won, (unsigned long)stats.lost, (unsigned long)stats.stopped,
+            (unsigned long)stats.highScores, (unsigned long)stats.visitorTouches);
+        printf("Anomalies: %lu start ignored, %lu game hangs, %lu attract mode hangs; slowest return to attract mode %.1f s\n",
+            (unsigned long)stats.startIgnored, (unsigned long)stats.gameHangs, (unsigned long)stats.attractHangs,
+            stats.maxAttractReturnMs / 1000.0);
+
+        printf("Tasks:\n  %-18s %8s %8s %11s %12s %16s\n", "name", "priority", "stack", "host used", "resumes",
+            "longest block s");
+        std::vector<const HostContext*> contexts = {kernel->getMainContext()};
+        for (const HostContext* task : kernel->getTasks()) {
+            contexts.push_back(task);
+        }
+        for (const HostContext* context : contexts) {
+            printf("  %-18s %8u %8lu %11lu %12llu %16.3f%s\n", context->name.c_str(), context->priority,
+                (unsigned long)context->stackSize, (unsigned long)kernel->getStackUsed(context),
+                static_cast<unsigned long long>(context->switchesIn), context->maxBlockedUs / 1e6,
+                context->finished ? " (ended)" : "");
+        }
+
+        const HostBoard::LedStrip& display = board.ledStrips[PUZZLE_DISPLAY_PIXEL_PIN];
+        const HostBoard::I2sPort& audio = board.i2s[kAudioPort];
+        printf("Display: %llu frames (%.1f fps)\n", static_cast<unsigned long long>(display.frames),
+            display.frames / virtualS);
+        // The firmware counts the underruns: only it knows when the mixer had voices to play
+        printf("Audio: %lu files played, %.1f s of samples, %lu underruns\n", (unsigned long)audio.filesPlayed,
+            audio.bytesWritten / 4.0 / audio.sampleRate, (unsigned long)audioPlayer.getStats().underruns);
+        printf("I2C: %llu transactions, bus busy %.1f%%; PbHub %lu reads, %lu writes\n",
+            static_cast<unsigned long long>(Wire.getTransactions()), 100.0 * Wire.getBusyUs() / 1e6 / virtualS,
+            (unsigned long)hub.getReads(), (unsigned long)hub.getWrites());
+        printf("Controller: %lu frames sent, %lu lost, %lu rate changes, rate %u ms\n",
+            (unsigned long)controller.getFramesSent(), (unsigned long)controller.getFramesLost(),
+            (unsigned long)controller.getRateChanges(), controller.getUpdateRateMs());
+        printf("NVS: %llu writes, %llu bytes\n", static_cast<unsigned long long>(board.nvsWrites),
+            static_cast<unsigned long long>(board.nvsBytesWritten));
+        printf("Flash partitions: %llu writes, %llu bytes, %llu sector erases\n",
+            static_cast<unsigned long long>(board.flashWrites),
+            static_cast<unsigned long long>(board.flashBytesWritten),
+            static_cast<unsigned long long>(board.flashSectorErases));
+
+        HeapGrowth growth;
+        if (measureHeapGrowth(scenario.heapCheckpoints, growth)) {
+            printf("Heap in attract mode: %+.3f live blocks and %+.0f bytes per game over the last %lu games "
+                "(%+.1f blocks, %+.0f bytes)%s\n", growth.blocksPerGame, growth.bytesPerGame,
+                (unsigned long)growth.games, growth.blocksOverRun(), growth.bytesOverRun(),
+                growth.grew() ? ", GROWING" : "");
+        } else {
+            printf("Heap in attract mode: %lu games, too few for the growth check\n",
+                (unsigned long)scenario.heapCheckpoints.size());
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    SimOptions options;
+    if (!parseArgs(argc, argv, options)) {
+        fprintf(stderr, "Usage: %s [--hours h] [--games n] [--seed n] [--attract s] [--stop-ratio r] [--touch-ratio r] "
+                        "[--reaction min,max] [--loss r] [--data dir] [--console c1,c2,...] [--soak] [--verbose]\n", argv[0]);
+        return 2;
+    }
+    Serial.attach(-1, options.verbose ? STDOUT_FILENO : -1);
+    SPIFFS.setHostDirectory(options.dataDir);
+
+    HostKernel kernel;
+    int64_t startUs = kernel.nowUs();
+    auto wallStart = std::chrono::steady_clock::now();
+    randomSeed(options.seed);
+
+    // Devices wired as on the board: the table (servos on LEDC 0 and 1, IMU, ball drop sensor), the PbHub and the
+    // remote controller on Serial1
+    MazeWorld world(options.world, getDefaultGameConfig(), options.seed, BALL_DROP_PIN);
+    SimulatedPbHub hub;
+    Wire.attachDevice(SimulatedImu::ADDRESS, &world.getImu());
+    Wire.attachDevice(SimulatedPbHub::ADDRESS, &hub);
+    Scenario scenario(options, world, hub);
+    SimulatedController controller(Serial1, options.seed ^ 0x5bd1e995u);
+    scenario.controller = &controller;
+    controller.setLossRatio(options.lossRatio);
+    controller.begin([&scenario](uint32_t nowMs, uint8_t hmiMode, float& x, float& y, bool& button) {
+        scenario.controllerInput(nowMs, hmiMode, x, y, button);
+    });
+
+    esp_timer_create_args_t physicsArgs = {};
+    physicsArgs.callback = [](void* arg) { static_cast<MazeWorld*>(arg)->step(esp_timer_get_time()); };
+    physicsArgs.arg = &world;
+    physicsArgs.name = "Physics";
+    esp_timer_handle_t physics;
+    esp_timer_create(&physicsArgs, &physics);
+    esp_timer_start_periodic(physics, 1000);
+
+    // The operator script ends the run: loop() never returns to this function
+    struct Run {
+        Scenario& scenario;
+        SimulatedController& controller;
+        SimulatedPbHub& hub;
+        int64_t startUs;
+        std::chrono::steady_clock::time_point wallStart;
+    } run = {scenario, controller, hub, startUs, wallStart};
+
+    setup();
+    xTaskCreate([](void* param) {
+        Run* run = static_cast<Run*>(param);
+        run->scenario.run();
+        runConsoleCommands(run->scenario.options.consoleCommands);
+        double wallS = std::chrono::duration<double>(std::chrono::steady_clock::now() - run->wallStart).count();
+        printReport(run->scenario, run->controller, run->hub, run->startUs, wallS);
+
+        const RunStats& stats = run->scenario.stats;
+        HeapGrowth growth;
+        bool heapGrew = measureHeapGrowth(run->scenario.heapCheckpoints, growth) && growth.grew();
+        bool stackExhausted = reportExhaustedStacks();
+        bool failed = stats.startIgnored > 0 || stats.gameHangs > 0 || stats.attractHangs > 0 || heapGrew ||
+                      stackExhausted;
+        printf("%s\n", failed ? "FAILED" : "OK");
+        fflush(stdout);
+        _exit(failed ? 1 : 0);
+    }, "SimOperatorTask", 8192, &run, 1, nullptr);
+
+    while (true) {
+        loop();
+    }
+}
@@ -0,0 +1,439 @@
+#include "Arduino.h"
+#include "HostKernel.h"
+
+#include <chrono>
+#include <thread>
+#include <unistd.h>
+#include <poll.h>
+
+HardwareSerial Serial(STDIN_FILENO, STDOUT_FILENO);
+HardwareSerial Serial1;
+
+namespace {
+    const auto kStartTime = std::chrono::steady_clock::now();
+}
+
+unsigned long millis() {
+    HostKernel* kernel = HostKernel::current();
+    if (kernel != nullptr) {
+        return static_cast<unsigned long>(kernel->nowUs() / 1000);
+    }
+    return static_cast<unsigned long>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - kStartTime).count());
+}
+
+unsigned long micros() {
+    HostKernel* kernel = HostKernel::current();
+    if (kernel != nullptr) {
+        return static_cast<unsigned long>(kernel->nowUs());
+    }
+    return static_cast<unsigned long>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - kStartTime).count());
+}
+
+void delay(unsigned long ms) {
+    HostKernel* kernel = HostKernel::current();
+    if (kernel != nullptr) {
+        kernel->sleepUntil(kernel->nowUs() + static_cast<int64_t>(ms) * 1000);
+        return;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(unsigned int us) {
+    HostKernel* kernel = HostKernel::current();
+    if (kernel != nullptr) {
+        kernel->sleepUntil(kernel->nowUs() + us);
+        return;
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void yield() {
+    HostKernel* kernel = HostKernel::current();
+    if (kernel != nullptr) {
+        kernel->sleepUntil(kernel->nowUs());
+        return;
+    }
+    std::this_thread::yield();
+}
+
+// -- Board peripherals
+
+namespace {
+    HostBoard realTimeBoard;
+}
+
+HostBoard& hostBoard() {
+    HostKernel* kernel = HostKernel::current();
+    return kernel != nullptr ? kernel->getBoard() : realTimeBoard;
+}
+
+void HostBoard::setPinLevel(uint8_t pin, uint8_t level) {
+    if (pin >= PIN_COUNT) {
+        return;
+    }
+    Pin& state = pins[pin];
+    uint8_t previous = state.level;
+    state.level = level ? HIGH : LOW;
+    if (previous == state.level) {
+        return;
+    }
+
+    bool rising = state.level == HIGH;
+    if (state.interruptMode == CHANGE || (state.interruptMode == RISING && rising) ||
+        (state.interruptMode == FALLING && !rising)) {
+        if (state.handler != nullptr) {
+            state.handler(state.arg);
+        } else if (state.plainHandler != nullptr) {
+            state.plainHandler();
+        }
+    }
+}
+
+float HostBoard::getLedcPulseUs(uint8_t channel) const {
+    if (channel >= LEDC_CHANNELS || ledc[channel].frequency == 0) {
+        return 0.0f;
+    }
+    const LedcChannel& state = ledc[channel];
+    float periodUs = 1000000.0f / state.frequency;
+    return periodUs * state.duty / static_cast<float>((1UL << state.resolutionBits) - 1);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    HostBoard& board = hostBoard();
+    if (pin < HostBoard::PIN_COUNT) {
+        board.pins[pin].mode = mode;
+        if (mode == INPUT_PULLUP) {
+            board.pins[pin].level = HIGH;
+        }
+    }
+}
+
+int digitalRead(uint8_t pin) {
+    return pin < HostBoard::PIN_COUNT ? hostBoard().pins[pin].level : LOW;
+}
+
+void digitalWrite(uint8_t pin, uint8_t level) {
+    hostBoard().setPinLevel(pin, level);
+}
+
+void attachInterrupt(uint8_t pin, void (*handler)(), int mode) {
+    if (pin < HostBoard::PIN_COUNT) {
+        HostBoard::Pin& state = hostBoard().pins[pin];
+        state.plainHandler = handler;
+        state.handler = nullptr;
+        state.interruptMode = mode;
+    }
+}
+
+void attachInterruptArg(uint8_t pin, void (*handler)(void*), void* arg, int mode) {
+    if (pin < HostBoard::PIN_COUNT) {
+        HostBoard::Pin& state = hostBoard().pins[pin];
+        state.handler = handler;
+        state.plainHandler = nullptr;
+        state.arg = arg;
+        state.interruptMode = mode;
+    }
+}
+
+void detachInterrupt(uint8_t pin) {
+    if (pin < HostBoard::PIN_COUNT) {
+        HostBoard::Pin& state = hostBoard().pins[pin];
+        state.handler = nullptr;
+        state.plainHandler = nullptr;
+        state.interruptMode = 0;
+    }
+}
+
+uint32_t ledcSetup(uint8_t channel, uint32_t frequency, uint8_t resolutionBits) {
+    if (channel >= HostBoard::LEDC_CHANNELS || resolutionBits == 0 || resolutionBits > 20) {
+        return 0;
+    }
+    HostBoard::LedcChannel& state = hostBoard().ledc[channel];
+    state.frequency = frequency;
+    state.resolutionBits = resolutionBits;
+    return frequency;
+}
+
+void ledcAttachPin(uint8_t pin, uint8_t channel) {
+    if (channel < HostBoard::LEDC_CHANNELS) {
+        hostBoard().ledc[channel].pin = pin;
+    }
+}
+
+void ledcWrite(uint8_t channel, uint32_t duty) {
+    if (channel < HostBoard::LEDC_CHANNELS) {
+        HostBoard::LedcChannel& state = hostBoard().ledc[channel];
+        state.duty = duty;
+        state.writes++;
+    }
+}
+
+uint32_t ledcRead(uint8_t channel) {
+    return channel < HostBoard::LEDC_CHANNELS ? hostBoard().ledc[channel].duty : 0;
+}
+
+void randomSeed(unsigned long seed) {
+    if (seed != 0) {
+        hostBoard().randomState = seed;
+    }
+}
+
+long random(long howBig) {
+    if (howBig <= 0) {
+        return 0;
+    }
+    // xorshift64*, plenty for animations and simulations
+    uint64_t& state = hostBoard().randomState;
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return static_cast<long>((state * 0x2545F4914F6CDD1DULL >> 33) % static_cast<uint64_t>(howBig));
+}
+
+long random(long howSmall, long howBig) {
+    if (howSmall >= howBig) {
+        return howSmall;
+    }
+    return random(howBig - howSmall) + howSmall;
+}
+
+void* ps_malloc(size_t size) {
+    void* block = malloc(size);
+    if (block != nullptr) {
+        hostBoard().psramAllocatedBytes += size;
+    }
+    return block;
+}
+
+void* ps_calloc(size_t count, size_t size) {
+    void* block = calloc(count, size);
+    if (block != nullptr) {
+        hostBoard().psramAllocatedBytes += count * size;
+    }
+    return block;
+}
+
+// -- String
+
+String::String(double value, unsigned int decimals) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+    str = buffer;
+}
+
+String String::substring(unsigned int from, unsigned int to) const {
+    if (from > to) {
+        std::swap(from, to);
+    }
+    if (from >= str.length()) {
+        return String();
+    }
+    return String(str.substr(from, to - from));
+}
+
+void String::trim() {
+    size_t begin = str.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos) {
+        str.clear();
+        return;
+    }
+    size_t end = str.find_last_not_of(" \t\r\n");
+    str = str.substr(begin, end - begin + 1);
+}
+
+void String::toLowerCase() {
+    std::transform(str.begin(), str.end(), str.begin(), [](unsigned char c) { return static_cast<char>(tolower(c)); });
+}
+
+void String::toUpperCase() {
+    std::transform(str.begin(), str.end(), str.begin(), [](unsigned char c) { return static_cast<char>(toupper(c)); });
+}
+
+// -- Print & Stream
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+    size_t written = 0;
+    while (size--) {
+        written += write(*buffer++);
+    }
+    return written;
+}
+
+size_t Print::printf(const char* format, ...) {
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (length < 0) {
+        return 0;
+    }
+    return write(reinterpret_cast<const uint8_t*>(buffer), min(static_cast<size_t>(length), sizeof(buffer) - 1));
+}
+
+size_t Stream::readBytes(char* buffer, size_t length) {
+    size_t count = 0;
+    unsigned long startMs = millis();
+    while (count < length) {
+        int c = read();
+        if (c < 0) {
+            if (millis() - startMs >= timeoutMs) {
+                break;
+            }
+            delay(1);
+            continue;
+        }
+        buffer[count++] = static_cast<char>(c);
+    }
+    return count;
+}
+
+// -- HardwareSerial
+
+HardwareSerial::~HardwareSerial() {
+    if (receiveThread.joinable()) {
+        stopReceiving = true;
+        rxSpace.notify_all();
+        receiveThread.join();
+    }
+}
+
+void HardwareSerial::startReceiveThread() {
+    if (readFd < 0 || receiveThread.joinable()) {
+        return;
+    }
+    stopReceiving = false;
+    receiveThread = std::thread([this]() { receiveLoop(); });
+}
+
+void HardwareSerial::receiveLoop() {
+    constexpr int kPollTimeoutMs = 10; // How late the thread notices the port being destroyed
+    while (!stopReceiving) {
+        size_t room;
+        {
+            std::unique_lock<std::mutex> lock(rxMutex);
+            rxSpace.wait(lock, [this]() { return stopReceiving || rxCount < RX_BUFFER_SIZE; });
+            room = RX_BUFFER_SIZE - rxCount;
+        }
+        struct pollfd pfd = {readFd, POLLIN, 0};
+        if (stopReceiving || poll(&pfd, 1, kPollTimeoutMs) <= 0 || !(pfd.revents & POLLIN)) {
+            continue;
+        }
+        uint8_t buffer[RX_BUFFER_SIZE];
+        ssize_t count = ::read(readFd, buffer, room);
+        if (count <= 0) {
+            // End of file or closed descriptor: nothing more will arrive
+            return;
+        }
+        receive(buffer, static_cast<size_t>(count));
+    }
+}
+
+void HardwareSerial::fill() {
+    if (readFd < 0 || receiveThread.joinable()) {
+        return;
+    }
+
+    struct pollfd pfd = {readFd, POLLIN, 0};
+    while (poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN)) {
+        size_t room;
+        {
+            std::lock_guard<std::mutex> lock(rxMutex);
+            room = RX_BUFFER_SIZE - rxCount;
+        }
+        if (room == 0) {
+            break;
+        }
+        uint8_t buffer[RX_BUFFER_SIZE];
+        ssize_t count = ::read(readFd, buffer, room);
+        if (count <= 0) {
+            break;
+        }
+
+        receive(buffer, static_cast<size_t>(count));
+    }
+}
+
+void HardwareSerial::receive(const uint8_t* buffer, size_t size) {
+    unsigned long nowUs = micros();
+    std::lock_guard<std::mutex> lock(rxMutex);
+    for (size_t i = 0; i < size && rxCount < RX_BUFFER_SIZE; i++) {
+        rxBuffer[(rxHead + rxCount) % RX_BUFFER_SIZE] = buffer[i];
+        rxCount++;
+        if (buffer[i] == '\n') {
+            {
+                std::lock_guard<std::mutex> lock(lineArrivalMutex);
+                if (lineArrivalCount == MAX_LINE_ARRIVAL_TIMES) {
+                    lineArrivalHead = (lineArrivalHead + 1) % MAX_LINE_ARRIVAL_TIMES;
+                    lineArrivalCount--;
+                }
+                lineArrivalTimesUs[(lineArrivalHead + lineArrivalCount) % MAX_LINE_ARRIVAL_TIMES] = nowUs;
+                lineArrivalCount++;
+            }
+            if (lineCallback) {
+                lineCallback(nowUs, currentLine);
+            }
+            currentLine.clear();
+        } else if (buffer[i] != '\r') {
+            currentLine += static_cast<char>(buffer[i]);
+        }
+    }
+}
+
+size_t HardwareSerial::inject(const uint8_t* buffer, size_t size) {
+    size_t count;
+    {
+        std::lock_guard<std::mutex> lock(rxMutex);
+        count = min(size, RX_BUFFER_SIZE - rxCount);
+    }
+    receive(buffer, count);
+    return count;
+}
+
+int HardwareSerial::available() {
+    fill();
+    std::lock_guard<std::mutex> lock(rxMutex);
+    return static_cast<int>(rxCount);
+}
+
+int HardwareSerial::read() {
+    std::unique_lock<std::mutex> lock(rxMutex);
+    if (rxCount == 0) {
+        lock.unlock();
+        fill();
+        lock.lock();
+    }
+    if (rxCount == 0) {
+        return -1;
+    }
+    uint8_t c = rxBuffer[rxHead];
+    rxHead = (rxHead + 1) % RX_BUFFER_SIZE;
+    rxCount--;
+    if (rxCount == RX_BUFFER_SIZE - 1) {
+        rxSpace.notify_one();
+    }
+    return c;
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+    if (transmitCallback) {
+        transmitCallback(buffer, size);
+        return size;
+    }
+    if (writeFd < 0) {
+        return size; // Not connected: behave like a UART without receiver
+    }
+    ssize_t written = ::write(writeFd, buffer, size);
+    return written > 0 ? static_cast<size_t>(written) : 0;
+}
+
+bool HardwareSerial::popLineArrivalTime(unsigned long& timeUs) {
+    std::lock_guard<std::mutex> lock(lineArrivalMutex);
+    if (lineArrivalCount == 0) {
+        return false;
+    }
+    timeUs = lineArrivalTimesUs[lineArrivalHead];
+    lineArrivalHead = (lineArrivalHead + 1) % MAX_LINE_ARRIVAL_TIMES;
+    lineArrivalCount--;
+    return true;
+}
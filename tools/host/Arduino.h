@@ -0,0 +1,255 @@
+#pragma once
+
+// Minimal Arduino core replacement used to build firmware libraries on Linux for the host tools.
+// Only the subset of the Arduino API used by the libraries linked in the tools is provided.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <string>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+
+#define IRAM_ATTR
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+#define pgm_read_word(addr) (*(const uint16_t*)(addr))
+
+#define LED_BUILTIN 21      // Seeed XIAO ESP32S3 user LED
+#define SERIAL_8N1  0x800001c
+
+#ifndef PI
+#define PI 3.1415926535897932384626433832795
+#endif
+
+#define LOW  0x0
+#define HIGH 0x1
+
+#define INPUT           0x01
+#define OUTPUT          0x03
+#define INPUT_PULLUP    0x05
+#define INPUT_PULLDOWN  0x09
+
+#define RISING  0x01
+#define FALLING 0x02
+#define CHANGE  0x03
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+using std::min;
+using std::max;
+using std::abs;
+
+inline long map(long x, long inMin, long inMax, long outMin, long outMax) {
+    return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+// Pseudo-random numbers from the HostBoard of the calling thread, so seeded runs are reproducible
+void randomSeed(unsigned long seed);
+long random(long howBig);
+long random(long howSmall, long howBig);
+
+// Time runs on the HostKernel virtual clock when the calling thread has one, on the host clock otherwise
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+// GPIO, interrupts and LEDC act on the HostBoard of the calling thread
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t level);
+#define digitalPinToInterrupt(pin) (pin)
+void attachInterrupt(uint8_t pin, void (*handler)(), int mode);
+void attachInterruptArg(uint8_t pin, void (*handler)(void*), void* arg, int mode);
+void detachInterrupt(uint8_t pin);
+uint32_t ledcSetup(uint8_t channel, uint32_t frequency, uint8_t resolutionBits);
+void ledcAttachPin(uint8_t pin, uint8_t channel);
+void ledcWrite(uint8_t channel, uint32_t duty);
+uint32_t ledcRead(uint8_t channel);
+
+// The host has no PSRAM: allocations come from the heap, reported as PSRAM by esp_heap_caps
+void* ps_malloc(size_t size);
+void* ps_calloc(size_t count, size_t size);
+
+class String {
+public:
+    String(const char* cstr = "") : str(cstr != nullptr ? cstr : "") {}
+    String(const std::string& s) : str(s) {}
+    String(char c) : str(1, c) {}
+    explicit String(int value) : str(std::to_string(value)) {}
+    explicit String(unsigned int value) : str(std::to_string(value)) {}
+    explicit String(long value) : str(std::to_string(value)) {}
+    explicit String(unsigned long value) : str(std::to_string(value)) {}
+    String(double value, unsigned int decimals = 2);
+
+    unsigned int length() const { return str.length(); }
+    const char* c_str() const { return str.c_str(); }
+    char operator[](unsigned int index) const { return index < str.length() ? str[index] : '\0'; }
+
+    int indexOf(char c, unsigned int from = 0) const { return toIndex(str.find(c, from)); }
+    int indexOf(const char* s, unsigned int from = 0) const { return toIndex(str.find(s, from)); }
+    int indexOf(const String& s, unsigned int from = 0) const { return toIndex(str.find(s.str, from)); }
+    String substring(unsigned int from) const { return from < str.length() ? String(str.substr(from)) : String(); }
+    String substring(unsigned int from, unsigned int to) const;
+
+    void trim();
+    void toLowerCase();
+    void toUpperCase();
+    long toInt() const { return atol(str.c_str()); }
+    float toFloat() const { return static_cast<float>(atof(str.c_str())); }
+    bool startsWith(const String& prefix) const { return str.compare(0, prefix.str.length(), prefix.str) == 0; }
+    void reserve(unsigned int size) { str.reserve(size); }
+
+    String& operator+=(const String& other) { str += other.str; return *this; }
+    String& operator+=(const char* other) { str += other; return *this; }
+    String& operator+=(char c) { str += c; return *this; }
+    bool operator==(const String& other) const { return str == other.str; }
+    bool operator==(const char* other) const { return str == other; }
+    bool operator!=(const String& other) const { return str != other.str; }
+    bool operator!=(const char* other) const { return str != other; }
+
+    friend String operator+(const String& a, const String& b) { return String(a.str + b.str); }
+    friend String operator+(const String& a, const char* b) { return String(a.str + b); }
+    friend String operator+(const char* a, const String& b) { return String(a + b.str); }
+
+private:
+    std::string str;
+
+    static int toIndex(size_t pos) { return pos == std::string::npos ? -1 : static_cast<int>(pos); }
+};
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size);
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+    size_t print(const char* s) { return write(reinterpret_cast<const uint8_t*>(s), strlen(s)); }
+    size_t print(const String& s) { return print(s.c_str()); }
+    size_t println() { return print("\n"); }
+    size_t println(const char* s) { return print(s) + println(); }
+    size_t println(const String& s) { return println(s.c_str()); }
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    size_t readBytes(char* buffer, size_t length);
+    size_t readBytes(uint8_t* buffer, size_t length) { return readBytes(reinterpret_cast<char*>(buffer), length); }
+    void setTimeout(unsigned long timeoutMs) { this->timeoutMs = timeoutMs; }
+
+protected:
+    unsigned long timeoutMs = 1000;
+};
+
+/**
+ * HardwareSerial backed by a file descriptor (a pseudo-terminal, a real tty or stdin/stdout).
+ * Every newline read from the descriptor is timestamped so that tools can measure the latency of
+ * the code consuming the received lines. The descriptor is read when the firmware polls the port, or
+ * as the bytes arrive once startReceiveThread() is called.
+ */
+class HardwareSerial : public Stream {
+public:
+    HardwareSerial(int readFd = -1, int writeFd = -1) : readFd(readFd), writeFd(writeFd) {}
+    ~HardwareSerial();
+    HardwareSerial(const HardwareSerial&) = delete;
+    HardwareSerial& operator=(const HardwareSerial&) = delete;
+
+    void attach(int readFd, int writeFd) { this->readFd = readFd; this->writeFd = writeFd; }
+    void begin(unsigned long baud, uint32_t config = 0, int8_t rxPin = -1, int8_t txPin = -1, bool invert = false) {}
+
+    int available() override;
+    int read() override;
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buffer, size_t size) override;
+
+    /**
+     * Reads the descriptor from a thread of its own, like the UART driver fills its RX buffer from the
+     * interrupt, so the bytes are timestamped when they arrive and not when the firmware polls the port.
+     * The thread stops reading while the RX buffer is full. For the real-time tools only: the arrival
+     * times are on the host clock.
+     */
+    void startReceiveThread();
+
+    /**
+     * Pops the arrival time (micros()) of the oldest received newline not yet popped. Only the last
+     * MAX_LINE_ARRIVAL_TIMES are kept, so a port nobody pops does not grow without bound.
+     * @param timeUs Where to store the arrival time.
+     * @return true if a timestamp was available.
+     */
+    bool popLineArrivalTime(unsigned long& timeUs);
+
+    /**
+     * Sets a function called with the arrival time (micros()) and the content of every line read from the descriptor.
+     * @param callback The function to call, or an empty function to disable it.
+     */
+    void onLineReceived(std::function<void(unsigned long, const std::string&)> callback) {
+        std::lock_guard<std::mutex> lock(rxMutex);
+        lineCallback = callback;
+    }
+
+    /**
+     * Sets a function receiving the bytes written by the firmware instead of the write descriptor, so a
+     * simulated peer can be connected to the port.
+     * @param callback The function to call, or an empty function to write to the descriptor again.
+     */
+    void onTransmit(std::function<void(const uint8_t*, size_t)> callback) { transmitCallback = callback; }
+
+    /**
+     * Makes bytes available to the firmware as if they were received on the port, the counterpart of
+     * onTransmit for a simulated peer. Bytes beyond the RX buffer size are lost, as with the UART driver.
+     * @param buffer Bytes received.
+     * @param size Number of bytes.
+     * @return The number of bytes stored in the RX buffer.
+     */
+    size_t inject(const uint8_t* buffer, size_t size);
+
+private:
+    static constexpr size_t RX_BUFFER_SIZE = 256; // Same as the default UART driver RX buffer
+    static constexpr size_t MAX_LINE_ARRIVAL_TIMES = 256;
+
+    int readFd;
+    int writeFd;
+    // Fixed rings like the buffer of the UART driver: the port allocates nothing while the firmware runs, so the
+    // heap counters of the firmware only see the firmware
+    uint8_t rxBuffer[RX_BUFFER_SIZE];
+    size_t rxHead = 0;
+    size_t rxCount = 0;
+    std::string currentLine;
+    std::function<void(unsigned long, const std::string&)> lineCallback;
+    std::function<void(const uint8_t*, size_t)> transmitCallback;
+    unsigned long lineArrivalTimesUs[MAX_LINE_ARRIVAL_TIMES];
+    size_t lineArrivalHead = 0;
+    size_t lineArrivalCount = 0;
+    std::mutex lineArrivalMutex;
+    std::mutex rxMutex;                 // Guards the RX buffer and the line callback against the receive thread
+    std::condition_variable rxSpace;    // Signaled when the firmware reads from a full RX buffer
+    std::thread receiveThread;
+    std::atomic<bool> stopReceiving{false};
+
+    void fill();
+    void receiveLoop();
+    void receive(const uint8_t* buffer, size_t size);
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
@@ -0,0 +1,101 @@
+#include "Audio.h"
+#include "HostKernel.h"
+#include "esp_timer.h"
+
+namespace {
+    uint32_t readLe32(const uint8_t* bytes) {
+        return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+    }
+
+    uint16_t readLe16(const uint8_t* bytes) {
+        return static_cast<uint16_t>(bytes[0] | (bytes[1] << 8));
+    }
+}
+
+Audio::Audio(bool internalDAC, uint8_t channelEnabled, uint8_t i2sPort)
+    : port(static_cast<i2s_port_t>(i2sPort < HostBoard::I2S_PORTS ? i2sPort : 0)) {}
+
+bool Audio::setPinout(uint8_t bclk, uint8_t lrc, uint8_t dout, int8_t mclk) {
+    return true;
+}
+
+bool Audio::connecttoFS(fs::FS& fs, const char* path, int32_t fileStartPos) {
+    stopSong();
+    File file = fs.open(path);
+    if (!file || file.isDirectory()) {
+        return false;
+    }
+
+    // Walk the RIFF chunks for the format and the size of the samples
+    uint8_t header[12];
+    if (file.read(header, sizeof(header)) != sizeof(header) || memcmp(header, "RIFF", 4) != 0 ||
+        memcmp(header + 8, "WAVE", 4) != 0) {
+        return false;
+    }
+    uint32_t sampleRate = 0;
+    uint16_t channels = 0;
+    uint16_t bitsPerSample = 0;
+    uint32_t dataBytes = 0;
+    uint8_t chunk[8];
+    while (file.read(chunk, sizeof(chunk)) == sizeof(chunk)) {
+        uint32_t chunkSize = readLe32(chunk + 4);
+        size_t next = file.position() + chunkSize + (chunkSize & 1);
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            uint8_t format[16];
+            if (chunkSize < sizeof(format) || file.read(format, sizeof(format)) != sizeof(format)) {
+                return false;
+            }
+            channels = readLe16(format + 2);
+            sampleRate = readLe32(format + 4);
+            bitsPerSample = readLe16(format + 14);
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            dataBytes = min<uint32_t>(chunkSize, file.size() - file.position());
+            break;
+        }
+        if (!file.seek(next)) {
+            break;
+        }
+    }
+    if (sampleRate == 0 || channels == 0 || bitsPerSample == 0 || dataBytes == 0) {
+        return false;
+    }
+
+    // The decoder outputs 16-bit stereo at the file sample rate
+    uint64_t frames = dataBytes / (channels * ((bitsPerSample + 7) / 8));
+    i2s_set_sample_rates(port, sampleRate);
+    remainingBytes = frames * 4;
+    durationUs = static_cast<int64_t>(frames * 1000000ULL / sampleRate);
+    running = true;
+
+    HostBoard::I2sPort& state = hostBoard().i2s[port];
+    state.filesPlayed++;
+    state.lastFile = path;
+    return true;
+}
+
+void Audio::loop() {
+    if (!running) {
+        return;
+    }
+    // Never block: the library writes only what the DMA buffers accept
+    static uint8_t silence[CHUNK_BYTES];
+    size_t written = 0;
+    do {
+        size_t chunkBytes = static_cast<size_t>(min<uint64_t>(remainingBytes, CHUNK_BYTES));
+        if (i2s_write(port, silence, chunkBytes, &written, 0) != ESP_OK) {
+            break;
+        }
+        remainingBytes -= written;
+    } while (written > 0 && remainingBytes > 0);
+
+    // The file ends when its last samples are played, not when they are queued
+    if (remainingBytes == 0 && hostBoard().i2s[port].queuedUntilUs <= esp_timer_get_time()) {
+        running = false;
+    }
+}
+
+uint32_t Audio::stopSong() {
+    running = false;
+    remainingBytes = 0;
+    return 0;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+// ESP32-audioI2S replacement for the host tools. Files are not decoded: a file plays for the duration given by
+// its WAV header, filling the DMA buffers of its I2S port on the virtual clock.
+
+#include "Arduino.h"
+#include "FS.h"
+#include "driver/i2s.h"
+
+class Audio {
+public:
+    Audio(bool internalDAC = false, uint8_t channelEnabled = 3, uint8_t i2sPort = I2S_NUM_0);
+
+    bool setPinout(uint8_t bclk, uint8_t lrc, uint8_t dout, int8_t mclk = -1);
+    void setVolume(uint8_t volume) { this->volume = volume; }
+    uint8_t getVolume() const { return volume; }
+
+    /**
+     * Starts playing a file.
+     * @return false if the file does not exist or is not a WAV file.
+     */
+    bool connecttoFS(fs::FS& fs, const char* path, int32_t fileStartPos = -1);
+
+    /**
+     * Feeds the DMA buffers with the audio due since the last call, like the decoder loop of the library.
+     */
+    void loop();
+
+    bool isRunning() const { return running; }
+    uint32_t stopSong();
+
+    /**
+     * Gets the duration of the current file.
+     * @return The duration in seconds.
+     */
+    uint32_t getAudioFileDuration() const { return static_cast<uint32_t>(durationUs / 1000000); }
+
+private:
+    static constexpr size_t CHUNK_BYTES = 4096;     // Decoded bytes written per loop iteration at most
+
+    i2s_port_t port;
+    uint8_t volume = 21;
+    bool running = false;
+    uint64_t remainingBytes = 0;    // Audio still to play, in 16-bit stereo bytes at the port sample rate
+    int64_t durationUs = 0;
+};
@@ -0,0 +1,110 @@
+#include "FS.h"
+#include "SPIFFS.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+
+fs::SPIFFSFS SPIFFS;
+
+namespace fs {
+
+size_t File::read(uint8_t* buffer, size_t length) {
+    if (!valid || directory || offset >= fileSize) {
+        return 0;
+    }
+    FILE* file = fopen(hostPath.c_str(), "rb");
+    if (file == nullptr) {
+        return 0;
+    }
+    size_t count = 0;
+    if (fseek(file, static_cast<long>(offset), SEEK_SET) == 0) {
+        count = fread(buffer, 1, min(length, fileSize - offset), file);
+    }
+    fclose(file);
+    offset += count;
+    return count;
+}
+
+bool File::seek(uint32_t position) {
+    if (!valid || directory || position > fileSize) {
+        return false;
+    }
+    offset = position;
+    return true;
+}
+
+void File::close() {
+    valid = false;
+    entries.reset();
+}
+
+File File::openNextFile() {
+    File next;
+    if (!valid || !directory || entries == nullptr || nextEntry >= entries->size()) {
+        return next;
+    }
+    const std::string& entry = (*entries)[nextEntry++];
+    std::string path = entryPath == "/" ? "/" + entry : entryPath + "/" + entry;
+    struct stat info;
+    std::string host = hostPath + "/" + entry;
+    if (stat(host.c_str(), &info) != 0) {
+        return next;
+    }
+    next.valid = true;
+    next.directory = S_ISDIR(info.st_mode);
+    next.entryName = entry;
+    next.entryPath = path;
+    next.hostPath = host;
+    next.fileSize = next.directory ? 0 : static_cast<size_t>(info.st_size);
+    return next;
+}
+
+File FS::open(const char* path, const char* mode) {
+    File file;
+    if (!mounted || path == nullptr || path[0] != '/' || mode == nullptr || mode[0] != 'r') {
+        return file;
+    }
+
+    std::string host = hostDirectory + path;
+    struct stat info;
+    if (stat(host.c_str(), &info) != 0) {
+        return file;
+    }
+    file.valid = true;
+    file.directory = S_ISDIR(info.st_mode);
+    file.entryPath = path;
+    const char* slash = strrchr(path, '/');
+    file.entryName = slash != nullptr ? slash + 1 : path;
+    file.hostPath = host;
+    if (file.directory) {
+        // Entries are listed in name order, so the runs do not depend on the host directory order
+        file.entries = std::make_shared<std::vector<std::string>>();
+        DIR* dir = opendir(host.c_str());
+        if (dir != nullptr) {
+            while (struct dirent* entry = readdir(dir)) {
+                if (entry->d_name[0] != '.') {
+                    file.entries->push_back(entry->d_name);
+                }
+            }
+            closedir(dir);
+        }
+        std::sort(file.entries->begin(), file.entries->end());
+    } else {
+        file.fileSize = static_cast<size_t>(info.st_size);
+    }
+    return file;
+}
+
+bool FS::exists(const char* path) {
+    return static_cast<bool>(open(path));
+}
+
+bool SPIFFSFS::begin(bool formatOnFail, const char* basePath, uint8_t maxOpenFiles, const char* partitionLabel) {
+    struct stat info;
+    mounted = stat(hostDirectory.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+    return mounted;
+}
+
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+// File system replacement for the host tools: the files are read from a directory of the host, the SPIFFS image
+// content (e.g. the data directory of the project). Only reading is supported.
+
+#include "Arduino.h"
+
+#include <memory>
+#include <vector>
+
+namespace fs {
+
+class File {
+public:
+    File() {}
+
+    explicit operator bool() const { return valid; }
+    const char* name() const { return entryName.c_str(); }
+    const char* path() const { return entryPath.c_str(); }
+    size_t size() const { return fileSize; }
+    bool isDirectory() const { return directory; }
+
+    /**
+     * Reads bytes from the current position.
+     * @return The number of bytes read.
+     */
+    size_t read(uint8_t* buffer, size_t length);
+    bool seek(uint32_t position);
+    size_t position() const { return offset; }
+    void close();
+
+    /**
+     * Opens the next entry of a directory.
+     * @return The entry, or an invalid File after the last one.
+     */
+    File openNextFile();
+
+private:
+    friend class FS;
+
+    bool valid = false;
+    bool directory = false;
+    std::string entryName;
+    std::string entryPath;
+    std::string hostPath;
+    size_t fileSize = 0;
+    size_t offset = 0;
+    std::shared_ptr<std::vector<std::string>> entries;  // Names of the directory entries
+    size_t nextEntry = 0;
+};
+
+class FS {
+public:
+    /**
+     * Sets the host directory holding the files.
+     * @param path Directory path, the "/" of the file system.
+     */
+    void setHostDirectory(const char* path) { hostDirectory = path; }
+
+    File open(const char* path, const char* mode = "r");
+    File open(const String& path, const char* mode = "r") { return open(path.c_str(), mode); }
+    bool exists(const char* path);
+
+protected:
+    std::string hostDirectory = "data";
+    bool mounted = false;
+};
+
+}
+
+using fs::File;
+using fs::FS;
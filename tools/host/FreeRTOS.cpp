@@ -0,0 +1,336 @@
+#include "Arduino.h"
+#include "HostKernel.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+
+#include <chrono>
+#include <vector>
+
+struct HostQueue {
+    std::vector<uint8_t> storage;
+    UBaseType_t length;
+    UBaseType_t itemSize;
+    UBaseType_t head = 0;
+    UBaseType_t count = 0;
+};
+
+namespace {
+    // Protects the state of the semaphores, queues and notifications against the real-time threads
+    std::mutex objectsMutex;
+
+    // Contexts of the threads running in real time, created on demand to hold their notifications
+    thread_local HostContext realTimeContext;
+
+    /**
+     * Waits until tryTake succeeds or the timeout expires, on the virtual clock if the caller has a kernel.
+     */
+    template <typename TryTake>
+    bool block(TryTake tryTake, TickType_t ticksToWait) {
+        auto locked = [&tryTake] {
+            std::lock_guard<std::mutex> lock(objectsMutex);
+            return tryTake();
+        };
+
+        HostKernel* kernel = HostKernel::current();
+        if (kernel != nullptr) {
+            int64_t deadlineUs = ticksToWait == portMAX_DELAY ? INT64_MAX
+                                                              : kernel->nowUs() + ticksToWait * 1000LL * portTICK_PERIOD_MS;
+            return kernel->waitUntil(locked, deadlineUs);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        while (!locked()) {
+            if (ticksToWait != portMAX_DELAY &&
+                std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(ticksToWait * portTICK_PERIOD_MS)) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        return true;
+    }
+
+    void signalWaiters() {
+        HostKernel* kernel = HostKernel::current();
+        if (kernel != nullptr) {
+            kernel->wakeAll();
+        }
+    }
+}
+
+// -- Tasks
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stackDepth, void* parameter,
+                                   UBaseType_t priority, TaskHandle_t* createdTask, BaseType_t coreId) {
+    HostKernel* kernel = HostKernel::current();
+    HostContext* context;
+    if (kernel != nullptr) {
+        context = kernel->createTask([function, parameter] { function(parameter); }, name, priority, stackDepth);
+    } else {
+        // Real time: a detached host thread, the tools using it never stop their tasks
+        std::thread([function, parameter] { function(parameter); }).detach();
+        context = nullptr;
+    }
+    if (createdTask != nullptr) {
+        *createdTask = context;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stackDepth, void* parameter,
+                       UBaseType_t priority, TaskHandle_t* createdTask) {
+    return xTaskCreatePinnedToCore(function, name, stackDepth, parameter, priority, createdTask, 0);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    HostKernel* kernel = HostKernel::current();
+    if (kernel == nullptr || (task != nullptr && task != kernel->currentContext())) {
+        fprintf(stderr, "vTaskDelete: only a task deleting itself is supported\n");
+        abort();
+    }
+    kernel->exitTask();
+}
+
+void vTaskDelay(TickType_t ticks) {
+    delay(ticks * portTICK_PERIOD_MS);
+}
+
+void vTaskDelayUntil(TickType_t* previousWakeTime, TickType_t timeIncrement) {
+    *previousWakeTime += timeIncrement;
+    TickType_t now = xTaskGetTickCount();
+    if (static_cast<int32_t>(*previousWakeTime - now) > 0) {
+        vTaskDelay(*previousWakeTime - now);
+    }
+}
+
+TickType_t xTaskGetTickCount() {
+    return static_cast<TickType_t>(millis() / portTICK_PERIOD_MS);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    HostKernel* kernel = HostKernel::current();
+    return kernel != nullptr ? kernel->currentContext() : &realTimeContext;
+}
+
+const char* pcTaskGetName(TaskHandle_t task) {
+    if (task == nullptr) {
+        task = xTaskGetCurrentTaskHandle();
+    }
+    return task->name.c_str();
+}
+
+TaskHandle_t xTaskGetHandle(const char* name) {
+    HostKernel* kernel = HostKernel::current();
+    return kernel != nullptr ? kernel->findTask(name) : nullptr;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+    HostKernel* kernel = HostKernel::current();
+    if (kernel == nullptr) {
+        return 0;
+    }
+    if (task == nullptr) {
+        task = kernel->currentContext();
+    }
+    // The stack size is the one of the board, the use is scaled down to it
+    uint32_t usedBytes = (kernel->getStackUsed(task) + HostKernel::HOST_STACK_WORD_RATIO - 1) /
+                         HostKernel::HOST_STACK_WORD_RATIO;
+    return task->stackSize > usedBytes ? task->stackSize - usedBytes : 0;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    {
+        std::lock_guard<std::mutex> lock(objectsMutex);
+        task->notifyValue++;
+    }
+    signalWaiters();
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higherPriorityTaskWoken) {
+    xTaskNotifyGive(task);
+    if (higherPriorityTaskWoken != nullptr) {
+        *higherPriorityTaskWoken = pdTRUE;
+    }
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait) {
+    HostContext* self = xTaskGetCurrentTaskHandle();
+    uint32_t value = 0;
+    block([self, clearCountOnExit, &value] {
+        if (self->notifyValue == 0) {
+            return false;
+        }
+        value = self->notifyValue;
+        self->notifyValue = clearCountOnExit ? 0 : value - 1;
+        return true;
+    }, ticksToWait);
+    return value;
+}
+
+// -- Semaphores
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t* buffer) {
+    buffer->count = 0;
+    buffer->maxCount = 1;
+    buffer->dynamic = false;
+    return buffer;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+    return xSemaphoreCreateCounting(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    // No priority inheritance: the host kernel runs a single task at a time anyway
+    return xSemaphoreCreateCounting(1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount) {
+    StaticSemaphore_t* semaphore = new StaticSemaphore_t();
+    semaphore->count = initialCount;
+    semaphore->maxCount = maxCount;
+    semaphore->dynamic = true;
+    return semaphore;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+    // Statically allocated semaphores are owned by the caller
+    if (semaphore->dynamic) {
+        delete semaphore;
+    }
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticksToWait) {
+    return block([semaphore] {
+        if (semaphore->count == 0) {
+            return false;
+        }
+        semaphore->count--;
+        return true;
+    }, ticksToWait) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    {
+        std::lock_guard<std::mutex> lock(objectsMutex);
+        if (semaphore->count >= semaphore->maxCount) {
+            return pdFALSE;
+        }
+        semaphore->count++;
+    }
+    signalWaiters();
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t* higherPriorityTaskWoken) {
+    BaseType_t given = xSemaphoreGive(semaphore);
+    if (higherPriorityTaskWoken != nullptr) {
+        *higherPriorityTaskWoken = given;
+    }
+    return given;
+}
+
+UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t semaphore) {
+    std::lock_guard<std::mutex> lock(objectsMutex);
+    return semaphore->count;
+}
+
+// -- Queues
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    HostQueue* queue = new HostQueue();
+    queue->length = length;
+    queue->itemSize = itemSize;
+    queue->storage.resize(static_cast<size_t>(length) * itemSize);
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    delete queue;
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void* item, TickType_t ticksToWait) {
+    bool sent = block([queue, item] {
+        if (queue->count == queue->length) {
+            return false;
+        }
+        UBaseType_t tail = (queue->head + queue->count) % queue->length;
+        memcpy(&queue->storage[static_cast<size_t>(tail) * queue->itemSize], item, queue->itemSize);
+        queue->count++;
+        return true;
+    }, ticksToWait);
+    if (sent) {
+        signalWaiters();
+    }
+    return sent ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticksToWait) {
+    return xQueueSendToBack(queue, item, ticksToWait);
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void* item, BaseType_t* higherPriorityTaskWoken) {
+    BaseType_t sent = xQueueSendToBack(queue, item, 0);
+    if (higherPriorityTaskWoken != nullptr) {
+        *higherPriorityTaskWoken = sent;
+    }
+    return sent;
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void* item) {
+    {
+        std::lock_guard<std::mutex> lock(objectsMutex);
+        queue->head = 0;
+        queue->count = 1;
+        memcpy(queue->storage.data(), item, queue->itemSize);
+    }
+    signalWaiters();
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticksToWait) {
+    bool received = block([queue, item] {
+        if (queue->count == 0) {
+            return false;
+        }
+        memcpy(item, &queue->storage[static_cast<size_t>(queue->head) * queue->itemSize], queue->itemSize);
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        return true;
+    }, ticksToWait);
+    if (received) {
+        signalWaiters();
+    }
+    return received ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void* item, TickType_t ticksToWait) {
+    return block([queue, item] {
+        if (queue->count == 0) {
+            return false;
+        }
+        memcpy(item, &queue->storage[static_cast<size_t>(queue->head) * queue->itemSize], queue->itemSize);
+        return true;
+    }, ticksToWait) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+    {
+        std::lock_guard<std::mutex> lock(objectsMutex);
+        queue->head = 0;
+        queue->count = 0;
+    }
+    signalWaiters();
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> lock(objectsMutex);
+    return queue->count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> lock(objectsMutex);
+    return queue->length - queue->count;
+}
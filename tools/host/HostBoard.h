@@ -0,0 +1,105 @@
+#pragma once
+
+// Simulated board peripherals (GPIO, LEDC, I2S, LED strips, NVS, flash partitions, heap) behind the Arduino
+// replacements of the host tools. Each HostKernel owns a board, so parallel simulations never share pins or
+// storage; threads without a kernel share a process-wide board.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <map>
+#include <string>
+#include <vector>
+
+struct HostQueue;
+struct HostTimer;
+
+struct HostBoard {
+    static constexpr uint8_t PIN_COUNT = 64;
+    static constexpr uint8_t LEDC_CHANNELS = 16;
+    static constexpr uint8_t I2S_PORTS = 2;
+
+    struct Pin {
+        uint8_t mode = 0;
+        uint8_t level = 0;
+        int interruptMode = 0;
+        void (*handler)(void*) = nullptr;
+        void (*plainHandler)() = nullptr;
+        void* arg = nullptr;
+    };
+
+    struct LedcChannel {
+        uint32_t frequency = 0;
+        uint8_t resolutionBits = 0;
+        int pin = -1;
+        uint32_t duty = 0;
+        uint64_t writes = 0;
+    };
+
+    struct I2sPort {
+        uint32_t sampleRate = 44100;
+        uint32_t dmaBufferCount = 16;   // DMA buffers of the audio library configuration, until a driver install
+        uint32_t dmaBufferFrames = 512;
+        HostQueue* events = nullptr;    // Event queue given to i2s_driver_install, fed by dmaTimer
+        HostTimer* dmaTimer = nullptr;  // Fires each time the DMA finishes a buffer
+        uint64_t bufferEmptyEvents = 0; // I2S_EVENT_TX_Q_OVF posted: the DMA found every buffer empty
+        int64_t queuedUntilUs = 0;  // Virtual time when the DMA buffers run empty
+        uint64_t bytesWritten = 0;
+        uint32_t filesPlayed = 0;   // Files started by the audio library on this port
+        std::string lastFile;
+    };
+
+    struct LedStrip {
+        std::vector<uint32_t> pixels;   // 0xRRGGBB colors of the last frame shown
+        uint64_t frames = 0;
+        int64_t busyUntilUs = 0;        // Virtual time when the transfer of the last frame ends
+    };
+
+    Pin pins[PIN_COUNT];
+    LedcChannel ledc[LEDC_CHANNELS];
+    I2sPort i2s[I2S_PORTS];
+    std::map<uint8_t, LedStrip> ledStrips;  // By data pin
+
+    // NVS content by namespace and key, the storage of Preferences
+    std::map<std::string, std::map<std::string, std::vector<uint8_t>>> nvs;
+    uint64_t nvsWrites = 0;
+    uint64_t nvsBytesWritten = 0;
+
+    // Data partitions written by the firmware itself (see esp_partition.h), by label. NOR flash: erased bytes are
+    // 0xFF and a write only clears bits.
+    std::map<std::string, std::vector<uint8_t>> flash;
+    uint64_t flashWrites = 0;
+    uint64_t flashBytesWritten = 0;
+    uint64_t flashSectorErases = 0;
+    // Power cut injection: flash steps (a byte written or a sector erased) done before the power fails, negative
+    // for never. The step the power fails in is left half done, then every flash operation fails until the test
+    // "reboots" by clearing flashPowerCut.
+    int64_t flashStepsBeforePowerCut = -1;
+    bool flashPowerCut = false;
+    uint64_t flashNoiseState = 0x2545f4914f6cdd1dULL; // Bits of the half done steps
+
+    size_t psramAllocatedBytes = 0;             // Allocated with ps_malloc, the firmware never frees it
+    size_t minInternalFreeBytes = SIZE_MAX;     // Lowest free sizes returned by esp_heap_caps
+    size_t minPsramFreeBytes = SIZE_MAX;
+
+    uint64_t randomState = 0x853c49e6748fea9bULL;  // State of the Arduino random() generator
+
+    /**
+     * Drives the level of an input pin and runs the attached interrupt handler on a matching edge.
+     * @param pin GPIO number.
+     * @param level New level (LOW or HIGH).
+     */
+    void setPinLevel(uint8_t pin, uint8_t level);
+
+    /**
+     * Converts the duty cycle of a LEDC channel to the pulse width it outputs.
+     * @param channel LEDC channel.
+     * @return The high time of the PWM period in microseconds, 0 if the channel is not configured.
+     */
+    float getLedcPulseUs(uint8_t channel) const;
+};
+
+/**
+ * Gets the board of the calling thread: the one of its HostKernel, or the process-wide one in real time.
+ * @return The board.
+ */
+HostBoard& hostBoard();
@@ -0,0 +1,340 @@
+#include "HostKernel.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+    constexpr uint8_t kStackPaintPattern = 0xA5;   // The FreeRTOS stack fill byte
+    constexpr uint32_t kLoopTaskStackBytes = 8192;  // Arduino loop task (CONFIG_ARDUINO_LOOP_STACK_SIZE)
+
+    thread_local HostKernel* threadKernel = nullptr;
+    thread_local HostContext* threadContext = nullptr;
+
+    /**
+     * Fills the stack below the caller with the pattern, before the context code runs.
+     */
+    __attribute__((noinline)) void paintStack(HostContext* context) {
+        uint8_t area[HostKernel::STACK_PAINT_BYTES];
+        memset(area, kStackPaintPattern, sizeof(area));
+        // Only the address is kept, passed through the asm so the compiler neither drops the fill nor warns
+        uint8_t* end = area;
+        asm volatile("" : "+r"(end) : : "memory");
+        context->stackPaintEnd = end;
+    }
+}
+
+HostKernel::HostKernel(int64_t startUs) : virtualUs(startUs) {
+    if (threadKernel != nullptr) {
+        fprintf(stderr, "HostKernel: the thread already runs a kernel\n");
+        abort();
+    }
+    mainContext.name = "loopTask";
+    mainContext.priority = 1;
+    mainContext.isMain = true;
+    mainContext.stackSize = kLoopTaskStackBytes;
+    uint8_t top;
+    mainContext.stackTop = &top;
+    paintStack(&mainContext);
+    running = &mainContext;
+    threadKernel = this;
+    threadContext = &mainContext;
+}
+
+HostKernel::~HostKernel() {
+    std::unique_lock<std::mutex> lock(mutex);
+    stopping = true;
+
+    // Resume every task once: it unwinds from its blocking call and hands the control back
+    for (HostContext* task : tasks) {
+        if (!task->finished) {
+            running = task;
+            task->resume.notify_one();
+            mainContext.resume.wait(lock, [this] { return running == &mainContext; });
+        }
+    }
+    lock.unlock();
+
+    for (HostContext* task : tasks) {
+        task->thread.join();
+        delete task;
+    }
+    for (HostTimer* timer : timers) {
+        delete timer;
+    }
+    threadKernel = nullptr;
+    threadContext = nullptr;
+}
+
+HostKernel* HostKernel::current() {
+    return threadKernel;
+}
+
+HostContext* HostKernel::currentContext() const {
+    return threadContext;
+}
+
+HostContext* HostKernel::createTask(std::function<void()> body, const char* name, unsigned priority,
+                                    uint32_t stackSize) {
+    HostContext* context = new HostContext();
+    context->name = name != nullptr ? name : "";
+    context->priority = priority;
+    context->stackSize = stackSize;
+    context->body = std::move(body);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    makeReady(context, nowUs());
+    tasks.push_back(context);
+    context->thread = std::thread(&HostKernel::taskEntry, this, context);
+    return context;
+}
+
+void HostKernel::taskEntry(HostContext* context) {
+    threadKernel = this;
+    threadContext = context;
+    uint8_t top;
+    context->stackTop = &top;
+    paintStack(context);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    context->resume.wait(lock, [this, context] { return running == context; });
+    if (!stopping) {
+        lock.unlock();
+        try {
+            context->body();
+        } catch (const HostTaskExit&) {
+            // Task deleted or kernel destroyed
+        }
+        lock.lock();
+    }
+
+    context->finished = true;
+    context->wakeUs = INT64_MAX;
+    if (stopping) {
+        running = &mainContext;
+        mainContext.resume.notify_one();
+    } else {
+        schedule(lock, context);
+    }
+}
+
+void HostKernel::makeReady(HostContext* context, int64_t wakeUs) {
+    context->wakeUs = wakeUs;
+    context->readySequence = nextReadySequence++;
+}
+
+void HostKernel::sleepUntil(int64_t wakeUs) {
+    if (timerDepth > 0) {
+        fprintf(stderr, "HostKernel: blocking call inside the timer callback\n");
+        abort();
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    HostContext* self = threadContext;
+    makeReady(self, std::max(wakeUs, nowUs()));
+    schedule(lock, self);
+}
+
+bool HostKernel::waitUntil(const std::function<bool()>& ready, int64_t deadlineUs) {
+    while (true) {
+        if (ready()) {
+            return true;
+        }
+        if (nowUs() >= deadlineUs) {
+            return false;
+        }
+        if (timerDepth > 0) {
+            fprintf(stderr, "HostKernel: blocking call inside the timer callback\n");
+            abort();
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        HostContext* self = threadContext;
+        makeReady(self, deadlineUs);
+        waiting.push_back(self);
+        schedule(lock, self);
+        waiting.erase(std::remove(waiting.begin(), waiting.end(), self), waiting.end());
+    }
+}
+
+void HostKernel::wake(HostContext* context) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (std::find(waiting.begin(), waiting.end(), context) != waiting.end() && context->wakeUs > nowUs()) {
+        makeReady(context, nowUs());
+    }
+}
+
+void HostKernel::wakeAll() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (HostContext* context : waiting) {
+        if (context->wakeUs > nowUs()) {
+            makeReady(context, nowUs());
+        }
+    }
+}
+
+void HostKernel::exitTask() {
+    if (threadContext == &mainContext) {
+        fprintf(stderr, "HostKernel: the main context cannot be deleted\n");
+        abort();
+    }
+    throw HostTaskExit();
+}
+
+void HostKernel::schedule(std::unique_lock<std::mutex>& lock, HostContext* self) {
+    self->blockedSinceUs = nowUs();
+    while (true) {
+        if (stopping && !self->isMain) {
+            throw HostTaskExit();
+        }
+
+        HostTimer* timer = nullptr;
+        for (HostTimer* candidate : timers) {
+            if (candidate->active && (timer == nullptr || candidate->nextUs < timer->nextUs)) {
+                timer = candidate;
+            }
+        }
+
+        // Earliest wake time first, then highest priority, then first made ready
+        HostContext* next = mainContext.finished ? nullptr : &mainContext;
+        for (HostContext* candidate : tasks) {
+            if (candidate->finished) {
+                continue;
+            }
+            if (next == nullptr || candidate->wakeUs < next->wakeUs ||
+                (candidate->wakeUs == next->wakeUs && (candidate->priority > next->priority ||
+                 (candidate->priority == next->priority && candidate->readySequence < next->readySequence)))) {
+                next = candidate;
+            }
+        }
+
+        if (timer != nullptr && (next == nullptr || timer->nextUs <= next->wakeUs)) {
+            virtualUs.store(std::max(nowUs(), timer->nextUs), std::memory_order_release);
+            if (timer->periodUs > 0) {
+                timer->nextUs += timer->periodUs;
+            } else {
+                timer->active = false;
+            }
+            timer->fired++;
+            timerCallbacks++;
+            timerDepth++;
+            lock.unlock();
+            timer->callback(timer->arg);
+            lock.lock();
+            timerDepth--;
+            continue;
+        }
+
+        if (next == nullptr || next->wakeUs == INT64_MAX) {
+            fprintf(stderr, "HostKernel: deadlock, every task is blocked forever\n");
+            abort();
+        }
+        int64_t previousUs = nowUs();
+        virtualUs.store(std::max(previousUs, next->wakeUs), std::memory_order_release);
+        checkProgress(previousUs);
+        next->maxBlockedUs = std::max(next->maxBlockedUs, nowUs() - next->blockedSinceUs);
+        if (next != self) {
+            switchTo(lock, self, next);
+            if (stopping && !self->isMain) {
+                throw HostTaskExit();
+            }
+        }
+        return;
+    }
+}
+
+void HostKernel::checkProgress(int64_t previousUs) {
+    // Tasks polling without ever sleeping (e.g. a loop on yield) would stop the clock and hang the simulation
+    constexpr uint64_t kMaxRunsAtSameTime = 1000000;
+    if (nowUs() != previousUs) {
+        runsAtSameTime = 0;
+        return;
+    }
+    if (++runsAtSameTime < kMaxRunsAtSameTime) {
+        return;
+    }
+    fprintf(stderr, "HostKernel: livelock, the virtual clock is stuck at %lld us while the tasks keep running:\n",
+            static_cast<long long>(nowUs()));
+    std::vector<HostContext*> contexts = tasks;
+    contexts.insert(contexts.begin(), &mainContext);
+    for (HostContext* context : contexts) {
+        if (!context->finished && context->wakeUs <= nowUs()) {
+            fprintf(stderr, "  %s (priority %u)\n", context->name.c_str(), context->priority);
+        }
+    }
+    abort();
+}
+
+void HostKernel::switchTo(std::unique_lock<std::mutex>& lock, HostContext* self, HostContext* next) {
+    running = next;
+    contextSwitches++;
+    next->switchesIn++;
+    next->resume.notify_one();
+    if (self->finished) {
+        return;
+    }
+    self->resume.wait(lock, [this, self] { return running == self; });
+}
+
+HostTimer* HostKernel::createTimer(void (*callback)(void*), void* arg, const char* name) {
+    HostTimer* timer = new HostTimer();
+    timer->callback = callback;
+    timer->arg = arg;
+    timer->name = name != nullptr ? name : "";
+
+    std::lock_guard<std::mutex> lock(mutex);
+    timers.push_back(timer);
+    return timer;
+}
+
+void HostKernel::startTimer(HostTimer* timer, int64_t delayUs, int64_t periodUs) {
+    std::lock_guard<std::mutex> lock(mutex);
+    timer->nextUs = nowUs() + delayUs;
+    timer->periodUs = periodUs;
+    timer->active = true;
+}
+
+void HostKernel::stopTimer(HostTimer* timer) {
+    std::lock_guard<std::mutex> lock(mutex);
+    timer->active = false;
+}
+
+void HostKernel::deleteTimer(HostTimer* timer) {
+    std::lock_guard<std::mutex> lock(mutex);
+    timers.erase(std::remove(timers.begin(), timers.end(), timer), timers.end());
+    delete timer;
+}
+
+std::vector<HostContext*> HostKernel::getTasks() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return tasks;
+}
+
+HostContext* HostKernel::findTask(const char* name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (mainContext.name == name) {
+        return &mainContext;
+    }
+    for (HostContext* task : tasks) {
+        if (task->name == name) {
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+uint32_t HostKernel::getStackUsed(const HostContext* context) const {
+    if (context->stackPaintEnd == nullptr) {
+        return 0;   // Not started yet
+    }
+    const uint8_t* deepest = context->stackPaintEnd;
+    const uint8_t* top = context->stackTop;
+    while (deepest < top && *deepest == kStackPaintPattern) {
+        deepest++;
+    }
+    return static_cast<uint32_t>(std::min<ptrdiff_t>(top - deepest, STACK_PAINT_BYTES));
+}
+
+HostKernelStats HostKernel::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return {contextSwitches, timerCallbacks, nowUs()};
+}
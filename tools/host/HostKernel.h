@@ -0,0 +1,235 @@
+#pragma once
+
+// Virtual-time cooperative kernel used to run firmware code on Linux faster than real time.
+//
+// Every FreeRTOS task is a host thread, but only one of them runs at a time: a task runs until it blocks
+// (delay, semaphore, queue, notification), then the kernel advances the virtual clock to the next event and
+// resumes the task or fires the esp_timer callback due at that time. Runs are therefore deterministic and as
+// fast as the code itself, independently of the virtual durations slept.
+//
+// The thread creating the kernel becomes its main context (the Arduino loop task). Each simulation owns its
+// kernel, so several simulations can run in parallel on different threads. Without a kernel the Arduino and
+// FreeRTOS replacements fall back to the real clock, as the controller harness expects.
+
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "HostBoard.h"
+
+/**
+ * Thrown inside the tasks to unwind them when the kernel is destroyed or when a task deletes itself.
+ * Firmware code never catches it since it does not use exceptions.
+ */
+struct HostTaskExit {};
+
+class HostKernel;
+
+/**
+ * Execution context of a task (or of the main thread) scheduled by a HostKernel.
+ */
+struct HostContext {
+    std::string name;
+    unsigned priority = 0;
+    uint32_t stackSize = 0;
+    std::function<void()> body;
+    std::thread thread;
+    std::condition_variable resume;
+    int64_t wakeUs = 0;         // Virtual time when the context becomes runnable, INT64_MAX while blocked
+    uint64_t readySequence = 0; // Keeps the contexts ready at the same time in FIFO order
+    bool finished = false;
+    bool isMain = false;
+    uint32_t notifyValue = 0;   // FreeRTOS direct to task notification count
+    uint64_t switchesIn = 0;    // Times the context was resumed
+    int64_t blockedSinceUs = 0; // Virtual time of the last blocking call
+    int64_t maxBlockedUs = 0;   // Longest virtual time spent in a blocking call
+    uint8_t* stackTop = nullptr;        // Stack pointer when the context started
+    uint8_t* stackPaintEnd = nullptr;   // Deepest byte of the painted stack area, below stackTop
+};
+
+/**
+ * One-shot or periodic callback fired at a virtual time, the esp_timer replacement.
+ */
+struct HostTimer {
+    void (*callback)(void*) = nullptr;
+    void* arg = nullptr;
+    std::string name;
+    int64_t nextUs = 0;
+    int64_t periodUs = 0;
+    bool active = false;
+    uint64_t fired = 0;
+};
+
+/**
+ * Counters of a kernel run, to compare the virtual and the host execution time.
+ */
+struct HostKernelStats {
+    uint64_t contextSwitches;
+    uint64_t timerCallbacks;
+    int64_t virtualUs;
+};
+
+class HostKernel {
+public:
+    static constexpr uint32_t STACK_PAINT_BYTES = 64 * 1024;
+    // The host stack frames hold 8 byte words where the ESP32 ones hold 4 byte words: the stack use of a task on
+    // the board is estimated as its host use divided by this ratio
+    static constexpr uint32_t HOST_STACK_WORD_RATIO = 2;
+
+    /**
+     * Creates a kernel and makes the calling thread its main context.
+     * @param startUs Initial virtual time in microseconds. Not zero by default since firmware code often uses
+     *                a zero timestamp as "never".
+     */
+    explicit HostKernel(int64_t startUs = 1000000);
+
+    /**
+     * Unwinds and joins all the tasks. Must be called from the main context.
+     */
+    ~HostKernel();
+
+    HostKernel(const HostKernel&) = delete;
+    HostKernel& operator=(const HostKernel&) = delete;
+
+    /**
+     * Gets the kernel scheduling the calling thread.
+     * @return The kernel, or nullptr when the calling thread runs in real time.
+     */
+    static HostKernel* current();
+
+    /**
+     * Gets the virtual time.
+     * @return The virtual time in microseconds.
+     */
+    int64_t nowUs() const {
+        return virtualUs.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Creates a task. The task runs when the creator blocks, like a task of the same priority on one core.
+     * @param body Task function.
+     * @param name Task name.
+     * @param priority Task priority, higher runs first among the tasks ready at the same virtual time.
+     * @param stackSize Stack size requested by the firmware, only reported.
+     * @return The task context, usable as a TaskHandle_t.
+     */
+    HostContext* createTask(std::function<void()> body, const char* name, unsigned priority, uint32_t stackSize);
+
+    /**
+     * Gets the context of the calling task.
+     * @return The context of the running task.
+     */
+    HostContext* currentContext() const;
+
+    /**
+     * Blocks the calling task until a virtual time, running the other tasks and the timers due before.
+     * @param wakeUs Virtual time to wake up at.
+     */
+    void sleepUntil(int64_t wakeUs);
+
+    /**
+     * Blocks the calling task until a condition holds or a deadline expires. The condition is checked again
+     * each time the task is woken by wake().
+     * @param ready Condition to wait for, checked with the kernel running only this task.
+     * @param deadlineUs Virtual time to give up at, INT64_MAX to wait forever.
+     * @return true if the condition holds, false on timeout.
+     */
+    bool waitUntil(const std::function<bool()>& ready, int64_t deadlineUs);
+
+    /**
+     * Makes a blocked task runnable, so it checks its wait condition again.
+     * @param context The task to wake.
+     */
+    void wake(HostContext* context);
+
+    /**
+     * Wakes every task blocked in waitUntil, the simplest correct policy for the few waiters of a simulation.
+     */
+    void wakeAll();
+
+    /**
+     * Ends the calling task, like vTaskDelete(NULL).
+     */
+    [[noreturn]] void exitTask();
+
+    HostTimer* createTimer(void (*callback)(void*), void* arg, const char* name);
+    void startTimer(HostTimer* timer, int64_t delayUs, int64_t periodUs);
+    void stopTimer(HostTimer* timer);
+    void deleteTimer(HostTimer* timer);
+
+    /**
+     * Checks if the code runs inside a timer callback, where blocking is not allowed.
+     * @return true inside a timer callback.
+     */
+    bool inTimerCallback() const {
+        return timerDepth > 0;
+    }
+
+    /**
+     * Gets the tasks created so far, finished ones included.
+     * @return The task contexts in creation order.
+     */
+    std::vector<HostContext*> getTasks() const;
+
+    /**
+     * Gets the context of the thread that created the kernel.
+     * @return The main context.
+     */
+    const HostContext* getMainContext() const {
+        return &mainContext;
+    }
+
+    /**
+     * Gets the task with a name.
+     * @param name Task name.
+     * @return The task context (the main one included), or nullptr if there is none.
+     */
+    HostContext* findTask(const char* name);
+
+    /**
+     * Measures the deepest stack use of a context since it started. The stack below the context start is painted
+     * with a pattern, the measure is the deepest byte overwritten. Host stack frames are larger than the ESP32
+     * ones, the figure is an upper bound of the board use.
+     * @param context The context to measure, running or not.
+     * @return The stack used in bytes, at most STACK_PAINT_BYTES.
+     */
+    uint32_t getStackUsed(const HostContext* context) const;
+
+    HostKernelStats getStats() const;
+
+    /**
+     * Gets the simulated peripherals of this kernel.
+     * @return The board.
+     */
+    HostBoard& getBoard() {
+        return board;
+    }
+
+private:
+    HostBoard board;
+    mutable std::mutex mutex;
+    std::atomic<int64_t> virtualUs;
+    HostContext mainContext;
+    std::vector<HostContext*> tasks;
+    std::vector<HostTimer*> timers;
+    std::vector<HostContext*> waiting;  // Contexts blocked in waitUntil
+    HostContext* running = nullptr;
+    uint64_t nextReadySequence = 0;
+    bool stopping = false;
+    int timerDepth = 0;
+    uint64_t contextSwitches = 0;
+    uint64_t timerCallbacks = 0;
+    uint64_t runsAtSameTime = 0;    // Consecutive scheduling decisions without the virtual clock advancing
+
+    void makeReady(HostContext* context, int64_t wakeUs);
+    void schedule(std::unique_lock<std::mutex>& lock, HostContext* self);
+    void switchTo(std::unique_lock<std::mutex>& lock, HostContext* self, HostContext* next);
+    void taskEntry(HostContext* context);
+    void checkProgress(int64_t previousUs);
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+// NeoPixelBus replacement for the host tools. The frames shown are copied to the LED strip of the HostBoard on
+// the data pin, and Show waits for the end of the previous transfer like the DMA methods of the library.
+
+#include "Arduino.h"
+#include "HostBoard.h"
+
+#include <vector>
+
+struct RgbColor {
+    uint8_t R = 0;
+    uint8_t G = 0;
+    uint8_t B = 0;
+
+    RgbColor() {}
+    RgbColor(uint8_t r, uint8_t g, uint8_t b) : R(r), G(g), B(b) {}
+    RgbColor(uint8_t brightness) : R(brightness), G(brightness), B(brightness) {}
+
+    bool operator==(const RgbColor& other) const { return R == other.R && G == other.G && B == other.B; }
+    bool operator!=(const RgbColor& other) const { return !(*this == other); }
+
+    /**
+     * Scales the color.
+     * @param ratio Scale in 1/255 units.
+     */
+    RgbColor Dim(uint8_t ratio) const {
+        return RgbColor(dim(R, ratio), dim(G, ratio), dim(B, ratio));
+    }
+
+    uint8_t CalculateBrightness() const {
+        return static_cast<uint8_t>((static_cast<uint16_t>(R) + G + B) / 3);
+    }
+
+    static RgbColor LinearBlend(const RgbColor& left, const RgbColor& right, float progress) {
+        return RgbColor(left.R + static_cast<int16_t>((right.R - left.R) * progress),
+                        left.G + static_cast<int16_t>((right.G - left.G) * progress),
+                        left.B + static_cast<int16_t>((right.B - left.B) * progress));
+    }
+
+private:
+    static uint8_t dim(uint8_t value, uint8_t ratio) {
+        return static_cast<uint8_t>((static_cast<uint16_t>(value) * (static_cast<uint16_t>(ratio) + 1)) >> 8);
+    }
+};
+
+// Color features and methods only select the hardware path on the board
+struct NeoGrbFeature {};
+struct NeoEsp32LcdX8Ws2812xMethod {};
+struct NeoEsp32I2s0Ws2812xMethod {};
+struct NeoEsp32I2s1Ws2812xMethod {};
+struct NeoEsp32Rmt0Ws2812xMethod {};
+
+template <typename Feature, typename Method>
+class NeoPixelBus {
+public:
+    static constexpr int64_t WS2812X_PIXEL_US = 30;     // 24 bits at 800 kHz, plus the reset time per frame
+    static constexpr int64_t WS2812X_RESET_US = 300;
+
+    NeoPixelBus(uint16_t count, uint8_t pin) : pixels(count), pin(pin) {}
+
+    void Begin() {}
+
+    bool CanShow() const {
+        return hostBoard().ledStrips[pin].busyUntilUs <= static_cast<int64_t>(micros());
+    }
+
+    void Show() {
+        HostBoard::LedStrip& strip = hostBoard().ledStrips[pin];
+        int64_t nowUs = static_cast<int64_t>(micros());
+        if (strip.busyUntilUs > nowUs) {
+            delayMicroseconds(static_cast<unsigned int>(strip.busyUntilUs - nowUs));
+            nowUs = strip.busyUntilUs;
+        }
+        strip.pixels.resize(pixels.size());
+        for (size_t i = 0; i < pixels.size(); i++) {
+            strip.pixels[i] = (static_cast<uint32_t>(pixels[i].R) << 16) | (pixels[i].G << 8) | pixels[i].B;
+        }
+        strip.frames++;
+        strip.busyUntilUs = nowUs + WS2812X_PIXEL_US * pixels.size() + WS2812X_RESET_US;
+    }
+
+    uint16_t PixelCount() const { return static_cast<uint16_t>(pixels.size()); }
+
+    void SetPixelColor(uint16_t index, const RgbColor& color) {
+        if (index < pixels.size()) {
+            pixels[index] = color;
+        }
+    }
+
+    RgbColor GetPixelColor(uint16_t index) const {
+        return index < pixels.size() ? pixels[index] : RgbColor();
+    }
+
+    void ClearTo(const RgbColor& color) {
+        std::fill(pixels.begin(), pixels.end(), color);
+    }
+
+private:
+    std::vector<RgbColor> pixels;
+    uint8_t pin;
+};
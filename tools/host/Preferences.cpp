@@ -0,0 +1,78 @@
+#include "Preferences.h"
+#include "HostBoard.h"
+
+bool Preferences::begin(const char* name, bool readOnly) {
+    if (name == nullptr || strlen(name) > 15) {
+        return false;
+    }
+    this->name = name;
+    this->readOnly = readOnly;
+    opened = true;
+    return true;
+}
+
+void Preferences::end() {
+    opened = false;
+}
+
+bool Preferences::clear() {
+    if (!opened || readOnly) {
+        return false;
+    }
+    hostBoard().nvs.erase(name);
+    return true;
+}
+
+bool Preferences::remove(const char* key) {
+    if (!opened || readOnly) {
+        return false;
+    }
+    return hostBoard().nvs[name].erase(key) > 0;
+}
+
+bool Preferences::isKey(const char* key) {
+    if (!opened) {
+        return false;
+    }
+    auto& keys = hostBoard().nvs[name];
+    return keys.find(key) != keys.end();
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t length) {
+    if (!opened || readOnly || key == nullptr || strlen(key) > 15) {
+        return 0;
+    }
+    HostBoard& board = hostBoard();
+    const uint8_t* bytes = static_cast<const uint8_t*>(value);
+    board.nvs[name][key].assign(bytes, bytes + length);
+    board.nvsWrites++;
+    board.nvsBytesWritten += length;
+    return length;
+}
+
+size_t Preferences::getBytesLength(const char* key) {
+    if (!opened) {
+        return 0;
+    }
+    auto& keys = hostBoard().nvs[name];
+    auto entry = keys.find(key);
+    return entry != keys.end() ? entry->second.size() : 0;
+}
+
+size_t Preferences::getBytes(const char* key, void* buffer, size_t maxLength) {
+    if (!opened) {
+        return 0;
+    }
+    auto& keys = hostBoard().nvs[name];
+    auto entry = keys.find(key);
+    if (entry == keys.end() || entry->second.size() > maxLength) {
+        return 0;
+    }
+    memcpy(buffer, entry->second.data(), entry->second.size());
+    return entry->second.size();
+}
+
+uint32_t Preferences::getUInt(const char* key, uint32_t defaultValue) {
+    uint32_t value;
+    return getBytes(key, &value, sizeof(value)) == sizeof(value) ? value : defaultValue;
+}
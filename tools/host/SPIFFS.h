@@ -0,0 +1,19 @@
+#pragma once
+
+#include "FS.h"
+
+namespace fs {
+
+class SPIFFSFS : public FS {
+public:
+    /**
+     * Mounts the file system. Fails when the host directory does not exist, as with a missing partition.
+     */
+    bool begin(bool formatOnFail = false, const char* basePath = "/spiffs", uint8_t maxOpenFiles = 10,
+               const char* partitionLabel = nullptr);
+    void end() { mounted = false; }
+};
+
+}
+
+extern fs::SPIFFSFS SPIFFS;
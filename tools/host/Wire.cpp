@@ -0,0 +1,89 @@
+#include "Wire.h"
+#include "HostKernel.h"
+
+TwoWire Wire(0);
+TwoWire Wire1(1);
+
+bool TwoWire::begin(int sda, int scl, uint32_t frequency) {
+    if (frequency != 0) {
+        clockHz = frequency;
+    }
+    return true;
+}
+
+bool TwoWire::setClock(uint32_t frequency) {
+    clockHz = frequency;
+    return true;
+}
+
+void TwoWire::attachDevice(uint8_t address, HostI2CDevice* device) {
+    if (address < 128) {
+        devices[address] = device;
+    }
+}
+
+void TwoWire::waitBusTime(size_t bytes) {
+    // Start, address byte, data bytes and stop: 9 clocks per byte with the acknowledge bit
+    int64_t durationUs = static_cast<int64_t>((bytes + 1) * 9 * 1000000ULL / clockHz) + 1;
+    transactions++;
+    busyUs += durationUs;
+    HostKernel* kernel = HostKernel::current();
+    if (kernel != nullptr) {
+        kernel->sleepUntil(kernel->nowUs() + durationUs);
+    }
+}
+
+void TwoWire::beginTransmission(uint16_t address) {
+    txAddress = static_cast<uint8_t>(address);
+    txBuffer.clear();
+}
+
+uint8_t TwoWire::endTransmission(bool sendStop) {
+    HostI2CDevice* device = txAddress < 128 ? devices[txAddress] : nullptr;
+    waitBusTime(txBuffer.size());
+    if (device == nullptr) {
+        return 2;   // Address NACK
+    }
+    return device->onWrite(txBuffer.data(), txBuffer.size()) ? 0 : 3;
+}
+
+uint8_t TwoWire::requestFrom(uint16_t address, uint8_t quantity, bool sendStop) {
+    rxBuffer.clear();
+    rxIndex = 0;
+    HostI2CDevice* device = address < 128 ? devices[address] : nullptr;
+    waitBusTime(quantity);
+    if (device == nullptr || quantity > BUFFER_LENGTH) {
+        return 0;
+    }
+    rxBuffer.resize(quantity);
+    rxBuffer.resize(device->onRead(rxBuffer.data(), quantity));
+    return static_cast<uint8_t>(rxBuffer.size());
+}
+
+size_t TwoWire::write(uint8_t data) {
+    if (txBuffer.size() >= BUFFER_LENGTH) {
+        return 0;
+    }
+    txBuffer.push_back(data);
+    return 1;
+}
+
+size_t TwoWire::write(const uint8_t* data, size_t length) {
+    size_t written = 0;
+    while (written < length && write(data[written]) == 1) {
+        written++;
+    }
+    return written;
+}
+
+int TwoWire::available() {
+    return static_cast<int>(rxBuffer.size() - rxIndex);
+}
+
+int TwoWire::read() {
+    return rxIndex < rxBuffer.size() ? rxBuffer[rxIndex++] : -1;
+}
+
+int TwoWire::peek() {
+    return rxIndex < rxBuffer.size() ? rxBuffer[rxIndex] : -1;
+}
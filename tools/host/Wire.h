@@ -0,0 +1,79 @@
+#pragma once
+
+// TwoWire replacement for the host tools. Simulated devices are attached to a bus at their address; the
+// transactions take the time of the bytes on the wire at the bus clock, on the virtual clock of the caller.
+
+#include "Arduino.h"
+
+#include <vector>
+
+/**
+ * Simulated I2C device. The register pointer, if any, is managed by the device.
+ */
+class HostI2CDevice {
+public:
+    virtual ~HostI2CDevice() {}
+
+    /**
+     * Handles a write transaction (usually a register address followed by the data to write to it).
+     * @param data Bytes written after the address byte.
+     * @param length Number of bytes written.
+     * @return true to acknowledge, false to NACK.
+     */
+    virtual bool onWrite(const uint8_t* data, size_t length) = 0;
+
+    /**
+     * Handles a read transaction.
+     * @param buffer Where to store the bytes read.
+     * @param length Number of bytes requested.
+     * @return The number of bytes returned.
+     */
+    virtual size_t onRead(uint8_t* buffer, size_t length) = 0;
+};
+
+class TwoWire : public Stream {
+public:
+    static constexpr size_t BUFFER_LENGTH = 128;
+
+    explicit TwoWire(uint8_t busNumber) : busNumber(busNumber) {}
+
+    bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0);
+    bool setClock(uint32_t frequency);
+    uint32_t getClock() const { return clockHz; }
+
+    void beginTransmission(uint16_t address);
+    uint8_t endTransmission(bool sendStop = true);
+    uint8_t requestFrom(uint16_t address, uint8_t quantity, bool sendStop = true);
+
+    size_t write(uint8_t data) override;
+    size_t write(const uint8_t* data, size_t length) override;
+    int available() override;
+    int read() override;
+    int peek();
+
+    /**
+     * Attaches a simulated device.
+     * @param address 7-bit address of the device.
+     * @param device The device, or nullptr to detach the address.
+     */
+    void attachDevice(uint8_t address, HostI2CDevice* device);
+
+    uint64_t getTransactions() const { return transactions; }
+    int64_t getBusyUs() const { return busyUs; }
+
+private:
+    uint8_t busNumber;
+    uint32_t clockHz = 100000;
+    HostI2CDevice* devices[128] = {};
+    uint8_t txAddress = 0;
+    std::vector<uint8_t> txBuffer;
+    std::vector<uint8_t> rxBuffer;
+    size_t rxIndex = 0;
+    uint64_t transactions = 0;
+    int64_t busyUs = 0;
+
+    void waitBusTime(size_t bytes);
+};
+
+extern TwoWire Wire;
+extern TwoWire Wire1;
@@ -0,0 +1,112 @@
+#pragma once
+
+// I2S driver replacement for the host tools. The samples are not played: each port tracks how much audio its
+// DMA buffers hold on the virtual clock, so writes block like on the board once the buffers are full. A driver
+// installed with an event queue gets the DMA buffer events on the virtual clock, like the legacy driver ISR.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "../esp_err.h"
+#include "../freertos/FreeRTOS.h"
+#include "../freertos/queue.h"
+
+#define ESP_INTR_FLAG_LEVEL1 (1 << 1)  // From esp_intr_alloc.h, included by the driver on the board
+
+typedef enum {
+    I2S_NUM_0 = 0,
+    I2S_NUM_1 = 1,
+    I2S_NUM_MAX
+} i2s_port_t;
+
+typedef enum {
+    I2S_MODE_MASTER = 1 << 0,
+    I2S_MODE_SLAVE = 1 << 1,
+    I2S_MODE_TX = 1 << 2,
+    I2S_MODE_RX = 1 << 3
+} i2s_mode_t;
+
+typedef enum {
+    I2S_BITS_PER_SAMPLE_8BIT = 8,
+    I2S_BITS_PER_SAMPLE_16BIT = 16,
+    I2S_BITS_PER_SAMPLE_24BIT = 24,
+    I2S_BITS_PER_SAMPLE_32BIT = 32
+} i2s_bits_per_sample_t;
+
+typedef enum {
+    I2S_CHANNEL_FMT_RIGHT_LEFT,
+    I2S_CHANNEL_FMT_ALL_RIGHT,
+    I2S_CHANNEL_FMT_ALL_LEFT,
+    I2S_CHANNEL_FMT_ONLY_RIGHT,
+    I2S_CHANNEL_FMT_ONLY_LEFT
+} i2s_channel_fmt_t;
+
+typedef enum {
+    I2S_COMM_FORMAT_STAND_I2S = 0x01,
+    I2S_COMM_FORMAT_STAND_MSB = 0x02
+} i2s_comm_format_t;
+
+/**
+ * Driver configuration, the fields of the legacy driver used by the firmware. Only the DMA buffer geometry and
+ * the sample rate are simulated.
+ */
+typedef struct {
+    i2s_mode_t mode;
+    uint32_t sample_rate;
+    i2s_bits_per_sample_t bits_per_sample;
+    i2s_channel_fmt_t channel_format;
+    i2s_comm_format_t communication_format;
+    int intr_alloc_flags;
+    int dma_buf_count;
+    int dma_buf_len;        // Frames per DMA buffer
+    bool use_apll;
+    bool tx_desc_auto_clear;
+    int fixed_mclk;
+} i2s_config_t;
+
+typedef enum {
+    I2S_EVENT_DMA_ERROR,
+    I2S_EVENT_TX_DONE,      // The DMA finished sending a buffer
+    I2S_EVENT_RX_DONE,
+    I2S_EVENT_TX_Q_OVF,     // The DMA found every buffer empty and sent silence
+    I2S_EVENT_RX_Q_OVF,
+    I2S_EVENT_MAX
+} i2s_event_type_t;
+
+typedef struct {
+    i2s_event_type_t type;
+    size_t size;
+} i2s_event_t;
+
+/**
+ * Installs the driver of a port. The DMA runs from the install on, a buffer every dma_buf_len frames, and posts
+ * its events to the queue when one is requested.
+ * @param port I2S port.
+ * @param config Driver configuration.
+ * @param queueSize Length of the event queue, 0 for no events.
+ * @param queue Output event queue, created by the driver. May be nullptr when queueSize is 0.
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG for a bad port or configuration.
+ */
+esp_err_t i2s_driver_install(i2s_port_t port, const i2s_config_t* config, int queueSize, QueueHandle_t* queue);
+
+esp_err_t i2s_driver_uninstall(i2s_port_t port);
+
+/**
+ * Queues samples in the DMA buffers of a port, 16-bit stereo frames at the port sample rate.
+ * @param port I2S port.
+ * @param src Samples.
+ * @param size Size of the samples in bytes.
+ * @param bytesWritten Output number of bytes queued.
+ * @param ticksToWait Longest time to wait for room in the DMA buffers.
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG for a bad port.
+ */
+esp_err_t i2s_write(i2s_port_t port, const void* src, size_t size, size_t* bytesWritten, TickType_t ticksToWait);
+
+esp_err_t i2s_set_sample_rates(i2s_port_t port, uint32_t rate);
+
+/**
+ * Drops the samples queued in the DMA buffers of a port, the buffers play silence until the next write.
+ * @param port I2S port.
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG for a bad port.
+ */
+esp_err_t i2s_zero_dma_buffer(i2s_port_t port);
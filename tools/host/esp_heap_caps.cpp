@@ -0,0 +1,89 @@
+#include "esp_heap_caps.h"
+#include "HostBoard.h"
+
+#include <malloc.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <new>
+
+namespace {
+    // A single malloc arena makes mallinfo2 cover the allocations of every thread, i.e. of every task
+    [[maybe_unused]] const int singleArena = mallopt(M_ARENA_MAX, 1);
+
+    size_t internalUsedBytes() {
+        struct mallinfo2 info = mallinfo2();
+        size_t usedBytes = info.uordblks + info.hblkhd;
+        size_t psramBytes = hostBoard().psramAllocatedBytes;
+        return usedBytes > psramBytes ? usedBytes - psramBytes : 0;
+    }
+
+    size_t freeBytes(uint32_t caps) {
+        HostBoard& board = hostBoard();
+        size_t free;
+        if (caps & MALLOC_CAP_SPIRAM) {
+            free = HOST_PSRAM_BYTES - std::min<size_t>(board.psramAllocatedBytes, HOST_PSRAM_BYTES);
+            board.minPsramFreeBytes = std::min(board.minPsramFreeBytes, free);
+        } else {
+            free = HOST_INTERNAL_HEAP_BYTES - std::min<size_t>(internalUsedBytes(), HOST_INTERNAL_HEAP_BYTES);
+            board.minInternalFreeBytes = std::min(board.minInternalFreeBytes, free);
+        }
+        return free;
+    }
+}
+
+size_t heap_caps_get_total_size(uint32_t caps) {
+    return (caps & MALLOC_CAP_SPIRAM) ? HOST_PSRAM_BYTES : HOST_INTERNAL_HEAP_BYTES;
+}
+
+size_t heap_caps_get_free_size(uint32_t caps) {
+    return freeBytes(caps);
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps) {
+    return freeBytes(caps);
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps) {
+    freeBytes(caps);
+    HostBoard& board = hostBoard();
+    return (caps & MALLOC_CAP_SPIRAM) ? board.minPsramFreeBytes : board.minInternalFreeBytes;
+}
+
+// The C++ library of the board allocates with malloc, the host one does not: these replacements route new and
+// delete to malloc and free, so the allocation wrappers of the firmware (SystemMonitor) see them like on the board
+void* operator new(size_t size) {
+    void* block = malloc(size > 0 ? size : 1);
+    if (block == nullptr) {
+        throw std::bad_alloc();
+    }
+    return block;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return malloc(size > 0 ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return malloc(size > 0 ? size : 1);
+}
+
+void operator delete(void* block) noexcept {
+    free(block);
+}
+
+void operator delete[](void* block) noexcept {
+    free(block);
+}
+
+void operator delete(void* block, size_t) noexcept {
+    free(block);
+}
+
+void operator delete[](void* block, size_t) noexcept {
+    free(block);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+// esp_heap_caps replacement for the host tools. The internal heap is the host heap, modeled as a region of
+// HOST_INTERNAL_HEAP_BYTES without fragmentation: its absolute free size means nothing, its changes do. PSRAM is
+// the share of the host heap allocated with ps_malloc.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define MALLOC_CAP_EXEC         (1 << 0)
+#define MALLOC_CAP_32BIT        (1 << 1)
+#define MALLOC_CAP_8BIT         (1 << 2)
+#define MALLOC_CAP_DMA          (1 << 3)
+#define MALLOC_CAP_SPIRAM       (1 << 10)
+#define MALLOC_CAP_INTERNAL     (1 << 11)
+#define MALLOC_CAP_DEFAULT      (1 << 12)
+
+#define HOST_INTERNAL_HEAP_BYTES    (64u * 1024 * 1024)
+#define HOST_PSRAM_BYTES            (8u * 1024 * 1024)
+
+size_t heap_caps_get_total_size(uint32_t caps);
+size_t heap_caps_get_free_size(uint32_t caps);
+size_t heap_caps_get_largest_free_block(uint32_t caps);
+
+/**
+ * Lowest free size seen by the calls of the heap_caps_get_xxx functions, the host does not track every allocation.
+ */
+size_t heap_caps_get_minimum_free_size(uint32_t caps);
@@ -0,0 +1,122 @@
+#include "esp_partition.h"
+#include "HostBoard.h"
+
+#include <string.h>
+
+namespace {
+    // The partitions of partitions/no_ota_spiffs_8MB.csv written through esp_partition (NVS and SPIFFS have
+    // replacements of their own)
+    const esp_partition_t kPartitions[] = {
+        {nullptr, (esp_partition_type_t)0x40, (esp_partition_subtype_t)0x00, 0x7EC000, 0x4000, "scores", false},
+    };
+
+    uint8_t noise(HostBoard& board) {
+        // xorshift64
+        board.flashNoiseState ^= board.flashNoiseState << 13;
+        board.flashNoiseState ^= board.flashNoiseState >> 7;
+        board.flashNoiseState ^= board.flashNoiseState << 17;
+        return (uint8_t)board.flashNoiseState;
+    }
+
+    /**
+     * Counts a flash step against the power cut budget of the board.
+     * @return false if the power fails during the step, which is then left half done.
+     */
+    bool powerLasts(HostBoard& board) {
+        if (board.flashStepsBeforePowerCut < 0) {
+            return true;
+        }
+        if (board.flashStepsBeforePowerCut == 0) {
+            board.flashPowerCut = true;
+            board.flashStepsBeforePowerCut = -1;
+            return false;
+        }
+        board.flashStepsBeforePowerCut--;
+        return true;
+    }
+
+    std::vector<uint8_t>* content(const esp_partition_t* partition, size_t offset, size_t size) {
+        if (partition == nullptr || offset > partition->size || size > partition->size - offset) {
+            return nullptr;
+        }
+        std::vector<uint8_t>& bytes = hostBoard().flash[partition->label];
+        if (bytes.size() != partition->size) {
+            bytes.assign(partition->size, 0xFF);
+        }
+        return &bytes;
+    }
+}
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char* label) {
+    for (const esp_partition_t& partition : kPartitions) {
+        if ((type == ESP_PARTITION_TYPE_ANY || partition.type == type) &&
+            (subtype == ESP_PARTITION_SUBTYPE_ANY || partition.subtype == subtype) &&
+            (label == nullptr || strcmp(partition.label, label) == 0)) {
+            return &partition;
+        }
+    }
+    return nullptr;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t src_offset, void* dst, size_t size) {
+    std::vector<uint8_t>* bytes = content(partition, src_offset, size);
+    if (bytes == nullptr || dst == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (hostBoard().flashPowerCut) {
+        return ESP_FAIL;
+    }
+    memcpy(dst, bytes->data() + src_offset, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t dst_offset, const void* src, size_t size) {
+    std::vector<uint8_t>* bytes = content(partition, dst_offset, size);
+    if (bytes == nullptr || src == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    HostBoard& board = hostBoard();
+    if (board.flashPowerCut) {
+        return ESP_FAIL;
+    }
+    board.flashWrites++;
+    const uint8_t* source = static_cast<const uint8_t*>(src);
+    for (size_t i = 0; i < size; i++) {
+        uint8_t& target = (*bytes)[dst_offset + i];
+        if (!powerLasts(board)) {
+            // Some of the bits to clear are cleared
+            target &= source[i] | noise(board);
+            return ESP_FAIL;
+        }
+        target &= source[i];
+        board.flashBytesWritten++;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size) {
+    std::vector<uint8_t>* bytes = content(partition, offset, size);
+    if (bytes == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (offset % SPI_FLASH_SEC_SIZE != 0 || size % SPI_FLASH_SEC_SIZE != 0) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    HostBoard& board = hostBoard();
+    if (board.flashPowerCut) {
+        return ESP_FAIL;
+    }
+    for (size_t sector = offset; sector < offset + size; sector += SPI_FLASH_SEC_SIZE) {
+        if (!powerLasts(board)) {
+            // Some of the bits of the sector are set
+            for (size_t i = sector; i < sector + SPI_FLASH_SEC_SIZE; i++) {
+                (*bytes)[i] |= noise(board);
+            }
+            return ESP_FAIL;
+        }
+        memset(bytes->data() + sector, 0xFF, SPI_FLASH_SEC_SIZE);
+        board.flashSectorErases++;
+    }
+    return ESP_OK;
+}
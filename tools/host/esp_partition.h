@@ -0,0 +1,59 @@
+#pragma once
+
+// esp_partition replacement for the host tools. The partitions the firmware writes itself are those of
+// partitions/no_ota_spiffs_8MB.csv, their content is in the HostBoard of the calling thread (initially erased) with
+// the power cut injection of the board.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+
+#define SPI_FLASH_SEC_SIZE 4096
+
+typedef enum {
+    ESP_PARTITION_TYPE_APP = 0x00,
+    ESP_PARTITION_TYPE_DATA = 0x01,
+    ESP_PARTITION_TYPE_ANY = 0xff,
+} esp_partition_type_t;
+
+typedef enum {
+    ESP_PARTITION_SUBTYPE_DATA_NVS = 0x02,
+    ESP_PARTITION_SUBTYPE_DATA_SPIFFS = 0x82,
+    ESP_PARTITION_SUBTYPE_ANY = 0xff,
+} esp_partition_subtype_t;
+
+typedef struct {
+    void* flash_chip;
+    esp_partition_type_t type;
+    esp_partition_subtype_t subtype;
+    uint32_t address;
+    uint32_t size;
+    char label[17];
+    bool encrypted;
+} esp_partition_t;
+
+/**
+ * Finds a partition of the table.
+ * @param type Partition type.
+ * @param subtype Partition subtype, ESP_PARTITION_SUBTYPE_ANY for any.
+ * @param label Partition label, nullptr for any.
+ * @return The first matching partition, nullptr if none.
+ */
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char* label);
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t src_offset, void* dst, size_t size);
+
+/**
+ * Writes to a partition as NOR flash does: each byte of the flash becomes the AND of its value and the written
+ * one, so only erased bytes take the written value.
+ */
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t dst_offset, const void* src, size_t size);
+
+/**
+ * Erases whole sectors of a partition to 0xFF.
+ * @param offset Start of the range, a multiple of SPI_FLASH_SEC_SIZE.
+ * @param size Size of the range, a multiple of SPI_FLASH_SEC_SIZE.
+ */
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size);
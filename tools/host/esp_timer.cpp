@@ -0,0 +1,56 @@
+#include "esp_timer.h"
+#include "Arduino.h"
+#include "HostKernel.h"
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* handle) {
+    HostKernel* kernel = HostKernel::current();
+    if (kernel == nullptr) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (args == nullptr || args->callback == nullptr || handle == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *handle = kernel->createTimer(args->callback, args->arg, args->name);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeoutUs) {
+    HostKernel* kernel = HostKernel::current();
+    if (kernel == nullptr || timer == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    kernel->startTimer(timer, static_cast<int64_t>(timeoutUs), 0);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t periodUs) {
+    HostKernel* kernel = HostKernel::current();
+    if (kernel == nullptr || timer == nullptr || periodUs == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    kernel->startTimer(timer, static_cast<int64_t>(periodUs), static_cast<int64_t>(periodUs));
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    HostKernel* kernel = HostKernel::current();
+    if (kernel == nullptr || timer == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    kernel->stopTimer(timer);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    HostKernel* kernel = HostKernel::current();
+    if (kernel == nullptr || timer == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    kernel->deleteTimer(timer);
+    return ESP_OK;
+}
+
+int64_t esp_timer_get_time() {
+    HostKernel* kernel = HostKernel::current();
+    return kernel != nullptr ? kernel->nowUs() : static_cast<int64_t>(micros());
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+// FreeRTOS replacement for the host tools. Critical sections are mapped on a standard mutex. Tasks, semaphores,
+// queues and notifications run on the HostKernel virtual clock when the calling thread has one, otherwise on
+// host threads in real time.
+
+#include <stdint.h>
+#include <mutex>
+
+struct portMUX_TYPE {
+    std::mutex mutex;
+    portMUX_TYPE() {}
+    portMUX_TYPE(const portMUX_TYPE&) {}
+};
+
+#define portMUX_INITIALIZER_UNLOCKED portMUX_TYPE()
+#define portENTER_CRITICAL(mux)     (mux)->mutex.lock()
+#define portEXIT_CRITICAL(mux)      (mux)->mutex.unlock()
+#define portENTER_CRITICAL_ISR(mux) (mux)->mutex.lock()
+#define portEXIT_CRITICAL_ISR(mux)  (mux)->mutex.unlock()
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE             0
+#define pdTRUE              1
+#define pdFAIL              0
+#define pdPASS              1
+#define portMAX_DELAY       ((TickType_t)0xFFFFFFFF)
+#define portTICK_PERIOD_MS  1
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(ms))
+#define configTICK_RATE_HZ  1000
+
+#define portYIELD_FROM_ISR(woken)   ((void)(woken))
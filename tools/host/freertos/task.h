@@ -0,0 +1,32 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+struct HostContext;
+typedef HostContext* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stackDepth, void* parameter,
+                                   UBaseType_t priority, TaskHandle_t* createdTask, BaseType_t coreId);
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stackDepth, void* parameter,
+                       UBaseType_t priority, TaskHandle_t* createdTask);
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t* previousWakeTime, TickType_t timeIncrement);
+TickType_t xTaskGetTickCount();
+TaskHandle_t xTaskGetCurrentTaskHandle();
+const char* pcTaskGetName(TaskHandle_t task);
+TaskHandle_t xTaskGetHandle(const char* name);
+
+/**
+ * Gets the least free stack of a task since it started, in bytes like on the ESP32. The host measures its own
+ * stack frames, larger than the board ones, and scales the use down by HostKernel::HOST_STACK_WORD_RATIO: 0
+ * means the task would likely overflow its stack on the board.
+ */
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higherPriorityTaskWoken);
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait);
+
+#define taskYIELD() vTaskDelay(0)
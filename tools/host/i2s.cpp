@@ -0,0 +1,143 @@
+#include "driver/i2s.h"
+#include "Arduino.h"
+#include "HostKernel.h"
+#include "esp_timer.h"
+
+namespace {
+    constexpr uint32_t kBytesPerFrame = 4;              // 16-bit stereo
+
+    int64_t frameTimeUs(const HostBoard::I2sPort& state, uint64_t bytes) {
+        return static_cast<int64_t>(bytes / kBytesPerFrame * 1000000ULL / max(state.sampleRate, 1U));
+    }
+
+    /**
+     * Posts a DMA event, dropping the oldest one when the queue is full like the driver ISR.
+     */
+    void postEvent(HostBoard::I2sPort& state, i2s_event_type_t type) {
+        i2s_event_t event = {type, state.dmaBufferFrames * kBytesPerFrame};
+        if (uxQueueSpacesAvailable(state.events) == 0) {
+            i2s_event_t dropped;
+            xQueueReceive(state.events, &dropped, 0);
+        }
+        xQueueSendFromISR(state.events, &event, nullptr);
+    }
+
+    void onDmaBufferSent(void* arg) {
+        HostBoard::I2sPort& state = *static_cast<HostBoard::I2sPort*>(arg);
+        if (state.queuedUntilUs <= esp_timer_get_time()) {
+            // Every buffer is empty: the DMA sends silence
+            state.bufferEmptyEvents++;
+            postEvent(state, I2S_EVENT_TX_Q_OVF);
+        }
+        postEvent(state, I2S_EVENT_TX_DONE);
+    }
+
+    void startDmaTimer(HostBoard::I2sPort& state) {
+        HostKernel* kernel = HostKernel::current();
+        if (kernel != nullptr && state.dmaTimer != nullptr) {
+            int64_t periodUs = frameTimeUs(state, static_cast<uint64_t>(state.dmaBufferFrames) * kBytesPerFrame);
+            kernel->startTimer(state.dmaTimer, periodUs, periodUs);
+        }
+    }
+}
+
+esp_err_t i2s_driver_install(i2s_port_t port, const i2s_config_t* config, int queueSize, QueueHandle_t* queue) {
+    if (port < 0 || port >= HostBoard::I2S_PORTS || config == nullptr || config->dma_buf_count <= 0 ||
+        config->dma_buf_len <= 0 || (queueSize > 0 && queue == nullptr)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    HostBoard::I2sPort& state = hostBoard().i2s[port];
+    if (state.events != nullptr) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    state.sampleRate = config->sample_rate;
+    state.dmaBufferCount = config->dma_buf_count;
+    state.dmaBufferFrames = config->dma_buf_len;
+    state.queuedUntilUs = 0;
+    if (queueSize > 0) {
+        state.events = xQueueCreate(queueSize, sizeof(i2s_event_t));
+        *queue = state.events;
+
+        // Without a kernel the DMA events are not simulated
+        HostKernel* kernel = HostKernel::current();
+        if (kernel != nullptr) {
+            state.dmaTimer = kernel->createTimer(onDmaBufferSent, &state, "i2s_dma");
+            startDmaTimer(state);
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t i2s_driver_uninstall(i2s_port_t port) {
+    if (port < 0 || port >= HostBoard::I2S_PORTS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    HostBoard::I2sPort& state = hostBoard().i2s[port];
+    HostKernel* kernel = HostKernel::current();
+    if (state.dmaTimer != nullptr && kernel != nullptr) {
+        kernel->deleteTimer(state.dmaTimer);
+    }
+    state.dmaTimer = nullptr;
+    if (state.events != nullptr) {
+        vQueueDelete(state.events);
+        state.events = nullptr;
+    }
+    state.queuedUntilUs = 0;
+    return ESP_OK;
+}
+
+esp_err_t i2s_write(i2s_port_t port, const void* src, size_t size, size_t* bytesWritten, TickType_t ticksToWait) {
+    if (port < 0 || port >= HostBoard::I2S_PORTS || bytesWritten == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    HostBoard::I2sPort& state = hostBoard().i2s[port];
+    int64_t capacityUs = frameTimeUs(state, static_cast<uint64_t>(state.dmaBufferCount) * state.dmaBufferFrames *
+                                            kBytesPerFrame);
+    int64_t nowUs = esp_timer_get_time();
+    if (state.queuedUntilUs < nowUs) {
+        // The DMA is sending a buffer of silence: the samples go to the next buffer, they play when it starts
+        bool dmaRunning = state.dmaTimer != nullptr && state.dmaTimer->active;
+        state.queuedUntilUs = dmaRunning ? state.dmaTimer->nextUs : nowUs;
+    }
+
+    // Wait for the room of the whole write, at most ticksToWait, then queue what fits
+    int64_t neededUs = state.queuedUntilUs + frameTimeUs(state, size) - capacityUs;
+    if (neededUs > nowUs && ticksToWait > 0) {
+        int64_t deadlineUs = ticksToWait == portMAX_DELAY ? neededUs
+                                                           : min<int64_t>(neededUs, nowUs + ticksToWait * 1000LL * portTICK_PERIOD_MS);
+        HostKernel* kernel = HostKernel::current();
+        if (kernel != nullptr) {
+            kernel->sleepUntil(deadlineUs);
+            nowUs = kernel->nowUs();
+        }
+    }
+    int64_t roomUs = max<int64_t>(nowUs + capacityUs - state.queuedUntilUs, 0);
+    uint64_t roomBytes = static_cast<uint64_t>(roomUs) * state.sampleRate / 1000000ULL * kBytesPerFrame;
+    size_t written = static_cast<size_t>(min<uint64_t>(size / kBytesPerFrame * kBytesPerFrame, roomBytes));
+
+    state.queuedUntilUs += frameTimeUs(state, written);
+    state.bytesWritten += written;
+    *bytesWritten = written;
+    return ESP_OK;
+}
+
+esp_err_t i2s_set_sample_rates(i2s_port_t port, uint32_t rate) {
+    if (port < 0 || port >= HostBoard::I2S_PORTS || rate == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    HostBoard::I2sPort& state = hostBoard().i2s[port];
+    if (state.sampleRate != rate) {
+        state.sampleRate = rate;
+        startDmaTimer(state);
+    }
+    return ESP_OK;
+}
+
+esp_err_t i2s_zero_dma_buffer(i2s_port_t port) {
+    if (port < 0 || port >= HostBoard::I2S_PORTS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    HostBoard::I2sPort& state = hostBoard().i2s[port];
+    state.queuedUntilUs = min<int64_t>(state.queuedUntilUs, esp_timer_get_time());
+    return ESP_OK;
+}
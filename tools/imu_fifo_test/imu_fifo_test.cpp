@@ -0,0 +1,323 @@
+/**
+ * Linux unit test of the FIFO streaming mode of the MPU6886 driver (lib/MPU6886). The driver reads register dumps
+ * served by a scripted device on the simulated I2C bus: the interrupt status, the FIFO count and the FIFO data
+ * bytes in the layout of the sensor (big-endian accelerometer X, Y, Z, temperature and gyroscope X, Y, Z words,
+ * at ±2 g and ±250 °/s, of a sensor lying flat, tilted and saturated by a shock).
+ *
+ * The decode test checks the packets of the dumps against their raw values, sign extension included. The stream
+ * tests check the samples and timestamps of readFifo(), the split of a large FIFO into burst reads and the ring
+ * buffer overrun. The partial frame test reads a FIFO holding a packet the sensor is still writing: the partial
+ * packet must stay in the FIFO and decode once complete. The overflow test reads a full FIFO with the overflow
+ * flag set: nothing must be decoded, the FIFO must be reset and the next samples read aligned.
+ *
+ * Usage:
+ *   imu_fifo_test
+ *
+ * The exit status is 0 when every test passes.
+ */
+
+#include <HostKernel.h>
+#include <I2CBus.hpp>
+#include <MPU6886.hpp>
+#include <Wire.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <deque>
+#include <vector>
+
+namespace {
+    constexpr uint8_t kAddress = 0x68;
+    constexpr uint8_t kSampleRateDivider = 4;       // 200 Hz, the rate of the tilt sensor task
+    constexpr uint32_t kSamplePeriodUs = 5000;
+    constexpr uint16_t kFifoSize = 1024;
+
+    // Registers of the FIFO streaming mode
+    constexpr uint8_t kIntStatus = 0x3A;
+    constexpr uint8_t kUserCtrl = 0x6A;
+    constexpr uint8_t kFifoCountH = 0x72;
+    constexpr uint8_t kFifoCountL = 0x73;
+    constexpr uint8_t kFifoRW = 0x74;
+    constexpr uint8_t kIntFifoOverflow = 0x10;
+    constexpr uint8_t kUserCtrlFifoReset = 0x04;
+
+    /**
+     * Packet of a dump with the raw values it holds
+     */
+    struct DumpPacket {
+        const char* name;
+        const char* bytes;      // FIFO_R_W bytes in hex
+        int16_t accel[3];
+        int16_t temp;
+        int16_t gyro[3];
+    };
+
+    const DumpPacket kPackets[] = {
+        {"flat 1", "00 5C FF 8A 40 1E 0B 4C FF F6 00 0D FF FE", {92, -118, 16414}, 2892, {-10, 13, -2}},
+        {"flat 2", "00 61 FF 85 40 27 0B 4E FF F3 00 0F 00 01", {97, -123, 16423}, 2894, {-13, 15, 1}},
+        {"flat 3", "00 57 FF 90 40 12 0B 4B FF F8 00 0A FF FC", {87, -112, 16402}, 2891, {-8, 10, -4}},
+        {"tilted", "F9 1C 02 C5 3F 05 0B 52 FE 0C 00 2B FF E7", {-1764, 709, 16133}, 2898, {-500, 43, -25}},
+        {"shock", "80 00 7F FF 7F FF 0B 50 80 00 FF FF 00 00", {-32768, 32767, 32767}, 2896, {-32768, -1, 0}},
+    };
+    constexpr size_t kPacketCount = sizeof(kPackets) / sizeof(kPackets[0]);
+
+    /**
+     * Parses the hex bytes of a dump.
+     */
+    std::vector<uint8_t> parseHex(const char* text) {
+        std::vector<uint8_t> bytes;
+        char* end;
+        for (long value = strtol(text, &end, 16); end != text; value = strtol(text, &end, 16)) {
+            bytes.push_back(static_cast<uint8_t>(value));
+            text = end;
+        }
+        return bytes;
+    }
+
+    /**
+     * MPU6886 serving register dumps: the FIFO data and the interrupt status are set by the test, the count is
+     * that of the FIFO content. Reading INT_STATUS clears it and a FIFO reset empties the FIFO, as on the sensor.
+     */
+    class DumpDevice : public HostI2CDevice {
+    public:
+        std::deque<uint8_t> fifo;
+        uint8_t intStatus = 0;
+        uint32_t fifoResets = 0;
+
+        void append(const char* hex) {
+            for (uint8_t byte : parseHex(hex)) {
+                fifo.push_back(byte);
+            }
+        }
+
+        bool onWrite(const uint8_t* data, size_t length) override {
+            if (length == 0) {
+                return false;
+            }
+            pointer = data[0];
+            if (length > 1 && pointer == kUserCtrl && (data[1] & kUserCtrlFifoReset)) {
+                fifo.clear();
+                fifoResets++;
+            }
+            return true;
+        }
+
+        size_t onRead(uint8_t* buffer, size_t length) override {
+            for (size_t i = 0; i < length; i++) {
+                switch (pointer) {
+                    case kFifoRW:
+                        // The FIFO is read at a single address
+                        buffer[i] = fifo.empty() ? 0xFF : fifo.front();
+                        if (!fifo.empty()) {
+                            fifo.pop_front();
+                        }
+                        continue;
+                    case kIntStatus:
+                        buffer[i] = intStatus;
+                        intStatus = 0;
+                        break;
+                    case kFifoCountH:
+                        fifoCountLatch = static_cast<uint16_t>(fifo.size());
+                        buffer[i] = fifoCountLatch >> 8;
+                        break;
+                    case kFifoCountL:
+                        buffer[i] = fifoCountLatch & 0xFF;
+                        break;
+                    default:
+                        buffer[i] = 0;
+                        break;
+                }
+                pointer++;
+            }
+            return length;
+        }
+
+    private:
+        uint8_t pointer = 0;
+        uint16_t fifoCountLatch = 0;
+    };
+
+    bool report(const char* name, bool ok, const char* format, ...) __attribute__((format(printf, 3, 4)));
+
+    bool report(const char* name, bool ok, const char* format, ...) {
+        printf("  %-22s ", name);
+        va_list args;
+        va_start(args, format);
+        vprintf(format, args);
+        va_end(args);
+        printf("%s\n", ok ? "" : "  FAIL");
+        return ok;
+    }
+
+    bool matches(const MPU6886Sample& sample, const DumpPacket& packet) {
+        return memcmp(sample.accel, packet.accel, sizeof(sample.accel)) == 0 && sample.temp == packet.temp &&
+            memcmp(sample.gyro, packet.gyro, sizeof(sample.gyro)) == 0;
+    }
+
+    /**
+     * Pops the buffered samples and checks them against the packets of the dump, in order.
+     * @param first Index in kPackets of the first packet, the next ones follow cyclically.
+     * @return The number of samples matching their packet.
+     */
+    size_t popMatching(MPU6886& imu, size_t first, std::vector<MPU6886Sample>& samples) {
+        size_t matching = 0;
+        MPU6886Sample sample;
+        samples.clear();
+        while (imu.popSample(sample)) {
+            matching += matches(sample, kPackets[(first + samples.size()) % kPacketCount]);
+            samples.push_back(sample);
+        }
+        return matching;
+    }
+
+    void appendPackets(DumpDevice& device, size_t first, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            device.append(kPackets[(first + i) % kPacketCount].bytes);
+        }
+    }
+
+    bool testDecode() {
+        bool ok = true;
+        for (const DumpPacket& packet : kPackets) {
+            std::vector<uint8_t> bytes = parseHex(packet.bytes);
+            MPU6886Sample sample = {};
+            sample.timestampUs = 1234;
+            MPU6886::decodeFifoPacket(bytes.data(), sample);
+            bool packetOk = bytes.size() == MPU6886::FIFO_PACKET_SIZE && matches(sample, packet) &&
+                sample.timestampUs == 1234;
+            ok = report(packet.name, packetOk, "accel %d %d %d, temp %d, gyro %d %d %d", sample.accel[0],
+                sample.accel[1], sample.accel[2], sample.temp, sample.gyro[0], sample.gyro[1], sample.gyro[2]) && ok;
+        }
+        return ok;
+    }
+
+    bool testStream(MPU6886& imu, DumpDevice& device) {
+        appendPackets(device, 0, 3);
+        MPU6886FifoStats before = imu.getFifoStats();
+        uint32_t readUs = micros();
+        uint16_t read = imu.readFifo();
+        MPU6886FifoStats after = imu.getFifoStats();
+        std::vector<MPU6886Sample> samples;
+        size_t matching = popMatching(imu, 0, samples);
+
+        // Polled timestamps count back from the read of the FIFO count, one sample period apart
+        bool timestampsOk = samples.size() == 3;
+        for (size_t i = 0; timestampsOk && i < samples.size(); i++) {
+            int32_t fromReadUs = static_cast<int32_t>(samples[i].timestampUs - readUs);
+            int32_t expectedUs = -static_cast<int32_t>((samples.size() - 1 - i) * kSamplePeriodUs);
+            timestampsOk = fromReadUs >= expectedUs && fromReadUs < expectedUs + 1000;
+        }
+        bool ok = read == 3 && matching == 3 && timestampsOk && after.burstReads - before.burstReads == 1;
+        return report("stream", ok, "%u samples read, %zu matching, %u burst reads, timestamps %s", read, matching,
+            after.burstReads - before.burstReads, timestampsOk ? "ok" : "wrong");
+    }
+
+    bool testBursts(MPU6886& imu, DumpDevice& device) {
+        appendPackets(device, 1, 20);
+        MPU6886FifoStats before = imu.getFifoStats();
+        uint16_t read = imu.readFifo();
+        MPU6886FifoStats after = imu.getFifoStats();
+        std::vector<MPU6886Sample> samples;
+        size_t matching = popMatching(imu, 1, samples);
+        uint32_t bursts = after.burstReads - before.burstReads;
+        bool ok = read == 20 && matching == 20 && bursts == 3 && device.fifo.empty();
+        return report("burst reads", ok, "%u samples read, %zu matching, %u burst reads", read, matching, bursts);
+    }
+
+    bool testPartialFrame(MPU6886& imu, DumpDevice& device) {
+        // The sensor has written 6 bytes of the third packet when the count is read
+        appendPackets(device, 2, 2);
+        std::vector<uint8_t> third = parseHex(kPackets[4].bytes);
+        device.fifo.insert(device.fifo.end(), third.begin(), third.begin() + 6);
+        uint16_t firstRead = imu.readFifo();
+        std::vector<MPU6886Sample> samples;
+        size_t firstMatching = popMatching(imu, 2, samples);
+        size_t left = device.fifo.size();
+
+        // Then completes it and writes the next one
+        device.fifo.insert(device.fifo.end(), third.begin() + 6, third.end());
+        appendPackets(device, 0, 1);
+        uint16_t secondRead = imu.readFifo();
+        size_t secondMatching = popMatching(imu, 4, samples);
+        bool ok = firstRead == 2 && firstMatching == 2 && left == 6 && secondRead == 2 && secondMatching == 2;
+        return report("partial frame", ok, "%u then %u samples read, %zu and %zu matching, %zu bytes left", firstRead,
+            secondRead, firstMatching, secondMatching, left);
+    }
+
+    bool testOverflow(MPU6886& imu, DumpDevice& device) {
+        // Stopped when full: the FIFO ends with a partial packet, the overflow flag is set
+        while (device.fifo.size() + MPU6886::FIFO_PACKET_SIZE <= kFifoSize) {
+            appendPackets(device, device.fifo.size() / MPU6886::FIFO_PACKET_SIZE, 1);
+        }
+        std::vector<uint8_t> partial = parseHex(kPackets[3].bytes);
+        device.fifo.insert(device.fifo.end(), partial.begin(), partial.begin() + (kFifoSize - device.fifo.size()));
+        device.intStatus = kIntFifoOverflow;
+        MPU6886FifoStats before = imu.getFifoStats();
+        uint32_t resetsBefore = device.fifoResets;
+        uint16_t overflowRead = imu.readFifo();
+        MPU6886FifoStats after = imu.getFifoStats();
+        bool resetOk = device.fifoResets == resetsBefore + 1 && device.fifo.empty() && imu.availableSamples() == 0;
+
+        // The samples after the reset are read aligned
+        appendPackets(device, 3, 2);
+        uint16_t nextRead = imu.readFifo();
+        std::vector<MPU6886Sample> samples;
+        size_t matching = popMatching(imu, 3, samples);
+        bool ok = overflowRead == 0 && after.overflows == before.overflows + 1 &&
+            after.samples == before.samples && resetOk && nextRead == 2 && matching == 2;
+        return report("overflow", ok, "%u samples read, %u overflows, FIFO %s, then %u read, %zu matching",
+            overflowRead, after.overflows - before.overflows, resetOk ? "reset" : "not reset", nextRead, matching);
+    }
+
+    bool testRingOverrun(MPU6886& imu, DumpDevice& device) {
+        const size_t packets = MPU6886::SAMPLE_RING_SIZE + 6;
+        appendPackets(device, 0, packets);
+        MPU6886FifoStats before = imu.getFifoStats();
+        uint16_t read = imu.readFifo();
+        MPU6886FifoStats after = imu.getFifoStats();
+        uint16_t available = imu.availableSamples();
+
+        // The oldest samples are dropped
+        std::vector<MPU6886Sample> samples;
+        size_t matching = popMatching(imu, packets - MPU6886::SAMPLE_RING_SIZE, samples);
+        uint32_t overruns = after.ringOverruns - before.ringOverruns;
+        bool ok = read == packets && available == MPU6886::SAMPLE_RING_SIZE && overruns == 6 &&
+            matching == MPU6886::SAMPLE_RING_SIZE;
+        return report("ring overrun", ok, "%u samples read, %u buffered, %u dropped, %zu matching", read, available,
+            overruns, matching);
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        fprintf(stderr, "Usage: %s\n", argv[0]);
+        return 2;
+    }
+
+    // Without the bus task the transactions run in the calling context, on the virtual clock of the kernel
+    HostKernel kernel;
+    DumpDevice device;
+    TwoWire wire(0);
+    wire.attachDevice(kAddress, &device);
+    wire.begin();
+    I2CBus bus(wire);
+    MPU6886 imu(bus, kAddress);
+
+    printf("Packet decode\n");
+    bool passed = testDecode();
+    printf("FIFO reads at %u us per sample\n", (unsigned)kSamplePeriodUs);
+    if (!imu.beginFifo(kSampleRateDivider)) {
+        printf("  FAIL: beginFifo\n");
+        return 1;
+    }
+    passed = testStream(imu, device) && passed;
+    passed = testBursts(imu, device) && passed;
+    passed = testPartialFrame(imu, device) && passed;
+    passed = testOverflow(imu, device) && passed;
+    passed = testRingOverrun(imu, device) && passed;
+    printf("%s\n", passed ? "OK" : "FAILED");
+    return passed ? 0 : 1;
+}
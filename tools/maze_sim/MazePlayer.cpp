@@ -0,0 +1,90 @@
+#include "MazePlayer.hpp"
+
+namespace {
+    constexpr float kRollingAccelMmS2 = 5.0f / 7.0f * 9810.0f;
+    constexpr float kRadToDeg = static_cast<float>(180.0 / M_PI);
+
+    /**
+     * Speed to aim for at a signed distance from a stop point, braking to reach it at rest.
+     */
+    float approachSpeed(float distance, float maxSpeed, float braking) {
+        float speed = min(maxSpeed, sqrtf(2.0f * braking * fabsf(distance)));
+        return distance >= 0.0f ? speed : -speed;
+    }
+}
+
+MazePlayer::MazePlayer(const PlayerConfig& config, const MazeWorld& world, uint32_t seed)
+    : config(config), world(world), rng(seed), noise(0.0f, config.inputNoise) {
+}
+
+void MazePlayer::update(uint32_t nowMs, bool playing, float& x, float& y) {
+    if (sampled && nowMs - lastSampleMs < config.updatePeriodMs) {
+        x = inputX;
+        y = inputY;
+        return;
+    }
+    sampled = true;
+    lastSampleMs = nowMs;
+
+    inputX = 0.0f;
+    inputY = 0.0f;
+    if (playing) {
+        if (world.isBallInHolder()) {
+            // The kickback did not free the ball: push it out
+            inputX = -1.0f;
+        } else if (world.isBallInMaze()) {
+            steer(inputX, inputY);
+            inputX = constrain(inputX + noise(rng), -1.0f, 1.0f);
+            inputY = constrain(inputY + noise(rng), -1.0f, 1.0f);
+        }
+    }
+    x = inputX;
+    y = inputY;
+}
+
+void MazePlayer::steer(float& x, float& y) {
+    // The player sees the ball with a delay and extrapolates where it is now from its motion
+    BallState ball = world.getBallState(static_cast<uint32_t>(config.reactionMs));
+    float anticipationS = config.reactionMs * config.anticipation * 1e-3f;
+    ball.x += ball.vx * anticipationS;
+    ball.y += ball.vy * anticipationS;
+    int cell = world.cellAt(ball.x, ball.y);
+    std::vector<int> path = world.findPath(cell, world.getGoalCell());
+
+    if (path.size() <= 1) {
+        // In the goal cell: stop over the hole
+        x = tiltInput(approachSpeed(world.cellCenterX(cell) - ball.x, config.holeSpeedMmS, config.brakingMmS2), ball.vx);
+        y = tiltInput(approachSpeed(world.cellCenterY(cell) - ball.y, config.holeSpeedMmS, config.brakingMmS2), ball.vy);
+        return;
+    }
+
+    // Run to the end of the straight corridor, keeping to its center line
+    int step = path[1] - path[0];
+    size_t end = 1;
+    while (end + 1 < path.size() && path[end + 1] - path[end] == step) {
+        end++;
+    }
+    int target = path[end];
+    bool toGoal = target == world.getGoalCell();
+    auto corridorSpeed = [this, toGoal](float distance) {
+        // Brake to a stop at a turn, enter the goal cell at the hole approach speed
+        float speed = approachSpeed(distance, config.cruiseSpeedMmS, config.brakingMmS2);
+        return toGoal && distance > 0.0f ? max(speed, config.holeSpeedMmS) : speed;
+    };
+    if (step == 1 || step == -1) {
+        float wanted = step * corridorSpeed((world.cellCenterX(target) - ball.x) * step);
+        x = tiltInput(wanted, ball.vx);
+        y = tiltInput(config.centeringGain * (world.cellCenterY(cell) - ball.y), ball.vy);
+    } else {
+        float direction = step > 0 ? 1.0f : -1.0f;
+        float wanted = direction * corridorSpeed((world.cellCenterY(target) - ball.y) * direction);
+        y = tiltInput(wanted, ball.vy);
+        x = tiltInput(config.centeringGain * (world.cellCenterX(cell) - ball.x), ball.vx);
+    }
+}
+
+float MazePlayer::tiltInput(float wantedSpeed, float speed) const {
+    float acceleration = config.speedGain * (wantedSpeed - speed);
+    float tiltDeg = asinf(constrain(acceleration / kRollingAccelMmS2, -1.0f, 1.0f)) * kRadToDeg;
+    return constrain(tiltDeg / world.getFullDeflectionTiltDeg(), -1.0f, 1.0f);
+}
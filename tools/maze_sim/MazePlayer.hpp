@@ -0,0 +1,52 @@
+#pragma once
+
+#include <random>
+
+#include "MazeWorld.hpp"
+
+/**
+ * Skill parameters of the simulated player
+ */
+struct PlayerConfig {
+    float reactionMs = 150.0f;          // Age of the ball position the player reacts to
+    float anticipation = 1.0f;          // Fraction of the reaction delay compensated by extrapolating the ball motion
+    float cruiseSpeedMmS = 160.0f;      // Ball speed aimed for along the corridors
+    float holeSpeedMmS = 90.0f;         // Ball speed aimed for when approaching the hole
+    float brakingMmS2 = 600.0f;         // Deceleration planned when approaching a turn or the hole
+    float speedGain = 3.0f;             // Acceleration commanded per unit of speed error (1/s)
+    float centeringGain = 4.0f;         // Speed commanded towards the corridor center line per unit of offset (1/s)
+    float inputNoise = 0.02f;           // Standard deviation of the stick position error, in full deflections
+    uint32_t updatePeriodMs = 50;       // Rate of the controller samples received by the game
+};
+
+/**
+ * MazePlayer steers the ball along the shortest path to the goal, one straight corridor at a time, as a player
+ * looking at the ball with a reaction delay: the stick commands the table tilt that would give the ball the
+ * speed wanted along the corridor, braking before each turn. The stick is sampled at the controller rate.
+ */
+class MazePlayer {
+public:
+    MazePlayer(const PlayerConfig& config, const MazeWorld& world, uint32_t seed);
+
+    /**
+     * Gets the controller position at the current time.
+     * @param nowMs Current virtual time in milliseconds.
+     * @param playing true while the game lets the player control the table.
+     * @param x Output X input in [-1, 1].
+     * @param y Output Y input in [-1, 1].
+     */
+    void update(uint32_t nowMs, bool playing, float& x, float& y);
+
+private:
+    PlayerConfig config;
+    const MazeWorld& world;
+    std::mt19937 rng;
+    std::normal_distribution<float> noise;
+    uint32_t lastSampleMs = 0;
+    bool sampled = false;
+    float inputX = 0.0f;
+    float inputY = 0.0f;
+
+    void steer(float& x, float& y);
+    float tiltInput(float wantedSpeed, float speed) const;
+};
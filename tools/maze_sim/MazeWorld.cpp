@@ -0,0 +1,419 @@
+#include "MazeWorld.hpp"
+
+#include <HostBoard.h>
+
+#include <algorithm>
+#include <deque>
+
+namespace {
+    constexpr float kGravityMmS2 = 9810.0f;
+    constexpr float kRollingFactor = 5.0f / 7.0f;    // Solid sphere rolling without slipping
+    constexpr float kDegToRad = static_cast<float>(M_PI / 180.0);
+    constexpr float kMinHitSpeedMmS = 30.0f;        // Slower contacts are the ball resting against a wall
+    constexpr float kStopSpeedMmS = 1.0f;
+    constexpr float kServoPulseSumUs = 500.0f + 2500.0f;   // X servo output is inverted, as wired in main.cpp
+    constexpr int64_t kStepUs = 1000;
+
+    float drive(float tiltDeg) {
+        return kRollingFactor * kGravityMmS2 * sinf(tiltDeg * kDegToRad);
+    }
+}
+
+MazeWorld::MazeWorld(const WorldConfig& config, const GameConfig& gameConfig, uint32_t seed, uint8_t ballDropPin)
+    : config(config), gameConfig(gameConfig), ballDropPin(ballDropPin), size(max(2, config.mazeSize)),
+      imu(seed * 7919u + 1, 0.004f, 0.05f) {
+    std::mt19937 rng(seed);
+    generateMaze(rng);
+
+    std::uniform_real_distribution<float> level(-config.levelSpreadUs, config.levelSpreadUs);
+    std::uniform_real_distribution<float> mount(-config.imuMountErrorDeg, config.imuMountErrorDeg);
+    levelPulseUs[0] = 1500.0f + level(rng);
+    levelPulseUs[1] = 1500.0f + level(rng);
+    // The configured compensation cancels the IMU mounting angle up to the mounting error
+    imuMountDeg[0] = gameConfig.servoCalibrationTargetAngleXDeg + mount(rng);
+    imuMountDeg[1] = gameConfig.servoCalibrationTargetAngleYDeg + mount(rng);
+
+    size_t deadTimeSteps = max<size_t>(1, static_cast<size_t>(lroundf(config.servoDeadTimeMs)));
+    for (Servo& servo : servos) {
+        servo.commands.assign(deadTimeSteps, 1500.0f);
+    }
+
+    // Turn cells of the solution, where the overshoot is measured
+    solution = findPath(cellIndex(0, size - 1), getGoalCell());
+    turnOvershoot.assign(size * size, -1.0f);
+    turnVisited.assign(size * size, 0);
+    for (size_t i = 1; i + 1 < solution.size(); i++) {
+        int inStep = solution[i] - solution[i - 1];
+        int outStep = solution[i + 1] - solution[i];
+        if (inStep != outStep) {
+            turnOvershoot[solution[i]] = 0.0f;
+        }
+    }
+
+    resetForGame();
+}
+
+void MazeWorld::generateMaze(std::mt19937& rng) {
+    // Depth-first carving of a perfect maze: a single path between any two cells
+    eastWalls.assign(size * size, 1);
+    southWalls.assign(size * size, 1);
+    std::vector<uint8_t> visited(size * size, 0);
+    std::vector<int> stack = {cellIndex(0, size - 1)};
+    visited[stack.back()] = 1;
+    while (!stack.empty()) {
+        int cell = stack.back();
+        int row = cell / size;
+        int col = cell % size;
+        int candidates[4];
+        int count = 0;
+        const int steps[4][2] = {{0, 1}, {0, -1}, {1, 0}, {-1, 0}};
+        for (const auto& step : steps) {
+            int r = row + step[0];
+            int c = col + step[1];
+            if (r >= 0 && r < size && c >= 0 && c < size && !visited[cellIndex(r, c)]) {
+                candidates[count++] = cellIndex(r, c);
+            }
+        }
+        if (count == 0) {
+            stack.pop_back();
+            continue;
+        }
+
+        int next = candidates[std::uniform_int_distribution<int>(0, count - 1)(rng)];
+        if (next == cell + 1) {
+            eastWalls[cell] = 0;
+        } else if (next == cell - 1) {
+            eastWalls[next] = 0;
+        } else if (next == cell + size) {
+            southWalls[cell] = 0;
+        } else {
+            southWalls[next] = 0;
+        }
+        visited[next] = 1;
+        stack.push_back(next);
+    }
+}
+
+bool MazeWorld::isOpen(int cell, int dx, int dy) const {
+    int row = cell / size;
+    int col = cell % size;
+    if (dx > 0) {
+        return col + 1 < size && !eastWalls[cell];
+    }
+    if (dx < 0) {
+        return col > 0 && !eastWalls[cell - 1];
+    }
+    if (dy > 0) {
+        return row + 1 < size && !southWalls[cell];
+    }
+    if (dy < 0) {
+        return row > 0 && !southWalls[cell - size];
+    }
+    return false;
+}
+
+int MazeWorld::cellAt(float px, float py) const {
+    int col = constrain(static_cast<int>(floorf(px / config.cellMm)), 0, size - 1);
+    int row = constrain(static_cast<int>(floorf(py / config.cellMm)), 0, size - 1);
+    return cellIndex(row, col);
+}
+
+std::vector<int> MazeWorld::findPath(int from, int to) const {
+    std::vector<int> previous(size * size, -1);
+    std::deque<int> queue = {from};
+    previous[from] = from;
+    const int steps[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+    while (!queue.empty() && previous[to] < 0) {
+        int cell = queue.front();
+        queue.pop_front();
+        for (const auto& step : steps) {
+            if (isOpen(cell, step[0], step[1])) {
+                int next = cell + step[0] + step[1] * size;
+                if (previous[next] < 0) {
+                    previous[next] = cell;
+                    queue.push_back(next);
+                }
+            }
+        }
+    }
+
+    std::vector<int> path;
+    for (int cell = to; previous[cell] >= 0; cell = previous[cell]) {
+        path.push_back(cell);
+        if (cell == from) {
+            break;
+        }
+    }
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+void MazeWorld::resetForGame() {
+    phase = Phase::IN_HOLDER;
+    x = (size + 0.5f) * config.cellMm;
+    y = 0.5f * config.cellMm;
+    vx = 0.0f;
+    vy = 0.0f;
+    kickHeldMs = 0.0f;
+    chutePositionMm = 0.0f;
+    chuteSpeedMmS = 0.0f;
+    currentCell = -1;
+    std::fill(turnVisited.begin(), turnVisited.end(), 0);
+    for (float& overshoot : turnOvershoot) {
+        if (overshoot > 0.0f) {
+            overshoot = 0.0f;
+        }
+    }
+    metrics = {};
+    setSensor(false);
+    for (BallState& state : history) {
+        state = {x, y, 0.0f, 0.0f};
+    }
+}
+
+void MazeWorld::step(int64_t nowUs) {
+    float dt = lastStepUs == 0 ? kStepUs * 1e-6f : min(nowUs - lastStepUs, 5 * kStepUs) * 1e-6f;
+    lastStepUs = nowUs;
+
+    stepServos(dt);
+    imu.setAttitude(tiltDeg[0] + imuMountDeg[0], tiltDeg[1] + imuMountDeg[1], tiltRateDps[0], tiltRateDps[1]);
+    imu.tick(nowUs);
+    metrics.maxTiltDeg = max(metrics.maxTiltDeg, max(fabsf(tiltDeg[0]), fabsf(tiltDeg[1])));
+
+    switch (phase) {
+        case Phase::IN_HOLDER:
+            // The kickback tilt has to push the ball long enough to get it out of the holder
+            kickHeldMs = tiltDeg[0] <= -config.kickTiltDeg ? kickHeldMs + dt * 1000.0f : 0.0f;
+            if (kickHeldMs >= config.kickHoldMs) {
+                phase = Phase::IN_MAZE;
+                x = size * config.cellMm - config.ballRadiusMm;
+                y = 0.5f * config.cellMm;
+                vx = -config.kickSpeedMmS;
+                vy = 0.0f;
+                metrics.released = true;
+                metrics.releaseUs = nowUs;
+            }
+            break;
+        case Phase::IN_MAZE:
+            stepBall(dt, nowUs);
+            break;
+        case Phase::IN_HOLE:
+        case Phase::IN_CHUTE:
+        case Phase::COLLECTED:
+            stepChute(dt, nowUs);
+            break;
+    }
+
+    historyHead = (historyHead + 1) % HISTORY_MS;
+    history[historyHead] = {x, y, vx, vy};
+}
+
+void MazeWorld::stepServos(float dt) {
+    HostBoard& board = hostBoard();
+    for (uint8_t axis = 0; axis < 2; axis++) {
+        Servo& servo = servos[axis];
+        float pulseUs = board.getLedcPulseUs(axis == 0 ? X_SERVO_CHANNEL : Y_SERVO_CHANNEL);
+        float commandUs = servo.commands[servo.next];   // Oldest command, delayed by the dead time
+        if (pulseUs > 0.0f) {
+            servo.commands[servo.next] = axis == 0 ? kServoPulseSumUs - pulseUs : pulseUs;
+        }
+        servo.next = (servo.next + 1) % servo.commands.size();
+
+        float speed = (commandUs - servo.positionUs) / (config.servoTimeConstantMs * 1e-3f);
+        servo.speedUsS = constrain(speed, -config.servoMaxSpeedUsS, config.servoMaxSpeedUsS);
+        servo.positionUs += servo.speedUsS * dt;
+        tiltDeg[axis] = config.tableGainDegPerUs * (servo.positionUs - levelPulseUs[axis]);
+        tiltRateDps[axis] = config.tableGainDegPerUs * servo.speedUsS;
+    }
+}
+
+void MazeWorld::stepBall(float dt, int64_t nowUs) {
+    float ax = drive(tiltDeg[0]);
+    float ay = drive(tiltDeg[1]);
+    float speed = sqrtf(vx * vx + vy * vy);
+    float resistance = config.rollingResistance * kGravityMmS2;
+    if (speed > kStopSpeedMmS) {
+        ax -= resistance * vx / speed;
+        ay -= resistance * vy / speed;
+    } else if (sqrtf(ax * ax + ay * ay) <= resistance) {
+        // Held by the rolling resistance
+        vx = 0.0f;
+        vy = 0.0f;
+        ax = 0.0f;
+        ay = 0.0f;
+    }
+    vx += ax * dt;
+    vy += ay * dt;
+    x += vx * dt;
+    y += vy * dt;
+    collide();
+    trackOvershoot();
+
+    // The ball falls in the hole when it rolls over its center slowly enough
+    int goal = getGoalCell();
+    float dx = x - cellCenterX(goal);
+    float dy = y - cellCenterY(goal);
+    if (sqrtf(dx * dx + dy * dy) < config.holeRadiusMm * 0.6f && sqrtf(vx * vx + vy * vy) < config.captureSpeedMmS) {
+        phase = Phase::IN_HOLE;
+        fallUs = nowUs;
+        metrics.dropped = true;
+        metrics.dropUs = nowUs;
+        vx = 0.0f;
+        vy = 0.0f;
+    }
+}
+
+void MazeWorld::collide() {
+    float r = config.ballRadiusMm;
+    float c = config.cellMm;
+    int cell = cellAt(x, y);
+    float left = (cell % size) * c;
+    float top = (cell / size) * c;
+
+    if (!isOpen(cell, -1, 0) && x - r < left) {
+        bounce(1.0f, 0.0f, left - (x - r));
+    }
+    if (!isOpen(cell, 1, 0) && x + r > left + c) {
+        bounce(-1.0f, 0.0f, x + r - (left + c));
+    }
+    if (!isOpen(cell, 0, -1) && y - r < top) {
+        bounce(0.0f, 1.0f, top - (y - r));
+    }
+    if (!isOpen(cell, 0, 1) && y + r > top + c) {
+        bounce(0.0f, -1.0f, y + r - (top + c));
+    }
+
+    // Every grid corner holds a post, wall ends included
+    for (int corner = 0; corner < 4; corner++) {
+        float cornerX = left + (corner & 1) * c;
+        float cornerY = top + (corner >> 1) * c;
+        float dx = x - cornerX;
+        float dy = y - cornerY;
+        float distance = sqrtf(dx * dx + dy * dy);
+        if (distance < r && distance > 1e-6f) {
+            bounce(dx / distance, dy / distance, r - distance);
+        }
+    }
+}
+
+void MazeWorld::bounce(float normalX, float normalY, float penetration) {
+    x += normalX * penetration;
+    y += normalY * penetration;
+    float normalSpeed = vx * normalX + vy * normalY;
+    if (normalSpeed >= 0.0f) {
+        return;
+    }
+    vx -= (1.0f + config.restitution) * normalSpeed * normalX;
+    vy -= (1.0f + config.restitution) * normalSpeed * normalY;
+    if (-normalSpeed >= kMinHitSpeedMmS) {
+        metrics.wallHits++;
+        metrics.maxImpactMmS = max(metrics.maxImpactMmS, -normalSpeed);
+    }
+}
+
+void MazeWorld::trackOvershoot() {
+    int cell = cellAt(x, y);
+    if (cell != currentCell) {
+        // Leaving a turn cell of the solution for the first time closes its overshoot measurement
+        if (currentCell >= 0 && turnOvershoot[currentCell] >= 0.0f && turnVisited[currentCell] == 1) {
+            turnVisited[currentCell] = 2;
+            metrics.turns++;
+            metrics.sumOvershootMm += turnOvershoot[currentCell];
+            metrics.maxOvershootMm = max(metrics.maxOvershootMm, turnOvershoot[currentCell]);
+        }
+        currentCell = cell;
+        if (turnOvershoot[cell] >= 0.0f && turnVisited[cell] == 0) {
+            turnVisited[cell] = 1;
+        }
+    }
+    if (turnVisited[cell] != 1) {
+        return;
+    }
+
+    // Distance run past the cell center in the direction the solution enters the cell
+    auto position = std::find(solution.begin(), solution.end(), cell);
+    int inStep = *position - *(position - 1);
+    float past;
+    if (inStep == 1 || inStep == -1) {
+        past = (x - cellCenterX(cell)) * inStep;
+    } else {
+        past = (y - cellCenterY(cell)) * (inStep > 0 ? 1.0f : -1.0f);
+    }
+    turnOvershoot[cell] = max(turnOvershoot[cell], past);
+}
+
+void MazeWorld::stepChute(float dt, int64_t nowUs) {
+    if (phase == Phase::IN_HOLE) {
+        float sinceFallMs = (nowUs - fallUs) / 1000.0f;
+        if (sinceFallMs >= config.dropFallMs && !sensorActive) {
+            setSensor(true);
+        }
+        if (sinceFallMs >= config.dropFallMs + config.dropPulseMs) {
+            setSensor(false);
+            phase = Phase::IN_CHUTE;
+        }
+        return;
+    }
+    if (phase != Phase::IN_CHUTE) {
+        return;
+    }
+
+    // The chute runs in the direction the ball drop pose tilts the table
+    float poseX = gameConfig.ballDropXDeltaPulseUs;
+    float poseY = gameConfig.ballDropYDeltaPulseUs;
+    float poseNorm = sqrtf(poseX * poseX + poseY * poseY);
+    float slopeDeg = config.chuteSlopeDeg;
+    if (poseNorm > 0.0f) {
+        slopeDeg += (tiltDeg[0] * poseX + tiltDeg[1] * poseY) / poseNorm;
+    }
+    float acceleration = drive(slopeDeg);
+    float resistance = config.rollingResistance * kGravityMmS2;
+    if (fabsf(chuteSpeedMmS) > kStopSpeedMmS) {
+        acceleration -= chuteSpeedMmS > 0.0f ? resistance : -resistance;
+    } else if (fabsf(acceleration) <= resistance) {
+        acceleration = 0.0f;
+        chuteSpeedMmS = 0.0f;
+    }
+    chuteSpeedMmS += acceleration * dt;
+    chutePositionMm += chuteSpeedMmS * dt;
+    if (chutePositionMm < 0.0f) {
+        chutePositionMm = 0.0f;
+        chuteSpeedMmS = 0.0f;
+    }
+    if (chutePositionMm >= config.chuteLengthMm) {
+        phase = Phase::COLLECTED;
+        metrics.collected = true;
+        metrics.collectedUs = nowUs;
+    }
+}
+
+void MazeWorld::setSensor(bool active) {
+    sensorActive = active;
+    hostBoard().setPinLevel(ballDropPin, active ? LOW : HIGH);
+}
+
+BallState MazeWorld::getBallState(uint32_t delayMs) const {
+    size_t age = min<size_t>(delayMs, HISTORY_MS - 1);
+    return history[(historyHead + HISTORY_MS - age) % HISTORY_MS];
+}
+
+void MazeWorld::printMaze(FILE* out) const {
+    for (int col = 0; col < size; col++) {
+        fputs("+--", out);
+    }
+    fputs("+\n", out);
+    for (int row = 0; row < size; row++) {
+        fputc('|', out);
+        for (int col = 0; col < size; col++) {
+            int cell = cellIndex(row, col);
+            const char* mark = cell == getGoalCell() ? "()" : (cell == cellIndex(0, size - 1) ? "<<" : "  ");
+            fputs(mark, out);
+            fputc(eastWalls[cell] && !(row == 0 && col == size - 1) ? '|' : ' ', out);
+        }
+        fputc('\n', out);
+        for (int col = 0; col < size; col++) {
+            fputs(southWalls[cellIndex(row, col)] ? "+--" : "+  ", out);
+        }
+        fputs("+\n", out);
+    }
+}
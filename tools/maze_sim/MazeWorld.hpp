@@ -0,0 +1,208 @@
+#pragma once
+
+#include <Arduino.h>
+#include <GameConfig.h>
+
+#include <random>
+#include <vector>
+
+#include "SimulatedImu.hpp"
+
+/**
+ * Physical parameters of the simulated table, servos, ball and maze
+ */
+struct WorldConfig {
+    int mazeSize = 6;                   // Cells per side of the square maze
+    float cellMm = 30.0f;               // Cell pitch in millimeters
+    float ballRadiusMm = 6.0f;
+    float holeRadiusMm = 8.0f;          // Goal hole radius
+    float captureSpeedMmS = 220.0f;     // Fastest ball speed that still falls in the hole
+    float restitution = 0.4f;           // Normal velocity kept after hitting a wall
+    float rollingResistance = 0.012f;   // Rolling resistance coefficient (deceleration in g)
+    float tableGainDegPerUs = 0.03f;    // Table tilt per microsecond of servo pulse width
+    float levelSpreadUs = 80.0f;        // Largest distance of the level pulse widths from 1500 us
+    float imuMountErrorDeg = 0.2f;      // Largest error of the IMU mounting compensation in the configuration
+    float servoDeadTimeMs = 12.0f;      // Servo response dead time (PWM period and control loop)
+    float servoTimeConstantMs = 15.0f;  // Servo position loop first order time constant
+    float servoMaxSpeedUsS = 3300.0f;   // Servo top speed in pulse microseconds per second (0.1 s / 60 deg)
+    float kickTiltDeg = 4.0f;           // X tilt that pushes the ball out of the holder at the game start
+    float kickHoldMs = 40.0f;           // Time the kick tilt must be held for the ball to leave the holder
+    float kickSpeedMmS = 120.0f;        // Ball speed when leaving the holder
+    float dropFallMs = 40.0f;           // Fall time from the hole to the drop sensor
+    float dropPulseMs = 8.0f;           // Time the falling ball is seen by the drop sensor
+    float chuteLengthMm = 250.0f;       // Length of the chute from the drop sensor to the collection box
+    float chuteSlopeDeg = 0.5f;         // Slope of the chute with the table level
+};
+
+/**
+ * Outcome of a simulated game on the world side
+ */
+struct WorldMetrics {
+    bool released;              // Ball left the holder
+    int64_t releaseUs;          // Time the ball left the holder
+    bool dropped;               // Ball fell in the goal hole
+    int64_t dropUs;             // Time the ball fell in the hole
+    bool collected;             // Ball reached the collection box after the drop
+    int64_t collectedUs;        // Time the ball reached the collection box
+    uint32_t wallHits;          // Wall and post impacts faster than the hit threshold
+    float maxImpactMmS;         // Fastest impact
+    uint32_t turns;             // Path turns crossed
+    float sumOvershootMm;       // Sum over the turns of the distance run past the turn cell center
+    float maxOvershootMm;       // Largest overshoot at a turn
+    float maxTiltDeg;           // Largest table tilt on either axis
+};
+
+/**
+ * Ball state as seen by the player
+ */
+struct BallState {
+    float x;
+    float y;
+    float vx;
+    float vy;
+};
+
+/**
+ * MazeWorld simulates the tilting maze table: the servos driven by the LEDC pulse widths of the firmware (dead
+ * time, first order response and top speed), the rigid table whose tilt follows the servo horns, the IMU on the
+ * table, and the ball rolling in a random perfect maze. The ball starts in the holder, is kicked into the start
+ * cell by the kickback tilt, falls in the goal hole where it pulses the ball drop sensor pin, and rolls down the
+ * chute to the collection box while the table holds the ball drop pose.
+ *
+ * Coordinates are in millimeters, x towards the east (positive X tilt), y towards the south (positive Y tilt).
+ * The start cell is the north-east one, with the holder outside its east wall; the goal is the south-west cell.
+ */
+class MazeWorld {
+public:
+    static constexpr uint8_t X_SERVO_CHANNEL = 0;
+    static constexpr uint8_t Y_SERVO_CHANNEL = 1;
+
+    /**
+     * @param config Physical parameters.
+     * @param gameConfig Firmware configuration, for the servo pulse range, the ball drop pose and the IMU mounting.
+     * @param seed Seed of the maze, the servo offsets and the IMU noise.
+     * @param ballDropPin GPIO of the ball drop sensor, active low.
+     */
+    MazeWorld(const WorldConfig& config, const GameConfig& gameConfig, uint32_t seed, uint8_t ballDropPin);
+
+    SimulatedImu& getImu() {
+        return imu;
+    }
+
+    /**
+     * Advances the simulation to the given time. Must be called at a 1 ms period.
+     * @param nowUs Current virtual time in microseconds.
+     */
+    void step(int64_t nowUs);
+
+    /**
+     * Puts the ball back in the holder and clears the metrics, before a new game.
+     */
+    void resetForGame();
+
+    bool isBallInHolder() const {
+        return phase == Phase::IN_HOLDER;
+    }
+    bool isBallInMaze() const {
+        return phase == Phase::IN_MAZE;
+    }
+
+    /**
+     * Gets the ball state at a past time, as perceived by a player with a reaction delay.
+     * @param delayMs Age of the state in milliseconds, within the last second.
+     * @return The ball state.
+     */
+    BallState getBallState(uint32_t delayMs) const;
+
+    const WorldMetrics& getMetrics() const {
+        return metrics;
+    }
+
+    // Maze geometry, for the player
+    int getSize() const { return size; }
+    float getCellMm() const { return config.cellMm; }
+    int getGoalCell() const { return cellIndex(size - 1, 0); }
+    int cellAt(float x, float y) const;
+    float cellCenterX(int cell) const { return (cell % size + 0.5f) * config.cellMm; }
+    float cellCenterY(int cell) const { return (cell / size + 0.5f) * config.cellMm; }
+    bool isOpen(int cell, int dx, int dy) const;
+
+    /**
+     * Finds the shortest path between two cells.
+     * @return The cells of the path, from and to included.
+     */
+    std::vector<int> findPath(int from, int to) const;
+
+    /**
+     * Gets the table tilt sensitivity at full controller deflection, as learned by a player.
+     * @return The tilt in degrees at full deflection.
+     */
+    float getFullDeflectionTiltDeg() const {
+        return config.tableGainDegPerUs * gameConfig.servoPulseRange * 0.5f;
+    }
+
+    /**
+     * Prints the maze as text, for the verbose mode.
+     */
+    void printMaze(FILE* out) const;
+
+private:
+    enum class Phase {
+        IN_HOLDER,
+        IN_MAZE,
+        IN_HOLE,
+        IN_CHUTE,
+        COLLECTED
+    };
+
+    struct Servo {
+        std::vector<float> commands;    // Dead time delay line of the commanded pulse widths, one per millisecond
+        size_t next = 0;
+        float positionUs = 1500.0f;
+        float speedUsS = 0.0f;
+    };
+
+    static constexpr size_t HISTORY_MS = 1000;
+
+    WorldConfig config;
+    GameConfig gameConfig;
+    uint8_t ballDropPin;
+    int size;
+    std::vector<uint8_t> eastWalls;     // Wall on the east side of each cell
+    std::vector<uint8_t> southWalls;    // Wall on the south side of each cell
+    std::vector<int> solution;          // Path from the start cell to the goal
+    std::vector<float> turnOvershoot;   // Largest overshoot of each solution cell, negative if not a turn
+    std::vector<uint8_t> turnVisited;
+
+    SimulatedImu imu;
+    Servo servos[2];
+    float levelPulseUs[2];
+    float imuMountDeg[2];
+    float tiltDeg[2] = {0.0f, 0.0f};
+    float tiltRateDps[2] = {0.0f, 0.0f};
+
+    Phase phase = Phase::IN_HOLDER;
+    float x = 0.0f, y = 0.0f, vx = 0.0f, vy = 0.0f;
+    float kickHeldMs = 0.0f;
+    int64_t fallUs = 0;
+    float chutePositionMm = 0.0f;
+    float chuteSpeedMmS = 0.0f;
+    bool sensorActive = false;
+    int currentCell = -1;
+    int64_t lastStepUs = 0;
+
+    BallState history[HISTORY_MS];
+    size_t historyHead = 0;
+
+    WorldMetrics metrics = {};
+
+    int cellIndex(int row, int col) const { return row * size + col; }
+    void generateMaze(std::mt19937& rng);
+    void stepServos(float dt);
+    void stepBall(float dt, int64_t nowUs);
+    void stepChute(float dt, int64_t nowUs);
+    void collide();
+    void bounce(float normalX, float normalY, float penetration);
+    void trackOvershoot();
+    void setSensor(bool active);
+};
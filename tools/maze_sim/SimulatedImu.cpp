@@ -0,0 +1,168 @@
+#include "SimulatedImu.hpp"
+
+namespace {
+    constexpr uint8_t kSmplrtDiv = 0x19;
+    constexpr uint8_t kConfig = 0x1A;
+    constexpr uint8_t kAccelConfig = 0x1C;
+    constexpr uint8_t kFifoEn = 0x23;
+    constexpr uint8_t kIntStatus = 0x3A;
+    constexpr uint8_t kAccelXoutH = 0x3B;
+    constexpr uint8_t kUserCtrl = 0x6A;
+    constexpr uint8_t kPwrMgmt1 = 0x6B;
+    constexpr uint8_t kFifoCountH = 0x72;
+    constexpr uint8_t kFifoCountL = 0x73;
+    constexpr uint8_t kFifoRW = 0x74;
+    constexpr uint8_t kWhoAmI = 0x75;
+
+    constexpr uint8_t kConfigFifoModeStop = 0x40;
+    constexpr uint8_t kFifoEnGyroAccel = 0x18;
+    constexpr uint8_t kUserCtrlFifoEn = 0x40;
+    constexpr uint8_t kUserCtrlFifoRst = 0x04;
+    constexpr uint8_t kPwrMgmt1Reset = 0x80;
+    constexpr uint8_t kIntFifoOverflow = 0x10;
+    constexpr uint8_t kIntDataReady = 0x01;
+
+    constexpr float kGyroLsbPerDps = 131.0f;
+    constexpr float kDegToRad = static_cast<float>(M_PI / 180.0);
+
+    void putWord(uint8_t* registers, uint8_t reg, int32_t value) {
+        int16_t clamped = static_cast<int16_t>(constrain(value, INT16_MIN, INT16_MAX));
+        registers[reg] = static_cast<uint8_t>(static_cast<uint16_t>(clamped) >> 8);
+        registers[reg + 1] = static_cast<uint8_t>(clamped & 0xFF);
+    }
+}
+
+SimulatedImu::SimulatedImu(uint32_t seed, float accelNoiseG, float gyroNoiseDps)
+    : rng(seed), accelNoise(0.0f, accelNoiseG), gyroNoise(0.0f, gyroNoiseDps) {
+    reset();
+}
+
+void SimulatedImu::reset() {
+    memset(registers, 0, sizeof(registers));
+    registers[kWhoAmI] = 0x19;
+    registers[kPwrMgmt1] = 0x40;    // Sleep
+    fifo.clear();
+    fifoCountLatch = 0;
+}
+
+void SimulatedImu::setAttitude(float angleXDeg, float angleYDeg, float rateXDps, float rateYDps) {
+    this->angleXDeg = angleXDeg;
+    this->angleYDeg = angleYDeg;
+    this->rateXDps = rateXDps;
+    this->rateYDps = rateYDps;
+}
+
+void SimulatedImu::tick(int64_t nowUs) {
+    int64_t periodUs = 1000LL * (1 + registers[kSmplrtDiv]);
+    if (nextSampleUs == 0 || nowUs - nextSampleUs > 100 * periodUs) {
+        nextSampleUs = nowUs;
+    }
+    while (nowUs >= nextSampleUs) {
+        sample();
+        nextSampleUs += periodUs;
+    }
+}
+
+void SimulatedImu::sample() {
+    // The firmware takes the X and Y angles as asin(-accel): gravity leans opposite to the angle. The gyroscope
+    // sees the rotation that moves gravity that way, the X angle being a rotation around Y and vice versa.
+    float gx = -sinf(angleXDeg * kDegToRad);
+    float gy = -sinf(angleYDeg * kDegToRad);
+    float gz = sqrtf(max(0.0f, 1.0f - gx * gx - gy * gy));
+    float lsbPerG = 16384.0f / (1 << ((registers[kAccelConfig] >> 3) & 0x03));
+
+    putWord(registers, kAccelXoutH, lroundf((gx + accelNoise(rng)) * lsbPerG));
+    putWord(registers, kAccelXoutH + 2, lroundf((gy + accelNoise(rng)) * lsbPerG));
+    putWord(registers, kAccelXoutH + 4, lroundf((gz + accelNoise(rng)) * lsbPerG));
+    putWord(registers, kAccelXoutH + 6, 0);  // 21 degrees
+    putWord(registers, kAccelXoutH + 8, lroundf((-rateYDps + gyroNoise(rng)) * kGyroLsbPerDps));
+    putWord(registers, kAccelXoutH + 10, lroundf((rateXDps + gyroNoise(rng)) * kGyroLsbPerDps));
+    putWord(registers, kAccelXoutH + 12, lroundf(gyroNoise(rng) * kGyroLsbPerDps));
+    registers[kIntStatus] |= kIntDataReady;
+
+    if (!(registers[kUserCtrl] & kUserCtrlFifoEn) || (registers[kFifoEn] & kFifoEnGyroAccel) != kFifoEnGyroAccel) {
+        return;
+    }
+    if (fifo.size() + PACKET_SIZE > FIFO_SIZE) {
+        registers[kIntStatus] |= kIntFifoOverflow;
+        fifoOverflows++;
+        if (registers[kConfig] & kConfigFifoModeStop) {
+            return;
+        }
+        fifo.erase(fifo.begin(), fifo.begin() + PACKET_SIZE);
+    }
+    fifo.insert(fifo.end(), &registers[kAccelXoutH], &registers[kAccelXoutH] + PACKET_SIZE);
+}
+
+void SimulatedImu::writeRegister(uint8_t reg, uint8_t value) {
+    switch (reg) {
+        case kPwrMgmt1:
+            if (value & kPwrMgmt1Reset) {
+                reset();
+                return;
+            }
+            break;
+        case kUserCtrl:
+            if (value & kUserCtrlFifoRst) {
+                fifo.clear();
+                value &= ~kUserCtrlFifoRst;
+            }
+            break;
+        case kFifoRW:
+        case kWhoAmI:
+        case kIntStatus:
+            return;
+        default:
+            break;
+    }
+    registers[reg & 0x7F] = value;
+}
+
+uint8_t SimulatedImu::readRegister(uint8_t reg) {
+    switch (reg) {
+        case kIntStatus: {
+            uint8_t status = registers[kIntStatus];
+            registers[kIntStatus] = 0;
+            return status;
+        }
+        case kFifoCountH:
+            fifoCountLatch = static_cast<uint16_t>(fifo.size());
+            return static_cast<uint8_t>(fifoCountLatch >> 8);
+        case kFifoCountL:
+            return static_cast<uint8_t>(fifoCountLatch & 0xFF);
+        default:
+            return registers[reg & 0x7F];
+    }
+}
+
+bool SimulatedImu::onWrite(const uint8_t* data, size_t length) {
+    if (length == 0) {
+        return true;    // Address probe
+    }
+    pointer = data[0] & 0x7F;
+    for (size_t i = 1; i < length; i++) {
+        writeRegister(pointer, data[i]);
+        if (pointer != kFifoRW) {
+            pointer = (pointer + 1) & 0x7F;
+        }
+    }
+    return true;
+}
+
+size_t SimulatedImu::onRead(uint8_t* buffer, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        if (pointer == kFifoRW) {
+            // Reading an empty FIFO returns the last byte again on the real sensor; zero is as good here
+            if (fifo.empty()) {
+                buffer[i] = 0;
+            } else {
+                buffer[i] = fifo.front();
+                fifo.pop_front();
+            }
+            continue;
+        }
+        buffer[i] = readRegister(pointer);
+        pointer = (pointer + 1) & 0x7F;
+    }
+    return length;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <Wire.h>
+
+#include <deque>
+#include <random>
+
+/**
+ * Register model of the MPU6886 on the simulated I2C bus, enough for the firmware driver: reset and identity,
+ * sample rate divider, direct reads of the accelerometer, temperature and gyroscope registers, and the FIFO
+ * (count, burst reads, stop-on-full mode and overflow flag). The sensor samples the attitude set by the world
+ * at its output data rate, with white noise.
+ */
+class SimulatedImu : public HostI2CDevice {
+public:
+    static constexpr uint8_t ADDRESS = 0x68;
+
+    /**
+     * @param seed Seed of the measurement noise.
+     * @param accelNoiseG Standard deviation of the accelerometer noise in g.
+     * @param gyroNoiseDps Standard deviation of the gyroscope noise in degrees per second.
+     */
+    SimulatedImu(uint32_t seed, float accelNoiseG, float gyroNoiseDps);
+
+    /**
+     * Sets the attitude sensed by the IMU, as the angles the firmware derives from the accelerometer.
+     * @param angleXDeg X angle in degrees.
+     * @param angleYDeg Y angle in degrees.
+     * @param rateXDps X angle rate in degrees per second.
+     * @param rateYDps Y angle rate in degrees per second.
+     */
+    void setAttitude(float angleXDeg, float angleYDeg, float rateXDps, float rateYDps);
+
+    /**
+     * Takes the samples due at the current time. Must be called at least once per sample period.
+     * @param nowUs Current virtual time in microseconds.
+     */
+    void tick(int64_t nowUs);
+
+    bool onWrite(const uint8_t* data, size_t length) override;
+    size_t onRead(uint8_t* buffer, size_t length) override;
+
+    uint32_t getFifoOverflows() const { return fifoOverflows; }
+
+private:
+    static constexpr size_t FIFO_SIZE = 1024;
+    static constexpr size_t PACKET_SIZE = 14;
+
+    uint8_t registers[128] = {};
+    uint8_t pointer = 0;
+    std::deque<uint8_t> fifo;
+    uint16_t fifoCountLatch = 0;
+    uint32_t fifoOverflows = 0;
+    int64_t nextSampleUs = 0;
+
+    float angleXDeg = 0.0f;
+    float angleYDeg = 0.0f;
+    float rateXDps = 0.0f;
+    float rateYDps = 0.0f;
+
+    std::mt19937 rng;
+    std::normal_distribution<float> accelNoise;
+    std::normal_distribution<float> gyroNoise;
+
+    void reset();
+    void sample();
+    void writeRegister(uint8_t reg, uint8_t value);
+    uint8_t readRegister(uint8_t reg);
+};
@@ -0,0 +1,465 @@
+/**
+ * Linux simulator of the tilting maze, to tune the game configuration without reflashing. It links the firmware
+ * Game with its servo motion loop, tilt control, IMU driver, I2C bus and servo calibration against the virtual-time
+ * host kernel, simulated servos (dead time, response, top speed), a rigid tilting table carrying the IMU, and a
+ * ball rolling in a random maze steered by a simulated player. Each game runs in its own kernel, far faster than
+ * real time, and the games of a parameter sweep run in parallel on all the cores.
+ *
+ * Usage:
+ *   maze_sim [options]
+ *     --games <n>             Games per parameter set, on the same mazes for every set (default 8)
+ *     --seed <n>              Seed of the first maze (default 1)
+ *     --jobs <n>              Parallel games (default: the number of cores)
+ *     --set <name>=<value>    Overrides a configuration parameter for every set
+ *     --sweep <name>=<v1,v2>  Sweeps a configuration parameter; several sweeps run their cartesian product
+ *     --maze-size <n>         Cells per side of the maze (default 6)
+ *     --reaction <ms>         Player reaction delay (default 150)
+ *     --table-gain <deg/us>   Table tilt per microsecond of servo pulse width (default 0.03)
+ *     --telemetry <file>      Writes the in-game telemetry of the first game in the TELEMETRY_DUMP format
+ *     --verbose               Prints the firmware log, the mazes and every game (use with --jobs 1)
+ *     --list                  Lists the configuration parameters
+ *
+ * Parameter sets are ranked by score, lower is better:
+ *   mean time to target (s, the time limit for a lost game)
+ *   + 0.1 s per mm of mean overshoot past the turns of the maze
+ *   + 0.2 s per s of mean turnaround (ball drop to ready for the next game)
+ *   + 30 s per kickback miss or ball collection failure, as a fraction of the games
+ */
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <esp_timer.h>
+#include <HostKernel.h>
+
+#include <Config.hpp>
+#include <Game.hpp>
+#include <I2CBus.hpp>
+#include <MPU6886.hpp>
+
+#include "MazePlayer.hpp"
+#include "MazeWorld.hpp"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace {
+    constexpr uint8_t kXServoPin = 7;       // As in PinsDefinitions.h
+    constexpr uint8_t kYServoPin = 8;
+    constexpr uint8_t kBallDropPin = 9;
+    constexpr uint32_t kPrepareMs = 1500;   // Time the player waits between the game preparation and the start
+    constexpr uint32_t kCollectionGraceMs = 500;
+    constexpr uint32_t kTelemetryRecords = 16384;
+
+    constexpr float kOvershootWeightSPerMm = 0.1f;
+    constexpr float kTurnaroundWeight = 0.2f;
+    constexpr float kFailurePenaltyS = 30.0f;
+
+    struct Parameter {
+        const char* name;
+        void (*apply)(GameConfig& config, double value);
+    };
+
+    const Parameter kParameters[] = {
+        {"maxServoPulseRate", [](GameConfig& c, double v) { c.maxServoPulseRate = static_cast<uint16_t>(v); }},
+        {"maxServoPulseAccel", [](GameConfig& c, double v) { c.maxServoPulseAccel = static_cast<uint32_t>(v); }},
+        {"maxServoPulseJerk", [](GameConfig& c, double v) { c.maxServoPulseJerk = static_cast<uint32_t>(v); }},
+        {"servoPulseRange", [](GameConfig& c, double v) { c.servoPulseRange = static_cast<uint16_t>(v); }},
+        {"servoLoopRateHz", [](GameConfig& c, double v) { c.servoLoopRateHz = static_cast<uint16_t>(v); }},
+        {"prepareKickBackDelayMs", [](GameConfig& c, double v) { c.prepareKickBackDelayMs = static_cast<uint16_t>(v); }},
+        {"ballDropTimeMs", [](GameConfig& c, double v) { c.ballDropTimeMs = static_cast<uint16_t>(v); }},
+        {"tiltControlEnabled", [](GameConfig& c, double v) { c.tiltControlEnabled = v != 0.0; }},
+        {"tiltMaxAngleDeg", [](GameConfig& c, double v) { c.tiltMaxAngleDeg = static_cast<float>(v); }},
+        {"tiltKp", [](GameConfig& c, double v) { c.tiltKp = static_cast<float>(v); }},
+        {"tiltKi", [](GameConfig& c, double v) { c.tiltKi = static_cast<float>(v); }},
+        {"tiltKd", [](GameConfig& c, double v) { c.tiltKd = static_cast<float>(v); }},
+    };
+
+    struct Setting {
+        const Parameter* parameter;
+        std::vector<double> values;
+    };
+
+    struct SimOptions {
+        int games = 8;
+        uint32_t seed = 1;
+        unsigned jobs = 0;
+        bool verbose = false;
+        const char* telemetryPath = nullptr;
+        WorldConfig world;
+        PlayerConfig player;
+        std::vector<Setting> fixed;
+        std::vector<Setting> sweeps;
+    };
+
+    struct GameOutcome {
+        bool won;
+        float timeToTargetS;
+        bool kickbackMiss;
+        bool collectionFailure;
+        float turnaroundS;
+        WorldMetrics world;
+        double virtualS;
+        CalibrationMode calibration;
+    };
+
+    struct SetSummary {
+        std::vector<double> values;     // Value of each swept parameter
+        int games;
+        int wins;
+        float meanTimeS;
+        float meanOvershootMm;
+        float maxOvershootMm;
+        float wallHitsPerGame;
+        int kickbackMisses;
+        int collectionFailures;
+        float meanTurnaroundS;
+        float score;
+    };
+
+    /**
+     * Writes a Print stream to a file, for the telemetry dump.
+     */
+    class FilePrint : public Print {
+    public:
+        explicit FilePrint(FILE* file) : file(file) {}
+        size_t write(uint8_t c) override { return fputc(c, file) == EOF ? 0 : 1; }
+        size_t write(const uint8_t* buffer, size_t size) override { return fwrite(buffer, 1, size, file); }
+
+    private:
+        FILE* file;
+    };
+
+    const Parameter* findParameter(const char* name) {
+        for (const Parameter& parameter : kParameters) {
+            if (strcmp(parameter.name, name) == 0) {
+                return &parameter;
+            }
+        }
+        return nullptr;
+    }
+
+    bool parseSetting(const char* text, Setting& setting) {
+        const char* equals = strchr(text, '=');
+        if (equals == nullptr) {
+            return false;
+        }
+        std::string name(text, equals - text);
+        setting.parameter = findParameter(name.c_str());
+        if (setting.parameter == nullptr) {
+            fprintf(stderr, "Unknown parameter %s, see --list\n", name.c_str());
+            return false;
+        }
+        const char* cursor = equals + 1;
+        while (*cursor != '\0') {
+            char* end;
+            setting.values.push_back(strtod(cursor, &end));
+            if (end == cursor || (*end != ',' && *end != '\0')) {
+                return false;
+            }
+            cursor = *end == ',' ? end + 1 : end;
+        }
+        return !setting.values.empty();
+    }
+
+    bool parseArgs(int argc, char** argv, SimOptions& options) {
+        for (int i = 1; i < argc; i++) {
+            const char* arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (strcmp(arg, "--games") == 0 && hasValue) {
+                options.games = atoi(argv[++i]);
+            } else if (strcmp(arg, "--seed") == 0 && hasValue) {
+                options.seed = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+            } else if (strcmp(arg, "--jobs") == 0 && hasValue) {
+                options.jobs = static_cast<unsigned>(atoi(argv[++i]));
+            } else if ((strcmp(arg, "--set") == 0 || strcmp(arg, "--sweep") == 0) && hasValue) {
+                Setting setting;
+                if (!parseSetting(argv[++i], setting)) {
+                    return false;
+                }
+                (arg[2] == 's' && arg[3] == 'e' ? options.fixed : options.sweeps).push_back(setting);
+            } else if (strcmp(arg, "--maze-size") == 0 && hasValue) {
+                options.world.mazeSize = atoi(argv[++i]);
+            } else if (strcmp(arg, "--reaction") == 0 && hasValue) {
+                options.player.reactionMs = static_cast<float>(atof(argv[++i]));
+            } else if (strcmp(arg, "--table-gain") == 0 && hasValue) {
+                options.world.tableGainDegPerUs = static_cast<float>(atof(argv[++i]));
+            } else if (strcmp(arg, "--telemetry") == 0 && hasValue) {
+                options.telemetryPath = argv[++i];
+            } else if (strcmp(arg, "--verbose") == 0) {
+                options.verbose = true;
+            } else if (strcmp(arg, "--list") == 0) {
+                for (const Parameter& parameter : kParameters) {
+                    printf("%s\n", parameter.name);
+                }
+                exit(0);
+            } else {
+                return false;
+            }
+        }
+        return options.games > 0 && options.world.mazeSize >= 2;
+    }
+
+    void IRAM_ATTR onBallDropInterrupt(void* arg) {
+        // The sensor pulls the pin low while it detects the ball, as in main.cpp
+        static_cast<Game*>(arg)->setBallDropSignal(digitalRead(kBallDropPin) == LOW);
+    }
+
+    struct SimTasks {
+        Game& game;
+        MPU6886& imu;
+        I2CBus& bus;
+        MazePlayer& player;
+    };
+
+    /**
+     * Boots the firmware on a fresh virtual board (calibration included) and plays a single game.
+     */
+    GameOutcome runGame(const SimOptions& options, GameConfig config, uint32_t seed, FILE* telemetry) {
+        HostKernel kernel;
+        int64_t bootUs = kernel.nowUs();
+        if (telemetry == nullptr) {
+            config.telemetryCapacityRecords = 1;    // Nothing is dumped: keep the jobs small
+        } else {
+            config.telemetryCapacityRecords = kTelemetryRecords;
+        }
+
+        MazeWorld world(options.world, config, seed, kBallDropPin);
+        TwoWire wire(0);
+        wire.attachDevice(SimulatedImu::ADDRESS, &world.getImu());
+        I2CBus bus(wire);
+        MPU6886 imu(bus);
+        HardwareServo xServo(kXServoPin, MazeWorld::X_SERVO_CHANNEL, -180, 180, 500, 2500, true);
+        HardwareServo yServo(kYServoPin, MazeWorld::Y_SERVO_CHANNEL, -180, 180, 500, 2500);
+        Game game(xServo, yServo);
+        MazePlayer player(options.player, world, seed ^ 0x9E3779B9u);
+        SimTasks tasks = {game, imu, bus, player};
+        if (options.verbose) {
+            world.printMaze(stdout);
+        }
+
+        // The physics runs at 1 kHz in a timer of the virtual kernel, between the firmware tasks
+        esp_timer_create_args_t physicsArgs = {};
+        physicsArgs.callback = [](void* arg) { static_cast<MazeWorld*>(arg)->step(esp_timer_get_time()); };
+        physicsArgs.arg = &world;
+        physicsArgs.name = "Physics";
+        esp_timer_handle_t physics;
+        esp_timer_create(&physicsArgs, &physics);
+        esp_timer_start_periodic(physics, 1000);
+
+        // Same boot sequence and task priorities as setup() in main.cpp
+        pinMode(kBallDropPin, INPUT_PULLUP);
+        attachInterruptArg(digitalPinToInterrupt(kBallDropPin), onBallDropInterrupt, &game, CHANGE);
+        wire.begin();
+        xTaskCreatePinnedToCore([](void* param) { static_cast<SimTasks*>(param)->bus.run(); },
+            "I2CBusTask", 3072, &tasks, 4, nullptr, 0);
+        if (!imu.begin(MPU6886::AccelScale::RANGE_2G)) {
+            fprintf(stderr, "Simulated IMU initialization failed\n");
+            exit(1);
+        }
+        xServo.begin(0);
+        yServo.begin(0);
+        game.begin(config);
+        xTaskCreatePinnedToCore([](void* param) {
+            SimTasks* tasks = static_cast<SimTasks*>(param);
+            while (true) {
+                float x, y;
+                tasks->player.update(millis(), tasks->game.isRunning(), x, y);
+                tasks->game.update(x, y);
+                delay(10);
+            }
+        }, "GameTask", 4096, &tasks, 1, nullptr, 1);
+        game.servoCalibration(imu);
+        xTaskCreatePinnedToCore([](void* param) {
+            SimTasks* tasks = static_cast<SimTasks*>(param);
+            tasks->game.tiltSensorLoop(tasks->imu);
+        }, "TiltSensorTask", 4096, &tasks, 2, nullptr, 0);
+
+        // Play one game as the main loop does, the player pressing start once the table is prepared
+        world.resetForGame();
+        game.prepareGame();
+        delay(kPrepareMs);
+        game.start(GameLevel::EASY);
+        int64_t kickbackEndUs = esp_timer_get_time();
+        int64_t deadlineUs = kickbackEndUs + (static_cast<int64_t>(config.easyTimeLimitMs) + config.ballDropTimeMs) * 1000 +
+                             10000000;
+        while (!game.isReadyToStart() && esp_timer_get_time() < deadlineUs) {
+            delay(20);
+        }
+        int64_t readyUs = esp_timer_get_time();
+        delay(kCollectionGraceMs);
+
+        GameOutcome outcome = {};
+        GameLevel level;
+        GameResult result;
+        uint32_t completionMs;
+        game.lastGameStats(level, result, completionMs);
+        outcome.world = world.getMetrics();
+        outcome.won = result == GameResult::WON;
+        outcome.timeToTargetS = outcome.won ? completionMs / 1000.0f : config.easyTimeLimitMs / 1000.0f;
+        outcome.kickbackMiss = !outcome.world.released || outcome.world.releaseUs > kickbackEndUs;
+        outcome.collectionFailure = outcome.won && (!outcome.world.collected || outcome.world.collectedUs > readyUs);
+        outcome.turnaroundS = outcome.won ? (readyUs - outcome.world.dropUs) / 1e6f : 0.0f;
+        outcome.calibration = game.getCalibrationReport().mode;
+        outcome.virtualS = (esp_timer_get_time() - bootUs) / 1e6;
+
+        if (telemetry != nullptr) {
+            FilePrint out(telemetry);
+            game.getTelemetry().dumpTo(out);
+        }
+        return outcome;
+    }
+
+    SetSummary summarize(const std::vector<double>& values, const GameOutcome* outcomes, int games) {
+        SetSummary summary = {};
+        summary.values = values;
+        summary.games = games;
+        uint32_t turns = 0;
+        float sumOvershoot = 0.0f;
+        uint32_t wallHits = 0;
+        float sumTime = 0.0f;
+        float sumTurnaround = 0.0f;
+        for (int i = 0; i < games; i++) {
+            const GameOutcome& outcome = outcomes[i];
+            summary.wins += outcome.won ? 1 : 0;
+            sumTime += outcome.timeToTargetS;
+            turns += outcome.world.turns;
+            sumOvershoot += outcome.world.sumOvershootMm;
+            summary.maxOvershootMm = max(summary.maxOvershootMm, outcome.world.maxOvershootMm);
+            wallHits += outcome.world.wallHits;
+            summary.kickbackMisses += outcome.kickbackMiss ? 1 : 0;
+            summary.collectionFailures += outcome.collectionFailure ? 1 : 0;
+            sumTurnaround += outcome.turnaroundS;
+        }
+        summary.meanTimeS = sumTime / games;
+        summary.meanOvershootMm = turns > 0 ? sumOvershoot / turns : 0.0f;
+        summary.wallHitsPerGame = static_cast<float>(wallHits) / games;
+        summary.meanTurnaroundS = summary.wins > 0 ? sumTurnaround / summary.wins : 0.0f;
+        summary.score = summary.meanTimeS + kOvershootWeightSPerMm * summary.meanOvershootMm +
+                        kTurnaroundWeight * summary.meanTurnaroundS +
+                        kFailurePenaltyS * (summary.kickbackMisses + summary.collectionFailures) / games;
+        return summary;
+    }
+}
+
+int main(int argc, char** argv) {
+    SimOptions options;
+    if (!parseArgs(argc, argv, options)) {
+        fprintf(stderr, "Usage: %s [--games n] [--seed n] [--jobs n] [--set name=value] [--sweep name=v1,v2,...] "
+                        "[--maze-size n] [--reaction ms] [--table-gain deg/us] [--telemetry file] [--verbose] "
+                        "[--list]\n", argv[0]);
+        return 2;
+    }
+    if (!options.verbose) {
+        Serial.attach(-1, -1);
+    }
+
+    // Cartesian product of the swept values, on top of the defaults and the fixed settings
+    GameConfig baseConfig = getDefaultGameConfig();
+    for (const Setting& setting : options.fixed) {
+        setting.parameter->apply(baseConfig, setting.values.back());
+    }
+    std::vector<std::vector<double>> sets = {{}};
+    for (const Setting& sweep : options.sweeps) {
+        std::vector<std::vector<double>> expanded;
+        for (const std::vector<double>& set : sets) {
+            for (double value : sweep.values) {
+                expanded.push_back(set);
+                expanded.back().push_back(value);
+            }
+        }
+        sets = expanded;
+    }
+
+    FILE* telemetry = nullptr;
+    if (options.telemetryPath != nullptr) {
+        telemetry = fopen(options.telemetryPath, "w");
+        if (telemetry == nullptr) {
+            perror(options.telemetryPath);
+            return 1;
+        }
+    }
+
+    // Every game is an independent job: its own kernel, board and firmware objects
+    size_t jobCount = sets.size() * options.games;
+    std::vector<GameOutcome> outcomes(jobCount);
+    std::atomic<size_t> nextJob(0);
+    std::atomic<size_t> doneJobs(0);
+    unsigned workers = options.jobs > 0 ? options.jobs : max(1u, std::thread::hardware_concurrency());
+    workers = static_cast<unsigned>(min<size_t>(workers, jobCount));
+    auto wallStart = std::chrono::steady_clock::now();
+
+    auto worker = [&]() {
+        size_t job;
+        while ((job = nextJob++) < jobCount) {
+            const std::vector<double>& set = sets[job / options.games];
+            int gameIndex = static_cast<int>(job % options.games);
+            GameConfig config = baseConfig;
+            for (size_t i = 0; i < set.size(); i++) {
+                options.sweeps[i].parameter->apply(config, set[i]);
+            }
+            // Common random numbers: game n plays the same maze and player for every parameter set
+            outcomes[job] = runGame(options, config, options.seed + gameIndex, job == 0 ? telemetry : nullptr);
+            if (options.verbose) {
+                const GameOutcome& outcome = outcomes[job];
+                printf("set %zu game %d: %s %.2f s, %lu turns, overshoot %.1f mm, %lu wall hits%s%s\n",
+                    job / options.games, gameIndex, outcome.won ? "won" : "lost", outcome.timeToTargetS,
+                    (unsigned long)outcome.world.turns,
+                    outcome.world.turns > 0 ? outcome.world.sumOvershootMm / outcome.world.turns : 0.0f,
+                    (unsigned long)outcome.world.wallHits, outcome.kickbackMiss ? ", kickback missed" : "",
+                    outcome.collectionFailure ? ", ball not collected" : "");
+            }
+            size_t done = ++doneJobs;
+            if (!options.verbose && isatty(STDERR_FILENO)) {
+                fprintf(stderr, "\r%zu/%zu games", done, jobCount);
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < workers; i++) {
+        threads.emplace_back(worker);
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    double wallS = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    if (!options.verbose && isatty(STDERR_FILENO)) {
+        fprintf(stderr, "\n");
+    }
+    if (telemetry != nullptr) {
+        fclose(telemetry);
+    }
+
+    std::vector<SetSummary> summaries;
+    double virtualS = 0.0;
+    for (size_t set = 0; set < sets.size(); set++) {
+        summaries.push_back(summarize(sets[set], &outcomes[set * options.games], options.games));
+    }
+    for (const GameOutcome& outcome : outcomes) {
+        virtualS += outcome.virtualS;
+    }
+    std::sort(summaries.begin(), summaries.end(),
+              [](const SetSummary& a, const SetSummary& b) { return a.score < b.score; });
+
+    printf("%zu parameter sets x %d games, %.0f s simulated in %.1f s on %u threads (%.0fx real time)\n",
+        sets.size(), options.games, virtualS, wallS, workers, virtualS / wallS);
+    printf("rank");
+    for (const Setting& sweep : options.sweeps) {
+        printf(" %*s", max(8, static_cast<int>(strlen(sweep.parameter->name))), sweep.parameter->name);
+    }
+    printf("   score  win%%  time s  overshoot mm (max)  hits/game  kick miss  not collected  turnaround s\n");
+    for (size_t i = 0; i < summaries.size(); i++) {
+        const SetSummary& summary = summaries[i];
+        printf("%4zu", i + 1);
+        for (size_t j = 0; j < options.sweeps.size(); j++) {
+            printf(" %*g", max(8, static_cast<int>(strlen(options.sweeps[j].parameter->name))), summary.values[j]);
+        }
+        printf(" %7.2f %5.0f %7.2f %8.1f (%5.1f) %10.1f %10d %14d %13.2f\n", summary.score,
+            100.0f * summary.wins / summary.games, summary.meanTimeS, summary.meanOvershootMm, summary.maxOvershootMm,
+            summary.wallHitsPerGame, summary.kickbackMisses, summary.collectionFailures, summary.meanTurnaroundS);
+    }
+    return 0;
+}
@@ -0,0 +1,415 @@
+/**
+ * Linux comparison of the jerk-limited servo motion profiler (lib/MotionProfiler) with the velocity limiter it
+ * replaced (lib/SlewRateLimiter). Both run at the servo loop rate with the limits of getDefaultGameConfig() and
+ * drive a servo model: a second order position loop with a torque (acceleration) limit, the response of a hobby
+ * servo to its pulse width.
+ *
+ * The move test compares, for steps of growing size, the peak acceleration of the commanded pulse, the overshoot of
+ * the servo and its settling time. The servo follows a step faster than any ramp, so the profiler trades the
+ * speed of the short moves for the overshoot of the long ones: it must settle the servo sooner after the command
+ * reaches the target, the long moves sooner than the limiter, and the short ones at most kMaxShortMoveDelayMs
+ * later. The slow move test runs the preparation of a game at prepareGamePulseRate, a
+ * rate the limiter rounds to zero at the loop period. The kickback test switches from the preparation to the
+ * kickback of Game::start in the middle of the move, the servo overshooting by kMaxKickbackOvershootUs at most. The retarget test changes the target and the limits at random
+ * times: the profiler must never exceed its limits, never overshoot its target and always settle.
+ *
+ * Usage:
+ *   motion_profile_sim [options]
+ *     --seed <n>          Random seed of the retarget test (default 1)
+ *     --cases <n>         Cases of the retarget test (default 2000)
+ *     --accel <us/s^2>    Acceleration limit (default: getDefaultGameConfig())
+ *     --jerk <us/s^3>     Jerk limit (default: getDefaultGameConfig())
+ *
+ * The exit status is 0 when every test passes.
+ */
+
+#include <Config.hpp>
+#include <MotionProfiler.hpp>
+#include <SlewRateLimiter.hpp>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <random>
+
+namespace {
+    constexpr float kServoNaturalHz = 8.0f;         // Bandwidth of the servo position loop
+    constexpr float kServoDamping = 0.6f;           // Damping ratio of the servo position loop
+    constexpr float kServoMaxAccel = 60000.0f;      // Torque limit of the servo, in us of pulse per s^2
+    constexpr float kServoSubstepS = 0.0001f;       // Integration step of the servo model
+    constexpr float kSettleToleranceUs = 3.0f;      // Servo position error of a settled move (about the deadband)
+    constexpr float kAccelMargin = 1.02f;           // Rounding of the fixed-point profile on the acceleration limit
+    constexpr uint16_t kStartPulseUs = 1500;
+    constexpr int16_t kLongMoveUs = 300;            // Moves settling sooner than with the limiter
+    constexpr float kMaxShortMoveDelayMs = 40.0f;   // Settling delay of the shorter moves on the limiter
+    constexpr float kMaxKickbackOvershootUs = 10.0f;
+
+    struct Options {
+        uint32_t seed = 1;
+        uint32_t cases = 2000;
+        uint32_t accel = 0;     // Acceleration limit, 0 for the one of getDefaultGameConfig()
+        uint32_t jerk = 0;      // Jerk limit, 0 for the one of getDefaultGameConfig()
+    };
+
+    /**
+     * Servo following its pulse width, in pulse width units.
+     */
+    struct ServoModel {
+        float positionUs;
+        float velocity = 0.0f;
+        float peakAccel = 0.0f;
+
+        explicit ServoModel(float positionUs) : positionUs(positionUs) {}
+
+        void step(float pulseUs, float dtS) {
+            const float omega = 2.0f * M_PI * kServoNaturalHz;
+            for (float t = 0.0f; t < dtS - kServoSubstepS * 0.5f; t += kServoSubstepS) {
+                float accel = omega * omega * (pulseUs - positionUs) - 2.0f * kServoDamping * omega * velocity;
+                accel = std::max(-kServoMaxAccel, std::min(kServoMaxAccel, accel));
+                peakAccel = std::max(peakAccel, fabsf(accel));
+                velocity += accel * kServoSubstepS;
+                positionUs += velocity * kServoSubstepS;
+            }
+        }
+    };
+
+    /**
+     * Motion of a move through one of the two pipelines.
+     */
+    struct MoveResult {
+        float commandPeakAccel = 0.0f;  // Peak acceleration of the commanded pulse
+        float commandSettleMs = -1.0f;  // Time to the commanded pulse reaching the target, negative if never
+        float servoOvershootUs = 0.0f;  // Largest servo excursion past the target
+        float servoSettleMs = -1.0f;    // Time to the servo settling on the target, negative if never
+        float servoPeakAccel = 0.0f;
+    };
+
+    /**
+     * Pulse generator of a pipeline: the old limiter or the profiler, behind the interface of the motion loop.
+     */
+    struct Pipeline {
+        bool profiled;
+        SlewRateLimiter<int16_t> limiter;
+        MotionProfiler<int16_t> profiler;
+
+        Pipeline(bool profiled, const GameConfig& config, uint16_t rate)
+            : profiled(profiled), limiter(kStartPulseUs, rate),
+              profiler(kStartPulseUs, rate, config.maxServoPulseAccel, config.maxServoPulseJerk) {}
+
+        void setRate(uint16_t rate) {
+            limiter.setMaxRate(rate);
+            profiler.setMaxVelocity(rate);
+        }
+
+        void setTarget(int16_t target) {
+            limiter.setTarget(target);
+            profiler.setTarget(target);
+        }
+
+        void update(uint32_t deltaTimeMs) {
+            if (profiled) {
+                profiler.update(deltaTimeMs);
+            } else {
+                limiter.update(deltaTimeMs);
+            }
+        }
+
+        int16_t getCurrentValue() const {
+            return profiled ? profiler.getCurrentValue() : limiter.getCurrentValue();
+        }
+    };
+
+    /**
+     * Runs a move through a pipeline.
+     * @param config Game configuration, for the limits and the loop rate.
+     * @param profiled true for the profiler, false for the old limiter.
+     * @param rate Velocity limit at the start of the move.
+     * @param targetUs Target pulse width.
+     * @param durationS Duration of the run.
+     * @param switchAtS Time of a switch to switchRate and switchTargetUs, negative for none.
+     */
+    MoveResult runMove(const GameConfig& config, bool profiled, uint16_t rate, int16_t targetUs, float durationS,
+                       float switchAtS = -1.0f, uint16_t switchRate = 0, int16_t switchTargetUs = 0) {
+        uint32_t periodMs = 1000 / config.servoLoopRateHz;
+        float periodS = periodMs * 0.001f;
+        Pipeline pipeline(profiled, config, rate);
+        ServoModel servo(kStartPulseUs);
+        pipeline.setTarget(targetUs);
+
+        MoveResult result;
+        float startUs = kStartPulseUs;
+        float lastCommandUs = kStartPulseUs;
+        float lastCommandVelocity = 0.0f;
+        float lastServoOutS = 0.0f;
+        float lastCommandOffS = 0.0f;
+        bool switched = false;
+        uint32_t steps = (uint32_t)(durationS / periodS);
+        for (uint32_t i = 0; i < steps; i++) {
+            float timeS = i * periodS;
+            if (!switched && switchAtS >= 0.0f && timeS >= switchAtS) {
+                pipeline.setRate(switchRate);
+                pipeline.setTarget(switchTargetUs);
+                startUs = servo.positionUs;
+                targetUs = switchTargetUs;
+                switched = true;
+            }
+            pipeline.update(periodMs);
+            // The velocity of the profiler is that of its fixed-point state, its output rounds it by a unit per step
+            float commandUs = pipeline.getCurrentValue();
+            float commandVelocity = profiled ? pipeline.profiler.getVelocity() : (commandUs - lastCommandUs) / periodS;
+            result.commandPeakAccel = std::max(result.commandPeakAccel,
+                fabsf(commandVelocity - lastCommandVelocity) / periodS);
+            lastCommandUs = commandUs;
+            lastCommandVelocity = commandVelocity;
+            if (commandUs != targetUs) {
+                lastCommandOffS = timeS + periodS;
+            }
+
+            servo.step(commandUs, periodS);
+            float pastTargetUs = (servo.positionUs - targetUs) * (targetUs >= startUs ? 1.0f : -1.0f);
+            if (switched || switchAtS < 0.0f) {
+                result.servoOvershootUs = std::max(result.servoOvershootUs, pastTargetUs);
+            }
+            if (fabsf(servo.positionUs - targetUs) > kSettleToleranceUs) {
+                lastServoOutS = timeS + periodS;
+            }
+        }
+        float settleFromS = switchAtS >= 0.0f ? switchAtS : 0.0f;
+        if (lastCommandUs == targetUs) {
+            result.commandSettleMs = (lastCommandOffS - settleFromS) * 1000.0f;
+        }
+        if (fabsf(servo.positionUs - targetUs) <= kSettleToleranceUs) {
+            result.servoSettleMs = (lastServoOutS - settleFromS) * 1000.0f;
+        }
+        result.servoPeakAccel = servo.peakAccel;
+        return result;
+    }
+
+    void printMove(const char* name, const MoveResult& result) {
+        printf("    %-10s %12.0f %16.1f ", name, result.commandPeakAccel, result.servoOvershootUs);
+        if (result.commandSettleMs < 0.0f) {
+            printf("%12s", "never");
+        } else {
+            printf("%12.0f", result.commandSettleMs);
+        }
+        if (result.servoSettleMs < 0.0f) {
+            printf(" %14s", "never");
+        } else {
+            printf(" %14.0f", result.servoSettleMs);
+        }
+        printf(" %14.0f\n", result.servoPeakAccel);
+    }
+
+    void printHeader() {
+        printf("    %-10s %12s %16s %12s %14s %14s\n", "", "us/s^2", "overshoot us", "command ms", "settle ms",
+            "servo us/s^2");
+    }
+
+    /**
+     * Steps of growing size at the game rate.
+     */
+    bool testMoves(const GameConfig& config) {
+        bool ok = true;
+        printf("  moves at %u us/s, servo settling within %.0f us\n", (unsigned)config.maxServoPulseRate,
+            kSettleToleranceUs);
+        printHeader();
+        for (int16_t sizeUs : {20, 50, 150, 300, 600}) {
+            MoveResult limiter = runMove(config, false, config.maxServoPulseRate, kStartPulseUs + sizeUs, 2.0f);
+            MoveResult profiler = runMove(config, true, config.maxServoPulseRate, kStartPulseUs + sizeUs, 2.0f);
+            bool moveOk = profiler.commandPeakAccel <= config.maxServoPulseAccel * kAccelMargin &&
+                profiler.servoSettleMs >= 0.0f && profiler.servoOvershootUs <= limiter.servoOvershootUs &&
+                profiler.servoSettleMs - profiler.commandSettleMs <= limiter.servoSettleMs - limiter.commandSettleMs &&
+                (sizeUs >= kLongMoveUs ? profiler.servoSettleMs < limiter.servoSettleMs
+                                       : profiler.servoSettleMs <= limiter.servoSettleMs + kMaxShortMoveDelayMs);
+            printf("   %d us%s\n", sizeUs, moveOk ? "" : "  FAIL");
+            printMove("limiter", limiter);
+            printMove("profiler", profiler);
+            ok = ok && moveOk;
+        }
+        return ok;
+    }
+
+    /**
+     * The move of Game::prepareGame, at a rate below one pulse width unit per loop period.
+     */
+    bool testSlowMove(const GameConfig& config) {
+        int16_t targetUs = kStartPulseUs + config.prepareGameXPulseus;
+        MoveResult limiter = runMove(config, false, config.prepareGamePulseRate, targetUs, 3.0f);
+        MoveResult profiler = runMove(config, true, config.prepareGamePulseRate, targetUs, 3.0f);
+        float expectedMs = fabsf(config.prepareGameXPulseus) * 1000.0f / config.prepareGamePulseRate;
+        bool ok = profiler.commandSettleMs >= 0.0f && profiler.commandSettleMs <= expectedMs * 1.2f;
+        printf("  slow move of %d us at %u us/s, ideally %.0f ms: limiter ", (int)config.prepareGameXPulseus,
+            (unsigned)config.prepareGamePulseRate, expectedMs);
+        if (limiter.commandSettleMs < 0.0f) {
+            printf("stalled");
+        } else {
+            printf("%.0f ms", limiter.commandSettleMs);
+        }
+        printf(", profiler %.0f ms%s\n", profiler.commandSettleMs, ok ? "" : "  FAIL");
+        return ok;
+    }
+
+    /**
+     * Game::start in the middle of the preparation: the rate jumps to the game rate and the target reverses.
+     */
+    bool testKickback(const GameConfig& config) {
+        int16_t prepareUs = kStartPulseUs + config.prepareGameXPulseus;
+        int16_t kickbackUs = kStartPulseUs - config.prepareGameXPulseus;
+        // The limiter does not move at the preparation rate, so both start the kickback from a full speed move
+        uint16_t prepareRate = config.maxServoPulseRate / 4;
+        MoveResult limiter = runMove(config, false, prepareRate, prepareUs, 2.0f, 0.05f, config.maxServoPulseRate,
+            kickbackUs);
+        MoveResult profiler = runMove(config, true, prepareRate, prepareUs, 2.0f, 0.05f, config.maxServoPulseRate,
+            kickbackUs);
+        bool ok = profiler.commandPeakAccel <= config.maxServoPulseAccel * kAccelMargin &&
+            profiler.servoSettleMs >= 0.0f && profiler.servoOvershootUs <= kMaxKickbackOvershootUs;
+        printf("  kickback from %u to %u us/s in the middle of a move%s\n", (unsigned)prepareRate,
+            (unsigned)config.maxServoPulseRate, ok ? "" : "  FAIL");
+        printHeader();
+        printMove("limiter", limiter);
+        printMove("profiler", profiler);
+        return ok;
+    }
+
+    /**
+     * Gets the shortest stopping distance of a motion, braking as hard as the limits allow.
+     * @param v Velocity towards the target, positive.
+     * @param a Acceleration towards the target.
+     * @param maxAccel Acceleration limit.
+     * @param maxJerk Jerk limit.
+     */
+    float stoppingDistance(float v, float a, float maxAccel, float maxJerk) {
+        const float dtS = 1e-5f;
+        float distance = 0.0f;
+        for (uint32_t i = 0; v > 0.0f && i < 10000000; i++) {
+            // Ramp the braking out once it would otherwise reverse the motion
+            if (a < 0.0f && v <= a * a / (2.0f * maxJerk)) {
+                a = std::min(0.0f, a + maxJerk * dtS);
+            } else {
+                a = std::max(-maxAccel, a - maxJerk * dtS);
+            }
+            v += a * dtS;
+            distance += std::max(v, 0.0f) * dtS;
+        }
+        return distance;
+    }
+
+    /**
+     * Random targets, limits and update periods, retargeted at random times.
+     */
+    bool testRetarget(const Options& options) {
+        std::mt19937 random(options.seed);
+        std::uniform_int_distribution<int> pulse(1000, 2000);
+        std::uniform_int_distribution<uint32_t> velocity(50, 8000);
+        std::uniform_int_distribution<uint32_t> accel(2000, 200000);
+        std::uniform_int_distribution<uint32_t> jerk(50000, 8000000);
+        std::uniform_int_distribution<uint32_t> period(1, 20);
+        std::uniform_int_distribution<uint32_t> retargetStep(0, 200);
+
+        uint32_t failures = 0;
+        for (uint32_t c = 0; c < options.cases; c++) {
+            uint32_t maxVelocity = velocity(random);
+            uint32_t maxAccel = accel(random);
+            uint32_t maxJerk = jerk(random);
+            uint32_t periodMs = period(random);
+            float periodS = periodMs * 0.001f;
+            MotionProfiler<int16_t> profiler(pulse(random), maxVelocity, maxAccel, maxJerk);
+            profiler.setTarget(pulse(random));
+            uint32_t retargetAt = retargetStep(random);
+            int16_t finalTarget = pulse(random);
+
+            // The longest move at the slowest limits, with margin
+            float limitS = 1000.0f / maxVelocity + 2.0f * sqrtf(1000.0f / maxAccel) + 2.0f * maxAccel / maxJerk;
+            uint32_t maxSteps = (uint32_t)(2.0f * (limitS + retargetAt * periodS) / periodS) + 100;
+            float lastVelocity = profiler.getVelocity();
+            float peakAccel = 0.0f;
+            float peakVelocity = 0.0f;
+            float overshootUs = 0.0f;
+            float direction = 1.0f;
+            bool canStop = true;
+            bool settled = false;
+            for (uint32_t i = 0; i < maxSteps && !settled; i++) {
+                if (i == retargetAt) {
+                    // A target closer than the braking distance of the move towards it is necessarily overshot
+                    profiler.setTarget(finalTarget);
+                    float distanceUs = finalTarget - profiler.getCurrentValue();
+                    direction = distanceUs >= 0.0f ? 1.0f : -1.0f;
+                    float v = profiler.getVelocity() * direction;
+                    float a = profiler.getAcceleration() * direction;
+                    canStop = v <= 0.0f || stoppingDistance(v, a, maxAccel, maxJerk) + 2.0f < fabsf(distanceUs);
+                }
+                profiler.update(periodMs);
+                // The step settling on the target drops a velocity below a unit per step, not a real acceleration
+                float v = profiler.getVelocity();
+                peakVelocity = std::max(peakVelocity, fabsf(v));
+                if (!profiler.isAtTarget()) {
+                    peakAccel = std::max(peakAccel, fabsf(v - lastVelocity) / periodS);
+                }
+                lastVelocity = v;
+                if (i >= retargetAt) {
+                    if (canStop) {
+                        overshootUs = std::max(overshootUs, (profiler.getCurrentValue() - finalTarget) * direction);
+                    }
+                    settled = profiler.isAtTarget() && profiler.getCurrentValue() == finalTarget;
+                }
+            }
+            bool ok = settled && overshootUs <= 1.0f && peakVelocity <= maxVelocity * 1.01f + 1.0f &&
+                peakAccel <= maxAccel * kAccelMargin + 1.0f / periodS;
+            if (!ok && failures < 5) {
+                printf("    case %u: v %u a %u j %u period %u ms: %s, overshoot %.1f us, peak velocity %.0f, "
+                    "peak acceleration %.0f\n", c, maxVelocity, maxAccel, maxJerk, periodMs,
+                    settled ? "settled" : "not settled", overshootUs, peakVelocity, peakAccel);
+            }
+            failures += ok ? 0 : 1;
+        }
+        printf("  retarget, %u random cases, %u failures%s\n", options.cases, failures, failures == 0 ? "" : "  FAIL");
+        return failures == 0;
+    }
+
+    bool parseOptions(int argc, char** argv, Options& options) {
+        for (int i = 1; i < argc; i++) {
+            const char* arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (strcmp(arg, "--seed") == 0 && hasValue) {
+                options.seed = strtoul(argv[++i], nullptr, 10);
+            } else if (strcmp(arg, "--cases") == 0 && hasValue) {
+                options.cases = strtoul(argv[++i], nullptr, 10);
+            } else if (strcmp(arg, "--accel") == 0 && hasValue) {
+                options.accel = strtoul(argv[++i], nullptr, 10);
+            } else if (strcmp(arg, "--jerk") == 0 && hasValue) {
+                options.jerk = strtoul(argv[++i], nullptr, 10);
+            } else {
+                fprintf(stderr, "Unknown or incomplete option %s\n", arg);
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        return 2;
+    }
+
+    GameConfig config = getDefaultGameConfig();
+    if (options.accel > 0) {
+        config.maxServoPulseAccel = options.accel;
+    }
+    if (options.jerk > 0) {
+        config.maxServoPulseJerk = options.jerk;
+    }
+    printf("Limits %u us/s, %lu us/s^2, %lu us/s^3, loop %u Hz\n", (unsigned)config.maxServoPulseRate,
+        (unsigned long)config.maxServoPulseAccel, (unsigned long)config.maxServoPulseJerk,
+        (unsigned)config.servoLoopRateHz);
+    bool passed = testMoves(config);
+    passed = testSlowMove(config) && passed;
+    passed = testKickback(config) && passed;
+    passed = testRetarget(options) && passed;
+    printf("%s\n", passed ? "OK" : "FAILED");
+    return passed ? 0 : 1;
+}
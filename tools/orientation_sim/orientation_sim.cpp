@@ -0,0 +1,354 @@
+/**
+ * Linux tests and benchmark of the table orientation filter (lib/OrientationEstimator). The filter fuses synthetic
+ * IMU traces at the 200 Hz of the tilt sensor FIFO: the table moves through known roll and pitch angles, the
+ * accelerometer reads gravity with white noise and the vibration of the servos, the gyroscope reads the rates of
+ * the motion with white noise, vibration and a constant bias.
+ *
+ * The tests check the static error at a tilt, the tracking of a moving table against the raw accelerometer
+ * angles, the online estimation of the gyroscope bias and the rejection of shocks. A last test compares the table
+ * angle measurements of the servo calibration (Game::measureTableAngles): a filter seeded from an averaged
+ * accelerometer window must be several times more accurate than one started from a single sample. The benchmark
+ * then reports the cost of an update.
+ *
+ * Usage:
+ *   orientation_sim [options]
+ *     --seed <n>          Random seed of the noise (default 1)
+ *     --updates <n>       Updates timed by the benchmark (default 10000000)
+ *     --no-bench          Run only the tests
+ *
+ * The exit status is 0 when every test passes.
+ */
+
+#include <OrientationEstimator.hpp>
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <vector>
+
+namespace {
+    constexpr float kSamplePeriodS = 0.005f;            // The 200 Hz of the tilt sensor FIFO
+    constexpr float kAccelNoiseG = 0.01f;               // White noise of the accelerometer (RMS)
+    constexpr float kGyroNoiseDps = 0.1f;               // White noise of the gyroscope (RMS)
+    constexpr float kVibrationHz = 47.0f;               // Servo vibration, not a divider of the sample rate
+    constexpr float kVibrationAccelG = 0.05f;           // Vibration amplitude on the accelerometer X and Y axes
+    constexpr float kVibrationGyroDps = 2.0f;           // Vibration amplitude on the gyroscope X and Y axes
+    constexpr uint8_t kMeasureSeedSamples = 20;         // As in lib/Game/Game.cpp
+    constexpr uint8_t kMeasureWindowSamples = 20;       // As in lib/Game/Game.cpp
+    constexpr uint16_t kMeasureTrials = 500;            // Table angle measurements compared
+
+    struct Options {
+        uint32_t seed = 1;
+        uint64_t updates = 10000000;
+        bool bench = true;
+    };
+
+    /**
+     * Table motion: roll (around the sensor X axis) and pitch (around the sensor Y axis) as functions of time
+     */
+    struct Motion {
+        std::function<float(float)> rollDeg;
+        std::function<float(float)> pitchDeg;
+    };
+
+    struct ImuSample {
+        float gx, gy, gz;   // dps
+        float ax, ay, az;   // g
+        uint32_t timestampUs;
+    };
+
+    /**
+     * Generates the IMU samples of a motion, with the conventions of OrientationEstimator: gravity reads
+     * (-sin(pitch), sin(roll) cos(pitch), cos(roll) cos(pitch)).
+     */
+    class ImuTrace {
+    public:
+        ImuTrace(const Motion& motion, uint32_t seed, float gyroBiasXDps = 0.0f, float gyroBiasYDps = 0.0f)
+            : motion(motion), random(seed), noise(0.0f, 1.0f), gyroBiasXDps(gyroBiasXDps),
+              gyroBiasYDps(gyroBiasYDps) {
+            // A random vibration phase, so the trials do not all sample the vibration at the same points
+            vibrationPhase = std::uniform_real_distribution<float>(0.0f, 2.0f * M_PI)(random);
+        }
+
+        ImuSample sample(uint32_t index) {
+            float t = index * kSamplePeriodS;
+            float roll = motion.rollDeg(t) * kDegToRad;
+            float pitch = motion.pitchDeg(t) * kDegToRad;
+
+            // Euler rates by central differences, then body rates (no yaw)
+            const float h = 1e-3f;
+            float rollRate = (motion.rollDeg(t + h) - motion.rollDeg(t - h)) / (2.0f * h);
+            float pitchRate = (motion.pitchDeg(t + h) - motion.pitchDeg(t - h)) / (2.0f * h);
+            float vibration = sinf(2.0f * M_PI * kVibrationHz * t + vibrationPhase);
+
+            ImuSample s;
+            s.gx = rollRate + gyroBiasXDps + kVibrationGyroDps * vibration + kGyroNoiseDps * noise(random);
+            s.gy = pitchRate * cosf(roll) + gyroBiasYDps + kVibrationGyroDps * vibration +
+                kGyroNoiseDps * noise(random);
+            s.gz = -pitchRate * sinf(roll) + kGyroNoiseDps * noise(random);
+            s.ax = -sinf(pitch) + kVibrationAccelG * vibration + kAccelNoiseG * noise(random);
+            s.ay = sinf(roll) * cosf(pitch) + kVibrationAccelG * vibration + kAccelNoiseG * noise(random);
+            s.az = cosf(roll) * cosf(pitch) + kAccelNoiseG * noise(random);
+            s.timestampUs = (uint32_t)lroundf(t * 1e6f);
+            return s;
+        }
+
+        float rollDeg(uint32_t index) const {
+            return motion.rollDeg(index * kSamplePeriodS);
+        }
+
+        float pitchDeg(uint32_t index) const {
+            return motion.pitchDeg(index * kSamplePeriodS);
+        }
+
+    private:
+        static constexpr float kDegToRad = M_PI / 180.0f;
+
+        Motion motion;
+        std::mt19937 random;
+        std::normal_distribution<float> noise;
+        float gyroBiasXDps;
+        float gyroBiasYDps;
+        float vibrationPhase;
+    };
+
+    void fuse(OrientationEstimator& filter, const ImuSample& s) {
+        filter.update(s.gx, s.gy, s.gz, s.ax, s.ay, s.az, s.timestampUs);
+    }
+
+    float tiltErrorDeg(const OrientationEstimator& filter, const ImuTrace& trace, uint32_t index) {
+        return std::max(fabsf(filter.getRollDeg() - trace.rollDeg(index)),
+                        fabsf(filter.getPitchDeg() - trace.pitchDeg(index)));
+    }
+
+    bool report(const char* name, bool ok, const char* format, ...) __attribute__((format(printf, 3, 4)));
+
+    bool report(const char* name, bool ok, const char* format, ...) {
+        printf("  %-22s ", name);
+        va_list args;
+        va_start(args, format);
+        vprintf(format, args);
+        va_end(args);
+        printf("%s\n", ok ? "" : "  FAIL");
+        return ok;
+    }
+
+    /**
+     * Static tilt: after the filter settled, the error must stay within the vibration filtered by the gains.
+     */
+    bool testStaticTilt(const Options& options) {
+        Motion motion = {[](float) { return 3.0f; }, [](float) { return -2.0f; }};
+        ImuTrace trace(motion, options.seed);
+        OrientationEstimator filter;
+        float maxErrorDeg = 0.0f;
+        for (uint32_t i = 0; i < 2000; i++) {
+            fuse(filter, trace.sample(i));
+            if (i >= 1000) {
+                maxErrorDeg = std::max(maxErrorDeg, tiltErrorDeg(filter, trace, i));
+            }
+        }
+        return report("static tilt", maxErrorDeg < 0.3f, "max error %.3f deg after 5 s", maxErrorDeg);
+    }
+
+    /**
+     * Moving table: a 0.5 Hz sweep of +-6 deg, like the player tilting the maze. The filter must follow it with
+     * less error than the raw accelerometer angles, which carry all the vibration.
+     */
+    bool testTracking(const Options& options) {
+        Motion motion = {[](float t) { return 6.0f * sinf(2.0f * M_PI * 0.5f * t); },
+                         [](float t) { return 4.0f * cosf(2.0f * M_PI * 0.3f * t); }};
+        ImuTrace trace(motion, options.seed + 1);
+        OrientationEstimator filter;
+        double filterSquares = 0.0;
+        double rawSquares = 0.0;
+        uint32_t count = 0;
+        for (uint32_t i = 0; i < 4000; i++) {
+            ImuSample s = trace.sample(i);
+            fuse(filter, s);
+            if (i < 400) {
+                continue;
+            }
+            float filterError = tiltErrorDeg(filter, trace, i);
+            float rawRollDeg = atan2f(s.ay, s.az) * 180.0f / M_PI;
+            float rawPitchDeg = asinf(std::max(-1.0f, std::min(1.0f, -s.ax))) * 180.0f / M_PI;
+            float rawError = std::max(fabsf(rawRollDeg - trace.rollDeg(i)), fabsf(rawPitchDeg - trace.pitchDeg(i)));
+            filterSquares += filterError * filterError;
+            rawSquares += rawError * rawError;
+            count++;
+        }
+        float filterRms = sqrt(filterSquares / count);
+        float rawRms = sqrt(rawSquares / count);
+        return report("tracking", filterRms < 0.3f && filterRms < rawRms / 4.0f,
+            "RMS error %.3f deg, raw accelerometer %.3f deg", filterRms, rawRms);
+    }
+
+    /**
+     * Gyroscope bias: a constant bias must be estimated within a minute and must not tilt the orientation.
+     */
+    bool testGyroBias(const Options& options) {
+        const float biasXDps = 1.5f;
+        const float biasYDps = -0.8f;
+        Motion motion = {[](float) { return 1.0f; }, [](float) { return 2.0f; }};
+        ImuTrace trace(motion, options.seed + 2, biasXDps, biasYDps);
+        OrientationEstimator filter;
+        for (uint32_t i = 0; i < 12000; i++) {
+            fuse(filter, trace.sample(i));
+        }
+        float xDps, yDps, zDps;
+        filter.getGyroBias(xDps, yDps, zDps);
+        float biasErrorDps = std::max(fabsf(xDps - biasXDps), fabsf(yDps - biasYDps));
+        float tiltError = tiltErrorDeg(filter, trace, 11999);
+        return report("gyroscope bias", biasErrorDps < 0.2f && tiltError < 0.3f,
+            "bias %.2f %.2f dps (true %.2f %.2f), tilt error %.3f deg", xDps, yDps, biasXDps, biasYDps, tiltError);
+    }
+
+    /**
+     * Shocks: samples far from 1g (the ball hitting the frame) are left out of the correction.
+     */
+    bool testShocks(const Options& options) {
+        Motion motion = {[](float) { return -4.0f; }, [](float) { return 1.0f; }};
+        ImuTrace trace(motion, options.seed + 3);
+        OrientationEstimator filter;
+        float maxErrorDeg = 0.0f;
+        for (uint32_t i = 0; i < 2000; i++) {
+            ImuSample s = trace.sample(i);
+            if (i >= 1000 && i % 50 < 5) {
+                // A burst of 5 samples at 2.5g sideways every 250 ms
+                s.ax += 2.5f;
+            }
+            fuse(filter, s);
+            if (i >= 1000) {
+                maxErrorDeg = std::max(maxErrorDeg, tiltErrorDeg(filter, trace, i));
+            }
+        }
+        bool ok = maxErrorDeg < 0.3f && filter.getRejectedAccelSamples() == 100;
+        return report("shocks", ok, "max error %.3f deg, %u samples rejected", maxErrorDeg,
+            (unsigned)filter.getRejectedAccelSamples());
+    }
+
+    /**
+     * Table angle measurement of the calibration: the filter started from the first sample against the one seeded
+     * from an averaged window, both at the end of the fused window, at random tilts.
+     */
+    bool testMeasurement(const Options& options) {
+        std::mt19937 random(options.seed + 4);
+        std::uniform_real_distribution<float> tilt(-5.0f, 5.0f);
+        std::vector<float> firstSampleErrors;
+        std::vector<float> seededErrors;
+        for (uint16_t trial = 0; trial < kMeasureTrials; trial++) {
+            float rollDeg = tilt(random);
+            float pitchDeg = tilt(random);
+            Motion motion = {[rollDeg](float) { return rollDeg; }, [pitchDeg](float) { return pitchDeg; }};
+
+            // The previous measurement: reset and fuse a window
+            ImuTrace firstSampleTrace(motion, options.seed * 1000 + trial);
+            OrientationEstimator firstSample;
+            for (uint8_t i = 0; i < kMeasureWindowSamples; i++) {
+                fuse(firstSample, firstSampleTrace.sample(i));
+            }
+            firstSampleErrors.push_back(tiltErrorDeg(firstSample, firstSampleTrace, kMeasureWindowSamples - 1));
+
+            // Game::measureTableAngles: average a window, seed a filter from it and fuse a second window
+            ImuTrace seededTrace(motion, options.seed * 1000 + trial);
+            float sumX = 0.0f;
+            float sumY = 0.0f;
+            float sumZ = 0.0f;
+            uint32_t i = 0;
+            for (; i < kMeasureSeedSamples; i++) {
+                ImuSample s = seededTrace.sample(i);
+                sumX += s.ax;
+                sumY += s.ay;
+                sumZ += s.az;
+            }
+            OrientationEstimator seeded;
+            seeded.initialize(sumX / kMeasureSeedSamples, sumY / kMeasureSeedSamples, sumZ / kMeasureSeedSamples,
+                seededTrace.sample(i - 1).timestampUs);
+            for (; i < kMeasureSeedSamples + kMeasureWindowSamples; i++) {
+                fuse(seeded, seededTrace.sample(i));
+            }
+            seededErrors.push_back(tiltErrorDeg(seeded, seededTrace, i - 1));
+        }
+
+        auto percentile = [](std::vector<float>& errors, float p) {
+            std::sort(errors.begin(), errors.end());
+            return errors[(size_t)(p * (errors.size() - 1))];
+        };
+        float firstSampleP95 = percentile(firstSampleErrors, 0.95f);
+        float seededP95 = percentile(seededErrors, 0.95f);
+        // Within the 0.5 deg calibration threshold of include/Config.hpp, with a margin for the servo positioning
+        return report("calibration measurement", seededP95 < 0.4f && seededP95 < firstSampleP95 / 4.0f,
+            "p95 error %.3f deg seeded, %.3f deg from the first sample", seededP95, firstSampleP95);
+    }
+
+    void runBenchmark(const Options& options) {
+        Motion motion = {[](float t) { return 6.0f * sinf(2.0f * M_PI * 0.5f * t); },
+                         [](float t) { return 4.0f * cosf(2.0f * M_PI * 0.3f * t); }};
+        ImuTrace trace(motion, options.seed);
+        std::vector<ImuSample> samples(4096);
+        for (uint32_t i = 0; i < samples.size(); i++) {
+            samples[i] = trace.sample(i);
+        }
+
+        OrientationEstimator filter;
+        float sink = 0.0f;  // Keeps the updates from being optimized out
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < options.updates; i++) {
+            ImuSample s = samples[i % samples.size()];
+            // The timestamps keep growing when the samples are looped
+            s.timestampUs = (uint32_t)(i * (uint64_t)(kSamplePeriodS * 1e6f));
+            fuse(filter, s);
+            sink += filter.getTimestampUs() & 1;
+        }
+        double elapsedS = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printf("Fused %llu samples: %.1f ns/update, %.0f updates/s, %.4f%% of a core at 200 Hz\n",
+            (unsigned long long)options.updates, elapsedS * 1e9 / options.updates, options.updates / elapsedS,
+            elapsedS / options.updates * 200.0 * 100.0);
+        if (sink < 0.0f) {
+            printf("unreachable\n");
+        }
+    }
+
+    bool parseOptions(int argc, char** argv, Options& options) {
+        for (int i = 1; i < argc; i++) {
+            const char* arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (strcmp(arg, "--seed") == 0 && hasValue) {
+                options.seed = strtoul(argv[++i], nullptr, 10);
+            } else if (strcmp(arg, "--updates") == 0 && hasValue) {
+                options.updates = strtoull(argv[++i], nullptr, 10);
+            } else if (strcmp(arg, "--no-bench") == 0) {
+                options.bench = false;
+            } else {
+                fprintf(stderr, "Unknown or incomplete option %s\n", arg);
+                return false;
+            }
+        }
+        return options.updates > 0;
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        return 2;
+    }
+
+    printf("Synthetic traces at %.0f Hz\n", 1.0f / kSamplePeriodS);
+    bool passed = testStaticTilt(options);
+    passed = testTracking(options) && passed;
+    passed = testGyroBias(options) && passed;
+    passed = testShocks(options) && passed;
+    passed = testMeasurement(options) && passed;
+    if (options.bench) {
+        runBenchmark(options);
+    }
+    printf("%s\n", passed ? "OK" : "FAILED");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,314 @@
+/**
+ * Linux power cut test of the high score journal (lib/HighScore/ScoreJournal.cpp). The firmware HighScore runs
+ * against the simulated flash of the host esp_partition, a NOR flash that fails at a chosen step: a byte written
+ * or a sector erased, the step itself left half done.
+ *
+ * A reference run plays a random sequence of scores and resets of the per-level tables, several times around the
+ * sector ring, and checks after each operation that a reboot (a new HighScore replaying the journal) rebuilds the
+ * tables. Then the power is cut at every flash step of the run in turn, the first boot of the journal included
+ * (the move of the NVS tables to it): after the reboot the tables must be those before or after the interrupted
+ * operation, and the operations after it must survive a second reboot, which checks the appends after a torn
+ * record and the compactions after a torn one.
+ *
+ * Usage:
+ *   score_journal_sim [options]
+ *     --operations <n>    Operations of the reference run (default 3000)
+ *     --seed <n>          Random seed (default 1)
+ *     --stride <n>        Cut the power at every n-th flash step only (default 1, all of them)
+ *
+ * The exit status is 0 when every check passes.
+ */
+
+#include <HighScore.hpp>
+#include <HostBoard.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    constexpr uint8_t kOperationsAfterReboot = 3;   // Operations checked after the reboot of a power cut
+    constexpr uint8_t kResetPercent = 5;            // Share of the operations resetting the per-level tables
+    constexpr uint32_t kEasyTimeLimitMs = 50000;    // Of getDefaultGameConfig(), the time of the default scores
+
+    struct Options {
+        uint32_t operations = 3000;
+        uint32_t seed = 1;
+        uint32_t stride = 1;
+    };
+
+    struct Operation {
+        bool reset;
+        HighScore::Score score;
+    };
+
+    /**
+     * Score tables as read through the HighScore interface
+     */
+    struct Tables {
+        HighScore::Score scores[GAME_LEVEL_COUNT][HighScore::SCORES_PER_LEVEL];
+        HighScore::AllTimeScore allTime[HighScore::SCORES_PER_LEVEL];
+
+        bool operator==(const Tables& other) const {
+            for (uint8_t level = 0; level < GAME_LEVEL_COUNT; level++) {
+                for (uint8_t rank = 0; rank < HighScore::SCORES_PER_LEVEL; rank++) {
+                    const HighScore::Score& a = scores[level][rank];
+                    const HighScore::Score& b = other.scores[level][rank];
+                    if (memcmp(a.name, b.name, sizeof(a.name)) != 0 || a.timeMs != b.timeMs) {
+                        return false;
+                    }
+                }
+            }
+            for (uint8_t rank = 0; rank < HighScore::SCORES_PER_LEVEL; rank++) {
+                const HighScore::AllTimeScore& a = allTime[rank];
+                const HighScore::AllTimeScore& b = other.allTime[rank];
+                if (memcmp(a.name, b.name, sizeof(a.name)) != 0 || a.timeMs != b.timeMs || a.level != b.level) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+
+    /**
+     * Flash and NVS content, the whole persistent state of the board
+     */
+    struct Storage {
+        std::map<std::string, std::vector<uint8_t>> flash;
+        std::map<std::string, std::map<std::string, std::vector<uint8_t>>> nvs;
+    };
+
+    Tables readTables(const HighScore& highScore) {
+        Tables tables = {};
+        for (uint8_t rank = 0; rank < HighScore::SCORES_PER_LEVEL; rank++) {
+            highScore.read(GameLevel::EASY, rank, tables.scores[0][rank]);
+            highScore.readAllTime(rank, tables.allTime[rank]);
+        }
+        return tables;
+    }
+
+    Storage saveStorage() {
+        HostBoard& board = hostBoard();
+        return {board.flash, board.nvs};
+    }
+
+    void restoreStorage(const Storage& storage) {
+        HostBoard& board = hostBoard();
+        board.flash = storage.flash;
+        board.nvs = storage.nvs;
+        board.flashPowerCut = false;
+        board.flashStepsBeforePowerCut = -1;
+    }
+
+    uint64_t flashSteps() {
+        const HostBoard& board = hostBoard();
+        return board.flashBytesWritten + board.flashSectorErases;
+    }
+
+    GameConfig gameConfig() {
+        GameConfig config = {};
+        config.easyTimeLimitMs = kEasyTimeLimitMs;
+        return config;
+    }
+
+    /**
+     * Boots the firmware high scores on the storage of the board: replays the journal, or moves the NVS tables
+     * to it the first time.
+     */
+    std::unique_ptr<HighScore> boot() {
+        std::unique_ptr<HighScore> highScore(new HighScore());
+        return highScore->begin(gameConfig()) ? std::move(highScore) : nullptr;
+    }
+
+    void run(HighScore& highScore, const Operation& operation) {
+        if (operation.reset) {
+            highScore.overwriteWithDefaultScores(gameConfig());
+        } else {
+            highScore.write(GameLevel::EASY, operation.score);
+        }
+    }
+
+    /**
+     * Draws the operations: mostly scores, most of them good enough for the tables, and a few resets.
+     */
+    std::vector<Operation> makeOperations(uint32_t count, uint32_t seed) {
+        std::mt19937 random(seed);
+        const uint32_t timeLimitMs = kEasyTimeLimitMs;
+        std::vector<Operation> operations(count);
+        for (Operation& operation : operations) {
+            operation.reset = random() % 100 < kResetPercent;
+            for (uint8_t i = 0; i < 3; i++) {
+                operation.score.name[i] = 'A' + random() % 26;
+            }
+            operation.score.name[3] = '\0';
+            // Better scores are rarer, so the tables keep changing for the whole run
+            uint32_t range = timeLimitMs >> (random() % 8);
+            operation.score.timeMs = timeLimitMs - range + random() % range;
+        }
+        return operations;
+    }
+
+    /**
+     * NVS tables of the firmware before the journal, moved to it at the first boot
+     */
+    void writeNvsTables(uint32_t seed) {
+        std::mt19937 random(seed);
+        Preferences preferences;
+        preferences.begin("brickmaze", false);
+        HighScore::Score scores[GAME_LEVEL_COUNT][HighScore::SCORES_PER_LEVEL];
+        HighScore::AllTimeScore allTime[HighScore::SCORES_PER_LEVEL];
+        uint32_t timeMs = 20000;
+        for (uint8_t rank = 0; rank < HighScore::SCORES_PER_LEVEL; rank++) {
+            timeMs += random() % 3000;
+            scores[0][rank] = {{'N', 'V', (char)('1' + rank), '\0'}, timeMs};
+            allTime[rank] = {{'O', 'L', (char)('1' + rank), '\0'}, timeMs - 5000, GameLevel::EASY};
+        }
+        preferences.putBytes("today2", scores, sizeof(scores));
+        preferences.putBytes("alltime2", allTime, sizeof(allTime));
+        preferences.end();
+    }
+
+    bool parseOptions(int argc, char** argv, Options& options) {
+        for (int i = 1; i < argc; i++) {
+            const char* name = argv[i];
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Missing value for %s\n", name);
+                return false;
+            }
+            uint32_t value = strtoul(argv[++i], nullptr, 10);
+            if (strcmp(name, "--operations") == 0) {
+                options.operations = value;
+            } else if (strcmp(name, "--seed") == 0) {
+                options.seed = value;
+            } else if (strcmp(name, "--stride") == 0 && value > 0) {
+                options.stride = value;
+            } else {
+                fprintf(stderr, "Unknown option or bad value %s\n", name);
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        return 2;
+    }
+    std::vector<Operation> operations = makeOperations(options.operations, options.seed);
+    HostBoard& board = hostBoard();
+
+    // Reference run. Step i of the run is the first boot (i = 0) or operation i - 1.
+    writeNvsTables(options.seed);
+    std::vector<Storage> storageBefore;     // Persistent state before each step
+    std::vector<uint64_t> stepsBefore;      // Flash steps before each step
+    std::vector<Tables> tablesAfter;        // Tables after each step
+    storageBefore.push_back(saveStorage());
+    stepsBefore.push_back(flashSteps());
+    std::unique_ptr<HighScore> highScore = boot();
+    uint32_t failures = 0;
+    if (!highScore || board.nvs["brickmaze"].count("today2") != 0) {
+        printf("FAIL: first boot, NVS tables not moved to the journal\n");
+        return 1;
+    }
+    tablesAfter.push_back(readTables(*highScore));
+    const uint64_t nvsWritesBefore = board.nvsWrites;
+    uint32_t written = 0;
+    for (uint32_t i = 0; i < operations.size(); i++) {
+        storageBefore.push_back(saveStorage());
+        stepsBefore.push_back(flashSteps());
+        run(*highScore, operations[i]);
+        written += operations[i].reset || !(tablesAfter.back() == readTables(*highScore));
+        tablesAfter.push_back(readTables(*highScore));
+
+        std::unique_ptr<HighScore> rebooted = boot();
+        if (!rebooted || !(readTables(*rebooted) == tablesAfter.back())) {
+            printf("FAIL: operation %u, the journal does not rebuild the tables\n", i);
+            failures++;
+        }
+    }
+    stepsBefore.push_back(flashSteps());
+    ScoreJournalStats stats = highScore->getJournalStats();
+    const uint64_t totalSteps = stepsBefore.back() - stepsBefore.front();
+    printf("Reference run: %u operations, %u changed the tables, %lu compactions, sector %u of %u\n",
+        (unsigned)operations.size(), written, (unsigned long)stats.compactions, stats.activeSector, stats.sectors);
+    printf("  flash: %llu bytes written, %llu sector erases, %.1f bytes per change; NVS: %llu writes after boot\n",
+        (unsigned long long)board.flashBytesWritten, (unsigned long long)board.flashSectorErases,
+        written > 0 ? (double)board.flashBytesWritten / written : 0.0,
+        (unsigned long long)(board.nvsWrites - nvsWritesBefore));
+    printf("  the NVS tables rewritten on each change were %u bytes\n",
+        (unsigned)(sizeof(HighScore::Score) * GAME_LEVEL_COUNT * HighScore::SCORES_PER_LEVEL +
+                   sizeof(HighScore::AllTimeScore) * HighScore::SCORES_PER_LEVEL));
+
+    // Power cut at each flash step
+    uint32_t cuts = 0;
+    uint32_t kept = 0;
+    uint32_t torn = 0;
+    size_t step = 0;
+    for (uint64_t cut = 0; cut < totalSteps; cut += options.stride) {
+        while (stepsBefore[step + 1] - stepsBefore[0] <= cut) {
+            step++;
+        }
+        restoreStorage(storageBefore[step]);
+        const Tables& before = step == 0 ? Tables() : tablesAfter[step - 1];
+        board.flashStepsBeforePowerCut = cut - (stepsBefore[step] - stepsBefore[0]);
+        if (step == 0) {
+            boot();
+        } else {
+            std::unique_ptr<HighScore> running = boot();
+            if (running) {
+                run(*running, operations[step - 1]);
+            }
+        }
+        if (!board.flashPowerCut) {
+            printf("FAIL: step %u, no power cut at flash step %llu\n", (unsigned)step, (unsigned long long)cut);
+            failures++;
+            continue;
+        }
+        cuts++;
+
+        // Reboot: the tables before or after the interrupted step
+        board.flashPowerCut = false;
+        std::unique_ptr<HighScore> rebooted = boot();
+        Tables tables = rebooted ? readTables(*rebooted) : Tables();
+        bool isAfter = rebooted && tables == tablesAfter[step];
+        bool isBefore = rebooted && step > 0 && tables == before;
+        if (step == 0 && rebooted && !isAfter) {
+            // The first boot again: the NVS tables are still there
+            printf("FAIL: flash step %llu of the first boot, the NVS tables are lost\n", (unsigned long long)cut);
+            failures++;
+            continue;
+        }
+        if (!isAfter && !isBefore) {
+            printf("FAIL: flash step %llu of operation %u, tables neither before nor after it\n",
+                (unsigned long long)cut, (unsigned)step - 1);
+            failures++;
+            continue;
+        }
+        kept += isAfter;
+        torn += rebooted->getJournalStats().tornRecords > 0;
+
+        // The operations after the reboot survive the next one
+        for (uint32_t i = step; i < step + kOperationsAfterReboot && i < operations.size(); i++) {
+            run(*rebooted, operations[i]);
+        }
+        Tables expected = readTables(*rebooted);
+        std::unique_ptr<HighScore> second = boot();
+        if (!second || !(readTables(*second) == expected)) {
+            printf("FAIL: flash step %llu of step %u, writes after the reboot lost\n", (unsigned long long)cut,
+                (unsigned)step);
+            failures++;
+        }
+    }
+    printf("Power cuts: %u of %llu flash steps, the interrupted change kept %u times, lost %u times, "
+        "%u boots with torn records\n", cuts, (unsigned long long)totalSteps, kept, cuts - kept, torn);
+    printf("%s: %u failures\n", failures == 0 ? "PASS" : "FAIL", failures);
+    return failures == 0 ? 0 : 1;
+}
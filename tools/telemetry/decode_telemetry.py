@@ -0,0 +1,168 @@
+#!/usr/bin/env python3
+"""
+Decodes the in-game telemetry exported by the TELEMETRY_DUMP debug console command into CSV.
+
+The dump is read from a capture of the USB serial (other log lines are ignored) or, with --port, requested and
+captured directly from the board. The record layout mirrors TelemetryRecord in
+lib/TelemetryRecorder/TelemetryRecorder.hpp.
+
+Examples:
+    decode_telemetry.py capture.log -o games.csv                # all the games found in a serial capture
+    decode_telemetry.py --port /dev/ttyACM0 -o games.csv        # dump all the games from the board
+    decode_telemetry.py --port /dev/ttyACM0 --game 12 -o game12.csv
+"""
+
+import argparse
+import csv
+import os
+import select
+import struct
+import sys
+import termios
+import time
+import tty
+
+FORMAT_VERSION = 1
+RECORD = struct.Struct("<IBBhhhhhhHHhh")
+
+RECORD_TYPES = ["sample", "start", "kickback", "drop", "timeout", "stop"]
+RESULTS = ["none", "won", "lost"]
+FLAG_TILT = 0x01
+FLAG_TILT_CONTROL = 0x02
+
+COLUMNS = ["game", "time_ms", "event", "input_x", "input_y", "target_x_us", "target_y_us", "ramp_x_us",
+           "ramp_y_us", "pulse_x_us", "pulse_y_us", "tilt_x_deg", "tilt_y_deg", "tilt_control"]
+
+
+def capture_from_port(path, game_id, timeout_s):
+    """Sends the dump command and returns the captured lines up to the end of the dump."""
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+    try:
+        if os.isatty(fd):
+            tty.setraw(fd)
+            attrs = termios.tcgetattr(fd)
+            attrs[4] = attrs[5] = termios.B115200
+            termios.tcsetattr(fd, termios.TCSANOW, attrs)
+        command = "TELEMETRY_DUMP" + (" %d" % game_id if game_id is not None else "") + "\n"
+        os.write(fd, command.encode("ascii"))
+
+        lines = []
+        pending = b""
+        deadline = time.monotonic() + timeout_s
+        while time.monotonic() < deadline:
+            ready, _, _ = select.select([fd], [], [], 0.2)
+            if not ready:
+                continue
+            pending += os.read(fd, 4096)
+            *complete, pending = pending.split(b"\n")
+            for line in complete:
+                text = line.decode("ascii", errors="replace").strip()
+                lines.append(text)
+                if text.startswith("TLM END"):
+                    return lines
+            deadline = time.monotonic() + timeout_s
+        raise RuntimeError("no complete dump received from %s" % path)
+    finally:
+        os.close(fd)
+
+
+def parse_dump(lines):
+    """Returns the list of games found in the dump lines, each with its header fields and records."""
+    games = []
+    game = None
+    for number, line in enumerate(lines, 1):
+        # The dump can be interleaved with other log messages, even on the same line
+        start = line.find("TLM ")
+        if start < 0:
+            continue
+        fields = line[start:].split()
+        if fields[1] == "BEGIN":
+            version, record_size = int(fields[2]), int(fields[3])
+            if version != FORMAT_VERSION or record_size != RECORD.size:
+                raise ValueError("unsupported dump format %d with %d bytes records" % (version, record_size))
+        elif fields[1] == "GAME":
+            game = dict(zip(["id", "start_ms", "level", "result", "completion_ms", "records", "lost"],
+                            map(int, fields[2:9])))
+            game["data"] = []
+            games.append(game)
+        elif fields[1] == "R" and game is not None:
+            try:
+                data = bytes.fromhex(fields[2])
+            except (IndexError, ValueError):
+                data = b""
+            if len(data) != RECORD.size:
+                print("line %d: corrupted record skipped" % number, file=sys.stderr)
+                continue
+            game["data"].append(RECORD.unpack(data))
+    return games
+
+
+def write_csv(games, out):
+    writer = csv.writer(out)
+    writer.writerow(COLUMNS)
+    for game in games:
+        for (time_us, kind, flags, input_x, input_y, target_x, target_y, ramp_x, ramp_y, pulse_x, pulse_y,
+             tilt_x, tilt_y) in game["data"]:
+            has_tilt = flags & FLAG_TILT
+            writer.writerow([
+                game["id"], "%.3f" % (time_us / 1000.0),
+                RECORD_TYPES[kind] if kind < len(RECORD_TYPES) else kind,
+                "%.4f" % (input_x / 10000.0), "%.4f" % (input_y / 10000.0),
+                target_x, target_y, ramp_x, ramp_y, pulse_x, pulse_y,
+                "%.2f" % (tilt_x / 100.0) if has_tilt else "", "%.2f" % (tilt_y / 100.0) if has_tilt else "",
+                1 if flags & FLAG_TILT_CONTROL else 0])
+
+
+def print_summary(games):
+    for game in games:
+        data = game["data"]
+        result = RESULTS[game["result"]] if game["result"] < len(RESULTS) else game["result"]
+        line = "game %d: %d records" % (game["id"], len(data))
+        if len(data) != game["records"]:
+            line += " (%d expected)" % game["records"]
+        if game["lost"]:
+            line += ", %d oldest lost" % game["lost"]
+        line += ", result %s, %d ms" % (result, game["completion_ms"])
+        samples = [r for r in data if r[1] == 0]
+        if len(samples) > 1:
+            periods = [b[0] - a[0] for a, b in zip(samples, samples[1:])]
+            line += ", sample period mean %.1f ms max %.1f ms" % (
+                sum(periods) / len(periods) / 1000.0, max(periods) / 1000.0)
+        print(line, file=sys.stderr)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("capture", nargs="?", help="serial capture containing a dump (default: stdin)")
+    parser.add_argument("--port", help="request the dump from the board on this serial port")
+    parser.add_argument("--game", type=int, help="only decode the game with this id")
+    parser.add_argument("--timeout", type=float, default=5.0, help="seconds without data before giving up")
+    parser.add_argument("-o", "--output", help="CSV file to write (default: stdout)")
+    args = parser.parse_args()
+
+    if args.port:
+        lines = capture_from_port(args.port, args.game, args.timeout)
+    elif args.capture:
+        with open(args.capture, "r", errors="replace") as capture:
+            lines = capture.read().splitlines()
+    else:
+        lines = sys.stdin.read().splitlines()
+
+    games = parse_dump(lines)
+    if args.game is not None:
+        games = [game for game in games if game["id"] == args.game]
+    if not games:
+        print("no telemetry found", file=sys.stderr)
+        return 1
+
+    print_summary(games)
+    if args.output:
+        with open(args.output, "w", newline="") as out:
+            write_csv(games, out)
+    else:
+        write_csv(games, sys.stdout)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
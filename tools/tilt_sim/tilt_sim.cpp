@@ -0,0 +1,381 @@
+/**
+ * Linux plant simulation of the closed-loop table tilt control (lib/TiltController). A servo and table model with
+ * the defects the closed loop corrects (a servo gain off from the nominal one, deadband, backlash between the servo
+ * arm and the table, the sag of the table under its load, a first order servo response) is driven through the
+ * commands of a game, once open loop with the feedforward pulse of Game::update alone and once with the
+ * TiltController correction added at the servo loop rate. The tilt is measured like the TiltSensorTask does: every
+ * tiltSensorPeriodMs, with the delay of the orientation filter and some noise.
+ *
+ * The step test compares the settling time and the tracking error of the two loops, the sweep test the tracking
+ * error on a moving command, the saturation test the recovery after the correction was at its limit (the
+ * anti-windup). The derivative test feeds a ramp sampled at the measurement rate to a derivative-only PID running
+ * at the loop rate: the rate estimated between the measurements must be steady, where differentiating at the loop
+ * rate gives a spike at each new sample.
+ *
+ * The gains are those of getDefaultGameConfig() unless given as options, to tune them. The runs are on the virtual clock of a HostKernel, the
+ * TiltController timing out its measurements with millis().
+ *
+ * Usage:
+ *   tilt_sim [options]
+ *     --seed <n>          Random seed of the measurement noise (default 1)
+ *     --kp <us/deg>       Proportional gain of the tilt PID
+ *     --ki <us/deg/s>     Integral gain of the tilt PID
+ *     --kd <us/deg/s>     Derivative gain of the tilt PID
+ *
+ * The exit status is 0 when every test passes.
+ */
+
+#include <Config.hpp>
+#include <HostKernel.h>
+#include <PidController.hpp>
+#include <TiltController.hpp>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+    constexpr uint32_t kPlantPeriodUs = 1000;           // Integration step of the plant
+    constexpr float kMeasurementDelayS = 0.01f;         // Delay of the orientation filter
+    constexpr float kMeasurementNoiseDeg = 0.05f;       // Noise of the measured tilt (RMS)
+    constexpr float kSettleToleranceDeg = 0.25f;        // Tilt error of a settled table
+    constexpr float kSettleAfterMs = 1500.0f;           // Longest closed-loop settling time accepted
+
+    struct Options {
+        uint32_t seed = 1;
+        float kp = NAN;     // NAN to keep the gains of getDefaultGameConfig()
+        float ki = NAN;
+        float kd = NAN;
+    };
+
+    /**
+     * Servo and table of one axis, in pulse widths relative to the calibrated center.
+     */
+    struct PlantAxis {
+        float gainDegPerUs;     // Table tilt per pulse width of the servo
+        float deadbandUs;       // The servo does not move for pulse errors within this
+        float backlashDeg;      // Play between the servo arm and the table
+        float loadOffsetDeg;    // Sag of the table under the load
+        float timeConstantS;    // First order response of the servo
+
+        float servoUs = 0.0f;
+        float tableDeg = 0.0f;
+
+        void step(float pulseUs, float dtS) {
+            float error = pulseUs - servoUs;
+            if (fabsf(error) > deadbandUs) {
+                servoUs += (error - copysignf(deadbandUs, error)) * dtS / timeConstantS;
+            }
+            float armDeg = gainDegPerUs * servoUs + loadOffsetDeg;
+            float halfBacklashDeg = backlashDeg * 0.5f;
+            tableDeg = std::max(armDeg - halfBacklashDeg, std::min(armDeg + halfBacklashDeg, tableDeg));
+        }
+    };
+
+    /**
+     * Tilt command of both axes at a time.
+     */
+    using Command = std::function<void(float timeS, float& xDeg, float& yDeg)>;
+
+    struct RunResult {
+        std::vector<float> timeS;
+        std::vector<float> errorXDeg;   // Command minus true table tilt
+        std::vector<float> errorYDeg;
+        TiltControlStats stats;
+    };
+
+    /**
+     * Runs the plant through a command on the virtual clock.
+     * @param config Game configuration, for the gains, the pulse range and the rates.
+     * @param x Plant of the X axis.
+     * @param y Plant of the Y axis.
+     * @param command The tilt command.
+     * @param durationS Duration of the run.
+     * @param closedLoop true to add the TiltController correction to the feedforward pulse.
+     * @param seed Random seed of the measurement noise.
+     */
+    RunResult runPlant(const GameConfig& config, PlantAxis x, PlantAxis y, const Command& command, float durationS,
+                       bool closedLoop, uint32_t seed) {
+        RunResult result;
+        std::thread thread([&]() {
+            HostKernel kernel;
+            std::mt19937 random(seed);
+            std::normal_distribution<float> noise(0.0f, kMeasurementNoiseDeg);
+
+            TiltController controller;
+            controller.begin(config.tiltKp, config.tiltKi, config.tiltKd, config.tiltMaxCorrectionPulseUs,
+                config.tiltSensorPeriodMs * 3);
+            controller.setEnabled(closedLoop);
+
+            // Feedforward of Game::update: full deflection is half the pulse range and tiltMaxAngleDeg
+            float feedforwardUsPerDeg = config.servoPulseRange * 0.5f / config.tiltMaxAngleDeg;
+            uint32_t loopPeriodUs = 1000000 / config.servoLoopRateHz;
+            uint32_t measurementPeriodUs = config.tiltSensorPeriodMs * 1000;
+            uint32_t delaySteps = (uint32_t)lroundf(kMeasurementDelayS * 1e6f / kPlantPeriodUs);
+            std::deque<std::pair<float, float>> history;    // True tilts of the last delaySteps steps
+
+            int16_t xCorrectionUs = 0;
+            int16_t yCorrectionUs = 0;
+            float xPulseUs = 0.0f;
+            float yPulseUs = 0.0f;
+            uint32_t steps = (uint32_t)(durationS * 1e6f / kPlantPeriodUs);
+            for (uint32_t i = 0; i < steps; i++) {
+                uint32_t nowUs = i * kPlantPeriodUs;
+                float timeS = nowUs * 1e-6f;
+                float commandXDeg, commandYDeg;
+                command(timeS, commandXDeg, commandYDeg);
+
+                if (nowUs % measurementPeriodUs == 0 && history.size() > delaySteps) {
+                    const std::pair<float, float>& delayed = history.front();
+                    controller.setMeasuredTilt(delayed.first + noise(random), delayed.second + noise(random),
+                        nowUs);
+                }
+                if (nowUs % loopPeriodUs == 0) {
+                    controller.setTargetTilt(commandXDeg, commandYDeg);
+                    controller.update(loopPeriodUs / 1000, xCorrectionUs, yCorrectionUs);
+                    xPulseUs = roundf(commandXDeg * feedforwardUsPerDeg) + xCorrectionUs;
+                    yPulseUs = roundf(commandYDeg * feedforwardUsPerDeg) + yCorrectionUs;
+                }
+
+                x.step(xPulseUs, kPlantPeriodUs * 1e-6f);
+                y.step(yPulseUs, kPlantPeriodUs * 1e-6f);
+                history.emplace_back(x.tableDeg, y.tableDeg);
+                if (history.size() > delaySteps + 1) {
+                    history.pop_front();
+                }
+                result.timeS.push_back(timeS);
+                result.errorXDeg.push_back(commandXDeg - x.tableDeg);
+                result.errorYDeg.push_back(commandYDeg - y.tableDeg);
+
+                delayMicroseconds(kPlantPeriodUs);
+            }
+            result.stats = controller.getStats();
+        });
+        thread.join();
+        return result;
+    }
+
+    /**
+     * Servo gains 10% below and 8% above the nominal one, with deadband, backlash and load on both axes.
+     */
+    void defaultPlant(const GameConfig& config, PlantAxis& x, PlantAxis& y) {
+        float nominalGainDegPerUs = config.tiltMaxAngleDeg / (config.servoPulseRange * 0.5f);
+        x = {nominalGainDegPerUs * 0.9f, 3.0f, 0.4f, 0.3f, 0.06f};
+        y = {nominalGainDegPerUs * 1.08f, 3.0f, 0.4f, -0.25f, 0.06f};
+    }
+
+    /**
+     * Gets the RMS tilt error of both axes over a time range of a run.
+     */
+    float rmsError(const RunResult& run, float fromS, float toS) {
+        double squares = 0.0;
+        uint32_t count = 0;
+        for (size_t i = 0; i < run.timeS.size(); i++) {
+            if (run.timeS[i] >= fromS && run.timeS[i] < toS) {
+                squares += run.errorXDeg[i] * run.errorXDeg[i] + run.errorYDeg[i] * run.errorYDeg[i];
+                count += 2;
+            }
+        }
+        return count > 0 ? sqrt(squares / count) : 0.0f;
+    }
+
+    /**
+     * Gets the settling time of a step: the time from the step to the last sample out of the tolerance.
+     * @return The settling time in milliseconds, a negative value if the table is not settled at the end.
+     */
+    float settlingTimeMs(const RunResult& run, float stepS, float endS) {
+        float lastOutS = stepS;
+        float lastErrorDeg = 0.0f;
+        for (size_t i = 0; i < run.timeS.size(); i++) {
+            if (run.timeS[i] < stepS || run.timeS[i] >= endS) {
+                continue;
+            }
+            lastErrorDeg = std::max(fabsf(run.errorXDeg[i]), fabsf(run.errorYDeg[i]));
+            if (lastErrorDeg > kSettleToleranceDeg) {
+                lastOutS = run.timeS[i];
+            }
+        }
+        return lastErrorDeg > kSettleToleranceDeg ? -1.0f : (lastOutS - stepS) * 1000.0f;
+    }
+
+    void printSettling(const char* name, float ms) {
+        if (ms < 0.0f) {
+            printf("    %-12s not settled\n", name);
+        } else {
+            printf("    %-12s %.0f ms\n", name, ms);
+        }
+    }
+
+    /**
+     * Command steps of the game: the player tilting the table and holding it.
+     */
+    bool testSteps(const GameConfig& config, const Options& options) {
+        static const float kStepsDeg[][2] = {{5.0f, -2.0f}, {-3.0f, 4.0f}, {6.4f, 6.4f}, {0.0f, 0.0f}};
+        const float holdS = 3.0f;
+        Command command = [&](float timeS, float& xDeg, float& yDeg) {
+            uint32_t step = std::min((uint32_t)(timeS / holdS), 3u);
+            xDeg = kStepsDeg[step][0];
+            yDeg = kStepsDeg[step][1];
+        };
+        PlantAxis x, y;
+        defaultPlant(config, x, y);
+        RunResult open = runPlant(config, x, y, command, 4 * holdS, false, options.seed);
+        RunResult closed = runPlant(config, x, y, command, 4 * holdS, true, options.seed);
+
+        // The servo response after a step is the same in both loops, the tracking error is compared once held
+        bool ok = true;
+        double openSquares = 0.0;
+        double closedSquares = 0.0;
+        printf("  steps, settling within %.2f deg\n", kSettleToleranceDeg);
+        for (uint8_t step = 0; step < 4; step++) {
+            float stepS = step * holdS;
+            float openMs = settlingTimeMs(open, stepS, stepS + holdS);
+            float closedMs = settlingTimeMs(closed, stepS, stepS + holdS);
+            printf("   to %.1f %.1f deg\n", kStepsDeg[step][0], kStepsDeg[step][1]);
+            printSettling("open loop", openMs);
+            printSettling("closed loop", closedMs);
+            ok = ok && closedMs >= 0.0f && closedMs <= kSettleAfterMs;
+            openSquares += pow(rmsError(open, stepS + kSettleAfterMs * 0.001f, stepS + holdS), 2);
+            closedSquares += pow(rmsError(closed, stepS + kSettleAfterMs * 0.001f, stepS + holdS), 2);
+        }
+        float openRms = sqrt(openSquares / 4);
+        float closedRms = sqrt(closedSquares / 4);
+        ok = ok && closedRms < openRms / 2.0f;
+        printf("    RMS error held %.3f deg open loop, %.3f deg closed loop%s\n", openRms, closedRms,
+            ok ? "" : "  FAIL");
+        return ok;
+    }
+
+    /**
+     * A moving command: the player sweeping the table.
+     */
+    bool testSweep(const GameConfig& config, const Options& options) {
+        Command command = [](float timeS, float& xDeg, float& yDeg) {
+            xDeg = 5.0f * sinf(2.0f * M_PI * 0.3f * timeS);
+            yDeg = 4.0f * cosf(2.0f * M_PI * 0.2f * timeS);
+        };
+        PlantAxis x, y;
+        defaultPlant(config, x, y);
+        RunResult open = runPlant(config, x, y, command, 20.0f, false, options.seed + 1);
+        RunResult closed = runPlant(config, x, y, command, 20.0f, true, options.seed + 1);
+        // After the integral caught up with the gain error
+        float openRms = rmsError(open, 5.0f, 20.0f);
+        float closedRms = rmsError(closed, 5.0f, 20.0f);
+        bool ok = closedRms < openRms / 2.0f;
+        printf("  sweep, RMS error %.3f deg open loop, %.3f deg closed loop%s\n", openRms, closedRms,
+            ok ? "" : "  FAIL");
+        return ok;
+    }
+
+    /**
+     * A plant far weaker than nominal: at full tilt the correction stays at its limit, then the command comes back
+     * to level. A wound up integral would hold the table off level for seconds.
+     */
+    bool testSaturation(const GameConfig& config, const Options& options) {
+        const float holdS = 4.0f;
+        float maxAngleDeg = config.tiltMaxAngleDeg;
+        Command command = [=](float timeS, float& xDeg, float& yDeg) {
+            xDeg = timeS < holdS ? maxAngleDeg : 0.0f;
+            yDeg = 0.0f;
+        };
+        PlantAxis x, y;
+        defaultPlant(config, x, y);
+        x.gainDegPerUs *= 0.6f / 0.9f;
+        RunResult closed = runPlant(config, x, y, command, 2 * holdS, true, options.seed + 2);
+        float settledMs = settlingTimeMs(closed, holdS, 2 * holdS);
+        bool ok = closed.stats.saturatedSamples > 0 && settledMs >= 0.0f && settledMs <= kSettleAfterMs;
+        printf("  saturation, %lu saturated updates, back to level in ", (unsigned long)closed.stats.saturatedSamples);
+        if (settledMs < 0.0f) {
+            printf("never%s\n", ok ? "" : "  FAIL");
+        } else {
+            printf("%.0f ms%s\n", settledMs, ok ? "" : "  FAIL");
+        }
+        return ok;
+    }
+
+    /**
+     * A 10 deg/s ramp measured at the tilt sensor rate through a derivative-only PID running at the loop rate:
+     * the output is the opposite of the estimated rate.
+     */
+    bool testDerivative(const GameConfig& config) {
+        const float rateDegS = 10.0f;
+        float loopDtS = 1.0f / config.servoLoopRateHz;
+        float measurementDtS = config.tiltSensorPeriodMs * 0.001f;
+        uint32_t loopsPerMeasurement = (uint32_t)lroundf(measurementDtS / loopDtS);
+
+        PidController measurementRate(0.0f, 0.0f, 1.0f, 1000.0f);
+        PidController loopRate(0.0f, 0.0f, 1.0f, 1000.0f);
+        float measurementMin = INFINITY, measurementMax = -INFINITY;
+        float loopMin = INFINITY, loopMax = -INFINITY;
+        float measurement = 0.0f;
+        for (uint32_t i = 0; i < 2000; i++) {
+            bool newMeasurement = i % loopsPerMeasurement == 0;
+            if (newMeasurement) {
+                measurement = rateDegS * i * loopDtS;
+            }
+            float fromMeasurements = -measurementRate.update(0.0f, measurement, loopDtS,
+                newMeasurement ? measurementDtS : 0.0f);
+            float fromLoop = -loopRate.update(0.0f, measurement, loopDtS);
+            // After the derivative filter settled
+            if (i >= 500) {
+                measurementMin = std::min(measurementMin, fromMeasurements);
+                measurementMax = std::max(measurementMax, fromMeasurements);
+                loopMin = std::min(loopMin, fromLoop);
+                loopMax = std::max(loopMax, fromLoop);
+            }
+        }
+        bool ok = measurementMin > rateDegS * 0.98f && measurementMax < rateDegS * 1.02f;
+        printf("  derivative of a %.0f deg/s ramp, %.2f to %.2f deg/s at the measurement rate, %.2f to %.2f deg/s "
+            "at the loop rate%s\n", rateDegS, measurementMin, measurementMax, loopMin, loopMax, ok ? "" : "  FAIL");
+        return ok;
+    }
+
+    bool parseOptions(int argc, char** argv, Options& options) {
+        for (int i = 1; i < argc; i++) {
+            const char* arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (strcmp(arg, "--seed") == 0 && hasValue) {
+                options.seed = strtoul(argv[++i], nullptr, 10);
+            } else if (strcmp(arg, "--kp") == 0 && hasValue) {
+                options.kp = atof(argv[++i]);
+            } else if (strcmp(arg, "--ki") == 0 && hasValue) {
+                options.ki = atof(argv[++i]);
+            } else if (strcmp(arg, "--kd") == 0 && hasValue) {
+                options.kd = atof(argv[++i]);
+            } else {
+                fprintf(stderr, "Unknown or incomplete option %s\n", arg);
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        return 2;
+    }
+
+    GameConfig config = getDefaultGameConfig();
+    config.tiltKp = isnan(options.kp) ? config.tiltKp : options.kp;
+    config.tiltKi = isnan(options.ki) ? config.tiltKi : options.ki;
+    config.tiltKd = isnan(options.kd) ? config.tiltKd : options.kd;
+    printf("Tilt PID Kp %.1f us/deg, Ki %.1f us/deg/s, Kd %.2f us/deg/s, loop %u Hz, measurements every %u ms\n",
+        config.tiltKp, config.tiltKi, config.tiltKd, (unsigned)config.servoLoopRateHz,
+        (unsigned)config.tiltSensorPeriodMs);
+    bool passed = testSteps(config, options);
+    passed = testSweep(config, options) && passed;
+    passed = testSaturation(config, options) && passed;
+    passed = testDerivative(config) && passed;
+    printf("%s\n", passed ? "OK" : "FAILED");
+    return passed ? 0 : 1;
+}